@@ -12,7 +12,7 @@
 
 <xsl:stylesheet xmlns:xsl="http://www.w3.org/1999/XSL/Transform" xmlns="http://www.w3.org/1999/xhtml" version="1.0">
   <xsl:output method="html" indent="yes" version="4.0"/>
-  <xsl:template match="statistics[@version=&quot;3.8&quot;]">
+  <xsl:template match="statistics[@version=&quot;3.9&quot;]">
     <html>
       <head>
         <script type="text/javascript" src="https://ajax.googleapis.com/ajax/libs/jquery/3.4.1/jquery.min.js"></script>
@@ -890,6 +890,8 @@
               <th>References</th>
               <th>LocalAddress</th>
               <th>PeerAddress</th>
+              <th>Received</th>
+              <th>Sent</th>
               <th>State</th>
             </tr>
             <xsl:for-each select="socketmgr/sockets/socket">
@@ -919,6 +921,12 @@
                 <td>
                   <xsl:value-of select="peer-address"/>
                 </td>
+                <td>
+                  <xsl:value-of select="received"/>
+                </td>
+                <td>
+                  <xsl:value-of select="sent"/>
+                </td>
                 <td>
                   <xsl:for-each select="states">
                     <xsl:value-of select="."/>
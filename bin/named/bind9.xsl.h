@@ -17,7 +17,7 @@ static char xslmsg[] =
 	"\n"
 	"<xsl:stylesheet xmlns:xsl=\"http://www.w3.org/1999/XSL/Transform\" xmlns=\"http://www.w3.org/1999/xhtml\" version=\"1.0\">\n"
 	" <xsl:output method=\"html\" indent=\"yes\" version=\"4.0\"/>\n"
-	" <xsl:template match=\"statistics[@version=&quot;3.8&quot;]\">\n"
+	" <xsl:template match=\"statistics[@version=&quot;3.9&quot;]\">\n"
 	" <html>\n"
 	" <head>\n"
 	" <script type=\"text/javascript\" src=\"https://ajax.googleapis.com/ajax/libs/jquery/3.4.1/jquery.min.js\"></script>\n"
@@ -895,6 +895,8 @@ static char xslmsg[] =
 	" <th>References</th>\n"
 	" <th>LocalAddress</th>\n"
 	" <th>PeerAddress</th>\n"
+	" <th>Received</th>\n"
+	" <th>Sent</th>\n"
 	" <th>State</th>\n"
 	" </tr>\n"
 	" <xsl:for-each select=\"socketmgr/sockets/socket\">\n"
@@ -925,6 +927,12 @@ static char xslmsg[] =
 	" <xsl:value-of select=\"peer-address\"/>\n"
 	" </td>\n"
 	" <td>\n"
+	" <xsl:value-of select=\"received\"/>\n"
+	" </td>\n"
+	" <td>\n"
+	" <xsl:value-of select=\"sent\"/>\n"
+	" </td>\n"
+	" <td>\n"
 	" <xsl:for-each select=\"states\">\n"
 	" <xsl:value-of select=\".\"/>\n"
 	" </xsl:for-each>\n"
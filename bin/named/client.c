@@ -49,6 +49,7 @@
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>
 #include <dns/view.h>
@@ -1123,6 +1124,29 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 	return (result);
 }
 
+/*
+ * Count a response of 'respsize' octets in the response size histograms.
+ */
+static void
+client_sizestats(ns_client_t *client, size_t respsize) {
+	isc_stats_t *stats;
+
+	switch (isc_sockaddr_pf(&client->peeraddr)) {
+	case AF_INET:
+		stats = TCP_CLIENT(client) ? ns_g_server->tcpoutstats4
+					   : ns_g_server->udpoutstats4;
+		break;
+	case AF_INET6:
+		stats = TCP_CLIENT(client) ? ns_g_server->tcpoutstats6
+					   : ns_g_server->udpoutstats6;
+		break;
+	default:
+		INSIST(0);
+		ISC_UNREACHABLE();
+	}
+	isc_stats_increment(stats, ISC_MIN((int)respsize / 16, 256));
+}
+
 void
 ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	isc_result_t result;
@@ -1169,6 +1193,225 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	ns_client_next(client, result);
 }
 
+/*
+ * Build the response cache key of the current query.
+ */
+static void
+client_respcachekey(ns_client_t *client, dns_respcachekey_t *key) {
+	key->qname = client->query.origqname;
+	key->qtype = client->query.qtype;
+	key->qclass = client->message->rdclass;
+	key->flags = client->query.respcacheflags;
+}
+
+/*
+ * Can the response that has just been rendered be sent to any other
+ * client asking the same question?  Only complete authoritative
+ * answers from a single zone, which no ACL, rewriting or rate
+ * limiting has had a say in, qualify.
+ */
+static bool
+client_respcacheable(ns_client_t *client) {
+	dns_message_t *message = client->message;
+
+	if (client->view == NULL || client->view->respcache == NULL ||
+	    !client->query.respcacheok)
+		return (false);
+
+	if (message->opcode != dns_opcode_query ||
+	    (message->rcode != dns_rcode_noerror &&
+	     message->rcode != dns_rcode_nxdomain) ||
+	    (message->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    message->tsigkey != NULL || message->sig0key != NULL)
+		return (false);
+
+	if (client->query.authzone == NULL || client->query.restarts != 0 ||
+	    (client->query.attributes & (NS_QUERYATTR_CACHEACLOK |
+					 NS_QUERYATTR_DNS64 |
+					 NS_QUERYATTR_DNS64EXCLUDE |
+					 NS_QUERYATTR_REDIRECT |
+					 NS_QUERYATTR_NORESPCACHE)) != 0)
+		return (false);
+
+	if ((client->attributes & (NS_CLIENTATTR_RA |
+				   NS_CLIENTATTR_HAVEEXPIRE)) != 0)
+		return (false);
+#ifdef ALLOW_FILTER_AAAA
+	if ((client->attributes & NS_CLIENTATTR_FILTER_AAAA) != 0)
+		return (false);
+#endif
+
+	return (true);
+}
+
+/*
+ * Add the response in 'buffer' to the view's response cache.  Only the
+ * first 'bodylen' octets are cached: everything after them (the OPT
+ * record, if 'opt_included') is generated anew for each client.
+ */
+static void
+client_respcacheadd(ns_client_t *client, isc_buffer_t *buffer,
+		    unsigned int bodylen, bool opt_included)
+{
+	dns_respcachekey_t key;
+	unsigned char *base = isc_buffer_base(buffer);
+	unsigned char arcount[2];
+	isc_region_t r;
+	uint16_t count;
+
+	client_respcachekey(client, &key);
+
+	/*
+	 * Take the OPT record out of the additional count while the
+	 * response is copied.
+	 */
+	memmove(arcount, base + 10, 2);
+	if (opt_included) {
+		count = ((base[10] << 8) | base[11]) - 1;
+		base[10] = (count >> 8) & 0xff;
+		base[11] = count & 0xff;
+	}
+
+	r.base = base;
+	r.length = bodylen;
+	(void)dns_respcache_add(client->view->respcache,
+				&client->query.respcachedeps, &key, &r);
+
+	memmove(base + 10, arcount, 2);
+}
+
+isc_result_t
+ns_client_sendcached(ns_client_t *client) {
+	isc_result_t result;
+	unsigned char *data;
+	isc_buffer_t buffer;
+	isc_buffer_t tcpbuffer;
+	isc_region_t r;
+	dns_respcachekey_t key;
+	dns_rdataset_t *opt = NULL;
+	dns_compress_t cctx;
+	unsigned char sendbuf[SEND_BUFFER_SIZE];
+	unsigned int count, flags;
+	uint16_t ancount, arcount;
+	dns_rcode_t rcode;
+	size_t respsize;
+	isc_statscounter_t counter;
+#ifdef HAVE_DNSTAP
+	dns_dtmsgtype_t dtmsgtype;
+	isc_region_t zr;
+#endif /* HAVE_DNSTAP */
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(client->query.respcacheok);
+
+	result = client_allocsendbuf(client, &buffer, &tcpbuffer, 0,
+				     sendbuf, &data);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	client_respcachekey(client, &key);
+	result = dns_respcache_get(client->view->respcache, &key, &buffer);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	CTRACE("sendcached");
+
+	/*
+	 * Patch in the id, and add our OPT record.
+	 */
+	isc_buffer_usedregion(&buffer, &r);
+	r.base[0] = (client->message->id >> 8) & 0xff;
+	r.base[1] = client->message->id & 0xff;
+	flags = (r.base[2] << 8) | r.base[3];
+	ancount = (r.base[6] << 8) | r.base[7];
+	arcount = (r.base[10] << 8) | r.base[11];
+	rcode = flags & 0x000f;
+
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		result = ns_client_addopt(client, client->message, &opt);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		result = dns_compress_init(&cctx, -1, client->mctx);
+		if (result == ISC_R_SUCCESS) {
+			count = 0;
+			result = dns_rdataset_towire(opt, dns_rootname, &cctx,
+						     &buffer, 0, &count);
+			dns_compress_invalidate(&cctx);
+		}
+		dns_rdataset_disassociate(opt);
+		dns_message_puttemprdataset(client->message, &opt);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		arcount++;
+		r.base[10] = (arcount >> 8) & 0xff;
+		r.base[11] = arcount & 0xff;
+	}
+
+#ifdef HAVE_DNSTAP
+	memset(&zr, 0, sizeof(zr));
+	if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0)
+		dtmsgtype = DNS_DTTYPE_CR;
+	else
+		dtmsgtype = DNS_DTTYPE_AR;
+	dns_dt_send(client->view, dtmsgtype, &client->peeraddr,
+		    &client->destsockaddr, TCP_CLIENT(client), &zr,
+		    &client->requesttime, NULL, &buffer);
+#endif /* HAVE_DNSTAP */
+
+	respsize = isc_buffer_usedlength(&buffer);
+	if (TCP_CLIENT(client)) {
+		isc_buffer_putuint16(&tcpbuffer, (uint16_t)respsize);
+		isc_buffer_add(&tcpbuffer, (unsigned int)respsize);
+		result = client_sendpkg(client, &tcpbuffer);
+	} else
+		result = client_sendpkg(client, &buffer);
+	client_sizestats(client, respsize);
+
+	/*
+	 * Count the response the way query_send() and client_send()
+	 * would have.
+	 */
+	if ((flags & DNS_MESSAGEFLAG_AA) != 0)
+		counter = dns_nsstatscounter_authans;
+	else
+		counter = dns_nsstatscounter_nonauthans;
+	isc_stats_increment(ns_g_server->nsstats, counter);
+	if (rcode == dns_rcode_nxdomain)
+		counter = dns_nsstatscounter_nxdomain;
+	else if (ancount != 0)
+		counter = dns_nsstatscounter_success;
+	else if ((flags & DNS_MESSAGEFLAG_AA) == 0)
+		counter = dns_nsstatscounter_referral;
+	else
+		counter = dns_nsstatscounter_nxrrset;
+	isc_stats_increment(ns_g_server->nsstats, counter);
+	isc_stats_increment(ns_g_server->nsstats,
+			    dns_nsstatscounter_respcachehit);
+	isc_stats_increment(ns_g_server->nsstats, dns_nsstatscounter_response);
+	dns_rcodestats_increment(ns_g_server->rcodestats, rcode);
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_edns0out);
+	}
+
+	if (result == ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+
+	if (client->tcpbuf != NULL) {
+		isc_mem_put(client->mctx, client->tcpbuf, TCP_BUFFER_SIZE);
+		client->tcpbuf = NULL;
+	}
+	ns_client_next(client, result);
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	if (client->tcpbuf != NULL) {
+		isc_mem_put(client->mctx, client->tcpbuf, TCP_BUFFER_SIZE);
+		client->tcpbuf = NULL;
+	}
+	return (result);
+}
+
 static void
 client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -1182,6 +1425,9 @@ client_send(ns_client_t *client) {
 	unsigned int render_opts;
 	unsigned int preferred_glue;
 	bool opt_included = false;
+	bool casesensitive = false;
+	bool complete = true;
+	unsigned int bodylen;
 	size_t respsize;
 #ifdef HAVE_DNSTAP
 	unsigned char zone[DNS_NAME_MAXWIRE];
@@ -1269,6 +1515,7 @@ client_send(ns_client_t *client) {
 			     client->view->nocasecompress))
 		{
 			dns_compress_setsensitive(&cctx, true);
+			casesensitive = true;
 		}
 
 		if (client->view->msgcompression == false) {
@@ -1324,14 +1571,20 @@ client_send(ns_client_t *client) {
 	result = dns_message_rendersection(client->message,
 					   DNS_SECTION_ADDITIONAL,
 					   preferred_glue | render_opts);
-	if (result != ISC_R_SUCCESS && result != ISC_R_NOSPACE)
+	if (result == ISC_R_NOSPACE)
+		complete = false;
+	else if (result != ISC_R_SUCCESS)
 		goto done;
  renderend:
+	bodylen = isc_buffer_usedlength(&buffer);
 	result = dns_message_renderend(client->message);
 
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
+	if (complete && casesensitive && client_respcacheable(client))
+		client_respcacheadd(client, &buffer, bodylen, opt_included);
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
@@ -1375,20 +1628,7 @@ client_send(ns_client_t *client) {
 		/* don't count the 2-octet length header */
 		respsize = isc_buffer_usedlength(&tcpbuffer) - 2;
 		result = client_sendpkg(client, &tcpbuffer);
-
-		switch (isc_sockaddr_pf(&client->peeraddr)) {
-		case AF_INET:
-			isc_stats_increment(ns_g_server->tcpoutstats4,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		case AF_INET6:
-			isc_stats_increment(ns_g_server->tcpoutstats6,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		default:
-			INSIST(0);
-			ISC_UNREACHABLE();
-		}
+		client_sizestats(client, respsize);
 	} else {
 		respsize = isc_buffer_usedlength(&buffer);
 		result = client_sendpkg(client, &buffer);
@@ -1401,20 +1641,7 @@ client_send(ns_client_t *client) {
 				    &client->requesttime, NULL, &buffer);
 		}
 #endif /* HAVE_DNSTAP */
-
-		switch (isc_sockaddr_pf(&client->peeraddr)) {
-		case AF_INET:
-			isc_stats_increment(ns_g_server->udpoutstats4,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		case AF_INET6:
-			isc_stats_increment(ns_g_server->udpoutstats6,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		default:
-			INSIST(0);
-			ISC_UNREACHABLE();
-		}
+		client_sizestats(client, respsize);
 	}
 
 	/* update statistics (XXXJT: is it okay to access message->xxxkey?) */
@@ -3208,7 +3435,7 @@ get_clientmctx(ns_clientmgr_t *manager, isc_mem_t **mctxp) {
 }
 
 static isc_result_t
-client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
+client_create(ns_clientmgr_t *manager, int threadid, ns_client_t **clientp) {
 	ns_client_t *client;
 	isc_result_t result;
 	isc_mem_t *mctx = NULL;
@@ -3219,6 +3446,9 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 	 * Note: creating a client does not add the client to the
 	 * manager's client list or set the client's manager pointer.
 	 * The caller is responsible for that.
+	 *
+	 * If 'threadid' is not negative, the client's task is bound to
+	 * that task manager worker.
 	 */
 
 	REQUIRE(clientp != NULL && *clientp == NULL);
@@ -3235,7 +3465,8 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 	client->mctx = mctx;
 
 	client->task = NULL;
-	result = isc_task_create(manager->taskmgr, 0, &client->task);
+	result = isc_task_create_bound(manager->taskmgr, 0, &client->task,
+				       threadid);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_client;
 	isc_task_setname(client->task, "client", client);
@@ -3860,6 +4091,8 @@ get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_event_t *ev;
 	ns_client_t *client;
+	int threadid = -1;
+	int i;
 	MTRACE("get client");
 
 	REQUIRE(manager != NULL);
@@ -3880,8 +4113,19 @@ get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
 	else {
 		MTRACE("create new");
 
+		/*
+		 * Keep UDP clients listening on the same dispatch on
+		 * the same worker thread.
+		 */
+		for (i = 0; !tcp && i < ifp->nudpdispatch; i++) {
+			if (ifp->udpdispatch[i] == disp) {
+				threadid = i;
+				break;
+			}
+		}
+
 		LOCK(&manager->lock);
-		result = client_create(manager, &client);
+		result = client_create(manager, threadid, &client);
 		UNLOCK(&manager->lock);
 		if (result != ISC_R_SUCCESS)
 			return (result);
@@ -3950,7 +4194,7 @@ get_worker(ns_clientmgr_t *manager, ns_interface_t *ifp, isc_socket_t *sock,
 		MTRACE("create new");
 
 		LOCK(&manager->lock);
-		result = client_create(manager, &client);
+		result = client_create(manager, -1, &client);
 		UNLOCK(&manager->lock);
 		if (result != ISC_R_SUCCESS)
 			return (result);
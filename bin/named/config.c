@@ -51,7 +51,8 @@ options {\n\
 	answer-cookie true;\n\
 	automatic-interface-scan yes;\n\
 	bindkeys-file \"" NS_SYSCONFDIR "/bind.keys\";\n\
-#	blackhole {none;};\n"
+#	blackhole {none;};\n\
+	cache-node-locks 0;\n"
 #if defined(HAVE_OPENSSL_AES) || defined(HAVE_OPENSSL_EVP_AES)
 "	cookie-algorithm aes;\n"
 #else
@@ -65,6 +66,7 @@ options {\n\
 #	deallocate-on-exit <obsolete>;\n\
 #	directory <none>\n\
 	dump-file \"named_dump.db\";\n\
+	dump-rate unlimited;\n\
 	edns-udp-size 4096;\n\
 #	fake-iquery <obsolete>;\n"
 #ifndef WIN32
@@ -105,6 +107,7 @@ options {\n\
 	request-nsid false;\n\
 	reserved-sockets 512;\n\
 	resolver-query-timeout 10;\n\
+	reuseport no;\n\
 	rrset-order { order random; };\n\
 	secroots-file \"named.secroots\";\n\
 	send-cookie true;\n\
@@ -117,7 +120,8 @@ options {\n\
 #ifndef WIN32
 "	stacksize default;\n"
 #endif
-"	startup-notify-rate 20;\n\
+"	startup-load-order size;\n\
+	startup-notify-rate 20;\n\
 	statistics-file \"named.stats\";\n\
 #	statistics-interval <obsolete>;\n\
 	tcp-clients 150;\n\
@@ -133,6 +137,7 @@ options {\n\
 	trust-anchor-telemetry yes;\n\
 #	use-id-pool <obsolete>;\n\
 #	use-ixfr <obsolete>;\n\
+	zone-node-locks 0;\n\
 \n\
 	/* view */\n\
 	acache-cleaning-interval 60;\n\
@@ -163,6 +168,7 @@ options {\n\
 "	dnstap-identity hostname;\n"
 #endif
 "\
+	expected-cache-names 0;\n\
 #	fetch-glue <obsolete>;\n\
 	fetch-quota-params 100 0.1 0.3 0.7;\n\
 	fetches-per-server 0;\n\
@@ -200,6 +206,7 @@ options {\n\
 	request-expire true;\n\
 	request-ixfr true;\n\
 	require-server-cookie no;\n\
+	response-cache-entries 0;\n\
 #	rfc2308-type1 <obsolete>;\n\
 	root-key-sentinel yes;\n\
 	servfail-ttl 1;\n\
@@ -207,6 +214,7 @@ options {\n\
 #	topology <none>\n\
 	transfer-format many-answers;\n\
 	v6-bias 50;\n\
+	verify-cache-size 1M;\n\
 	zero-no-soa-ttl-cache no;\n\
 \n\
 	/* zone */\n\
@@ -226,6 +234,8 @@ options {\n\
 	dnssec-loadkeys-interval 60;\n\
 	dnssec-secure-to-insecure no;\n\
 	dnssec-update-mode maintain;\n\
+	dump-journal-ratio 0;\n\
+	expected-names 0;\n\
 #	forward <none>\n\
 #	forwarders <none>\n\
 	inline-signing no;\n\
@@ -259,6 +259,8 @@ ns_control_docommand(isccc_sexpr_t *message, bool readonly,
 		result = ns_server_signing(ns_g_server, lex, text);
 	} else if (command_compare(command, NS_COMMAND_SHOWZONE)) {
 		result = ns_server_showzone(ns_g_server, lex, text);
+	} else if (command_compare(command, NS_COMMAND_SNAPSHOT)) {
+		result = ns_server_snapshot(ns_g_server, lex, text);
 	} else if (command_compare(command, NS_COMMAND_STATUS)) {
 		result = ns_server_status(ns_g_server, text);
 	} else if (command_compare(command, NS_COMMAND_SYNC)) {
@@ -38,6 +38,7 @@
  * \code
  *   ns_client_send()	(sending a non-error response)
  *   ns_client_sendraw() (sending a raw response)
+ *   ns_client_sendcached() (sending a cached response)
  *   ns_client_error()	(sending an error response)
  *   ns_client_next()	(sending no response)
  *\endcode
@@ -243,6 +244,24 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client);
+/*%
+ * Look up the response to the current query in the view's response
+ * cache and, if there is one that fits, send it with the query's id
+ * and a fresh OPT record.
+ *
+ * Requires:
+ *\li	client->query.respcacheok is true.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS	the request has been dealt with; the response
+ *			was sent, or sending it failed and the client
+ *			has moved on to the next request.
+ *\li	Other results	the request was not answered; the caller
+ *			must continue processing it.
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%
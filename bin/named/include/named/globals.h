@@ -159,6 +159,7 @@ EXTERN const char *		ns_g_engine		INIT(NULL);
 #endif
 
 EXTERN int			ns_g_listen		INIT(3);
+EXTERN bool			ns_g_reuseport		INIT(false);
 EXTERN isc_time_t		ns_g_boottime;
 EXTERN isc_time_t		ns_g_configtime;
 EXTERN bool			ns_g_memstatistics	INIT(false);
@@ -21,6 +21,7 @@
 #include <isc/netaddr.h>
 
 #include <dns/rdataset.h>
+#include <dns/respcache.h>
 #include <dns/rpz.h>
 #include <dns/types.h>
 
@@ -50,6 +51,9 @@ struct ns_query {
 	dns_zone_t *			authzone;
 	bool			authdbset;
 	bool			isreferral;
+	bool			respcacheok;
+	dns_respcachedeps_t		respcachedeps;
+	unsigned int			respcacheflags;
 	isc_mutex_t			fetchlock;
 	dns_fetch_t *			fetch;
 	dns_fetch_t *			prefetch;
@@ -99,6 +103,7 @@ struct ns_query {
 #define NS_QUERYATTR_DNS64EXCLUDE	0x8000
 #define NS_QUERYATTR_RRL_CHECKED	0x10000
 #define NS_QUERYATTR_REDIRECT		0x20000
+#define NS_QUERYATTR_NORESPCACHE	0x40000
 
 isc_result_t
 ns_query_init(ns_client_t *client);
@@ -78,6 +78,7 @@ struct ns_server {
 	ns_interfacemgr_t *	interfacemgr;
 	dns_db_t *		in_roothints;
 	dns_tkeyctx_t *		tkeyctx;
+	dns_cryptopool_t *	cryptopool;	/*%< DNSSEC crypto threads */
 
 	isc_timer_t *		interface_timer;
 	isc_timer_t *		heartbeat_timer;
@@ -224,7 +225,9 @@ enum {
 
 	dns_nsstatscounter_reclimitdropped = 58,
 
-	dns_nsstatscounter_max = 59
+	dns_nsstatscounter_respcachehit = 59,
+
+	dns_nsstatscounter_max = 60
 };
 
 /*%
@@ -617,6 +620,12 @@ ns_server_dumpstats(ns_server_t *server);
 isc_result_t
 ns_server_dumpdb(ns_server_t *server, isc_lex_t *lex, isc_buffer_t **text);
 
+/*%
+ * Write the cache snapshot of the given views, or of all caches.
+ */
+isc_result_t
+ns_server_snapshot(ns_server_t *server, isc_lex_t *lex, isc_buffer_t **text);
+
 /*%
  * Dump the current security roots to the secroots file.
  */
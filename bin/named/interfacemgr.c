@@ -52,8 +52,10 @@
 
 #ifdef TUNE_LARGE
 #define UDPBUFFERS 32768
+#define UDPLISTENERS 8
 #else
 #define UDPBUFFERS 1000
+#define UDPLISTENERS 4
 #endif /* TUNE_LARGE */
 
 #define IFMGR_MAGIC			ISC_MAGIC('I', 'F', 'M', 'G')
@@ -414,6 +416,19 @@ ns_interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr,
 	return (ISC_R_UNEXPECTED);
 }
 
+static isc_result_t
+getudpdispatch(ns_interface_t *ifp, unsigned int attrs, unsigned int attrmask,
+	       int disp)
+{
+	return (dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
+					ns_g_socketmgr, ns_g_taskmgr,
+					&ifp->addr, 4096, UDPBUFFERS,
+					32768, 8219, 8237, attrs, attrmask,
+					&ifp->udpdispatch[disp],
+					disp == 0 ? NULL
+						  : ifp->udpdispatch[0]));
+}
+
 static isc_result_t
 ns_interface_listenudp(ns_interface_t *ifp) {
 	isc_result_t result;
@@ -432,18 +447,29 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	attrmask |= DNS_DISPATCHATTR_UDP | DNS_DISPATCHATTR_TCP;
 	attrmask |= DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_IPV6;
 
+	/*
+	 * With "reuseport yes;" every dispatch gets its own socket bound
+	 * with SO_REUSEPORT so the kernel spreads queries across them;
+	 * otherwise the dispatches share duplicates of a single socket.
+	 */
+	if (ns_g_reuseport)
+		attrs |= DNS_DISPATCHATTR_REUSEPORT;
+
 	ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
 	for (disp = 0; disp < ifp->nudpdispatch; disp++) {
-		result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
-						 ns_g_socketmgr,
-						 ns_g_taskmgr, &ifp->addr,
-						 4096, UDPBUFFERS,
-						 32768, 8219, 8237,
-						 attrs, attrmask,
-						 &ifp->udpdispatch[disp],
-						 disp == 0
-						    ? NULL
-						    : ifp->udpdispatch[0]);
+		result = getudpdispatch(ifp, attrs, attrmask, disp);
+		if (result == ISC_R_NOTIMPLEMENTED && disp == 0 &&
+		    (attrs & DNS_DISPATCHATTR_REUSEPORT) != 0)
+		{
+			/*
+			 * Fall back to duplicates of a single socket.
+			 */
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_WARNING,
+				      "SO_REUSEPORT is not supported, "
+				      "using a shared UDP socket");
+			attrs &= ~DNS_DISPATCHATTR_REUSEPORT;
+			result = getudpdispatch(ifp, attrs, attrmask, disp);
+		}
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				      "could not listen on UDP socket: %s",
@@ -451,15 +477,32 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 			goto udp_dispatch_failure;
 		}
 
+		if ((attrs & DNS_DISPATCHATTR_REUSEPORT) != 0) {
+			char name[16];
+
+			snprintf(name, sizeof(name), "udp-shard%u",
+				 (unsigned int)disp % MAX_UDP_DISPATCH);
+			isc_socket_setname(
+				dns_dispatch_getsocket(ifp->udpdispatch[disp]),
+				name, NULL);
+		}
 	}
 
-	result = ns_clientmgr_createclients(ifp->clientmgr, ifp->nudpdispatch,
-					    ifp, false);
-	if (result != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "UDP ns_clientmgr_createclients(): %s",
-				 isc_result_totext(result));
-		goto addtodispatch_failure;
+	/*
+	 * Keep several clients listening on each UDP dispatch, so that
+	 * datagrams arriving together are read by one batched receive
+	 * and handled in parallel.
+	 */
+	for (i = 0; i < UDPLISTENERS; i++) {
+		result = ns_clientmgr_createclients(ifp->clientmgr,
+						    ifp->nudpdispatch,
+						    ifp, false);
+		if (result != ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "UDP ns_clientmgr_createclients(): %s",
+					 isc_result_totext(result));
+			goto addtodispatch_failure;
+		}
 	}
 
 	return (ISC_R_SUCCESS);
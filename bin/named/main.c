@@ -899,7 +899,12 @@ create_managers(void) {
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_socketmgr_create2(ns_g_mctx, &ns_g_socketmgr, maxsocks);
+	/*
+	 * Run one socket event loop per worker thread so that readiness
+	 * notifications are not funneled through a single watcher.
+	 */
+	result = isc_socketmgr_create3(ns_g_mctx, &ns_g_socketmgr, maxsocks,
+				       ns_g_cpus);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socketmgr_create() failed: %s",
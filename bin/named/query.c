@@ -47,6 +47,7 @@
 #include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -467,6 +468,7 @@ query_reset(ns_client_t *client, bool everything) {
 	client->query.gluedb = NULL;
 	client->query.authdbset = false;
 	client->query.isreferral = false;
+	client->query.respcacheok = false;
 	client->query.dns64_options = 0;
 	client->query.dns64_ttl = UINT32_MAX;
 	client->query.root_key_sentinel_keyid = 0;
@@ -850,6 +852,12 @@ query_validatezonedb(ns_client_t *client, dns_name_t *name,
 		}
 	}
 
+	/*
+	 * Responses that depend on who asked must not be cached.
+	 */
+	if (queryacl != NULL && !dns_acl_isany(queryacl))
+		client->query.attributes |= NS_QUERYATTR_NORESPCACHE;
+
 	result = ns_client_checkaclsilent(client, NULL, queryacl, true);
 	if ((options & DNS_GETDB_NOLOG) == 0) {
 		char msg[NS_CLIENT_ACLMSGSIZE("query")];
@@ -895,6 +903,8 @@ query_validatezonedb(ns_client_t *client, dns_name_t *name,
 		queryonacl = dns_zone_getqueryonacl(zone);
 		if (queryonacl == NULL)
 			queryonacl = client->view->queryonacl;
+		if (queryonacl != NULL && !dns_acl_isany(queryonacl))
+			client->query.attributes |= NS_QUERYATTR_NORESPCACHE;
 
 		result = ns_client_checkaclsilent(client, &client->destaddr,
 						  queryonacl, true);
@@ -944,12 +954,29 @@ query_getzonedb(ns_client_t *client, dns_name_t *name, dns_rdatatype_t qtype,
 
 	if (result == DNS_R_PARTIALMATCH)
 		partial = true;
-	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH)
+	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
+		if (client->query.respcacheok)
+			dns_respcache_adddep(&client->query.respcachedeps,
+					     zone);
 		result = dns_zone_getdb(zone, &db);
+	}
 
 	if (result != ISC_R_SUCCESS)
 		goto fail;
 
+	/*
+	 * Note the database before a version of it is opened.  Data
+	 * kept outside the server (sdb, dyndb) can change without a new
+	 * version, so responses built from it are not cached.
+	 */
+	if (client->query.respcacheok) {
+		if (dns_db_ispersistent(db))
+			client->query.respcacheok = false;
+		else
+			dns_respcache_adddep(&client->query.respcachedeps,
+					     db);
+	}
+
 	result = query_validatezonedb(client, name, qtype, options, zone, db,
 				      versionp);
 
@@ -3276,9 +3303,9 @@ verify(dst_key_t *key, dns_name_t *name, dns_rdataset_t *rdataset,
 	dns_fixedname_init(&fixed);
 
 again:
-	result = dns_dnssec_verify3(name, rdataset, key, ignore,
+	result = dns_dnssec_verify4(name, rdataset, key, ignore,
 				    client->view->maxbits, client->mctx,
-				    rdata, NULL);
+				    rdata, NULL, client->view->verifycache);
 	if (result == DNS_R_SIGEXPIRED && client->view->acceptexpired) {
 		ignore = true;
 		goto again;
@@ -9428,6 +9455,45 @@ log_queryerror(ns_client_t *client, isc_result_t result, int line, int level) {
 		      classp, sep2, typep, __FILE__, line);
 }
 
+/*
+ * If the view has a response cache and the response to this query
+ * can be shared with other clients, remember how to cache it and try
+ * to answer from the cache.  Returns true if the query was answered.
+ */
+static bool
+query_respcache(ns_client_t *client) {
+	unsigned int flags;
+
+	if (client->view->respcache == NULL || ns_g_delay != 0 ||
+	    client->signer != NULL || client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL ||
+	    (client->attributes & NS_CLIENTATTR_WANTEXPIRE) != 0)
+	{
+		return (false);
+	}
+
+	/*
+	 * Everything in the request that can change the response:
+	 * RD, CD and AD, DO, and the minimal-responses decisions, none
+	 * of which overlap as bit values.
+	 */
+	flags = client->message->flags & (DNS_MESSAGEFLAG_RD |
+					  DNS_MESSAGEFLAG_CD |
+					  DNS_MESSAGEFLAG_AD);
+	flags |= client->query.attributes & (NS_QUERYATTR_NOAUTHORITY |
+					     NS_QUERYATTR_NOADDITIONAL);
+	if (WANTDNSSEC(client))
+		flags |= DNS_MESSAGEEXTFLAG_DO << 16;
+
+	client->query.respcacheok = true;
+	dns_respcache_initdeps(&client->query.respcachedeps);
+	dns_respcache_adddep(&client->query.respcachedeps,
+			     client->view->zonetable);
+	client->query.respcacheflags = flags;
+
+	return (ns_client_sendcached(client) == ISC_R_SUCCESS);
+}
+
 void
 ns_query_start(ns_client_t *client) {
 	isc_result_t result;
@@ -9670,6 +9736,9 @@ ns_query_start(ns_client_t *client) {
 	if (WANTDNSSEC(client) || WANTAD(client))
 		message->flags |= DNS_MESSAGEFLAG_AD;
 
+	if (query_respcache(client))
+		return;
+
 	qclient = NULL;
 	ns_client_attach(client, &qclient);
 	(void)query_find(qclient, NULL, qtype);
@@ -63,6 +63,7 @@
 #include <dns/badcache.h>
 #include <dns/cache.h>
 #include <dns/catz.h>
+#include <dns/cryptopool.h>
 #include <dns/db.h>
 #include <dns/dispatch.h>
 #include <dns/dlz.h>
@@ -89,6 +90,7 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/rootns.h>
 #include <dns/rriterator.h>
 #include <dns/secalg.h>
@@ -97,6 +99,7 @@
 #include <dns/tkey.h>
 #include <dns/tsig.h>
 #include <dns/ttl.h>
+#include <dns/verifycache.h>
 #include <dns/view.h>
 #include <dns/zone.h>
 #include <dns/zt.h>
@@ -145,12 +148,20 @@
 #define SIZE_AS_PERCENT ((size_t)-2)
 #endif
 
+/*%
+ * Resolver fetch contexts are hashed into buckets, each with its own
+ * lock and task.  Use at least RESOLVER_NTASKS of them, and more on
+ * machines with many worker threads so that contention on the bucket
+ * locks does not grow with the thread count.
+ */
 #ifdef TUNE_LARGE
 #define RESOLVER_NTASKS 523
+#define RESOLVER_NTASKS_PERCPU 64
 #define UDPBUFFERS 32768
 #define EXCLBUFFERS 32768
 #else
 #define RESOLVER_NTASKS 31
+#define RESOLVER_NTASKS_PERCPU 8
 #define UDPBUFFERS 1000
 #define EXCLBUFFERS 4096
 #endif /* TUNE_LARGE */
@@ -3289,6 +3300,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	size_t max_acache_size;
 	size_t max_adb_size;
 	uint32_t lame_ttl, fail_ttl;
+	uint64_t verify_cache_size;
 	dns_tsig_keyring_t *ring = NULL;
 	dns_view_t *pview = NULL;	/* Production view */
 	isc_mem_t *cmctx = NULL, *hmctx = NULL;
@@ -3313,7 +3325,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	ns_cache_t *nsc;
 	bool zero_no_soattl;
 	dns_acl_t *clients = NULL, *mapped = NULL, *excluded = NULL;
-	unsigned int query_timeout, ndisp;
+	unsigned int query_timeout, ndisp, nbuckets;
 	bool old_rpz_ok = false;
 	isc_dscp_t dscp4 = -1, dscp6 = -1;
 	dns_dyndbctx_t *dctx = NULL;
@@ -3864,6 +3876,42 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	dns_cache_setcleaninginterval(cache, cleaning_interval);
 	dns_cache_setcachesize(cache, max_cache_size);
 
+	obj = NULL;
+	result = ns_config_get(maps, "expected-cache-names", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_cache_setexpectednames(cache, cfg_obj_asuint32(obj));
+
+	/*
+	 * Pre-warm a new cache from its snapshot.  The snapshot is loaded
+	 * incrementally in the server task, so the load gets under way
+	 * before the listeners are opened without holding up the rest of
+	 * startup; queries that arrive first are simply resolved.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "cache-snapshot", &obj);
+	if (result == ISC_R_SUCCESS && strcmp(view->name, "_bind") != 0) {
+		CHECK(dns_cache_setsnapshot(cache, cfg_obj_asstring(obj)));
+		if (!reused_cache && !shared_cache) {
+			result = dns_cache_loadsnapshot(cache,
+							ns_g_server->task);
+			if (result != ISC_R_SUCCESS &&
+			    result != DNS_R_CONTINUE)
+			{
+				isc_log_write(ns_g_lctx,
+					      NS_LOGCATEGORY_GENERAL,
+					      NS_LOGMODULE_SERVER,
+					      ISC_LOG_WARNING,
+					      "view '%s': could not load "
+					      "cache snapshot '%s': %s",
+					      view->name,
+					      cfg_obj_asstring(obj),
+					      isc_result_totext(result));
+			}
+		}
+	} else if (!shared_cache) {
+		CHECK(dns_cache_setsnapshot(cache, NULL));
+	}
+
 	dns_cache_detach(&cache);
 
 	/*
@@ -3895,7 +3943,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	dns_view_setresquerystats(view, resquerystats);
 
 	ndisp = 4 * ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
-	CHECK(dns_view_createresolver(view, ns_g_taskmgr, RESOLVER_NTASKS,
+	nbuckets = ISC_MAX(RESOLVER_NTASKS, ns_g_cpus * RESOLVER_NTASKS_PERCPU);
+	CHECK(dns_view_createresolver(view, ns_g_taskmgr, nbuckets,
 				      ndisp, ns_g_socketmgr, ns_g_timermgr,
 				      resopts, ns_g_dispatchmgr,
 				      dispatch4, dispatch6));
@@ -4939,6 +4988,25 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 		fail_ttl = 30;
 	dns_view_setfailttl(view, fail_ttl);
 
+	/*
+	 * Set the size of the signature verification cache.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "verify-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	verify_cache_size = cfg_obj_asuint64(obj);
+	if (verify_cache_size > SIZE_MAX) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "'verify-cache-size %" PRIu64 "' "
+			    "is too large for this system; reducing to %lu",
+			    verify_cache_size, (unsigned long)SIZE_MAX);
+		verify_cache_size = SIZE_MAX;
+	}
+	dns_verifycache_setmaxsize(view->verifycache,
+				   (size_t)verify_cache_size);
+
+	dns_view_setcryptopool(view, ns_g_server->cryptopool);
+
 	/*
 	 * Name space to look up redirect information in.
 	 */
@@ -4960,6 +5028,44 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	CHECK(configure_dnstap(maps, view));
 #endif /* HAVE_DNSTAP */
 
+	/*
+	 * Cache rendered responses, unless something in the view can
+	 * make the response to a question differ between clients.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "response-cache-entries", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asuint32(obj) > 0) {
+		const char *conflict = NULL;
+
+		if (view->recursion)
+			conflict = "recursion";
+		else if (view->rrl != NULL)
+			conflict = "rate-limit";
+		else if (view->rpzs != NULL)
+			conflict = "response-policy";
+		else if (view->dns64cnt != 0)
+			conflict = "dns64";
+		else if (view->sortlist != NULL)
+			conflict = "sortlist";
+		else if (!ISC_LIST_EMPTY(view->dlz_searched))
+			conflict = "dlz";
+		else if (view->acache != NULL)
+			conflict = "acache-enable";
+
+		if (conflict != NULL) {
+			isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+				      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+				      "view '%s': response-cache-entries "
+				      "ignored because of %s",
+				      view->name, conflict);
+		} else {
+			CHECK(dns_respcache_create(view->mctx,
+						   cfg_obj_asuint32(obj),
+						   &view->respcache));
+		}
+	}
+
 	result = ISC_R_SUCCESS;
 
  cleanup:
@@ -7449,6 +7555,8 @@ load_configuration(const char *filename, ns_server_t *server,
 	uint32_t reserved;
 	uint32_t udpsize;
 	uint32_t transfer_message_size;
+	uint32_t loadlimit;
+	uint32_t dump_rate;
 	ns_cache_t *nsc;
 	ns_cachelist_t cachelist, tmpcachelist;
 	ns_altsecret_t *altsecret;
@@ -7636,6 +7744,43 @@ load_configuration(const char *filename, ns_server_t *server,
 	}
 	isc__socketmgr_setreserved(ns_g_socketmgr, reserved);
 
+	/*
+	 * Start the threads that verify DNSSEC signatures for the
+	 * validators and sign the zones that are being signed
+	 * incrementally.  The number of threads can only be set at startup.
+	 */
+	if (first_time) {
+		unsigned int cryptothreads = ns_g_cpus;
+
+		obj = NULL;
+		result = ns_config_get(maps, "crypto-threads", &obj);
+		if (result == ISC_R_SUCCESS)
+			cryptothreads = cfg_obj_asuint32(obj);
+		if (cryptothreads != 0) {
+			result = dns_cryptopool_create(ns_g_mctx, cryptothreads,
+						       &server->cryptopool);
+			if (result == ISC_R_SUCCESS) {
+				dns_zonemgr_setcryptopool(server->zonemgr,
+							  server->cryptopool);
+				isc_log_write(ns_g_lctx,
+					      NS_LOGCATEGORY_GENERAL,
+					      NS_LOGMODULE_SERVER,
+					      ISC_LOG_INFO,
+					      "using %u crypto thread%s",
+					      cryptothreads,
+					      cryptothreads == 1 ? "" : "s");
+			} else if (result != ISC_R_NOTIMPLEMENTED) {
+				isc_log_write(ns_g_lctx,
+					      NS_LOGCATEGORY_GENERAL,
+					      NS_LOGMODULE_SERVER,
+					      ISC_LOG_WARNING,
+					      "unable to start crypto "
+					      "threads: %s",
+					      isc_result_totext(result));
+			}
+		}
+	}
+
 #if defined(HAVE_GEOIP) || defined(HAVE_GEOIP2)
 	/*
 	 * Release any previously opened GeoIP2 databases.
@@ -7662,6 +7807,22 @@ load_configuration(const char *filename, ns_server_t *server,
 	ns_g_server->aclenv.geoip_use_ecs = cfg_obj_asboolean(obj);
 #endif /* HAVE_GEOIP || HAVE_GEOIP2 */
 
+	/*
+	 * Set the number of node locks for databases created from now
+	 * on; existing caches and zones keep theirs until recreated.
+	 * This must be done in exclusive mode: see
+	 * dns_db_setnodelockcount().
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "cache-node-locks", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_db_setnodelockcount(dns_dbtype_cache, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = ns_config_get(maps, "zone-node-locks", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_db_setnodelockcount(dns_dbtype_zone, cfg_obj_asuint32(obj));
+
 	/*
 	 * Configure various server options.
 	 */
@@ -7836,6 +7997,48 @@ load_configuration(const char *filename, ns_server_t *server,
 	INSIST(result == ISC_R_SUCCESS);
 	dns_zonemgr_setserialqueryrate(server->zonemgr, cfg_obj_asuint32(obj));
 
+	obj = NULL;
+	result = ns_config_get(maps, "dump-rate", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_isstring(obj)) {
+		INSIST(strcasecmp(cfg_obj_asstring(obj), "unlimited") == 0);
+		dump_rate = 0;
+	} else if (cfg_obj_asuint64(obj) > UINT32_MAX) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "'dump-rate' too large; using unlimited");
+		dump_rate = 0;
+	} else {
+		dump_rate = (uint32_t)cfg_obj_asuint64(obj);
+	}
+	dns_zonemgr_setdumprate(server->zonemgr, dump_rate);
+
+	/*
+	 * By default one zone is loaded per worker thread, which keeps
+	 * them all busy without queueing loads behind each other.
+	 */
+	loadlimit = ns_g_cpus;
+	obj = NULL;
+	result = ns_config_get(maps, "startup-load-concurrency", &obj);
+	if (result == ISC_R_SUCCESS)
+		loadlimit = cfg_obj_asuint32(obj);
+	result = dns_zonemgr_setloadlimit(server->zonemgr, loadlimit);
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "unable to set startup-load-concurrency "
+			      "to %u: %s", loadlimit,
+			      isc_result_totext(result));
+
+	obj = NULL;
+	result = ns_config_get(maps, "startup-load-order", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (strcasecmp(cfg_obj_asstring(obj), "size") == 0)
+		dns_zonemgr_setloadorder(server->zonemgr,
+					 dns_zoneloadorder_size);
+	else
+		dns_zonemgr_setloadorder(server->zonemgr,
+					 dns_zoneloadorder_none);
+
 	/*
 	 * Determine which port to use for listening for incoming connections.
 	 */
@@ -7861,6 +8064,14 @@ load_configuration(const char *filename, ns_server_t *server,
 		ns_g_listen = 10;
 	}
 
+	/*
+	 * Whether UDP listeners are sharded across SO_REUSEPORT sockets.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "reuseport", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_g_reuseport = cfg_obj_asboolean(obj);
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -8764,6 +8975,12 @@ load_zones(ns_server_t *server, bool init, bool reconfig) {
 
 	isc_refcount_init(&zl->refs, 1);
 
+	/*
+	 * Queue the loads of all views before starting any, so that
+	 * they start in order of priority.
+	 */
+	dns_zonemgr_holdloads(server->zonemgr);
+
 	/*
 	 * Schedule zones to be loaded from disk.
 	 */
@@ -8795,6 +9012,8 @@ load_zones(ns_server_t *server, bool init, bool reconfig) {
 	}
 
  cleanup:
+	dns_zonemgr_releaseloads(server->zonemgr);
+
 	isc_refcount_decrement(&zl->refs, &refs);
 	if (refs == 0) {
 		isc_refcount_destroy(&zl->refs);
@@ -8977,6 +9196,11 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 
 	dns_db_detach(&server->in_roothints);
 
+	if (server->cryptopool != NULL) {
+		dns_zonemgr_setcryptopool(server->zonemgr, NULL);
+		dns_cryptopool_detach(&server->cryptopool);
+	}
+
 	isc_task_endexclusive(server->task);
 
 	isc_task_detach(&server->task);
@@ -9017,6 +9241,7 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->interfacemgr = NULL;
 	ISC_LIST_INIT(server->viewlist);
 	server->in_roothints = NULL;
+	server->cryptopool = NULL;
 	server->blackholeacl = NULL;
 	server->keepresporder = NULL;
 
@@ -9092,8 +9317,9 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->tcpoutstats4 = NULL;
 	server->tcpinstats6 = NULL;
 	server->tcpoutstats6 = NULL;
-	CHECKFATAL(isc_stats_create(server->mctx, &server->sockstats,
-				    isc_sockstatscounter_max),
+	CHECKFATAL(isc_stats_create2(server->mctx, &server->sockstats,
+				     isc_sockstatscounter_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "isc_stats_create");
 	isc_socketmgr_setstats(ns_g_socketmgr, server->sockstats);
 
@@ -9122,18 +9348,22 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->server_usehostname = false;
 	server->server_id = NULL;
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->nsstats,
-				    dns_nsstatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->nsstats,
+				     dns_nsstatscounter_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (server)");
 
-	CHECKFATAL(dns_rdatatypestats_create(ns_g_mctx,
-					     &server->rcvquerystats),
+	CHECKFATAL(dns_rdatatypestats_create2(ns_g_mctx,
+					      &server->rcvquerystats,
+					      ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (rcvquery)");
 
-	CHECKFATAL(dns_opcodestats_create(ns_g_mctx, &server->opcodestats),
+	CHECKFATAL(dns_opcodestats_create2(ns_g_mctx, &server->opcodestats,
+					   ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (opcode)");
 
-	CHECKFATAL(dns_rcodestats_create(ns_g_mctx, &server->rcodestats),
+	CHECKFATAL(dns_rcodestats_create2(ns_g_mctx, &server->rcodestats,
+					  ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (rcode)");
 
 	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->zonestats,
@@ -9144,36 +9374,44 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 				    dns_resstatscounter_max),
 		   "dns_stats_create (resolver)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpinstats4,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpinstats4,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (inbound UDP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpoutstats4,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpoutstats4,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (outbound UDP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpinstats6,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpinstats6,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (inbound UDP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpoutstats6,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpoutstats6,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (outbound UDP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpinstats4,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpinstats4,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (inbound TCP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpoutstats4,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpoutstats4,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (outbound TCP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpinstats6,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpinstats6,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (inbound TCP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpoutstats6,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpoutstats6,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_PERTHREAD),
 		   "dns_stats_create (outbound TCP IPv6 traffic size)");
 
 	server->flushonshutdown = false;
@@ -10316,6 +10554,68 @@ ns_server_dumpdb(ns_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
 	return (result);
 }
 
+isc_result_t
+ns_server_snapshot(ns_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
+	dns_view_t *view;
+	isc_result_t result = ISC_R_SUCCESS, tresult;
+	char *ptr;
+	bool found;
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL)
+		return (ISC_R_UNEXPECTEDEND);
+
+	ptr = next_token(lex, text);
+	do {
+		found = false;
+		for (view = ISC_LIST_HEAD(server->viewlist);
+		     view != NULL;
+		     view = ISC_LIST_NEXT(view, link))
+		{
+			if (ptr != NULL && strcmp(view->name, ptr) != 0)
+				continue;
+			found = true;
+			/* Write a shared cache only once. */
+			if (ptr == NULL && view->cache != NULL &&
+			    dns_view_iscacheshared(view))
+			{
+				continue;
+			}
+			if (view->cache == NULL)
+				continue;
+			tresult = dns_cache_dumpsnapshot(view->cache);
+			if (tresult != ISC_R_SUCCESS) {
+				isc_log_write(ns_g_lctx,
+					      NS_LOGCATEGORY_GENERAL,
+					      NS_LOGMODULE_SERVER,
+					      ISC_LOG_ERROR,
+					      "writing cache snapshot for "
+					      "view '%s' failed: %s",
+					      view->name,
+					      isc_result_totext(tresult));
+				result = tresult;
+			}
+		}
+		if (ptr != NULL) {
+			if (!found) {
+				(void)putstr(text, "view '");
+				(void)putstr(text, ptr);
+				(void)putstr(text, "' not found");
+				(void)putnull(text);
+				return (ISC_R_NOTFOUND);
+			}
+			ptr = next_token(lex, text);
+		}
+	} while (ptr != NULL);
+
+	isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+		      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "cache snapshots written: %s",
+		      isc_result_totext(result));
+	return (result);
+}
+
 isc_result_t
 ns_server_dumpsecroots(ns_server_t *server, isc_lex_t *lex,
 		       isc_buffer_t **text)
@@ -10812,6 +11112,7 @@ ns_server_status(ns_server_t *server, isc_buffer_t **text) {
 	isc_result_t result;
 	unsigned int zonecount, xferrunning, xferdeferred, soaqueries;
 	unsigned int automatic;
+	dns_zoneloadprogress_t loads;
 	const char *ob = "", *cb = "", *alt = "";
 	char boottime[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char configtime[ISC_FORMATHTTPTIMESTAMP_SIZE];
@@ -10834,6 +11135,7 @@ ns_server_status(ns_server_t *server, isc_buffer_t **text) {
 					  DNS_ZONESTATE_SOAQUERY);
 	automatic = dns_zonemgr_getcount(server->zonemgr,
 					 DNS_ZONESTATE_AUTOMATIC);
+	dns_zonemgr_getloadprogress(server->zonemgr, &loads);
 
 	isc_time_formathttptimestamp(&ns_g_boottime, boottime,
 				     sizeof(boottime));
@@ -10900,6 +11202,29 @@ ns_server_status(ns_server_t *server, isc_buffer_t **text) {
 		     soaqueries);
 	CHECK(putstr(text, line));
 
+	if (loads.loaded < loads.total && loads.eta != 0) {
+		snprintf(line, sizeof(line),
+			 "zone loads: %u/%u done, %u in progress, "
+			 "%" PRIu64 " seconds elapsed, "
+			 "about %" PRIu64 " seconds left\n",
+			 loads.loaded, loads.total, loads.active,
+			 loads.usecs / 1000000, loads.eta / 1000000);
+		CHECK(putstr(text, line));
+	} else if (loads.loaded < loads.total) {
+		snprintf(line, sizeof(line),
+			 "zone loads: %u/%u done, %u in progress, "
+			 "%" PRIu64 " seconds elapsed\n",
+			 loads.loaded, loads.total, loads.active,
+			 loads.usecs / 1000000);
+		CHECK(putstr(text, line));
+	} else if (loads.total != 0) {
+		snprintf(line, sizeof(line),
+			 "zone loads: %u done in %" PRIu64 ".%03u seconds\n",
+			 loads.loaded, loads.usecs / 1000000,
+			 (unsigned int)(loads.usecs % 1000000 / 1000));
+		CHECK(putstr(text, line));
+	}
+
 	snprintf(line, sizeof(line), "query logging is %s\n",
 		     server->log_queries ? "ON" : "OFF");
 	CHECK(putstr(text, line));
@@ -13442,6 +13767,7 @@ ns_server_signing(ns_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
 			dns_rdata_t priv = DNS_RDATA_INIT;
 			char output[BUFSIZ];
 			isc_buffer_t buf;
+			uint32_t nodes;
 
 			dns_rdataset_current(&privset, &priv);
 
@@ -13451,6 +13777,21 @@ ns_server_signing(ns_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
 				CHECK(putstr(text, "\n"));
 			CHECK(putstr(text, output));
 			first = false;
+
+			/*
+			 * Report the progress of signings that are
+			 * still under way.
+			 */
+			if (priv.length == 5 && priv.data[0] != 0 &&
+			    priv.data[4] == 0 &&
+			    dns_zone_getsigningprogress(zone, priv.data[0],
+					(priv.data[1] << 8) | priv.data[2],
+					&nodes) == ISC_R_SUCCESS)
+			{
+				snprintf(output, sizeof(output),
+					 " (%u names processed)", nodes);
+				CHECK(putstr(text, output));
+			}
 		}
 		if (!first)
 			CHECK(putnull(text));
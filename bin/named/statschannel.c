@@ -300,6 +300,9 @@ init_desc(void) {
 	SET_NSSTATDESC(reclimitdropped,
 		       "queries dropped due to recursive client limit",
 		       "RecLimitDropped");
+	SET_NSSTATDESC(respcachehit,
+		       "queries answered from the response cache",
+		       "QryRespCache");
 	INSIST(i == dns_nsstatscounter_max);
 
 	/* Initialize resolver statistics */
@@ -387,6 +390,29 @@ init_desc(void) {
 	SET_RESSTATDESC(serverquota, "spilled due to server quota",
 			"ServerQuota");
 	SET_RESSTATDESC(nextitem, "waited for next item", "NextItem");
+	SET_RESSTATDESC(bucketwait, "fetch bucket lock waits",
+			"BucketWait");
+	SET_RESSTATDESC(bucketwaitmax, "longest fetch bucket lock wait (us)",
+			"BucketWaitMax");
+	SET_RESSTATDESC(bucketmax, "most fetches in a bucket",
+			"BucketMaxFetch");
+	SET_RESSTATDESC(chainmax, "longest fetch hash chain",
+			"BucketMaxChain");
+	SET_RESSTATDESC(cryptoqueued, "DNSSEC verifications offloaded",
+			"CryptoQueued");
+	SET_RESSTATDESC(cryptoqueuemax, "longest crypto pool queue",
+			"CryptoQueueMax");
+	SET_RESSTATDESC(cryptolatlt1ms, "offloaded verifications < 1ms",
+			"CryptoLat<1ms");
+	SET_RESSTATDESC(cryptolatlt10ms,
+			"offloaded verifications >= 1ms and < 10ms",
+			"CryptoLat<10ms");
+	SET_RESSTATDESC(cryptolatlt100ms,
+			"offloaded verifications >= 10ms and < 100ms",
+			"CryptoLat<100ms");
+	SET_RESSTATDESC(cryptolatge100ms,
+			"offloaded verifications >= 100ms",
+			"CryptoLat>=100ms");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -409,6 +435,13 @@ init_desc(void) {
 	SET_ADBSTATDESC(entriescnt, "Addresses in hash table", "entriescnt");
 	SET_ADBSTATDESC(nnames, "Name hash table size", "nnames");
 	SET_ADBSTATDESC(namescnt, "Names in hash table", "namescnt");
+	SET_ADBSTATDESC(namehit, "Name lookups found", "namehit");
+	SET_ADBSTATDESC(namemiss, "Name lookups not found", "namemiss");
+	SET_ADBSTATDESC(namegrow, "Name hash table resizes", "namegrow");
+	SET_ADBSTATDESC(entryhit, "Address lookups found", "entryhit");
+	SET_ADBSTATDESC(entrymiss, "Address lookups not found", "entrymiss");
+	SET_ADBSTATDESC(entrygrow, "Address hash table resizes",
+			"entrygrow");
 
 	INSIST(i == dns_adbstats_max);
 
@@ -589,6 +622,8 @@ init_desc(void) {
 	SET_DNSSECSTATDESC(wildcard, "dnssec validation of wildcard signature",
 			   "DNSSECwild");
 	SET_DNSSECSTATDESC(fail, "dnssec validation failures", "DNSSECfail");
+	SET_DNSSECSTATDESC(cached, "dnssec validation found in verify cache",
+			   "DNSSECcached");
 	INSIST(i == dns_dnssecstats_max);
 
 	/* Initialize dnstap statistics */
@@ -1397,6 +1432,31 @@ rcodestat_dump(dns_rcode_t code, uint64_t val, void *arg) {
 #endif
 }
 
+#if defined(EXTENDED_STATS)
+/*
+ * Progress of the zone loads, as shown by "rndc status".
+ */
+static const char *zoneload_names[] = {
+	"total", "loaded", "in-progress", "bytes", "bytes-loaded",
+	"elapsed-ms", "eta-ms"
+};
+#define ZONELOAD_NFIELDS (sizeof(zoneload_names) / sizeof(zoneload_names[0]))
+
+static void
+zoneload_values(ns_server_t *server, uint64_t *values) {
+	dns_zoneloadprogress_t loads;
+
+	dns_zonemgr_getloadprogress(server->zonemgr, &loads);
+	values[0] = loads.total;
+	values[1] = loads.loaded;
+	values[2] = loads.active;
+	values[3] = loads.bytes;
+	values[4] = loads.bytesloaded;
+	values[5] = loads.usecs / 1000;
+	values[6] = loads.eta / 1000;
+}
+#endif
+
 #ifdef HAVE_LIBXML2
 /*
  * Which statistics to include when rendering to XML
@@ -1525,6 +1585,8 @@ generatexml(ns_server_t *server, uint32_t flags,
 #ifdef HAVE_DNSTAP
 	uint64_t dnstapstat_values[dns_dnstapcounter_max];
 #endif
+	uint64_t zoneload_vals[ZONELOAD_NFIELDS];
+	unsigned int i;
 	isc_result_t result;
 
 	isc_time_now(&now);
@@ -1540,7 +1602,7 @@ generatexml(ns_server_t *server, uint32_t flags,
 			ISC_XMLCHAR "type=\"text/xsl\" href=\"/bind9.xsl\""));
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "statistics"));
 	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "version",
-					 ISC_XMLCHAR "3.8"));
+					 ISC_XMLCHAR "3.9"));
 
 	/* Set common fields for statistics dump */
 	dumparg.type = isc_statsformat_xml;
@@ -1562,6 +1624,18 @@ generatexml(ns_server_t *server, uint32_t flags,
 	TRY0(xmlTextWriterEndElement(writer));  /* version */
 
 	if ((flags & STATS_XML_SERVER) != 0) {
+		zoneload_values(server, zoneload_vals);
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "zone-loads"));
+		for (i = 0; i < ZONELOAD_NFIELDS; i++) {
+			TRY0(xmlTextWriterStartElement(writer,
+					ISC_XMLCHAR zoneload_names[i]));
+			TRY0(xmlTextWriterWriteFormatString(writer,
+					"%" PRIu64, zoneload_vals[i]));
+			TRY0(xmlTextWriterEndElement(writer));
+		}
+		TRY0(xmlTextWriterEndElement(writer));  /* zone-loads */
+
 		dumparg.result = ISC_R_SUCCESS;
 
 		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
@@ -2280,6 +2354,8 @@ generatejson(ns_server_t *server, size_t *msglen,
 #ifdef HAVE_DNSTAP
 	uint64_t dnstapstat_values[dns_dnstapcounter_max];
 #endif
+	uint64_t zoneload_vals[ZONELOAD_NFIELDS];
+	unsigned int i;
 	stats_dumparg_t dumparg;
 	char boottime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
 	char configtime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
@@ -2297,7 +2373,7 @@ generatejson(ns_server_t *server, size_t *msglen,
 	/*
 	 * These statistics are included no matter which URL we use.
 	 */
-	obj = json_object_new_string("1.2");
+	obj = json_object_new_string("1.3");
 	CHECKMEM(obj);
 	json_object_object_add(bindstats, "json-stats-version", obj);
 
@@ -2324,6 +2400,19 @@ generatejson(ns_server_t *server, size_t *msglen,
 	json_object_object_add(bindstats, "version", obj);
 
 	if ((flags & STATS_JSON_SERVER) != 0) {
+		/* Zone load progress */
+		counters = json_object_new_object();
+		CHECKMEM(counters);
+		json_object_object_add(bindstats, "zone-loads", counters);
+		zoneload_values(server, zoneload_vals);
+		for (i = 0; i < ZONELOAD_NFIELDS; i++) {
+			obj = json_object_new_int64(
+				(int64_t)zoneload_vals[i]);
+			CHECKMEM(obj);
+			json_object_object_add(counters, zoneload_names[i],
+					       obj);
+		}
+
 		/* OPCODE counters */
 		counters = json_object_new_object();
 
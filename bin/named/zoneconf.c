@@ -979,6 +979,20 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 	if (zone != mayberaw)
 		dns_zone_setmaxrecords(zone, 0);
 
+	obj = NULL;
+	result = ns_config_get(maps, "startup-load-priority", &obj);
+	if (result == ISC_R_SUCCESS)
+		dns_zone_setloadpriority(zone, cfg_obj_asuint32(obj));
+	else
+		dns_zone_setloadpriority(zone, 0);
+
+	obj = NULL;
+	result = ns_config_get(maps, "expected-names", &obj);
+	INSIST(result == ISC_R_SUCCESS && obj != NULL);
+	dns_zone_setexpectednames(zone, cfg_obj_asuint32(obj));
+	if (raw != NULL)
+		dns_zone_setexpectednames(raw, cfg_obj_asuint32(obj));
+
 	if (raw != NULL && filename != NULL) {
 #define SIGNED ".signed"
 		size_t signedlen = strlen(filename) + sizeof(SIGNED);
@@ -1218,6 +1232,14 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 			dns_zone_setjournalsize(raw, journal_size);
 		dns_zone_setjournalsize(zone, journal_size);
 
+		obj = NULL;
+		result = ns_config_get(maps, "dump-journal-ratio", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		if (raw != NULL)
+			dns_zone_setdumpjournalratio(raw,
+						     cfg_obj_asuint32(obj));
+		dns_zone_setdumpjournalratio(zone, cfg_obj_asuint32(obj));
+
 		obj = NULL;
 		result = ns_config_get(maps, "ixfr-from-differences", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
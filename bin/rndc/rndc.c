@@ -161,6 +161,8 @@ command is one of the following:\n\
 		Write security roots to the secroots file.\n\
   showzone zone [class [view]]\n\
 		Print a zone's configuration.\n\
+  snapshot [view ...]\n\
+		Write the cache snapshot of each view (cache-snapshot).\n\
   sign zone [class [view]]\n\
 		Update zone keys, and sign as needed.\n\
   signing -clear all zone [class [view]]\n\
@@ -1048,6 +1048,34 @@ check_options(const cfg_obj_t *options, isc_log_t *logctx, isc_mem_t *mctx,
 		}
 	}
 
+	obj = NULL;
+	cfg_map_get(options, "cache-node-locks", &obj);
+	if (obj != NULL) {
+		uint32_t val;
+
+		val = cfg_obj_asuint32(obj);
+		if (val == 1 || val > 1023) {
+			cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+				    "cache-node-locks '%u' is out of "
+				    "range (0 or 2..1023)", val);
+			result = ISC_R_RANGE;
+		}
+	}
+
+	obj = NULL;
+	cfg_map_get(options, "zone-node-locks", &obj);
+	if (obj != NULL) {
+		uint32_t val;
+
+		val = cfg_obj_asuint32(obj);
+		if (val > 1023) {
+			cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+				    "zone-node-locks '%u' is out of "
+				    "range (0..1023)", val);
+			result = ISC_R_RANGE;
+		}
+	}
+
 	obj = NULL;
 	cfg_map_get(options, "sig-validity-interval", &obj);
 	if (obj != NULL) {
@@ -4067,13 +4095,21 @@ bind9_check_namedconf(const cfg_obj_t *config, isc_log_t *logctx,
 	}
 
 	if (views != NULL && options != NULL) {
-		obj = NULL;
-		tresult = cfg_map_get(options, "cache-file", &obj);
-		if (tresult == ISC_R_SUCCESS) {
-			cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
-				    "'cache-file' cannot be a global "
-				    "option if views are present");
-			result = ISC_R_FAILURE;
+		static const char *perview[] = {
+			"cache-file", "cache-snapshot", NULL
+		};
+		unsigned int i;
+
+		for (i = 0; perview[i] != NULL; i++) {
+			obj = NULL;
+			tresult = cfg_map_get(options, perview[i], &obj);
+			if (tresult == ISC_R_SUCCESS) {
+				cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+					    "'%s' cannot be a global "
+					    "option if views are present",
+					    perview[i]);
+				result = ISC_R_FAILURE;
+			}
 		}
 	}
 
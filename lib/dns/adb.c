@@ -33,6 +33,14 @@
 #include <isc/task.h>
 #include <isc/util.h>
 
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#if defined(__cplusplus)
+#include <isc/stdatomic.h>
+#else
+#include <stdatomic.h>
+#endif
+#endif
+
 #include <dns/adb.h>
 #include <dns/db.h>
 #include <dns/events.h>
@@ -86,6 +94,49 @@
 
 #define DNS_ADB_MINADBSIZE      (1024U*1024U)     /*%< 1 Megabyte */
 
+/*%
+ * Names and entries are spread over a fixed number of lock buckets.
+ * Within each bucket they are also hashed into a table of chains which
+ * starts with 2^ADB_HASHBITS_MIN chains and doubles, under the bucket
+ * lock alone, whenever the average chain would exceed ADB_CHAINLEN.
+ */
+#define ADB_NBUCKETS		1021
+#define ADB_HASHBITS_MIN	2
+#define ADB_HASHBITS_MAX	16
+#define ADB_CHAINLEN		2U
+#define NAME_CHAIN(adb, b, h) \
+	(&(adb)->name_table[b][(h) & ((1U << (adb)->name_hashbits[b]) - 1)])
+#define ENTRY_CHAIN(adb, b, h) \
+	(&(adb)->entry_table[b][(h) & ((1U << (adb)->entry_hashbits[b]) - 1)])
+
+/*%
+ * The entry fields updated on every response (srtt, flags, udpsize
+ * and the expiry times) are atomic where possible, so that
+ * dns_adb_adjustsrtt(), dns_adb_changeflags() and friends do not need
+ * the entry bucket lock.  Without atomics they are taken under it.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && defined(ISC_PLATFORM_HAVESTDATOMIC)
+#define ADB_ATOMIC		1
+typedef atomic_uint_fast32_t	adbatomic_t;
+#define ADB_GET(v) \
+	((unsigned int)atomic_load_explicit(&(v), memory_order_relaxed))
+#define ADB_SET(v, n) \
+	atomic_store_explicit(&(v), (n), memory_order_relaxed)
+#define ADB_CAS(v, o, n) \
+	atomic_compare_exchange_weak_explicit(&(v), &(o), (n), \
+					      memory_order_relaxed, \
+					      memory_order_relaxed)
+#define ADB_OR(v, n) \
+	atomic_fetch_or_explicit(&(v), (n), memory_order_relaxed)
+#else
+typedef uint_fast32_t		adbatomic_t;
+#define ADB_GET(v)		((unsigned int)(v))
+#define ADB_SET(v, n)		((v) = (n))
+#define ADB_CAS(v, o, n)	((v) == (o) ? ((v) = (n), true) : \
+					      ((o) = (v), false))
+#define ADB_OR(v, n)		((v) |= (n))
+#endif
+
 typedef ISC_LIST(dns_adbname_t) dns_adbnamelist_t;
 typedef struct dns_adbnamehook dns_adbnamehook_t;
 typedef ISC_LIST(dns_adbnamehook_t) dns_adbnamehooklist_t;
@@ -106,7 +157,6 @@ struct dns_adb {
 
 	isc_taskmgr_t                  *taskmgr;
 	isc_task_t                     *task;
-	isc_task_t                     *excl;
 
 	isc_interval_t                  tick_interval;
 	int                             next_cleanbucket;
@@ -131,8 +181,12 @@ struct dns_adb {
 	unsigned int			nnames;
 	isc_mutex_t                     namescntlock;
 	unsigned int			namescnt;
+	unsigned int			namechains; /*%< Total hash chains */
 	dns_adbnamelist_t               *names;
 	dns_adbnamelist_t               *deadnames;
+	dns_adbnamelist_t               **name_table;
+	unsigned int                    *name_hashbits;
+	unsigned int                    *name_hashcnt;
 	isc_mutex_t                     *namelocks;
 	bool                   *name_sd;
 	unsigned int                    *name_refcnt;
@@ -145,8 +199,12 @@ struct dns_adb {
 	unsigned int			nentries;
 	isc_mutex_t                     entriescntlock;
 	unsigned int			entriescnt;
+	unsigned int			entrychains; /*%< Total hash chains */
 	dns_adbentrylist_t              *entries;
 	dns_adbentrylist_t              *deadentries;
+	dns_adbentrylist_t              **entry_table;
+	unsigned int                    *entry_hashbits;
+	unsigned int                    *entry_hashcnt;
 	isc_mutex_t                     *entrylocks;
 	bool                   *entry_sd; /*%< shutting down */
 	unsigned int                    *entry_refcnt;
@@ -155,10 +213,6 @@ struct dns_adb {
 	bool                   cevent_out;
 	bool                   shutting_down;
 	isc_eventlist_t                 whenshutdown;
-	isc_event_t			growentries;
-	bool			growentries_sent;
-	isc_event_t			grownames;
-	bool			grownames_sent;
 
 	uint32_t			quota;
 	uint32_t			atr_freq;
@@ -179,6 +233,7 @@ struct dns_adbname {
 	unsigned int                    partial_result;
 	unsigned int                    flags;
 	int                             lock_bucket;
+	unsigned int                    hashval;
 	dns_name_t                      target;
 	isc_stdtime_t                   expire_target;
 	isc_stdtime_t                   expire_v4;
@@ -195,6 +250,7 @@ struct dns_adbname {
 	isc_stdtime_t                   last_used;
 
 	ISC_LINK(dns_adbname_t)         plink;
+	ISC_LINK(dns_adbname_t)         hlink;
 };
 
 /*% The adbfetch structure */
@@ -240,12 +296,13 @@ struct dns_adbentry {
 	unsigned int                    magic;
 
 	int                             lock_bucket;
+	unsigned int                    hashval;
 	unsigned int                    refcnt;
 	unsigned int                    nh;
 
-	unsigned int                    flags;
-	unsigned int                    srtt;
-	uint16_t			udpsize;
+	adbatomic_t                     flags;
+	adbatomic_t                     srtt;
+	adbatomic_t			udpsize;
 	unsigned int			completed;
 	unsigned int			timeouts;
 	unsigned char			plain;
@@ -269,8 +326,8 @@ struct dns_adbentry {
 	unsigned char *			cookie;
 	uint16_t			cookielen;
 
-	isc_stdtime_t                   expires;
-	isc_stdtime_t			lastage;
+	adbatomic_t                     expires;
+	adbatomic_t			lastage;
 	/*%<
 	 * A nonzero 'expires' field indicates that the entry should
 	 * persist until that time.  This allows entries found
@@ -281,6 +338,7 @@ struct dns_adbentry {
 
 	ISC_LIST(dns_adblameinfo_t)     lameinfo;
 	ISC_LINK(dns_adbentry_t)        plink;
+	ISC_LINK(dns_adbentry_t)        hlink;
 };
 
 /*
@@ -539,329 +597,84 @@ ttlclamp(dns_ttl_t ttl) {
 }
 
 /*
- * Hashing is most efficient if the number of buckets is prime.
- * The sequence below is the closest previous primes to 2^n and
- * 1.5 * 2^n, for values of n from 10 to 28.  (The tables will
- * no longer grow beyond 2^28 entries.)
+ * Double the number of hash chains for the names in 'bucket'.  If
+ * memory is short the current table is kept; it still works, the
+ * chains are just longer.
+ *
+ * Requires the name bucket be locked.
  */
-static const unsigned nbuckets[] = { 1021, 1531, 2039, 3067, 4093, 6143,
-				     8191, 12281, 16381, 24571, 32749,
-				     49193, 65521, 98299, 131071, 199603,
-				     262139, 393209, 524287, 768431, 1048573,
-				     1572853, 2097143, 3145721, 4194301,
-				     6291449, 8388593, 12582893, 16777213,
-				     25165813, 33554393, 50331599, 67108859,
-				     100663291, 134217689, 201326557,
-				     268535431, 0 };
-
 static void
-grow_entries(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbentry_t *e;
-	dns_adbentrylist_t *newdeadentries = NULL;
-	dns_adbentrylist_t *newentries = NULL;
-	bool *newentry_sd = NULL;
-	isc_mutex_t *newentrylocks = NULL;
-	isc_result_t result;
-	unsigned int *newentry_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nentries >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_entries to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nentries; i++)
-		if (adb->entry_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newentries = isc_mem_get(adb->mctx, sizeof(*newentries) * n);
-	newdeadentries = isc_mem_get(adb->mctx, sizeof(*newdeadentries) * n);
-	newentrylocks = isc_mem_get(adb->mctx, sizeof(*newentrylocks) * n);
-	newentry_sd = isc_mem_get(adb->mctx, sizeof(*newentry_sd) * n);
-	newentry_refcnt = isc_mem_get(adb->mctx, sizeof(*newentry_refcnt) * n);
-	if (newentries == NULL || newdeadentries == NULL ||
-	    newentrylocks == NULL || newentry_sd == NULL ||
-	    newentry_refcnt == NULL)
-		goto cleanup;
+grow_name_table(dns_adb_t *adb, int bucket) {
+	dns_adbnamelist_t *table, *oldtable;
+	unsigned int i, oldsize;
+	dns_adbname_t *name;
 
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newentrylocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
+	oldtable = adb->name_table[bucket];
+	oldsize = 1U << adb->name_hashbits[bucket];
 
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newentries[i]);
-		ISC_LIST_INIT(newdeadentries[i]);
-		newentry_sd[i] = false;
-		newentry_refcnt[i] = 0;
-		adb->irefcnt++;
-	}
-
-	/*
-	 * Move entries to new arrays.
-	 */
-	for (i = 0; i < adb->nentries; i++) {
-		e = ISC_LIST_HEAD(adb->entries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->entries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, true) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->entries[i]);
-		}
-		e = ISC_LIST_HEAD(adb->deadentries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->deadentries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, true) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->deadentries[i]);
+	table = isc_mem_get(adb->mctx, 2 * oldsize * sizeof(*table));
+	if (table == NULL)
+		return;
+	for (i = 0; i < 2 * oldsize; i++)
+		ISC_LIST_INIT(table[i]);
+
+	adb->name_table[bucket] = table;
+	adb->name_hashbits[bucket]++;
+	for (i = 0; i < oldsize; i++) {
+		while ((name = ISC_LIST_HEAD(oldtable[i])) != NULL) {
+			ISC_LIST_UNLINK(oldtable[i], name, hlink);
+			ISC_LIST_APPEND(*NAME_CHAIN(adb, bucket,
+						    name->hashval),
+					name, hlink);
 		}
-		INSIST(adb->entry_refcnt[i] == 0);
-		adb->irefcnt--;
 	}
 
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->entrylocks, adb->nentries);
-	isc_mem_put(adb->mctx, adb->entries,
-		    sizeof(*adb->entries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->deadentries,
-		    sizeof(*adb->deadentries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entrylocks,
-		    sizeof(*adb->entrylocks) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_sd,
-		    sizeof(*adb->entry_sd) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_refcnt,
-		    sizeof(*adb->entry_refcnt) * adb->nentries);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->entries = newentries;
-	adb->deadentries = newdeadentries;
-	adb->entrylocks = newentrylocks;
-	adb->entry_sd = newentry_sd;
-	adb->entry_refcnt = newentry_refcnt;
-	adb->nentries = n;
+	isc_mem_put(adb->mctx, oldtable, oldsize * sizeof(*oldtable));
 
-	set_adbstat(adb, adb->nentries, dns_adbstats_nentries);
-
-	/*
-	 * Only on success do we set adb->growentries_sent to false.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->growentries_sent = false;
-	goto done;
-
- cleanup:
-	if (newentries != NULL)
-		isc_mem_put(adb->mctx, newentries,
-			    sizeof(*newentries) * n);
-	if (newdeadentries != NULL)
-		isc_mem_put(adb->mctx, newdeadentries,
-			    sizeof(*newdeadentries) * n);
-	if (newentrylocks != NULL)
-		isc_mem_put(adb->mctx, newentrylocks,
-			    sizeof(*newentrylocks) * n);
-	if (newentry_sd != NULL)
-		isc_mem_put(adb->mctx, newentry_sd,
-			    sizeof(*newentry_sd) * n);
-	if (newentry_refcnt != NULL)
-		isc_mem_put(adb->mctx, newentry_refcnt,
-			     sizeof(*newentry_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_entries finished");
+	LOCK(&adb->namescntlock);
+	adb->namechains += oldsize;
+	set_adbstat(adb, adb->namechains, dns_adbstats_nnames);
+	UNLOCK(&adb->namescntlock);
+	inc_adbstats(adb, dns_adbstats_namegrow);
 }
 
+/*
+ * Double the number of hash chains for the entries in 'bucket'.
+ *
+ * Requires the entry bucket be locked.
+ */
 static void
-grow_names(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbname_t *name;
-	dns_adbnamelist_t *newdeadnames = NULL;
-	dns_adbnamelist_t *newnames = NULL;
-	bool *newname_sd = NULL;
-	isc_mutex_t *newnamelocks = NULL;
-	isc_result_t result;
-	unsigned int *newname_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nnames >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_names to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nnames; i++)
-		if (adb->name_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newnames = isc_mem_get(adb->mctx, sizeof(*newnames) * n);
-	newdeadnames = isc_mem_get(adb->mctx, sizeof(*newdeadnames) * n);
-	newnamelocks = isc_mem_get(adb->mctx, sizeof(*newnamelocks) * n);
-	newname_sd = isc_mem_get(adb->mctx, sizeof(*newname_sd) * n);
-	newname_refcnt = isc_mem_get(adb->mctx, sizeof(*newname_refcnt) * n);
-	if (newnames == NULL || newdeadnames == NULL ||
-	    newnamelocks == NULL || newname_sd == NULL ||
-	    newname_refcnt == NULL)
-		goto cleanup;
-
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newnamelocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
+grow_entry_table(dns_adb_t *adb, int bucket) {
+	dns_adbentrylist_t *table, *oldtable;
+	unsigned int i, oldsize;
+	dns_adbentry_t *e;
 
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newnames[i]);
-		ISC_LIST_INIT(newdeadnames[i]);
-		newname_sd[i] = false;
-		newname_refcnt[i] = 0;
-		adb->irefcnt++;
-	}
+	oldtable = adb->entry_table[bucket];
+	oldsize = 1U << adb->entry_hashbits[bucket];
 
-	/*
-	 * Move names to new arrays.
-	 */
-	for (i = 0; i < adb->nnames; i++) {
-		name = ISC_LIST_HEAD(adb->names[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->names[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, true) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->names[i]);
-		}
-		name = ISC_LIST_HEAD(adb->deadnames[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->deadnames[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, true) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->deadnames[i]);
+	table = isc_mem_get(adb->mctx, 2 * oldsize * sizeof(*table));
+	if (table == NULL)
+		return;
+	for (i = 0; i < 2 * oldsize; i++)
+		ISC_LIST_INIT(table[i]);
+
+	adb->entry_table[bucket] = table;
+	adb->entry_hashbits[bucket]++;
+	for (i = 0; i < oldsize; i++) {
+		while ((e = ISC_LIST_HEAD(oldtable[i])) != NULL) {
+			ISC_LIST_UNLINK(oldtable[i], e, hlink);
+			ISC_LIST_APPEND(*ENTRY_CHAIN(adb, bucket, e->hashval),
+					e, hlink);
 		}
-		INSIST(adb->name_refcnt[i] == 0);
-		adb->irefcnt--;
 	}
 
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
-	isc_mem_put(adb->mctx, adb->names,
-		    sizeof(*adb->names) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->deadnames,
-		    sizeof(*adb->deadnames) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->namelocks,
-		    sizeof(*adb->namelocks) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_sd,
-		    sizeof(*adb->name_sd) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_refcnt,
-		    sizeof(*adb->name_refcnt) * adb->nnames);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->names = newnames;
-	adb->deadnames = newdeadnames;
-	adb->namelocks = newnamelocks;
-	adb->name_sd = newname_sd;
-	adb->name_refcnt = newname_refcnt;
-	adb->nnames = n;
+	isc_mem_put(adb->mctx, oldtable, oldsize * sizeof(*oldtable));
 
-	set_adbstat(adb, adb->nnames, dns_adbstats_nnames);
-
-	/*
-	 * Only on success do we set adb->grownames_sent to false.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->grownames_sent = false;
-	goto done;
-
- cleanup:
-	if (newnames != NULL)
-		isc_mem_put(adb->mctx, newnames, sizeof(*newnames) * n);
-	if (newdeadnames != NULL)
-		isc_mem_put(adb->mctx, newdeadnames, sizeof(*newdeadnames) * n);
-	if (newnamelocks != NULL)
-		isc_mem_put(adb->mctx, newnamelocks, sizeof(*newnamelocks) * n);
-	if (newname_sd != NULL)
-		isc_mem_put(adb->mctx, newname_sd, sizeof(*newname_sd) * n);
-	if (newname_refcnt != NULL)
-		isc_mem_put(adb->mctx, newname_refcnt,
-			     sizeof(*newname_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_names finished");
+	LOCK(&adb->entriescntlock);
+	adb->entrychains += oldsize;
+	set_adbstat(adb, adb->entrychains, dns_adbstats_nentries);
+	UNLOCK(&adb->entriescntlock);
+	inc_adbstats(adb, dns_adbstats_entrygrow);
 }
 
 /*
@@ -1064,6 +877,11 @@ kill_name(dns_adbname_t **n, isc_eventtype_t ev) {
 		if (!NAME_DEAD(name)) {
 			bucket = name->lock_bucket;
 			ISC_LIST_UNLINK(adb->names[bucket], name, plink);
+			ISC_LIST_UNLINK(*NAME_CHAIN(adb, bucket,
+						    name->hashval),
+					name, hlink);
+			INSIST(adb->name_hashcnt[bucket] > 0);
+			adb->name_hashcnt[bucket]--;
 			ISC_LIST_APPEND(adb->deadnames[bucket], name, plink);
 			name->flags |= NAME_IS_DEAD;
 		}
@@ -1128,6 +946,14 @@ link_name(dns_adb_t *adb, int bucket, dns_adbname_t *name) {
 	INSIST(name->lock_bucket == DNS_ADB_INVALIDBUCKET);
 
 	ISC_LIST_PREPEND(adb->names[bucket], name, plink);
+	name->hashval = dns_name_fullhash(&name->name, false);
+	if (adb->name_hashcnt[bucket] >=
+	    (ADB_CHAINLEN << adb->name_hashbits[bucket]) &&
+	    adb->name_hashbits[bucket] < ADB_HASHBITS_MAX)
+		grow_name_table(adb, bucket);
+	ISC_LIST_PREPEND(*NAME_CHAIN(adb, bucket, name->hashval),
+			 name, hlink);
+	adb->name_hashcnt[bucket]++;
 	name->lock_bucket = bucket;
 	adb->name_refcnt[bucket]++;
 }
@@ -1145,8 +971,13 @@ unlink_name(dns_adb_t *adb, dns_adbname_t *name) {
 
 	if (NAME_DEAD(name))
 		ISC_LIST_UNLINK(adb->deadnames[bucket], name, plink);
-	else
+	else {
 		ISC_LIST_UNLINK(adb->names[bucket], name, plink);
+		ISC_LIST_UNLINK(*NAME_CHAIN(adb, bucket, name->hashval),
+				name, hlink);
+		INSIST(adb->name_hashcnt[bucket] > 0);
+		adb->name_hashcnt[bucket]--;
+	}
 	name->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->name_refcnt[bucket] > 0);
 	adb->name_refcnt[bucket]--;
@@ -1173,14 +1004,26 @@ link_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
 				free_adbentry(adb, &e);
 				continue;
 			}
-			INSIST((e->flags & ENTRY_IS_DEAD) == 0);
-			e->flags |= ENTRY_IS_DEAD;
+			INSIST((ADB_GET(e->flags) & ENTRY_IS_DEAD) == 0);
+			ADB_OR(e->flags, ENTRY_IS_DEAD);
 			ISC_LIST_UNLINK(adb->entries[bucket], e, plink);
+			ISC_LIST_UNLINK(*ENTRY_CHAIN(adb, bucket, e->hashval),
+					e, hlink);
+			INSIST(adb->entry_hashcnt[bucket] > 0);
+			adb->entry_hashcnt[bucket]--;
 			ISC_LIST_PREPEND(adb->deadentries[bucket], e, plink);
 		}
 	}
 
 	ISC_LIST_PREPEND(adb->entries[bucket], entry, plink);
+	entry->hashval = isc_sockaddr_hash(&entry->sockaddr, true);
+	if (adb->entry_hashcnt[bucket] >=
+	    (ADB_CHAINLEN << adb->entry_hashbits[bucket]) &&
+	    adb->entry_hashbits[bucket] < ADB_HASHBITS_MAX)
+		grow_entry_table(adb, bucket);
+	ISC_LIST_PREPEND(*ENTRY_CHAIN(adb, bucket, entry->hashval),
+			 entry, hlink);
+	adb->entry_hashcnt[bucket]++;
 	entry->lock_bucket = bucket;
 	adb->entry_refcnt[bucket]++;
 }
@@ -1196,10 +1039,15 @@ unlink_entry(dns_adb_t *adb, dns_adbentry_t *entry) {
 	bucket = entry->lock_bucket;
 	INSIST(bucket != DNS_ADB_INVALIDBUCKET);
 
-	if ((entry->flags & ENTRY_IS_DEAD) != 0)
+	if ((ADB_GET(entry->flags) & ENTRY_IS_DEAD) != 0)
 		ISC_LIST_UNLINK(adb->deadentries[bucket], entry, plink);
-	else
+	else {
 		ISC_LIST_UNLINK(adb->entries[bucket], entry, plink);
+		ISC_LIST_UNLINK(*ENTRY_CHAIN(adb, bucket, entry->hashval),
+				entry, hlink);
+		INSIST(adb->entry_hashcnt[bucket] > 0);
+		adb->entry_hashcnt[bucket]--;
+	}
 	entry->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->entry_refcnt[bucket] > 0);
 	adb->entry_refcnt[bucket]--;
@@ -1293,7 +1141,7 @@ shutdown_entries(dns_adb_t *adb) {
 			while (entry != NULL) {
 				next_entry = ISC_LIST_NEXT(entry, plink);
 				if (entry->refcnt == 0 &&
-				    entry->expires != 0) {
+				    ADB_GET(entry->expires) != 0) {
 					result = unlink_entry(adb, entry);
 					free_adbentry(adb, &entry);
 					if (result)
@@ -1644,8 +1492,8 @@ dec_entry_refcnt(dns_adb_t *adb, bool overmem, dns_adbentry_t *entry,
 
 	destroy_entry = false;
 	if (entry->refcnt == 0 &&
-	    (adb->entry_sd[bucket] || entry->expires == 0 || overmem ||
-	     (entry->flags & ENTRY_IS_DEAD) != 0)) {
+	    (adb->entry_sd[bucket] || ADB_GET(entry->expires) == 0 ||
+	     overmem || (ADB_GET(entry->flags) & ENTRY_IS_DEAD) != 0)) {
 		destroy_entry = true;
 		result = unlink_entry(adb, entry);
 	}
@@ -1696,18 +1544,11 @@ new_adbname(dns_adb_t *adb, dns_name_t *dnsname) {
 	name->fetch6_err = FIND_ERR_UNEXPECTED;
 	ISC_LIST_INIT(name->finds);
 	ISC_LINK_INIT(name, plink);
+	ISC_LINK_INIT(name, hlink);
 
 	LOCK(&adb->namescntlock);
 	adb->namescnt++;
 	inc_adbstats(adb, dns_adbstats_namescnt);
-	if (!adb->grownames_sent && adb->excl != NULL &&
-	    adb->namescnt > (adb->nnames * 8))
-	{
-		isc_event_t *event = &adb->grownames;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->excl, &event);
-		adb->grownames_sent = true;
-	}
 	UNLOCK(&adb->namescntlock);
 
 	return (name);
@@ -1726,6 +1567,7 @@ free_adbname(dns_adb_t *adb, dns_adbname_t **name) {
 	INSIST(!NAME_FETCH(n));
 	INSIST(ISC_LIST_EMPTY(n->finds));
 	INSIST(!ISC_LINK_LINKED(n, plink));
+	INSIST(!ISC_LINK_LINKED(n, hlink));
 	INSIST(n->lock_bucket == DNS_ADB_INVALIDBUCKET);
 	INSIST(n->adb == adb);
 
@@ -1820,8 +1662,8 @@ new_adbentry(dns_adb_t *adb) {
 	e->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	e->refcnt = 0;
 	e->nh = 0;
-	e->flags = 0;
-	e->udpsize = 0;
+	ADB_SET(e->flags, 0);
+	ADB_SET(e->udpsize, 0);
 	e->edns = 0;
 	e->completed = 0;
 	e->timeouts = 0;
@@ -1834,26 +1676,19 @@ new_adbentry(dns_adb_t *adb) {
 	e->cookie = NULL;
 	e->cookielen = 0;
 	isc_random_get(&r);
-	e->srtt = (r & 0x1f) + 1;
-	e->lastage = 0;
-	e->expires = 0;
+	ADB_SET(e->srtt, (r & 0x1f) + 1);
+	ADB_SET(e->lastage, 0);
+	ADB_SET(e->expires, 0);
 	e->active = 0;
 	e->mode = 0;
 	e->quota = adb->quota;
 	e->atr = 0.0;
 	ISC_LIST_INIT(e->lameinfo);
 	ISC_LINK_INIT(e, plink);
+	ISC_LINK_INIT(e, hlink);
 	LOCK(&adb->entriescntlock);
 	adb->entriescnt++;
 	inc_adbstats(adb, dns_adbstats_entriescnt);
-	if (!adb->growentries_sent && adb->excl != NULL &&
-	    adb->entriescnt > (adb->nentries * 8))
-	{
-		isc_event_t *event = &adb->growentries;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->excl, &event);
-		adb->growentries_sent = true;
-	}
 	UNLOCK(&adb->entriescntlock);
 
 	return (e);
@@ -1871,6 +1706,7 @@ free_adbentry(dns_adb_t *adb, dns_adbentry_t **entry) {
 	INSIST(e->lock_bucket == DNS_ADB_INVALIDBUCKET);
 	INSIST(e->refcnt == 0);
 	INSIST(!ISC_LINK_LINKED(e, plink));
+	INSIST(!ISC_LINK_LINKED(e, hlink));
 
 	e->magic = 0;
 
@@ -2004,8 +1840,8 @@ new_adbaddrinfo(dns_adb_t *adb, dns_adbentry_t *entry, in_port_t port) {
 	ai->magic = DNS_ADBADDRINFO_MAGIC;
 	ai->sockaddr = entry->sockaddr;
 	isc_sockaddr_setport(&ai->sockaddr, port);
-	ai->srtt = entry->srtt;
-	ai->flags = entry->flags;
+	ai->srtt = ADB_GET(entry->srtt);
+	ai->flags = ADB_GET(entry->flags);
 	ai->entry = entry;
 	ai->dscp = -1;
 	ISC_LINK_INIT(ai, publink);
@@ -2041,9 +1877,11 @@ find_name_and_lock(dns_adb_t *adb, dns_name_t *name,
 		   unsigned int options, int *bucketp)
 {
 	dns_adbname_t *adbname;
+	unsigned int hashval;
 	int bucket;
 
-	bucket = dns_name_fullhash(name, false) % adb->nnames;
+	hashval = dns_name_fullhash(name, false);
+	bucket = hashval % adb->nnames;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->namelocks[bucket]);
@@ -2054,17 +1892,24 @@ find_name_and_lock(dns_adb_t *adb, dns_name_t *name,
 		*bucketp = bucket;
 	}
 
-	adbname = ISC_LIST_HEAD(adb->names[bucket]);
+	/*
+	 * Dead names are never on the hash chains.
+	 */
+	adbname = ISC_LIST_HEAD(*NAME_CHAIN(adb, bucket, hashval));
 	while (adbname != NULL) {
-		if (!NAME_DEAD(adbname)) {
-			if (dns_name_equal(name, &adbname->name)
-			    && GLUEHINT_OK(adbname, options)
-			    && STARTATZONE_MATCHES(adbname, options))
-				return (adbname);
+		INSIST(!NAME_DEAD(adbname));
+		if (adbname->hashval == hashval &&
+		    dns_name_equal(name, &adbname->name) &&
+		    GLUEHINT_OK(adbname, options) &&
+		    STARTATZONE_MATCHES(adbname, options))
+		{
+			inc_adbstats(adb, dns_adbstats_namehit);
+			return (adbname);
 		}
-		adbname = ISC_LIST_NEXT(adbname, plink);
+		adbname = ISC_LIST_NEXT(adbname, hlink);
 	}
 
+	inc_adbstats(adb, dns_adbstats_namemiss);
 	return (NULL);
 }
 
@@ -2083,9 +1928,12 @@ find_entry_and_lock(dns_adb_t *adb, isc_sockaddr_t *addr, int *bucketp,
 	isc_stdtime_t now)
 {
 	dns_adbentry_t *entry, *entry_next;
+	isc_stdtime_t expires;
+	unsigned int hashval;
 	int bucket;
 
-	bucket = isc_sockaddr_hash(addr, true) % adb->nentries;
+	hashval = isc_sockaddr_hash(addr, true);
+	bucket = hashval % adb->nentries;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->entrylocks[bucket]);
@@ -2096,21 +1944,26 @@ find_entry_and_lock(dns_adb_t *adb, isc_sockaddr_t *addr, int *bucketp,
 		*bucketp = bucket;
 	}
 
-	/* Search the list, while cleaning up expired entries. */
-	for (entry = ISC_LIST_HEAD(adb->entries[bucket]);
+	/* Search the chain, while cleaning up expired entries. */
+	for (entry = ISC_LIST_HEAD(*ENTRY_CHAIN(adb, bucket, hashval));
 	     entry != NULL;
 	     entry = entry_next) {
-		entry_next = ISC_LIST_NEXT(entry, plink);
+		entry_next = ISC_LIST_NEXT(entry, hlink);
 		(void)check_expire_entry(adb, &entry, now);
-		if (entry != NULL &&
-		    (entry->expires == 0 || entry->expires > now) &&
+		if (entry == NULL)
+			continue;
+		expires = ADB_GET(entry->expires);
+		if (entry->hashval == hashval &&
+		    (expires == 0 || expires > now) &&
 		    isc_sockaddr_equal(addr, &entry->sockaddr)) {
 			ISC_LIST_UNLINK(adb->entries[bucket], entry, plink);
 			ISC_LIST_PREPEND(adb->entries[bucket], entry, plink);
+			inc_adbstats(adb, dns_adbstats_entryhit);
 			return (entry);
 		}
 	}
 
+	inc_adbstats(adb, dns_adbstats_entrymiss);
 	return (NULL);
 }
 
@@ -2387,6 +2240,7 @@ static bool
 check_expire_entry(dns_adb_t *adb, dns_adbentry_t **entryp, isc_stdtime_t now)
 {
 	dns_adbentry_t *entry;
+	isc_stdtime_t expires;
 	bool result = false;
 
 	INSIST(entryp != NULL && DNS_ADBENTRY_VALID(*entryp));
@@ -2395,7 +2249,8 @@ check_expire_entry(dns_adb_t *adb, dns_adbentry_t **entryp, isc_stdtime_t now)
 	if (entry->refcnt != 0)
 		return (result);
 
-	if (entry->expires == 0 || entry->expires > now)
+	expires = ADB_GET(entry->expires);
+	if (expires == 0 || expires > now)
 		return (result);
 
 	/*
@@ -2463,13 +2318,59 @@ cleanup_entries(dns_adb_t *adb, int bucket, isc_stdtime_t now) {
 	return (result);
 }
 
+/*
+ * Free the per-bucket hash tables, and the arrays that describe them.
+ * Tolerates partially allocated tables, for the benefit of
+ * dns_adb_create()'s error path.
+ */
+static void
+free_tables(dns_adb_t *adb) {
+	unsigned int i;
+
+	if (adb->name_table != NULL) {
+		for (i = 0; i < adb->nnames; i++) {
+			if (adb->name_table[i] == NULL)
+				continue;
+			INSIST(adb->name_hashcnt[i] == 0);
+			isc_mem_put(adb->mctx, adb->name_table[i],
+				    sizeof(dns_adbnamelist_t) *
+				    (1U << adb->name_hashbits[i]));
+		}
+		isc_mem_put(adb->mctx, adb->name_table,
+			    sizeof(*adb->name_table) * adb->nnames);
+	}
+	if (adb->name_hashbits != NULL)
+		isc_mem_put(adb->mctx, adb->name_hashbits,
+			    sizeof(*adb->name_hashbits) * adb->nnames);
+	if (adb->name_hashcnt != NULL)
+		isc_mem_put(adb->mctx, adb->name_hashcnt,
+			    sizeof(*adb->name_hashcnt) * adb->nnames);
+
+	if (adb->entry_table != NULL) {
+		for (i = 0; i < adb->nentries; i++) {
+			if (adb->entry_table[i] == NULL)
+				continue;
+			INSIST(adb->entry_hashcnt[i] == 0);
+			isc_mem_put(adb->mctx, adb->entry_table[i],
+				    sizeof(dns_adbentrylist_t) *
+				    (1U << adb->entry_hashbits[i]));
+		}
+		isc_mem_put(adb->mctx, adb->entry_table,
+			    sizeof(*adb->entry_table) * adb->nentries);
+	}
+	if (adb->entry_hashbits != NULL)
+		isc_mem_put(adb->mctx, adb->entry_hashbits,
+			    sizeof(*adb->entry_hashbits) * adb->nentries);
+	if (adb->entry_hashcnt != NULL)
+		isc_mem_put(adb->mctx, adb->entry_hashcnt,
+			    sizeof(*adb->entry_hashcnt) * adb->nentries);
+}
+
 static void
 destroy(dns_adb_t *adb) {
 	adb->magic = 0;
 
 	isc_task_detach(&adb->task);
-	if (adb->excl != NULL)
-		isc_task_detach(&adb->excl);
 
 	isc_mempool_destroy(&adb->nmp);
 	isc_mempool_destroy(&adb->nhmp);
@@ -2479,6 +2380,8 @@ destroy(dns_adb_t *adb) {
 	isc_mempool_destroy(&adb->aimp);
 	isc_mempool_destroy(&adb->afmp);
 
+	free_tables(adb);
+
 	DESTROYMUTEXBLOCK(adb->entrylocks, adb->nentries);
 	isc_mem_put(adb->mctx, adb->entries,
 		    sizeof(*adb->entries) * adb->nentries);
@@ -2524,7 +2427,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 {
 	dns_adb_t *adb;
 	isc_result_t result;
-	unsigned int i;
+	unsigned int i, j;
 
 	REQUIRE(mem != NULL);
 	REQUIRE(view != NULL);
@@ -2553,7 +2456,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->aimp = NULL;
 	adb->afmp = NULL;
 	adb->task = NULL;
-	adb->excl = NULL;
 	adb->mctx = NULL;
 	adb->view = view;
 	adb->taskmgr = taskmgr;
@@ -2564,17 +2466,17 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->shutting_down = false;
 	ISC_LIST_INIT(adb->whenshutdown);
 
-	adb->nentries = nbuckets[0];
+	adb->nentries = ADB_NBUCKETS;
 	adb->entriescnt = 0;
+	adb->entrychains = 0;
 	adb->entries = NULL;
 	adb->deadentries = NULL;
+	adb->entry_table = NULL;
+	adb->entry_hashbits = NULL;
+	adb->entry_hashcnt = NULL;
 	adb->entry_sd = NULL;
 	adb->entry_refcnt = NULL;
 	adb->entrylocks = NULL;
-	ISC_EVENT_INIT(&adb->growentries, sizeof(adb->growentries), 0, NULL,
-		       DNS_EVENT_ADBGROWENTRIES, grow_entries, adb,
-		       adb, NULL, NULL);
-	adb->growentries_sent = false;
 
 	adb->quota = 0;
 	adb->atr_freq = 0;
@@ -2582,26 +2484,17 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->atr_high = 0.0;
 	adb->atr_discount = 0.0;
 
-	adb->nnames = nbuckets[0];
+	adb->nnames = ADB_NBUCKETS;
 	adb->namescnt = 0;
+	adb->namechains = 0;
 	adb->names = NULL;
 	adb->deadnames = NULL;
+	adb->name_table = NULL;
+	adb->name_hashbits = NULL;
+	adb->name_hashcnt = NULL;
 	adb->name_sd = NULL;
 	adb->name_refcnt = NULL;
 	adb->namelocks = NULL;
-	ISC_EVENT_INIT(&adb->grownames, sizeof(adb->grownames), 0, NULL,
-		       DNS_EVENT_ADBGROWNAMES, grow_names, adb,
-		       adb, NULL, NULL);
-	adb->grownames_sent = false;
-
-	result = isc_taskmgr_excltask(adb->taskmgr, &adb->excl);
-	if (result != ISC_R_SUCCESS) {
-		DP(DEF_LEVEL, "adb: task-exclusive mode unavailable, "
-			      "intializing table sizes to %u\n",
-			      nbuckets[11]);
-		adb->nentries = nbuckets[11];
-		adb->nnames = nbuckets[11];
-	}
 
 	isc_mem_attach(mem, &adb->mctx);
 
@@ -2640,6 +2533,11 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	} while (0)
 	ALLOCENTRY(adb, entries);
 	ALLOCENTRY(adb, deadentries);
+	ALLOCENTRY(adb, entry_table);
+	for (i = 0; i < adb->nentries; i++)
+		adb->entry_table[i] = NULL;
+	ALLOCENTRY(adb, entry_hashbits);
+	ALLOCENTRY(adb, entry_hashcnt);
 	ALLOCENTRY(adb, entrylocks);
 	ALLOCENTRY(adb, entry_sd);
 	ALLOCENTRY(adb, entry_refcnt);
@@ -2656,11 +2554,48 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	} while (0)
 	ALLOCNAME(adb, names);
 	ALLOCNAME(adb, deadnames);
+	ALLOCNAME(adb, name_table);
+	for (i = 0; i < adb->nnames; i++)
+		adb->name_table[i] = NULL;
+	ALLOCNAME(adb, name_hashbits);
+	ALLOCNAME(adb, name_hashcnt);
 	ALLOCNAME(adb, namelocks);
 	ALLOCNAME(adb, name_sd);
 	ALLOCNAME(adb, name_refcnt);
 #undef ALLOCNAME
 
+	/*
+	 * Allocate the smallest hash table for each bucket.
+	 */
+	for (i = 0; i < adb->nnames; i++) {
+		adb->name_table[i] = isc_mem_get(adb->mctx,
+					sizeof(dns_adbnamelist_t) *
+					(1U << ADB_HASHBITS_MIN));
+		if (adb->name_table[i] == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto fail1;
+		}
+		for (j = 0; j < (1U << ADB_HASHBITS_MIN); j++)
+			ISC_LIST_INIT(adb->name_table[i][j]);
+		adb->name_hashbits[i] = ADB_HASHBITS_MIN;
+		adb->name_hashcnt[i] = 0;
+		adb->namechains += 1U << ADB_HASHBITS_MIN;
+	}
+	for (i = 0; i < adb->nentries; i++) {
+		adb->entry_table[i] = isc_mem_get(adb->mctx,
+					sizeof(dns_adbentrylist_t) *
+					(1U << ADB_HASHBITS_MIN));
+		if (adb->entry_table[i] == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto fail1;
+		}
+		for (j = 0; j < (1U << ADB_HASHBITS_MIN); j++)
+			ISC_LIST_INIT(adb->entry_table[i][j]);
+		adb->entry_hashbits[i] = ADB_HASHBITS_MIN;
+		adb->entry_hashcnt[i] = 0;
+		adb->entrychains += 1U << ADB_HASHBITS_MIN;
+	}
+
 	/*
 	 * Initialize the bucket locks for names and elements.
 	 * May as well initialize the list heads, too.
@@ -2722,8 +2657,8 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	if (result != ISC_R_SUCCESS)
 		goto fail3;
 
-	set_adbstat(adb, adb->nentries, dns_adbstats_nentries);
-	set_adbstat(adb, adb->nnames, dns_adbstats_nnames);
+	set_adbstat(adb, adb->entrychains, dns_adbstats_nentries);
+	set_adbstat(adb, adb->namechains, dns_adbstats_nnames);
 
 	/*
 	 * Normal return.
@@ -2743,6 +2678,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
 
  fail1: /* clean up only allocated memory */
+	free_tables(adb);
 	if (adb->entries != NULL)
 		isc_mem_put(adb->mctx, adb->entries,
 			    sizeof(*adb->entries) * adb->nentries);
@@ -2800,8 +2736,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
  fail0c:
 	DESTROYLOCK(&adb->lock);
  fail0b:
-	if (adb->excl != NULL)
-		isc_task_detach(&adb->excl);
 	isc_mem_putanddetach(&adb->mctx, adb, sizeof(dns_adb_t));
 
 	return (result);
@@ -3540,11 +3474,12 @@ dump_entry(FILE *f, dns_adb_t *adb, dns_adbentry_t *entry,
 		fprintf(f, ";\t%p: refcnt %u\n", entry, entry->refcnt);
 
 	fprintf(f, ";\t%s [srtt %u] [flags %08x] [edns %u/%u/%u/%u/%u] "
-		"[plain %u/%u]", addrbuf, entry->srtt, entry->flags,
+		"[plain %u/%u]", addrbuf, ADB_GET(entry->srtt),
+		ADB_GET(entry->flags),
 		entry->edns, entry->to4096, entry->to1432, entry->to1232,
 		entry->to512, entry->plain, entry->plainto);
-	if (entry->udpsize != 0U)
-		fprintf(f, " [udpsize %u]", entry->udpsize);
+	if (ADB_GET(entry->udpsize) != 0U)
+		fprintf(f, " [udpsize %u]", ADB_GET(entry->udpsize));
 	if (entry->cookie != NULL) {
 		unsigned int i;
 		fprintf(f, " [cookie=");
@@ -3552,8 +3487,9 @@ dump_entry(FILE *f, dns_adb_t *adb, dns_adbentry_t *entry,
 			fprintf(f, "%02x", entry->cookie[i]);
 		fprintf(f, "]");
 	}
-	if (entry->expires != 0)
-		fprintf(f, " [ttl %d]", (int)(entry->expires - now));
+	if (ADB_GET(entry->expires) != 0)
+		fprintf(f, " [ttl %d]",
+			(int)(ADB_GET(entry->expires) - now));
 
 	if (adb != NULL && adb->quota != 0 && adb->atr_freq != 0) {
 		fprintf(f, " [atr %0.2f] [quota %u]",
@@ -4121,69 +4057,117 @@ void
 dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		   unsigned int rtt, unsigned int factor)
 {
+#ifndef ADB_ATOMIC
 	int bucket;
+#endif
 	isc_stdtime_t now = 0;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 	REQUIRE(factor <= 10);
 
+#ifndef ADB_ATOMIC
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
+#endif
 
-	if (addr->entry->expires == 0 || factor == DNS_ADB_RTTADJAGE)
+	if (ADB_GET(addr->entry->expires) == 0 ||
+	    factor == DNS_ADB_RTTADJAGE)
 		isc_stdtime_get(&now);
 	adjustsrtt(addr, rtt, factor, now);
 
+#ifndef ADB_ATOMIC
 	UNLOCK(&adb->entrylocks[bucket]);
+#endif
 }
 
 void
 dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
+#ifndef ADB_ATOMIC
 	int bucket;
+#endif
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
+#ifndef ADB_ATOMIC
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
+#endif
 
 	adjustsrtt(addr, 0, DNS_ADB_RTTADJAGE, now);
 
+#ifndef ADB_ATOMIC
 	UNLOCK(&adb->entrylocks[bucket]);
+#endif
+}
+
+/*
+ * Give 'entry' an expiry time, unless it already has one.
+ */
+static inline void
+set_entry_expires(dns_adbentry_t *entry, isc_stdtime_t now) {
+	uint_fast32_t expires = 0;
+
+	while (expires == 0 &&
+	       !ADB_CAS(entry->expires, expires, now + ADB_ENTRY_WINDOW))
+		;
 }
 
+/*
+ * Without atomics the entry bucket must be locked.  With them, the new
+ * srtt is computed from the value it replaces, and retried if another
+ * thread got in first, so concurrent updates are never lost.
+ */
 static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now)
 {
+	dns_adbentry_t *entry = addr->entry;
+	uint_fast32_t old_srtt, lastage;
 	uint64_t new_srtt;
 
+	old_srtt = ADB_GET(entry->srtt);
+
 	if (factor == DNS_ADB_RTTADJAGE) {
-		if (addr->entry->lastage != now) {
-			new_srtt = addr->entry->srtt;
+		/*
+		 * Only the caller that moves 'lastage' on to 'now' ages
+		 * the entry, so it is aged at most once a second.
+		 */
+		lastage = ADB_GET(entry->lastage);
+		if (lastage == now ||
+		    !ADB_CAS(entry->lastage, lastage, now))
+		{
+			addr->srtt = (unsigned int)old_srtt;
+			goto expires;
+		}
+	}
+
+	do {
+		if (factor == DNS_ADB_RTTADJAGE) {
+			new_srtt = old_srtt;
 			new_srtt <<= 9;
-			new_srtt -= addr->entry->srtt;
+			new_srtt -= old_srtt;
 			new_srtt >>= 9;
-			addr->entry->lastage = now;
 		} else
-			new_srtt = addr->entry->srtt;
-	} else
-		new_srtt = ((uint64_t)addr->entry->srtt / 10 * factor)
-			+ ((uint64_t)rtt / 10 * (10 - factor));
+			new_srtt = ((uint64_t)old_srtt / 10 * factor)
+				+ ((uint64_t)rtt / 10 * (10 - factor));
+	} while (!ADB_CAS(entry->srtt, old_srtt, (unsigned int)new_srtt));
 
-	addr->entry->srtt = (unsigned int) new_srtt;
 	addr->srtt = (unsigned int) new_srtt;
 
-	if (addr->entry->expires == 0)
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+ expires:
+	set_entry_expires(entry, now);
 }
 
 void
 dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		    unsigned int bits, unsigned int mask)
 {
+#ifndef ADB_ATOMIC
 	int bucket;
+#endif
+	uint_fast32_t flags;
 	isc_stdtime_t now;
 
 	REQUIRE(DNS_ADB_VALID(adb));
@@ -4192,13 +4176,22 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	REQUIRE((bits & ENTRY_IS_DEAD) == 0);
 	REQUIRE((mask & ENTRY_IS_DEAD) == 0);
 
+#ifndef ADB_ATOMIC
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
+#endif
 
-	addr->entry->flags = (addr->entry->flags & ~mask) | (bits & mask);
-	if (addr->entry->expires == 0) {
+	/*
+	 * ENTRY_IS_DEAD is outside 'mask', so a concurrent kill under the
+	 * bucket lock is preserved.
+	 */
+	flags = ADB_GET(addr->entry->flags);
+	while (!ADB_CAS(addr->entry->flags, flags,
+			(flags & ~mask) | (bits & mask)))
+		;
+	if (ADB_GET(addr->entry->expires) == 0) {
 		isc_stdtime_get(&now);
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+		set_entry_expires(addr->entry, now);
 	}
 
 	/*
@@ -4207,7 +4200,9 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	 */
 	addr->flags = (addr->flags & ~mask) | (bits & mask);
 
+#ifndef ADB_ATOMIC
 	UNLOCK(&adb->entrylocks[bucket]);
+#endif
 }
 
 /*
@@ -4431,6 +4426,7 @@ dns_adb_ednsto(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int size) {
 
 void
 dns_adb_setudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int size) {
+	uint_fast32_t udpsize;
 	int bucket;
 
 	REQUIRE(DNS_ADB_VALID(adb));
@@ -4440,8 +4436,10 @@ dns_adb_setudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int size) {
 	LOCK(&adb->entrylocks[bucket]);
 	if (size < 512U)
 		size = 512U;
-	if (size > addr->entry->udpsize)
-		addr->entry->udpsize = size;
+	udpsize = ADB_GET(addr->entry->udpsize);
+	while (size > udpsize &&
+	       !ADB_CAS(addr->entry->udpsize, udpsize, size))
+		;
 
 	maybe_adjust_quota(adb, addr, false);
 
@@ -4460,16 +4458,22 @@ dns_adb_setudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int size) {
 
 unsigned int
 dns_adb_getudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
+#ifndef ADB_ATOMIC
 	int bucket;
+#endif
 	unsigned int size;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
+#ifndef ADB_ATOMIC
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
-	size = addr->entry->udpsize;
+#endif
+	size = ADB_GET(addr->entry->udpsize);
+#ifndef ADB_ATOMIC
 	UNLOCK(&adb->entrylocks[bucket]);
+#endif
 
 	return (size);
 }
@@ -4502,8 +4506,9 @@ dns_adb_probesize2(dns_adb_t *adb, dns_adbaddrinfo_t *addr, int lookups) {
 	 * lookups.
 	 */
 	if (lookups > 0 &&
-	    size < addr->entry->udpsize && addr->entry->udpsize < 4096)
-		size = addr->entry->udpsize;
+	    size < ADB_GET(addr->entry->udpsize) &&
+	    ADB_GET(addr->entry->udpsize) < 4096)
+		size = ADB_GET(addr->entry->udpsize);
 	UNLOCK(&adb->entrylocks[bucket]);
 
 	return (size);
@@ -4638,9 +4643,9 @@ dns_adb_freeaddrinfo(dns_adb_t *adb, dns_adbaddrinfo_t **addrp) {
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
 
-	if (entry->expires == 0) {
+	if (ADB_GET(entry->expires) == 0) {
 		isc_stdtime_get(&now);
-		entry->expires = now + ADB_ENTRY_WINDOW;
+		set_entry_expires(entry, now);
 	}
 
 	want_check_exit = dec_entry_refcnt(adb, overmem, entry, false);
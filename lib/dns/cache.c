@@ -17,6 +17,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/file.h>
 #include <isc/json.h>
 #include <isc/mem.h>
 #include <isc/print.h>
@@ -29,11 +30,13 @@
 #include <isc/xml.h>
 
 #include <dns/cache.h>
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/events.h>
 #include <dns/lib.h>
 #include <dns/log.h>
+#include <dns/master.h>
 #include <dns/masterdump.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
@@ -138,13 +141,28 @@ struct dns_cache {
 	int			db_argc;
 	char			**db_argv;
 	size_t			size;
+	unsigned int		expected_names;
 	isc_stats_t		*stats;
+	dns_loadctx_t		*loadctx;	/*%< Snapshot load */
 
 	/* Locked by 'filelock'. */
 	char			*filename;
+	char			*snapshot;
 	/* Access to the on-disk cache file is also locked by 'filelock'. */
 };
 
+/*%
+ * State of a snapshot load in progress.  While it exists, the cache
+ * holds a reference to the load context and will not be freed.
+ */
+typedef struct cache_load {
+	dns_cache_t		*cache;
+	dns_db_t		*db;
+	dns_rdatacallbacks_t	callbacks;
+	isc_stdtime_t		now;
+	unsigned int		loaded;
+} cache_load_t;
+
 /***
  ***	Functions
  ***/
@@ -238,6 +256,7 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	cache->references = 1;
 	cache->live_tasks = 0;
 	cache->rdclass = rdclass;
+	cache->expected_names = 0;
 
 	cache->stats = NULL;
 	result = isc_stats_create(cmctx, &cache->stats,
@@ -303,6 +322,8 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	}
 
 	cache->filename = NULL;
+	cache->snapshot = NULL;
+	cache->loadctx = NULL;
 
 	cache->magic = CACHE_MAGIC;
 
@@ -375,11 +396,18 @@ cache_free(dns_cache_t *cache) {
 
 	DESTROYLOCK(&cache->cleaner.lock);
 
+	INSIST(cache->loadctx == NULL);
+
 	if (cache->filename) {
 		isc_mem_free(cache->mctx, cache->filename);
 		cache->filename = NULL;
 	}
 
+	if (cache->snapshot != NULL) {
+		isc_mem_free(cache->mctx, cache->snapshot);
+		cache->snapshot = NULL;
+	}
+
 	if (cache->db != NULL)
 		dns_db_detach(&cache->db);
 
@@ -432,7 +460,9 @@ dns_cache_attach(dns_cache_t *cache, dns_cache_t **targetp) {
 void
 dns_cache_detach(dns_cache_t **cachep) {
 	dns_cache_t *cache;
+	isc_result_t result;
 	bool free_cache = false;
+	bool snapshot = false;
 
 	REQUIRE(cachep != NULL);
 	cache = *cachep;
@@ -444,29 +474,61 @@ dns_cache_detach(dns_cache_t **cachep) {
 	if (cache->references == 0) {
 		cache->cleaner.overmem = false;
 		free_cache = true;
+		/*
+		 * Write a snapshot for the next start, unless the last
+		 * one has not even been loaded completely: then stop
+		 * loading it below and leave the file alone.
+		 */
+		snapshot = (cache->loadctx == NULL);
+		/*
+		 * Count the dump as a live task, so that neither the
+		 * cleaner nor a snapshot load finishing meanwhile frees
+		 * the cache while it is written without the lock held.
+		 */
+		cache->live_tasks++;
 	}
+	UNLOCK(&cache->lock);
 
 	*cachep = NULL;
 
-	if (free_cache) {
-		/*
-		 * When the cache is shut down, dump it to a file if one is
-		 * specified.
-		 */
-		isc_result_t result = dns_cache_dump(cache);
+	if (!free_cache)
+		return;
+
+	/*
+	 * When the cache is shut down, dump it to a file if one is
+	 * specified.
+	 */
+	result = dns_cache_dump(cache);
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_WARNING,
+			      "error dumping cache: %s ",
+			      isc_result_totext(result));
+
+	if (snapshot) {
+		result = dns_cache_dumpsnapshot(cache);
 		if (result != ISC_R_SUCCESS)
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
 				      DNS_LOGMODULE_CACHE, ISC_LOG_WARNING,
-				      "error dumping cache: %s ",
+				      "error writing cache snapshot: %s",
 				      isc_result_totext(result));
+	}
 
-		/*
-		 * If the cleaner task exists, let it free the cache.
-		 */
-		if (cache->live_tasks > 0) {
-			isc_task_shutdown(cache->cleaner.task);
-			free_cache = false;
-		}
+	LOCK(&cache->lock);
+	cache->live_tasks--;
+
+	if (cache->loadctx != NULL) {
+		dns_loadctx_cancel(cache->loadctx);
+		free_cache = false;
+	}
+
+	/*
+	 * If the cleaner task exists, or a snapshot load has yet to
+	 * finish, let them free the cache.
+	 */
+	if (cache->live_tasks > 0) {
+		isc_task_shutdown(cache->cleaner.task);
+		free_cache = false;
 	}
 
 	UNLOCK(&cache->lock);
@@ -540,6 +602,193 @@ dns_cache_dump(dns_cache_t *cache) {
 
 }
 
+isc_result_t
+dns_cache_setsnapshot(dns_cache_t *cache, const char *filename) {
+	char *newname = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	if (filename != NULL) {
+		newname = isc_mem_strdup(cache->mctx, filename);
+		if (newname == NULL)
+			return (ISC_R_NOMEMORY);
+	}
+
+	LOCK(&cache->filelock);
+	if (cache->snapshot != NULL)
+		isc_mem_free(cache->mctx, cache->snapshot);
+	cache->snapshot = newname;
+	UNLOCK(&cache->filelock);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+snapshot_add(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
+	cache_load_t *load = arg;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	result = dns_db_findnode(load->db, name, true, &node);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	/*
+	 * This goes through the normal locked insertion path, so the
+	 * trust level decides between the snapshot and anything the
+	 * resolver has cached in the meantime.
+	 */
+	result = dns_db_addrdataset(load->db, node, NULL, load->now,
+				    rdataset, 0, NULL);
+	dns_db_detachnode(load->db, &node);
+
+	if (result == ISC_R_SUCCESS)
+		load->loaded++;
+	else if (result == DNS_R_UNCHANGED)
+		result = ISC_R_SUCCESS;
+
+	return (result);
+}
+
+static void
+snapshot_logdone(cache_load_t *load, isc_result_t result) {
+	if (result == ISC_R_SUCCESS) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_INFO,
+			      "cache '%s': loaded %u RRsets from snapshot",
+			      load->cache->name, load->loaded);
+	} else if (result == ISC_R_CANCELED) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_INFO,
+			      "cache '%s': loading snapshot canceled after "
+			      "%u RRsets", load->cache->name, load->loaded);
+	} else {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_WARNING,
+			      "cache '%s': loading snapshot failed after "
+			      "%u RRsets: %s", load->cache->name,
+			      load->loaded, isc_result_totext(result));
+	}
+}
+
+static void
+snapshot_loaded(void *arg, isc_result_t result) {
+	cache_load_t *load = arg;
+	dns_cache_t *cache = load->cache;
+	bool should_free = false;
+
+	snapshot_logdone(load, result);
+
+	LOCK(&cache->lock);
+	INSIST(cache->loadctx != NULL);
+	dns_loadctx_detach(&cache->loadctx);
+	if (cache->references == 0 && cache->live_tasks == 0)
+		should_free = true;
+	UNLOCK(&cache->lock);
+
+	dns_db_detach(&load->db);
+	isc_mem_put(cache->mctx, load, sizeof(*load));
+
+	if (should_free)
+		cache_free(cache);
+}
+
+isc_result_t
+dns_cache_loadsnapshot(dns_cache_t *cache, isc_task_t *task) {
+	cache_load_t *load;
+	dns_loadctx_t *lctx = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+	bool started = false;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	load = isc_mem_get(cache->mctx, sizeof(*load));
+	if (load == NULL)
+		return (ISC_R_NOMEMORY);
+	load->cache = cache;
+	load->db = NULL;
+	load->loaded = 0;
+	isc_stdtime_get(&load->now);
+	dns_rdatacallbacks_init(&load->callbacks);
+	load->callbacks.add = snapshot_add;
+	load->callbacks.add_private = load;
+
+	LOCK(&cache->lock);
+	if (cache->loadctx != NULL) {
+		UNLOCK(&cache->lock);
+		isc_mem_put(cache->mctx, load, sizeof(*load));
+		return (ISC_R_INPROGRESS);
+	}
+	dns_db_attach(cache->db, &load->db);
+
+	LOCK(&cache->filelock);
+	if (cache->snapshot == NULL || !isc_file_exists(cache->snapshot)) {
+		/* Nothing to load. */
+	} else if (task == NULL) {
+		/*
+		 * Without a task, load synchronously; the cache lock
+		 * need not be held for that.
+		 */
+		UNLOCK(&cache->lock);
+		result = dns_master_loadfile2(cache->snapshot,
+					      dns_db_origin(load->db),
+					      dns_db_origin(load->db),
+					      cache->rdclass,
+					      DNS_MASTER_AGETTL,
+					      &load->callbacks, cache->mctx,
+					      dns_masterformat_raw);
+		UNLOCK(&cache->filelock);
+		snapshot_logdone(load, result);
+		goto cleanup;
+	} else {
+		result = dns_master_loadfileinc2(cache->snapshot,
+						 dns_db_origin(load->db),
+						 dns_db_origin(load->db),
+						 cache->rdclass,
+						 DNS_MASTER_AGETTL,
+						 &load->callbacks, task,
+						 snapshot_loaded, load, &lctx,
+						 cache->mctx,
+						 dns_masterformat_raw);
+		if (result == DNS_R_CONTINUE) {
+			/*
+			 * snapshot_loaded() cannot run before we release
+			 * the cache lock, so it will find 'loadctx' set.
+			 */
+			cache->loadctx = lctx;
+			started = true;
+		}
+	}
+	UNLOCK(&cache->filelock);
+	UNLOCK(&cache->lock);
+
+	if (started)
+		return (result);
+
+ cleanup:
+	dns_db_detach(&load->db);
+	isc_mem_put(cache->mctx, load, sizeof(*load));
+	return (result);
+}
+
+isc_result_t
+dns_cache_dumpsnapshot(dns_cache_t *cache) {
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->filelock);
+	if (cache->snapshot != NULL) {
+		result = dns_master_dump2(cache->mctx, cache->db, NULL,
+					  &dns_master_style_cache,
+					  cache->snapshot,
+					  dns_masterformat_raw);
+	}
+	UNLOCK(&cache->filelock);
+
+	return (result);
+}
+
 void
 dns_cache_setcleaninginterval(dns_cache_t *cache, unsigned int t) {
 	isc_interval_t interval;
@@ -1079,6 +1328,22 @@ dns_cache_setcachesize(dns_cache_t *cache, size_t size) {
 		isc_mem_setwater(cache->mctx, water, cache, hiwater, lowater);
 }
 
+void
+dns_cache_setexpectednames(dns_cache_t *cache, unsigned int names) {
+	dns_db_t *db = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->expected_names = names;
+	dns_db_attach(cache->db, &db);
+	UNLOCK(&cache->lock);
+
+	if (names != 0U)
+		dns_db_adjusthashsize(db, names);
+	dns_db_detach(&db);
+}
+
 size_t
 dns_cache_getcachesize(dns_cache_t *cache) {
 	size_t size;
@@ -1112,10 +1377,12 @@ cleaner_shutdown_action(isc_task_t *task, isc_event_t *event) {
 
 	LOCK(&cache->lock);
 
+	/*
+	 * dns_cache_detach() may still be dumping the cache.
+	 */
 	cache->live_tasks--;
-	INSIST(cache->live_tasks == 0);
-
-	if (cache->references == 0)
+	if (cache->references == 0 && cache->live_tasks == 0 &&
+	    cache->loadctx == NULL)
 		should_free = true;
 
 	/*
@@ -1139,12 +1406,19 @@ isc_result_t
 dns_cache_flush(dns_cache_t *cache) {
 	dns_db_t *db = NULL, *olddb;
 	dns_dbiterator_t *dbiterator = NULL, *olddbiterator = NULL;
+	unsigned int names;
 	isc_result_t result;
 
 	result = cache_create_db(cache, &db);
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
+	LOCK(&cache->lock);
+	names = cache->expected_names;
+	UNLOCK(&cache->lock);
+	if (names != 0U)
+		dns_db_adjusthashsize(db, names);
+
 	result = dns_db_createiterator(db, false, &dbiterator);
 	if (result != ISC_R_SUCCESS) {
 		dns_db_detach(&db);
@@ -1166,6 +1440,8 @@ dns_cache_flush(dns_cache_t *cache) {
 	cache->db = db;
 	dns_db_setcachestats(cache->db, cache->stats);
 	UNLOCK(&cache->cleaner.lock);
+	if (cache->loadctx != NULL)
+		dns_loadctx_cancel(cache->loadctx);
 	UNLOCK(&cache->lock);
 
 	if (dbiterator != NULL)
@@ -1381,10 +1657,47 @@ getcounters(isc_stats_t *stats, isc_statsformat_t type, int ncounters,
 	isc_stats_dump(stats, getcounter, &dumparg, ISC_STATSDUMP_VERBOSE);
 }
 
+/*
+ * Get the number of times each node lock of the cache database had to
+ * be waited for.  '*waitsp' is set to NULL if the database keeps no
+ * such statistics; otherwise it must be freed by freenodelockwaits().
+ */
+static void
+getnodelockwaits(dns_cache_t *cache, uint64_t **waitsp,
+		 unsigned int *countp, uint64_t *totalp)
+{
+	uint64_t *waits = NULL, total = 0;
+	unsigned int count, i;
+
+	count = dns_db_nodelockstats(cache->db, NULL, 0);
+	if (count != 0)
+		waits = isc_mem_get(cache->mctx, count * sizeof(*waits));
+	if (waits != NULL) {
+		count = ISC_MIN(count, dns_db_nodelockstats(cache->db,
+							    waits, count));
+		for (i = 0; i < count; i++)
+			total += waits[i];
+	}
+
+	*waitsp = waits;
+	*countp = count;
+	*totalp = total;
+}
+
+static void
+freenodelockwaits(dns_cache_t *cache, uint64_t **waitsp, unsigned int count) {
+	if (*waitsp != NULL) {
+		isc_mem_put(cache->mctx, *waitsp, count * sizeof(**waitsp));
+		*waitsp = NULL;
+	}
+}
+
 void
 dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	int indices[dns_cachestatscounter_max];
 	uint64_t values[dns_cachestatscounter_max];
+	uint64_t *waits, totalwaits;
+	unsigned int nodelocks;
 
 	REQUIRE(VALID_CACHE(cache));
 
@@ -1415,6 +1728,15 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 		(uint64_t) dns_db_hashsize(cache->db),
 		"cache database hash buckets");
 
+	getnodelockwaits(cache, &waits, &nodelocks, &totalwaits);
+	if (waits != NULL) {
+		fprintf(fp, "%20u %s\n", nodelocks,
+			"cache database node locks");
+		fprintf(fp, "%20" PRIu64 " %s\n", totalwaits,
+			"cache database node lock waits");
+		freenodelockwaits(cache, &waits, nodelocks);
+	}
+
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		(uint64_t) isc_mem_total(cache->mctx),
 		"cache tree memory total");
@@ -1458,6 +1780,9 @@ int
 dns_cache_renderxml(dns_cache_t *cache, xmlTextWriterPtr writer) {
 	int indices[dns_cachestatscounter_max];
 	uint64_t values[dns_cachestatscounter_max];
+	uint64_t *waits = NULL, totalwaits;
+	unsigned int i, nodelocks = 0;
+	char name[sizeof("NodeLockWaits") + 10];
 	int xmlrc;
 
 	REQUIRE(VALID_CACHE(cache));
@@ -1480,6 +1805,16 @@ dns_cache_renderxml(dns_cache_t *cache, xmlTextWriterPtr writer) {
 	TRY0(renderstat("CacheNodes", dns_db_nodecount(cache->db), writer));
 	TRY0(renderstat("CacheBuckets", dns_db_hashsize(cache->db), writer));
 
+	getnodelockwaits(cache, &waits, &nodelocks, &totalwaits);
+	if (waits != NULL) {
+		TRY0(renderstat("NodeLocks", nodelocks, writer));
+		TRY0(renderstat("NodeLockWaits", totalwaits, writer));
+		for (i = 0; i < nodelocks; i++) {
+			snprintf(name, sizeof(name), "NodeLockWaits%u", i);
+			TRY0(renderstat(name, waits[i], writer));
+		}
+	}
+
 	TRY0(renderstat("TreeMemTotal", isc_mem_total(cache->mctx), writer));
 	TRY0(renderstat("TreeMemInUse", isc_mem_inuse(cache->mctx), writer));
 	TRY0(renderstat("TreeMemMax", isc_mem_maxinuse(cache->mctx), writer));
@@ -1488,6 +1823,7 @@ dns_cache_renderxml(dns_cache_t *cache, xmlTextWriterPtr writer) {
 	TRY0(renderstat("HeapMemInUse", isc_mem_inuse(cache->hmctx), writer));
 	TRY0(renderstat("HeapMemMax", isc_mem_maxinuse(cache->hmctx), writer));
 error:
+	freenodelockwaits(cache, &waits, nodelocks);
 	return (xmlrc);
 }
 #endif
@@ -1505,7 +1841,9 @@ dns_cache_renderjson(dns_cache_t *cache, json_object *cstats) {
 	isc_result_t result = ISC_R_SUCCESS;
 	int indices[dns_cachestatscounter_max];
 	uint64_t values[dns_cachestatscounter_max];
-	json_object *obj;
+	uint64_t *waits = NULL, totalwaits;
+	unsigned int i, nodelocks = 0;
+	json_object *obj, *array;
 
 	REQUIRE(VALID_CACHE(cache));
 
@@ -1544,6 +1882,26 @@ dns_cache_renderjson(dns_cache_t *cache, json_object *cstats) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CacheBuckets", obj);
 
+	getnodelockwaits(cache, &waits, &nodelocks, &totalwaits);
+	if (waits != NULL) {
+		obj = json_object_new_int64(nodelocks);
+		CHECKMEM(obj);
+		json_object_object_add(cstats, "NodeLocks", obj);
+
+		obj = json_object_new_int64(totalwaits);
+		CHECKMEM(obj);
+		json_object_object_add(cstats, "NodeLockWaits", obj);
+
+		array = json_object_new_array();
+		CHECKMEM(array);
+		json_object_object_add(cstats, "NodeLockWaitsPerLock", array);
+		for (i = 0; i < nodelocks; i++) {
+			obj = json_object_new_int64(waits[i]);
+			CHECKMEM(obj);
+			json_object_array_add(array, obj);
+		}
+	}
+
 	obj = json_object_new_int64(isc_mem_total(cache->mctx));
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "TreeMemTotal", obj);
@@ -1570,6 +1928,7 @@ dns_cache_renderjson(dns_cache_t *cache, json_object *cstats) {
 
 	result = ISC_R_SUCCESS;
 error:
+	freenodelockwaits(cache, &waits, nodelocks);
 	return (result);
 }
 #endif
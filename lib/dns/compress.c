@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/string.h>
 #include <isc/util.h>
@@ -35,15 +36,19 @@
 
 #define TABLE_READY							\
 	do {								\
-		unsigned int i;						\
-									\
-		if ((cctx->allowed & DNS_COMPRESS_READY) == 0) {	\
-			cctx->allowed |= DNS_COMPRESS_READY;		\
-			for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++)	\
-				cctx->table[i] = NULL;			\
-		}							\
+		if ((cctx->allowed & DNS_COMPRESS_READY) == 0)		\
+			table_ready(cctx);				\
 	} while (0)
 
+/*
+ * The largest number of nodes: every suffix in the table starts at a
+ * distinct offset below 0x4000, so this is never reached in practice.
+ */
+#define MAXNODES	0x4000
+
+#define SLOT_TAG(hash)	((hash) & 0xffff0000U)
+#define SLOT_NODE(slot)	((slot) & 0x0000ffffU)
+
 /***
  ***	Compression
  ***/
@@ -63,24 +68,17 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 
 void
 dns_compress_invalidate(dns_compress_t *cctx) {
-	dns_compressnode_t *node;
-	unsigned int i;
-
 	REQUIRE(VALID_CCTX(cctx));
 
 	if ((cctx->allowed & DNS_COMPRESS_READY) != 0) {
-		for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-			while (cctx->table[i] != NULL) {
-				node = cctx->table[i];
-				cctx->table[i] = cctx->table[i]->next;
-				if ((node->offset & 0x8000) != 0)
-					isc_mem_put(cctx->mctx, node->r.base,
-						    node->r.length);
-				if (node->count < DNS_COMPRESS_INITIALNODES)
-					continue;
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			}
-		}
+		if (cctx->table != cctx->initialtable)
+			isc_mem_put(cctx->mctx, cctx->table,
+				    cctx->tablesize * sizeof(cctx->table[0]));
+		if (cctx->nodes != cctx->initialnodes)
+			isc_mem_put(cctx->mctx, cctx->nodes,
+				    cctx->nodessize * sizeof(cctx->nodes[0]));
+		if (cctx->data != cctx->initialdata)
+			isc_mem_put(cctx->mctx, cctx->data, cctx->datasize);
 	}
 	cctx->magic = 0;
 	cctx->allowed = 0;
@@ -130,13 +128,204 @@ dns_compress_getedns(dns_compress_t *cctx) {
 	return (cctx->edns);
 }
 
-#define NODENAME(node, name) \
-do { \
-	(name)->length = (node)->r.length; \
-	(name)->labels = (node)->labels; \
-	(name)->ndata = (node)->r.base; \
-	(name)->attributes = DNS_NAMEATTR_ABSOLUTE; \
-} while (0)
+static void
+table_ready(dns_compress_t *cctx) {
+	cctx->allowed |= DNS_COMPRESS_READY;
+	memset(cctx->initialtable, 0, sizeof(cctx->initialtable));
+	cctx->table = cctx->initialtable;
+	cctx->tablesize = DNS_COMPRESS_INITIALSLOTS;
+	cctx->nodes = cctx->initialnodes;
+	cctx->nodessize = DNS_COMPRESS_INITIALNODES;
+	cctx->data = cctx->initialdata;
+	cctx->datasize = DNS_COMPRESS_INITIALDATA;
+	cctx->dataused = 0;
+}
+
+/*
+ * Compute the hash of each suffix of 'name' but the root name, storing
+ * the offset of its first label in offsets[] and its hash in hashes[].
+ * Labels are hashed case-insensitively from the root towards the first
+ * label, so each suffix hash extends the one that follows it.  Returns
+ * the number of labels in 'name'.
+ */
+static inline unsigned int
+suffix_hashes(const dns_name_t *name, unsigned char *offsets,
+	      uint32_t *hashes)
+{
+	const unsigned char *ndata = name->ndata;
+	unsigned int labels = name->labels;
+	unsigned int i, o;
+	uint32_t hash;
+
+	INSIST(labels > 0 && labels <= sizeof(dns_offsets_t));
+
+	if (name->offsets != NULL) {
+		memmove(offsets, name->offsets, labels);
+	} else {
+		for (i = 0, o = 0; i < labels; i++) {
+			offsets[i] = o;
+			o += ndata[o] + 1;
+		}
+	}
+
+	hash = isc_hash_function(NULL, 0, false, NULL);
+	for (i = labels - 1; i-- > 0; ) {
+		o = offsets[i];
+		hash = isc_hash_function(ndata + o, ndata[o] + 1, false,
+					 &hash);
+		hashes[i] = hash;
+	}
+
+	return (labels);
+}
+
+/*
+ * Compare the name data of two suffixes of equal length.  Label length
+ * octets are below 'A', so they can be case folded with the rest.
+ */
+static inline bool
+suffix_equal(const unsigned char *a, const unsigned char *b,
+	     unsigned int length, bool sensitive)
+{
+	unsigned int i;
+	unsigned char ca, cb;
+
+	if (memcmp(a, b, length) == 0)
+		return (true);
+	if (sensitive)
+		return (false);
+	for (i = 0; i < length; i++) {
+		ca = a[i];
+		cb = b[i];
+		if (ca >= 'A' && ca <= 'Z')
+			ca += 'a' - 'A';
+		if (cb >= 'A' && cb <= 'Z')
+			cb += 'a' - 'A';
+		if (ca != cb)
+			return (false);
+	}
+	return (true);
+}
+
+/*
+ * Find the node for the suffix with hash 'hash', name data 'ndata',
+ * 'length' octets and 'labels' labels.
+ */
+static inline dns_compressnode_t *
+table_find(dns_compress_t *cctx, uint32_t hash, const unsigned char *ndata,
+	   unsigned int length, unsigned int labels)
+{
+	unsigned int mask = cctx->tablesize - 1;
+	unsigned int i = hash & mask;
+	bool sensitive = ((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0);
+	dns_compressnode_t *node;
+	uint32_t slot;
+
+	while ((slot = cctx->table[i]) != 0) {
+		if (SLOT_TAG(slot) == SLOT_TAG(hash)) {
+			node = &cctx->nodes[SLOT_NODE(slot) - 1];
+			if (node->hash == hash && node->length == length &&
+			    node->labels == labels &&
+			    suffix_equal(cctx->data + node->data, ndata,
+					 length, sensitive))
+			{
+				return (node);
+			}
+		}
+		i = (i + 1) & mask;
+	}
+	return (NULL);
+}
+
+/*
+ * Store node number 'n' in the first free slot for its hash.
+ */
+static inline void
+table_insert(uint32_t *table, unsigned int tablesize, uint32_t hash,
+	     unsigned int n)
+{
+	unsigned int mask = tablesize - 1;
+	unsigned int i = hash & mask;
+
+	while (table[i] != 0)
+		i = (i + 1) & mask;
+	table[i] = SLOT_TAG(hash) | (n + 1);
+}
+
+/*
+ * Make room for one more node, keeping the table at most 3/4 full.
+ */
+static bool
+table_grow(dns_compress_t *cctx) {
+	unsigned int i, size;
+	void *p;
+
+	if (cctx->count >= MAXNODES)
+		return (false);
+
+	if (cctx->count == cctx->nodessize) {
+		size = cctx->nodessize * 2;
+		p = isc_mem_get(cctx->mctx, size * sizeof(cctx->nodes[0]));
+		if (p == NULL)
+			return (false);
+		memmove(p, cctx->nodes, cctx->count * sizeof(cctx->nodes[0]));
+		if (cctx->nodes != cctx->initialnodes)
+			isc_mem_put(cctx->mctx, cctx->nodes,
+				    cctx->nodessize * sizeof(cctx->nodes[0]));
+		cctx->nodes = p;
+		cctx->nodessize = size;
+	}
+
+	if ((cctx->count + 1U) * 4 > cctx->tablesize * 3) {
+		size = cctx->tablesize * 2;
+		p = isc_mem_get(cctx->mctx, size * sizeof(cctx->table[0]));
+		if (p == NULL)
+			return (false);
+		memset(p, 0, size * sizeof(cctx->table[0]));
+		/*
+		 * Reinsert in node order, so that a later rollback can
+		 * clear slots without breaking any probe sequence.
+		 */
+		for (i = 0; i < cctx->count; i++)
+			table_insert(p, size, cctx->nodes[i].hash, i);
+		if (cctx->table != cctx->initialtable)
+			isc_mem_put(cctx->mctx, cctx->table,
+				    cctx->tablesize * sizeof(cctx->table[0]));
+		cctx->table = p;
+		cctx->tablesize = size;
+	}
+
+	return (true);
+}
+
+/*
+ * Copy 'length' octets of name data, returning their offset in
+ * cctx->data or -1 if memory is exhausted.
+ */
+static int
+data_add(dns_compress_t *cctx, const unsigned char *ndata,
+	 unsigned int length)
+{
+	unsigned int size, offset;
+	unsigned char *p;
+
+	if (cctx->datasize - cctx->dataused < length) {
+		size = cctx->datasize * 2;
+		p = isc_mem_get(cctx->mctx, size);
+		if (p == NULL)
+			return (-1);
+		memmove(p, cctx->data, cctx->dataused);
+		if (cctx->data != cctx->initialdata)
+			isc_mem_put(cctx->mctx, cctx->data, cctx->datasize);
+		cctx->data = p;
+		cctx->datasize = size;
+	}
+
+	offset = cctx->dataused;
+	memmove(cctx->data + offset, ndata, length);
+	cctx->dataused += length;
+	return ((int)offset);
+}
 
 /*
  * Find the longest match of name in the table.
@@ -147,9 +336,10 @@ bool
 dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 			dns_name_t *prefix, uint16_t *offset)
 {
-	dns_name_t tname, nname;
 	dns_compressnode_t *node = NULL;
-	unsigned int labels, hash, n;
+	dns_offsets_t offsets;
+	uint32_t hashes[sizeof(dns_offsets_t)];
+	unsigned int labels, n;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name) == true);
@@ -163,27 +353,11 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	if (cctx->count == 0)
 		return (false);
 
-	labels = dns_name_countlabels(name);
-	INSIST(labels > 0);
-
-	dns_name_init(&tname, NULL);
-	dns_name_init(&nname, NULL);
+	labels = suffix_hashes(name, offsets, hashes);
 
 	for (n = 0; n < labels - 1; n++) {
-		dns_name_getlabelsequence(name, n, labels - n, &tname);
-		hash = dns_name_hash(&tname, false) %
-		       DNS_COMPRESS_TABLESIZE;
-		for (node = cctx->table[hash]; node != NULL; node = node->next)
-		{
-			NODENAME(node, &nname);
-			if ((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0) {
-				if (dns_name_caseequal(&nname, &tname))
-					break;
-			} else {
-				if (dns_name_equal(&nname, &tname))
-					break;
-			}
-		}
+		node = table_find(cctx, hashes[n], name->ndata + offsets[n],
+				  name->length - offsets[n], labels - n);
 		if (node != NULL)
 			break;
 	}
@@ -199,32 +373,20 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	else
 		dns_name_getlabelsequence(name, 0, n, prefix);
 
-	*offset = (node->offset & 0x7fff);
+	*offset = node->offset;
 	return (true);
 }
 
-static inline unsigned int
-name_length(const dns_name_t *name) {
-	isc_region_t r;
-	dns_name_toregion(name, &r);
-	return (r.length);
-}
-
 void
 dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		 const dns_name_t *prefix, uint16_t offset)
 {
-	dns_name_t tname, xname;
-	unsigned int start;
-	unsigned int n;
-	unsigned int count;
-	unsigned int hash;
 	dns_compressnode_t *node;
-	unsigned int length;
-	unsigned int tlength;
-	uint16_t toffset;
-	unsigned char *tmp;
-	isc_region_t r;
+	dns_offsets_t offsets;
+	uint32_t hashes[sizeof(dns_offsets_t)];
+	unsigned int labels, count, n;
+	unsigned int toffset;
+	int data;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name));
@@ -236,72 +398,49 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 
 	if (offset >= 0x4000)
 		return;
-	dns_name_init(&tname, NULL);
-	dns_name_init(&xname, NULL);
 
-	n = dns_name_countlabels(name);
 	count = dns_name_countlabels(prefix);
 	if (dns_name_isabsolute(prefix))
 		count--;
 	if (count == 0)
 		return;
-	start = 0;
-	dns_name_toregion(name, &r);
-	length = r.length;
-	tmp = isc_mem_get(cctx->mctx, length);
-	if (tmp == NULL)
-		return;
+
 	/*
-	 * Copy name data to 'tmp' and make 'r' use 'tmp'.
+	 * The name may not outlive the message, so keep a copy of it;
+	 * the nodes for all of its suffixes refer to that one copy.
 	 */
-	memmove(tmp, r.base, r.length);
-	r.base = tmp;
-	dns_name_fromregion(&xname, &r);
-
-	while (count > 0) {
-		dns_name_getlabelsequence(&xname, start, n, &tname);
-		hash = dns_name_hash(&tname, false) %
-		       DNS_COMPRESS_TABLESIZE;
-		tlength = name_length(&tname);
-		toffset = (uint16_t)(offset + (length - tlength));
+	data = data_add(cctx, name->ndata, name->length);
+	if (data < 0)
+		return;
+
+	labels = suffix_hashes(name, offsets, hashes);
+
+	for (n = 0; n < count; n++) {
+		toffset = offset + offsets[n];
 		if (toffset >= 0x4000)
 			break;
-		/*
-		 * Create a new node and add it.
-		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES)
-			node = &cctx->initialnodes[cctx->count];
-		else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-			if (node == NULL)
-				break;
-		}
-		node->count = cctx->count++;
-		/*
-		 * 'node->r.base' becomes 'tmp' when start == 0.
-		 * Record this by setting 0x8000 so it can be freed later.
-		 */
-		if (start == 0)
-			toffset |= 0x8000;
-		node->offset = toffset;
-		dns_name_toregion(&tname, &node->r);
-		node->labels = (uint8_t)dns_name_countlabels(&tname);
-		node->next = cctx->table[hash];
-		cctx->table[hash] = node;
-		start++;
-		n--;
-		count--;
+		if (!table_grow(cctx))
+			break;
+		node = &cctx->nodes[cctx->count];
+		node->hash = hashes[n];
+		node->data = (uint32_t)data + offsets[n];
+		node->offset = (uint16_t)toffset;
+		node->length = (uint8_t)(name->length - offsets[n]);
+		node->labels = (uint8_t)(labels - n);
+		table_insert(cctx->table, cctx->tablesize, node->hash,
+			     cctx->count);
+		cctx->count++;
 	}
 
-	if (start == 0)
-		isc_mem_put(cctx->mctx, tmp, length);
+	if (n == 0)
+		cctx->dataused = (unsigned int)data;
 }
 
 void
 dns_compress_rollback(dns_compress_t *cctx, uint16_t offset) {
-	unsigned int i;
 	dns_compressnode_t *node;
+	unsigned int mask, i;
+	uint32_t slot;
 
 	REQUIRE(VALID_CCTX(cctx));
 
@@ -311,24 +450,35 @@ dns_compress_rollback(dns_compress_t *cctx, uint16_t offset) {
 	if ((cctx->allowed & DNS_COMPRESS_READY) == 0)
 		return;
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		node = cctx->table[i];
-		/*
-		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end
-		 * of the initialnodes[] array.
-		 */
-		while (node != NULL && (node->offset & 0x7fff) >= offset) {
-			cctx->table[i] = node->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count >= DNS_COMPRESS_INITIALNODES)
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			cctx->count--;
-			node = cctx->table[i];
+	/*
+	 * Nodes are added in offset order, so the ones to remove are at
+	 * the end of cctx->nodes.  Removing them in the reverse of the
+	 * order they were added leaves every remaining node reachable
+	 * from its home slot, as no remaining node was placed after them.
+	 */
+	mask = cctx->tablesize - 1;
+	while (cctx->count > 0) {
+		node = &cctx->nodes[cctx->count - 1];
+		if (node->offset < offset)
+			break;
+		slot = SLOT_TAG(node->hash) | cctx->count;
+		i = node->hash & mask;
+		while (cctx->table[i] != slot) {
+			INSIST(cctx->table[i] != 0);
+			i = (i + 1) & mask;
 		}
+		cctx->table[i] = 0;
+		cctx->count--;
+	}
+
+	/*
+	 * All the suffixes of a name end where its copy ends.
+	 */
+	if (cctx->count == 0) {
+		cctx->dataused = 0;
+	} else {
+		node = &cctx->nodes[cctx->count - 1];
+		cctx->dataused = node->data + node->length;
 	}
 }
 
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/condition.h>
+#include <isc/event.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/task.h>
+#include <isc/util.h>
+
+#include <dns/cryptopool.h>
+#include <dns/events.h>
+
+struct dns_cryptopool {
+	unsigned int		magic;
+	isc_mem_t *		mctx;
+	isc_refcount_t		references;
+	isc_mutex_t		lock;
+	isc_taskmgr_t *		taskmgr;
+	unsigned int		ntasks;
+	isc_task_t **		tasks;
+	/* Locked by lock. */
+	unsigned int		next;
+	unsigned int		queued;
+};
+
+#define CRYPTOPOOL_MAGIC	ISC_MAGIC('C', 'P', 'o', 'l')
+#define VALID_CRYPTOPOOL(p)	ISC_MAGIC_VALID(p, CRYPTOPOOL_MAGIC)
+
+/*%
+ * A set of functions queued by dns_cryptopool_runall().
+ */
+typedef struct cryptobatch {
+	isc_mutex_t		lock;
+	isc_condition_t		done;
+	size_t			pending;
+} cryptobatch_t;
+
+/*%
+ * The event that carries a function to the pool.  Once the function
+ * has run, the same event is sent back to the caller, or, if it is
+ * part of a batch, freed.
+ */
+typedef struct cryptowork {
+	ISC_EVENT_COMMON(struct cryptowork);
+	dns_cryptopool_t *	pool;
+	dns_cryptofunc_t	func;
+	isc_task_t *		task;
+	isc_taskaction_t	action;
+	cryptobatch_t *		batch;
+} cryptowork_t;
+
+static void
+free_tasks(dns_cryptopool_t *pool) {
+	unsigned int i;
+
+	for (i = 0; i < pool->ntasks; i++)
+		if (pool->tasks[i] != NULL)
+			isc_task_detach(&pool->tasks[i]);
+	isc_mem_put(pool->mctx, pool->tasks,
+		    pool->ntasks * sizeof(pool->tasks[0]));
+	pool->tasks = NULL;
+}
+
+isc_result_t
+dns_cryptopool_create(isc_mem_t *mctx, unsigned int workers,
+		      dns_cryptopool_t **poolp)
+{
+#ifdef ISC_PLATFORM_USETHREADS
+	dns_cryptopool_t *pool;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(workers > 0);
+	REQUIRE(poolp != NULL && *poolp == NULL);
+
+	pool = isc_mem_get(mctx, sizeof(*pool));
+	if (pool == NULL)
+		return (ISC_R_NOMEMORY);
+
+	pool->mctx = NULL;
+	isc_mem_attach(mctx, &pool->mctx);
+	pool->taskmgr = NULL;
+	pool->next = 0;
+	pool->queued = 0;
+
+	/*
+	 * One task per thread lets every thread be busy at once.
+	 */
+	pool->ntasks = workers;
+	pool->tasks = isc_mem_get(mctx, workers * sizeof(pool->tasks[0]));
+	if (pool->tasks == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_pool;
+	}
+	for (i = 0; i < workers; i++)
+		pool->tasks[i] = NULL;
+
+	result = isc_refcount_init(&pool->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_tasks;
+
+	result = isc_mutex_init(&pool->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_refcount;
+
+	result = isc_taskmgr_create(mctx, workers, 0, &pool->taskmgr);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_lock;
+
+	for (i = 0; i < workers; i++) {
+		result = isc_task_create(pool->taskmgr, 0, &pool->tasks[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_taskmgr;
+		isc_task_setname(pool->tasks[i], "crypto", pool);
+	}
+
+	pool->magic = CRYPTOPOOL_MAGIC;
+	*poolp = pool;
+	return (ISC_R_SUCCESS);
+
+ cleanup_taskmgr:
+	free_tasks(pool);
+	isc_taskmgr_destroy(&pool->taskmgr);
+ cleanup_lock:
+	DESTROYLOCK(&pool->lock);
+ cleanup_refcount:
+	isc_refcount_decrement(&pool->references, NULL);
+	isc_refcount_destroy(&pool->references);
+ cleanup_tasks:
+	if (pool->tasks != NULL)
+		isc_mem_put(mctx, pool->tasks,
+			    workers * sizeof(pool->tasks[0]));
+ cleanup_pool:
+	isc_mem_putanddetach(&pool->mctx, pool, sizeof(*pool));
+	return (result);
+#else
+	UNUSED(mctx);
+	UNUSED(workers);
+	UNUSED(poolp);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif /* ISC_PLATFORM_USETHREADS */
+}
+
+void
+dns_cryptopool_attach(dns_cryptopool_t *source, dns_cryptopool_t **targetp) {
+	REQUIRE(VALID_CRYPTOPOOL(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_cryptopool_detach(dns_cryptopool_t **poolp) {
+	dns_cryptopool_t *pool;
+	unsigned int references;
+
+	REQUIRE(poolp != NULL && VALID_CRYPTOPOOL(*poolp));
+	pool = *poolp;
+	*poolp = NULL;
+
+	isc_refcount_decrement(&pool->references, &references);
+	if (references != 0)
+		return;
+
+	INSIST(pool->queued == 0);
+	pool->magic = 0;
+	free_tasks(pool);
+	isc_taskmgr_destroy(&pool->taskmgr);
+	DESTROYLOCK(&pool->lock);
+	isc_refcount_destroy(&pool->references);
+	isc_mem_putanddetach(&pool->mctx, pool, sizeof(*pool));
+}
+
+static void
+cryptowork(isc_task_t *task, isc_event_t *event) {
+	cryptowork_t *work = (cryptowork_t *)event;
+	dns_cryptopool_t *pool = work->pool;
+	isc_task_t *sendto;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_CRYPTOWORK);
+
+	LOCK(&pool->lock);
+	INSIST(pool->queued > 0);
+	pool->queued--;
+	UNLOCK(&pool->lock);
+
+	(work->func)(work->ev_arg);
+
+	if (work->batch != NULL) {
+		cryptobatch_t *batch = work->batch;
+
+		isc_event_free(&event);
+		LOCK(&batch->lock);
+		INSIST(batch->pending > 0);
+		if (--batch->pending == 0)
+			SIGNAL(&batch->done);
+		UNLOCK(&batch->lock);
+		return;
+	}
+
+	/*
+	 * The caller may release the pool as soon as it has this event,
+	 * so it must not be used after the event is sent.
+	 */
+	sendto = work->task;
+	work->task = NULL;
+	work->pool = NULL;
+	work->ev_type = DNS_EVENT_CRYPTODONE;
+	work->ev_action = work->action;
+	isc_task_sendanddetach(&sendto, &event);
+}
+
+isc_result_t
+dns_cryptopool_run(dns_cryptopool_t *pool, isc_mem_t *mctx,
+		   dns_cryptofunc_t func, isc_task_t *task,
+		   isc_taskaction_t action, void *arg)
+{
+	cryptowork_t *work;
+	isc_event_t *event;
+	unsigned int i;
+
+	REQUIRE(VALID_CRYPTOPOOL(pool));
+	REQUIRE(mctx != NULL);
+	REQUIRE(func != NULL);
+	REQUIRE(task != NULL);
+	REQUIRE(action != NULL);
+
+	event = isc_event_allocate(mctx, pool, DNS_EVENT_CRYPTOWORK,
+				   cryptowork, arg, sizeof(*work));
+	if (event == NULL)
+		return (ISC_R_NOMEMORY);
+
+	work = (cryptowork_t *)event;
+	work->pool = pool;
+	work->func = func;
+	work->task = NULL;
+	isc_task_attach(task, &work->task);
+	work->action = action;
+	work->batch = NULL;
+
+	LOCK(&pool->lock);
+	i = pool->next;
+	pool->next = (i + 1) % pool->ntasks;
+	pool->queued++;
+	UNLOCK(&pool->lock);
+
+	isc_task_send(pool->tasks[i], &event);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_cryptopool_runall(dns_cryptopool_t *pool, isc_mem_t *mctx,
+		      dns_cryptofunc_t func, void *base, size_t nmemb,
+		      size_t size)
+{
+	unsigned char *elem = base;
+	cryptobatch_t batch;
+	cryptowork_t *work;
+	isc_event_t *event;
+	size_t n;
+	unsigned int i;
+
+	REQUIRE(VALID_CRYPTOPOOL(pool));
+	REQUIRE(mctx != NULL);
+	REQUIRE(func != NULL);
+	REQUIRE(nmemb == 0 || base != NULL);
+
+	if (nmemb == 0)
+		return;
+
+	if (isc_mutex_init(&batch.lock) != ISC_R_SUCCESS)
+		goto serial;
+	if (isc_condition_init(&batch.done) != ISC_R_SUCCESS) {
+		DESTROYLOCK(&batch.lock);
+		goto serial;
+	}
+	batch.pending = 0;
+
+	/*
+	 * The first element is kept for this thread, which would
+	 * otherwise just wait.
+	 */
+	for (n = 1; n < nmemb; n++) {
+		event = isc_event_allocate(mctx, pool, DNS_EVENT_CRYPTOWORK,
+					   cryptowork, elem + n * size,
+					   sizeof(*work));
+		if (event == NULL)
+			break;
+		work = (cryptowork_t *)event;
+		work->pool = pool;
+		work->func = func;
+		work->task = NULL;
+		work->action = NULL;
+		work->batch = &batch;
+
+		LOCK(&batch.lock);
+		batch.pending++;
+		UNLOCK(&batch.lock);
+
+		LOCK(&pool->lock);
+		i = pool->next;
+		pool->next = (i + 1) % pool->ntasks;
+		pool->queued++;
+		UNLOCK(&pool->lock);
+
+		isc_task_send(pool->tasks[i], &event);
+	}
+
+	/*
+	 * Whatever could not be queued is done here.
+	 */
+	(func)(elem);
+	for (; n < nmemb; n++)
+		(func)(elem + n * size);
+
+	LOCK(&batch.lock);
+	while (batch.pending > 0)
+		WAIT(&batch.done, &batch.lock);
+	UNLOCK(&batch.lock);
+
+	(void)isc_condition_destroy(&batch.done);
+	DESTROYLOCK(&batch.lock);
+	return;
+
+ serial:
+	for (n = 0; n < nmemb; n++)
+		(func)(elem + n * size);
+}
+
+unsigned int
+dns_cryptopool_getqueued(dns_cryptopool_t *pool) {
+	unsigned int queued;
+
+	REQUIRE(VALID_CRYPTOPOOL(pool));
+
+	LOCK(&pool->lock);
+	queued = pool->queued;
+	UNLOCK(&pool->lock);
+
+	return (queued);
+}
+
+unsigned int
+dns_cryptopool_getworkers(dns_cryptopool_t *pool) {
+	REQUIRE(VALID_CRYPTOPOOL(pool));
+
+	return (pool->ntasks);
+}
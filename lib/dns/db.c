@@ -36,6 +36,7 @@
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
 #include <dns/rdatasetiter.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 
 /***
@@ -68,6 +69,13 @@ static isc_once_t once = ISC_ONCE_INIT;
 static dns_dbimplementation_t rbtimp;
 static dns_dbimplementation_t rbt64imp;
 
+/*
+ * Node lock counts for new "rbt" databases; 0 means the default for the
+ * database type.  These are not locked: see dns_db_setnodelockcount().
+ */
+static unsigned int cache_nodelocks = 0;
+static unsigned int zone_nodelocks = 0;
+
 static void
 initialize(void) {
 	RUNTIME_CHECK(isc_rwlock_init(&implock, 0, 0) == ISC_R_SUCCESS);
@@ -461,6 +469,10 @@ dns_db_closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 	(db->methods->closeversion)(db, versionp, commit);
 
 	if (commit == true) {
+		/*
+		 * Responses rendered from the previous version are stale.
+		 */
+		dns_respcache_invalidate(db);
 		for (listener = ISC_LIST_HEAD(db->update_listeners);
 		     listener != NULL;
 		     listener = ISC_LIST_NEXT(listener, link))
@@ -896,6 +908,42 @@ dns_db_hashsize(dns_db_t *db) {
 	return ((db->methods->hashsize)(db));
 }
 
+void
+dns_db_adjusthashsize(dns_db_t *db, unsigned int nodecount) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (db->methods->adjusthashsize != NULL)
+		(db->methods->adjusthashsize)(db, nodecount);
+}
+
+unsigned int
+dns_db_nodelockstats(dns_db_t *db, uint64_t *waits, unsigned int count) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(waits != NULL || count == 0);
+
+	if (db->methods->nodelockstats != NULL)
+		return ((db->methods->nodelockstats)(db, waits, count));
+	return (0);
+}
+
+void
+dns_db_setnodelockcount(dns_dbtype_t type, unsigned int count) {
+	REQUIRE(count < 1024);
+
+	if (type == dns_dbtype_cache) {
+		REQUIRE(count != 1);
+		cache_nodelocks = count;
+	} else
+		zone_nodelocks = count;
+}
+
+unsigned int
+dns_db_getnodelockcount(dns_dbtype_t type) {
+	if (type == dns_dbtype_cache)
+		return (cache_nodelocks);
+	return (zone_nodelocks);
+}
+
 void
 dns_db_settask(dns_db_t *db, isc_task_t *task) {
 	REQUIRE(DNS_DB_VALID(db));
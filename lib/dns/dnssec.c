@@ -22,6 +22,7 @@
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/serial.h>
+#include <isc/sha2.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -41,6 +42,7 @@
 #include <dns/result.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>		/* for DNS_TSIG_FUDGE */
+#include <dns/verifycache.h>
 
 #include <dst/result.h>
 
@@ -75,6 +77,24 @@ digest_callback(void *arg, isc_region_t *data) {
 	return (dst_context_adddata(ctx, data));
 }
 
+/*%
+ * While verifying, everything added to the DST context is also added
+ * to a SHA-256 digest, which is the key of the verification cache.
+ */
+typedef struct verify_digest {
+	dst_context_t *		ctx;
+	isc_sha256_t *		sha;
+} verify_digest_t;
+
+static isc_result_t
+verify_callback(void *arg, isc_region_t *data) {
+	verify_digest_t *vd = arg;
+
+	if (vd->sha != NULL)
+		isc_sha256_update(vd->sha, data->base, data->length);
+	return (dst_context_adddata(vd->ctx, data));
+}
+
 static inline void
 inc_stat(isc_statscounter_t counter) {
 	if (dns_dnssec_stats != NULL)
@@ -157,8 +177,8 @@ dns_dnssec_keyfromrdata(dns_name_t *name, dns_rdata_t *rdata, isc_mem_t *mctx,
 }
 
 static isc_result_t
-digest_sig(dst_context_t *ctx, bool downcase, dns_rdata_t *sigrdata,
-	   dns_rdata_rrsig_t *rrsig)
+digest_sig(dns_digestfunc_t digest, void *arg, bool downcase,
+	   dns_rdata_t *sigrdata, dns_rdata_rrsig_t *rrsig)
 {
 	isc_region_t r;
 	isc_result_t ret;
@@ -168,7 +188,7 @@ digest_sig(dst_context_t *ctx, bool downcase, dns_rdata_t *sigrdata,
 	INSIST(r.length >= 19);
 
 	r.length = 18;
-	ret = dst_context_adddata(ctx, &r);
+	ret = (digest)(arg, &r);
 	if (ret != ISC_R_SUCCESS)
 		return (ret);
 	if (downcase) {
@@ -181,7 +201,7 @@ digest_sig(dst_context_t *ctx, bool downcase, dns_rdata_t *sigrdata,
 	} else
 		dns_name_toregion(&rrsig->signer, &r);
 
-	return (dst_context_adddata(ctx, &r));
+	return ((digest)(arg, &r));
 }
 
 isc_result_t
@@ -280,7 +300,7 @@ dns_dnssec_sign(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	/*
 	 * Digest the SIG rdata.
 	 */
-	ret = digest_sig(ctx, false, &tmpsigrdata, &sig);
+	ret = digest_sig(digest_callback, ctx, false, &tmpsigrdata, &sig);
 	if (ret != ISC_R_SUCCESS)
 		goto cleanup_context;
 
@@ -379,6 +399,46 @@ isc_result_t
 dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		   bool ignoretime, unsigned int maxbits,
 		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild)
+{
+	return (dns_dnssec_verify4(name, set, key, ignoretime, maxbits, mctx,
+				   sigrdata, wild, NULL));
+}
+
+/*
+ * Digest what identifies a verification apart from the signed data:
+ * the key, the RSA exponent limit and the RRSIG rdata including the
+ * signature.  The signed data follows.
+ */
+static void
+cache_prefix(isc_sha256_t *sha, isc_region_t *keyr, unsigned int maxbits,
+	     dns_rdata_t *sigrdata)
+{
+	unsigned char data[6];
+	isc_buffer_t b;
+	isc_region_t r;
+
+	isc_buffer_init(&b, data, sizeof(data));
+	isc_buffer_putuint16(&b, (uint16_t)keyr->length);
+	isc_buffer_putuint32(&b, (uint32_t)maxbits);
+	isc_sha256_update(sha, data, sizeof(data));
+	isc_sha256_update(sha, keyr->base, keyr->length);
+
+	dns_rdata_toregion(sigrdata, &r);
+	isc_buffer_init(&b, data, sizeof(data));
+	isc_buffer_putuint16(&b, (uint16_t)r.length);
+	isc_sha256_update(sha, data, 2);
+	isc_sha256_update(sha, r.base, r.length);
+}
+
+/*
+ * 'keyr' is the DNSKEY rdata of 'key'.  It is only needed, and may
+ * only be NULL, when 'cache' is NULL.
+ */
+static isc_result_t
+verify(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+       isc_region_t *keyr, bool ignoretime, unsigned int maxbits,
+       isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild,
+       dns_verifycache_t *cache)
 {
 	dns_rdata_rrsig_t sig;
 	dns_fixedname_t fnewname;
@@ -393,12 +453,12 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	int labels = 0;
 	uint32_t flags;
 	bool downcase = false;
+	bool cached = false;
+	verify_digest_t vd;
+	isc_sha256_t sha;
+	unsigned char digest[DNS_VERIFYCACHE_DIGESTLEN];
 
-	REQUIRE(name != NULL);
-	REQUIRE(set != NULL);
-	REQUIRE(key != NULL);
-	REQUIRE(mctx != NULL);
-	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
+	REQUIRE(cache == NULL || keyr != NULL);
 
 	ret = dns_rdata_tostruct(sigrdata, &sig, NULL);
 	if (ret != ISC_R_SUCCESS)
@@ -473,10 +533,18 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	if (ret != ISC_R_SUCCESS)
 		goto cleanup_struct;
 
+	vd.ctx = ctx;
+	vd.sha = NULL;
+	if (cache != NULL) {
+		isc_sha256_init(&sha);
+		vd.sha = &sha;
+		cache_prefix(&sha, keyr, maxbits, sigrdata);
+	}
+
 	/*
 	 * Digest the SIG rdata (not including the signature).
 	 */
-	ret = digest_sig(ctx, downcase, sigrdata, &sig);
+	ret = digest_sig(verify_callback, &vd, downcase, sigrdata, &sig);
 	if (ret != ISC_R_SUCCESS)
 		goto cleanup_context;
 
@@ -529,7 +597,7 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		/*
 		 * Digest the envelope.
 		 */
-		ret = dst_context_adddata(ctx, &r);
+		ret = verify_callback(&vd, &r);
 		if (ret != ISC_R_SUCCESS)
 			goto cleanup_array;
 
@@ -544,17 +612,30 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		/*
 		 * Digest the rdata.
 		 */
-		ret = dst_context_adddata(ctx, &lenr);
+		ret = verify_callback(&vd, &lenr);
 		if (ret != ISC_R_SUCCESS)
 			goto cleanup_array;
-		ret = dns_rdata_digest(&rdatas[i], digest_callback, ctx);
+		ret = dns_rdata_digest(&rdatas[i], verify_callback, &vd);
 		if (ret != ISC_R_SUCCESS)
 			goto cleanup_array;
 	}
 
-	r.base = sig.signature;
-	r.length = sig.siglen;
-	ret = dst_context_verify2(ctx, maxbits, &r);
+	if (vd.sha != NULL) {
+		isc_sha256_final(digest, vd.sha);
+		vd.sha = NULL;
+		cached = dns_verifycache_find(cache, digest);
+	}
+
+	if (cached) {
+		ret = ISC_R_SUCCESS;
+		inc_stat(dns_dnssecstats_cached);
+	} else {
+		r.base = sig.signature;
+		r.length = sig.siglen;
+		ret = dst_context_verify2(ctx, maxbits, &r);
+		if (ret == ISC_R_SUCCESS && cache != NULL)
+			dns_verifycache_add(cache, digest);
+	}
 	if (ret == ISC_R_SUCCESS && downcase) {
 		char namebuf[DNS_NAME_FORMATSIZE];
 		dns_name_format(&sig.signer, namebuf, sizeof(namebuf));
@@ -569,6 +650,8 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 cleanup_array:
 	isc_mem_put(mctx, rdatas, nrdatas * sizeof(dns_rdata_t));
 cleanup_context:
+	if (vd.sha != NULL)
+		isc_sha256_invalidate(vd.sha);
 	dst_context_destroy(&ctx);
 	if (ret == DST_R_VERIFYFAILURE && !downcase) {
 		downcase = true;
@@ -594,6 +677,73 @@ cleanup_struct:
 	return (ret);
 }
 
+isc_result_t
+dns_dnssec_verify4(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+		   bool ignoretime, unsigned int maxbits,
+		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild,
+		   dns_verifycache_t *cache)
+{
+	dns_dnssec_verifyitem_t item;
+
+	item.name = name;
+	item.rdataset = set;
+	item.sigrdata = sigrdata;
+	item.wild = wild;
+
+	(void)dns_dnssec_verifybatch(key, &item, 1, ignoretime, maxbits,
+				     mctx, cache);
+	return (item.result);
+}
+
+isc_result_t
+dns_dnssec_verifybatch(dst_key_t *key, dns_dnssec_verifyitem_t *items,
+		       unsigned int count, bool ignoretime,
+		       unsigned int maxbits, isc_mem_t *mctx,
+		       dns_verifycache_t *cache)
+{
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	isc_buffer_t keybuf;
+	isc_region_t keyr;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int i;
+
+	REQUIRE(key != NULL);
+	REQUIRE(items != NULL || count == 0);
+	REQUIRE(mctx != NULL);
+
+	/*
+	 * The key is part of every cache entry; render it once.  If it
+	 * cannot be rendered, verify without the cache.
+	 */
+	if (cache != NULL) {
+		isc_buffer_init(&keybuf, keydata, sizeof(keydata));
+		if (dst_key_todns(key, &keybuf) == ISC_R_SUCCESS)
+			isc_buffer_usedregion(&keybuf, &keyr);
+		else
+			cache = NULL;
+	}
+
+	for (i = 0; i < count; i++) {
+		dns_dnssec_verifyitem_t *item = &items[i];
+
+		REQUIRE(item->name != NULL);
+		REQUIRE(item->rdataset != NULL);
+		REQUIRE(item->sigrdata != NULL &&
+			item->sigrdata->type == dns_rdatatype_rrsig);
+
+		item->result = verify(item->name, item->rdataset, key,
+				      (cache != NULL) ? &keyr : NULL,
+				      ignoretime, maxbits, mctx,
+				      item->sigrdata, item->wild, cache);
+		if (result == ISC_R_SUCCESS &&
+		    item->result != ISC_R_SUCCESS &&
+		    item->result != DNS_R_FROMWILDCARD)
+			result = item->result;
+	}
+
+	return (result);
+}
+
 isc_result_t
 dns_dnssec_verify(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		  bool ignoretime, isc_mem_t *mctx,
@@ -549,6 +549,9 @@ dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
  *
  *\li	The srtt in addr will be updated to reflect the new global
  *	srtt value.  This may include changes made by others.
+ *
+ *\li	Where atomic operations are available this does not take
+ *	any lock, and concurrent adjustments are never lost.
  */
 
 void
@@ -579,6 +582,9 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
  *
  *\li	newflags = (oldflags & ~mask) | (bits & mask);
  *
+ * Like dns_adb_adjustsrtt(), this is lock free where atomic operations
+ * are available.
+ *
  * Requires:
  *
  *\li	adb be valid.
@@ -222,6 +222,53 @@ dns_cache_dump(dns_cache_t *cache);
  *  \li    Various failures depending on the database implementation type
  */
 
+isc_result_t
+dns_cache_setsnapshot(dns_cache_t *cache, const char *filename);
+/*%<
+ * Set the file the cache snapshot is kept in, or if 'filename' is
+ * NULL, stop keeping one.  A snapshot is a "raw" format dump of the
+ * cache that records the trust level of each RRset; it is written
+ * by dns_cache_dumpsnapshot() and when the cache is shut down, and
+ * used by dns_cache_loadsnapshot() to pre-warm a new cache.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+isc_result_t
+dns_cache_loadsnapshot(dns_cache_t *cache, isc_task_t *task);
+/*%<
+ * If the cache has a snapshot file and it exists, load its contents
+ * into the cache.  TTLs are aged by the time that has passed since
+ * the snapshot was written, and RRsets that have expired are skipped.
+ *
+ * The RRsets are added the same way the resolver adds data, so the
+ * cache may be used while the load is in progress and snapshot data
+ * never replaces data of a higher trust level.  If 'task' is not NULL
+ * the load runs incrementally in 'task' and DNS_R_CONTINUE is
+ * returned; it is canceled if the cache is flushed or shut down
+ * first.  Otherwise the snapshot is loaded before returning.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		loaded, or no snapshot to load
+ *\li	#DNS_R_CONTINUE		load started in 'task'
+ *\li	#ISC_R_INPROGRESS		a load is already in progress
+ *\li	Various file-related and format failures
+ */
+
+isc_result_t
+dns_cache_dumpsnapshot(dns_cache_t *cache);
+/*%<
+ * If the cache has a snapshot file, write the cache contents to it,
+ * replacing the previous snapshot.  If no snapshot file has been
+ * set, do nothing and return success.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *  \li    Various failures depending on the database implementation type
+ */
+
 isc_result_t
 dns_cache_clean(dns_cache_t *cache, isc_stdtime_t now);
 /*%<
@@ -254,6 +301,14 @@ dns_cache_setcachesize(dns_cache_t *cache, size_t size);
  * Set the maximum cache size.  0 means unlimited.
  */
 
+void
+dns_cache_setexpectednames(dns_cache_t *cache, unsigned int names);
+/*%<
+ * Size the cache database's name hash table for 'names' names, so
+ * that a large cache does not have to grow it repeatedly while it
+ * fills.  The hint is kept across dns_cache_flush().  0 means no hint.
+ */
+
 size_t
 dns_cache_getcachesize(dns_cache_t *cache);
 /*%<
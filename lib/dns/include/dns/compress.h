@@ -45,29 +45,49 @@ ISC_LANG_BEGINDECLS
 
 #define DNS_COMPRESS_READY		0x80000000
 
-#define DNS_COMPRESS_TABLESIZE 64
-#define DNS_COMPRESS_INITIALNODES 16
+/*%
+ * The global compression table is an open addressing hash table of
+ * slots referring to an array of nodes, one per name suffix added, in
+ * the order they were added.  Each node refers to a copy of the name
+ * data.  The context holds enough of each for a typical response; the
+ * table, nodes and name data move to memory allocated from 'mctx' as
+ * the message grows.
+ */
+#define DNS_COMPRESS_INITIALSLOTS	128
+#define DNS_COMPRESS_INITIALNODES	64
+#define DNS_COMPRESS_INITIALDATA	1024
 
 typedef struct dns_compressnode dns_compressnode_t;
 
 struct dns_compressnode {
-	isc_region_t		r;
-	uint16_t		offset;
-	uint16_t		count;
-	uint8_t			labels;
-	dns_compressnode_t	*next;
+	uint32_t		hash;		/*%< Hash of the suffix. */
+	uint32_t		data;		/*%< Offset in the name data. */
+	uint16_t		offset;		/*%< Offset in the message. */
+	uint8_t			length;		/*%< Length of the suffix. */
+	uint8_t			labels;		/*%< Labels in the suffix. */
 };
 
 struct dns_compress {
 	unsigned int		magic;		/*%< Magic number. */
 	unsigned int		allowed;	/*%< Allowed methods. */
 	int			edns;		/*%< Edns version or -1. */
-	/*% Global compression table. */
-	dns_compressnode_t	*table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated nodes for the table. */
-	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
+	/*%
+	 * Global compression table.  Each slot is zero or holds the
+	 * upper 16 bits of the suffix hash and the node number plus one.
+	 */
+	uint32_t		*table;
+	unsigned int		tablesize;	/*%< Slots, a power of 2. */
+	dns_compressnode_t	*nodes;		/*%< Nodes, in offset order. */
+	unsigned int		nodessize;
+	unsigned char		*data;		/*%< Copies of the names. */
+	unsigned int		datasize;
+	unsigned int		dataused;
 	uint16_t		count;		/*%< Number of nodes. */
 	isc_mem_t		*mctx;		/*%< Memory context. */
+	/*% Preallocated storage for the table, nodes and name data. */
+	uint32_t		initialtable[DNS_COMPRESS_INITIALSLOTS];
+	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
+	unsigned char		initialdata[DNS_COMPRESS_INITIALDATA];
 };
 
 typedef enum {
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#ifndef DNS_CRYPTOPOOL_H
+#define DNS_CRYPTOPOOL_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/cryptopool.h
+ * \brief
+ * A pool of threads, separate from the server's task manager, that
+ * runs expensive DNSSEC cryptographic operations.
+ *
+ * Notes:
+ *\li	A caller hands the pool a function and an argument with
+ *	dns_cryptopool_run().  The function is run on one of the pool's
+ *	threads, and then a #DNS_EVENT_CRYPTODONE event whose ev_arg is
+ *	the argument is sent to the caller's task.  The function must
+ *	only use data that the caller will leave alone until the event
+ *	arrives.
+ *
+ *\li	A public key operation run this way does not hold up the other
+ *	events queued for the caller's task manager, such as incoming
+ *	queries.
+ *
+ * MP:
+ *\li	The pool is internally locked.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <stddef.h>
+
+#include <isc/lang.h>
+#include <isc/types.h>
+
+#include <dns/types.h>
+
+typedef void
+(*dns_cryptofunc_t)(void *arg);
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_cryptopool_create(isc_mem_t *mctx, unsigned int workers,
+		      dns_cryptopool_t **poolp);
+/*%
+ * Create a pool of 'workers' threads.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	workers > 0
+ * \li	poolp != NULL && *poolp == NULL
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMEMORY
+ * \li	#ISC_R_NOTIMPLEMENTED if the library was built without threads
+ */
+
+void
+dns_cryptopool_attach(dns_cryptopool_t *source, dns_cryptopool_t **targetp);
+/*%
+ * Attach '*targetp' to 'source'.
+ */
+
+void
+dns_cryptopool_detach(dns_cryptopool_t **poolp);
+/*%
+ * Detach from the pool.  When the last reference goes away the pool's
+ * threads are stopped, which waits for any functions still running.
+ * The last reference must not be released by a function run by the
+ * pool.
+ */
+
+isc_result_t
+dns_cryptopool_run(dns_cryptopool_t *pool, isc_mem_t *mctx,
+		   dns_cryptofunc_t func, isc_task_t *task,
+		   isc_taskaction_t action, void *arg);
+/*%
+ * Run 'func(arg)' on one of the pool's threads, and then send a
+ * #DNS_EVENT_CRYPTODONE event with action 'action' and argument 'arg'
+ * to 'task'.  The event is allocated from 'mctx'; the receiver frees
+ * it with isc_event_free().
+ *
+ * Requires:
+ * \li	'pool' is a valid pool
+ * \li	'func', 'task' and 'action' are not NULL
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_cryptopool_runall(dns_cryptopool_t *pool, isc_mem_t *mctx,
+		      dns_cryptofunc_t func, void *base, size_t nmemb,
+		      size_t size);
+/*%
+ * Call 'func' on each of the 'nmemb' elements of size 'size' in the
+ * array at 'base', spread over the pool's threads, and wait for them all
+ * to finish.  Elements that cannot be queued are processed by the
+ * calling thread.  This blocks the caller, so it is meant for batches of
+ * work whose results are needed before the caller can go on.
+ *
+ * Requires:
+ * \li	'pool' is a valid pool
+ * \li	'func' is not NULL
+ * \li	the caller is not running on one of the pool's threads
+ */
+
+unsigned int
+dns_cryptopool_getqueued(dns_cryptopool_t *pool);
+/*%
+ * Return the number of functions that have been passed to
+ * dns_cryptopool_run() and have not yet started to run.
+ */
+
+unsigned int
+dns_cryptopool_getworkers(dns_cryptopool_t *pool);
+/*%
+ * Return the number of threads in the pool.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_CRYPTOPOOL_H */
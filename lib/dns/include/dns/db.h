@@ -197,6 +197,10 @@ typedef struct dns_dbmethods {
 					dns_name_t *name);
 	isc_result_t	(*getsize)(dns_db_t *db, dns_dbversion_t *version,
 				   uint64_t *records, uint64_t *bytes);
+	void		(*adjusthashsize)(dns_db_t *db,
+					  unsigned int nodecount);
+	unsigned int	(*nodelockstats)(dns_db_t *db, uint64_t *waits,
+					 unsigned int count);
 } dns_dbmethods_t;
 
 typedef isc_result_t
@@ -1399,6 +1403,56 @@ dns_db_hashsize(dns_db_t *db);
  *      0 if not implemented.
  */
 
+void
+dns_db_adjusthashsize(dns_db_t *db, unsigned int nodecount);
+/*%<
+ * For database implementations using a hash table, grow the table
+ * so that it can hold 'nodecount' names without growing again.
+ * The table is never shrunk, and databases that do not use a hash
+ * table ignore the request.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ */
+
+unsigned int
+dns_db_nodelockstats(dns_db_t *db, uint64_t *waits, unsigned int count);
+/*%<
+ * For database implementations that stripe their nodes over a set of
+ * locks, return the number of node locks and copy the number of times
+ * each lock had to be waited for into the first 'count' elements of
+ * 'waits'.  Databases that do not keep these statistics return 0.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ * \li	'waits' is not NULL if 'count' is not 0.
+ */
+
+void
+dns_db_setnodelockcount(dns_dbtype_t type, unsigned int count);
+
+unsigned int
+dns_db_getnodelockcount(dns_dbtype_t type);
+/*%<
+ * Set/get the number of node locks used by "rbt" databases of 'type'
+ * created from now on.  Stub databases use the zone setting.  The
+ * default, 0, gives caches two locks per CPU (16 to 64) and zones 7.
+ * Existing databases are not affected.
+ *
+ * The counts are process-wide and not locked, so dns_db_setnodelockcount()
+ * must only be called while no other thread can be creating databases:
+ * before the task manager is started, or from a task that holds
+ * exclusive access (isc_task_beginexclusive()).
+ *
+ * Requires (set):
+ *
+ * \li	'count' is 0 or less than 1024; for caches it is not 1.
+ *
+ * \li	No other thread is creating a database.
+ */
+
 void
 dns_db_settask(dns_db_t *db, isc_task_t *task);
 /*%<
@@ -128,6 +128,12 @@ struct dns_dispatchset {
  *
  * _EXCLUSIVE
  *	A separate socket will be used on-demand for each transaction.
+ *
+ * _REUSEPORT
+ *	The UDP socket is bound with SO_REUSEPORT.  When creating a dispatch
+ *	with dns_dispatch_getudp_dup(), a new socket is opened for the same
+ *	address instead of duplicating the one of 'dup', so that the kernel
+ *	balances incoming datagrams between the dispatches.
  */
 #define DNS_DISPATCHATTR_PRIVATE	0x00000001U
 #define DNS_DISPATCHATTR_TCP		0x00000002U
@@ -139,6 +145,7 @@ struct dns_dispatchset {
 #define DNS_DISPATCHATTR_CONNECTED	0x00000080U
 #define DNS_DISPATCHATTR_FIXEDID	0x00000100U
 #define DNS_DISPATCHATTR_EXCLUSIVE	0x00000200U
+#define DNS_DISPATCHATTR_REUSEPORT	0x00000400U
 /*@}*/
 
 /*
@@ -269,6 +276,10 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
  * Attach to existing dns_dispatch_t if one is found with dns_dispatchmgr_find,
  * otherwise create a new UDP dispatch.
  *
+ * If 'dup' is not NULL a new dispatch is always created.  It shares the
+ * socket of 'dup', unless 'attributes' includes DNS_DISPATCHATTR_REUSEPORT,
+ * in which case it gets its own socket bound to the same address.
+ *
  * Requires:
  *\li	All pointer parameters be valid for their respective types.
  *
@@ -68,6 +68,17 @@ struct dns_dnsseckey {
 	ISC_LINK(dns_dnsseckey_t) link;
 };
 
+/*
+ * One signature to be verified by dns_dnssec_verifybatch().
+ */
+typedef struct dns_dnssec_verifyitem {
+	dns_name_t *name;		/*% owner of the RRset */
+	dns_rdataset_t *rdataset;	/*% the signed RRset */
+	dns_rdata_t *sigrdata;		/*% the RRSIG */
+	dns_name_t *wild;		/*% wildcard name, or NULL */
+	isc_result_t result;		/*% set by dns_dnssec_verifybatch() */
+} dns_dnssec_verifyitem_t;
+
 isc_result_t
 dns_dnssec_keyfromrdata(dns_name_t *name, dns_rdata_t *rdata, isc_mem_t *mctx,
 			dst_key_t **key);
@@ -132,6 +143,12 @@ isc_result_t
 dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		   bool ignoretime, unsigned int maxbits,
 		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild);
+
+isc_result_t
+dns_dnssec_verify4(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+		   bool ignoretime, unsigned int maxbits,
+		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild,
+		   dns_verifycache_t *cache);
 /*%<
  *	Verifies the RRSIG record covering this rdataset signed by a specific
  *	key.  This does not determine if the key's owner is authorized to sign
@@ -140,6 +157,12 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
  *
  *	'maxbits' specifies the maximum number of rsa exponent bits accepted.
  *
+ *	If 'cache' is not NULL, a signature that has already been verified
+ *	successfully with the same key over the same data is accepted
+ *	without repeating the public key operation, and a successful
+ *	verification is added to 'cache'.  The temporal validity of the
+ *	signature and the key's flags are still checked.
+ *
  *	Requires:
  *\li		'name' (the owner name of the record) is a valid name
  *\li		'set' is a valid rdataset
@@ -163,6 +186,30 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
  *\li		DST_R_*
  */
 
+isc_result_t
+dns_dnssec_verifybatch(dst_key_t *key, dns_dnssec_verifyitem_t *items,
+		       unsigned int count, bool ignoretime,
+		       unsigned int maxbits, isc_mem_t *mctx,
+		       dns_verifycache_t *cache);
+/*%<
+ *	Verify 'count' RRSIG records that were all made by 'key', as
+ *	dns_dnssec_verify4() would verify each of them.  The result for
+ *	each signature is stored in its item's 'result'.  Work that depends
+ *	only on the key is done once for the whole batch.
+ *
+ *	Requires:
+ *\li		'key' is a valid key
+ *\li		'items' points to 'count' items, each of which has a valid
+ *		'name', 'rdataset' and 'sigrdata' as dns_dnssec_verify4()
+ *		requires; 'wild' may be NULL
+ *\li		'mctx' is not NULL
+ *
+ *	Returns:
+ *\li		#ISC_R_SUCCESS - every signature verified (some may be
+ *			#DNS_R_FROMWILDCARD)
+ *\li		the result of the first signature that failed to verify
+ */
+
 /*@{*/
 isc_result_t
 dns_dnssec_findzonekeys(dns_db_t *db, dns_dbversion_t *ver, dns_dbnode_t *node,
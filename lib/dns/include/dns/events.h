@@ -78,6 +78,8 @@
 #define DNS_EVENT_CATZMODZONE			(ISC_EVENTCLASS_DNS + 55)
 #define DNS_EVENT_CATZDELZONE			(ISC_EVENTCLASS_DNS + 56)
 #define DNS_EVENT_STARTUPDATE			(ISC_EVENTCLASS_DNS + 58)
+#define DNS_EVENT_CRYPTOWORK			(ISC_EVENTCLASS_DNS + 59)
+#define DNS_EVENT_CRYPTODONE			(ISC_EVENTCLASS_DNS + 60)
 
 #define DNS_EVENT_FIRSTEVENT			(ISC_EVENTCLASS_DNS + 0)
 #define DNS_EVENT_LASTEVENT			(ISC_EVENTCLASS_DNS + 65535)
@@ -20,6 +20,12 @@
 /*! \file dns/journal.h
  * \brief
  * Database journaling.
+ *
+ * A journal file "name.jnl" may be accompanied by a serial index file
+ * "name.jdx" listing the position of every transaction in it, which
+ * lets a transaction be found without reading the ones before it.
+ * The serial index file is maintained by the journal writers, checked
+ * against the journal before use, and may safely be removed.
  */
 
 /***
@@ -197,6 +203,18 @@ dns_journal_iter_init(dns_journal_t *j,
  *			this particular serial number does not exist.
  */
 
+isc_result_t
+dns_journal_iter_init2(dns_journal_t *j,
+		       uint32_t begin_serial, uint32_t end_serial,
+		       size_t *sizep);
+/*%<
+ * Like dns_journal_iter_init(), but if 'sizep' is not NULL also store
+ * in '*sizep' the number of bytes the transactions take up in the
+ * journal file.  Since the transactions are found through the serial
+ * index file, this is cheap enough to be used to decide whether the
+ * journal has grown large compared with the zone.
+ */
+
 /*@{*/
 isc_result_t
 dns_journal_first_rr(dns_journal_t *j);
@@ -280,6 +298,12 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
  * Attempt to compact the journal if it is greater that 'target_size'.
  * Changes from 'serial' onwards will be preserved.  If the journal
  * exists and is non-empty 'serial' must exist in the journal.
+ *
+ * The transactions that are kept are copied to a new journal, which
+ * then replaces the old one; readers that have the old journal open
+ * are not affected.  This does not need to be done while holding any
+ * lock that the journal's readers use, but it must not run at the
+ * same time as a writer of the same journal.
  */
 
 bool
@@ -52,6 +52,12 @@
 #define DNS_MASTER_KEY	 	0x00004000	/*%< Loading a key zone master file. */
 #define DNS_MASTER_NOTTL	0x00008000	/*%< Don't require ttl. */
 #define DNS_MASTER_CHECKTTL	0x00010000	/*%< Check max-zone-ttl */
+#define DNS_MASTER_MAPTRUSTED	0x00020000	/*%<
+						 * Use a map file that is
+						 * mapped where it was
+						 * written for without
+						 * checking its CRC
+						 */
 
 ISC_LANG_BEGINDECLS
 
@@ -62,6 +68,9 @@ ISC_LANG_BEGINDECLS
  * is always "packed", regardless of the hardware architecture.
  */
 #define DNS_RAWFORMAT_VERSION 1
+#define DNS_RAWFORMAT_CACHEVERSION 2	/*%< version 1 with a trust level
+					 * in each RRset; only used for
+					 * cache snapshots */
 
 /*
  * Flags to indicate the status of the data in the raw file header
@@ -69,6 +78,12 @@ ISC_LANG_BEGINDECLS
 #define DNS_MASTERRAW_COMPAT 		0x01
 #define DNS_MASTERRAW_SOURCESERIALSET	0x02
 #define DNS_MASTERRAW_LASTXFRINSET	0x04
+#define DNS_MASTERRAW_CACHE		0x08	/*%< Cache snapshot: each
+						 * RRset carries its trust
+						 * level, and TTLs are
+						 * relative to 'dumptime';
+						 * requires version
+						 * DNS_RAWFORMAT_CACHEVERSION */
 
 /* Common header */
 struct dns_masterrawheader {
@@ -79,7 +94,8 @@ struct dns_masterrawheader {
 	uint32_t		version;	/* compatibility for future
 						 * extensions */
 	uint32_t		dumptime;	/* timestamp on creation
-						 * (currently unused) */
+						 * (used to age the TTLs of
+						 * cache snapshots) */
 	uint32_t		flags;		/* Flags */
 	uint32_t		sourceserial;	/* Source serial number (used
 						 * by inline-signing zones) */
@@ -97,9 +113,23 @@ typedef struct {
 	dns_rdatatype_t		covers;		/* same as type */
 	dns_ttl_t		ttl;		/* 32-bit TTL */
 	uint32_t		nrdata;		/* number of RRs in this set */
-	/* followed by encoded owner name, and then rdata */
+	/*
+	 * followed by a 16-bit trust level if the file header has version
+	 * DNS_RAWFORMAT_CACHEVERSION, then encoded owner name, and then
+	 * rdata
+	 */
 } dns_masterrawrdataset_t;
 
+/*%
+ * Throughput of a master file load; see dns_loadctx_getstats().
+ */
+struct dns_masterloadstats {
+	uint64_t		records;	/*%< rdata added */
+	uint64_t		bytes;		/*%< size of the file */
+	unsigned int		threads;	/*%< parsing threads, or 0 */
+	uint64_t		usecs;		/*%< duration of the load */
+};
+
 /*
  * Method prototype: a callback to register each include file as
  * it is encountered.
@@ -166,6 +196,20 @@ dns_master_loadfile5(const char *master_file,
 		     dns_masterformat_t format,
 		     dns_ttl_t maxttl);
 
+isc_result_t
+dns_master_loadfile6(const char *master_file,
+		     dns_name_t *top,
+		     dns_name_t *origin,
+		     dns_rdataclass_t zclass,
+		     unsigned int options,
+		     uint32_t resign,
+		     dns_rdatacallbacks_t *callbacks,
+		     dns_masterincludecb_t include_cb,
+		     void *include_arg, isc_mem_t *mctx,
+		     dns_masterformat_t format,
+		     dns_ttl_t maxttl, dns_cryptopool_t *pool,
+		     dns_masterloadstats_t *stats);
+
 isc_result_t
 dns_master_loadstream(FILE *stream,
 		      dns_name_t *top,
@@ -258,6 +302,21 @@ dns_master_loadfileinc5(const char *master_file,
 			isc_mem_t *mctx, dns_masterformat_t format,
 			uint32_t maxttl);
 
+isc_result_t
+dns_master_loadfileinc6(const char *master_file,
+			dns_name_t *top,
+			dns_name_t *origin,
+			dns_rdataclass_t zclass,
+			unsigned int options,
+			uint32_t resign,
+			dns_rdatacallbacks_t *callbacks,
+			isc_task_t *task,
+			dns_loaddonefunc_t done, void *done_arg,
+			dns_loadctx_t **ctxp,
+			dns_masterincludecb_t include_cb, void *include_arg,
+			isc_mem_t *mctx, dns_masterformat_t format,
+			uint32_t maxttl, dns_cryptopool_t *pool);
+
 isc_result_t
 dns_master_loadstreaminc(FILE *stream,
 			 dns_name_t *top,
@@ -300,6 +359,12 @@ dns_master_loadlexerinc(isc_lex_t *lex,
  *
  * If 'DNS_MASTER_AGETTL' is set and the master file contains one or more
  * $DATE directives, the TTLs of the data will be aged accordingly.
+ * The same applies to the dump time of a raw format cache snapshot
+ * (DNS_MASTERRAW_CACHE); RRsets that have expired since the snapshot
+ * was written are skipped.
+ *
+ * Rdatasets are committed with trust level dns_trust_ultimate, except
+ * when loading a cache snapshot, which records the trust of each RRset.
  *
  * 'callbacks->commit' is assumed to call 'callbacks->error' or
  * 'callbacks->warn' to generate any error messages required.
@@ -311,6 +376,24 @@ dns_master_loadlexerinc(isc_lex_t *lex,
  * 'resign' the number of seconds before a RRSIG expires that it should
  * be re-signed.  0 is used if not provided.
  *
+ * If 'pool' is not NULL, a large text master file is read in chunks
+ * that start at a record with an explicit owner name, and the chunks
+ * are parsed by the threads of 'pool'.  dns_master_loadfileinc6()
+ * queues each chunk with dns_cryptopool_run() and adds its rdatasets
+ * from 'task' once it has been parsed; dns_master_loadfile6() parses
+ * the chunks in batches with dns_cryptopool_runall() and adds them
+ * itself.  Either way the rdatasets are added in file order, but
+ * 'callbacks->warn' and 'callbacks->error' may be called from the
+ * pool's threads.  Once a $INCLUDE directive, or a $ORIGIN or $TTL
+ * directive that cannot be parsed, has been seen, no more chunks are
+ * cut and the rest of the file is parsed by the loading task, or the
+ * calling thread for dns_master_loadfile6(), which then also calls
+ * 'include_cb'.  'include_cb' is called from a pool thread only when
+ * the end of the file was reached while cutting the last chunk and
+ * that chunk holds the $INCLUDE directive.  A file without a $TTL
+ * directive near its start is loaded as if 'pool' were NULL.  If 'stats' is not NULL, dns_master_loadfile6()
+ * fills it in as dns_loadctx_getstats() would.
+ *
  * Requires:
  *\li	'master_file' points to a valid string.
  *\li	'lexer' points to a valid lexer.
@@ -371,6 +454,19 @@ dns_loadctx_cancel(dns_loadctx_t *ctx);
  *\li	'ctx' to be valid
  */
 
+void
+dns_loadctx_getstats(dns_loadctx_t *ctx, dns_masterloadstats_t *stats);
+/*%<
+ * Fill in '*stats' with the number of records that have been added,
+ * the size of the master file, the number of threads that parsed it
+ * (zero if it was parsed by the loading task alone), and, once the
+ * load has completed, the time it took in microseconds.
+ *
+ * Requires:
+ *\li	'ctx' to be valid
+ *\li	'stats' is not NULL
+ */
+
 void
 dns_master_initrawheader(dns_masterrawheader_t *header);
 /*%<
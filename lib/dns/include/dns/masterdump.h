@@ -290,7 +290,18 @@ dns_master_dumptostream3(isc_mem_t *mctx, dns_db_t *db,
  * a NULL header.
  *
  * If 'format' is dns_masterformat_raw, then 'header' can contain
- * information to be written to the file header.
+ * information to be written to the file header.  A raw dump of a cache
+ * database with a 'style' that includes DNS_STYLEFLAG_TRUST is written
+ * as a cache snapshot (DNS_MASTERRAW_CACHE): the trust level of each
+ * RRset is recorded, and negative cache entries are omitted.
+ *
+ * dns_master_dumpinc4() throttles the dump if 'rl' is not NULL and
+ * 'chunk' is not zero: each step writes about 'chunk' bytes, and the
+ * event for the next step is queued on the rate limiter 'rl' rather
+ * than sent straight to 'task', so that the rate limiter's interval sets
+ * the rate at which the file is written.  A dump in the
+ * dns_masterformat_map format is written in a single step.
+ * dns_master_dumpinc3() is dns_master_dumpinc4() without throttling.
  *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
@@ -327,6 +338,14 @@ dns_master_dumpinc3(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		    *done_arg, dns_dumpctx_t **dctxp,
 		    dns_masterformat_t format, dns_masterrawheader_t *header);
 
+isc_result_t
+dns_master_dumpinc4(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
+		    const dns_master_style_t *style, const char *filename,
+		    isc_task_t *task, dns_dumpdonefunc_t done, void *done_arg,
+		    dns_dumpctx_t **dctxp, dns_masterformat_t format,
+		    dns_masterrawheader_t *header, isc_ratelimiter_t *rl,
+		    size_t chunk);
+
 isc_result_t
 dns_master_dump(isc_mem_t *mctx, dns_db_t *db,
 		dns_dbversion_t *version,
@@ -355,7 +374,18 @@ dns_master_dump3(isc_mem_t *mctx, dns_db_t *db,
  * always specify a NULL header.
  *
  * If 'format' is dns_masterformat_raw, then 'header' can contain
- * information to be written to the file header.
+ * information to be written to the file header.  A raw dump of a cache
+ * database with a 'style' that includes DNS_STYLEFLAG_TRUST is written
+ * as a cache snapshot (DNS_MASTERRAW_CACHE): the trust level of each
+ * RRset is recorded, and negative cache entries are omitted.
+ *
+ * dns_master_dumpinc4() throttles the dump if 'rl' is not NULL and
+ * 'chunk' is not zero: each step writes about 'chunk' bytes, and the
+ * event for the next step is queued on the rate limiter 'rl' rather
+ * than sent straight to 'task', so that the rate limiter's interval sets
+ * the rate at which the file is written.  A dump in the
+ * dns_masterformat_map format is written in a single step.
+ * dns_master_dumpinc3() is dns_master_dumpinc4() without throttling.
  *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
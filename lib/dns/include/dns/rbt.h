@@ -111,13 +111,8 @@ struct dns_rbtnode {
 	unsigned int oldnamelen : 8;    /*%< range is 1..255 */
 	/*@}*/
 
-	/* flags needed for serialization to file*/
+	/* node is part of a map file image */
 	unsigned int is_mmapped : 1;
-	unsigned int parent_is_relative : 1;
-	unsigned int left_is_relative : 1;
-	unsigned int right_is_relative : 1;
-	unsigned int down_is_relative : 1;
-	unsigned int data_is_relative : 1;
 
 	/* node needs to be cleaned from rpz */
 	unsigned int rpz : 1;
@@ -180,6 +175,7 @@ typedef isc_result_t (*dns_rbtfindcallback_t)(dns_rbtnode_t *node,
 typedef isc_result_t (*dns_rbtdatawriter_t)(FILE *file,
 					    unsigned char *data,
 					    void *arg,
+					    uintptr_t node,
 					    uint64_t *crc);
 
 typedef isc_result_t (*dns_rbtdatafixer_t)(dns_rbtnode_t *rbtnode,
@@ -696,6 +692,18 @@ dns_rbt_hashsize(dns_rbt_t *rbt);
  * \li  rbt is a valid rbt manager.
  */
 
+void
+dns_rbt_adjusthashsize(dns_rbt_t *rbt, unsigned int nodecount);
+/*%<
+ * Grow the 'rbt' hash table, if necessary, so that it can hold
+ * 'nodecount' nodes without growing again.  Existing nodes are moved
+ * to the larger table incrementally as new nodes are added.  The
+ * table is never shrunk.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ */
+
 void
 dns_rbt_destroy(dns_rbt_t **rbtp);
 isc_result_t
@@ -733,10 +741,18 @@ dns_rbt_serialize_align(off_t target);
 isc_result_t
 dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 		       dns_rbtdatawriter_t datawriter,
-		       void *writer_arg, off_t *offset);
+		       void *writer_arg, uintptr_t base, off_t *offset);
 /*%<
  * Write out the RBT structure and its data to a file.
  *
+ * The image is written to be used in place when the file is mapped at
+ * address 'base': every pointer in it, and the tree's hash table, is
+ * stored as it will be at that address.  'datawriter' is called for
+ * each node with data, with the address the node will have; it must
+ * store the data the same way.  If 'base' is 0, the pointers are
+ * offsets into the file and the image always has to be relocated when
+ * it is read back.
+ *
  * Notes:
  * \li  The file must be an actual file which allows seek() calls, so it cannot
  *      be a stream.  Returns ISC_R_INVALIDFILE if not.
@@ -747,10 +763,24 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 			 off_t header_offset, isc_mem_t *mctx,
 			 dns_rbtdeleter_t deleter, void *deleter_arg,
 			 dns_rbtdatafixer_t datafixer, void *fixer_arg,
-			 dns_rbtnode_t **originp, dns_rbt_t **rbtp);
+			 bool trusted, dns_rbtnode_t **originp,
+			 dns_rbt_t **rbtp);
 /*%<
  * Read a RBT structure and its data from a file.
  *
+ * The image must lie within the first 'filesize' bytes.  Every node is
+ * checked against the image's CRC, relocated if the file is not mapped
+ * at the address the image was written for, and passed to 'datafixer'
+ * if it has data, which must add the data to the CRC and relocate it
+ * by the same amount.  Nodes are only written to when they have to be
+ * relocated, so that pages of the file are otherwise shared until a
+ * node on them is changed.
+ *
+ * If 'trusted' is true and the file is mapped at the address the image
+ * was written for, the nodes are used as they are without being read
+ * or checked, and 'datafixer' is not called.  The caller must know
+ * that the image is intact.
+ *
  * If 'originp' is not NULL, then it is pointed to the root node of the RBT.
  *
  * Notes:
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#ifndef DNS_RESPCACHE_H
+#define DNS_RESPCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/respcache.h
+ * \brief
+ * Defines dns_respcache_t, a cache of rendered authoritative responses.
+ *
+ * Notes:
+ *\li	A response cache maps a question (name, type and class, plus
+ *	caller supplied flags describing the parts of the request that
+ *	change the answer) to the wire format of the response that was
+ *	sent for it, without its OPT or TSIG records.  A server can answer
+ *	a repeated question by copying the cached response and patching
+ *	the message ID, instead of searching its zones and rendering the
+ *	response again.
+ *
+ *\li	The owner name is matched case-sensitively, since the question
+ *	section of the cached response echoes it.
+ *
+ *\li	Every cached response is tagged with the generations of the
+ *	zone table, zones and databases it was built from, recorded
+ *	with dns_respcache_adddep() before each of them was searched.
+ *	dns_respcache_invalidate() is called whenever one of them
+ *	changes; it advances that object's generation and so
+ *	invalidates the responses that depend on it, in every response
+ *	cache, while other responses stay valid.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	Each cache holds at most the number of entries given to
+ *	dns_respcache_create(); the least recently used entries are
+ *	discarded first.
+ *
+ * Security:
+ *\li	Callers must only cache responses that would be sent unchanged
+ *	to any client that can reach the lookup, i.e. responses that did
+ *	not depend on the client's address, keys or ACLs.
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/buffer.h>
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/*%
+ * Responses larger than this are not cached.
+ */
+#define DNS_RESPCACHE_MAXRESPONSE	4096
+
+/*%
+ * The lookup key of a cached response.  'flags' is opaque to the cache
+ * and only compared for equality.
+ */
+typedef struct dns_respcachekey {
+	const dns_name_t *	qname;
+	dns_rdatatype_t		qtype;
+	dns_rdataclass_t	qclass;
+	unsigned int		flags;
+} dns_respcachekey_t;
+
+/*%
+ * A response built from more than this many objects is not cached.
+ */
+#define DNS_RESPCACHE_MAXDEPS		8
+
+/*%
+ * The generations of the objects a response was built from.
+ */
+typedef struct dns_respcachedeps {
+	unsigned int		count;
+	bool			overflow;
+	uint32_t		slots[DNS_RESPCACHE_MAXDEPS];
+	uint32_t		generations[DNS_RESPCACHE_MAXDEPS];
+} dns_respcachedeps_t;
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, unsigned int maxentries,
+		     dns_respcache_t **rcp);
+/*%
+ * Create a response cache holding at most 'maxentries' responses and
+ * store it in '*rcp'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	maxentries > 0
+ * \li	rcp != NULL && *rcp == NULL
+ */
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp);
+/*%
+ * Flush and then free the response cache in '*rcp'.  '*rcp' is set to
+ * NULL on return.
+ *
+ * Requires:
+ * \li	'*rcp' to be a valid response cache
+ */
+
+void
+dns_respcache_initdeps(dns_respcachedeps_t *deps);
+/*%
+ * Start recording the objects a response is built from in 'deps'.
+ *
+ * Requires:
+ * \li	deps != NULL
+ */
+
+void
+dns_respcache_adddep(dns_respcachedeps_t *deps, const void *object);
+/*%
+ * Record the current generation of 'object', a zone table, zone or
+ * database, in 'deps'.  Callers record each object before they look
+ * up data in it.
+ *
+ * Requires:
+ * \li	deps != NULL
+ * \li	object != NULL
+ */
+
+void
+dns_respcache_invalidate(const void *object);
+/*%
+ * Invalidate every response cached so far that depends on 'object',
+ * in all response caches.  Called after a change to 'object' becomes
+ * visible to queries.
+ *
+ * Requires:
+ * \li	object != NULL
+ */
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *rc, const dns_respcachedeps_t *deps,
+		  const dns_respcachekey_t *key, const isc_region_t *response);
+/*%
+ * Copy 'response', the rendered response to the question 'key', into
+ * the response cache 'rc'.  An existing response for 'key' is replaced.
+ *
+ * 'deps' holds the objects the response was built from; if any of
+ * them has changed since it was recorded, or there were too many of
+ * them, the response may be stale and is not cached.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache
+ * \li	deps != NULL
+ * \li	'key' to have an absolute qname
+ * \li	response->length >= DNS_MESSAGE_HEADERLEN
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_IGNORE	one of 'deps' has changed, or there were
+ *			too many of them
+ * \li	ISC_R_NOSPACE	the response is larger than
+ *			DNS_RESPCACHE_MAXRESPONSE
+ * \li	ISC_R_NOMEMORY
+ */
+
+isc_result_t
+dns_respcache_get(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		  isc_buffer_t *target);
+/*%
+ * Look up the response to the question 'key' in 'rc' and, if one
+ * is cached and still valid, append it to 'target'.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache
+ * \li	'key' to have an absolute qname
+ * \li	'target' to be a valid buffer
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOTFOUND	no valid response is cached
+ * \li	ISC_R_NOSPACE	the cached response does not fit in 'target';
+ *			'target' is unchanged
+ */
+
+void
+dns_respcache_flush(dns_respcache_t *rc);
+/*%
+ * Remove all responses from 'rc'.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache
+ */
+
+unsigned int
+dns_respcache_count(dns_respcache_t *rc);
+/*%
+ * Return the number of responses held by 'rc', including ones that
+ * have been invalidated but not yet discarded.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_RESPCACHE_H */
@@ -21,6 +21,7 @@
 #include <stdbool.h>
 
 #include <isc/lang.h>
+#include <isc/mutex.h>
 
 #include <dns/fixedname.h>
 #include <dns/rdata.h>
@@ -198,9 +199,55 @@ struct dns_rrl_rate {
 };
 
 /*
- * Per-view query rate limit parameters and a pointer to database.
+ * One independently locked part of the table of rate-limit entries.
+ * All of the entries for a client address block live in the same shard,
+ * so a single call to dns_rrl() takes exactly one shard lock.
  */
 typedef struct dns_rrl dns_rrl_t;
+typedef struct dns_rrl_shard dns_rrl_shard_t;
+struct dns_rrl_shard {
+	isc_mutex_t	lock;
+	dns_rrl_t	*rrl;
+
+	int		num_entries;
+
+	unsigned int	probes;
+	unsigned int	searches;
+
+	ISC_LIST(dns_rrl_block_t) blocks;
+	ISC_LIST(dns_rrl_entry_t) lru;
+
+	dns_rrl_hash_t	*hash;
+	dns_rrl_hash_t	*old_hash;
+	unsigned int	hash_gen;
+
+	unsigned int	ts_gen;
+# define DNS_RRL_TS_BASES   (1<<DNS_RRL_TS_GEN_BITS)
+	isc_stdtime_t	ts_bases[DNS_RRL_TS_BASES];
+
+	isc_stdtime_t	log_stops_time;
+	dns_rrl_entry_t	*last_logged;
+	int		num_logged;
+	int		num_qnames;
+	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
+# define DNS_RRL_QNAMES	    (1<<DNS_RRL_QNAMES_BITS)
+	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
+};
+
+/*
+ * Split the table into at most this many shards, but give each shard
+ * at least DNS_RRL_SHARD_MIN_ENTRIES of the min-table-size entries.
+ */
+#define DNS_RRL_MAX_SHARDS		16
+#define DNS_RRL_SHARD_MIN_ENTRIES	32
+
+/*
+ * Per-view query rate limit parameters and a pointer to database.
+ * The parameters are set before the first call to dns_rrl() and
+ * not changed afterwards.  'lock' protects the qps estimate and the
+ * scaled rates, which are only used when qps-scale is configured, and
+ * the count of entries shared by all of the shards.
+ */
 struct dns_rrl {
 	isc_mutex_t	lock;
 	isc_mem_t	*mctx;
@@ -216,41 +263,22 @@ struct dns_rrl {
 	int		window;
 	double		qps_scale;
 	int		max_entries;
+	int		num_entries;
 
 	dns_acl_t	*exempt;
 
-	int		num_entries;
-
 	int		qps_responses;
 	isc_stdtime_t	qps_time;
 	double		qps;
 
-	unsigned int	probes;
-	unsigned int	searches;
-
-	ISC_LIST(dns_rrl_block_t) blocks;
-	ISC_LIST(dns_rrl_entry_t) lru;
-
-	dns_rrl_hash_t	*hash;
-	dns_rrl_hash_t	*old_hash;
-	unsigned int	hash_gen;
-
-	unsigned int	ts_gen;
-# define DNS_RRL_TS_BASES   (1<<DNS_RRL_TS_GEN_BITS)
-	isc_stdtime_t	ts_bases[DNS_RRL_TS_BASES];
-
 	int		ipv4_prefixlen;
 	uint32_t	ipv4_mask;
 	int		ipv6_prefixlen;
 	uint32_t	ipv6_mask[4];
 
-	isc_stdtime_t	log_stops_time;
-	dns_rrl_entry_t	*last_logged;
-	int		num_logged;
-	int		num_qnames;
-	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
-# define DNS_RRL_QNAMES	    (1<<DNS_RRL_QNAMES_BITS)
-	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
+	unsigned int	nshards;
+	unsigned int	shard_bits;
+	dns_rrl_shard_t	*shards;
 };
 
 typedef enum {
@@ -71,7 +71,17 @@ enum {
 	dns_resstatscounter_zonequota = 41,
 	dns_resstatscounter_serverquota = 42,
 	dns_resstatscounter_nextitem = 43,
-	dns_resstatscounter_max = 44,
+	dns_resstatscounter_bucketwait = 44,
+	dns_resstatscounter_bucketwaitmax = 45,
+	dns_resstatscounter_bucketmax = 46,
+	dns_resstatscounter_cryptoqueued = 47,
+	dns_resstatscounter_cryptoqueuemax = 48,
+	dns_resstatscounter_cryptolatlt1ms = 49,
+	dns_resstatscounter_cryptolatlt10ms = 50,
+	dns_resstatscounter_cryptolatlt100ms = 51,
+	dns_resstatscounter_cryptolatge100ms = 52,
+	dns_resstatscounter_chainmax = 53,
+	dns_resstatscounter_max = 54,
 
 	/*
 	 * DNSSEC stats.
@@ -80,8 +90,9 @@ enum {
 	dns_dnssecstats_downcase = 1,
 	dns_dnssecstats_wildcard = 2,
 	dns_dnssecstats_fail = 3,
+	dns_dnssecstats_cached = 4,
 
-	dns_dnssecstats_max = 4,
+	dns_dnssecstats_max = 5,
 
 	/*%
 	 * Zone statistics counters.
@@ -109,8 +120,14 @@ enum {
 	dns_adbstats_entriescnt = 1,
 	dns_adbstats_nnames = 2,
 	dns_adbstats_namescnt = 3,
+	dns_adbstats_namehit = 4,
+	dns_adbstats_namemiss = 5,
+	dns_adbstats_namegrow = 6,
+	dns_adbstats_entryhit = 7,
+	dns_adbstats_entrymiss = 8,
+	dns_adbstats_entrygrow = 9,
 
-	dns_adbstats_max = 4,
+	dns_adbstats_max = 10,
 
 	/*
 	 * Cache statistics values.
@@ -228,9 +245,18 @@ dns_generalstats_create(isc_mem_t *mctx, dns_stats_t **statsp, int ncounters);
 
 isc_result_t
 dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
+
+isc_result_t
+dns_rdatatypestats_create2(isc_mem_t *mctx, dns_stats_t **statsp,
+			   unsigned int options);
 /*%<
  * Create a statistics counter structure per rdatatype.
  *
+ * dns_rdatatypestats_create2() passes 'options' to isc_stats_create2();
+ * ISC_STATSCREATE_PERTHREAD is meant for the few server-wide counters
+ * that every query updates, as it multiplies their memory by the
+ * number of CPUs.
+ *
  * Requires:
  *\li	'mctx' must be a valid memory context.
  *
@@ -260,9 +286,15 @@ dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 
 isc_result_t
 dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
+
+isc_result_t
+dns_opcodestats_create2(isc_mem_t *mctx, dns_stats_t **statsp,
+			unsigned int options);
 /*%<
  * Create a statistics counter structure per opcode.
  *
+ * dns_opcodestats_create2() passes 'options' to isc_stats_create2().
+ *
  * Requires:
  *\li	'mctx' must be a valid memory context.
  *
@@ -276,9 +308,15 @@ dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 
 isc_result_t
 dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
+
+isc_result_t
+dns_rcodestats_create2(isc_mem_t *mctx, dns_stats_t **statsp,
+		       unsigned int options);
 /*%<
  * Create a statistics counter structure per assigned rcode.
  *
+ * dns_rcodestats_create2() passes 'options' to isc_stats_create2().
+ *
  * Requires:
  *\li	'mctx' must be a valid memory context.
  *
@@ -54,6 +54,7 @@ typedef void					dns_clientupdatetrans_t;
 typedef struct dns_cache			dns_cache_t;
 typedef uint16_t				dns_cert_t;
 typedef struct dns_compress			dns_compress_t;
+typedef struct dns_cryptopool			dns_cryptopool_t;
 typedef struct dns_db				dns_db_t;
 typedef struct dns_dbimplementation		dns_dbimplementation_t;
 typedef struct dns_dbiterator			dns_dbiterator_t;
@@ -100,6 +101,7 @@ typedef struct dns_keytable			dns_keytable_t;
 typedef uint16_t				dns_keytag_t;
 typedef struct dns_loadctx			dns_loadctx_t;
 typedef struct dns_loadmgr			dns_loadmgr_t;
+typedef struct dns_masterloadstats		dns_masterloadstats_t;
 typedef struct dns_masterrawheader		dns_masterrawheader_t;
 typedef uint64_t				dns_masterstyle_flags_t;
 typedef struct dns_message			dns_message_t;
@@ -129,6 +131,7 @@ typedef uint16_t				dns_rdatatype_t;
 typedef struct dns_request			dns_request_t;
 typedef struct dns_requestmgr			dns_requestmgr_t;
 typedef struct dns_resolver			dns_resolver_t;
+typedef struct dns_respcache			dns_respcache_t;
 typedef struct dns_sdbimplementation		dns_sdbimplementation_t;
 typedef uint8_t					dns_secalg_t;
 typedef uint8_t					dns_secproto_t;
@@ -145,10 +148,12 @@ typedef struct dns_tsigkey			dns_tsigkey_t;
 typedef uint32_t				dns_ttl_t;
 typedef struct dns_update_state			dns_update_state_t;
 typedef struct dns_validator			dns_validator_t;
+typedef struct dns_verifycache			dns_verifycache_t;
 typedef struct dns_view				dns_view_t;
 typedef ISC_LIST(dns_view_t)			dns_viewlist_t;
 typedef struct dns_zone				dns_zone_t;
 typedef ISC_LIST(dns_zone_t)			dns_zonelist_t;
+typedef struct dns_zoneloadprogress		dns_zoneloadprogress_t;
 typedef struct dns_zonemgr			dns_zonemgr_t;
 typedef struct dns_zt				dns_zt_t;
 typedef struct dns_ipkeylist 			dns_ipkeylist_t;
@@ -430,7 +435,7 @@ typedef bool
 		    isc_sockaddr_t *, dns_rdataclass_t, void *);
 
 typedef isc_result_t
-(*dns_deserializefunc_t)(void *, FILE *, off_t);
+(*dns_deserializefunc_t)(void *, FILE *, off_t, unsigned int);
 
 typedef void
 (*dns_nseclog_t)(void *val, int , const char *, ...);
@@ -161,6 +161,7 @@ struct dns_validator {
 	unsigned int			authcount;
 	unsigned int			authfail;
 	isc_stdtime_t			start;
+	struct dns_valverify *		verifyjob;
 };
 
 /*%
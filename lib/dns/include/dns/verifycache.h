@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#ifndef DNS_VERIFYCACHE_H
+#define DNS_VERIFYCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/verifycache.h
+ * \brief
+ * Defines dns_verifycache_t, a cache of recent successful DNSSEC
+ * signature verifications.
+ *
+ * Notes:
+ *\li	Each entry is a SHA-256 digest of everything that went into one
+ *	successful signature verification: the DNSKEY, the RRSIG rdata
+ *	including the signature, and the canonical form of the signed
+ *	RRset.  If the same signature over the same data with the same key
+ *	is seen again (typically because the data has been fetched again
+ *	after expiring from the cache) dns_dnssec_verify4() can skip the
+ *	public key operation.
+ *
+ *\li	Only the cryptographic result is cached.  The validity period of
+ *	the signature, and whether the key is trusted, are checked by the
+ *	caller every time.
+ *
+ *\li	The cache is bounded by a memory size.  When it is full, the least
+ *	recently used entries are discarded.
+ *
+ * MP:
+ *\li	The cache is internally locked.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/sha2.h>
+
+#include <dns/types.h>
+
+#define DNS_VERIFYCACHE_DIGESTLEN	ISC_SHA256_DIGESTLENGTH
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_verifycache_create(isc_mem_t *mctx, size_t maxsize,
+		       dns_verifycache_t **vcp);
+/*%
+ * Create a verification cache that will use at most 'maxsize' bytes of
+ * memory, and store it in '*vcp'.  A 'maxsize' of zero creates a cache
+ * that never holds anything.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	vcp != NULL && *vcp == NULL
+ */
+
+void
+dns_verifycache_destroy(dns_verifycache_t **vcp);
+/*%
+ * Flush and then free the cache in '*vcp'.  '*vcp' is set to NULL on
+ * return.
+ *
+ * Requires:
+ * \li	'*vcp' to be a valid verification cache
+ */
+
+void
+dns_verifycache_setmaxsize(dns_verifycache_t *vc, size_t maxsize);
+/*%
+ * Change the memory limit of 'vc'.  The cache is flushed if the limit
+ * changes.
+ *
+ * Requires:
+ * \li	'vc' to be a valid verification cache
+ */
+
+size_t
+dns_verifycache_getmaxsize(dns_verifycache_t *vc);
+/*%
+ * Return the memory limit of 'vc'.
+ *
+ * Requires:
+ * \li	'vc' to be a valid verification cache
+ */
+
+void
+dns_verifycache_flush(dns_verifycache_t *vc);
+/*%
+ * Discard every entry in 'vc'.
+ *
+ * Requires:
+ * \li	'vc' to be a valid verification cache
+ */
+
+bool
+dns_verifycache_find(dns_verifycache_t *vc, const unsigned char *digest);
+/*%
+ * Return true if 'digest' records a successful verification.
+ *
+ * Requires:
+ * \li	'vc' to be a valid verification cache
+ * \li	'digest' to point to DNS_VERIFYCACHE_DIGESTLEN bytes
+ */
+
+void
+dns_verifycache_add(dns_verifycache_t *vc, const unsigned char *digest);
+/*%
+ * Record 'digest' as a successful verification, discarding the least
+ * recently used entry if the cache is full.  Failure to allocate memory
+ * is not reported; the verification is simply not cached.
+ *
+ * Requires:
+ * \li	'vc' to be a valid verification cache
+ * \li	'digest' to point to DNS_VERIFYCACHE_DIGESTLEN bytes
+ */
+
+unsigned int
+dns_verifycache_count(dns_verifycache_t *vc);
+/*%
+ * Return the number of entries in 'vc'.
+ *
+ * Requires:
+ * \li	'vc' to be a valid verification cache
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_VERIFYCACHE_H */
@@ -148,6 +148,7 @@ struct dns_view {
 	dns_rbt_t *			denyanswernames;
 	dns_rbt_t *			answernames_exclude;
 	dns_rrl_t *			rrl;
+	dns_respcache_t *		respcache;
 	bool			provideixfr;
 	bool			requestnsid;
 	bool			sendcookie;
@@ -182,6 +183,8 @@ struct dns_view {
 	dns_dlzdblist_t 		dlz_unsearched;
 	uint32_t			fail_ttl;
 	dns_badcache_t			*failcache;
+	dns_verifycache_t		*verifycache;
+	dns_cryptopool_t		*cryptopool;
 
 	/*
 	 * Configurable data for server use only,
@@ -1080,6 +1083,17 @@ dns_view_getresstats(dns_view_t *view, isc_stats_t **statsp);
  *\li	'statsp' != NULL && '*statsp' != NULL
  */
 
+void
+dns_view_setcryptopool(dns_view_t *view, dns_cryptopool_t *pool);
+/*%<
+ * Set the pool of threads the view's validators use to verify
+ * signatures.  If 'pool' is NULL, signatures are verified by the
+ * validator's own task.
+ *
+ * Requires:
+ * \li	'view' is valid and is not frozen.
+ */
+
 void
 dns_view_setresquerystats(dns_view_t *view, dns_stats_t *stats);
 /*%<
@@ -18,6 +18,7 @@
  ***	Imports
  ***/
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdbool.h>
 
@@ -50,6 +51,25 @@ typedef enum {
 	dns_zonestat_full
 } dns_zonestat_level_t;
 
+typedef enum {
+	dns_zoneloadorder_none = 0,
+	dns_zoneloadorder_size
+} dns_zoneloadorder_t;
+
+/*%
+ * Progress of the zone loads queued by dns_zone_asyncload(); see
+ * dns_zonemgr_getloadprogress().
+ */
+struct dns_zoneloadprogress {
+	unsigned int		total;		/*%< zones queued */
+	unsigned int		loaded;		/*%< zones finished */
+	unsigned int		active;		/*%< zones being loaded */
+	uint64_t		bytes;		/*%< size of the queued files */
+	uint64_t		bytesloaded;	/*%< size of the finished files */
+	uint64_t		usecs;		/*%< time spent so far */
+	uint64_t		eta;		/*%< estimated time left, usecs */
+};
+
 #define DNS_ZONEOPT_SERVERS	  0x00000001U	/*%< perform server checks */
 #define DNS_ZONEOPT_PARENTS	  0x00000002U	/*%< perform parent checks */
 #define DNS_ZONEOPT_CHILDREN	  0x00000004U	/*%< perform child checks */
@@ -345,6 +365,26 @@ dns_zone_getmaxrecords(dns_zone_t *zone);
  *\li	uint32_t maxrecords.
  */
 
+void
+dns_zone_setexpectednames(dns_zone_t *zone, uint32_t names);
+/*%<
+ *	Sets the number of names the zone is expected to hold.  New
+ *	databases for the zone are created with a name hash table
+ *	large enough for that many names.  0 means no hint.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+uint32_t
+dns_zone_getexpectednames(dns_zone_t *zone);
+/*%<
+ *	Gets the number of names the zone is expected to hold.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
 void
 dns_zone_setmaxttl(dns_zone_t *zone, uint32_t maxttl);
 /*%<
@@ -369,6 +409,26 @@ dns_zone_getmaxttl(dns_zone_t *zone);
  *\li	dns_ttl_t maxttl.
  */
 
+void
+dns_zone_setloadpriority(dns_zone_t *zone, unsigned int priority);
+/*%<
+ * 	Sets the priority of the zone's asynchronous loads.  When the
+ *	zone manager has more loads queued than it runs at once, those
+ *	of higher priority are started first.  The default is 0.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+unsigned int
+dns_zone_getloadpriority(dns_zone_t *zone);
+/*%<
+ * 	Gets the load priority of the zone.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
 isc_result_t
 dns_zone_load(dns_zone_t *zone);
 
@@ -416,6 +476,11 @@ dns_zone_asyncload2(dns_zone_t *zone, dns_zt_zoneloaded_t done, void *arg,
  * expected to point to the zone table but is left undefined for testing
  * purposes.)
  *
+ * The load is queued by the zone manager, which starts it once fewer
+ * than its load limit are running; see dns_zonemgr_setloadlimit().
+ * If the zone manager is shut down first, 'done' is called without the
+ * zone having been loaded.
+ *
  * Require:
  *\li	'zone' to be a valid zone.
  *
@@ -424,6 +489,7 @@ dns_zone_asyncload2(dns_zone_t *zone, dns_zt_zoneloaded_t done, void *arg,
  *\li	#ISC_R_SUCCESS
  *\li	#ISC_R_FAILURE
  *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_SHUTTINGDOWN
  */
 
 bool
@@ -1269,6 +1335,30 @@ dns_zone_getjournalsize(dns_zone_t *zone);
  *\li	'zone' to be a valid zone.
  */
 
+void
+dns_zone_setdumpjournalratio(dns_zone_t *zone, uint32_t ratio);
+/*%<
+ *	Put off writing the zone's master file for as long as the journal
+ *	holds every change made since the file was last written and those
+ *	changes take up less than 'ratio' percent of the size of the file.
+ *	The changes are not lost, as they are applied from the journal
+ *	when the zone is loaded.  A dump requested with dns_zone_flush()
+ *	is never put off.  Zero, the default, writes the master file
+ *	whenever the zone has changed.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ */
+
+uint32_t
+dns_zone_getdumpjournalratio(dns_zone_t *zone);
+/*%<
+ *	Return the value set with dns_zone_setdumpjournalratio().
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ */
+
 isc_result_t
 dns_zone_notifyreceive(dns_zone_t *zone, isc_sockaddr_t *from,
 		       dns_message_t *msg);
@@ -1806,6 +1896,90 @@ dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr);
  *\li	'zmgr' to be a valid zone manager.
  */
 
+isc_result_t
+dns_zonemgr_setloadlimit(dns_zonemgr_t *zmgr, unsigned int limit);
+/*%<
+ *	Set the number of asynchronous zone loads that are run at the
+ *	same time.  Loads beyond the limit wait in a queue ordered by
+ *	zone load priority and then as set by dns_zonemgr_setloadorder().
+ *	Each running load gets a task of its own, so with a limit no
+ *	larger than the number of worker threads every load has a thread
+ *	to itself.  0, the default, starts every load as soon as it is
+ *	queued, on the zone's own load task.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	Any error that isc_task_create() can return.  The limit is
+ *	left unchanged.
+ */
+
+unsigned int
+dns_zonemgr_getloadlimit(dns_zonemgr_t *zmgr);
+/*%<
+ *	Get the number of asynchronous zone loads run at the same time.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
+void
+dns_zonemgr_setloadorder(dns_zonemgr_t *zmgr, dns_zoneloadorder_t order);
+/*%<
+ *	Set the order in which queued zone loads of the same priority
+ *	are started: dns_zoneloadorder_none starts them in the order in
+ *	which they were queued, dns_zoneloadorder_size starts the zones
+ *	with the largest master files first.  Starting the largest zones
+ *	first keeps one of them from being left to load on its own at the
+ *	end.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
+void
+dns_zonemgr_holdloads(dns_zonemgr_t *zmgr);
+/*%<
+ *	Queue the zone loads requested until the matching
+ *	dns_zonemgr_releaseloads() call without starting them, so that
+ *	they can be started in order of priority rather than in the order
+ *	of the calls.  Calls nest.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
+void
+dns_zonemgr_releaseloads(dns_zonemgr_t *zmgr);
+/*%<
+ *	Undo one dns_zonemgr_holdloads() call, and start as many of the
+ *	queued zone loads as the limit allows once none is left.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	A matching dns_zonemgr_holdloads() call.
+ */
+
+void
+dns_zonemgr_getloadprogress(dns_zonemgr_t *zmgr,
+			    dns_zoneloadprogress_t *progress);
+/*%<
+ *	Fill in '*progress' for the zone loads queued since the zone
+ *	manager last had none queued or running.  Once they are all
+ *	finished the totals are kept until the next load is queued;
+ *	'eta' is then 0.  While loads are running, 'eta' is estimated from
+ *	the share of the queued master file bytes loaded so far, or, if
+ *	the sizes are not known, from the share of zones; it is 0 until
+ *	the first zone is finished.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'progress' is not NULL.
+ */
+
 void
 dns_zonemgr_setnotifyrate(dns_zonemgr_t *zmgr, unsigned int value);
 /*%<
@@ -1860,6 +2034,51 @@ dns_zonemgr_getserialqueryrate(dns_zonemgr_t *zmgr);
  *\li	'zmgr' to be a valid zone manager.
  */
 
+void
+dns_zonemgr_setdumprate(dns_zonemgr_t *zmgr, unsigned int value);
+/*%<
+ *	Limit the rate at which zones are written to their master files
+ *	in the background to about 'value' bytes per second, shared by all
+ *	of the zones.  Zero, the default, writes them as fast as the
+ *	task manager allows.  Dumps requested with dns_zone_flush() or
+ *	dns_zone_dump() are not limited, nor is a background dump that
+ *	starts after dns_zone_flush() has been called.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager
+ */
+
+unsigned int
+dns_zonemgr_getdumprate(dns_zonemgr_t *zmgr);
+/*%<
+ *	Return the value set with dns_zonemgr_setdumprate().
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
+isc_ratelimiter_t *
+dns__zone_dumprl(dns_zone_t *zone, size_t *chunkp);
+/*%<
+ * Return the rate limiter a background dump of 'zone' would use now,
+ * setting '*chunkp' to the bytes written per tick, or NULL and 0 if the
+ * dump would not be limited.
+ * (Not currently intended for use outside of this module and associated
+ * tests.)
+ */
+
+void
+dns_zonemgr_setcryptopool(dns_zonemgr_t *zmgr, dns_cryptopool_t *pool);
+/*%<
+ *	Have the zones managed by 'zmgr' compute the signatures made by
+ *	incremental signing on the threads of 'pool', replacing any
+ *	previous pool.  If 'pool' is NULL the signatures are computed
+ *	by the zone's task.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
 unsigned int
 dns_zonemgr_getcount(dns_zonemgr_t *zmgr, int state);
 /*%<
@@ -2165,6 +2384,23 @@ dns_zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm,
  * that match the given algorithm and keyid.
  */
 
+isc_result_t
+dns_zone_getsigningprogress(dns_zone_t *zone, dns_secalg_t algorithm,
+			    uint16_t keyid, uint32_t *nodesp);
+/*%<
+ * Set '*nodesp' to the number of names processed so far by the
+ * signing of the zone with, or the removal of the signatures of,
+ * the key that matches 'algorithm' and 'keyid'.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'nodesp' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND if the zone is not being signed with that key.
+ */
+
 isc_result_t
 dns_zone_addnsec3chain(dns_zone_t *zone, dns_rdata_nsec3param_t *nsec3param);
 /*%<
@@ -313,6 +313,15 @@ struct dns_journal {
 	unsigned char		*rawindex;	/*%< In-core buffer for journal index in on-disk format */
 	journal_pos_t		*index;		/*%< In-core journal index */
 
+	/*% Serial index file state. */
+	struct {
+		FILE *		fp;		/*%< File handle */
+		bool		writable;	/*%< Opened for update */
+		bool		failed;		/*%< Do not try it again */
+		uint32_t	count;		/*%< Number of entries */
+		journal_pos_t	next;		/*%< After the last entry */
+	} jdx;
+
 	/*% Current transaction state (when writing). */
 	struct {
 		unsigned int	n_soa;		/*%< Number of SOAs seen */
@@ -495,6 +504,312 @@ journal_read_rrhdr(dns_journal_t *j, journal_rrhdr_t *rrhdr) {
 	return (ISC_R_SUCCESS);
 }
 
+static isc_result_t journal_next(dns_journal_t *j, journal_pos_t *pos);
+
+/*
+ * The serial index file.
+ *
+ * The index that follows the journal header has room for only a few
+ * dozen entries, so finding a transaction in a long journal means
+ * reading the header of every transaction between the nearest index
+ * entry and the one wanted.  The serial index file, kept next to the
+ * journal as <name>.jdx, lists the position of every transaction in
+ * the order in which they were written.  Offsets increase along the
+ * list, and so, in serial number arithmetic, do the serial numbers of
+ * the addressable transactions, which allows a binary search.
+ *
+ * The file is a hint.  It is written after the journal has been
+ * committed and is not synced; an entry is checked against the
+ * transaction header it points to before it is used, and a file that
+ * does not match its journal is ignored until a writer rebuilds it.
+ */
+#define JDX_HEADER_SIZE 16
+
+static unsigned char jdx_format[JDX_HEADER_SIZE] = ";BIND JDX V1\n";
+
+static isc_result_t
+jdx_name(const char *filename, char *buf, size_t size) {
+	size_t namelen;
+
+	namelen = strlen(filename);
+	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0)
+		namelen -= 4;
+
+	return (isc_string_printf(buf, size, "%.*s.jdx",
+				  (int)namelen, filename));
+}
+
+static void
+jdx_close(dns_journal_t *j) {
+	if (j->jdx.fp != NULL)
+		(void)isc_stdio_close(j->jdx.fp);
+	j->jdx.fp = NULL;
+	j->jdx.writable = false;
+	j->jdx.count = 0;
+	POS_INVALIDATE(j->jdx.next);
+}
+
+/*
+ * Stop using the serial index file of 'j'.  The journal does not
+ * depend on it, so this is not an error.
+ */
+static void
+jdx_fail(dns_journal_t *j, const char *what, isc_result_t result) {
+	isc_log_write(JOURNAL_DEBUG_LOGARGS(1),
+		      "%s: serial index %s: %s",
+		      j->filename, what, isc_result_totext(result));
+	jdx_close(j);
+	j->jdx.failed = true;
+}
+
+/*
+ * Empty the serial index file of 'j'.
+ */
+static isc_result_t
+jdx_reset(dns_journal_t *j) {
+	char name[1024];
+	isc_result_t result;
+
+	CHECK(jdx_name(j->filename, name, sizeof(name)));
+	CHECK(isc_stdio_seek(j->jdx.fp, 0, SEEK_SET));
+	CHECK(isc_stdio_write(jdx_format, 1, sizeof(jdx_format),
+			      j->jdx.fp, NULL));
+	CHECK(isc_stdio_flush(j->jdx.fp));
+	CHECK(isc_file_truncate(name, JDX_HEADER_SIZE));
+	j->jdx.count = 0;
+	POS_INVALIDATE(j->jdx.next);
+
+ failure:
+	return (result);
+}
+
+/*
+ * Open the serial index file of 'j', for update if 'writable' is true.
+ * A writable file that is missing or not recognized is started afresh.
+ */
+static isc_result_t
+jdx_open(dns_journal_t *j, bool writable) {
+	char name[1024];
+	unsigned char format[JDX_HEADER_SIZE];
+	off_t size;
+	isc_result_t result;
+
+	if (j->jdx.failed)
+		return (ISC_R_FAILURE);
+	if (j->jdx.fp != NULL && (j->jdx.writable || !writable))
+		return (ISC_R_SUCCESS);
+
+	jdx_close(j);
+	CHECK(jdx_name(j->filename, name, sizeof(name)));
+	result = isc_stdio_open(name, writable ? "rb+" : "rb", &j->jdx.fp);
+	if (result == ISC_R_FILENOTFOUND && writable)
+		result = isc_stdio_open(name, "wb+", &j->jdx.fp);
+	if (result == ISC_R_FILENOTFOUND) {
+		j->jdx.failed = true;
+		return (result);
+	}
+	CHECK(result);
+	j->jdx.writable = writable;
+
+	CHECK(isc_file_getsizefd(fileno(j->jdx.fp), &size));
+	if (size >= JDX_HEADER_SIZE) {
+		CHECK(isc_stdio_read(format, 1, sizeof(format),
+				     j->jdx.fp, NULL));
+		if (memcmp(format, jdx_format, sizeof(format)) == 0) {
+			j->jdx.count = (uint32_t)((size - JDX_HEADER_SIZE) /
+						  sizeof(journal_rawpos_t));
+			return (ISC_R_SUCCESS);
+		}
+	}
+	if (!writable)
+		FAIL(ISC_R_NOTFOUND);
+	CHECK(jdx_reset(j));
+	return (ISC_R_SUCCESS);
+
+ failure:
+	jdx_fail(j, "open", result);
+	return (result);
+}
+
+static isc_result_t
+jdx_read(dns_journal_t *j, uint32_t i, journal_pos_t *pos) {
+	journal_rawpos_t raw;
+	isc_result_t result;
+
+	CHECK(isc_stdio_seek(j->jdx.fp, JDX_HEADER_SIZE +
+			     (off_t)i * sizeof(raw), SEEK_SET));
+	CHECK(isc_stdio_read(&raw, 1, sizeof(raw), j->jdx.fp, NULL));
+	journal_pos_decode(&raw, pos);
+
+ failure:
+	return (result);
+}
+
+static void
+jdx_append(dns_journal_t *j, journal_pos_t *pos) {
+	journal_rawpos_t raw;
+	isc_result_t result;
+
+	if (j->jdx.fp == NULL)
+		return;
+
+	INSIST(j->jdx.writable);
+	journal_pos_encode(&raw, pos);
+	CHECK(isc_stdio_seek(j->jdx.fp, JDX_HEADER_SIZE +
+			     (off_t)j->jdx.count * sizeof(raw), SEEK_SET));
+	CHECK(isc_stdio_write(&raw, 1, sizeof(raw), j->jdx.fp, NULL));
+	j->jdx.count++;
+	return;
+
+ failure:
+	jdx_fail(j, "write", result);
+}
+
+/*
+ * Check that a transaction with initial serial number pos->serial
+ * starts at pos->offset in the addressable part of the journal 'j'.
+ * If 'next' is not NULL, store the position that follows it there.
+ * Unlike journal_next(), a mismatch is not logged.
+ */
+static bool
+jdx_check(dns_journal_t *j, journal_pos_t *pos, journal_pos_t *next) {
+	journal_xhdr_t xhdr;
+	isc_offset_t end;
+
+	if (pos->offset < j->header.begin.offset ||
+	    pos->offset >= j->header.end.offset)
+		return (false);
+	if (journal_seek(j, pos->offset) != ISC_R_SUCCESS ||
+	    journal_read_xhdr(j, &xhdr) != ISC_R_SUCCESS ||
+	    xhdr.serial0 != pos->serial)
+		return (false);
+
+	end = pos->offset + sizeof(journal_rawxhdr_t) + xhdr.size;
+	if (end <= pos->offset || end > j->header.end.offset)
+		return (false);
+	if (next != NULL) {
+		next->serial = xhdr.serial1;
+		next->offset = end;
+	}
+	return (true);
+}
+
+/*
+ * If the serial index file of 'j' has an entry for a transaction
+ * with a serial number not greater than 'serial' that starts at or
+ * before 'maxoffset', and it is later than '*best_guess', replace
+ * '*best_guess' with the latest such entry.
+ */
+static void
+jdx_find(dns_journal_t *j, uint32_t serial, isc_offset_t maxoffset,
+	 journal_pos_t *best_guess)
+{
+	journal_pos_t pos;
+	uint32_t first, lo, hi, mid;
+	isc_result_t result;
+
+	if (jdx_open(j, false) != ISC_R_SUCCESS)
+		return;
+
+	/*
+	 * Skip the entries for transactions that are no longer
+	 * addressable.
+	 */
+	lo = 0;
+	hi = j->jdx.count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		CHECK(jdx_read(j, mid, &pos));
+		if (pos.offset < j->header.begin.offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	first = lo;
+
+	/*
+	 * Find the first entry that does not qualify.
+	 */
+	hi = j->jdx.count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		CHECK(jdx_read(j, mid, &pos));
+		if (pos.offset <= maxoffset &&
+		    DNS_SERIAL_GE(serial, pos.serial))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == first)
+		return;
+
+	CHECK(jdx_read(j, lo - 1, &pos));
+	if (pos.offset <= best_guess->offset)
+		return;
+	if (!jdx_check(j, &pos, NULL))
+		FAIL(ISC_R_UNEXPECTED);
+	*best_guess = pos;
+	return;
+
+ failure:
+	jdx_fail(j, "lookup", result);
+}
+
+/*
+ * Bring the serial index file of 'j' up to date with the journal,
+ * rebuilding it if it does not match.
+ */
+static void
+jdx_update(dns_journal_t *j) {
+	journal_pos_t pos;
+	isc_result_t result;
+
+	if (jdx_open(j, true) != ISC_R_SUCCESS)
+		return;
+
+	if (!POS_VALID(j->jdx.next) && j->jdx.count != 0) {
+		CHECK(jdx_read(j, j->jdx.count - 1, &pos));
+		if (!jdx_check(j, &pos, &j->jdx.next))
+			POS_INVALIDATE(j->jdx.next);
+	}
+	if (!POS_VALID(j->jdx.next)) {
+		CHECK(jdx_reset(j));
+		j->jdx.next = j->header.begin;
+	}
+
+	while (j->jdx.next.offset < j->header.end.offset) {
+		jdx_append(j, &j->jdx.next);
+		if (j->jdx.fp == NULL)
+			return;
+		CHECK(journal_next(j, &j->jdx.next));
+	}
+	CHECK(isc_stdio_flush(j->jdx.fp));
+	return;
+
+ failure:
+	jdx_fail(j, "update", result);
+}
+
+/*
+ * Move the serial index file of the journal 'from' to go with the
+ * journal 'to', or remove it if that fails.
+ */
+static void
+jdx_rename(const char *from, const char *to) {
+	char fromname[1024];
+	char toname[1024];
+
+	if (jdx_name(from, fromname, sizeof(fromname)) != ISC_R_SUCCESS ||
+	    jdx_name(to, toname, sizeof(toname)) != ISC_R_SUCCESS)
+		return;
+
+	if (rename(fromname, toname) == -1) {
+		(void)isc_file_remove(toname);
+		if (rename(fromname, toname) == -1)
+			(void)isc_file_remove(fromname);
+	}
+}
+
 static isc_result_t
 journal_file_create(isc_mem_t *mctx, const char *filename) {
 	FILE *fp = NULL;
@@ -504,6 +819,7 @@ journal_file_create(isc_mem_t *mctx, const char *filename) {
 	int index_size = 56; /* XXX configurable */
 	int size;
 	void *mem; /* Memory for temporary index image. */
+	char name[1024];
 
 	INSIST(sizeof(journal_rawheader_t) == JOURNAL_HEADER_SIZE);
 
@@ -552,6 +868,13 @@ journal_file_create(isc_mem_t *mctx, const char *filename) {
 		return (ISC_R_UNEXPECTED);
 	}
 
+	/*
+	 * A serial index file left over from an earlier journal
+	 * of the same name does not apply to this one.
+	 */
+	if (jdx_name(filename, name, sizeof(name)) == ISC_R_SUCCESS)
+		(void)isc_file_remove(name);
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -576,6 +899,11 @@ journal_open(isc_mem_t *mctx, const char *filename, bool writable,
 	j->filename = isc_mem_strdup(mctx, filename);
 	j->index = NULL;
 	j->rawindex = NULL;
+	j->jdx.fp = NULL;
+	j->jdx.writable = false;
+	j->jdx.failed = false;
+	j->jdx.count = 0;
+	POS_INVALIDATE(j->jdx.next);
 
 	if (j->filename == NULL)
 		FAIL(ISC_R_NOMEMORY);
@@ -958,6 +1286,7 @@ journal_find(dns_journal_t *j, uint32_t serial, journal_pos_t *pos) {
 
 	current_pos = j->header.begin;
 	index_find(j, serial, &current_pos);
+	jdx_find(j, serial, j->header.end.offset - 1, &current_pos);
 
 	while (current_pos.serial != serial) {
 		if (DNS_SERIAL_GT(current_pos.serial, serial))
@@ -1231,6 +1560,8 @@ dns_journal_commit(dns_journal_t *j) {
 	 */
 	CHECK(journal_fsync(j));
 
+	jdx_update(j);
+
 	/*
 	 * We no longer have a transaction open.
 	 */
@@ -1262,6 +1593,7 @@ dns_journal_destroy(dns_journal_t **journalp) {
 	j->it.result = ISC_R_FAILURE;
 	dns_name_invalidate(&j->it.name);
 	dns_decompress_invalidate(&j->it.dctx);
+	jdx_close(j);
 	if (j->rawindex != NULL)
 		isc_mem_put(j->mctx, j->rawindex, j->header.index_size *
 			    sizeof(journal_rawpos_t));
@@ -1637,6 +1969,14 @@ size_buffer(isc_mem_t *mctx, isc_buffer_t *b, unsigned size) {
 isc_result_t
 dns_journal_iter_init(dns_journal_t *j,
 		      uint32_t begin_serial, uint32_t end_serial)
+{
+	return (dns_journal_iter_init2(j, begin_serial, end_serial, NULL));
+}
+
+isc_result_t
+dns_journal_iter_init2(dns_journal_t *j,
+		       uint32_t begin_serial, uint32_t end_serial,
+		       size_t *sizep)
 {
 	isc_result_t result;
 
@@ -1646,6 +1986,9 @@ dns_journal_iter_init(dns_journal_t *j,
 	CHECK(journal_find(j, end_serial, &j->it.epos));
 	INSIST(j->it.epos.serial == end_serial);
 
+	if (sizep != NULL)
+		*sizep = j->it.epos.offset - j->it.bpos.offset;
+
 	result = ISC_R_SUCCESS;
  failure:
 	j->it.result = result;
@@ -2128,6 +2471,7 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 	isc_result_t result;
 	unsigned int indexend;
 	char newname[1024];
+	char newjdx[1024];
 	char backup[1024];
 	bool is_backup = false;
 
@@ -2202,6 +2546,8 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 		    j1->index[i].offset > best_guess.offset)
 			best_guess = j1->index[i];
 	}
+	jdx_find(j1, serial, j1->header.end.offset - target_size / 2,
+		 &best_guess);
 
 	current_pos = best_guess;
 	while (current_pos.serial != serial) {
@@ -2272,11 +2618,13 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 		CHECK(journal_fsync(j2));
 
 		/*
-		 * Build new index.
+		 * Build new index and serial index file.
 		 */
+		(void)jdx_open(j2, true);
 		current_pos = j2->header.begin;
 		while (current_pos.serial != j2->header.end.serial) {
 			index_add(j2, &current_pos);
+			jdx_append(j2, &current_pos);
 			CHECK(journal_next(j2, &current_pos));
 		}
 
@@ -2325,11 +2673,14 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 			goto failure;
 		}
 	}
+	jdx_rename(newname, filename);
 
 	result = ISC_R_SUCCESS;
 
  failure:
 	(void)isc_file_remove(newname);
+	if (jdx_name(newname, newjdx, sizeof(newjdx)) == ISC_R_SUCCESS)
+		(void)isc_file_remove(newjdx);
 	if (buf != NULL)
 		isc_mem_put(mctx, buf, size);
 	if (j1 != NULL)
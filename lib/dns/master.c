@@ -16,6 +16,7 @@
 #include <stdbool.h>
 
 #include <isc/event.h>
+#include <isc/file.h>
 #include <isc/lex.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
@@ -25,9 +26,11 @@
 #include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/callbacks.h>
+#include <dns/cryptopool.h>
 #include <dns/events.h>
 #include <dns/fixedname.h>
 #include <dns/master.h>
@@ -87,9 +90,26 @@
 
 #define CHECKNAMESFAIL(x) (((x) & DNS_MASTER_CHECKNAMESFAIL) != 0)
 
+/*%
+ * A large text master file may be parsed by the threads of a crypto
+ * pool.  It is then cut into chunks of at least CHUNKSIZE bytes, read
+ * READSIZE bytes at a time, and the rdatasets parsed from each chunk
+ * are kept in blocks of at least BLOCKSIZE bytes until they are added.
+ * Smaller files are parsed by the loading task alone.
+ */
+#define CHUNKSIZE (1024*1024)
+#define READSIZE (64*1024)
+#define BLOCKSIZE (64*1024)
+#define PARALLELMIN (2*CHUNKSIZE)
+
+#define LOADALIGN(x) (((x) + 7) & ~((size_t)7))
+
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
 
 typedef struct dns_incctx dns_incctx_t;
+typedef struct dns_loadsplit dns_loadsplit_t;
+typedef struct dns_loadchunk dns_loadchunk_t;
+typedef struct dns_loadblock dns_loadblock_t;
 
 /*%
  * Master file load state.
@@ -128,11 +148,16 @@ struct dns_loadctx {
 	dns_rdataclass_t	zclass;
 	dns_fixedname_t		fixed_top;
 	dns_name_t		*top;			/*%< top of zone */
+	unsigned long		commitline;	/*%< of the RRset being
+						 * committed */
+	dns_loadsplit_t		*split;		/*%< parallel parsing */
 
 	/* Members specific to the raw format: */
 	FILE			*f;
 	bool		first;
 	dns_masterrawheader_t	header;
+	dns_trust_t		trust;		/*%< of the RRset being
+						 * committed */
 
 	/* Which fixed buffers we are using? */
 	unsigned int		loop_cnt;		/*% records per quantum,
@@ -148,6 +173,13 @@ struct dns_loadctx {
 
 	dns_masterincludecb_t	include_cb;
 	void			*include_arg;
+
+	/* Statistics */
+	uint64_t		records;
+	uint64_t		bytes;
+	unsigned int		threads;	/*%< that parsed chunks */
+	isc_time_t		start;
+	uint64_t		usecs;
 };
 
 struct dns_incctx {
@@ -166,6 +198,113 @@ struct dns_incctx {
 	unsigned int		current_line;
 };
 
+/*%
+ * State of the parallel parsing of a text master file.  The file is
+ * scanned, outside of comments, quoted strings and parentheses, for
+ * places to cut it, keeping track of $ORIGIN and $TTL so that each
+ * chunk can be parsed without the ones before it.
+ */
+struct dns_loadsplit {
+	dns_cryptopool_t	*pool;
+	char			*filename;
+	isc_result_t		result;		/*%< first fatal error */
+	bool			eof;		/*%< whole file read */
+	bool			finished;	/*%< whole file cut */
+	bool			tail;		/*%< rest left to load_text() */
+	unsigned int		nchunks;	/*%< cut so far */
+	unsigned int		queued;
+	unsigned int		maxqueued;
+	ISC_LIST(dns_loadchunk_t) chunks;	/*%< in file order */
+
+	/* Text read but not yet cut off */
+	off_t			offset;		/*%< of 'text' in the file */
+	unsigned char		*text;
+	size_t			size;
+	size_t			length;
+	size_t			scanned;
+
+	/* State at the start of 'text' */
+	unsigned long		startline;
+	dns_fixedname_t		fixed_startorigin;
+	dns_name_t		*startorigin;
+	bool			startttl_known;
+	uint32_t		startttl;
+
+	/* State at 'scanned' */
+	unsigned long		line;
+	unsigned int		paren;
+	bool			linestart;
+	bool			quote;
+	bool			comment;
+	bool			escape;
+	bool			cut;		/*%< chunks may still be cut */
+	dns_fixedname_t		fixed_origin;
+	dns_name_t		*origin;
+	bool			ttl_known;
+	uint32_t		ttl;
+
+	/* Used to add the parsed rdatasets */
+	dns_rdata_t		*rdata;
+	unsigned int		rdatasize;
+};
+
+/*%
+ * A chunk of a text master file, which starts at the beginning of a
+ * line with an owner name, and the state of the parser there.  The
+ * owner names and rdata parsed by a pool thread are kept as
+ * loadrdataset_t records in 'blocks'.
+ */
+struct dns_loadchunk {
+	dns_loadctx_t		*lctx;		/*%< not attached */
+	unsigned char		*text;
+	size_t			size;
+	size_t			length;
+	unsigned long		line;
+	dns_fixedname_t		fixed_origin;
+	dns_name_t		*origin;
+	bool			ttl_known;
+	uint32_t		ttl;
+	bool			warn_tcr;
+	bool			warn_sigexpired;
+
+	/* Set by the pool thread */
+	dns_loadctx_t		*child;
+	isc_result_t		result;
+	isc_result_t		error;		/*%< kept by MANYERRORS */
+	bool			seen_include;
+	ISC_LIST(dns_loadblock_t) blocks;
+
+	/* Set by the loading task */
+	bool			parsed;
+	ISC_LINK(dns_loadchunk_t) link;
+};
+
+struct dns_loadblock {
+	size_t			size;
+	size_t			used;
+	ISC_LINK(dns_loadblock_t) link;
+	/* Followed by 'size' bytes of loadrdataset_t records */
+};
+
+/*%
+ * A parsed rdataset.  It is followed by the owner name in wire format
+ * and, for each rdata, its length in two bytes and its data, and then
+ * padded to LOADALIGN().
+ */
+typedef struct {
+	size_t			size;
+	dns_rdataclass_t	rdclass;
+	dns_rdatatype_t		type;
+	dns_rdatatype_t		covers;
+	dns_ttl_t		ttl;
+	dns_trust_t		trust;
+	unsigned int		attributes;
+	isc_stdtime_t		resign;
+	unsigned long		line;
+	unsigned int		namelen;
+	unsigned int		count;
+} loadrdataset_t;
+
 #define DNS_LCTX_MAGIC ISC_MAGIC('L','c','t','x')
 #define DNS_LCTX_VALID(lctx) ISC_MAGIC_VALID(lctx, DNS_LCTX_MAGIC)
 
@@ -189,6 +328,20 @@ openfile_map(dns_loadctx_t *lctx, const char *master_file);
 static isc_result_t
 load_map(dns_loadctx_t *lctx);
 
+static isc_result_t
+openfile_pool(dns_loadctx_t *lctx, const char *master_file,
+	      dns_cryptopool_t *pool);
+
+static isc_result_t
+split_open(dns_loadctx_t *lctx, const char *master_file,
+	   dns_cryptopool_t *pool);
+
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx);
+
+static void
+split_destroy(dns_loadctx_t *lctx);
+
 static isc_result_t
 pushfile(const char *master_file, dns_name_t *origin, dns_loadctx_t *lctx);
 
@@ -213,6 +366,9 @@ load_quantum(isc_task_t *task, isc_event_t *event);
 static isc_result_t
 task_send(dns_loadctx_t *lctx);
 
+static void
+load_done(dns_loadctx_t *lctx, isc_result_t result);
+
 static void
 loadctx_destroy(dns_loadctx_t *lctx);
 
@@ -447,6 +603,9 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 	if (lctx->inc != NULL)
 		incctx_destroy(lctx->mctx, lctx->inc);
 
+	if (lctx->split != NULL)
+		split_destroy(lctx);
+
 	if (lctx->f != NULL) {
 		result = isc_stdio_close(lctx->f);
 		if (result != ISC_R_SUCCESS) {
@@ -602,6 +761,13 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 	lctx->include_cb = include_cb;
 	lctx->include_arg = include_arg;
 	isc_stdtime_get(&lctx->now);
+	lctx->commitline = 0;
+	lctx->split = NULL;
+	lctx->records = 0;
+	lctx->bytes = 0;
+	lctx->threads = 0;
+	TIME_NOW(&lctx->start);
+	lctx->usecs = 0;
 
 	lctx->top = dns_fixedname_initname(&lctx->fixed_top);
 	dns_name_toregion(top, &r);
@@ -610,6 +776,7 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 	lctx->f = NULL;
 	lctx->first = true;
 	dns_master_initrawheader(&lctx->header);
+	lctx->trust = dns_trust_ultimate;
 
 	lctx->loop_cnt = (done != NULL) ? 100 : 0;
 	lctx->callbacks = callbacks;
@@ -2216,6 +2383,7 @@ load_header(dns_loadctx_t *lctx) {
 		remainder = sizeof(header.dumptime);
 		break;
 	case DNS_RAWFORMAT_VERSION:
+	case DNS_RAWFORMAT_CACHEVERSION:
 		remainder = sizeof(header) - commonlen;
 		break;
 	default:
@@ -2235,12 +2403,26 @@ load_header(dns_loadctx_t *lctx) {
 
 	isc_buffer_add(&target, (unsigned int)remainder);
 	header.dumptime = isc_buffer_getuint32(&target);
-	if (header.version == DNS_RAWFORMAT_VERSION) {
+	if (header.version != 0) {
 		header.flags = isc_buffer_getuint32(&target);
 		header.sourceserial = isc_buffer_getuint32(&target);
 		header.lastxfrin = isc_buffer_getuint32(&target);
 	}
 
+	/*
+	 * Only raw cache snapshots, and all of them, carry trust levels.
+	 */
+	if ((header.version == DNS_RAWFORMAT_CACHEVERSION) !=
+	    ((header.flags & DNS_MASTERRAW_CACHE) != 0) ||
+	    (header.version == DNS_RAWFORMAT_CACHEVERSION &&
+	     lctx->format != dns_masterformat_raw))
+	{
+		(*callbacks->error)(callbacks,
+				    "dns_master_load: "
+				    "unsupported file format version");
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
 	lctx->first = false;
 	lctx->header = header;
 
@@ -2280,7 +2462,8 @@ load_map(dns_loadctx_t *lctx) {
 
 		result = (*callbacks->deserialize)
 			  (callbacks->deserialize_private,
-			   lctx->f, sizeof(dns_masterrawheader_t));
+			   lctx->f, sizeof(dns_masterrawheader_t),
+			   lctx->options);
 	}
 
 	return (result);
@@ -2318,6 +2501,8 @@ load_raw(dns_loadctx_t *lctx) {
 	isc_buffer_t target, buf;
 	unsigned char *target_mem = NULL;
 	dns_decompress_t dctx;
+	bool snapshot;
+	uint32_t ttl_offset = 0;
 
 	callbacks = lctx->callbacks;
 	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_NONE);
@@ -2328,6 +2513,17 @@ load_raw(dns_loadctx_t *lctx) {
 			return (result);
 	}
 
+	/*
+	 * The TTLs in a cache snapshot were current when the snapshot
+	 * was dumped; age them by the time that has passed since.
+	 */
+	snapshot = ((lctx->header.flags & DNS_MASTERRAW_CACHE) != 0);
+	if (snapshot && (lctx->options & DNS_MASTER_AGETTL) != 0 &&
+	    isc_serial_gt(lctx->now, lctx->header.dumptime))
+	{
+		ttl_offset = lctx->now - lctx->header.dumptime;
+	}
+
 	ISC_LIST_INIT(head);
 	ISC_LIST_INIT(dummy);
 
@@ -2360,6 +2556,7 @@ load_raw(dns_loadctx_t *lctx) {
 		uint32_t totallen;
 		size_t minlen, readlen;
 		bool sequential_read = false;
+		bool expired = false;
 
 		/* Read the data length */
 		isc_buffer_clear(&target);
@@ -2384,6 +2581,8 @@ load_raw(dns_loadctx_t *lctx) {
 		minlen = sizeof(totallen) + sizeof(uint16_t) +
 			sizeof(uint16_t) + sizeof(uint16_t) +
 			sizeof(uint32_t) + sizeof(uint32_t);
+		if (snapshot)
+			minlen += sizeof(uint16_t);
 		if (totallen < minlen) {
 			result = ISC_R_RANGE;
 			goto cleanup;
@@ -2435,6 +2634,21 @@ load_raw(dns_loadctx_t *lctx) {
 			result = ISC_R_RANGE;
 			goto cleanup;
 		}
+		if (snapshot) {
+			lctx->trust = isc_buffer_getuint16(&target);
+			if (lctx->trust > dns_trust_ultimate) {
+				result = ISC_R_RANGE;
+				goto cleanup;
+			}
+			/*
+			 * An RRset that has expired since the snapshot
+			 * was taken is still read, but not committed.
+			 */
+			if (rdatalist.ttl <= ttl_offset)
+				expired = true;
+			else
+				rdatalist.ttl -= ttl_offset;
+		}
 		INSIST(isc_buffer_consumedlength(&target) <= readlen);
 
 		/* Owner name: length followed by name */
@@ -2498,9 +2712,13 @@ load_raw(dns_loadctx_t *lctx) {
 				INSIST(i > 0); /* detect an infinite loop */
 
 				/* Partial Commit. */
-				ISC_LIST_APPEND(head, &rdatalist, link);
-				result = commit(callbacks, lctx, &head, name,
-						NULL, 0);
+				result = ISC_R_SUCCESS;
+				if (!expired) {
+					ISC_LIST_APPEND(head, &rdatalist,
+							link);
+					result = commit(callbacks, lctx,
+							&head, name, NULL, 0);
+				}
 				for (j = 0; j < i; j++) {
 					ISC_LIST_UNLINK(rdatalist.rdata,
 							&rdata[j], link);
@@ -2558,10 +2776,11 @@ load_raw(dns_loadctx_t *lctx) {
 			goto cleanup;
 		}
 
-		ISC_LIST_APPEND(head, &rdatalist, link);
-
 		/* Commit this RRset.  rdatalist will be unlinked. */
-		result = commit(callbacks, lctx, &head, name, NULL, 0);
+		if (!expired) {
+			ISC_LIST_APPEND(head, &rdatalist, link);
+			result = commit(callbacks, lctx, &head, name, NULL, 0);
+		}
 
 		for (i = 0; i < rdcount; i++) {
 			ISC_LIST_UNLINK(rdatalist.rdata, &rdata[i], link);
@@ -2651,9 +2870,26 @@ dns_master_loadfile5(const char *master_file, dns_name_t *top,
 		     dns_masterincludecb_t include_cb, void *include_arg,
 		     isc_mem_t *mctx, dns_masterformat_t format,
 		     dns_ttl_t maxttl)
+{
+	return (dns_master_loadfile6(master_file, top, origin, zclass,
+				     options, resign, callbacks, include_cb,
+				     include_arg, mctx, format, maxttl,
+				     NULL, NULL));
+}
+
+isc_result_t
+dns_master_loadfile6(const char *master_file, dns_name_t *top,
+		     dns_name_t *origin, dns_rdataclass_t zclass,
+		     unsigned int options, uint32_t resign,
+		     dns_rdatacallbacks_t *callbacks,
+		     dns_masterincludecb_t include_cb, void *include_arg,
+		     isc_mem_t *mctx, dns_masterformat_t format,
+		     dns_ttl_t maxttl, dns_cryptopool_t *pool,
+		     dns_masterloadstats_t *stats)
 {
 	dns_loadctx_t *lctx = NULL;
 	isc_result_t result;
+	isc_time_t now;
 
 	result = loadctx_create(format, mctx, options, resign, top, zclass,
 				origin, callbacks, NULL, NULL, NULL,
@@ -2663,12 +2899,24 @@ dns_master_loadfile5(const char *master_file, dns_name_t *top,
 
 	lctx->maxttl = maxttl;
 
-	result = (lctx->openfile)(lctx, master_file);
+	result = openfile_pool(lctx, master_file, pool);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup;
 
 	result = (lctx->load)(lctx);
-	INSIST(result != DNS_R_CONTINUE);
+	if (result == DNS_R_CONTINUE) {
+		/*
+		 * The rest of the file could not be cut up.
+		 */
+		result = (lctx->load)(lctx);
+	}
+	INSIST(result != DNS_R_CONTINUE && result != DNS_R_WAIT);
+
+	if (stats != NULL) {
+		TIME_NOW(&now);
+		lctx->usecs = isc_time_microdiff(&now, &lctx->start);
+		dns_loadctx_getstats(lctx, stats);
+	}
 
  cleanup:
 	dns_loadctx_detach(&lctx);
@@ -2744,6 +2992,24 @@ dns_master_loadfileinc5(const char *master_file, dns_name_t *top,
 			dns_masterincludecb_t include_cb, void *include_arg,
 			isc_mem_t *mctx, dns_masterformat_t format,
 			uint32_t maxttl)
+{
+	return (dns_master_loadfileinc6(master_file, top, origin, zclass,
+					options, resign, callbacks, task,
+					done, done_arg, lctxp, include_cb,
+					include_arg, mctx, format, maxttl,
+					NULL));
+}
+
+isc_result_t
+dns_master_loadfileinc6(const char *master_file, dns_name_t *top,
+			dns_name_t *origin, dns_rdataclass_t zclass,
+			unsigned int options, uint32_t resign,
+			dns_rdatacallbacks_t *callbacks,
+			isc_task_t *task, dns_loaddonefunc_t done,
+			void *done_arg, dns_loadctx_t **lctxp,
+			dns_masterincludecb_t include_cb, void *include_arg,
+			isc_mem_t *mctx, dns_masterformat_t format,
+			uint32_t maxttl, dns_cryptopool_t *pool)
 {
 	dns_loadctx_t *lctx = NULL;
 	isc_result_t result;
@@ -2759,7 +3025,7 @@ dns_master_loadfileinc5(const char *master_file, dns_name_t *top,
 
 	lctx->maxttl = maxttl;
 
-	result = (lctx->openfile)(lctx, master_file);
+	result = openfile_pool(lctx, master_file, pool);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup;
 
@@ -3127,7 +3393,7 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 		dns_rdataset_init(&dataset);
 		RUNTIME_CHECK(dns_rdatalist_tordataset(this, &dataset)
 			      == ISC_R_SUCCESS);
-		dataset.trust = dns_trust_ultimate;
+		dataset.trust = lctx->trust;
 		/*
 		 * If this is a secure dynamic zone set the re-signing time.
 		 */
@@ -3136,8 +3402,11 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 			dataset.attributes |= DNS_RDATASETATTR_RESIGN;
 			dataset.resign = resign_fromlist(this, lctx);
 		}
+		lctx->commitline = line;
 		result = ((*callbacks->add)(callbacks->add_private, owner,
 					    &dataset));
+		if (result == ISC_R_SUCCESS)
+			lctx->records += dns_rdataset_count(&dataset);
 		if (result == ISC_R_NOMEMORY) {
 			(*error)(callbacks, "dns_master_load: %s",
 				 dns_result_totext(result));
@@ -3216,13 +3485,30 @@ load_quantum(isc_task_t *task, isc_event_t *event) {
 	if (result == DNS_R_CONTINUE) {
 		event->ev_arg = lctx;
 		isc_task_send(task, &event);
+	} else if (result == DNS_R_WAIT) {
+		/*
+		 * The chunks being parsed by the pool will finish the load.
+		 */
+		isc_event_free(&event);
 	} else {
-		(lctx->done)(lctx->done_arg, result);
 		isc_event_free(&event);
-		dns_loadctx_detach(&lctx);
+		load_done(lctx, result);
 	}
 }
 
+/*
+ * Record how long the load took, and report its result.
+ */
+static void
+load_done(dns_loadctx_t *lctx, isc_result_t result) {
+	isc_time_t now;
+
+	TIME_NOW(&now);
+	lctx->usecs = isc_time_microdiff(&now, &lctx->start);
+	(lctx->done)(lctx->done_arg, result);
+	dns_loadctx_detach(&lctx);
+}
+
 static isc_result_t
 task_send(dns_loadctx_t *lctx) {
 	isc_event_t *event;
@@ -3245,6 +3531,828 @@ dns_loadctx_cancel(dns_loadctx_t *lctx) {
 	UNLOCK(&lctx->lock);
 }
 
+void
+dns_loadctx_getstats(dns_loadctx_t *lctx, dns_masterloadstats_t *stats) {
+	REQUIRE(DNS_LCTX_VALID(lctx));
+	REQUIRE(stats != NULL);
+
+	stats->records = lctx->records;
+	stats->bytes = lctx->bytes;
+	if (lctx->split != NULL)
+		stats->threads = dns_cryptopool_getworkers(lctx->split->pool);
+	else
+		stats->threads = lctx->threads;
+	stats->usecs = lctx->usecs;
+}
+
+/*
+ * Parallel parsing of text master files.
+ *
+ * The loading task reads the file and cuts it into chunks, each of
+ * which is parsed into a private set of blocks by a pool thread with a
+ * load context of its own.  The loading task then adds the rdatasets
+ * of each chunk with the load's callbacks, in file order, so the
+ * database sees the same sequence of rdatasets as it would from
+ * load_text().
+ */
+
+/*
+ * Open 'master_file', to be parsed by 'pool' if it is worth it.
+ */
+static isc_result_t
+openfile_pool(dns_loadctx_t *lctx, const char *master_file,
+	      dns_cryptopool_t *pool)
+{
+	off_t size;
+
+	if (isc_file_getsize(master_file, &size) == ISC_R_SUCCESS)
+		lctx->bytes = size;
+
+	/*
+	 * $DATE changes the TTLs of the records after it when
+	 * DNS_MASTER_AGETTL is set, so such files are not cut up.
+	 */
+	if (pool != NULL && lctx->format == dns_masterformat_text &&
+	    (lctx->options & DNS_MASTER_AGETTL) == 0 &&
+	    lctx->bytes >= PARALLELMIN)
+		return (split_open(lctx, master_file, pool));
+
+	return ((lctx->openfile)(lctx, master_file));
+}
+
+static isc_result_t
+split_open(dns_loadctx_t *lctx, const char *master_file,
+	   dns_cryptopool_t *pool)
+{
+	dns_loadsplit_t *split;
+	isc_result_t result;
+
+	split = isc_mem_get(lctx->mctx, sizeof(*split));
+	if (split == NULL)
+		return (ISC_R_NOMEMORY);
+
+	split->pool = NULL;
+	split->result = ISC_R_SUCCESS;
+	split->eof = false;
+	split->finished = false;
+	split->tail = false;
+	split->nchunks = 0;
+	split->queued = 0;
+	/*
+	 * Without a task, the chunks are parsed in batches by the pool
+	 * and the calling thread.
+	 */
+	if (lctx->task != NULL)
+		split->maxqueued = 2 * dns_cryptopool_getworkers(pool);
+	else
+		split->maxqueued = dns_cryptopool_getworkers(pool) + 1;
+	ISC_LIST_INIT(split->chunks);
+	split->offset = 0;
+	split->size = CHUNKSIZE + 2 * READSIZE;
+	split->length = 0;
+	split->scanned = 0;
+	split->line = 1;
+	split->paren = 0;
+	split->linestart = true;
+	split->quote = false;
+	split->comment = false;
+	split->escape = false;
+	split->cut = true;
+	split->origin = dns_fixedname_initname(&split->fixed_origin);
+	RUNTIME_CHECK(dns_name_copy(lctx->inc->origin, split->origin,
+				    NULL) == ISC_R_SUCCESS);
+	split->ttl_known = lctx->default_ttl_known;
+	split->ttl = lctx->default_ttl;
+	split->startline = split->line;
+	split->startorigin = dns_fixedname_initname(&split->fixed_startorigin);
+	RUNTIME_CHECK(dns_name_copy(split->origin, split->startorigin,
+				    NULL) == ISC_R_SUCCESS);
+	split->startttl_known = split->ttl_known;
+	split->startttl = split->ttl;
+	split->rdata = NULL;
+	split->rdatasize = 0;
+	lctx->split = split;
+
+	split->filename = isc_mem_strdup(lctx->mctx, master_file);
+	split->text = isc_mem_get(lctx->mctx, split->size);
+	if (split->filename == NULL || split->text == NULL)
+		return (ISC_R_NOMEMORY);
+
+	result = isc_stdio_open(master_file, "r", &lctx->f);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	dns_cryptopool_attach(pool, &split->pool);
+	lctx->load = load_parallel;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+split_destroy(dns_loadctx_t *lctx) {
+	dns_loadsplit_t *split = lctx->split;
+
+	INSIST(ISC_LIST_EMPTY(split->chunks));
+
+	if (split->filename != NULL)
+		isc_mem_free(lctx->mctx, split->filename);
+	if (split->text != NULL)
+		isc_mem_put(lctx->mctx, split->text, split->size);
+	if (split->rdata != NULL)
+		isc_mem_put(lctx->mctx, split->rdata,
+			    split->rdatasize * sizeof(*split->rdata));
+	if (split->pool != NULL)
+		dns_cryptopool_detach(&split->pool);
+	isc_mem_put(lctx->mctx, split, sizeof(*split));
+	lctx->split = NULL;
+}
+
+/*
+ * Follow a $ORIGIN or $TTL directive.  A directive that changes the
+ * parser's state in a way that is not followed here stops the cutting.
+ */
+static void
+split_directive(dns_loadsplit_t *split, unsigned char *text, size_t length)
+{
+	isc_textregion_t keyword, value;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_buffer_t buffer;
+	uint32_t ttl;
+	size_t i = 0, j;
+	isc_result_t result;
+
+	while (i < length && strchr(" \t\r;", text[i]) == NULL)
+		i++;
+	keyword.base = (char *)text;
+	keyword.length = (unsigned int)i;
+	while (i < length && (text[i] == ' ' || text[i] == '\t'))
+		i++;
+	for (j = i; j < length && strchr(" \t\r;", text[j]) == NULL; j++) {
+		if (strchr("\\\"()", text[j]) != NULL) {
+			split->cut = false;
+			return;
+		}
+	}
+	value.base = (char *)text + i;
+	value.length = (unsigned int)(j - i);
+
+	if (keyword.length == 7 &&
+	    strncasecmp(keyword.base, "$ORIGIN", 7) == 0)
+	{
+		name = dns_fixedname_initname(&fixed);
+		isc_buffer_init(&buffer, value.base, value.length);
+		isc_buffer_add(&buffer, value.length);
+		result = dns_name_fromtext(name, &buffer, split->origin,
+					   0, NULL);
+		if (value.length == 0 || result != ISC_R_SUCCESS)
+			split->cut = false;
+		else
+			RUNTIME_CHECK(dns_name_copy(name, split->origin,
+						    NULL) == ISC_R_SUCCESS);
+	} else if (keyword.length == 4 &&
+		   strncasecmp(keyword.base, "$TTL", 4) == 0)
+	{
+		result = dns_ttl_fromtext(&value, &ttl);
+		if (value.length == 0 || result != ISC_R_SUCCESS) {
+			split->cut = false;
+		} else {
+			/* As limit_ttl() does. */
+			if (ttl > 0x7fffffffUL)
+				ttl = 0;
+			split->ttl = ttl;
+			split->ttl_known = true;
+		}
+	} else if (keyword.length == 8 &&
+		   strncasecmp(keyword.base, "$INCLUDE", 8) == 0)
+	{
+		/*
+		 * The included file may change the default TTL.
+		 */
+		split->cut = false;
+	}
+}
+
+/*
+ * Scan the text read so far for the next place to cut it: the start
+ * of a line, outside of parentheses, that begins with an owner name,
+ * at least CHUNKSIZE bytes in.  Returns true and sets '*cutp' if one
+ * was found, or false if more text is needed.
+ */
+static bool
+split_scan(dns_loadsplit_t *split, size_t *cutp) {
+	unsigned char *text = split->text;
+	size_t i, end;
+	unsigned char c;
+
+	for (i = split->scanned; i < split->length; i++) {
+		c = text[i];
+		if (split->linestart) {
+			split->linestart = false;
+			if (split->paren != 0) {
+				/* Not a new record. */
+			} else if (c == '$') {
+				end = i;
+				while (end < split->length && text[end] != '\n')
+					end++;
+				if (end == split->length && !split->eof) {
+					split->linestart = true;
+					split->scanned = i;
+					return (false);
+				}
+				split_directive(split, text + i, end - i);
+			} else if (split->cut && split->ttl_known &&
+				   i >= CHUNKSIZE &&
+				   strchr(" \t\r\n;()\"", c) == NULL)
+			{
+				split->linestart = true;
+				split->scanned = i;
+				*cutp = i;
+				return (true);
+			}
+		}
+
+		if (split->escape) {
+			split->escape = false;
+		} else if (c == '\n') {
+			split->comment = false;
+			split->quote = false;
+			split->linestart = true;
+		} else if (split->comment) {
+			/* Skip to the end of the line. */
+		} else if (c == '\\') {
+			split->escape = true;
+		} else if (split->quote) {
+			if (c == '"')
+				split->quote = false;
+		} else if (c == '"') {
+			split->quote = true;
+		} else if (c == ';') {
+			split->comment = true;
+		} else if (c == '(') {
+			split->paren++;
+		} else if (c == ')' && split->paren > 0) {
+			split->paren--;
+		}
+		if (c == '\n')
+			split->line++;
+	}
+	split->scanned = i;
+	return (false);
+}
+
+/*
+ * Give up on cutting the file.  Once the chunks cut so far have been
+ * added, load_text() parses the rest of it, starting where the last
+ * of them ended with the state the parser had there.
+ */
+static isc_result_t
+split_fallback(dns_loadctx_t *lctx) {
+	dns_loadsplit_t *split = lctx->split;
+	isc_result_t result;
+
+	INSIST(ISC_LIST_EMPTY(split->chunks));
+
+	result = isc_stdio_seek(lctx->f, split->offset, SEEK_SET);
+	if (result == ISC_R_SUCCESS)
+		result = isc_lex_openstream(lctx->lex, lctx->f);
+	if (result == ISC_R_SUCCESS)
+		result = isc_lex_setsourcename(lctx->lex, split->filename);
+	if (result == ISC_R_SUCCESS)
+		result = isc_lex_setsourceline(lctx->lex, split->startline);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	RUNTIME_CHECK(dns_name_copy(split->startorigin, lctx->inc->origin,
+				    NULL) == ISC_R_SUCCESS);
+	lctx->inc->origin_changed = true;
+	if (split->startttl_known) {
+		lctx->ttl = split->startttl;
+		lctx->default_ttl = split->startttl;
+		lctx->default_ttl_known = true;
+	}
+	if (split->nchunks != 0)
+		lctx->threads = dns_cryptopool_getworkers(split->pool);
+
+	split_destroy(lctx);
+	lctx->load = load_text;
+	return (DNS_R_CONTINUE);
+}
+
+/*
+ * Cut the next chunk off the file, reading more of it as needed.
+ * '*chunkp' is left NULL once the whole file has been cut, or once
+ * the rest of it has been left to load_text() because it can no
+ * longer be cut.
+ */
+static isc_result_t
+split_next(dns_loadctx_t *lctx, dns_loadchunk_t **chunkp) {
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	dns_loadsplit_t *split = lctx->split;
+	dns_loadchunk_t *chunk;
+	unsigned char *text;
+	size_t cut, n, size;
+	isc_result_t result;
+
+	REQUIRE(chunkp != NULL && *chunkp == NULL);
+
+	while (!split_scan(split, &cut)) {
+		if (split->eof) {
+			cut = split->length;
+			break;
+		}
+		if (!split->cut || split->length >= PARALLELMIN) {
+			split->tail = true;
+			return (ISC_R_SUCCESS);
+		}
+		if (split->size - split->length < READSIZE) {
+			size = split->size * 2;
+			text = isc_mem_get(lctx->mctx, size);
+			if (text == NULL)
+				return (ISC_R_NOMEMORY);
+			memmove(text, split->text, split->length);
+			isc_mem_put(lctx->mctx, split->text, split->size);
+			split->text = text;
+			split->size = size;
+		}
+		result = isc_stdio_read(split->text + split->length, 1,
+					READSIZE, lctx->f, &n);
+		split->length += n;
+		if (result == ISC_R_EOF) {
+			split->eof = true;
+		} else if (result != ISC_R_SUCCESS) {
+			(*callbacks->error)(callbacks, "%s: %s: %s",
+					    "dns_master_load", split->filename,
+					    dns_result_totext(result));
+			return (result);
+		}
+	}
+
+	if (cut == 0)
+		return (ISC_R_SUCCESS);
+
+	chunk = isc_mem_get(lctx->mctx, sizeof(*chunk));
+	if (chunk == NULL)
+		return (ISC_R_NOMEMORY);
+	size = CHUNKSIZE + 2 * READSIZE;
+	if (split->length - cut + READSIZE > size)
+		size = split->length - cut + READSIZE;
+	text = isc_mem_get(lctx->mctx, size);
+	if (text == NULL) {
+		isc_mem_put(lctx->mctx, chunk, sizeof(*chunk));
+		return (ISC_R_NOMEMORY);
+	}
+
+	chunk->lctx = lctx;
+	chunk->text = split->text;
+	chunk->size = split->size;
+	chunk->length = cut;
+	chunk->line = split->startline;
+	chunk->origin = dns_fixedname_initname(&chunk->fixed_origin);
+	RUNTIME_CHECK(dns_name_copy(split->startorigin, chunk->origin,
+				    NULL) == ISC_R_SUCCESS);
+	chunk->ttl_known = split->startttl_known;
+	chunk->ttl = split->startttl;
+	chunk->warn_tcr = lctx->warn_tcr;
+	chunk->warn_sigexpired = lctx->warn_sigexpired;
+	chunk->child = NULL;
+	chunk->result = ISC_R_SUCCESS;
+	chunk->error = ISC_R_SUCCESS;
+	chunk->seen_include = false;
+	ISC_LIST_INIT(chunk->blocks);
+	chunk->parsed = false;
+	ISC_LINK_INIT(chunk, link);
+
+	/*
+	 * The rest of the text begins the next chunk.
+	 */
+	memmove(text, split->text + cut, split->length - cut);
+	split->offset += cut;
+	split->text = text;
+	split->size = size;
+	split->length -= cut;
+	split->scanned -= cut;
+	split->startline = split->line;
+	RUNTIME_CHECK(dns_name_copy(split->origin, split->startorigin,
+				    NULL) == ISC_R_SUCCESS);
+	split->startttl_known = split->ttl_known;
+	split->startttl = split->ttl;
+
+	*chunkp = chunk;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+chunk_free(dns_loadctx_t *lctx, dns_loadchunk_t *chunk) {
+	dns_loadblock_t *block;
+
+	if (chunk->text != NULL)
+		isc_mem_put(lctx->mctx, chunk->text, chunk->size);
+	while ((block = ISC_LIST_HEAD(chunk->blocks)) != NULL) {
+		ISC_LIST_UNLINK(chunk->blocks, block, link);
+		isc_mem_put(lctx->mctx, block, sizeof(*block) + block->size);
+	}
+	isc_mem_put(lctx->mctx, chunk, sizeof(*chunk));
+}
+
+/*
+ * The 'add' callback of a chunk's load context: append the rdataset
+ * to the chunk's blocks.
+ */
+static isc_result_t
+chunk_add(void *arg, dns_name_t *owner, dns_rdataset_t *rdataset) {
+	dns_loadchunk_t *chunk = arg;
+	isc_mem_t *mctx = chunk->lctx->mctx;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_loadblock_t *block;
+	loadrdataset_t *header;
+	unsigned char *p;
+	unsigned int count = 0;
+	size_t size;
+	isc_result_t result;
+
+	size = sizeof(*header) + owner->length;
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdataset_current(rdataset, &rdata);
+		size += 2 + rdata.length;
+		count++;
+		dns_rdata_reset(&rdata);
+	}
+	size = LOADALIGN(size);
+
+	block = ISC_LIST_TAIL(chunk->blocks);
+	if (block == NULL || block->size - block->used < size) {
+		block = isc_mem_get(mctx, sizeof(*block) +
+				    ISC_MAX(BLOCKSIZE, size));
+		if (block == NULL)
+			return (ISC_R_NOMEMORY);
+		block->size = ISC_MAX(BLOCKSIZE, size);
+		block->used = 0;
+		ISC_LINK_INIT(block, link);
+		ISC_LIST_APPEND(chunk->blocks, block, link);
+	}
+
+	header = (loadrdataset_t *)((unsigned char *)(block + 1) +
+				    block->used);
+	header->size = size;
+	header->rdclass = rdataset->rdclass;
+	header->type = rdataset->type;
+	header->covers = rdataset->covers;
+	header->ttl = rdataset->ttl;
+	header->trust = rdataset->trust;
+	header->attributes = rdataset->attributes & DNS_RDATASETATTR_RESIGN;
+	header->resign = rdataset->resign;
+	header->line = chunk->child->commitline;
+	header->namelen = owner->length;
+	header->count = count;
+
+	p = (unsigned char *)(header + 1);
+	memmove(p, owner->ndata, owner->length);
+	p += owner->length;
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdataset_current(rdataset, &rdata);
+		*p++ = (rdata.length >> 8) & 0xff;
+		*p++ = rdata.length & 0xff;
+		memmove(p, rdata.data, rdata.length);
+		p += rdata.length;
+		dns_rdata_reset(&rdata);
+	}
+
+	block->used += size;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Parse a chunk.  This runs on a pool thread.
+ */
+static void
+chunk_parse(void *arg) {
+	dns_loadchunk_t *chunk = arg;
+	dns_loadctx_t *lctx = chunk->lctx;
+	dns_rdatacallbacks_t callbacks;
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	callbacks = *lctx->callbacks;
+	callbacks.add = chunk_add;
+	callbacks.add_private = chunk;
+
+	result = loadctx_create(dns_masterformat_text, lctx->mctx,
+				lctx->options, lctx->resign, lctx->top,
+				lctx->zclass, chunk->origin, &callbacks,
+				NULL, NULL, NULL, lctx->include_cb,
+				lctx->include_arg, NULL, &chunk->child);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	chunk->child->maxttl = lctx->maxttl;
+	chunk->child->now = lctx->now;
+	if (chunk->ttl_known) {
+		chunk->child->ttl = chunk->ttl;
+		chunk->child->default_ttl = chunk->ttl;
+		chunk->child->default_ttl_known = true;
+	}
+	chunk->child->warn_tcr = chunk->warn_tcr;
+	chunk->child->warn_sigexpired = chunk->warn_sigexpired;
+
+	isc_buffer_init(&buffer, chunk->text, (unsigned int)chunk->length);
+	isc_buffer_add(&buffer, (unsigned int)chunk->length);
+	result = isc_lex_openbuffer(chunk->child->lex, &buffer);
+	if (result == ISC_R_SUCCESS)
+		result = isc_lex_setsourcename(chunk->child->lex,
+					       lctx->split->filename);
+	if (result == ISC_R_SUCCESS)
+		result = isc_lex_setsourceline(chunk->child->lex,
+					       chunk->line);
+	if (result == ISC_R_SUCCESS)
+		result = load_text(chunk->child);
+
+	chunk->error = chunk->child->result;
+	chunk->seen_include = chunk->child->seen_include;
+	chunk->warn_tcr = chunk->child->warn_tcr;
+	chunk->warn_sigexpired = chunk->child->warn_sigexpired;
+	dns_loadctx_detach(&chunk->child);
+
+ cleanup:
+	chunk->result = result;
+	isc_mem_put(lctx->mctx, chunk->text, chunk->size);
+	chunk->text = NULL;
+}
+
+/*
+ * Add the rdatasets parsed from 'chunk', as commit() would have.
+ */
+static isc_result_t
+chunk_commit(dns_loadctx_t *lctx, dns_loadchunk_t *chunk) {
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	dns_loadsplit_t *split = lctx->split;
+	dns_loadblock_t *block;
+	loadrdataset_t *header;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t dataset;
+	dns_offsets_t offsets;
+	dns_name_t owner;
+	dns_rdata_t *rdata;
+	isc_region_t r;
+	unsigned char *p;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	size_t offset;
+	unsigned int i;
+	isc_result_t result;
+
+	if (chunk->seen_include)
+		lctx->seen_include = true;
+	lctx->warn_tcr = (lctx->warn_tcr && chunk->warn_tcr);
+	lctx->warn_sigexpired = (lctx->warn_sigexpired &&
+				 chunk->warn_sigexpired);
+
+	/*
+	 * With DNS_MASTER_MANYERRORS, load_text() returns the first error
+	 * it got past.
+	 */
+	if (chunk->error != ISC_R_SUCCESS)
+		SETRESULT(lctx, chunk->error);
+	if (chunk->result != ISC_R_SUCCESS &&
+	    chunk->result != DNS_R_SEENINCLUDE &&
+	    chunk->result != chunk->error)
+		return (chunk->result);
+
+	for (block = ISC_LIST_HEAD(chunk->blocks);
+	     block != NULL;
+	     block = ISC_LIST_NEXT(block, link))
+	{
+		for (offset = 0; offset < block->used; offset += header->size) {
+			header = (loadrdataset_t *)
+				((unsigned char *)(block + 1) + offset);
+			p = (unsigned char *)(header + 1);
+
+			dns_name_init(&owner, offsets);
+			r.base = p;
+			r.length = header->namelen;
+			dns_name_fromregion(&owner, &r);
+			p += header->namelen;
+
+			if (header->count > split->rdatasize) {
+				rdata = isc_mem_get(lctx->mctx,
+						    header->count *
+						    sizeof(*rdata));
+				if (rdata == NULL)
+					return (ISC_R_NOMEMORY);
+				if (split->rdata != NULL)
+					isc_mem_put(lctx->mctx, split->rdata,
+						    split->rdatasize *
+						    sizeof(*rdata));
+				split->rdata = rdata;
+				split->rdatasize = header->count;
+			}
+
+			dns_rdatalist_init(&rdatalist);
+			rdatalist.rdclass = header->rdclass;
+			rdatalist.type = header->type;
+			rdatalist.covers = header->covers;
+			rdatalist.ttl = header->ttl;
+			for (i = 0; i < header->count; i++) {
+				r.length = (p[0] << 8) | p[1];
+				r.base = p + 2;
+				p += 2 + r.length;
+				dns_rdata_init(&split->rdata[i]);
+				dns_rdata_fromregion(&split->rdata[i],
+						     header->rdclass,
+						     header->type, &r);
+				ISC_LIST_APPEND(rdatalist.rdata,
+						&split->rdata[i], link);
+			}
+
+			dns_rdataset_init(&dataset);
+			RUNTIME_CHECK(dns_rdatalist_tordataset(&rdatalist,
+							       &dataset)
+				      == ISC_R_SUCCESS);
+			dataset.trust = header->trust;
+			dataset.attributes |= header->attributes;
+			dataset.resign = header->resign;
+
+			result = ((*callbacks->add)(callbacks->add_private,
+						    &owner, &dataset));
+			if (result == ISC_R_SUCCESS) {
+				lctx->records += header->count;
+				continue;
+			}
+			if (result == ISC_R_NOMEMORY) {
+				(*callbacks->error)(callbacks,
+						    "dns_master_load: %s",
+						    dns_result_totext(result));
+			} else {
+				dns_name_format(&owner, namebuf,
+						sizeof(namebuf));
+				(*callbacks->error)(callbacks,
+						    "%s: %s:%lu: %s: %s",
+						    "dns_master_load",
+						    split->filename,
+						    header->line, namebuf,
+						    dns_result_totext(result));
+			}
+			if (MANYERRS(lctx, result))
+				SETRESULT(lctx, result);
+			else
+				return (result);
+		}
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static void
+chunk_parseptr(void *arg) {
+	dns_loadchunk_t **chunkp = arg;
+
+	chunk_parse(*chunkp);
+}
+
+/*
+ * Parse the queued chunks, for a load without a task to be told when
+ * each of them is done.  The calling thread parses one of them, and
+ * waits for the pool to parse the others.
+ */
+static void
+split_parseall(dns_loadctx_t *lctx) {
+	dns_loadsplit_t *split = lctx->split;
+	dns_loadchunk_t *chunk, **chunks;
+	unsigned int n = 0;
+
+	chunks = isc_mem_get(lctx->mctx, split->queued * sizeof(*chunks));
+	for (chunk = ISC_LIST_HEAD(split->chunks);
+	     chunk != NULL;
+	     chunk = ISC_LIST_NEXT(chunk, link))
+	{
+		chunk->parsed = true;
+		if (split->result != ISC_R_SUCCESS)
+			continue;
+		if (chunks != NULL)
+			chunks[n++] = chunk;
+		else
+			chunk_parse(chunk);
+	}
+	if (chunks != NULL) {
+		dns_cryptopool_runall(split->pool, lctx->mctx, chunk_parseptr,
+				      chunks, n, sizeof(*chunks));
+		isc_mem_put(lctx->mctx, chunks,
+			    split->queued * sizeof(*chunks));
+	}
+}
+
+static void
+chunk_done(isc_task_t *task, isc_event_t *event) {
+	dns_loadchunk_t *chunk = event->ev_arg;
+	dns_loadctx_t *lctx = chunk->lctx;
+	isc_result_t result;
+
+	UNUSED(task);
+
+	REQUIRE(event->ev_type == DNS_EVENT_CRYPTODONE);
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	isc_event_free(&event);
+
+	chunk->parsed = true;
+	result = load_parallel(lctx);
+	if (result == DNS_R_CONTINUE) {
+		/*
+		 * The rest of the file is left to load_text().
+		 */
+		result = task_send(lctx);
+		if (result == ISC_R_SUCCESS)
+			return;
+	}
+	if (result != DNS_R_WAIT)
+		load_done(lctx, result);
+}
+
+/*
+ * The 'load' method for a file that is parsed by a pool: add the
+ * chunks that have been parsed, and keep up to 'maxqueued' chunks
+ * queued or waiting to be added.  Returns DNS_R_WAIT while chunks are
+ * outstanding, and DNS_R_CONTINUE once they have all been added if the
+ * rest of the file is left to load_text().
+ */
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx) {
+	dns_loadsplit_t *split = lctx->split;
+	dns_loadchunk_t *chunk;
+	isc_result_t result;
+
+ again:
+	while ((chunk = ISC_LIST_HEAD(split->chunks)) != NULL &&
+	       chunk->parsed)
+	{
+		ISC_LIST_UNLINK(split->chunks, chunk, link);
+		split->queued--;
+		if (split->result == ISC_R_SUCCESS)
+			split->result = chunk_commit(lctx, chunk);
+		chunk_free(lctx, chunk);
+	}
+
+	if (lctx->canceled && split->result == ISC_R_SUCCESS)
+		split->result = ISC_R_CANCELED;
+
+	while (split->result == ISC_R_SUCCESS && !split->finished &&
+	       split->queued < split->maxqueued)
+	{
+		chunk = NULL;
+		result = split_next(lctx, &chunk);
+		if (result != ISC_R_SUCCESS) {
+			split->result = result;
+			break;
+		}
+		if (chunk == NULL) {
+			split->finished = true;
+			break;
+		}
+		ISC_LIST_APPEND(split->chunks, chunk, link);
+		split->queued++;
+		split->nchunks++;
+		/*
+		 * An incremental load hands each chunk to the pool as it
+		 * is cut, and chunk_done() adds it from the loading task.
+		 * A load without a task parses its chunks in batches with
+		 * split_parseall() below.
+		 */
+		if (lctx->task == NULL)
+			continue;
+		result = dns_cryptopool_run(split->pool, lctx->mctx,
+					    chunk_parse, lctx->task,
+					    chunk_done, chunk);
+		if (result != ISC_R_SUCCESS) {
+			ISC_LIST_UNLINK(split->chunks, chunk, link);
+			split->queued--;
+			chunk_free(lctx, chunk);
+			split->result = result;
+			break;
+		}
+	}
+
+	if (lctx->task == NULL && !ISC_LIST_EMPTY(split->chunks)) {
+		split_parseall(lctx);
+		goto again;
+	}
+
+	if (!ISC_LIST_EMPTY(split->chunks))
+		return (DNS_R_WAIT);
+
+	if (split->tail && split->result == ISC_R_SUCCESS)
+		return (split_fallback(lctx));
+
+	result = split->result;
+	if (result == ISC_R_SUCCESS && lctx->result != ISC_R_SUCCESS)
+		result = lctx->result;
+	else if (result == ISC_R_SUCCESS && lctx->seen_include)
+		result = DNS_R_SEENINCLUDE;
+	return (result);
+}
+
 void
 dns_master_initrawheader(dns_masterrawheader_t *header) {
 	memset(header, 0, sizeof(dns_masterrawheader_t));
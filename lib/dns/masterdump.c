@@ -23,6 +23,7 @@
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/print.h>
+#include <isc/ratelimiter.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
@@ -233,6 +234,9 @@ struct dns_dumpctx {
 	dns_dumpdonefunc_t	done;
 	void			*done_arg;
 	unsigned int		nodes;
+	/* dns_master_dumpinc4() */
+	isc_ratelimiter_t	*rl;
+	size_t			chunk;
 	/* dns_master_dumpinc() */
 	char			*file;
 	char 			*tmpfile;
@@ -1072,11 +1076,12 @@ dump_rdatasets_text(isc_mem_t *mctx, dns_name_t *name,
 }
 
 /*
- * Dump given RRsets in the "raw" format.
+ * Dump given RRsets in the "raw" format.  If 'trust' is true (a cache
+ * snapshot), the trust level of the RRset follows the common header.
  */
 static isc_result_t
 dump_rdataset_raw(isc_mem_t *mctx, dns_name_t *name, dns_rdataset_t *rdataset,
-		  isc_buffer_t *buffer, FILE *f)
+		  bool trust, isc_buffer_t *buffer, FILE *f)
 {
 	isc_result_t result;
 	uint32_t totallen;
@@ -1107,6 +1112,8 @@ dump_rdataset_raw(isc_mem_t *mctx, dns_name_t *name, dns_rdataset_t *rdataset,
 	isc_buffer_putuint16(buffer, rdataset->covers);	/* same as type */
 	isc_buffer_putuint32(buffer, rdataset->ttl); /* 32-bit TTL */
 	isc_buffer_putuint32(buffer, dns_rdataset_count(rdataset));
+	if (trust)
+		isc_buffer_putuint16(buffer, rdataset->trust);
 	totallen = isc_buffer_usedlength(buffer);
 	INSIST(totallen <= sizeof(dns_masterrawrdataset_t));
 
@@ -1190,6 +1197,7 @@ dump_rdatasets_raw(isc_mem_t *mctx, dns_name_t *owner_name,
 	dns_rdataset_t rdataset;
 	dns_fixedname_t fixed;
 	dns_name_t *name;
+	bool trust = ((ctx->style.flags & DNS_STYLEFLAG_TRUST) != 0);
 
 	name = dns_fixedname_initname(&fixed);
 	dns_name_copy(owner_name, name, NULL);
@@ -1203,11 +1211,14 @@ dump_rdatasets_raw(isc_mem_t *mctx, dns_name_t *owner_name,
 		dns_rdataset_getownercase(&rdataset, name);
 
 		if (((rdataset.attributes & DNS_RDATASETATTR_NEGATIVE) != 0) &&
-		    (ctx->style.flags & DNS_STYLEFLAG_NCACHE) == 0) {
-			/* Omit negative cache entries */
+		    ((ctx->style.flags & DNS_STYLEFLAG_NCACHE) == 0 || trust)) {
+			/*
+			 * Omit negative cache entries; a cache snapshot
+			 * cannot restore them.
+			 */
 		} else {
 			result = dump_rdataset_raw(mctx, name, &rdataset,
-						   buffer, f);
+						   trust, buffer, f);
 		}
 		dns_rdataset_disassociate(&rdataset);
 		if (result != ISC_R_SUCCESS)
@@ -1261,6 +1272,8 @@ dumpctx_destroy(dns_dumpctx_t *dctx) {
 	dns_db_detach(&dctx->db);
 	if (dctx->task != NULL)
 		isc_task_detach(&dctx->task);
+	if (dctx->rl != NULL)
+		isc_ratelimiter_detach(&dctx->rl);
 	if (dctx->file != NULL)
 		isc_mem_free(dctx->mctx, dctx->file);
 	if (dctx->tmpfile != NULL)
@@ -1410,6 +1423,16 @@ dump_quantum(isc_task_t *task, isc_event_t *event) {
 		result = dumptostreaminc(dctx);
 	if (result == DNS_R_CONTINUE) {
 		event->ev_arg = dctx;
+		if (dctx->rl != NULL) {
+			event->ev_sender = NULL;
+			if (isc_ratelimiter_enqueue(dctx->rl, task,
+						    &event) == ISC_R_SUCCESS)
+				return;
+			/*
+			 * The rate limiter is shutting down; write the
+			 * rest of the file without it.
+			 */
+		}
 		isc_task_send(task, &event);
 		return;
 	}
@@ -1460,6 +1483,8 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	dctx->done_arg = NULL;
 	dctx->task = NULL;
 	dctx->nodes = 0;
+	dctx->rl = NULL;
+	dctx->chunk = 0;
 	dctx->first = true;
 	dctx->canceled = false;
 	dctx->file = NULL;
@@ -1497,6 +1522,21 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 
 	dctx->do_date = dns_db_iscache(dctx->db);
 
+	/*
+	 * A raw dump of a cache that asks for trust levels is a cache
+	 * snapshot; otherwise the style does not affect the raw format.
+	 */
+	if (dctx->format == dns_masterformat_raw) {
+		if (dctx->do_date &&
+		    (dctx->tctx.style.flags & DNS_STYLEFLAG_TRUST) != 0)
+		{
+			dctx->header.flags &= ~DNS_MASTERRAW_COMPAT;
+			dctx->header.flags |= DNS_MASTERRAW_CACHE;
+		} else {
+			dctx->tctx.style.flags &= ~DNS_STYLEFLAG_TRUST;
+		}
+	}
+
 	if (dctx->format == dns_masterformat_text &&
 	    (dctx->tctx.style.flags & DNS_STYLEFLAG_REL_OWNER) != 0) {
 		options = DNS_DB_RELATIVENAMES;
@@ -1568,15 +1608,17 @@ writeheader(dns_dumpctx_t *dctx) {
 		r.length = sizeof(rawheader);
 		isc_buffer_region(&buffer, &r);
 		now32 = dctx->now;
-		rawversion = 1;
-		if ((dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0)
+		rawversion = DNS_RAWFORMAT_VERSION;
+		if ((dctx->header.flags & DNS_MASTERRAW_CACHE) != 0)
+			rawversion = DNS_RAWFORMAT_CACHEVERSION;
+		else if ((dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0)
 			rawversion = 0;
 
 		isc_buffer_putuint32(&buffer, dctx->format);
 		isc_buffer_putuint32(&buffer, rawversion);
 		isc_buffer_putuint32(&buffer, now32);
 
-		if (rawversion == 1) {
+		if (rawversion != 0) {
 			isc_buffer_putuint32(&buffer, dctx->header.flags);
 			isc_buffer_putuint32(&buffer,
 					     dctx->header.sourceserial);
@@ -1607,8 +1649,9 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 	char *bufmem;
 	dns_name_t *name;
 	dns_fixedname_t fixname;
-	unsigned int nodes;
+	unsigned int nodes, count = 0;
 	isc_time_t start;
+	off_t begin = 0, offset;
 
 	bufmem = isc_mem_get(dctx->mctx, initial_buffer_length);
 	if (bufmem == NULL)
@@ -1641,6 +1684,14 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 	} else
 		result = ISC_R_SUCCESS;
 
+	/*
+	 * When the dump is throttled, a quantum also ends once about
+	 * 'chunk' bytes have been written.
+	 */
+	if (dctx->chunk != 0 &&
+	    isc_stdio_tell(dctx->f, &begin) != ISC_R_SUCCESS)
+		dctx->chunk = 0;
+
 	nodes = dctx->nodes;
 	isc_time_now(&start);
 	while (result == ISC_R_SUCCESS && (dctx->nodes == 0 || nodes--)) {
@@ -1675,6 +1726,11 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 		}
 		dns_db_detachnode(dctx->db, &node);
 		result = dns_dbiterator_next(dctx->dbiter);
+		count++;
+		if (result == ISC_R_SUCCESS && dctx->chunk != 0 &&
+		    isc_stdio_tell(dctx->f, &offset) == ISC_R_SUCCESS &&
+		    (uint64_t)(offset - begin) >= dctx->chunk)
+			break;
 	}
 
 	/*
@@ -1701,7 +1757,7 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 			if (dctx->nodes > 1000)
 				dctx->nodes = 1000;
 		} else {
-			nodes = dctx->nodes * interval;
+			nodes = count * interval;
 			nodes /= (unsigned int)usecs;
 			if (nodes == 0)
 				nodes = 1;
@@ -1870,6 +1926,19 @@ dns_master_dumpinc3(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		    isc_task_t *task, dns_dumpdonefunc_t done, void *done_arg,
 		    dns_dumpctx_t **dctxp, dns_masterformat_t format,
 		    dns_masterrawheader_t *header)
+{
+	return (dns_master_dumpinc4(mctx, db, version, style, filename, task,
+				    done, done_arg, dctxp, format, header,
+				    NULL, 0));
+}
+
+isc_result_t
+dns_master_dumpinc4(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
+		    const dns_master_style_t *style, const char *filename,
+		    isc_task_t *task, dns_dumpdonefunc_t done, void *done_arg,
+		    dns_dumpctx_t **dctxp, dns_masterformat_t format,
+		    dns_masterrawheader_t *header, isc_ratelimiter_t *rl,
+		    size_t chunk)
 {
 	FILE *f = NULL;
 	isc_result_t result;
@@ -1897,6 +1966,10 @@ dns_master_dumpinc3(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	dctx->done = done;
 	dctx->done_arg = done_arg;
 	dctx->nodes = 100;
+	if (rl != NULL && chunk != 0) {
+		isc_ratelimiter_attach(rl, &dctx->rl);
+		dctx->chunk = chunk;
+	}
 	dctx->file = file;
 	file = NULL;
 	dctx->tmpfile = tempname;
@@ -18,6 +18,11 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include <isc/buffer.h>
 #include <isc/hash.h>
@@ -48,7 +53,6 @@ typedef enum {
 
 typedef enum {
 	fw_start = 0,
-	fw_ordinary,
 	fw_newcurrent
 } fw_state;
 
@@ -106,6 +110,113 @@ static unsigned char maptolower[] = {
 	0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
 };
 
+/*
+ * Case-insensitive handling of name data 16 octets at a time with SSE2
+ * where the compiler targets it, then a word at a time, then octet by
+ * octet.  Label length octets are below 'A' and are unchanged by case
+ * folding, so these apply equally to label contents and to whole names.
+ */
+#define ONES	UINT64_C(0x0101010101010101)
+
+static inline uint64_t
+load8(const unsigned char *p) {
+	uint64_t x;
+
+	memmove(&x, p, sizeof(x));
+	return (x);
+}
+
+static inline void
+store8(unsigned char *p, uint64_t x) {
+	memmove(p, &x, sizeof(x));
+}
+
+/*
+ * Lowercase the eight octets of 'x'.  Each octet is tested on its low
+ * seven bits, which cannot carry into the next octet, and octets with
+ * the top bit set are left alone.
+ */
+static inline uint64_t
+fold8(uint64_t x) {
+	uint64_t heptets = x & (0x7f * ONES);
+	uint64_t ge_a = heptets + (0x80 - 'A') * ONES;
+	uint64_t gt_z = heptets + (0x80 - 'Z' - 1) * ONES;
+	uint64_t upper = ge_a & ~gt_z & ~x & (0x80 * ONES);
+
+	return (x | (upper >> 2));
+}
+
+#if defined(__SSE2__)
+static inline __m128i
+fold16(__m128i v) {
+	/* Octets with the top bit set compare as negative. */
+	__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+				      _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+
+	return (_mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+}
+#endif
+
+/*
+ * Return the index of the first of 'length' octets at which 'a' and 'b'
+ * differ ignoring case, or 'length' if there is none.
+ */
+static inline unsigned int
+fold_mismatch(const unsigned char *a, const unsigned char *b,
+	      unsigned int length)
+{
+	unsigned int i = 0;
+
+#if defined(__SSE2__)
+	while (length - i >= 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+
+		va = fold16(va);
+		vb = fold16(vb);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xffff)
+			break;
+		i += 16;
+	}
+#endif
+	while (length - i >= 8) {
+		if (fold8(load8(a + i)) != fold8(load8(b + i)))
+			break;
+		i += 8;
+	}
+	while (i < length) {
+		if (maptolower[a[i]] != maptolower[b[i]])
+			break;
+		i++;
+	}
+	return (i);
+}
+
+/*
+ * Copy 'length' octets from 'src' to 'dst', lowercasing them.  'dst' may
+ * be the same as 'src', but they must not otherwise overlap.
+ */
+static inline void
+fold_copy(unsigned char *dst, const unsigned char *src, unsigned int length) {
+	unsigned int i = 0;
+
+#if defined(__SSE2__)
+	while (length - i >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i), fold16(v));
+		i += 16;
+	}
+#endif
+	while (length - i >= 8) {
+		store8(dst + i, fold8(load8(src + i)));
+		i += 8;
+	}
+	while (i < length) {
+		dst[i] = maptolower[src[i]];
+		i++;
+	}
+}
+
 #define CONVERTTOASCII(c)
 #define CONVERTFROMASCII(c)
 
@@ -698,10 +809,6 @@ dns_name_compare(const dns_name_t *name1, const dns_name_t *name2) {
 
 bool
 dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l, count;
-	unsigned char c;
-	unsigned char *label1, *label2;
-
 	/*
 	 * Are 'name1' and 'name2' equal?
 	 *
@@ -725,46 +832,15 @@ dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
 	if (name1->length != name2->length)
 		return (false);
 
-	l = name1->labels;
-
-	if (l != name2->labels)
+	if (name1->labels != name2->labels)
 		return (false);
 
-	label1 = name1->ndata;
-	label2 = name2->ndata;
-	while (ISC_LIKELY(l-- > 0)) {
-		count = *label1++;
-		if (count != *label2++)
-			return (false);
-
-		INSIST(count <= 63); /* no bitstring support */
-
-		/* Loop unrolled for performance */
-		while (ISC_LIKELY(count > 3)) {
-			c = maptolower[label1[0]];
-			if (c != maptolower[label2[0]])
-				return (false);
-			c = maptolower[label1[1]];
-			if (c != maptolower[label2[1]])
-				return (false);
-			c = maptolower[label1[2]];
-			if (c != maptolower[label2[2]])
-				return (false);
-			c = maptolower[label1[3]];
-			if (c != maptolower[label2[3]])
-				return (false);
-			count -= 4;
-			label1 += 4;
-			label2 += 4;
-		}
-		while (ISC_LIKELY(count-- > 0)) {
-			c = maptolower[*label1++];
-			if (c != maptolower[*label2++])
-				return (false);
-		}
-	}
-
-	return (true);
+	/*
+	 * Label lengths are not affected by case folding, so the names
+	 * are equal if all of their octets are.
+	 */
+	return (fold_mismatch(name1->ndata, name2->ndata, name1->length) ==
+		name1->length);
 }
 
 bool
@@ -1730,11 +1806,10 @@ dns_name_downcase(dns_name_t *source, dns_name_t *name, isc_buffer_t *target) {
 		nlen--;
 		if (count < 64) {
 			INSIST(nlen >= count);
-			while (count > 0) {
-				*ndata++ = maptolower[(*sndata++)];
-				nlen--;
-				count--;
-			}
+			fold_copy(ndata, sndata, count);
+			ndata += count;
+			sndata += count;
+			nlen -= count;
 		} else {
 			FATAL_ERROR(__FILE__, __LINE__,
 				    "Unexpected label type %02x", count);
@@ -1805,7 +1880,7 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 {
 	unsigned char *cdata, *ndata;
 	unsigned int cused; /* Bytes of compressed name data used */
-	unsigned int nused, labels, n, nmax;
+	unsigned int nused, labels, nmax;
 	unsigned int current, new_current, biggest_pointer;
 	bool done;
 	fw_state state = fw_start;
@@ -1845,7 +1920,6 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 	/*
 	 * Initialize things to make the compiler happy; they're not required.
 	 */
-	n = 0;
 	new_current = 0;
 
 	/*
@@ -1874,11 +1948,6 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 	current = source->current;
 	biggest_pointer = current;
 
-	/*
-	 * Note:  The following code is not optimized for speed, but
-	 * rather for correctness.  Speed will be addressed in the future.
-	 */
-
 	while (current < source->active && !done) {
 		c = *cdata++;
 		current++;
@@ -1894,10 +1963,24 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 					goto full;
 				nused += c + 1;
 				*ndata++ = c;
-				if (c == 0)
+				if (c == 0) {
 					done = true;
-				n = c;
-				state = fw_ordinary;
+					break;
+				}
+				/*
+				 * Copy the whole label.
+				 */
+				if (c > source->active - current)
+					return (ISC_R_UNEXPECTEDEND);
+				if (downcase)
+					fold_copy(ndata, cdata, c);
+				else
+					memmove(ndata, cdata, c);
+				ndata += c;
+				cdata += c;
+				current += c;
+				if (!seen_pointer)
+					cused += c;
 			} else if (c >= 128 && c < 192) {
 				/*
 				 * 14 bit local compression pointer.
@@ -1918,14 +2001,6 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 			} else
 				return (DNS_R_BADLABELTYPE);
 			break;
-		case fw_ordinary:
-			if (downcase)
-				c = maptolower[c];
-			*ndata++ = c;
-			n--;
-			if (n == 0)
-				state = fw_start;
-			break;
 		case fw_newcurrent:
 			new_current *= 256;
 			new_current += c;
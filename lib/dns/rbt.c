@@ -19,11 +19,13 @@
 
 #include <isc/crc64.h>
 #include <isc/file.h>
+#include <isc/hash.h>
 #include <isc/hex.h>
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/platform.h>
 #include <isc/print.h>
+#include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/socket.h>
 #include <isc/stdio.h>
@@ -64,6 +66,14 @@
 
 #define RBT_HASH_SIZE           64
 
+/*%
+ * Number of buckets of the previous hash table moved to the current
+ * one each time a node is hashed while the table is growing.  The
+ * previous table is always empty long before the current one needs
+ * to grow again.
+ */
+#define RBT_REHASH_BUCKETS      8
+
 #ifdef RBT_MEM_TEST
 #undef RBT_HASH_SIZE
 #define RBT_HASH_SIZE 2 /*%< To give the reallocation code a workout. */
@@ -78,6 +88,14 @@ struct dns_rbt {
 	unsigned int		nodecount;
 	size_t			hashsize;
 	dns_rbtnode_t **	hashtable;
+	/*
+	 * While the hash table grows, nodes in buckets of the previous
+	 * table at or after 'rehashpos' have not been moved yet.
+	 */
+	size_t			oldhashsize;
+	dns_rbtnode_t **	oldhashtable;
+	size_t			rehashpos;
+	uint32_t		hashseed;
 	void *			mmap_location;
 };
 
@@ -108,7 +126,14 @@ struct file_header {
 	uint32_t ptrsize;
 	unsigned int bigendian:1;	/* big or little endian system */
 	unsigned int rdataset_fixed:1;	/* compiled with --enable-rrset-fixed */
+	unsigned int usehash:1;		/* nodes are hashed */
 	unsigned int nodecount;		/* shadow from rbt structure */
+	uint32_t nodesize;		/* sizeof(dns_rbtnode_t) */
+	uint32_t hashseed;		/* shadow from rbt structure */
+	uint64_t base;			/* address the image was written for */
+	uint64_t hashtable;		/* offset of the hash table */
+	uint64_t hashsize;		/* number of hash buckets */
+	uint64_t size;			/* length of the image */
 	uint64_t crc;
 	char version2[32];  		/* repeated; must match version1 */
 };
@@ -118,13 +143,16 @@ struct file_header {
  *
  * step one: write out a zeroed header of 1024 bytes
  * step two: walk the tree in a depth-first, left-right-down order, writing
- * out the nodes, reserving space as we go, correcting addresses to point
- * at the proper offset in the file, and setting a flag for each pointer to
- * indicate that it is a reference to a location in the file, rather than in
- * memory.
+ * out the nodes, reserving space as we go, and storing every pointer as
+ * the address it will have when the file is mapped at the image's base
+ * address.  The hash chains and upper node pointers are stored the same
+ * way, followed by the hash table itself.
  * step three: write out the header, adding the information that will be
  * needed to re-create the tree object itself.
  *
+ * An image mapped at its base address can then be used as it is, with
+ * no pass over the nodes; one mapped elsewhere is relocated.
+ *
  * The RBTDB object will do this three times, once for each of the three
  * RBT objects it contains.
  *
@@ -132,69 +160,45 @@ struct file_header {
  * and fseeked, not to a pipe or stream
  */
 
+/*
+ * State kept while an RBT is written out.
+ */
+typedef struct serialize {
+	FILE *			file;
+	uintptr_t		base;
+	dns_rbtdatawriter_t	datawriter;
+	void *			writer_arg;
+	uint64_t		crc;
+#ifdef DNS_RBT_USEHASH
+	size_t			hashsize;
+	uint64_t *		buckets;	/* offsets of the chain heads */
+#endif
+} serialize_t;
+
+/*
+ * The address that file offset 'off' has in an image mapped at its base.
+ */
+#define IMAGE_ADDR(s, off) \
+	((off) == 0 ? NULL : (void *)((s)->base + (uintptr_t)(off)))
+
 static isc_result_t
 dns_rbt_zero_header(FILE *file);
 
 static isc_result_t
-write_header(FILE *file, dns_rbt_t *rbt, uint64_t first_node_offset,
-	     uint64_t crc);
+write_header(FILE *file, dns_rbt_t *rbt, serialize_t *s,
+	     uint64_t first_node_offset, uint64_t hashtable, uint64_t size);
 
 static bool
 match_header_version(file_header_t *header);
 
 static isc_result_t
-serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
-	       uintptr_t right, uintptr_t down, uintptr_t parent,
-	       uintptr_t data, uint64_t *crc);
+serialize_node(serialize_t *s, dns_rbtnode_t *node, off_t location,
+	       uintptr_t left, uintptr_t right, uintptr_t down,
+	       uintptr_t parent, uintptr_t upper, uintptr_t data);
 
 static isc_result_t
-serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
-		dns_rbtdatawriter_t datawriter, void *writer_arg,
-		uintptr_t *where, uint64_t *crc);
-/*
- * The following functions allow you to get the actual address of a pointer
- * without having to use an if statement to check to see if that address is
- * relative or not
- */
-static inline dns_rbtnode_t *
-getparent(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->parent);
-	adjusted_address += node->parent_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getleft(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->left);
-	adjusted_address += node->left_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getright(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->right);
-	adjusted_address += node->right_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getdown(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->down);
-	adjusted_address += node->down_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getdata(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->data);
-	adjusted_address += node->data_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
+serialize_nodes(serialize_t *s, dns_rbtnode_t *node, uintptr_t parent,
+		uintptr_t upper, uintptr_t *where);
 
 /*%
  * Elements of the rbtnode structure.
@@ -354,27 +358,6 @@ get_upper_node(dns_rbtnode_t *node) {
 	return (UPPERNODE(node));
 }
 
-static void
-fixup_uppernodes_helper(dns_rbtnode_t *node, dns_rbtnode_t *uppernode) {
-	if (node == NULL)
-		return;
-
-	UPPERNODE(node) = uppernode;
-
-	fixup_uppernodes_helper(LEFT(node), uppernode);
-	fixup_uppernodes_helper(RIGHT(node), uppernode);
-	fixup_uppernodes_helper(DOWN(node), node);
-}
-
-/*
- * This function is used to fixup uppernode members of all dns_rbtnodes
- * after deserialization.
- */
-static void
-fixup_uppernodes(dns_rbt_t *rbt) {
-	fixup_uppernodes_helper(rbt->root, NULL);
-}
-
 #else
 
 /* The passed node must not be NULL. */
@@ -425,6 +408,11 @@ static isc_result_t
 create_node(isc_mem_t *mctx, dns_name_t *name, dns_rbtnode_t **nodep);
 
 #ifdef DNS_RBT_USEHASH
+static inline unsigned int
+name_hash(dns_rbt_t *rbt, dns_name_t *name);
+static inline dns_rbtnode_t *
+hash_find(dns_rbt_t *rbt, unsigned int hash, dns_rbtnode_t *up_current,
+	  dns_name_t *hash_name);
 static inline void
 hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name);
 static inline void
@@ -450,15 +438,17 @@ static void
 deletefromlevel(dns_rbtnode_t *item, dns_rbtnode_t **rootp);
 
 static isc_result_t
-treefix(dns_rbt_t *rbt, void *base, size_t size,
-	dns_rbtnode_t *n, dns_name_t *name,
-	dns_rbtdatafixer_t datafixer, void *fixer_arg,
+treefix(dns_rbt_t *rbt, void *base, size_t filesize, uintptr_t filebase,
+	dns_rbtnode_t *n, dns_rbtdatafixer_t datafixer, void *fixer_arg,
 	uint64_t *crc);
 
 static void
 deletetreeflat(dns_rbt_t *rbt, unsigned int quantum, bool unhash,
 	       dns_rbtnode_t **nodep);
 
+static void
+deletetreeinplace(dns_rbt_t *rbt, dns_rbtnode_t **nodep);
+
 static void
 printnodename(dns_rbtnode_t *node, bool quoted, FILE *f);
 
@@ -501,18 +491,17 @@ init_file_version(void) {
 
 /*
  * Write out the real header, including NodeDump version information
- * and the offset of the first node.
+ * and the offset of the first node, at the current position.
  *
  * Any information stored in the rbt object itself should be stored
  * here.
  */
 static isc_result_t
-write_header(FILE *file, dns_rbt_t *rbt, uint64_t first_node_offset,
-	     uint64_t crc)
+write_header(FILE *file, dns_rbt_t *rbt, serialize_t *s,
+	     uint64_t first_node_offset, uint64_t hashtable, uint64_t size)
 {
 	file_header_t header;
 	isc_result_t result;
-	off_t location;
 
 	RUNTIME_CHECK(isc_once_do(&once, init_file_version) == ISC_R_SUCCESS);
 
@@ -530,18 +519,24 @@ write_header(FILE *file, dns_rbt_t *rbt, uint64_t first_node_offset,
 #endif
 
 	header.nodecount = rbt->nodecount;
+	header.nodesize = (uint32_t) sizeof(dns_rbtnode_t);
+	header.base = (uint64_t) s->base;
+	header.size = size;
 
-	header.crc = crc;
+#ifdef DNS_RBT_USEHASH
+	header.usehash = 1;
+	header.hashseed = rbt->hashseed;
+	header.hashtable = hashtable;
+	header.hashsize = (uint64_t) s->hashsize;
+#else
+	UNUSED(hashtable);
+#endif
+
+	header.crc = s->crc;
 
-	CHECK(isc_stdio_tell(file, &location));
-	location = dns_rbt_serialize_align(location);
-	CHECK(isc_stdio_seek(file, location, SEEK_SET));
 	CHECK(isc_stdio_write(&header, 1, sizeof(file_header_t), file, NULL));
 	CHECK(fflush(file));
 
-	/* Ensure we are always at the end of the file. */
-	CHECK(isc_stdio_seek(file, 0, SEEK_END));
-
  cleanup:
 	return (result);
 }
@@ -562,66 +557,58 @@ match_header_version(file_header_t *header) {
 }
 
 static isc_result_t
-serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
-	       uintptr_t right, uintptr_t down, uintptr_t parent,
-	       uintptr_t data, uint64_t *crc)
+serialize_node(serialize_t *s, dns_rbtnode_t *node, off_t location,
+	       uintptr_t left, uintptr_t right, uintptr_t down,
+	       uintptr_t parent, uintptr_t upper, uintptr_t data)
 {
 	dns_rbtnode_t temp_node;
-	off_t file_position;
 	unsigned char *node_data;
 	size_t datasize;
 	isc_result_t result;
+#ifdef DNS_RBT_USEHASH
+	size_t bucket;
+#endif
 #ifdef DEBUG
 	dns_name_t nodename;
 #endif
 
 	INSIST(node != NULL);
 
-	CHECK(isc_stdio_tell(file, &file_position));
-	file_position = dns_rbt_serialize_align(file_position);
-	CHECK(isc_stdio_seek(file, file_position, SEEK_SET));
+	CHECK(isc_stdio_seek(s->file, location, SEEK_SET));
 
+	/*
+	 * Store the node as it will be when the image is mapped at its
+	 * base address, without the state it has while it is in use.
+	 */
 	temp_node = *node;
-	temp_node.down_is_relative = 0;
-	temp_node.left_is_relative = 0;
-	temp_node.right_is_relative = 0;
-	temp_node.parent_is_relative = 0;
-	temp_node.data_is_relative = 0;
 	temp_node.is_mmapped = 1;
+	temp_node.parent = IMAGE_ADDR(s, parent);
+	temp_node.left = IMAGE_ADDR(s, left);
+	temp_node.right = IMAGE_ADDR(s, right);
+	temp_node.down = IMAGE_ADDR(s, down);
+	temp_node.data = IMAGE_ADDR(s, data);
+	ISC_LINK_INIT(&temp_node, deadlink);
+	temp_node.dirty = 0;
+	dns_rbtnode_refinit(&temp_node, 0);
 
+#ifdef DNS_RBT_USEHASH
 	/*
-	 * If the next node is not NULL, calculate the next node's location
-	 * in the file.  Note that this will have to change when the data
-	 * structure changes, and it also assumes that we always write the
-	 * nodes out in list order (which we currently do.)
-	*/
-	if (temp_node.parent != NULL) {
-		temp_node.parent = (dns_rbtnode_t *)(parent);
-		temp_node.parent_is_relative = 1;
-	}
-	if (temp_node.left != NULL) {
-		temp_node.left = (dns_rbtnode_t *)(left);
-		temp_node.left_is_relative = 1;
-	}
-	if (temp_node.right != NULL) {
-		temp_node.right = (dns_rbtnode_t *)(right);
-		temp_node.right_is_relative = 1;
-	}
-	if (temp_node.down != NULL) {
-		temp_node.down = (dns_rbtnode_t *)(down);
-		temp_node.down_is_relative = 1;
-	}
-	if (temp_node.data != NULL) {
-		temp_node.data = (dns_rbtnode_t *)(data);
-		temp_node.data_is_relative = 1;
-	}
+	 * Chain the node into the image's hash table.
+	 */
+	temp_node.uppernode = IMAGE_ADDR(s, upper);
+	bucket = HASHVAL(node) % s->hashsize;
+	temp_node.hashnext = IMAGE_ADDR(s, s->buckets[bucket]);
+	s->buckets[bucket] = (uint64_t) location;
+#else
+	UNUSED(upper);
+#endif
 
 	node_data = (unsigned char *) node + sizeof(dns_rbtnode_t);
 	datasize = NODE_SIZE(node) - sizeof(dns_rbtnode_t);
 
 	CHECK(isc_stdio_write(&temp_node, 1, sizeof(dns_rbtnode_t),
-			      file, NULL));
-	CHECK(isc_stdio_write(node_data, 1, datasize, file, NULL));
+			      s->file, NULL));
+	CHECK(isc_stdio_write(node_data, 1, datasize, s->file, NULL));
 
 #ifdef DEBUG
 	dns_name_init(&nodename, NULL);
@@ -634,18 +621,17 @@ serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
 	hexdump("node data", node_data, datasize);
 #endif
 
-	isc_crc64_update(crc, (const uint8_t *) &temp_node,
+	isc_crc64_update(&s->crc, (const uint8_t *) &temp_node,
 			 sizeof(dns_rbtnode_t));
-	isc_crc64_update(crc, (const uint8_t *) node_data, datasize);
+	isc_crc64_update(&s->crc, (const uint8_t *) node_data, datasize);
 
  cleanup:
 	return (result);
 }
 
 static isc_result_t
-serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
-		dns_rbtdatawriter_t datawriter, void *writer_arg,
-		uintptr_t *where, uint64_t *crc)
+serialize_nodes(serialize_t *s, dns_rbtnode_t *node, uintptr_t parent,
+		uintptr_t upper, uintptr_t *where)
 {
 	uintptr_t left = 0, right = 0, down = 0, data = 0;
 	off_t location = 0, offset_adjust;
@@ -658,12 +644,12 @@ serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
 	}
 
 	/* Reserve space for current node. */
-	CHECK(isc_stdio_tell(file, &location));
+	CHECK(isc_stdio_tell(s->file, &location));
 	location = dns_rbt_serialize_align(location);
-	CHECK(isc_stdio_seek(file, location, SEEK_SET));
+	CHECK(isc_stdio_seek(s->file, location, SEEK_SET));
 
 	offset_adjust = dns_rbt_serialize_align(location + NODE_SIZE(node));
-	CHECK(isc_stdio_seek(file, offset_adjust, SEEK_SET));
+	CHECK(isc_stdio_seek(s->file, offset_adjust, SEEK_SET));
 
 	/*
 	 * Serialize the rest of the tree.
@@ -671,32 +657,35 @@ serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
 	 * WARNING: A change in the order (from left, right, down)
 	 * will break the way the crc hash is computed.
 	 */
-	CHECK(serialize_nodes(file, getleft(node, NULL), location,
-			      datawriter, writer_arg, &left, crc));
-	CHECK(serialize_nodes(file, getright(node, NULL), location,
-			      datawriter, writer_arg, &right, crc));
-	CHECK(serialize_nodes(file, getdown(node, NULL), location,
-			      datawriter, writer_arg, &down, crc));
+	CHECK(serialize_nodes(s, LEFT(node), location, upper, &left));
+	CHECK(serialize_nodes(s, RIGHT(node), location, upper, &right));
+	CHECK(serialize_nodes(s, DOWN(node), location, location, &down));
 
-	if (node->data != NULL) {
-		off_t ret;
+	if (DATA(node) != NULL) {
+		off_t ret, end;
 
-		CHECK(isc_stdio_tell(file, &ret));
+		CHECK(isc_stdio_tell(s->file, &ret));
 		ret = dns_rbt_serialize_align(ret);
-		CHECK(isc_stdio_seek(file, ret, SEEK_SET));
-		data = ret;
+		CHECK(isc_stdio_seek(s->file, ret, SEEK_SET));
 
-		datawriter(file, node->data, writer_arg, crc);
-	}
+		CHECK(s->datawriter(s->file, DATA(node), s->writer_arg,
+				    s->base + (uintptr_t) location, &s->crc));
 
-	/* Seek back to reserved space. */
-	CHECK(isc_stdio_seek(file, location, SEEK_SET));
+		/*
+		 * Data that the writer left out, such as rdatasets that
+		 * are not in the version being written, is not pointed to.
+		 */
+		CHECK(isc_stdio_tell(s->file, &end));
+		if (end != ret)
+			data = ret;
+	}
 
 	/* Serialize the current node. */
-	CHECK(serialize_node(file, node, left, right, down, parent, data, crc));
+	CHECK(serialize_node(s, node, location, left, right, down, parent,
+			     upper, data));
 
 	/* Ensure we are always at the end of the file. */
-	CHECK(isc_stdio_seek(file, 0, SEEK_END));
+	CHECK(isc_stdio_seek(s->file, 0, SEEK_END));
 
 	if (where != NULL)
 		*where = (uintptr_t) location;
@@ -705,6 +694,37 @@ serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
 	return (result);
 }
 
+#ifdef DNS_RBT_USEHASH
+/*
+ * Write out the hash table, as the addresses of the first node of
+ * each chain.
+ */
+static isc_result_t
+write_hashtable(serialize_t *s, off_t *locationp) {
+	isc_result_t result;
+	off_t location;
+	size_t i;
+
+	CHECK(isc_stdio_tell(s->file, &location));
+	location = dns_rbt_serialize_align(location);
+	CHECK(isc_stdio_seek(s->file, location, SEEK_SET));
+
+	for (i = 0; i < s->hashsize; i++)
+		if (s->buckets[i] != 0)
+			s->buckets[i] += s->base;
+
+	isc_crc64_update(&s->crc, (const uint8_t *) s->buckets,
+			 s->hashsize * sizeof(s->buckets[0]));
+	CHECK(isc_stdio_write(s->buckets, sizeof(s->buckets[0]), s->hashsize,
+			      s->file, NULL));
+
+	*locationp = location;
+
+ cleanup:
+	return (result);
+}
+#endif /* DNS_RBT_USEHASH */
+
 off_t
 dns_rbt_serialize_align(off_t target) {
 	off_t offset = target % 8;
@@ -718,17 +738,35 @@ dns_rbt_serialize_align(off_t target) {
 isc_result_t
 dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 		       dns_rbtdatawriter_t datawriter,
-		       void *writer_arg, off_t *offset)
+		       void *writer_arg, uintptr_t base, off_t *offset)
 {
 	isc_result_t result;
 	off_t header_position, node_position, end_position;
-	uint64_t crc;
+	off_t hashtable = 0;
+	uintptr_t root = 0;
+	serialize_t s;
 
 	REQUIRE(file != NULL);
+	REQUIRE(VALID_RBT(rbt));
 
-	CHECK(isc_file_isplainfilefd(fileno(file)));
+	result = isc_file_isplainfilefd(fileno(file));
+	if (result != ISC_R_SUCCESS)
+		return (result);
 
-	isc_crc64_init(&crc);
+	s.file = file;
+	s.base = base;
+	s.datawriter = datawriter;
+	s.writer_arg = writer_arg;
+	isc_crc64_init(&s.crc);
+
+#ifdef DNS_RBT_USEHASH
+	s.hashsize = rbt->hashsize;
+	s.buckets = isc_mem_get(rbt->mctx,
+				s.hashsize * sizeof(s.buckets[0]));
+	if (s.buckets == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(s.buckets, 0, s.hashsize * sizeof(s.buckets[0]));
+#endif
 
 	CHECK(isc_stdio_tell(file, &header_position));
 
@@ -737,30 +775,39 @@ dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 
 	/* Serialize nodes */
 	CHECK(isc_stdio_tell(file, &node_position));
-	CHECK(serialize_nodes(file, rbt->root, 0, datawriter,
-			      writer_arg, NULL, &crc));
+	CHECK(serialize_nodes(&s, rbt->root, 0, 0, &root));
 
 	CHECK(isc_stdio_tell(file, &end_position));
 	if (node_position == end_position) {
 		CHECK(isc_stdio_seek(file, header_position, SEEK_SET));
 		*offset = 0;
-		return (ISC_R_SUCCESS);
+		goto cleanup;
 	}
 
-	isc_crc64_final(&crc);
+#ifdef DNS_RBT_USEHASH
+	CHECK(write_hashtable(&s, &hashtable));
+	CHECK(isc_stdio_tell(file, &end_position));
+#endif
+
+	isc_crc64_final(&s.crc);
 #ifdef DEBUG
-	hexdump("serializing CRC", (unsigned char *)&crc, sizeof(crc));
+	hexdump("serializing CRC", (unsigned char *)&s.crc, sizeof(s.crc));
 #endif
 
 	/* Serialize header */
+	header_position = dns_rbt_serialize_align(header_position);
 	CHECK(isc_stdio_seek(file, header_position, SEEK_SET));
-	CHECK(write_header(file, rbt, HEADER_LENGTH, crc));
+	CHECK(write_header(file, rbt, &s, root - header_position, hashtable,
+			   end_position - header_position));
 
 	/* Ensure we are always at the end of the file. */
 	CHECK(isc_stdio_seek(file, 0, SEEK_END));
-	*offset = dns_rbt_serialize_align(header_position);
+	*offset = header_position;
 
  cleanup:
+#ifdef DNS_RBT_USEHASH
+	isc_mem_put(rbt->mctx, s.buckets, s.hashsize * sizeof(s.buckets[0]));
+#endif
 	return (result);
 }
 
@@ -771,92 +818,78 @@ dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 	} \
 } while(0);
 
+/*
+ * Check that the pointer 'field' of a node in an image written for
+ * address 'filebase' points into the image, and relocate it to the
+ * image's actual address 'base' if that is different.
+ */
+#define FIXPTR(field, type) do { \
+	if ((field) != NULL) { \
+		uintptr_t off_ = (uintptr_t)(field) - filebase; \
+		CONFIRM(off_ <= nodemax); \
+		if (delta != 0) \
+			(field) = (type *)((char *)base + off_); \
+	} \
+} while (0)
+
 static isc_result_t
-treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
-	dns_name_t *name, dns_rbtdatafixer_t datafixer,
-	void *fixer_arg, uint64_t *crc)
+treefix(dns_rbt_t *rbt, void *base, size_t filesize, uintptr_t filebase,
+	dns_rbtnode_t *n, dns_rbtdatafixer_t datafixer, void *fixer_arg,
+	uint64_t *crc)
 {
 	isc_result_t result = ISC_R_SUCCESS;
-	dns_fixedname_t fixed;
-	dns_name_t nodename, *fullname;
+	dns_name_t nodename;
 	unsigned char *node_data;
 	dns_rbtnode_t header;
 	size_t datasize, nodemax = filesize - sizeof(dns_rbtnode_t);
+	uintptr_t delta = (uintptr_t)base - filebase;
 
 	if (n == NULL)
 		return (ISC_R_SUCCESS);
 
 	CONFIRM((void *) n >= base);
-	CONFIRM((char *) n - (char *) base <= (int) nodemax);
+	CONFIRM((size_t)((char *) n - (char *) base) <= nodemax);
 	CONFIRM(DNS_RBTNODE_VALID(n));
+	CONFIRM(n->is_mmapped == 1);
 
 	dns_name_init(&nodename, NULL);
 	NODENAME(n, &nodename);
-
-	fullname = &nodename;
-	CONFIRM(dns_name_isvalid(fullname));
-
-	if (!dns_name_isabsolute(&nodename)) {
-		fullname = dns_fixedname_initname(&fixed);
-		CHECK(dns_name_concatenate(&nodename, name, fullname, NULL));
-	}
+	CONFIRM(dns_name_isvalid(&nodename));
 
 	/* memorize header contents prior to fixup */
 	memmove(&header, n, sizeof(header));
 
-	if (n->left_is_relative) {
-		CONFIRM(n->left <= (dns_rbtnode_t *) nodemax);
-		n->left = getleft(n, rbt->mmap_location);
-		n->left_is_relative = 0;
-		CONFIRM(DNS_RBTNODE_VALID(n->left));
-	} else
-		CONFIRM(n->left == NULL);
+	FIXPTR(n->left, dns_rbtnode_t);
+	CONFIRM(n->left == NULL || DNS_RBTNODE_VALID(n->left));
 
-	if (n->right_is_relative) {
-		CONFIRM(n->right <= (dns_rbtnode_t *) nodemax);
-		n->right = getright(n, rbt->mmap_location);
-		n->right_is_relative = 0;
-		CONFIRM(DNS_RBTNODE_VALID(n->right));
-	} else
-		CONFIRM(n->right == NULL);
-
-	if (n->down_is_relative) {
-		CONFIRM(n->down <= (dns_rbtnode_t *) nodemax);
-		n->down = getdown(n, rbt->mmap_location);
-		n->down_is_relative = 0;
-		CONFIRM(n->down > (dns_rbtnode_t *) n);
-		CONFIRM(DNS_RBTNODE_VALID(n->down));
-	} else
-		CONFIRM(n->down == NULL);
-
-	if (n->parent_is_relative) {
-		CONFIRM(n->parent <= (dns_rbtnode_t *) nodemax);
-		n->parent = getparent(n, rbt->mmap_location);
-		n->parent_is_relative = 0;
-		CONFIRM(n->parent < (dns_rbtnode_t *) n);
-		CONFIRM(DNS_RBTNODE_VALID(n->parent));
-	} else
-		CONFIRM(n->parent == NULL);
+	FIXPTR(n->right, dns_rbtnode_t);
+	CONFIRM(n->right == NULL || DNS_RBTNODE_VALID(n->right));
 
-	if (n->data_is_relative) {
-		CONFIRM(n->data <= (void *) filesize);
-		n->data = getdata(n, rbt->mmap_location);
-		n->data_is_relative = 0;
-		CONFIRM(n->data > (void *) n);
-	} else
-		CONFIRM(n->data == NULL);
+	FIXPTR(n->down, dns_rbtnode_t);
+	CONFIRM(n->down == NULL || n->down > n);
+	CONFIRM(n->down == NULL || DNS_RBTNODE_VALID(n->down));
+
+	FIXPTR(n->parent, dns_rbtnode_t);
+	CONFIRM(n->parent == NULL || n->parent < n);
+	CONFIRM(n->parent == NULL || DNS_RBTNODE_VALID(n->parent));
 
-	hash_node(rbt, n, fullname);
+	FIXPTR(n->data, void);
+	CONFIRM(n->data == NULL || n->data > (void *) n);
 
-	/* a change in the order (from left, right, down) will break hashing*/
+#ifdef DNS_RBT_USEHASH
+	FIXPTR(n->uppernode, dns_rbtnode_t);
+	FIXPTR(n->hashnext, dns_rbtnode_t);
+#endif
+
+	/* a change in the order (from left, right, down) will break the CRC */
 	if (n->left != NULL)
-		CHECK(treefix(rbt, base, filesize, n->left, name,
+		CHECK(treefix(rbt, base, filesize, filebase, n->left,
 			      datafixer, fixer_arg, crc));
 	if (n->right != NULL)
-		CHECK(treefix(rbt, base, filesize, n->right, name,
+		CHECK(treefix(rbt, base, filesize, filebase, n->right,
 			      datafixer, fixer_arg, crc));
 	if (n->down != NULL)
-		CHECK(treefix(rbt, base, filesize, n->down, fullname,
+		CHECK(treefix(rbt, base, filesize, filebase, n->down,
 			      datafixer, fixer_arg, crc));
 
 	if (datafixer != NULL && n->data != NULL)
@@ -883,28 +916,86 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 	return (result);
 }
 
+#ifdef DNS_RBT_USEHASH
+/*
+ * Replace the hash table of 'rbt' with a copy of the one in the image,
+ * relocated to the image's actual address.
+ */
+static isc_result_t
+loadhash(dns_rbt_t *rbt, void *base, size_t filesize, file_header_t *header) {
+	uintptr_t filebase = (uintptr_t) header->base;
+	size_t nodemax = filesize - sizeof(dns_rbtnode_t);
+	size_t i, size;
+	uint64_t *buckets;
+	uint64_t off;
+	dns_rbtnode_t **table;
+
+	if (header->hashsize == 0 || header->hashtable > filesize ||
+	    header->hashtable % sizeof(*buckets) != 0 ||
+	    header->hashsize > (filesize - header->hashtable) /
+			       sizeof(*buckets))
+	{
+		return (ISC_R_INVALIDFILE);
+	}
+	size = (size_t) header->hashsize;
+
+	table = isc_mem_get(rbt->mctx, size * sizeof(*table));
+	if (table == NULL)
+		return (ISC_R_NOMEMORY);
+
+	buckets = (uint64_t *)((char *) base + header->hashtable);
+	for (i = 0; i < size; i++) {
+		if (buckets[i] == 0) {
+			table[i] = NULL;
+			continue;
+		}
+		off = buckets[i] - filebase;
+		if (off > nodemax) {
+			isc_mem_put(rbt->mctx, table, size * sizeof(*table));
+			return (ISC_R_INVALIDFILE);
+		}
+		table[i] = (dns_rbtnode_t *)((char *) base + off);
+	}
+
+	isc_mem_put(rbt->mctx, rbt->hashtable,
+		    rbt->hashsize * sizeof(dns_rbtnode_t *));
+	rbt->hashtable = table;
+	rbt->hashsize = size;
+	rbt->hashseed = header->hashseed;
+
+	return (ISC_R_SUCCESS);
+}
+#endif /* DNS_RBT_USEHASH */
+
 isc_result_t
 dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 			 off_t header_offset, isc_mem_t *mctx,
 			 dns_rbtdeleter_t deleter, void *deleter_arg,
 			 dns_rbtdatafixer_t datafixer, void *fixer_arg,
-			 dns_rbtnode_t **originp, dns_rbt_t **rbtp)
+			 bool trusted, dns_rbtnode_t **originp,
+			 dns_rbt_t **rbtp)
 {
 	isc_result_t result = ISC_R_SUCCESS;
 	file_header_t *header;
 	dns_rbt_t *rbt = NULL;
 	uint64_t crc;
 	unsigned int host_big_endian;
+	uintptr_t filebase;
 
 	REQUIRE(originp == NULL || *originp == NULL);
 	REQUIRE(rbtp != NULL && *rbtp == NULL);
 
-	isc_crc64_init(&crc);
-
 	CHECK(dns_rbt_create(mctx, deleter, deleter_arg, &rbt));
 
 	rbt->mmap_location = base_address;
 
+	if (header_offset < 0 || filesize < sizeof(dns_rbtnode_t) ||
+	    (size_t) header_offset > filesize - sizeof(file_header_t))
+	{
+		result = ISC_R_INVALIDFILE;
+		goto cleanup;
+	}
+
 	header = (file_header_t *)((char *)base_address + header_offset);
 	if (!match_header_version(header)) {
 		result = ISC_R_INVALIDFILE;
@@ -924,7 +1015,21 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 	}
 #endif
 
-	if (header->ptrsize != (uint32_t) sizeof(void *)) {
+#ifdef DNS_RBT_USEHASH
+	if (header->usehash != 1) {
+		result = ISC_R_INVALIDFILE;
+		goto cleanup;
+	}
+#else
+	if (header->usehash != 0) {
+		result = ISC_R_INVALIDFILE;
+		goto cleanup;
+	}
+#endif
+
+	if (header->ptrsize != (uint32_t) sizeof(void *) ||
+	    header->nodesize != (uint32_t) sizeof(dns_rbtnode_t))
+	{
 		result = ISC_R_INVALIDFILE;
 		goto cleanup;
 	}
@@ -935,19 +1040,44 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 		goto cleanup;
 	}
 
+	/*
+	 * Everything the header refers to must be inside the image, and
+	 * the image inside the file.
+	 */
+	if (header->size > filesize - (size_t) header_offset ||
+	    header->size < sizeof(file_header_t) + sizeof(dns_rbtnode_t) ||
+	    header->first_node_offset > header->size - sizeof(dns_rbtnode_t) ||
+	    header->nodecount > header->size / sizeof(dns_rbtnode_t))
+	{
+		result = ISC_R_INVALIDFILE;
+		goto cleanup;
+	}
+
 	/* Copy other data items from the header into our rbt. */
 	rbt->root = (dns_rbtnode_t *)((char *)base_address +
 				header_offset + header->first_node_offset);
 
-	if ((header->nodecount * sizeof(dns_rbtnode_t)) > filesize) {
-		result = ISC_R_INVALIDFILE;
-		goto cleanup;
-	}
-	rehash(rbt, header->nodecount);
+#ifdef DNS_RBT_USEHASH
+	CHECK(loadhash(rbt, base_address, filesize, header));
+#endif
 
-	CHECK(treefix(rbt, base_address, filesize, rbt->root,
-		      dns_rootname, datafixer, fixer_arg, &crc));
+	filebase = (uintptr_t) header->base;
+	if (trusted && (uintptr_t) base_address == filebase) {
+		/*
+		 * The caller vouches for the image, and it is where it
+		 * was written for, so it is used without being read.
+		 */
+		rbt->nodecount = header->nodecount;
+		goto done;
+	}
 
+	isc_crc64_init(&crc);
+	CHECK(treefix(rbt, base_address, filesize, filebase, rbt->root,
+		      datafixer, fixer_arg, &crc));
+#ifdef DNS_RBT_USEHASH
+	isc_crc64_update(&crc, (uint8_t *)base_address + header->hashtable,
+			 header->hashsize * sizeof(uint64_t));
+#endif
 	isc_crc64_final(&crc);
 #ifdef DEBUG
 	hexdump("deserializing CRC", (unsigned char *)&crc, sizeof(crc));
@@ -964,10 +1094,7 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 		goto cleanup;
 	}
 
-#ifdef DNS_RBT_USEHASH
-	fixup_uppernodes(rbt);
-#endif /* DNS_RBT_USEHASH */
-
+ done:
 	*rbtp = rbt;
 	if (originp != NULL)
 		*originp = rbt->root;
@@ -1010,9 +1137,13 @@ dns_rbt_create(isc_mem_t *mctx, dns_rbtdeleter_t deleter,
 	rbt->nodecount = 0;
 	rbt->hashtable = NULL;
 	rbt->hashsize = 0;
+	rbt->oldhashtable = NULL;
+	rbt->oldhashsize = 0;
+	rbt->rehashpos = 0;
 	rbt->mmap_location = NULL;
 
 #ifdef DNS_RBT_USEHASH
+	isc_random_get(&rbt->hashseed);
 	result = inithash(rbt);
 	if (result != ISC_R_SUCCESS) {
 		isc_mem_putanddetach(&rbt->mctx, rbt, sizeof(*rbt));
@@ -1043,7 +1174,15 @@ dns_rbt_destroy2(dns_rbt_t **rbtp, unsigned int quantum) {
 
 	rbt = *rbtp;
 
-	deletetreeflat(rbt, quantum, false, &rbt->root);
+	/*
+	 * A tree loaded from a map file is taken apart without writing
+	 * to it, so that pages which were never changed are not copied
+	 * just to be thrown away.
+	 */
+	if (rbt->mmap_location != NULL)
+		deletetreeinplace(rbt, &rbt->root);
+	else
+		deletetreeflat(rbt, quantum, false, &rbt->root);
 	if (rbt->root != NULL)
 		return (ISC_R_QUOTA);
 
@@ -1054,6 +1193,9 @@ dns_rbt_destroy2(dns_rbt_t **rbtp, unsigned int quantum) {
 	if (rbt->hashtable != NULL)
 		isc_mem_put(rbt->mctx, rbt->hashtable,
 			    rbt->hashsize * sizeof(dns_rbtnode_t *));
+	if (rbt->oldhashtable != NULL)
+		isc_mem_put(rbt->mctx, rbt->oldhashtable,
+			    rbt->oldhashsize * sizeof(dns_rbtnode_t *));
 
 	rbt->magic = 0;
 
@@ -1078,6 +1220,19 @@ dns_rbt_hashsize(dns_rbt_t *rbt) {
 	return (rbt->hashsize);
 }
 
+void
+dns_rbt_adjusthashsize(dns_rbt_t *rbt, unsigned int nodecount) {
+
+	REQUIRE(VALID_RBT(rbt));
+
+#ifdef DNS_RBT_USEHASH
+	if (nodecount >= rbt->hashsize * 3)
+		rehash(rbt, nodecount);
+#else
+	UNUSED(nodecount);
+#endif
+}
+
 static inline isc_result_t
 chain_name(dns_rbtnodechain_t *chain, dns_name_t *name,
 	   bool include_chain_end)
@@ -1605,38 +1760,12 @@ dns_rbt_findnode(dns_rbt_t *rbt, const dns_name_t *name, dns_name_t *foundname,
 						  nlabels - tlabels,
 						  hlabels + tlabels,
 						  &hash_name);
-			hash = dns_name_fullhash(&hash_name, false);
+			hash = name_hash(rbt, &hash_name);
 			dns_name_getlabelsequence(search_name,
 						  nlabels - tlabels,
 						  tlabels, &hash_name);
 
-			/*
-			 * Walk all the nodes in the hash bucket pointed
-			 * by the computed hash value.
-			 */
-			for (hnode = rbt->hashtable[hash % rbt->hashsize];
-			     hnode != NULL;
-			     hnode = hnode->hashnext)
-			{
-				dns_name_t hnode_name;
-
-				if (ISC_LIKELY(hash != HASHVAL(hnode)))
-					continue;
-				/*
-				 * This checks that the hashed label
-				 * sequence being looked up is at the
-				 * same tree level, so that we don't
-				 * match a labelsequence from some other
-				 * subdomain.
-				 */
-				if (ISC_LIKELY(get_upper_node(hnode) != up_current))
-					continue;
-
-				dns_name_init(&hnode_name, NULL);
-				NODENAME(hnode, &hnode_name);
-				if (ISC_LIKELY(dns_name_equal(&hnode_name, &hash_name)))
-					break;
-			}
+			hnode = hash_find(rbt, hash, up_current, &hash_name);
 
 			if (hnode != NULL) {
 				current = hnode;
@@ -2249,11 +2378,6 @@ create_node(isc_mem_t *mctx, dns_name_t *name, dns_rbtnode_t **nodep) {
 	DOWN(node) = NULL;
 	DATA(node) = NULL;
 	node->is_mmapped = 0;
-	node->down_is_relative = 0;
-	node->left_is_relative = 0;
-	node->right_is_relative = 0;
-	node->parent_is_relative = 0;
-	node->data_is_relative = 0;
 	node->rpz = 0;
 
 #ifdef DNS_RBT_USEHASH
@@ -2302,13 +2426,80 @@ create_node(isc_mem_t *mctx, dns_name_t *name, dns_rbtnode_t **nodep) {
 }
 
 #ifdef DNS_RBT_USEHASH
+/*
+ * Hash 'name' for the tree's hash table.  Each tree has its own seed,
+ * which is kept in map files, so that a tree loaded from a file can
+ * use the hash table stored with it.
+ */
+static inline unsigned int
+name_hash(dns_rbt_t *rbt, dns_name_t *name) {
+	if (name->labels == 0)
+		return (0);
+
+	return (isc_hash_function_reverse(name->ndata, name->length, false,
+					  &rbt->hashseed));
+}
+
+/*
+ * Walk all the nodes in a hash bucket looking for the node named
+ * 'hash_name' whose upper node is 'up_current'.
+ */
+static inline dns_rbtnode_t *
+hash_find_bucket(dns_rbtnode_t *hnode, unsigned int hash,
+		 dns_rbtnode_t *up_current, dns_name_t *hash_name)
+{
+	for (; hnode != NULL; hnode = HASHNEXT(hnode)) {
+		dns_name_t hnode_name;
+
+		if (ISC_LIKELY(hash != HASHVAL(hnode)))
+			continue;
+		/*
+		 * This checks that the hashed label sequence being
+		 * looked up is at the same tree level, so that we
+		 * don't match a labelsequence from some other
+		 * subdomain.
+		 */
+		if (ISC_LIKELY(get_upper_node(hnode) != up_current))
+			continue;
+
+		dns_name_init(&hnode_name, NULL);
+		NODENAME(hnode, &hnode_name);
+		if (ISC_LIKELY(dns_name_equal(&hnode_name, hash_name)))
+			return (hnode);
+	}
+
+	return (NULL);
+}
+
+static inline dns_rbtnode_t *
+hash_find(dns_rbt_t *rbt, unsigned int hash, dns_rbtnode_t *up_current,
+	  dns_name_t *hash_name)
+{
+	dns_rbtnode_t *hnode;
+	size_t bucket;
+
+	hnode = hash_find_bucket(rbt->hashtable[hash % rbt->hashsize],
+				 hash, up_current, hash_name);
+	if (hnode != NULL || rbt->oldhashtable == NULL)
+		return (hnode);
+
+	/*
+	 * The table is growing; the node may not have been moved yet.
+	 */
+	bucket = hash % rbt->oldhashsize;
+	if (bucket < rbt->rehashpos)
+		return (NULL);
+	return (hash_find_bucket(rbt->oldhashtable[bucket],
+				 hash, up_current, hash_name));
+}
+
 static inline void
 hash_add_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name) {
 	unsigned int hash;
 
 	REQUIRE(name != NULL);
 
-	HASHVAL(node) = dns_name_fullhash(name, false);
+	HASHVAL(node) = name_hash(rbt, name);
 
 	hash = HASHVAL(node) % rbt->hashsize;
 	HASHNEXT(node) = rbt->hashtable[hash];
@@ -2332,34 +2523,20 @@ inithash(dns_rbt_t *rbt) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Move up to 'buckets' buckets of the previous hash table to the
+ * current one, and free the previous table once it is empty.
+ */
 static void
-rehash(dns_rbt_t *rbt, unsigned int newcount) {
-	unsigned int oldsize;
-	dns_rbtnode_t **oldtable;
+rehash_some(dns_rbt_t *rbt, size_t buckets) {
 	dns_rbtnode_t *node;
 	dns_rbtnode_t *nextnode;
 	unsigned int hash;
-	unsigned int i;
 
-	oldsize = (unsigned int)rbt->hashsize;
-	oldtable = rbt->hashtable;
-	do {
-		INSIST((rbt->hashsize * 2 + 1) > rbt->hashsize);
-		rbt->hashsize = rbt->hashsize * 2 + 1;
-	} while (newcount >= (rbt->hashsize * 3));
-	rbt->hashtable = isc_mem_get(rbt->mctx,
-				     rbt->hashsize * sizeof(dns_rbtnode_t *));
-	if (rbt->hashtable == NULL) {
-		rbt->hashtable = oldtable;
-		rbt->hashsize = oldsize;
-		return;
-	}
-
-	for (i = 0; i < rbt->hashsize; i++)
-		rbt->hashtable[i] = NULL;
-
-	for (i = 0; i < oldsize; i++) {
-		for (node = oldtable[i]; node != NULL; node = nextnode) {
+	while (buckets-- > 0 && rbt->rehashpos < rbt->oldhashsize) {
+		node = rbt->oldhashtable[rbt->rehashpos];
+		rbt->oldhashtable[rbt->rehashpos++] = NULL;
+		for (; node != NULL; node = nextnode) {
 			hash = HASHVAL(node) % rbt->hashsize;
 			nextnode = HASHNEXT(node);
 			HASHNEXT(node) = rbt->hashtable[hash];
@@ -2367,38 +2544,100 @@ rehash(dns_rbt_t *rbt, unsigned int newcount) {
 		}
 	}
 
-	isc_mem_put(rbt->mctx, oldtable, oldsize * sizeof(dns_rbtnode_t *));
+	if (rbt->rehashpos == rbt->oldhashsize) {
+		isc_mem_put(rbt->mctx, rbt->oldhashtable,
+			    rbt->oldhashsize * sizeof(dns_rbtnode_t *));
+		rbt->oldhashtable = NULL;
+		rbt->oldhashsize = 0;
+		rbt->rehashpos = 0;
+	}
+}
+
+/*
+ * Replace the hash table with one large enough for 'newcount' nodes.
+ * The nodes are moved to the new table a few buckets at a time by
+ * hash_node(), so that growing a large table does not stall lookups.
+ */
+static void
+rehash(dns_rbt_t *rbt, unsigned int newcount) {
+	size_t newsize;
+	dns_rbtnode_t **newtable;
+
+	/*
+	 * Finish any growth still in progress first; this only happens
+	 * when the table is grown explicitly.
+	 */
+	if (rbt->oldhashtable != NULL)
+		rehash_some(rbt, rbt->oldhashsize);
+
+	newsize = rbt->hashsize;
+	do {
+		INSIST((newsize * 2 + 1) > newsize);
+		newsize = newsize * 2 + 1;
+	} while (newcount >= (newsize * 3));
+	newtable = isc_mem_get(rbt->mctx, newsize * sizeof(dns_rbtnode_t *));
+	if (newtable == NULL)
+		return;
+	memset(newtable, 0, newsize * sizeof(dns_rbtnode_t *));
+
+	rbt->oldhashtable = rbt->hashtable;
+	rbt->oldhashsize = rbt->hashsize;
+	rbt->rehashpos = 0;
+	rbt->hashtable = newtable;
+	rbt->hashsize = newsize;
+
+	/*
+	 * Nothing to move from an empty tree.
+	 */
+	if (rbt->nodecount == 0)
+		rehash_some(rbt, rbt->oldhashsize);
 }
 
 static inline void
 hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name) {
 	REQUIRE(DNS_RBTNODE_VALID(node));
 
+	if (rbt->oldhashtable != NULL)
+		rehash_some(rbt, RBT_REHASH_BUCKETS);
+
 	if (rbt->nodecount >= (rbt->hashsize * 3))
 		rehash(rbt, rbt->nodecount);
 
 	hash_add_node(rbt, node, name);
 }
 
+static inline bool
+unhash_bucket(dns_rbtnode_t **bucketp, dns_rbtnode_t *node) {
+	dns_rbtnode_t *bucket_node = *bucketp;
+
+	if (bucket_node == node) {
+		*bucketp = HASHNEXT(node);
+		return (true);
+	}
+	while (bucket_node != NULL) {
+		if (HASHNEXT(bucket_node) == node) {
+			HASHNEXT(bucket_node) = HASHNEXT(node);
+			return (true);
+		}
+		bucket_node = HASHNEXT(bucket_node);
+	}
+	return (false);
+}
+
 static inline void
 unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node) {
-	unsigned int bucket;
-	dns_rbtnode_t *bucket_node;
+	size_t bucket;
 
 	REQUIRE(DNS_RBTNODE_VALID(node));
 
 	bucket = HASHVAL(node) % rbt->hashsize;
-	bucket_node = rbt->hashtable[bucket];
+	if (unhash_bucket(&rbt->hashtable[bucket], node))
+		return;
 
-	if (bucket_node == node) {
-		rbt->hashtable[bucket] = HASHNEXT(node);
-	} else {
-		while (HASHNEXT(bucket_node) != node) {
-			INSIST(HASHNEXT(bucket_node) != NULL);
-			bucket_node = HASHNEXT(bucket_node);
-		}
-		HASHNEXT(bucket_node) = HASHNEXT(node);
-	}
+	INSIST(rbt->oldhashtable != NULL);
+	bucket = HASHVAL(node) % rbt->oldhashsize;
+	INSIST(bucket >= rbt->rehashpos);
+	RUNTIME_CHECK(unhash_bucket(&rbt->oldhashtable[bucket], node));
 }
 #endif /* DNS_RBT_USEHASH */
 
@@ -2878,6 +3117,62 @@ deletetreeflat(dns_rbt_t *rbt, unsigned int quantum, bool unhash,
 	*nodep = root;
 }
 
+/*
+ * Delete the whole tree at '*nodep' like deletetreeflat(), but without
+ * changing the nodes, which may be in a map file image.  The tree is
+ * walked in the same order, using the parent pointers to get back up.
+ */
+static void
+deletetreeinplace(dns_rbt_t *rbt, dns_rbtnode_t **nodep) {
+	dns_rbtnode_t *node = *nodep, *parent, *next;
+
+	while (node != NULL) {
+		/*
+		 * Go down to the first node that has no left, right or
+		 * down node.
+		 */
+		for (;;) {
+			if (LEFT(node) != NULL)
+				node = LEFT(node);
+			else if (RIGHT(node) != NULL)
+				node = RIGHT(node);
+			else if (DOWN(node) != NULL)
+				node = DOWN(node);
+			else
+				break;
+		}
+
+		/*
+		 * Free it, and then its parents, until one of them has
+		 * another subtree that is still to be deleted.
+		 */
+		do {
+			parent = PARENT(node);
+			next = NULL;
+			if (parent != NULL && !IS_ROOT(node)) {
+				if (LEFT(parent) == node &&
+				    RIGHT(parent) != NULL)
+					next = RIGHT(parent);
+				else
+					next = DOWN(parent);
+			}
+
+			if (DATA(node) != NULL && rbt->data_deleter != NULL)
+				rbt->data_deleter(DATA(node),
+						  rbt->deleter_arg);
+#if DNS_RBT_USEMAGIC
+			if (node->is_mmapped == 0)
+				node->magic = 0;
+#endif
+			freenode(rbt, &node);
+
+			node = (next != NULL) ? next : parent;
+		} while (next == NULL && node != NULL);
+	}
+
+	*nodep = NULL;
+}
+
 static size_t
 getheight_helper(dns_rbtnode_t *node) {
 	size_t dl, dr;
@@ -3016,12 +3311,7 @@ dns_rbt_printnodeinfo(dns_rbtnode_t *n, FILE *f) {
 
 	fprintf(f, "n = %p\n", n);
 
-	fprintf(f, "Relative pointers: %s%s%s%s%s\n",
-			(n->parent_is_relative == 1 ? " P" : ""),
-			(n->right_is_relative == 1 ? " R" : ""),
-			(n->left_is_relative == 1 ? " L" : ""),
-			(n->down_is_relative == 1 ? " D" : ""),
-			(n->data_is_relative == 1 ? " T" : ""));
+	fprintf(f, "Mapped: %s\n", n->is_mmapped == 1 ? "yes" : "no");
 
 	fprintf(f, "node lock address = %u\n", n->locknum);
 
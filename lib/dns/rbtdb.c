@@ -18,6 +18,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
+#include <isc/condition.h>
 #include <isc/crc64.h>
 #include <isc/event.h>
 #include <isc/heap.h>
@@ -26,6 +28,7 @@
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/random.h>
@@ -36,6 +39,7 @@
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -47,6 +51,7 @@
 #include <dns/fixedname.h>
 #include <dns/lib.h>
 #include <dns/log.h>
+#include <dns/master.h>
 #include <dns/masterdump.h>
 #include <dns/nsec.h>
 #include <dns/nsec3.h>
@@ -74,6 +79,14 @@
 #define MAP_FAILED	((void *)-1)
 #endif
 
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#if defined(__cplusplus)
+#include <isc/stdatomic.h>
+#else
+#include <stdatomic.h>
+#endif
+#endif
+
 #ifdef DNS_RBTDB_VERSION64
 #include "rbtdb64.h"
 #else
@@ -96,6 +109,12 @@
  * written, as the LAST thing done to the file.  Writing this last (with
  * zeros in the header area initially) will ensure that the header is only
  * valid when the RBTDB image is also valid.
+ *
+ * The image is written to be mapped at address 'base', and ends at
+ * offset 'size' in the file.  When it is mapped there, nothing else
+ * needs to be set up and the loader trusts the file, the database is
+ * used straight from the mapped file, and 'records' and 'bytes' give
+ * the sizes that would otherwise be counted while loading.
  */
 typedef struct rbtdb_file_header rbtdb_file_header_t;
 
@@ -109,10 +128,30 @@ struct rbtdb_file_header {
 	uint64_t tree;
 	uint64_t nsec;
 	uint64_t nsec3;
+	uint64_t base;
+	uint64_t size;
+	uint64_t records;
+	uint64_t bytes;
+	uint64_t resigns;		/* headers to add to the resign heaps */
+	uint32_t nodelocks;		/* node_lock_count of the database */
+	uint32_t headersize;		/* sizeof(rdatasetheader_t) */
 
 	char version2[32];  		/* repeated; must match version1 */
 };
 
+/*
+ * Preferred addresses for map file images, on platforms with enough
+ * address space to keep them clear of everything else.  Each image is
+ * given a randomly chosen address in a range well away from where the
+ * heap, libraries and stacks are usually placed, so that images of
+ * different zones rarely want the same address.
+ */
+#if defined(_LP64) || defined(__LP64__) || defined(_WIN64)
+#define RBTDB_MAP_BASE		((uintptr_t)0x100000000000ULL)
+#define RBTDB_MAP_RANGE		((uintptr_t)0x200000000000ULL)
+#define RBTDB_MAP_ALIGN		((uintptr_t)0x200000)
+#endif
+
 
 /*%
  * Note that "impmagic" is not the first four bytes of the struct, so
@@ -154,6 +193,7 @@ typedef uint64_t                    rbtdb_serial_t;
 #define addnoqname addnoqname64
 #define addrdataset addrdataset64
 #define adjust_quantum adjust_quantum64
+#define adjusthashsize adjusthashsize64
 #define allocate_version allocate_version64
 #define allrdatasets allrdatasets64
 #define attach attach64
@@ -186,6 +226,7 @@ typedef uint64_t                    rbtdb_serial_t;
 #define dbiterator_prev dbiterator_prev64
 #define dbiterator_seek dbiterator_seek64
 #define decrement_reference decrement_reference64
+#define default_node_lock_count default_node_lock_count64
 #define delegating_type delegating_type64
 #define delete_callback delete_callback64
 #define delete_node delete_node64
@@ -205,6 +246,7 @@ typedef uint64_t                    rbtdb_serial_t;
 #define findnode findnode64
 #define findnodeintree findnodeintree64
 #define findnsec3node findnsec3node64
+#define fix_locknums fix_locknums64
 #define flush_deletions flush_deletions64
 #define free_acachearray free_acachearray64
 #define free_noqname free_noqname64
@@ -234,8 +276,10 @@ typedef uint64_t                    rbtdb_serial_t;
 #define new_rdataset new_rdataset64
 #define new_reference new_reference64
 #define newversion newversion64
+#define node_lock node_lock64
 #define nodecount nodecount64
 #define nodefullname nodefullname64
+#define nodelockstats nodelockstats64
 #define overmem overmem64
 #define overmem_purge overmem_purge64
 #define previous_closest_nsec previous_closest_nsec64
@@ -285,6 +329,18 @@ typedef uint64_t                    rbtdb_serial_t;
 #define settask settask64
 #define setup_delegation setup_delegation64
 #define subtractrdataset subtractrdataset64
+#define treelock_clearwriter treelock_clearwriter64
+#define treelock_count treelock_count64
+#define treelock_destroy treelock_destroy64
+#define treelock_downgrade treelock_downgrade64
+#define treelock_init treelock_init64
+#define treelock_lock treelock_lock64
+#define treelock_readers treelock_readers64
+#define treelock_setwriter treelock_setwriter64
+#define treelock_tryread treelock_tryread64
+#define treelock_trylock treelock_trylock64
+#define treelock_tryupgrade treelock_tryupgrade64
+#define treelock_unlock treelock_unlock64
 #define ttl_sooner ttl_sooner64
 #define update_cachestats update_cachestats64
 #define update_header update_header64
@@ -292,6 +348,7 @@ typedef uint64_t                    rbtdb_serial_t;
 #define update_recordsandbytes  update_recordsandbytes64
 #define update_rrsetstats update_rrsetstats64
 #define valid_glue valid_glue64
+#define visible_header visible_header64
 #define zone_find zone_find64
 #define zone_findrdataset zone_findrdataset64
 #define zone_findzonecut zone_findzonecut64
@@ -370,9 +427,11 @@ typedef uint32_t                    rbtdb_rdatatype_t;
 #if defined(ISC_RWLOCK_USEATOMIC) && defined(DNS_RBT_USEISCREFCOUNT)
 typedef isc_rwlock_t nodelock_t;
 
+#define NODE_USERWLOCK		1
+
 #define NODE_INITLOCK(l)        isc_rwlock_init((l), 0, 0)
 #define NODE_DESTROYLOCK(l)     isc_rwlock_destroy(l)
-#define NODE_LOCK(l, t)         RWLOCK((l), (t))
+#define NODE_LOCK(l, t)         node_lock((l), (t))
 #define NODE_UNLOCK(l, t)       RWUNLOCK((l), (t))
 #define NODE_TRYUPGRADE(l)      isc_rwlock_tryupgrade(l)
 
@@ -386,17 +445,302 @@ typedef isc_mutex_t nodelock_t;
 
 #define NODE_INITLOCK(l)        isc_mutex_init(l)
 #define NODE_DESTROYLOCK(l)     DESTROYLOCK(l)
-#define NODE_LOCK(l, t)         LOCK(l)
+#define NODE_LOCK(l, t)         node_lock((l), (t))
 #define NODE_UNLOCK(l, t)       UNLOCK(l)
 #define NODE_TRYUPGRADE(l)      ISC_R_SUCCESS
 
-#define NODE_STRONGLOCK(l)      LOCK(l)
+#define NODE_STRONGLOCK(l)      node_lock((l), isc_rwlocktype_write)
 #define NODE_STRONGUNLOCK(l)    UNLOCK(l)
 #define NODE_WEAKLOCK(l, t)     ((void)0)
 #define NODE_WEAKUNLOCK(l, t)   ((void)0)
 #define NODE_WEAKDOWNGRADE(l)   ((void)0)
 #endif
 
+/*
+ * Zone databases are read far more often than they are written, but
+ * with an isc_rwlock every reader updates the same lock word, so on a
+ * busy authoritative server the cache line holding the tree lock of a
+ * popular zone moves between CPUs on every lookup.  The tree lock of a
+ * zone database is therefore striped: each stripe counts readers on a
+ * cache line of its own, and a reader only touches the stripe picked
+ * from its thread.  A writer serializes with other writers on 'wlock',
+ * sets 'writer' so that new readers back off and wait for 'wlock', and
+ * then sleeps on 'drained' until the readers already inside have left.
+ * A reader that leaves while 'writer' is set wakes it, so a steady
+ * stream of readers cannot hold off an update.
+ *
+ * Only the sum of the stripes is meaningful, so a read lock may be
+ * released by a different thread than the one that took it.
+ *
+ * Caches are written too often for this to pay off and keep using an
+ * ordinary rwlock.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && defined(ISC_PLATFORM_HAVESTDATOMIC)
+#define TREE_USESTRIPES		1
+#define TREE_STRIPES_MAX	16
+#define TREE_STRIPE_SIZE	64	/*%< Assumed cache line size. */
+
+typedef union {
+	atomic_int_fast32_t		readers;
+	char				pad[TREE_STRIPE_SIZE];
+} treelock_stripe_t;
+
+typedef struct {
+	/* Used when nstripes is 0. */
+	isc_rwlock_t			rwlock;
+	/* Used when nstripes is not 0. */
+	unsigned int			nstripes;
+	treelock_stripe_t *		stripes;
+	void *				base;
+	size_t				size;
+	isc_mutex_t			wlock;
+	atomic_int_fast32_t		writer;
+	isc_mutex_t			dlock;
+	isc_condition_t			drained;
+} treelock_t;
+
+#define TREE_INITLOCK(m, l, s)	treelock_init((m), (l), (s))
+#define TREE_DESTROYLOCK(m, l)	treelock_destroy((m), (l))
+#define TREE_LOCK(l, t)		treelock_lock((l), (t))
+#define TREE_UNLOCK(l, t)	treelock_unlock((l), (t))
+#define TREE_TRYLOCK(l, t)	treelock_trylock((l), (t))
+#define TREE_TRYUPGRADE(l)	treelock_tryupgrade(l)
+#define TREE_DOWNGRADE(l)	treelock_downgrade(l)
+
+static isc_result_t
+treelock_init(isc_mem_t *mctx, treelock_t *lock, bool striped) {
+	isc_result_t result;
+	unsigned int i, ncpus;
+
+	lock->nstripes = 0;
+	lock->stripes = NULL;
+	lock->base = NULL;
+	lock->size = 0;
+	if (!striped)
+		return (isc_rwlock_init(&lock->rwlock, 0, 0));
+
+	ncpus = isc_os_ncpus();
+	lock->nstripes = 1;
+	while (lock->nstripes < ncpus && lock->nstripes < TREE_STRIPES_MAX)
+		lock->nstripes <<= 1;
+
+	/*
+	 * Allocate one extra stripe so that the stripes can be aligned
+	 * on a cache line boundary.
+	 */
+	lock->size = (lock->nstripes + 1) * sizeof(treelock_stripe_t);
+	lock->base = isc_mem_get(mctx, lock->size);
+	if (lock->base == NULL)
+		return (ISC_R_NOMEMORY);
+	lock->stripes = (treelock_stripe_t *)
+		(((uintptr_t)lock->base + TREE_STRIPE_SIZE - 1) &
+		 ~(uintptr_t)(TREE_STRIPE_SIZE - 1));
+	for (i = 0; i < lock->nstripes; i++)
+		atomic_init(&lock->stripes[i].readers, 0);
+	atomic_init(&lock->writer, 0);
+
+	result = isc_mutex_init(&lock->wlock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_base;
+	result = isc_mutex_init(&lock->dlock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_wlock;
+	result = isc_condition_init(&lock->drained);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_dlock;
+	return (ISC_R_SUCCESS);
+
+ cleanup_dlock:
+	DESTROYLOCK(&lock->dlock);
+ cleanup_wlock:
+	DESTROYLOCK(&lock->wlock);
+ cleanup_base:
+	isc_mem_put(mctx, lock->base, lock->size);
+	return (result);
+}
+
+static void
+treelock_destroy(isc_mem_t *mctx, treelock_t *lock) {
+	if (lock->nstripes == 0) {
+		isc_rwlock_destroy(&lock->rwlock);
+		return;
+	}
+
+	INSIST(atomic_load_explicit(&lock->writer, memory_order_relaxed) == 0);
+	(void)isc_condition_destroy(&lock->drained);
+	DESTROYLOCK(&lock->dlock);
+	DESTROYLOCK(&lock->wlock);
+	isc_mem_put(mctx, lock->base, lock->size);
+}
+
+static inline atomic_int_fast32_t *
+treelock_readers(treelock_t *lock) {
+	uint64_t self = (uint64_t)isc_thread_self();
+
+	self *= 0x9e3779b97f4a7c15ULL;
+	return (&lock->stripes[(self >> 32) & (lock->nstripes - 1)].readers);
+}
+
+static inline int32_t
+treelock_count(treelock_t *lock) {
+	int32_t count = 0;
+	unsigned int i;
+
+	for (i = 0; i < lock->nstripes; i++)
+		count += atomic_load_explicit(&lock->stripes[i].readers,
+					      memory_order_seq_cst);
+	return (count);
+}
+
+/*
+ * Leave as a reader.  The decrement and the check of 'writer' pair with
+ * the store to 'writer' and the count in treelock_lock(): either this
+ * reader sees the writer and wakes it, or the writer sees the reader
+ * gone.  'dlock' is taken so that the wakeup cannot fall between the
+ * writer's count and its wait.
+ */
+static inline void
+treelock_leave(treelock_t *lock, atomic_int_fast32_t *readers) {
+	atomic_fetch_sub_explicit(readers, 1, memory_order_seq_cst);
+	if (atomic_load_explicit(&lock->writer, memory_order_seq_cst) != 0) {
+		LOCK(&lock->dlock);
+		BROADCAST(&lock->drained);
+		UNLOCK(&lock->dlock);
+	}
+}
+
+/*
+ * Enter as a reader unless a writer holds or waits for the lock.
+ * The increment and the check of 'writer' pair with the store to
+ * 'writer' and the reader count in treelock_setwriter(): either the
+ * reader sees the writer or the writer sees the reader.
+ */
+static inline bool
+treelock_tryread(treelock_t *lock) {
+	atomic_int_fast32_t *readers = treelock_readers(lock);
+
+	atomic_fetch_add_explicit(readers, 1, memory_order_seq_cst);
+	if (atomic_load_explicit(&lock->writer, memory_order_seq_cst) == 0)
+		return (true);
+	treelock_leave(lock, readers);
+	return (false);
+}
+
+/*
+ * Called with 'wlock' held.  Keep new readers out and check whether
+ * exactly 'count' readers are left.
+ */
+static inline bool
+treelock_setwriter(treelock_t *lock, int32_t count) {
+	atomic_store_explicit(&lock->writer, 1, memory_order_seq_cst);
+	return (treelock_count(lock) == count);
+}
+
+static inline void
+treelock_clearwriter(treelock_t *lock) {
+	atomic_store_explicit(&lock->writer, 0, memory_order_seq_cst);
+	UNLOCK(&lock->wlock);
+}
+
+static inline void
+treelock_lock(treelock_t *lock, isc_rwlocktype_t type) {
+	if (lock->nstripes == 0) {
+		RWLOCK(&lock->rwlock, type);
+		return;
+	}
+
+	if (type == isc_rwlocktype_read) {
+		while (!treelock_tryread(lock)) {
+			/* Wait for the writer to finish. */
+			LOCK(&lock->wlock);
+			UNLOCK(&lock->wlock);
+		}
+		return;
+	}
+
+	LOCK(&lock->wlock);
+	if (!treelock_setwriter(lock, 0)) {
+		LOCK(&lock->dlock);
+		while (treelock_count(lock) != 0)
+			WAIT(&lock->drained, &lock->dlock);
+		UNLOCK(&lock->dlock);
+	}
+}
+
+static inline void
+treelock_unlock(treelock_t *lock, isc_rwlocktype_t type) {
+	if (lock->nstripes == 0) {
+		RWUNLOCK(&lock->rwlock, type);
+		return;
+	}
+
+	if (type == isc_rwlocktype_read)
+		treelock_leave(lock, treelock_readers(lock));
+	else
+		treelock_clearwriter(lock);
+}
+
+static inline isc_result_t
+treelock_trylock(treelock_t *lock, isc_rwlocktype_t type) {
+	if (lock->nstripes == 0)
+		return (isc_rwlock_trylock(&lock->rwlock, type));
+
+	if (type == isc_rwlocktype_read)
+		return (treelock_tryread(lock) ? ISC_R_SUCCESS
+					       : ISC_R_LOCKBUSY);
+
+	if (isc_mutex_trylock(&lock->wlock) != ISC_R_SUCCESS)
+		return (ISC_R_LOCKBUSY);
+	if (!treelock_setwriter(lock, 0)) {
+		treelock_clearwriter(lock);
+		return (ISC_R_LOCKBUSY);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * The caller holds a read lock, so the upgrade only succeeds if it is
+ * the last reader.
+ */
+static inline isc_result_t
+treelock_tryupgrade(treelock_t *lock) {
+	if (lock->nstripes == 0)
+		return (isc_rwlock_tryupgrade(&lock->rwlock));
+
+	if (isc_mutex_trylock(&lock->wlock) != ISC_R_SUCCESS)
+		return (ISC_R_LOCKBUSY);
+	if (!treelock_setwriter(lock, 1)) {
+		treelock_clearwriter(lock);
+		return (ISC_R_LOCKBUSY);
+	}
+	atomic_fetch_sub_explicit(treelock_readers(lock), 1,
+				  memory_order_relaxed);
+	return (ISC_R_SUCCESS);
+}
+
+static inline void
+treelock_downgrade(treelock_t *lock) {
+	if (lock->nstripes == 0) {
+		isc_rwlock_downgrade(&lock->rwlock);
+		return;
+	}
+
+	atomic_fetch_add_explicit(treelock_readers(lock), 1,
+				  memory_order_relaxed);
+	treelock_clearwriter(lock);
+}
+#else
+typedef isc_rwlock_t treelock_t;
+
+#define TREE_INITLOCK(m, l, s)	isc_rwlock_init((l), 0, 0)
+#define TREE_DESTROYLOCK(m, l)	isc_rwlock_destroy(l)
+#define TREE_LOCK(l, t)		RWLOCK((l), (t))
+#define TREE_UNLOCK(l, t)	RWUNLOCK((l), (t))
+#define TREE_TRYLOCK(l, t)	isc_rwlock_trylock((l), (t))
+#define TREE_TRYUPGRADE(l)	isc_rwlock_tryupgrade(l)
+#define TREE_DOWNGRADE(l)	isc_rwlock_downgrade(l)
+#endif /* ISC_PLATFORM_USETHREADS && ISC_PLATFORM_HAVESTDATOMIC */
+
 /*%
  * Whether to rate-limit updating the LRU to avoid possible thread contention.
  * Our performance measurement has shown the cost is marginal, so it's defined
@@ -433,8 +777,6 @@ typedef struct rdatasetheader {
 	struct noqname                  *noqname;
 	struct noqname                  *closest;
 	unsigned int 			is_mmapped : 1;
-	unsigned int 			next_is_relative : 1;
-	unsigned int 			node_is_relative : 1;
 	unsigned int 			resign_lsb : 1;
 	/*%<
 	 * We don't use the LIST macros, because the LIST structure has
@@ -577,15 +919,62 @@ struct acachectl {
 #else
 #define DEFAULT_CACHE_NODE_LOCK_COUNT   16
 #endif	/* DNS_RBTDB_CACHE_NODE_LOCK_COUNT */
+#define MAX_CACHE_NODE_LOCK_COUNT       64
+
+/*%
+ * The number of times a node lock had to be waited for.  With rwlocks
+ * several readers may be waiting at once, so the counter is atomic;
+ * with mutexes it is only updated while the lock is held.
+ */
+#if defined(NODE_USERWLOCK) && defined(ISC_PLATFORM_HAVESTDATOMIC)
+typedef atomic_uint_fast32_t		nodelock_waits_t;
+#define NODE_WAITED(w) \
+	atomic_fetch_add_explicit(&(w), 1, memory_order_relaxed)
+#define NODE_WAITS(w)	atomic_load_explicit(&(w), memory_order_relaxed)
+#elif defined(NODE_USERWLOCK)
+typedef int32_t				nodelock_waits_t;
+#define NODE_WAITED(w)	isc_atomic_xadd(&(w), 1)
+#define NODE_WAITS(w)	((uint32_t)(w))
+#else
+typedef unsigned int			nodelock_waits_t;
+#define NODE_WAITED(w)	((w)++)
+#define NODE_WAITS(w)	(w)
+#endif
 
 typedef struct {
+	/* Must be first; see node_lock(). */
 	nodelock_t                      lock;
 	/* Protected in the refcount routines. */
 	isc_refcount_t                  references;
 	/* Locked by lock. */
 	bool                   exiting;
+	/* See NODE_WAITED(). */
+	nodelock_waits_t		waits;
 } rbtdb_nodelock_t;
 
+/*%
+ * Acquire a node lock, counting the acquisitions that found the lock
+ * busy so that contention on each stripe can be reported.
+ */
+static inline void
+node_lock(nodelock_t *lock, isc_rwlocktype_t type) {
+	rbtdb_nodelock_t *nodelock = (rbtdb_nodelock_t *)lock;
+
+#ifdef NODE_USERWLOCK
+	if (isc_rwlock_trylock(lock, type) == ISC_R_SUCCESS)
+		return;
+	NODE_WAITED(nodelock->waits);
+	RWLOCK(lock, type);
+#else
+	UNUSED(type);
+
+	if (isc_mutex_trylock(lock) == ISC_R_SUCCESS)
+		return;
+	LOCK(lock);
+	NODE_WAITED(nodelock->waits);
+#endif
+}
+
 typedef struct rbtdb_changed {
 	dns_rbtnode_t *                 node;
 	bool                   dirty;
@@ -654,7 +1043,7 @@ struct dns_rbtdb {
 	isc_mutex_t                     lock;
 #endif
 	/* Locks the tree structure (prevents nodes appearing/disappearing) */
-	isc_rwlock_t                    tree_lock;
+	treelock_t                      tree_lock;
 	/* Locks for individual tree nodes */
 	unsigned int                    node_lock_count;
 	rbtdb_nodelock_t *              node_locks;
@@ -746,6 +1135,25 @@ typedef struct {
 	isc_stdtime_t           now;
 } rbtdb_load_t;
 
+/*%
+ * Map file image writing context
+ */
+typedef struct {
+	rbtdb_version_t *       version;
+	uintptr_t               base;	/*%< address the image is for */
+	uint64_t                records;
+	uint64_t                bytes;
+	uint64_t                resigns;
+} rbtdb_writer_t;
+
+/*%
+ * Map file image loading context
+ */
+typedef struct {
+	dns_rbtdb_t *           rbtdb;
+	uintptr_t               base;	/*%< address the image was for */
+} rbtdb_fixer_t;
+
 static void delete_callback(void *data, void *arg);
 static void rdataset_disassociate(dns_rdataset_t *rdataset);
 static isc_result_t rdataset_first(dns_rdataset_t *rdataset);
@@ -1360,7 +1768,7 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 
 	isc_mem_put(rbtdb->common.mctx, rbtdb->node_locks,
 		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
-	isc_rwlock_destroy(&rbtdb->tree_lock);
+	TREE_DESTROYLOCK(rbtdb->common.mctx, &rbtdb->tree_lock);
 	isc_refcount_destroy(&rbtdb->references);
 	if (rbtdb->task != NULL)
 		isc_task_detach(&rbtdb->task);
@@ -1655,8 +2063,6 @@ init_rdataset(dns_rbtdb_t *rbtdb, rdatasetheader_t *h) {
 	ISC_LINK_INIT(h, link);
 	h->heap_index = 0;
 	h->is_mmapped = 0;
-	h->next_is_relative = 0;
-	h->node_is_relative = 0;
 
 #if TRACE_HEADER
 	if (IS_CACHE(rbtdb) && rbtdb->common.rdclass == dns_rdataclass_in)
@@ -1667,22 +2073,10 @@ init_rdataset(dns_rbtdb_t *rbtdb, rdatasetheader_t *h) {
 }
 
 /*
- * Update the copied values of 'next' and 'node' if they are relative.
+ * Copy the case of the owner name from 'old' to 'newh'.
  */
 static void
 update_newheader(rdatasetheader_t *newh, rdatasetheader_t *old) {
-	char *p;
-
-	if (old->next_is_relative) {
-		p = (char *) old;
-		p += (uintptr_t)old->next;
-		newh->next = (rdatasetheader_t *)p;
-	}
-	if (old->node_is_relative) {
-		p = (char *) old;
-		p += (uintptr_t)old->node;
-		newh->node = (dns_rbtnode_t *)p;
-	}
 	if (CASESET(old)) {
 		uint16_t attr;
 
@@ -1727,9 +2121,14 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
 		ISC_LIST_UNLINK(rbtdb->rdatasets[idx], rdataset, link);
 	}
 
-	if (rdataset->heap_index != 0)
+	/*
+	 * Headers in a map file image are only written to when there is
+	 * something to change, so that their pages stay shared.
+	 */
+	if (rdataset->heap_index != 0) {
 		isc_heap_delete(rbtdb->heaps[idx], rdataset->heap_index);
-	rdataset->heap_index = 0;
+		rdataset->heap_index = 0;
+	}
 
 	if (rdataset->noqname != NULL)
 		free_noqname(mctx, &rdataset->noqname);
@@ -2316,9 +2715,9 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		 * we only do a trylock.
 		 */
 		if (tlock == isc_rwlocktype_read)
-			result = isc_rwlock_tryupgrade(&rbtdb->tree_lock);
+			result = TREE_TRYUPGRADE(&rbtdb->tree_lock);
 		else
-			result = isc_rwlock_trylock(&rbtdb->tree_lock,
+			result = TREE_TRYLOCK(&rbtdb->tree_lock,
 						    isc_rwlocktype_write);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS ||
 			      result == ISC_R_LOCKBUSY);
@@ -2379,11 +2778,11 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	 */
 	if (tlock == isc_rwlocktype_none)
 		if (write_locked)
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	if (tlock == isc_rwlocktype_read)
 		if (write_locked)
-			isc_rwlock_downgrade(&rbtdb->tree_lock);
+			TREE_DOWNGRADE(&rbtdb->tree_lock);
 
 	return (no_reference);
 }
@@ -2406,7 +2805,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 
 	isc_event_free(&event);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	locknum = node->locknum;
 	NODE_LOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
 	do {
@@ -2446,7 +2845,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 		node = parent;
 	} while (node != NULL);
 	NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	detach((dns_db_t **)&rbtdb);
 }
@@ -2564,7 +2963,7 @@ setnsec3parameters(dns_db_t *db, rbtdb_version_t *version) {
 	unsigned int count, length;
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	version->havensec3 = false;
 	node = rbtdb->origin_node;
 	NODE_LOCK(&(rbtdb->node_locks[node->locknum].lock),
@@ -2633,7 +3032,7 @@ setnsec3parameters(dns_db_t *db, rbtdb_version_t *version) {
  unlock:
 	NODE_UNLOCK(&(rbtdb->node_locks[node->locknum].lock),
 		    isc_rwlocktype_read);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 }
 
 static void
@@ -2643,7 +3042,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 	unsigned int locknum;
 	unsigned int refs;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	for (locknum = 0; locknum < rbtdb->node_lock_count; locknum++) {
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
 			  isc_rwlocktype_write);
@@ -2653,7 +3052,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
 			    isc_rwlocktype_write);
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	if (again)
 		isc_task_send(task, &event);
 	else {
@@ -2893,7 +3292,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 			 * expensive, but this event should be rare enough
 			 * to justify the cost.
 			 */
-			RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 			tlock = isc_rwlocktype_write;
 		}
 
@@ -2929,7 +3328,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 			isc_refcount_increment(&rbtdb->references, NULL);
 			isc_task_send(rbtdb->task, &event);
 		} else
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	}
 
  end:
@@ -3019,11 +3418,11 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 	INSIST(tree == rbtdb->tree || tree == rbtdb->nsec3);
 
 	dns_name_init(&nodename, NULL);
-	RWLOCK(&rbtdb->tree_lock, locktype);
+	TREE_LOCK(&rbtdb->tree_lock, locktype);
 	result = dns_rbt_findnode(tree, name, NULL, &node, NULL,
 				  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
 	if (result != ISC_R_SUCCESS) {
-		RWUNLOCK(&rbtdb->tree_lock, locktype);
+		TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 		if (!create) {
 			if (result == DNS_R_PARTIALMATCH)
 				result = ISC_R_NOTFOUND;
@@ -3034,7 +3433,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 		 * unlocking then relocking.
 		 */
 		locktype = isc_rwlocktype_write;
-		RWLOCK(&rbtdb->tree_lock, locktype);
+		TREE_LOCK(&rbtdb->tree_lock, locktype);
 		node = NULL;
 		result = dns_rbt_addnode(tree, name, &node);
 		if (result == ISC_R_SUCCESS) {
@@ -3051,7 +3450,8 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 				if (dns_name_iswildcard(name)) {
 					result = add_wildcard_magic(rbtdb, name);
 					if (result != ISC_R_SUCCESS) {
-						RWUNLOCK(&rbtdb->tree_lock, locktype);
+						TREE_UNLOCK(&rbtdb->tree_lock,
+							    locktype);
 						return (result);
 					}
 				}
@@ -3059,7 +3459,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 			if (tree == rbtdb->nsec3)
 				node->nsec = DNS_RBT_NSEC_NSEC3;
 		} else if (result != ISC_R_EXISTS) {
-			RWUNLOCK(&rbtdb->tree_lock, locktype);
+			TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 			return (result);
 		}
 	}
@@ -3097,7 +3497,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 		}
 	}
 
-	RWUNLOCK(&rbtdb->tree_lock, locktype);
+	TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 
 	*nodep = (dns_dbnode_t *)node;
 
@@ -4164,7 +4564,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	 */
 	wild = false;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -4588,7 +4988,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	NODE_UNLOCK(lock, isc_rwlocktype_read);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -4985,11 +5385,11 @@ rpz_attach(dns_db_t *db, dns_rpz_zones_t *rpzs, dns_rpz_num_t rpz_num) {
 	rbtdb = (dns_rbtdb_t *)db;
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	REQUIRE(rbtdb->rpzs == NULL && rbtdb->rpz_num == DNS_RPZ_INVALID_NUM);
 	dns_rpz_attach_rpzs(rpzs, &rbtdb->rpzs);
 	rbtdb->rpz_num = rpz_num;
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 }
 
 /*
@@ -5003,7 +5403,7 @@ rpz_ready(dns_db_t *db) {
 	rbtdb = (dns_rbtdb_t *)db;
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	if (rbtdb->rpzs == NULL) {
 		INSIST(rbtdb->rpz_num == DNS_RPZ_INVALID_NUM);
 		result = ISC_R_SUCCESS;
@@ -5011,7 +5411,7 @@ rpz_ready(dns_db_t *db) {
 		result = dns_rpz_ready(rbtdb->rpzs, &rbtdb->load_rpzs,
 				       rbtdb->rpz_num);
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	return (result);
 }
 
@@ -5057,7 +5457,7 @@ cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	update = NULL;
 	updatesig = NULL;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -5305,7 +5705,7 @@ cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -5365,7 +5765,7 @@ cache_findzonecut(dns_db_t *db, dns_name_t *name, unsigned int options,
 	if ((options & DNS_DBFIND_NOEXACT) != 0)
 		rbtoptions |= DNS_RBTFIND_NOEXACT;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.
@@ -5460,7 +5860,7 @@ cache_findzonecut(dns_db_t *db, dns_name_t *name, unsigned int options,
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	INSIST(!search.need_cleanup);
 
@@ -6747,14 +7147,14 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	INSIST(rbtversion == NULL || rbtversion->rbtdb == rbtdb);
 
 	if (rbtdb->common.methods == &zone_methods) {
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 		REQUIRE(((rbtnode->nsec == DNS_RBT_NSEC_NSEC3 &&
 			  (rdataset->type == dns_rdatatype_nsec3 ||
 			   rdataset->covers == dns_rdatatype_nsec3)) ||
 			 (rbtnode->nsec != DNS_RBT_NSEC_NSEC3 &&
 			   rdataset->type != dns_rdatatype_nsec3 &&
 			   rdataset->covers != dns_rdatatype_nsec3)));
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	}
 
 	if (rbtversion == NULL) {
@@ -6769,9 +7169,9 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		return (result);
 
 	name = dns_fixedname_initname(&fixed);
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	dns_rbt_fullnamefromnode(node, name);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	dns_rdataset_getownercase(rdataset, name);
 
 	newheader = (rdatasetheader_t *)region.base;
@@ -6847,7 +7247,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	/*
 	 * Add to the auxiliary NSEC tree if we're adding an NSEC record.
 	 */
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	if (rbtnode->nsec != DNS_RBT_NSEC_HAS_NSEC &&
 	    rdataset->type == dns_rdatatype_nsec)
 	{
@@ -6855,7 +7255,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	} else {
 		newnsec = false;
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * If we're adding a delegation type, adding to the auxiliary NSEC tree,
@@ -6867,7 +7267,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		cache_is_overmem = true;
 	if (delegating || newnsec || cache_is_overmem) {
 		tree_locked = true;
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	}
 
 	if (cache_is_overmem)
@@ -6896,7 +7296,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		 * node lock.
 		 */
 		if (tree_locked && !delegating && !newnsec) {
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 			tree_locked = false;
 		}
 	}
@@ -6927,7 +7327,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		    isc_rwlocktype_write);
 
 	if (tree_locked)
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	/*
 	 * Update the zone's secure status.  If version is non-NULL
@@ -6957,14 +7357,14 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	REQUIRE(rbtversion != NULL && rbtversion->rbtdb == rbtdb);
 
 	if (rbtdb->common.methods == &zone_methods) {
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 		REQUIRE(((rbtnode->nsec == DNS_RBT_NSEC_NSEC3 &&
 			  (rdataset->type == dns_rdatatype_nsec3 ||
 			   rdataset->covers == dns_rdatatype_nsec3)) ||
 			 (rbtnode->nsec != DNS_RBT_NSEC_NSEC3 &&
 			   rdataset->type != dns_rdatatype_nsec3 &&
 			   rdataset->covers != dns_rdatatype_nsec3)));
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	}
 
 	result = dns_rdataslab_fromrdataset(rdataset, rbtdb->common.mctx,
@@ -7457,31 +7857,94 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 	return (result);
 }
 
+/*
+ * Return the size of the slab of the rdataset header at 'p' in a map file
+ * image, or 0 if it does not end before 'limit'.  This is
+ * dns_rdataslab_size() for a slab that may be corrupt.
+ */
+static size_t
+image_slabsize(unsigned char *p, unsigned char *limit) {
+	unsigned char *current = p + sizeof(rdatasetheader_t);
+	unsigned int count, length;
+
+	if (limit - current < 2)
+		return (0);
+	count = *current++ * 256;
+	count += *current++;
+#if DNS_RDATASET_FIXED
+	if ((size_t)(limit - current) < 4 * count)
+		return (0);
+	current += (4 * count);
+#endif
+	while (count > 0) {
+		count--;
+		if (limit - current < 2)
+			return (0);
+		length = *current++ * 256;
+		length += *current++;
+#if DNS_RDATASET_FIXED
+		length += 2;
+#endif
+		if ((size_t)(limit - current) < length)
+			return (0);
+		current += length;
+	}
+
+	return ((size_t)(current - p));
+}
+
+/*
+ * Relocate and check the rdataset headers of a node in a map file image,
+ * and set up the run time state that depends on them.
+ */
 static isc_result_t
 rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 	      void *arg, uint64_t *crc)
 {
 	isc_result_t result;
-	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *) arg;
+	rbtdb_fixer_t *fixer = arg;
+	dns_rbtdb_t *rbtdb = fixer->rbtdb;
 	rdatasetheader_t *header;
 	unsigned char *limit = ((unsigned char *) base) + filesize;
 
 	REQUIRE(rbtnode != NULL);
 	REQUIRE(VALID_RBTDB(rbtdb));
 
+	if (rbtnode->locknum >= rbtdb->node_lock_count) {
+#ifdef DNS_RBT_USEHASH
+		rbtnode->locknum = rbtnode->hashval % rbtdb->node_lock_count;
+#else
+		dns_name_t name;
+
+		dns_name_init(&name, NULL);
+		dns_rbt_namefromnode(rbtnode, &name);
+		rbtnode->locknum = dns_name_hash(&name, true) %
+			rbtdb->node_lock_count;
+#endif
+	}
+
 	for (header = rbtnode->data; header != NULL; header = header->next) {
 		unsigned char *p = (unsigned char *) header;
-		size_t size = dns_rdataslab_size(p, sizeof(*header));
+		size_t size;
+
+		if (p < (unsigned char *) base ||
+		    p + sizeof(*header) > limit)
+		{
+			return (ISC_R_INVALIDFILE);
+		}
+		size = image_slabsize(p, limit);
+		if (size == 0)
+			return (ISC_R_INVALIDFILE);
 		isc_crc64_update(crc, p, size);
 #ifdef DEBUG
 		hexdump("hashing header", p, sizeof(rdatasetheader_t));
 		hexdump("hashing slab", p + sizeof(rdatasetheader_t),
 			size - sizeof(rdatasetheader_t));
 #endif
-		header->serial = 1;
-		header->is_mmapped = 1;
-		header->node = rbtnode;
-		header->node_is_relative = 0;
+		if (header->serial != 1 || header->is_mmapped != 1)
+			return (ISC_R_INVALIDFILE);
+		if (header->node != rbtnode)
+			header->node = rbtnode;
 
 		if (RESIGN(header) &&
 		    (header->resign != 0 || header->resign_lsb != 0))
@@ -7494,14 +7957,15 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 
 		if (header->next != NULL) {
 			size_t cooked = dns_rbt_serialize_align(size);
+			unsigned char *next = p + cooked;
+
 			if ((uintptr_t)header->next !=
-				    (p - (unsigned char *)base) + cooked)
+			    fixer->base + (uintptr_t)(next - (unsigned char *)base))
 				return (ISC_R_INVALIDFILE);
-			header->next = (rdatasetheader_t *)(p + cooked);
-			header->next_is_relative = 0;
-			if ((header->next < (rdatasetheader_t *) base) ||
-			    (header->next > (rdatasetheader_t *) limit))
+			if (next >= limit)
 				return (ISC_R_INVALIDFILE);
+			if (header->next != (rdatasetheader_t *)next)
+				header->next = (rdatasetheader_t *)next;
 		}
 		update_recordsandbytes(true, rbtdb->current_version, header);
 	}
@@ -7509,59 +7973,134 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Give every node of 'tree' that was loaded from a map file written for
+ * more node locks than 'rbtdb' has a lock number it can use.
+ */
+static isc_result_t
+fix_locknums(dns_rbtdb_t *rbtdb, dns_rbt_t *tree) {
+	dns_rbtnodechain_t chain;
+	dns_rbtnode_t *node;
+	isc_result_t result;
+
+	dns_rbtnodechain_init(&chain, rbtdb->common.mctx);
+	result = dns_rbtnodechain_first(&chain, tree, NULL, NULL);
+	while (result == ISC_R_SUCCESS || result == DNS_R_NEWORIGIN) {
+		node = NULL;
+		(void)dns_rbtnodechain_current(&chain, NULL, NULL, &node);
+		if (node->locknum >= rbtdb->node_lock_count) {
+#ifdef DNS_RBT_USEHASH
+			node->locknum = node->hashval %
+				rbtdb->node_lock_count;
+#else
+			dns_name_t name;
+
+			dns_name_init(&name, NULL);
+			dns_rbt_namefromnode(node, &name);
+			node->locknum = dns_name_hash(&name, true) %
+				rbtdb->node_lock_count;
+#endif
+		}
+		result = dns_rbtnodechain_next(&chain, NULL, NULL);
+	}
+	dns_rbtnodechain_invalidate(&chain);
+
+	if (result == ISC_R_NOMORE)
+		result = ISC_R_SUCCESS;
+	return (result);
+}
+
 /*
  * Load the RBT database from the image in 'f'
  */
 static isc_result_t
-deserialize32(void *arg, FILE *f, off_t offset) {
+deserialize32(void *arg, FILE *f, off_t offset, unsigned int options) {
 	isc_result_t result;
 	rbtdb_load_t *loadctx = arg;
 	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
-	rbtdb_file_header_t *header;
+	rbtdb_file_header_t header;
+	rbtdb_fixer_t fixer;
+	dns_rbtdatafixer_t datafixer = NULL;
+	bool fixlocks, trusted;
 	int fd;
 	off_t filesize = 0;
-	char *base;
+	char *base, *hint;
 	dns_rbt_t *tree = NULL, *nsec = NULL, *nsec3 = NULL;
 	int protect, flags;
-	dns_rbtnode_t *origin_node = NULL;
+	dns_rbtnode_t *origin_node = NULL, *nsec3_origin_node = NULL;
+	rbtdb_version_t *version;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
 	/*
-	 * TODO CKB: since this is read-write (had to be to add nodes later)
-	 * we will need to lock the file or the nodes in it before modifying
-	 * the nodes in the file.
+	 * The header says where the image wants to be mapped, so it is
+	 * read before the file is mapped in.
 	 */
+	CHECK(isc_stdio_seek(f, offset, SEEK_SET));
+	CHECK(isc_stdio_read(&header, 1, sizeof(header), f, NULL));
+	if (!match_header_version(&header) ||
+	    header.headersize != (uint32_t) sizeof(rdatasetheader_t))
+	{
+		return (ISC_R_INVALIDFILE);
+	}
 
-	/* Map in the whole file in one go */
+	/*
+	 * The mapping is private and writable: pages are shared with the
+	 * page cache, and with other processes that map the same file,
+	 * until something is changed in them.
+	 */
 	fd = fileno(f);
-	isc_file_getsizefd(fd, &filesize);
+	CHECK(isc_file_getsizefd(fd, &filesize));
+	if (header.size > (uint64_t) filesize ||
+	    header.tree >= header.size || header.nsec >= header.size ||
+	    header.nsec3 >= header.size)
+	{
+		return (ISC_R_INVALIDFILE);
+	}
 	protect = PROT_READ|PROT_WRITE;
 	flags = MAP_PRIVATE;
 #ifdef MAP_FILE
 	flags |= MAP_FILE;
 #endif
 
-	base = isc_file_mmap(NULL, filesize, protect, flags, fd, 0);
+	hint = (char *)(uintptr_t) header.base;
+	if ((uint64_t)(uintptr_t) hint != header.base)
+		hint = NULL;
+	base = isc_file_mmap(hint, filesize, protect, flags, fd, 0);
 	if (base == NULL || base == MAP_FAILED) {
 		return (ISC_R_FAILURE);
 	}
 
-	header = (rbtdb_file_header_t *)(base + offset);
-	if (!match_header_version(header)) {
-		result = ISC_R_INVALIDFILE;
-		goto cleanup;
-	}
-
-	if (header->tree != 0) {
+	/*
+	 * Every node is walked and checked against the image's CRC, and
+	 * relocated if needed, unless the loader said the file can be
+	 * trusted.  Even then the walk is needed if the image has to be
+	 * relocated, records have to be added to the resign heaps, or it
+	 * was written for more node locks than this database has.
+	 */
+	fixer.rbtdb = rbtdb;
+	fixer.base = (uintptr_t) header.base;
+	fixlocks = (header.nodelocks > rbtdb->node_lock_count);
+	trusted = ((options & DNS_MASTER_MAPTRUSTED) != 0 &&
+		   (uintptr_t) base == fixer.base && header.resigns == 0 &&
+		   !fixlocks);
+	if (!trusted)
+		datafixer = rbt_datafixer;
+
+	if (header.tree != 0) {
 		result = dns_rbt_deserialize_tree(base, filesize,
-						  (off_t) header->tree,
+						  (off_t) header.tree,
 						  rbtdb->common.mctx,
 						  delete_callback, rbtdb,
-						  rbt_datafixer, rbtdb,
+						  datafixer, &fixer, trusted,
 						  NULL, &tree);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
+		if (fixlocks) {
+			result = fix_locknums(rbtdb, tree);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup;
+		}
 
 		result = dns_rbt_findnode(tree, &rbtdb->common.origin, NULL,
 					  &origin_node, NULL,
@@ -7570,26 +8109,42 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 			goto cleanup;
 	}
 
-	if (header->nsec != 0) {
+	if (header.nsec != 0) {
 		result = dns_rbt_deserialize_tree(base, filesize,
-						  (off_t) header->nsec,
+						  (off_t) header.nsec,
 						  rbtdb->common.mctx,
 						  delete_callback, rbtdb,
-						  rbt_datafixer, rbtdb,
+						  datafixer, &fixer, trusted,
 						  NULL, &nsec);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
+		if (fixlocks) {
+			result = fix_locknums(rbtdb, nsec);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup;
+		}
 	}
 
-	if (header->nsec3 != 0) {
+	if (header.nsec3 != 0) {
 		result = dns_rbt_deserialize_tree(base, filesize,
-						  (off_t) header->nsec3,
+						  (off_t) header.nsec3,
 						  rbtdb->common.mctx,
 						  delete_callback, rbtdb,
-						  rbt_datafixer, rbtdb,
+						  datafixer, &fixer, trusted,
 						  NULL, &nsec3);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
+		if (fixlocks) {
+			result = fix_locknums(rbtdb, nsec3);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup;
+		}
+
+		result = dns_rbt_findnode(nsec3, &rbtdb->common.origin, NULL,
+					  &nsec3_origin_node, NULL,
+					  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
 	}
 
 	/*
@@ -7600,6 +8155,14 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	rbtdb->mmap_location = base;
 	rbtdb->mmap_size = (size_t) filesize;
 
+	if (trusted) {
+		version = rbtdb->current_version;
+		RWLOCK(&version->rwlock, isc_rwlocktype_write);
+		version->records += header.records;
+		version->bytes += header.bytes;
+		RWUNLOCK(&version->rwlock, isc_rwlocktype_write);
+	}
+
 	if (tree != NULL) {
 		dns_rbt_destroy(&rbtdb->tree);
 		rbtdb->tree = tree;
@@ -7614,6 +8177,7 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	if (nsec3 != NULL) {
 		dns_rbt_destroy(&rbtdb->nsec3);
 		rbtdb->nsec3 = nsec3;
+		rbtdb->nsec3_origin_node = nsec3_origin_node;
 	}
 
 	return (ISC_R_SUCCESS);
@@ -7627,6 +8191,9 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 		dns_rbt_destroy(&nsec3);
 	isc_file_munmap(base, (size_t) filesize);
 	return (result);
+
+ failure:
+	return (result);
 }
 
 static isc_result_t
@@ -7717,68 +8284,111 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Return the version of the rdataset at 'header' that is visible in the
+ * version 'serial', or NULL if there is none.
+ */
+static inline rdatasetheader_t *
+visible_header(rdatasetheader_t *header, rbtdb_serial_t serial) {
+	do {
+		if (header->serial <= serial && !IGNORE(header)) {
+			if (NONEXISTENT(header))
+				return (NULL);
+			return (header);
+		}
+		header = header->down;
+	} while (header != NULL);
+
+	return (NULL);
+}
+
 /*
  * helper function to handle writing out the rdataset data pointed to
  * by the void *data pointer in the dns_rbtnode
  */
 static isc_result_t
 rbt_datawriter(FILE *rbtfile, unsigned char *data, void *arg,
-	       uint64_t *crc)
+	       uintptr_t node, uint64_t *crc)
 {
-	rbtdb_version_t *version = (rbtdb_version_t *) arg;
+	rbtdb_writer_t *writer = (rbtdb_writer_t *) arg;
 	rbtdb_serial_t serial;
 	rdatasetheader_t newheader;
-	rdatasetheader_t *header = (rdatasetheader_t *) data, *next;
+	rdatasetheader_t *header, *next;
 	off_t where;
 	size_t cooked, size;
 	unsigned char *p;
 	isc_result_t result = ISC_R_SUCCESS;
 	char pad[sizeof(char *)];
-	uintptr_t off;
+	unsigned int count = 0;
 
 	REQUIRE(rbtfile != NULL);
 	REQUIRE(data != NULL);
-	REQUIRE(version != NULL);
+	REQUIRE(writer != NULL && writer->version != NULL);
 
-	serial = version->serial;
+	serial = writer->version->serial;
 
-	for (; header != NULL; header = next) {
-		next = header->next;
-		do {
-			if (header->serial <= serial && !IGNORE(header)) {
-				if (NONEXISTENT(header))
-					header = NULL;
-				break;
-			} else
-				header = header->down;
-		} while (header != NULL);
+	/*
+	 * Find the version of each rdataset that is to be written.  Only
+	 * these are written, one after the other, so that 'next' can be
+	 * set to where the following one will be.
+	 */
+	for (header = (rdatasetheader_t *) data;
+	     header != NULL;
+	     header = header->next)
+	{
+		if (visible_header(header, serial) != NULL)
+			count++;
+	}
 
-		if (header == NULL)
+	for (header = (rdatasetheader_t *) data; header != NULL; header = next)
+	{
+		rdatasetheader_t *current;
+
+		next = header->next;
+		current = visible_header(header, serial);
+		if (current == NULL)
 			continue;
 
 		CHECK(isc_stdio_tell(rbtfile, &where));
-		size = dns_rdataslab_size((unsigned char *) header,
+		size = dns_rdataslab_size((unsigned char *) current,
 					  sizeof(rdatasetheader_t));
 
-		p = (unsigned char *) header;
-		memmove(&newheader, p, sizeof(rdatasetheader_t));
-		newheader.down = NULL;
-		newheader.next = NULL;
-		off = where;
-		if ((off_t)off != where)
-			return (ISC_R_RANGE);
-		newheader.node = (dns_rbtnode_t *) off;
-		newheader.node_is_relative = 1;
-		newheader.serial = 1;
-
 		/*
 		 * Round size up to the next pointer sized offset so it
 		 * will be properly aligned when read back in.
 		 */
 		cooked = dns_rbt_serialize_align(size);
-		if (next != NULL) {
-			newheader.next = (rdatasetheader_t *) (off + cooked);
-			newheader.next_is_relative = 1;
+
+		/*
+		 * Write the header as it will be when the image is mapped
+		 * at its base address, without any of the state it has
+		 * while it is in use.
+		 */
+		p = (unsigned char *) current;
+		memmove(&newheader, p, sizeof(rdatasetheader_t));
+		newheader.down = NULL;
+		newheader.next = NULL;
+		if (--count != 0)
+			newheader.next = (rdatasetheader_t *)
+				(writer->base + (uintptr_t)(where + cooked));
+		newheader.node = (dns_rbtnode_t *) node;
+		newheader.is_mmapped = 1;
+		newheader.serial = 1;
+		newheader.noqname = NULL;
+		newheader.closest = NULL;
+		newheader.additional_auth = NULL;
+		newheader.additional_glue = NULL;
+		newheader.count = 0;
+		newheader.heap_index = 0;
+		ISC_LINK_INIT(&newheader, link);
+
+		writer->records += dns_rdataslab_count(p,
+						sizeof(rdatasetheader_t));
+		writer->bytes += size;
+		if (RESIGN(current) &&
+		    (current->resign != 0 || current->resign_lsb != 0))
+		{
+			writer->resigns++;
 		}
 
 #ifdef DEBUG
@@ -7848,7 +8458,8 @@ init_file_version(void) {
  */
 static isc_result_t
 rbtdb_write_header(FILE *rbtfile, off_t tree_location, off_t nsec_location,
-		   off_t nsec3_location)
+		   off_t nsec3_location, off_t end_location,
+		   dns_rbtdb_t *rbtdb, rbtdb_writer_t *writer)
 {
 	rbtdb_file_header_t header;
 	isc_result_t result;
@@ -7863,6 +8474,13 @@ rbtdb_write_header(FILE *rbtfile, off_t tree_location, off_t nsec_location,
 	header.tree = (uint64_t) tree_location;
 	header.nsec = (uint64_t) nsec_location;
 	header.nsec3 = (uint64_t) nsec3_location;
+	header.base = (uint64_t) writer->base;
+	header.size = (uint64_t) end_location;
+	header.records = writer->records;
+	header.bytes = writer->bytes;
+	header.resigns = writer->resigns;
+	header.nodelocks = rbtdb->node_lock_count;
+	header.headersize = (uint32_t) sizeof(rdatasetheader_t);
 	result = isc_stdio_write(&header, 1, sizeof(rbtdb_file_header_t),
 			      rbtfile, NULL);
 	fflush(rbtfile);
@@ -7891,6 +8509,11 @@ serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
 	dns_rbtdb_t *rbtdb;
 	isc_result_t result;
 	off_t tree_location, nsec_location, nsec3_location, header_location;
+	off_t end_location;
+	rbtdb_writer_t writer;
+#ifdef RBTDB_MAP_BASE
+	uint32_t r;
+#endif
 
 	rbtdb = (dns_rbtdb_t *)db;
 
@@ -7900,6 +8523,21 @@ serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
 	/* Ensure we're writing to a plain file */
 	CHECK(isc_file_isplainfilefd(fileno(rbtfile)));
 
+	/*
+	 * Choose the address the image is to be mapped at.  Where there
+	 * is no room for that, the image is always relocated when it is
+	 * loaded.
+	 */
+	memset(&writer, 0, sizeof(writer));
+	writer.version = version;
+#ifdef RBTDB_MAP_BASE
+	isc_random_get(&r);
+	writer.base = RBTDB_MAP_BASE +
+		(r % (RBTDB_MAP_RANGE / RBTDB_MAP_ALIGN)) * RBTDB_MAP_ALIGN;
+#else
+	writer.base = 0;
+#endif
+
 	/*
 	 * first, write out a zeroed header to store rbtdb information
 	 *
@@ -7915,15 +8553,17 @@ serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
 	CHECK(isc_stdio_tell(rbtfile, &header_location));
 	CHECK(rbtdb_zero_header(rbtfile));
 	CHECK(dns_rbt_serialize_tree(rbtfile, rbtdb->tree, rbt_datawriter,
-				     version, &tree_location));
+				     &writer, writer.base, &tree_location));
 	CHECK(dns_rbt_serialize_tree(rbtfile, rbtdb->nsec, rbt_datawriter,
-				     version, &nsec_location));
+				     &writer, writer.base, &nsec_location));
 	CHECK(dns_rbt_serialize_tree(rbtfile, rbtdb->nsec3, rbt_datawriter,
-				     version, &nsec3_location));
+				     &writer, writer.base, &nsec3_location));
+	CHECK(isc_stdio_tell(rbtfile, &end_location));
 
 	CHECK(isc_stdio_seek(rbtfile, header_location, SEEK_SET));
 	CHECK(rbtdb_write_header(rbtfile, tree_location, nsec_location,
-				 nsec3_location));
+				 nsec3_location, end_location, rbtdb,
+				 &writer));
  failure:
 	return (result);
 }
@@ -8003,9 +8643,9 @@ nodecount(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	count = dns_rbt_nodecount(rbtdb->tree);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (count);
 }
@@ -8019,13 +8659,39 @@ hashsize(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	size = dns_rbt_hashsize(rbtdb->tree);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (size);
 }
 
+static void
+adjusthashsize(dns_db_t *db, unsigned int nodecount) {
+	dns_rbtdb_t *rbtdb;
+
+	rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	dns_rbt_adjusthashsize(rbtdb->tree, nodecount);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+}
+
+static unsigned int
+nodelockstats(dns_db_t *db, uint64_t *waits, unsigned int count) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	unsigned int i;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+
+	for (i = 0; i < count && i < rbtdb->node_lock_count; i++)
+		waits[i] = NODE_WAITS(rbtdb->node_locks[i].waits);
+
+	return (rbtdb->node_lock_count);
+}
+
 static void
 settask(dns_db_t *db, isc_task_t *task) {
 	dns_rbtdb_t *rbtdb;
@@ -8206,7 +8872,7 @@ getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	for (i = 0; i < rbtdb->node_lock_count; i++) {
 		NODE_LOCK(&rbtdb->node_locks[i].lock, isc_rwlocktype_read);
@@ -8242,7 +8908,7 @@ getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 	result = ISC_R_SUCCESS;
 
  unlock:
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (result);
 }
@@ -8272,7 +8938,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	if (header->heap_index == 0)
 		return;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	NODE_LOCK(&rbtdb->node_locks[node->locknum].lock,
 		  isc_rwlocktype_write);
 	/*
@@ -8282,7 +8948,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	resign_delete(rbtdb, rbtversion, header);
 	NODE_UNLOCK(&rbtdb->node_locks[node->locknum].lock,
 		    isc_rwlocktype_write);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 }
 
 static isc_result_t
@@ -8317,9 +8983,9 @@ nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
 	REQUIRE(node != NULL);
 	REQUIRE(name != NULL);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	result = dns_rbt_fullnamefromnode(rbtnode, name);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (result);
 }
@@ -8369,7 +9035,9 @@ static dns_dbmethods_t zone_methods = {
 	NULL,
 	hashsize,
 	nodefullname,
-	getsize
+	getsize,
+	adjusthashsize,
+	nodelockstats
 };
 
 static dns_dbmethods_t cache_methods = {
@@ -8417,9 +9085,31 @@ static dns_dbmethods_t cache_methods = {
 	setcachestats,
 	hashsize,
 	nodefullname,
-	NULL
+	NULL,
+	adjusthashsize,
+	nodelockstats
 };
 
+/*%
+ * Pick a node lock count.  Caches get two locks per CPU, but never
+ * fewer than the historical default and no more than
+ * MAX_CACHE_NODE_LOCK_COUNT since too many stripes make LRU cleaning
+ * less effective.  Zones keep DEFAULT_NODE_LOCK_COUNT: every zone
+ * allocates its own locks, so a server with many zones would pay for
+ * more of them many times over.
+ */
+static unsigned int
+default_node_lock_count(bool cache) {
+	unsigned int count;
+
+	if (!cache)
+		return (DEFAULT_NODE_LOCK_COUNT);
+
+	count = ISC_MAX(DEFAULT_CACHE_NODE_LOCK_COUNT, isc_os_ncpus() * 2);
+	return (ISC_MIN(count, ISC_MAX(MAX_CACHE_NODE_LOCK_COUNT,
+				       DEFAULT_CACHE_NODE_LOCK_COUNT)));
+}
+
 isc_result_t
 #ifdef DNS_RBTDB_VERSION64
 dns_rbtdb64_create
@@ -8470,21 +9160,19 @@ dns_rbtdb_create
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_rbtdb;
 
-	result = isc_rwlock_init(&rbtdb->tree_lock, 0, 0);
+	result = TREE_INITLOCK(mctx, &rbtdb->tree_lock, !IS_CACHE(rbtdb));
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_lock;
 
 	/*
-	 * Initialize node_lock_count in a generic way to support future
-	 * extension which allows the user to specify this value on creation.
-	 * Note that when specified for a cache DB it must be larger than 1
-	 * as commented with the definition of DEFAULT_CACHE_NODE_LOCK_COUNT.
+	 * Use the node lock count set with dns_db_setnodelockcount(), or
+	 * the default for the database type.  Note that when specified for
+	 * a cache DB it must be larger than 1 as commented with the
+	 * definition of DEFAULT_CACHE_NODE_LOCK_COUNT.
 	 */
+	rbtdb->node_lock_count = dns_db_getnodelockcount(type);
 	if (rbtdb->node_lock_count == 0) {
-		if (IS_CACHE(rbtdb))
-			rbtdb->node_lock_count = DEFAULT_CACHE_NODE_LOCK_COUNT;
-		else
-			rbtdb->node_lock_count = DEFAULT_NODE_LOCK_COUNT;
+		rbtdb->node_lock_count = default_node_lock_count(IS_CACHE(rbtdb));
 	} else if (rbtdb->node_lock_count < 2 && IS_CACHE(rbtdb)) {
 		result = ISC_R_RANGE;
 		goto cleanup_tree_lock;
@@ -8562,6 +9250,7 @@ dns_rbtdb_create
 			goto cleanup_deadnodes;
 		}
 		rbtdb->node_locks[i].exiting = false;
+		rbtdb->node_locks[i].waits = 0;
 	}
 
 	/*
@@ -8764,7 +9453,7 @@ dns_rbtdb_create
 		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
 
  cleanup_tree_lock:
-	isc_rwlock_destroy(&rbtdb->tree_lock);
+	TREE_DESTROYLOCK(mctx, &rbtdb->tree_lock);
 
  cleanup_lock:
 	RBTDB_DESTROYLOCK(&rbtdb->lock);
@@ -9280,10 +9969,10 @@ flush_deletions(rbtdb_dbiterator_t *rbtdbiter) {
 			      dns_rbt_nodecount(rbtdb->tree));
 
 		if (rbtdbiter->tree_locked == isc_rwlocktype_read) {
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 			was_read_locked = true;
 		}
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 		rbtdbiter->tree_locked = isc_rwlocktype_write;
 
 		for (i = 0; i < rbtdbiter->delcnt; i++) {
@@ -9299,9 +9988,9 @@ flush_deletions(rbtdb_dbiterator_t *rbtdbiter) {
 
 		rbtdbiter->delcnt = 0;
 
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 		if (was_read_locked) {
-			RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+			TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 			rbtdbiter->tree_locked = isc_rwlocktype_read;
 
 		} else {
@@ -9317,7 +10006,7 @@ resume_iteration(rbtdb_dbiterator_t *rbtdbiter) {
 	REQUIRE(rbtdbiter->paused);
 	REQUIRE(rbtdbiter->tree_locked == isc_rwlocktype_none);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	rbtdbiter->tree_locked = isc_rwlocktype_read;
 
 	rbtdbiter->paused = false;
@@ -9330,7 +10019,7 @@ dbiterator_destroy(dns_dbiterator_t **iteratorp) {
 	dns_db_t *db = NULL;
 
 	if (rbtdbiter->tree_locked == isc_rwlocktype_read) {
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 		rbtdbiter->tree_locked = isc_rwlocktype_none;
 	} else
 		INSIST(rbtdbiter->tree_locked == isc_rwlocktype_none);
@@ -9706,7 +10395,7 @@ dbiterator_pause(dns_dbiterator_t *iterator) {
 
 	if (rbtdbiter->tree_locked != isc_rwlocktype_none) {
 		INSIST(rbtdbiter->tree_locked == isc_rwlocktype_read);
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 		rbtdbiter->tree_locked = isc_rwlocktype_none;
 	}
 
@@ -29,6 +29,14 @@
 #include <isc/timer.h>
 #include <isc/util.h>
 
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#if defined(__cplusplus)
+#include <isc/stdatomic.h>
+#else
+#include <stdatomic.h>
+#endif
+#endif
+
 #include <dns/acl.h>
 #include <dns/adb.h>
 #include <dns/badcache.h>
@@ -178,6 +186,51 @@
 #endif
 #define RES_NOBUCKET		0xffffffff
 
+/*%
+ * Each fetch context bucket hashes its fetch contexts into a table of
+ * chains, starting with 2^FCTX_HASHBITS_MIN chains and doubling whenever
+ * the average chain would exceed FCTX_CHAINLEN, so that finding a fetch
+ * to join stays cheap when a bucket fills up during a cold-cache storm.
+ *
+ * The bucket is chosen with the hash value modulo the number of buckets,
+ * so the chain is chosen with what is left of it.  Every fetch context
+ * in a bucket has the same remainder, and if the number of buckets is a
+ * power of two, the same low bits.
+ */
+#define FCTX_HASHBITS_MIN	3
+#define FCTX_HASHBITS_MAX	16
+#define FCTX_CHAINLEN		2U
+#define FCTX_CHAIN(r, b, h, t) \
+	(&(b)->table[(((h) / (r)->nbuckets) ^ (t)) & \
+		     ((1U << (b)->hashbits) - 1)])
+
+/*%
+ * Buckets share this many memory contexts, so that threads working on
+ * different buckets rarely contend for one without every bucket of
+ * every view having a context of its own.
+ */
+#ifndef RES_BUCKET_MCTXS
+#define RES_BUCKET_MCTXS	8
+#endif
+
+/*%
+ * The clients-per-query limits are read by every fetch creation; where
+ * possible they are atomic so that does not take the resolver lock.
+ * They are only changed with the resolver lock held.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && defined(ISC_PLATFORM_HAVESTDATOMIC)
+#define SPILL_ATOMIC		1
+typedef atomic_uint_fast32_t	spill_t;
+#define SPILL_GET(v) \
+	((unsigned int)atomic_load_explicit(&(v), memory_order_relaxed))
+#define SPILL_SET(v, n) \
+	atomic_store_explicit(&(v), (n), memory_order_relaxed)
+#else
+typedef unsigned int		spill_t;
+#define SPILL_GET(v)		(v)
+#define SPILL_SET(v, n)		((v) = (n))
+#endif
+
 /*%
  * Maximum EDNS0 input packet size.
  */
@@ -261,6 +314,7 @@ struct fetchctx {
 	unsigned int			options;
 	unsigned int			bucketnum;
 	unsigned int			dbucketnum;
+	unsigned int			hashval;
 	char *				info;
 	isc_mem_t *			mctx;
 
@@ -273,6 +327,7 @@ struct fetchctx {
 	unsigned int			references;
 	isc_event_t			control_event;
 	ISC_LINK(struct fetchctx)       link;
+	ISC_LINK(struct fetchctx)       hlink;
 	ISC_LIST(dns_fetchevent_t)      events;
 	/*% Locked by task event serialization. */
 	dns_name_t			domain;
@@ -415,10 +470,17 @@ struct dns_fetch {
 #define DNS_FETCH_MAGIC			ISC_MAGIC('F', 't', 'c', 'h')
 #define DNS_FETCH_VALID(fetch)		ISC_MAGIC_VALID(fetch, DNS_FETCH_MAGIC)
 
+typedef ISC_LIST(fetchctx_t) fctxlist_t;
+
 typedef struct fctxbucket {
 	isc_task_t *			task;
 	isc_mutex_t			lock;
-	ISC_LIST(fetchctx_t)		fctxs;
+	fctxlist_t			fctxs;
+	fctxlist_t *			table;
+	unsigned int			hashbits;
+	unsigned int			count;
+	unsigned int			highwater;
+	unsigned int			chainmax;
 	bool			exiting;
 	isc_mem_t *			mctx;
 } fctxbucket_t;
@@ -490,7 +552,7 @@ struct dns_resolver {
 #endif
 	dns_rbt_t *			mustbesecure;
 	unsigned int			spillatmax;
-	unsigned int			spillatmin;
+	spill_t				spillatmin;
 	isc_timer_t *			spillattimer;
 	bool				zero_no_soa_ttl;
 	unsigned int			query_timeout;
@@ -507,7 +569,7 @@ struct dns_resolver {
 	isc_eventlist_t			whenshutdown;
 	unsigned int			activebuckets;
 	bool				priming;
-	unsigned int			spillat;	/* clients-per-query */
+	spill_t				spillat;	/* clients-per-query */
 
 	dns_badcache_t  * 		badcache;	 /* Bad cache. */
 
@@ -595,6 +657,69 @@ dec_stats(dns_resolver_t *res, isc_statscounter_t counter) {
 		isc_stats_decrement(res->view->resstats, counter);
 }
 
+static inline void
+max_stats(dns_resolver_t *res, isc_statscounter_t counter, uint64_t value) {
+	if (res->view->resstats != NULL)
+		isc_stats_update_if_greater(res->view->resstats, counter,
+					    value);
+}
+
+/*
+ * Lock a fetch context bucket, recording in the resolver statistics
+ * whether, and for how long, we had to wait for it.
+ */
+static inline void
+bucket_lock(dns_resolver_t *res, fctxbucket_t *bucket) {
+	isc_time_t start, now;
+
+	if (isc_mutex_trylock(&bucket->lock) == ISC_R_SUCCESS)
+		return;
+
+	TIME_NOW(&start);
+	LOCK(&bucket->lock);
+	TIME_NOW(&now);
+
+	inc_stats(res, dns_resstatscounter_bucketwait);
+	max_stats(res, dns_resstatscounter_bucketwaitmax,
+		  isc_time_microdiff(&now, &start));
+}
+
+/*
+ * Double the number of hash chains in 'bucket'.  If memory is short
+ * the current table is kept.
+ *
+ * Caller must be holding the bucket lock.
+ */
+static void
+bucket_grow(dns_resolver_t *res, fctxbucket_t *bucket) {
+	fctxlist_t *table, *oldtable;
+	unsigned int i, oldsize;
+	fetchctx_t *fctx;
+
+	oldtable = bucket->table;
+	oldsize = 1U << bucket->hashbits;
+
+	table = isc_mem_get(bucket->mctx, 2 * oldsize * sizeof(*table));
+	if (table == NULL)
+		return;
+	for (i = 0; i < 2 * oldsize; i++)
+		ISC_LIST_INIT(table[i]);
+
+	bucket->table = table;
+	bucket->hashbits++;
+	for (i = 0; i < oldsize; i++) {
+		while ((fctx = ISC_LIST_HEAD(oldtable[i])) != NULL) {
+			ISC_LIST_UNLINK(oldtable[i], fctx, hlink);
+			ISC_LIST_APPEND(*FCTX_CHAIN(res, bucket,
+						    fctx->hashval,
+						    fctx->type),
+					fctx, hlink);
+		}
+	}
+
+	isc_mem_put(bucket->mctx, oldtable, oldsize * sizeof(*oldtable));
+}
+
 static isc_result_t
 valcreate(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo, dns_name_t *name,
 	  dns_rdatatype_t type, dns_rdataset_t *rdataset,
@@ -1410,13 +1535,13 @@ fctx_sendevents(fetchctx_t *fctx, isc_result_t result, int line) {
 	    fctx->spilled &&
 	    (count < fctx->res->spillatmax || fctx->res->spillatmax == 0)) {
 		LOCK(&fctx->res->lock);
-		if (count == fctx->res->spillat && !fctx->res->exiting) {
-			old_spillat = fctx->res->spillat;
-			fctx->res->spillat += 5;
-			if (fctx->res->spillat > fctx->res->spillatmax &&
+		old_spillat = SPILL_GET(fctx->res->spillat);
+		if (count == old_spillat && !fctx->res->exiting) {
+			new_spillat = old_spillat + 5;
+			if (new_spillat > fctx->res->spillatmax &&
 			    fctx->res->spillatmax != 0)
-				fctx->res->spillat = fctx->res->spillatmax;
-			new_spillat = fctx->res->spillat;
+				new_spillat = fctx->res->spillatmax;
+			SPILL_SET(fctx->res->spillat, new_spillat);
 			if (new_spillat != old_spillat) {
 				logit = true;
 			}
@@ -3879,6 +4004,11 @@ fctx_unlink(fetchctx_t *fctx) {
 	bucketnum = fctx->bucketnum;
 
 	ISC_LIST_UNLINK(res->buckets[bucketnum].fctxs, fctx, link);
+	ISC_LIST_UNLINK(*FCTX_CHAIN(res, &res->buckets[bucketnum],
+				    fctx->hashval, fctx->type),
+			fctx, hlink);
+	INSIST(res->buckets[bucketnum].count > 0);
+	res->buckets[bucketnum].count--;
 
 	LOCK(&res->nlock);
 	res->nfctx--;
@@ -4279,10 +4409,13 @@ static isc_result_t
 fctx_create(dns_resolver_t *res, dns_name_t *name, dns_rdatatype_t type,
 	    dns_name_t *domain, dns_rdataset_t *nameservers,
 	    const isc_sockaddr_t *client, unsigned int options,
-	    unsigned int bucketnum, unsigned int depth, isc_counter_t *qc,
-	    fetchctx_t **fctxp)
+	    unsigned int hashval, unsigned int bucketnum, unsigned int depth,
+	    isc_counter_t *qc, fetchctx_t **fctxp)
 {
-	fetchctx_t *fctx;
+	fctxbucket_t *bucket = &res->buckets[bucketnum];
+	fctxlist_t *chain;
+	fetchctx_t *fctx, *f;
+	unsigned int chainlen;
 	isc_result_t result;
 	isc_result_t iresult;
 	isc_interval_t interval;
@@ -4345,6 +4478,7 @@ fctx_create(dns_resolver_t *res, dns_name_t *name, dns_rdatatype_t type,
 	fctx->references = 0;
 	fctx->bucketnum = bucketnum;
 	fctx->dbucketnum = RES_NOBUCKET;
+	fctx->hashval = hashval;
 	fctx->state = fetchstate_init;
 	fctx->want_shutdown = false;
 	fctx->cloned = false;
@@ -4540,9 +4674,26 @@ fctx_create(dns_resolver_t *res, dns_name_t *name, dns_rdatatype_t type,
 
 	ISC_LIST_INIT(fctx->events);
 	ISC_LINK_INIT(fctx, link);
+	ISC_LINK_INIT(fctx, hlink);
 	fctx->magic = FCTX_MAGIC;
 
-	ISC_LIST_APPEND(res->buckets[bucketnum].fctxs, fctx, link);
+	ISC_LIST_APPEND(bucket->fctxs, fctx, link);
+	if (bucket->count >= (FCTX_CHAINLEN << bucket->hashbits) &&
+	    bucket->hashbits < FCTX_HASHBITS_MAX)
+		bucket_grow(res, bucket);
+	chain = FCTX_CHAIN(res, bucket, hashval, type);
+	ISC_LIST_APPEND(*chain, fctx, hlink);
+	if (++bucket->count > bucket->highwater) {
+		bucket->highwater = bucket->count;
+		max_stats(res, dns_resstatscounter_bucketmax, bucket->count);
+	}
+	chainlen = 0;
+	for (f = ISC_LIST_HEAD(*chain); f != NULL; f = ISC_LIST_NEXT(f, hlink))
+		chainlen++;
+	if (chainlen > bucket->chainmax) {
+		bucket->chainmax = chainlen;
+		max_stats(res, dns_resstatscounter_chainmax, chainlen);
+	}
 
 	LOCK(&res->nlock);
 	res->nfctx++;
@@ -8818,9 +8969,13 @@ destroy(dns_resolver_t *res) {
 	DESTROYLOCK(&res->lock);
 	for (i = 0; i < res->nbuckets; i++) {
 		INSIST(ISC_LIST_EMPTY(res->buckets[i].fctxs));
+		INSIST(res->buckets[i].count == 0);
 		isc_task_shutdown(res->buckets[i].task);
 		isc_task_detach(&res->buckets[i].task);
 		DESTROYLOCK(&res->buckets[i].lock);
+		isc_mem_put(res->buckets[i].mctx, res->buckets[i].table,
+			    (1U << res->buckets[i].hashbits) *
+			    sizeof(fctxlist_t));
 		isc_mem_detach(&res->buckets[i].mctx);
 	}
 	isc_mem_put(res->mctx, res->buckets,
@@ -8904,17 +9059,17 @@ spillattimer_countdown(isc_task_t *task, isc_event_t *event) {
 
 	LOCK(&res->lock);
 	INSIST(!res->exiting);
-	if (res->spillat > res->spillatmin) {
-		res->spillat--;
+	count = SPILL_GET(res->spillat);
+	if (count > SPILL_GET(res->spillatmin)) {
+		SPILL_SET(res->spillat, --count);
 		logit = true;
 	}
-	if (res->spillat <= res->spillatmin) {
+	if (count <= SPILL_GET(res->spillatmin)) {
 		result = isc_timer_reset(res->spillattimer,
 					 isc_timertype_inactive, NULL,
 					 NULL, true);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
-	count = res->spillat;
 	UNLOCK(&res->lock);
 	if (logit)
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RESOLVER,
@@ -8938,7 +9093,7 @@ dns_resolver_create(dns_view_t *view,
 {
 	dns_resolver_t *res;
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int i, buckets_created = 0, dbuckets_created = 0;
+	unsigned int i, j, buckets_created = 0, dbuckets_created = 0;
 	isc_task_t *task = NULL;
 	char name[16];
 	unsigned dispattr;
@@ -8978,7 +9133,8 @@ dns_resolver_create(dns_view_t *view,
 		goto cleanup_res;
 	}
 	res->mustbesecure = NULL;
-	res->spillatmin = res->spillat = 10;
+	SPILL_SET(res->spillatmin, 10);
+	SPILL_SET(res->spillat, 10);
 	res->spillatmax = 100;
 	res->spillattimer = NULL;
 	res->zspill = 0;
@@ -9013,20 +9169,42 @@ dns_resolver_create(dns_view_t *view,
 		snprintf(name, sizeof(name), "res%u", i);
 #ifdef ISC_PLATFORM_USETHREADS
 		/*
-		 * Use a separate memory context for each bucket to reduce
-		 * contention among multiple threads.  Do this only when
-		 * enabling threads because it will be require more memory.
+		 * Use separate memory contexts for the buckets to reduce
+		 * contention among multiple threads, sharing each among
+		 * several buckets.  Do this only when enabling threads
+		 * because it will be require more memory.
 		 */
-		result = isc_mem_create(0, 0, &res->buckets[i].mctx);
-		if (result != ISC_R_SUCCESS) {
-			isc_task_detach(&res->buckets[i].task);
-			DESTROYLOCK(&res->buckets[i].lock);
-			goto cleanup_buckets;
+		if (i >= RES_BUCKET_MCTXS) {
+			isc_mem_attach(res->buckets[i % RES_BUCKET_MCTXS].mctx,
+				       &res->buckets[i].mctx);
+		} else {
+			result = isc_mem_create(0, 0, &res->buckets[i].mctx);
+			if (result != ISC_R_SUCCESS) {
+				isc_task_detach(&res->buckets[i].task);
+				DESTROYLOCK(&res->buckets[i].lock);
+				goto cleanup_buckets;
+			}
+			isc_mem_setname(res->buckets[i].mctx, name, NULL);
 		}
-		isc_mem_setname(res->buckets[i].mctx, name, NULL);
 #else
 		isc_mem_attach(view->mctx, &res->buckets[i].mctx);
 #endif
+		res->buckets[i].hashbits = FCTX_HASHBITS_MIN;
+		res->buckets[i].table = isc_mem_get(res->buckets[i].mctx,
+					(1U << FCTX_HASHBITS_MIN) *
+					sizeof(fctxlist_t));
+		if (res->buckets[i].table == NULL) {
+			isc_mem_detach(&res->buckets[i].mctx);
+			isc_task_detach(&res->buckets[i].task);
+			DESTROYLOCK(&res->buckets[i].lock);
+			result = ISC_R_NOMEMORY;
+			goto cleanup_buckets;
+		}
+		for (j = 0; j < (1U << FCTX_HASHBITS_MIN); j++)
+			ISC_LIST_INIT(res->buckets[i].table[j]);
+		res->buckets[i].count = 0;
+		res->buckets[i].highwater = 0;
+		res->buckets[i].chainmax = 0;
 		isc_task_setname(res->buckets[i].task, name, res);
 		ISC_LIST_INIT(res->buckets[i].fctxs);
 		res->buckets[i].exiting = false;
@@ -9165,6 +9343,9 @@ dns_resolver_create(dns_view_t *view,
 
  cleanup_buckets:
 	for (i = 0; i < buckets_created; i++) {
+		isc_mem_put(res->buckets[i].mctx, res->buckets[i].table,
+			    (1U << res->buckets[i].hashbits) *
+			    sizeof(fctxlist_t));
 		isc_mem_detach(&res->buckets[i].mctx);
 		DESTROYLOCK(&res->buckets[i].lock);
 		isc_task_shutdown(res->buckets[i].task);
@@ -9517,7 +9698,8 @@ dns_resolver_createfetch3(dns_resolver_t *res, dns_name_t *name,
 	dns_fetch_t *fetch;
 	fetchctx_t *fctx = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int bucketnum;
+	unsigned int hashval, bucketnum;
+	fctxbucket_t *bucket;
 	bool new_fctx = false;
 	isc_event_t *event;
 	unsigned int count = 0;
@@ -9552,24 +9734,32 @@ dns_resolver_createfetch3(dns_resolver_t *res, dns_name_t *name,
 	fetch->mctx = NULL;
 	isc_mem_attach(res->mctx, &fetch->mctx);
 
-	bucketnum = dns_name_fullhash(name, false) % res->nbuckets;
+	hashval = dns_name_fullhash(name, false);
+	bucketnum = hashval % res->nbuckets;
+	bucket = &res->buckets[bucketnum];
 
+#ifndef SPILL_ATOMIC
 	LOCK(&res->lock);
-	spillat = res->spillat;
-	spillatmin = res->spillatmin;
+#endif
+	spillat = SPILL_GET(res->spillat);
+	spillatmin = SPILL_GET(res->spillatmin);
+#ifndef SPILL_ATOMIC
 	UNLOCK(&res->lock);
-	LOCK(&res->buckets[bucketnum].lock);
+#endif
+	bucket_lock(res, bucket);
 
-	if (res->buckets[bucketnum].exiting) {
+	if (bucket->exiting) {
 		result = ISC_R_SHUTTINGDOWN;
 		goto unlock;
 	}
 
 	if ((options & DNS_FETCHOPT_UNSHARED) == 0) {
-		for (fctx = ISC_LIST_HEAD(res->buckets[bucketnum].fctxs);
+		for (fctx = ISC_LIST_HEAD(*FCTX_CHAIN(res, bucket, hashval,
+						      type));
 		     fctx != NULL;
-		     fctx = ISC_LIST_NEXT(fctx, link)) {
-			if (fctx_match(fctx, name, type, options))
+		     fctx = ISC_LIST_NEXT(fctx, hlink)) {
+			if (fctx->hashval == hashval &&
+			    fctx_match(fctx, name, type, options))
 				break;
 		}
 	}
@@ -9602,8 +9792,8 @@ dns_resolver_createfetch3(dns_resolver_t *res, dns_name_t *name,
 
 	if (fctx == NULL) {
 		result = fctx_create(res, name, type, domain, nameservers,
-				     client, options, bucketnum, depth, qc,
-				     &fctx);
+				     client, options, hashval, bucketnum,
+				     depth, qc, &fctx);
 		if (result != ISC_R_SUCCESS)
 			goto unlock;
 		new_fctx = true;
@@ -9622,7 +9812,7 @@ dns_resolver_createfetch3(dns_resolver_t *res, dns_name_t *name,
 				       DNS_EVENT_FETCHCONTROL,
 				       fctx_start, fctx, NULL,
 				       NULL, NULL);
-			isc_task_send(res->buckets[bucketnum].task, &event);
+			isc_task_send(bucket->task, &event);
 		} else {
 			/*
 			 * We don't care about the result of fctx_unlink()
@@ -9634,7 +9824,7 @@ dns_resolver_createfetch3(dns_resolver_t *res, dns_name_t *name,
 	}
 
  unlock:
-	UNLOCK(&res->buckets[bucketnum].lock);
+	UNLOCK(&bucket->lock);
 
 	if (dodestroy)
 		fctx_destroy(fctx);
@@ -10257,9 +10447,9 @@ dns_resolver_getclientsperquery(dns_resolver_t *resolver, uint32_t *cur,
 
 	LOCK(&resolver->lock);
 	if (cur != NULL)
-		*cur = resolver->spillat;
+		*cur = SPILL_GET(resolver->spillat);
 	if (min != NULL)
-		*min = resolver->spillatmin;
+		*min = SPILL_GET(resolver->spillatmin);
 	if (max != NULL)
 		*max = resolver->spillatmax;
 	UNLOCK(&resolver->lock);
@@ -10272,7 +10462,8 @@ dns_resolver_setclientsperquery(dns_resolver_t *resolver, uint32_t min,
 	REQUIRE(VALID_RESOLVER(resolver));
 
 	LOCK(&resolver->lock);
-	resolver->spillatmin = resolver->spillat = min;
+	SPILL_SET(resolver->spillatmin, min);
+	SPILL_SET(resolver->spillat, min);
 	resolver->spillatmax = max;
 	UNLOCK(&resolver->lock);
 }
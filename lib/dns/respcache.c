@@ -0,0 +1,496 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/once.h>
+#include <isc/platform.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#include <stdatomic.h>
+#elif defined(ISC_PLATFORM_HAVEXADD)
+#include <isc/atomic.h>
+#endif
+
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+
+#define RESPCACHE_MAGIC			ISC_MAGIC('R', 's', 'p', 'C')
+#define VALID_RESPCACHE(rc)		ISC_MAGIC_VALID(rc, RESPCACHE_MAGIC)
+
+/*
+ * The cache is split into up to RESPCACHE_MAXSHARDS independently
+ * locked shards, but only while every shard still gets at least
+ * RESPCACHE_SHARDMIN entries.
+ */
+#define RESPCACHE_MAXSHARDS		16
+#define RESPCACHE_SHARDMIN		64
+
+typedef struct respcache_entry respcache_entry_t;
+
+struct respcache_entry {
+	respcache_entry_t *		next;
+	ISC_LINK(respcache_entry_t)	link;
+	uint32_t			hashval;
+	dns_respcachedeps_t		deps;
+	dns_rdatatype_t			qtype;
+	dns_rdataclass_t		qclass;
+	unsigned int			flags;
+	unsigned int			namelen;
+	unsigned int			length;
+	/* The owner name and the response follow the structure. */
+};
+
+#define ENTRY_NAME(e)		((unsigned char *)((e) + 1))
+#define ENTRY_RESPONSE(e)	(ENTRY_NAME(e) + (e)->namelen)
+#define ENTRY_SIZE(e)		(sizeof(*(e)) + (e)->namelen + (e)->length)
+
+typedef struct respcache_shard {
+	isc_mutex_t			lock;
+	respcache_entry_t **		table;
+	ISC_LIST(respcache_entry_t)	lru;
+	unsigned int			count;
+} respcache_shard_t;
+
+struct dns_respcache {
+	unsigned int			magic;
+	isc_mem_t *			mctx;
+	unsigned int			nshards;
+	unsigned int			shardmax;
+	unsigned int			hashsize;
+	respcache_shard_t *		shards;
+};
+
+/*
+ * Generations are kept in a table shared by all caches, indexed by a
+ * hash of the address of the zone table, zone or database they stand
+ * for.  Objects that share a slot only invalidate each other's
+ * responses needlessly, and an object that reuses the address of a
+ * freed one starts from a generation no response depends on any more.
+ */
+#define RESPCACHE_GENBITS		12
+#define RESPCACHE_GENSLOTS		(1U << RESPCACHE_GENBITS)
+
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+static atomic_uint_fast32_t generations[RESPCACHE_GENSLOTS];
+#define GENERATION(i)	((uint32_t)atomic_load_explicit(&generations[i], \
+							memory_order_acquire))
+#define INVALIDATE(i)	atomic_fetch_add_explicit(&generations[i], 1, \
+						  memory_order_release)
+#elif defined(ISC_PLATFORM_HAVEXADD)
+static int32_t generations[RESPCACHE_GENSLOTS];
+#define GENERATION(i)	((uint32_t)isc_atomic_xadd(&generations[i], 0))
+#define INVALIDATE(i)	isc_atomic_xadd(&generations[i], 1)
+#else
+static uint32_t generations[RESPCACHE_GENSLOTS];
+static isc_mutex_t generation_lock;
+static isc_once_t generation_once = ISC_ONCE_INIT;
+
+static void
+generation_initlock(void) {
+	RUNTIME_CHECK(isc_mutex_init(&generation_lock) == ISC_R_SUCCESS);
+}
+
+static uint32_t
+generation_get(uint32_t i, bool increment) {
+	uint32_t value;
+
+	RUNTIME_CHECK(isc_once_do(&generation_once,
+				  generation_initlock) == ISC_R_SUCCESS);
+	LOCK(&generation_lock);
+	if (increment)
+		generations[i]++;
+	value = generations[i];
+	UNLOCK(&generation_lock);
+	return (value);
+}
+#define GENERATION(i)	generation_get((i), false)
+#define INVALIDATE(i)	(void)generation_get((i), true)
+#endif
+
+static inline uint32_t
+generation_slot(const void *object) {
+	uint64_t h = (uintptr_t)object;
+
+	h *= 0x9e3779b97f4a7c15ULL;
+	return ((uint32_t)(h >> (64 - RESPCACHE_GENBITS)));
+}
+
+void
+dns_respcache_initdeps(dns_respcachedeps_t *deps) {
+	REQUIRE(deps != NULL);
+
+	deps->count = 0;
+	deps->overflow = false;
+}
+
+void
+dns_respcache_adddep(dns_respcachedeps_t *deps, const void *object) {
+	uint32_t slot;
+	unsigned int i;
+
+	REQUIRE(deps != NULL);
+	REQUIRE(object != NULL);
+
+	/*
+	 * Keep the generation seen first: data looked up since may
+	 * already be older than the current one.
+	 */
+	slot = generation_slot(object);
+	for (i = 0; i < deps->count; i++)
+		if (deps->slots[i] == slot)
+			return;
+	if (deps->count == DNS_RESPCACHE_MAXDEPS) {
+		deps->overflow = true;
+		return;
+	}
+	deps->slots[deps->count] = slot;
+	deps->generations[deps->count] = GENERATION(slot);
+	deps->count++;
+}
+
+void
+dns_respcache_invalidate(const void *object) {
+	REQUIRE(object != NULL);
+
+	INVALIDATE(generation_slot(object));
+}
+
+static inline bool
+deps_current(const dns_respcachedeps_t *deps) {
+	unsigned int i;
+
+	for (i = 0; i < deps->count; i++)
+		if (GENERATION(deps->slots[i]) != deps->generations[i])
+			return (false);
+	return (true);
+}
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, unsigned int maxentries,
+		     dns_respcache_t **rcp)
+{
+	isc_result_t result;
+	dns_respcache_t *rc;
+	unsigned int i, nshards;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(maxentries > 0);
+	REQUIRE(rcp != NULL && *rcp == NULL);
+
+	nshards = 1;
+	while (nshards < RESPCACHE_MAXSHARDS &&
+	       maxentries / (nshards * 2) >= RESPCACHE_SHARDMIN)
+	{
+		nshards *= 2;
+	}
+
+	rc = isc_mem_get(mctx, sizeof(*rc));
+	if (rc == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(rc, 0, sizeof(*rc));
+	isc_mem_attach(mctx, &rc->mctx);
+
+	rc->nshards = nshards;
+	rc->shardmax = (maxentries + nshards - 1) / nshards;
+	rc->hashsize = 16;
+	while (rc->hashsize < rc->shardmax)
+		rc->hashsize *= 2;
+
+	rc->shards = isc_mem_get(mctx, nshards * sizeof(rc->shards[0]));
+	if (rc->shards == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_rc;
+	}
+	memset(rc->shards, 0, nshards * sizeof(rc->shards[0]));
+
+	for (i = 0; i < nshards; i++) {
+		respcache_shard_t *shard = &rc->shards[i];
+
+		shard->table = isc_mem_get(mctx, rc->hashsize *
+					   sizeof(shard->table[0]));
+		if (shard->table == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup_shards;
+		}
+		memset(shard->table, 0,
+		       rc->hashsize * sizeof(shard->table[0]));
+		result = isc_mutex_init(&shard->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, shard->table,
+				    rc->hashsize * sizeof(shard->table[0]));
+			goto cleanup_shards;
+		}
+		ISC_LIST_INIT(shard->lru);
+	}
+
+	rc->magic = RESPCACHE_MAGIC;
+	*rcp = rc;
+	return (ISC_R_SUCCESS);
+
+ cleanup_shards:
+	while (i-- > 0) {
+		DESTROYLOCK(&rc->shards[i].lock);
+		isc_mem_put(mctx, rc->shards[i].table,
+			    rc->hashsize * sizeof(rc->shards[i].table[0]));
+	}
+	isc_mem_put(mctx, rc->shards, nshards * sizeof(rc->shards[0]));
+ cleanup_rc:
+	isc_mem_putanddetach(&rc->mctx, rc, sizeof(*rc));
+	return (result);
+}
+
+/*
+ * Unlink 'entry' from its hash chain, whose link to it is 'prevp',
+ * and from the LRU list, and free it.
+ */
+static void
+entry_free(dns_respcache_t *rc, respcache_shard_t *shard,
+	   respcache_entry_t **prevp, respcache_entry_t *entry)
+{
+	*prevp = entry->next;
+	ISC_LIST_UNLINK(shard->lru, entry, link);
+	INSIST(shard->count > 0);
+	shard->count--;
+	isc_mem_put(rc->mctx, entry, ENTRY_SIZE(entry));
+}
+
+static void
+shard_flush(dns_respcache_t *rc, respcache_shard_t *shard) {
+	respcache_entry_t *entry;
+	unsigned int i;
+
+	for (i = 0; i < rc->hashsize; i++) {
+		while ((entry = shard->table[i]) != NULL)
+			entry_free(rc, shard, &shard->table[i], entry);
+	}
+	INSIST(shard->count == 0);
+}
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp) {
+	dns_respcache_t *rc;
+	unsigned int i;
+
+	REQUIRE(rcp != NULL && VALID_RESPCACHE(*rcp));
+
+	rc = *rcp;
+	*rcp = NULL;
+	rc->magic = 0;
+
+	for (i = 0; i < rc->nshards; i++) {
+		shard_flush(rc, &rc->shards[i]);
+		DESTROYLOCK(&rc->shards[i].lock);
+		isc_mem_put(rc->mctx, rc->shards[i].table,
+			    rc->hashsize * sizeof(rc->shards[i].table[0]));
+	}
+	isc_mem_put(rc->mctx, rc->shards,
+		    rc->nshards * sizeof(rc->shards[0]));
+	isc_mem_putanddetach(&rc->mctx, rc, sizeof(*rc));
+}
+
+static inline uint32_t
+key_hash(const dns_respcachekey_t *key, isc_region_t *name) {
+	dns_name_t *qname;
+	uint32_t hashval;
+
+	DE_CONST(key->qname, qname);
+	dns_name_toregion(qname, name);
+	hashval = isc_hash_function(name->base, name->length, true, NULL);
+	return (hashval ^ ((uint32_t)key->qtype << 16) ^ key->qclass ^
+		(key->flags * 0x9e3779b1U));
+}
+
+/*
+ * Find the entry for 'key' in 'shard' and set '*prevpp' to the link
+ * pointing to it.  The shard must be locked.
+ */
+static respcache_entry_t *
+entry_find(dns_respcache_t *rc, respcache_shard_t *shard,
+	   const dns_respcachekey_t *key, uint32_t hashval,
+	   const isc_region_t *name, respcache_entry_t ***prevpp)
+{
+	respcache_entry_t *entry, **prevp;
+
+	prevp = &shard->table[(hashval / rc->nshards) & (rc->hashsize - 1)];
+	for (entry = *prevp; entry != NULL; entry = entry->next) {
+		if (entry->hashval == hashval &&
+		    entry->qtype == key->qtype &&
+		    entry->qclass == key->qclass &&
+		    entry->flags == key->flags &&
+		    entry->namelen == name->length &&
+		    memcmp(ENTRY_NAME(entry), name->base, name->length) == 0)
+		{
+			break;
+		}
+		prevp = &entry->next;
+	}
+	*prevpp = prevp;
+	return (entry);
+}
+
+/*
+ * Unlink and free the least recently used entry of 'shard'.
+ */
+static void
+shard_evict(dns_respcache_t *rc, respcache_shard_t *shard) {
+	respcache_entry_t *entry, **prevp;
+
+	entry = ISC_LIST_TAIL(shard->lru);
+	INSIST(entry != NULL);
+	prevp = &shard->table[(entry->hashval / rc->nshards) &
+			      (rc->hashsize - 1)];
+	while (*prevp != entry)
+		prevp = &(*prevp)->next;
+	entry_free(rc, shard, prevp, entry);
+}
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *rc, const dns_respcachedeps_t *deps,
+		  const dns_respcachekey_t *key, const isc_region_t *response)
+{
+	respcache_shard_t *shard;
+	respcache_entry_t *entry, *old, **prevp;
+	isc_region_t name;
+	uint32_t hashval;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+	REQUIRE(deps != NULL);
+	REQUIRE(key != NULL && dns_name_isabsolute(key->qname));
+	REQUIRE(response != NULL &&
+		response->length >= DNS_MESSAGE_HEADERLEN);
+
+	if (response->length > DNS_RESPCACHE_MAXRESPONSE)
+		return (ISC_R_NOSPACE);
+	if (deps->overflow || !deps_current(deps))
+		return (ISC_R_IGNORE);
+
+	hashval = key_hash(key, &name);
+
+	/*
+	 * Build the new entry before taking the lock.
+	 */
+	entry = isc_mem_get(rc->mctx,
+			    sizeof(*entry) + name.length + response->length);
+	if (entry == NULL)
+		return (ISC_R_NOMEMORY);
+	entry->next = NULL;
+	ISC_LINK_INIT(entry, link);
+	entry->hashval = hashval;
+	entry->deps = *deps;
+	entry->qtype = key->qtype;
+	entry->qclass = key->qclass;
+	entry->flags = key->flags;
+	entry->namelen = name.length;
+	entry->length = response->length;
+	memmove(ENTRY_NAME(entry), name.base, name.length);
+	memmove(ENTRY_RESPONSE(entry), response->base, response->length);
+
+	shard = &rc->shards[hashval % rc->nshards];
+	LOCK(&shard->lock);
+	old = entry_find(rc, shard, key, hashval, &name, &prevp);
+	if (old != NULL)
+		entry_free(rc, shard, prevp, old);
+	else if (shard->count >= rc->shardmax)
+		shard_evict(rc, shard);
+	/*
+	 * Re-find the chain head: eviction may have unlinked the entry
+	 * 'prevp' pointed into.
+	 */
+	prevp = &shard->table[(hashval / rc->nshards) & (rc->hashsize - 1)];
+	entry->next = *prevp;
+	*prevp = entry;
+	ISC_LIST_PREPEND(shard->lru, entry, link);
+	shard->count++;
+	UNLOCK(&shard->lock);
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_respcache_get(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		  isc_buffer_t *target)
+{
+	respcache_shard_t *shard;
+	respcache_entry_t *entry, **prevp;
+	isc_region_t name;
+	isc_result_t result;
+	uint32_t hashval;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+	REQUIRE(key != NULL && dns_name_isabsolute(key->qname));
+	REQUIRE(ISC_BUFFER_VALID(target));
+
+	hashval = key_hash(key, &name);
+	shard = &rc->shards[hashval % rc->nshards];
+
+	LOCK(&shard->lock);
+	entry = entry_find(rc, shard, key, hashval, &name, &prevp);
+	if (entry == NULL) {
+		result = ISC_R_NOTFOUND;
+	} else if (!deps_current(&entry->deps)) {
+		entry_free(rc, shard, prevp, entry);
+		result = ISC_R_NOTFOUND;
+	} else if (entry->length > isc_buffer_availablelength(target)) {
+		result = ISC_R_NOSPACE;
+	} else {
+		isc_buffer_putmem(target, ENTRY_RESPONSE(entry),
+				  entry->length);
+		if (entry != ISC_LIST_HEAD(shard->lru)) {
+			ISC_LIST_UNLINK(shard->lru, entry, link);
+			ISC_LIST_PREPEND(shard->lru, entry, link);
+		}
+		result = ISC_R_SUCCESS;
+	}
+	UNLOCK(&shard->lock);
+
+	return (result);
+}
+
+void
+dns_respcache_flush(dns_respcache_t *rc) {
+	unsigned int i;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+
+	for (i = 0; i < rc->nshards; i++) {
+		LOCK(&rc->shards[i].lock);
+		shard_flush(rc, &rc->shards[i]);
+		UNLOCK(&rc->shards[i].lock);
+	}
+}
+
+unsigned int
+dns_respcache_count(dns_respcache_t *rc) {
+	unsigned int i, count = 0;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+
+	for (i = 0; i < rc->nshards; i++) {
+		LOCK(&rc->shards[i].lock);
+		count += rc->shards[i].count;
+		UNLOCK(&rc->shards[i].lock);
+	}
+	return (count);
+}
@@ -37,7 +37,7 @@
 #include <dns/view.h>
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early,
+log_end(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, bool early,
 	char *log_buf, unsigned int log_buf_len);
 
 /*
@@ -131,20 +131,22 @@ delta_rrl_time(isc_stdtime_t ts, isc_stdtime_t now) {
 }
 
 static inline int
-get_age(const dns_rrl_t *rrl, const dns_rrl_entry_t *e, isc_stdtime_t now) {
+get_age(const dns_rrl_shard_t *shard, const dns_rrl_entry_t *e,
+	isc_stdtime_t now)
+{
 	if (!e->ts_valid)
 		return (DNS_RRL_FOREVER);
-	return (delta_rrl_time(e->ts + rrl->ts_bases[e->ts_gen], now));
+	return (delta_rrl_time(e->ts + shard->ts_bases[e->ts_gen], now));
 }
 
 static inline void
-set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
+set_age(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	dns_rrl_entry_t *e_old;
 	unsigned int ts_gen;
 	int i, ts;
 
-	ts_gen = rrl->ts_gen;
-	ts = now - rrl->ts_bases[ts_gen];
+	ts_gen = shard->ts_gen;
+	ts = now - shard->ts_bases[ts_gen];
 	if (ts < 0) {
 		if (ts < -DNS_RRL_MAX_TIME_TRAVEL)
 			ts = DNS_RRL_FOREVER;
@@ -166,7 +168,7 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	 */
 	if (ts >= DNS_RRL_MAX_TS) {
 		ts_gen = (ts_gen + 1) % DNS_RRL_TS_BASES;
-		for (e_old = ISC_LIST_TAIL(rrl->lru), i = 0;
+		for (e_old = ISC_LIST_TAIL(shard->lru), i = 0;
 		     e_old != NULL && (e_old->ts_gen == ts_gen ||
 				       !ISC_LINK_LINKED(e_old, hlink));
 		     e_old = ISC_LIST_PREV(e_old, lru), ++i)
@@ -178,15 +180,15 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 				      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DEBUG1,
 				      "rrl new time base scanned %d entries"
 				      " at %d for %d %d %d %d",
-				      i, now, rrl->ts_bases[ts_gen],
-				      rrl->ts_bases[(ts_gen + 1) %
+				      i, now, shard->ts_bases[ts_gen],
+				      shard->ts_bases[(ts_gen + 1) %
 					DNS_RRL_TS_BASES],
-				      rrl->ts_bases[(ts_gen + 2) %
+				      shard->ts_bases[(ts_gen + 2) %
 					DNS_RRL_TS_BASES],
-				      rrl->ts_bases[(ts_gen + 3) %
+				      shard->ts_bases[(ts_gen + 3) %
 					DNS_RRL_TS_BASES]);
-		rrl->ts_gen = ts_gen;
-		rrl->ts_bases[ts_gen] = now;
+		shard->ts_gen = ts_gen;
+		shard->ts_bases[ts_gen] = now;
 		ts = 0;
 	}
 
@@ -195,37 +197,48 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	e->ts_valid = true;
 }
 
+/*
+ * The shards draw their entries from max-table-size as they need them,
+ * so that a busy shard can use the entries the others leave unused.
+ */
 static isc_result_t
-expand_entries(dns_rrl_t *rrl, int newsize) {
+expand_entries(dns_rrl_shard_t *shard, int newsize) {
+	dns_rrl_t *rrl = shard->rrl;
 	unsigned int bsize;
 	dns_rrl_block_t *b;
 	dns_rrl_entry_t *e;
 	double rate;
 	int i;
 
+	LOCK(&rrl->lock);
 	if (rrl->num_entries + newsize >= rrl->max_entries &&
 	    rrl->max_entries != 0)
 	{
 		newsize = rrl->max_entries - rrl->num_entries;
-		if (newsize <= 0)
-			return (ISC_R_SUCCESS);
 	}
+	if (newsize > 0)
+		rrl->num_entries += newsize;
+	UNLOCK(&rrl->lock);
+	if (newsize <= 0)
+		return (ISC_R_SUCCESS);
 
 	/*
 	 * Log expansions so that the user can tune max-table-size
 	 * and min-table-size.
 	 */
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) &&
-	    rrl->hash != NULL) {
-		rate = rrl->probes;
-		if (rrl->searches != 0)
-			rate /= rrl->searches;
+	    shard->hash != NULL) {
+		rate = shard->probes;
+		if (shard->searches != 0)
+			rate /= shard->searches;
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL entries with"
-			      " %d bins; average search length %.1f",
-			      rrl->num_entries, rrl->num_entries+newsize,
-			      rrl->hash->length, rate);
+			      " %d bins in shard %u; average search"
+			      " length %.1f",
+			      shard->num_entries, shard->num_entries+newsize,
+			      shard->hash->length,
+			      (unsigned int)(shard - rrl->shards), rate);
 	}
 
 	bsize = sizeof(dns_rrl_block_t) + (newsize-1)*sizeof(dns_rrl_entry_t);
@@ -235,6 +248,9 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_FAIL,
 			      "isc_mem_get(%d) failed for RRL entries",
 			      bsize);
+		LOCK(&rrl->lock);
+		rrl->num_entries -= newsize;
+		UNLOCK(&rrl->lock);
 		return (ISC_R_NOMEMORY);
 	}
 	memset(b, 0, bsize);
@@ -243,10 +259,10 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 	e = b->entries;
 	for (i = 0; i < newsize; ++i, ++e) {
 		ISC_LINK_INIT(e, hlink);
-		ISC_LIST_INITANDAPPEND(rrl->lru, e, lru);
+		ISC_LIST_INITANDAPPEND(shard->lru, e, lru);
 	}
-	rrl->num_entries += newsize;
-	ISC_LIST_INITANDAPPEND(rrl->blocks, b, link);
+	shard->num_entries += newsize;
+	ISC_LIST_INITANDAPPEND(shard->blocks, b, link);
 
 	return (ISC_R_SUCCESS);
 }
@@ -258,12 +274,12 @@ get_bin(dns_rrl_hash_t *hash, unsigned int hval) {
 }
 
 static void
-free_old_hash(dns_rrl_t *rrl) {
+free_old_hash(dns_rrl_shard_t *shard) {
 	dns_rrl_hash_t *old_hash;
 	dns_rrl_bin_t *old_bin;
 	dns_rrl_entry_t *e, *e_next;
 
-	old_hash = rrl->old_hash;
+	old_hash = shard->old_hash;
 	for (old_bin = &old_hash->bins[0];
 	     old_bin < &old_hash->bins[old_hash->length];
 	     ++old_bin)
@@ -274,29 +290,30 @@ free_old_hash(dns_rrl_t *rrl) {
 		}
 	}
 
-	isc_mem_put(rrl->mctx, old_hash,
+	isc_mem_put(shard->rrl->mctx, old_hash,
 		    sizeof(*old_hash)
 		      + (old_hash->length - 1) * sizeof(old_hash->bins[0]));
-	rrl->old_hash = NULL;
+	shard->old_hash = NULL;
 }
 
 static isc_result_t
-expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
+expand_rrl_hash(dns_rrl_shard_t *shard, isc_stdtime_t now) {
+	dns_rrl_t *rrl = shard->rrl;
 	dns_rrl_hash_t *hash;
 	int old_bins, new_bins, hsize;
 	double rate;
 
-	if (rrl->old_hash != NULL)
-		free_old_hash(rrl);
+	if (shard->old_hash != NULL)
+		free_old_hash(shard);
 
 	/*
 	 * Most searches fail and so go to the end of the chain.
 	 * Use a small hash table load factor.
 	 */
-	old_bins = (rrl->hash == NULL) ? 0 : rrl->hash->length;
+	old_bins = (shard->hash == NULL) ? 0 : shard->hash->length;
 	new_bins = old_bins/8 + old_bins;
-	if (new_bins < rrl->num_entries)
-		new_bins = rrl->num_entries;
+	if (new_bins < shard->num_entries)
+		new_bins = shard->num_entries;
 	new_bins = hash_divisor(new_bins);
 
 	hsize = sizeof(dns_rrl_hash_t) + (new_bins-1)*sizeof(hash->bins[0]);
@@ -311,38 +328,42 @@ expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
 	}
 	memset(hash, 0, hsize);
 	hash->length = new_bins;
-	rrl->hash_gen ^= 1;
-	hash->gen = rrl->hash_gen;
+	shard->hash_gen ^= 1;
+	hash->gen = shard->hash_gen;
 
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) && old_bins != 0) {
-		rate = rrl->probes;
-		if (rrl->searches != 0)
-			rate /= rrl->searches;
+		rate = shard->probes;
+		if (shard->searches != 0)
+			rate /= shard->searches;
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL bins for"
-			      " %d entries; average search length %.1f",
-			      old_bins, new_bins, rrl->num_entries, rate);
+			      " %d entries in shard %u; average search"
+			      " length %.1f",
+			      old_bins, new_bins, shard->num_entries,
+			      (unsigned int)(shard - rrl->shards), rate);
 	}
 
-	rrl->old_hash = rrl->hash;
-	if (rrl->old_hash != NULL)
-		rrl->old_hash->check_time = now;
-	rrl->hash = hash;
+	shard->old_hash = shard->hash;
+	if (shard->old_hash != NULL)
+		shard->old_hash->check_time = now;
+	shard->hash = hash;
 
 	return (ISC_R_SUCCESS);
 }
 
 static void
-ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
+ref_entry(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, int probes,
+	  isc_stdtime_t now)
+{
 	/*
 	 * Make the entry most recently used.
 	 */
-	if (ISC_LIST_HEAD(rrl->lru) != e) {
-		if (e == rrl->last_logged)
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
-		ISC_LIST_UNLINK(rrl->lru, e, lru);
-		ISC_LIST_PREPEND(rrl->lru, e, lru);
+	if (ISC_LIST_HEAD(shard->lru) != e) {
+		if (e == shard->last_logged)
+			shard->last_logged = ISC_LIST_PREV(e, lru);
+		ISC_LIST_UNLINK(shard->lru, e, lru);
+		ISC_LIST_PREPEND(shard->lru, e, lru);
 	}
 
 	/*
@@ -351,15 +372,15 @@ ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
 	 * old hash table.  It will migrate to the new hash table the next
 	 * time it is used or be cut loose when the old hash table is destroyed.
 	 */
-	rrl->probes += probes;
-	++rrl->searches;
-	if (rrl->searches > 100 &&
-	    delta_rrl_time(rrl->hash->check_time, now) > 1) {
-		if (rrl->probes/rrl->searches > 2)
-			expand_rrl_hash(rrl, now);
-		rrl->hash->check_time = now;
-		rrl->probes = 0;
-		rrl->searches = 0;
+	shard->probes += probes;
+	++shard->searches;
+	if (shard->searches > 100 &&
+	    delta_rrl_time(shard->hash->check_time, now) > 1) {
+		if (shard->probes/shard->searches > 2)
+			expand_rrl_hash(shard, now);
+		shard->hash->check_time = now;
+		shard->probes = 0;
+		shard->searches = 0;
 	}
 }
 
@@ -448,6 +469,27 @@ make_key(const dns_rrl_t *rrl, dns_rrl_key_t *key,
 	}
 }
 
+/*
+ * Pick the shard for a client.  Every kind of entry for a client address
+ * block is keyed by the same masked address, so they all land in the
+ * same shard.
+ */
+static inline dns_rrl_shard_t *
+get_shard(const dns_rrl_t *rrl, const isc_sockaddr_t *client_addr) {
+	dns_rrl_key_t key;
+	uint32_t hval;
+	int i;
+
+	if (rrl->nshards == 1)
+		return (&rrl->shards[0]);
+
+	make_key(rrl, &key, client_addr, 0, NULL, 0, DNS_RRL_RTYPE_FREE);
+	hval = key.s.ipv6;
+	for (i = 0; i < DNS_RRL_MAX_PREFIX/32; ++i)
+		hval = (hval ^ key.s.ip[i]) * 0x9e3779b1U;
+	return (&rrl->shards[hval >> (32 - rrl->shard_bits)]);
+}
+
 static inline dns_rrl_rate_t *
 get_rate(dns_rrl_t *rrl, dns_rrl_rtype_t rtype) {
 	switch (rtype) {
@@ -469,6 +511,23 @@ get_rate(dns_rrl_t *rrl, dns_rrl_rtype_t rtype) {
 	}
 }
 
+/*
+ * Other shards may be changing the scaled rates when qps-scale is
+ * configured.
+ */
+static inline int
+get_scaled(dns_rrl_t *rrl, const dns_rrl_rate_t *ratep) {
+	int scaled;
+
+	if (rrl->qps_scale == 0)
+		return (ratep->scaled);
+
+	LOCK(&rrl->lock);
+	scaled = ratep->scaled;
+	UNLOCK(&rrl->lock);
+	return (scaled);
+}
+
 static int
 response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
 	dns_rrl_rate_t *ratep;
@@ -478,7 +537,7 @@ response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
 		rate = 1;
 	} else {
 		ratep = get_rate(rrl, e->key.s.rtype);
-		rate = ratep->scaled;
+		rate = get_scaled(rrl, ratep);
 	}
 
 	balance = e->responses + age * rate;
@@ -491,11 +550,12 @@ response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
  * Search for an entry for a response and optionally create it.
  */
 static dns_rrl_entry_t *
-get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
+get_entry(dns_rrl_shard_t *shard, const isc_sockaddr_t *client_addr,
 	  dns_rdataclass_t qclass, dns_rdatatype_t qtype, dns_name_t *qname,
 	  dns_rrl_rtype_t rtype, isc_stdtime_t now, bool create,
 	  char *log_buf, unsigned int log_buf_len)
 {
+	dns_rrl_t *rrl = shard->rrl;
 	dns_rrl_key_t key;
 	uint32_t hval;
 	dns_rrl_entry_t *e;
@@ -509,12 +569,12 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	/*
 	 * Look for the entry in the current hash table.
 	 */
-	new_bin = get_bin(rrl->hash, hval);
+	new_bin = get_bin(shard->hash, hval);
 	probes = 1;
 	e = ISC_LIST_HEAD(*new_bin);
 	while (e != NULL) {
 		if (key_cmp(&e->key, &key)) {
-			ref_entry(rrl, e, probes, now);
+			ref_entry(shard, e, probes, now);
 			return (e);
 		}
 		++probes;
@@ -524,15 +584,15 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	/*
 	 * Look in the old hash table.
 	 */
-	if (rrl->old_hash != NULL) {
-		old_bin = get_bin(rrl->old_hash, hval);
+	if (shard->old_hash != NULL) {
+		old_bin = get_bin(shard->old_hash, hval);
 		e = ISC_LIST_HEAD(*old_bin);
 		while (e != NULL) {
 			if (key_cmp(&e->key, &key)) {
 				ISC_LIST_UNLINK(*old_bin, e, hlink);
 				ISC_LIST_PREPEND(*new_bin, e, hlink);
-				e->hash_gen = rrl->hash_gen;
-				ref_entry(rrl, e, probes, now);
+				e->hash_gen = shard->hash_gen;
+				ref_entry(shard, e, probes, now);
 				return (e);
 			}
 			e = ISC_LIST_NEXT(e, hlink);
@@ -541,9 +601,9 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 		/*
 		 * Discard prevous hash table when all of its entries are old.
 		 */
-		age = delta_rrl_time(rrl->old_hash->check_time, now);
+		age = delta_rrl_time(shard->old_hash->check_time, now);
 		if (age > rrl->window)
-			free_old_hash(rrl);
+			free_old_hash(shard);
 	}
 
 	if (!create)
@@ -555,13 +615,13 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	 * Try to make more entries if none are idle.
 	 * Steal the oldest entry if we cannot create more.
 	 */
-	for (e = ISC_LIST_TAIL(rrl->lru);
+	for (e = ISC_LIST_TAIL(shard->lru);
 	     e != NULL;
 	     e = ISC_LIST_PREV(e, lru))
 	{
 		if (!ISC_LINK_LINKED(e, hlink))
 			break;
-		age = get_age(rrl, e, now);
+		age = get_age(shard, e, now);
 		if (age <= 1) {
 			e = NULL;
 			break;
@@ -570,24 +630,24 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 			break;
 	}
 	if (e == NULL) {
-		expand_entries(rrl, ISC_MIN((rrl->num_entries+1)/2, 1000));
-		e = ISC_LIST_TAIL(rrl->lru);
+		expand_entries(shard, ISC_MIN((shard->num_entries+1)/2, 1000));
+		e = ISC_LIST_TAIL(shard->lru);
 	}
 	if (e->logged)
-		log_end(rrl, e, true, log_buf, log_buf_len);
+		log_end(shard, e, true, log_buf, log_buf_len);
 	if (ISC_LINK_LINKED(e, hlink)) {
-		if (e->hash_gen == rrl->hash_gen)
-			hash = rrl->hash;
+		if (e->hash_gen == shard->hash_gen)
+			hash = shard->hash;
 		else
-			hash = rrl->old_hash;
+			hash = shard->old_hash;
 		old_bin = get_bin(hash, hash_key(&e->key));
 		ISC_LIST_UNLINK(*old_bin, e, hlink);
 	}
 	ISC_LIST_PREPEND(*new_bin, e, hlink);
-	e->hash_gen = rrl->hash_gen;
+	e->hash_gen = shard->hash_gen;
 	e->key = key;
 	e->ts_valid = false;
-	ref_entry(rrl, e, probes, now);
+	ref_entry(shard, e, probes, now);
 	return (e);
 }
 
@@ -609,13 +669,16 @@ debit_log(const dns_rrl_entry_t *e, int age, const char *action) {
 }
 
 static inline dns_rrl_result_t
-debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
+debit_rrl_entry(dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+		double qps, double scale,
 		const isc_sockaddr_t *client_addr, isc_stdtime_t now,
 		char *log_buf, unsigned int log_buf_len)
 {
+	dns_rrl_t *rrl = shard->rrl;
 	int rate, new_rate, slip, new_slip, age, log_secs, min;
 	dns_rrl_rate_t *ratep;
 	dns_rrl_entry_t const *credit_e;
+	bool changed;
 
 	/*
 	 * Pick the rate counter.
@@ -630,12 +693,12 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		/*
 		 * The limit for clients that have used TCP is not scaled.
 		 */
-		credit_e = get_entry(rrl, client_addr,
+		credit_e = get_entry(shard, client_addr,
 				     0, dns_rdatatype_none, NULL,
 				     DNS_RRL_RTYPE_TCP, now, false,
 				     log_buf, log_buf_len);
 		if (credit_e != NULL) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < rrl->window)
 				scale = 1.0;
 		}
@@ -644,7 +707,11 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		new_rate = (int) (rate * scale);
 		if (new_rate < 1)
 			new_rate = 1;
-		if (ratep->scaled != new_rate) {
+		LOCK(&rrl->lock);
+		changed = (ratep->scaled != new_rate);
+		ratep->scaled = new_rate;
+		UNLOCK(&rrl->lock);
+		if (changed) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 				      DNS_LOGMODULE_REQUEST,
 				      DNS_RRL_LOG_DEBUG1,
@@ -652,9 +719,8 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 				      " from %d to %d",
 				      (int)qps, ratep->str, scale,
 				      rate, new_rate);
-			rate = new_rate;
-			ratep->scaled = rate;
 		}
+		rate = new_rate;
 	}
 
 	min = -rrl->window * rate;
@@ -664,7 +730,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 	 * Treat entries older than the window as if they were just created
 	 * Credit other entries.
 	 */
-	age = get_age(rrl, e, now);
+	age = get_age(shard, e, now);
 	if (age > 0) {
 		/*
 		 * Credit tokens earned during elapsed time.
@@ -695,7 +761,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 			e->log_secs = log_secs;
 		}
 	}
-	set_age(rrl, e, now);
+	set_age(shard, e, now);
 
 	/*
 	 * Debit the entry for this response.
@@ -717,7 +783,11 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		new_slip = (int) (slip * scale);
 		if (new_slip < 2)
 			new_slip = 2;
-		if (rrl->slip.scaled != new_slip) {
+		LOCK(&rrl->lock);
+		changed = (rrl->slip.scaled != new_slip);
+		rrl->slip.scaled = new_slip;
+		UNLOCK(&rrl->lock);
+		if (changed) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 				      DNS_LOGMODULE_REQUEST,
 				      DNS_RRL_LOG_DEBUG1,
@@ -725,9 +795,8 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 				      " by %.2f from %d to %d",
 				      (int)qps, scale,
 				      slip, new_slip);
-			slip = new_slip;
-			rrl->slip.scaled = slip;
 		}
+		slip = new_slip;
 	}
 	if (slip != 0 && e->key.s.rtype != DNS_RRL_RTYPE_ALL) {
 		if (e->slip_cnt++ == 0) {
@@ -747,23 +816,23 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 }
 
 static inline dns_rrl_qname_buf_t *
-get_qname(dns_rrl_t *rrl, const dns_rrl_entry_t *e) {
+get_qname(dns_rrl_shard_t *shard, const dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
 
-	qbuf = rrl->qnames[e->log_qname];
+	qbuf = shard->qnames[e->log_qname];
 	if (qbuf == NULL || qbuf->e != e)
 		return (NULL);
 	return (qbuf);
 }
 
 static inline void
-free_qname(dns_rrl_t *rrl, dns_rrl_entry_t *e) {
+free_qname(dns_rrl_shard_t *shard, dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
 
-	qbuf = get_qname(rrl, e);
+	qbuf = get_qname(shard, e);
 	if (qbuf != NULL) {
 		qbuf->e = NULL;
-		ISC_LIST_APPEND(rrl->qname_free, qbuf, link);
+		ISC_LIST_APPEND(shard->qname_free, qbuf, link);
 	}
 }
 
@@ -787,12 +856,13 @@ add_log_str(isc_buffer_t *lb, const char *str, unsigned int str_len) {
  * Build strings for the logs
  */
 static void
-make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
+make_log_buf(dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
 	     const char *str1, const char *str2, bool plural,
 	     dns_name_t *qname, bool save_qname,
 	     dns_rrl_result_t rrl_result, isc_result_t resp_result,
 	     char *log_buf, unsigned int log_buf_len)
 {
+	dns_rrl_t *rrl = shard->rrl;
 	isc_buffer_t lb;
 	dns_rrl_qname_buf_t *qbuf;
 	isc_netaddr_t cidr;
@@ -880,22 +950,22 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 	    e->key.s.rtype == DNS_RRL_RTYPE_REFERRAL ||
 	    e->key.s.rtype == DNS_RRL_RTYPE_NODATA ||
 	    e->key.s.rtype == DNS_RRL_RTYPE_NXDOMAIN) {
-		qbuf = get_qname(rrl, e);
+		qbuf = get_qname(shard, e);
 		if (save_qname && qbuf == NULL &&
 		    qname != NULL && dns_name_isabsolute(qname)) {
 			/*
 			 * Capture the qname for the "stop limiting" message.
 			 */
-			qbuf = ISC_LIST_TAIL(rrl->qname_free);
+			qbuf = ISC_LIST_TAIL(shard->qname_free);
 			if (qbuf != NULL) {
-				ISC_LIST_UNLINK(rrl->qname_free, qbuf, link);
-			} else if (rrl->num_qnames < DNS_RRL_QNAMES) {
+				ISC_LIST_UNLINK(shard->qname_free, qbuf, link);
+			} else if (shard->num_qnames < DNS_RRL_QNAMES) {
 				qbuf = isc_mem_get(rrl->mctx, sizeof(*qbuf));
 				if (qbuf != NULL) {
 					memset(qbuf, 0, sizeof(*qbuf));
 					ISC_LINK_INIT(qbuf, link);
-					qbuf->index = rrl->num_qnames;
-					rrl->qnames[rrl->num_qnames++] = qbuf;
+					qbuf->index = shard->num_qnames++;
+					shard->qnames[qbuf->index] = qbuf;
 				} else {
 					isc_log_write(dns_lctx,
 						      DNS_LOGCATEGORY_RRL,
@@ -943,23 +1013,23 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 }
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early,
+log_end(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, bool early,
 	char *log_buf, unsigned int log_buf_len)
 {
 	if (e->logged) {
-		make_log_buf(rrl, e,
+		make_log_buf(shard, e,
 			     early ? "*" : NULL,
-			     rrl->log_only ? "would stop limiting "
-					   : "stop limiting ",
+			     shard->rrl->log_only ? "would stop limiting "
+						  : "stop limiting ",
 			     true, NULL, false,
 			     DNS_RRL_RESULT_OK, ISC_R_SUCCESS,
 			     log_buf, log_buf_len);
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "%s", log_buf);
-		free_qname(rrl, e);
+		free_qname(shard, e);
 		e->logged = false;
-		--rrl->num_logged;
+		--shard->num_logged;
 	}
 }
 
@@ -967,39 +1037,39 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early,
  * Log messages for streams that have stopped being rate limited.
  */
 static void
-log_stops(dns_rrl_t *rrl, isc_stdtime_t now, int limit,
+log_stops(dns_rrl_shard_t *shard, isc_stdtime_t now, int limit,
 	  char *log_buf, unsigned int log_buf_len)
 {
 	dns_rrl_entry_t *e;
 	int age;
 
-	for (e = rrl->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
+	for (e = shard->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
 		if (!e->logged)
 			continue;
 		if (now != 0) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < DNS_RRL_STOP_LOG_SECS ||
-			    response_balance(rrl, e, age) < 0)
+			    response_balance(shard->rrl, e, age) < 0)
 				break;
 		}
 
-		log_end(rrl, e, now == 0, log_buf, log_buf_len);
-		if (rrl->num_logged <= 0)
+		log_end(shard, e, now == 0, log_buf, log_buf_len);
+		if (shard->num_logged <= 0)
 			break;
 
 		/*
 		 * Too many messages could stall real work.
 		 */
 		if (--limit < 0) {
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
+			shard->last_logged = ISC_LIST_PREV(e, lru);
 			return;
 		}
 	}
 	if (e == NULL) {
-		INSIST(rrl->num_logged == 0);
-		rrl->log_stops_time = now;
+		INSIST(shard->num_logged == 0);
+		shard->log_stops_time = now;
 	}
-	rrl->last_logged = e;
+	shard->last_logged = e;
 }
 
 /*
@@ -1013,6 +1083,7 @@ dns_rrl(dns_view_t *view,
 	bool wouldlog, char *log_buf, unsigned int log_buf_len)
 {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shard;
 	dns_rrl_rtype_t rtype;
 	dns_rrl_entry_t *e;
 	isc_netaddr_t netclient;
@@ -1033,8 +1104,6 @@ dns_rrl(dns_view_t *view,
 			return (DNS_RRL_RESULT_OK);
 	}
 
-	LOCK(&rrl->lock);
-
 	/*
 	 * Estimate total query per second rate when scaling by qps.
 	 */
@@ -1042,6 +1111,7 @@ dns_rrl(dns_view_t *view,
 		qps = 0.0;
 		scale = 1.0;
 	} else {
+		LOCK(&rrl->lock);
 		++rrl->qps_responses;
 		secs = delta_rrl_time(rrl->qps_time, now);
 		if (secs <= 0) {
@@ -1066,14 +1136,21 @@ dns_rrl(dns_view_t *view,
 				qps = rrl->qps;
 			}
 		}
+		UNLOCK(&rrl->lock);
 		scale = rrl->qps_scale / qps;
 	}
 
+	/*
+	 * Everything else is kept per shard.
+	 */
+	shard = get_shard(rrl, client_addr);
+	LOCK(&shard->lock);
+
 	/*
 	 * Do maintenance once per second.
 	 */
-	if (rrl->num_logged > 0 && rrl->log_stops_time != now)
-		log_stops(rrl, now, 8, log_buf, log_buf_len);
+	if (shard->num_logged > 0 && shard->log_stops_time != now)
+		log_stops(shard, now, 8, log_buf, log_buf_len);
 
 	/*
 	 * Notice TCP responses when scaling limits by qps.
@@ -1081,16 +1158,16 @@ dns_rrl(dns_view_t *view,
 	 */
 	if (is_tcp) {
 		if (scale < 1.0) {
-			e = get_entry(rrl, client_addr,
+			e = get_entry(shard, client_addr,
 				      0, dns_rdatatype_none, NULL,
 				      DNS_RRL_RTYPE_TCP, now, true,
 				      log_buf, log_buf_len);
 			if (e != NULL) {
 				e->responses = -(rrl->window+1);
-				set_age(rrl, e, now);
+				set_age(shard, e, now);
 			}
 		}
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return (ISC_R_SUCCESS);
 	}
 
@@ -1115,10 +1192,10 @@ dns_rrl(dns_view_t *view,
 		rtype = DNS_RRL_RTYPE_ERROR;
 		break;
 	}
-	e = get_entry(rrl, client_addr, qclass, qtype, qname, rtype,
+	e = get_entry(shard, client_addr, qclass, qtype, qname, rtype,
 		      now, true, log_buf, log_buf_len);
 	if (e == NULL) {
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return (DNS_RRL_RESULT_OK);
 	}
 
@@ -1127,7 +1204,7 @@ dns_rrl(dns_view_t *view,
 		 * Do not worry about speed or releasing the lock.
 		 * This message appears before messages from debit_rrl_entry().
 		 */
-		make_log_buf(rrl, e, "consider limiting ", NULL, false,
+		make_log_buf(shard, e, "consider limiting ", NULL, false,
 			     qname, false, DNS_RRL_RESULT_OK, resp_result,
 			     log_buf, log_buf_len);
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
@@ -1135,7 +1212,7 @@ dns_rrl(dns_view_t *view,
 			      "%s", log_buf);
 	}
 
-	rrl_result = debit_rrl_entry(rrl, e, qps, scale, client_addr, now,
+	rrl_result = debit_rrl_entry(shard, e, qps, scale, client_addr, now,
 				     log_buf, log_buf_len);
 
 	if (rrl->all_per_second.r != 0) {
@@ -1150,22 +1227,22 @@ dns_rrl(dns_view_t *view,
 		dns_rrl_entry_t *e_all;
 		dns_rrl_result_t rrl_all_result;
 
-		e_all = get_entry(rrl, client_addr,
+		e_all = get_entry(shard, client_addr,
 				  0, dns_rdatatype_none, NULL,
 				  DNS_RRL_RTYPE_ALL, now, true,
 				  log_buf, log_buf_len);
 		if (e_all == NULL) {
-			UNLOCK(&rrl->lock);
+			UNLOCK(&shard->lock);
 			return (DNS_RRL_RESULT_OK);
 		}
-		rrl_all_result = debit_rrl_entry(rrl, e_all, qps, scale,
+		rrl_all_result = debit_rrl_entry(shard, e_all, qps, scale,
 						 client_addr, now,
 						 log_buf, log_buf_len);
 		if (rrl_all_result != DNS_RRL_RESULT_OK) {
 			e = e_all;
 			rrl_result = rrl_all_result;
 			if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DEBUG1)) {
-				make_log_buf(rrl, e,
+				make_log_buf(shard, e,
 					     "prefer all-per-second limiting ",
 					     NULL, true, qname, false,
 					     DNS_RRL_RESULT_OK, resp_result,
@@ -1179,7 +1256,7 @@ dns_rrl(dns_view_t *view,
 	}
 
 	if (rrl_result == DNS_RRL_RESULT_OK) {
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return (DNS_RRL_RESULT_OK);
 	}
 
@@ -1188,15 +1265,15 @@ dns_rrl(dns_view_t *view,
 	 */
 	if ((!e->logged || e->log_secs >= DNS_RRL_MAX_LOG_SECS) &&
 	    isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP)) {
-		make_log_buf(rrl, e, rrl->log_only ? "would " : NULL,
+		make_log_buf(shard, e, rrl->log_only ? "would " : NULL,
 			     e->logged ? "continue limiting " : "limit ",
 			     true, qname, true,
 			     DNS_RRL_RESULT_OK, resp_result,
 			     log_buf, log_buf_len);
 		if (!e->logged) {
 			e->logged = true;
-			if (++rrl->num_logged <= 1)
-				rrl->last_logged = e;
+			if (++shard->num_logged <= 1)
+				shard->last_logged = e;
 		}
 		e->log_secs = 0;
 
@@ -1204,7 +1281,7 @@ dns_rrl(dns_view_t *view,
 		 * Avoid holding the lock.
 		 */
 		if (!wouldlog) {
-			UNLOCK(&rrl->lock);
+			UNLOCK(&shard->lock);
 			e = NULL;
 		}
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
@@ -1216,7 +1293,7 @@ dns_rrl(dns_view_t *view,
 	 * Make a log message for the caller.
 	 */
 	if (wouldlog)
-		make_log_buf(rrl, e,
+		make_log_buf(shard, e,
 			     rrl->log_only ? "would rate limit " : "rate limit ",
 			     NULL, false, qname, false,
 			     rrl_result, resp_result, log_buf, log_buf_len);
@@ -1227,21 +1304,54 @@ dns_rrl(dns_view_t *view,
 		 * the ending log message.
 		 */
 		if (!e->logged)
-			free_qname(rrl, e);
-		UNLOCK(&rrl->lock);
+			free_qname(shard, e);
+		UNLOCK(&shard->lock);
 	}
 
 	return (rrl_result);
 }
 
-void
-dns_rrl_view_destroy(dns_view_t *view) {
-	dns_rrl_t *rrl;
+static void
+destroy_shard(dns_rrl_shard_t *shard) {
+	isc_mem_t *mctx = shard->rrl->mctx;
 	dns_rrl_block_t *b;
 	dns_rrl_hash_t *h;
 	char log_buf[DNS_RRL_LOG_BUF_LEN];
 	int i;
 
+	if (shard->num_logged > 0)
+		log_stops(shard, 0, INT32_MAX, log_buf, sizeof(log_buf));
+
+	for (i = 0; i < DNS_RRL_QNAMES; ++i) {
+		if (shard->qnames[i] == NULL)
+			break;
+		isc_mem_put(mctx, shard->qnames[i], sizeof(*shard->qnames[i]));
+	}
+
+	DESTROYLOCK(&shard->lock);
+
+	while (!ISC_LIST_EMPTY(shard->blocks)) {
+		b = ISC_LIST_HEAD(shard->blocks);
+		ISC_LIST_UNLINK(shard->blocks, b, link);
+		isc_mem_put(mctx, b, b->size);
+	}
+
+	h = shard->hash;
+	if (h != NULL)
+		isc_mem_put(mctx, h,
+			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
+
+	h = shard->old_hash;
+	if (h != NULL)
+		isc_mem_put(mctx, h,
+			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
+}
+
+void
+dns_rrl_view_destroy(dns_view_t *view) {
+	dns_rrl_t *rrl;
+	unsigned int i;
+
 	rrl = view->rrl;
 	if (rrl == NULL)
 		return;
@@ -1251,46 +1361,43 @@ dns_rrl_view_destroy(dns_view_t *view) {
 	 * Assume the caller takes care of locking the view and anything else.
 	 */
 
-	if (rrl->num_logged > 0)
-		log_stops(rrl, 0, INT32_MAX, log_buf, sizeof(log_buf));
-
-	for (i = 0; i < DNS_RRL_QNAMES; ++i) {
-		if (rrl->qnames[i] == NULL)
-			break;
-		isc_mem_put(rrl->mctx, rrl->qnames[i], sizeof(*rrl->qnames[i]));
-	}
+	for (i = 0; i < rrl->nshards; ++i)
+		destroy_shard(&rrl->shards[i]);
+	if (rrl->shards != NULL)
+		isc_mem_put(rrl->mctx, rrl->shards,
+			    rrl->nshards * sizeof(rrl->shards[0]));
 
 	if (rrl->exempt != NULL)
 		dns_acl_detach(&rrl->exempt);
 
 	DESTROYLOCK(&rrl->lock);
 
-	while (!ISC_LIST_EMPTY(rrl->blocks)) {
-		b = ISC_LIST_HEAD(rrl->blocks);
-		ISC_LIST_UNLINK(rrl->blocks, b, link);
-		isc_mem_put(rrl->mctx, b, b->size);
-	}
-
-	h = rrl->hash;
-	if (h != NULL)
-		isc_mem_put(rrl->mctx, h,
-			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
-
-	h = rrl->old_hash;
-	if (h != NULL)
-		isc_mem_put(rrl->mctx, h,
-			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
-
 	isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 }
 
 isc_result_t
 dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shards, *shard;
 	isc_result_t result;
+	unsigned int i, nshards, shard_bits;
+	isc_stdtime_t now;
 
 	*rrlp = NULL;
 
+	/*
+	 * Split the table only when each shard still gets a useful
+	 * number of entries, so that small tables behave as before.
+	 */
+	nshards = 1;
+	shard_bits = 0;
+	while (nshards < DNS_RRL_MAX_SHARDS &&
+	       min_entries / (int)(nshards * 2) >= DNS_RRL_SHARD_MIN_ENTRIES)
+	{
+		nshards *= 2;
+		shard_bits++;
+	}
+
 	rrl = isc_mem_get(view->mctx, sizeof(*rrl));
 	if (rrl == NULL)
 		return (ISC_R_NOMEMORY);
@@ -1301,19 +1408,50 @@ dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 		isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 		return (result);
 	}
-	isc_stdtime_get(&rrl->ts_bases[0]);
+
+	shards = isc_mem_get(rrl->mctx, nshards * sizeof(shards[0]));
+	if (shards == NULL) {
+		DESTROYLOCK(&rrl->lock);
+		isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
+		return (ISC_R_NOMEMORY);
+	}
+	memset(shards, 0, nshards * sizeof(shards[0]));
+
+	isc_stdtime_get(&now);
+	for (i = 0; i < nshards; i++) {
+		shard = &shards[i];
+		result = isc_mutex_init(&shard->lock);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				DESTROYLOCK(&shards[i].lock);
+			isc_mem_put(rrl->mctx, shards,
+				    nshards * sizeof(shards[0]));
+			DESTROYLOCK(&rrl->lock);
+			isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
+			return (result);
+		}
+		shard->rrl = rrl;
+		shard->ts_bases[0] = now;
+	}
+	rrl->shards = shards;
+	rrl->nshards = nshards;
+	rrl->shard_bits = shard_bits;
 
 	view->rrl = rrl;
 
-	result = expand_entries(rrl, min_entries);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return (result);
-	}
-	result = expand_rrl_hash(rrl, 0);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return (result);
+	for (i = 0; i < nshards; i++) {
+		shard = &shards[i];
+		result = expand_entries(shard,
+					(min_entries + nshards - 1) / nshards);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
+		result = expand_rrl_hash(shard, 0);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
 	}
 
 	*rrlp = rrl;
@@ -1368,7 +1368,9 @@ static dns_dbmethods_t sdb_methods = {
 	NULL,			/* setcachestats */
 	NULL,			/* hashsize */
 	NULL,			/* nodefullname */
-	NULL			/* getsize */
+	NULL,			/* getsize */
+	NULL,			/* adjusthashsize */
+	NULL			/* nodelockstats */
 };
 
 static isc_result_t
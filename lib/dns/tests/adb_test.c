@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <config.h>
+
+#if HAVE_CMOCKA
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <sched.h> /* IWYU pragma: keep */
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/event.h>
+#include <isc/sockaddr.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/adb.h>
+#include <dns/stats.h>
+#include <dns/view.h>
+
+#include "dnstest.h"
+
+static dns_view_t *view = NULL;
+static dns_adb_t *adb = NULL;
+static bool adb_done = false;
+
+static void
+adb_shutdown(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	adb_done = true;
+	isc_event_free(&event);
+}
+
+static int
+_setup(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_test_begin(NULL, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_test_makeview("view", &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_adb_create(mctx, view, timermgr, taskmgr, &adb);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (0);
+}
+
+static int
+_teardown(void **state) {
+	isc_event_t *event;
+
+	UNUSED(state);
+
+	/*
+	 * The view does not own this ADB, so wait for it to finish
+	 * shutting down before the view goes away.
+	 */
+	adb_done = false;
+	event = isc_event_allocate(mctx, NULL, 1000, adb_shutdown, NULL,
+				   sizeof(*event));
+	assert_non_null(event);
+	dns_adb_whenshutdown(adb, maintask, &event);
+	dns_adb_shutdown(adb);
+	dns_adb_detach(&adb);
+	while (!adb_done)
+		dns_test_nap(1000);
+
+	dns_view_detach(&view);
+	dns_test_end();
+
+	return (0);
+}
+
+static void
+mkaddr(unsigned int n, isc_sockaddr_t *sa) {
+	struct in_addr ina;
+
+	ina.s_addr = htonl(0x0a000000 | n);
+	isc_sockaddr_fromin(sa, &ina, 53);
+}
+
+static uint64_t
+getstat(isc_statscounter_t counter) {
+	isc_stats_t *stats = NULL;
+	uint64_t value;
+
+	dns_view_getadbstats(view, &stats);
+	assert_non_null(stats);
+	value = isc_stats_get_counter(stats, counter);
+	isc_stats_detach(&stats);
+
+	return (value);
+}
+
+/*
+ * Enough addresses to grow the hash chains of every bucket are found,
+ * and then found again.
+ */
+static void
+grow_test(void **state) {
+	dns_adbaddrinfo_t *ai = NULL;
+	isc_sockaddr_t sa;
+	isc_stdtime_t now;
+	isc_result_t result;
+	unsigned int i, count = 20000;
+	uint64_t chains;
+
+	UNUSED(state);
+
+	isc_stdtime_get(&now);
+	chains = getstat(dns_adbstats_nentries);
+
+	for (i = 0; i < count; i++) {
+		mkaddr(i, &sa);
+		result = dns_adb_findaddrinfo(adb, &sa, &ai, now);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_adb_freeaddrinfo(adb, &ai);
+	}
+
+	assert_int_equal(getstat(dns_adbstats_entriescnt), count);
+	assert_int_equal(getstat(dns_adbstats_entrymiss), count);
+	assert_true(getstat(dns_adbstats_entrygrow) > 0);
+	assert_true(getstat(dns_adbstats_nentries) > chains);
+
+	for (i = 0; i < count; i++) {
+		mkaddr(i, &sa);
+		result = dns_adb_findaddrinfo(adb, &sa, &ai, now);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_true(isc_sockaddr_equal(&sa, &ai->sockaddr));
+		dns_adb_freeaddrinfo(adb, &ai);
+	}
+
+	assert_int_equal(getstat(dns_adbstats_entriescnt), count);
+	assert_int_equal(getstat(dns_adbstats_entryhit), count);
+}
+
+/* dns_adb_adjustsrtt, dns_adb_changeflags, dns_adb_setudpsize */
+static void
+update_test(void **state) {
+	dns_adbaddrinfo_t *ai = NULL, *ai2 = NULL;
+	isc_sockaddr_t sa;
+	isc_stdtime_t now;
+	isc_result_t result;
+	unsigned int srtt;
+
+	UNUSED(state);
+
+	isc_stdtime_get(&now);
+	mkaddr(1, &sa);
+	result = dns_adb_findaddrinfo(adb, &sa, &ai, now);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_adb_findaddrinfo(adb, &sa, &ai2, now);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(ai->entry, ai2->entry);
+
+	dns_adb_adjustsrtt(adb, ai, 100000, DNS_ADB_RTTADJREPLACE);
+	assert_int_equal(ai->srtt, 100000);
+
+	/* The second address sees the first one's adjustment. */
+	dns_adb_adjustsrtt(adb, ai2, 200000, 5);
+	assert_int_equal(ai2->srtt, 150000);
+
+	/* Ageing happens at most once a second. */
+	dns_adb_agesrtt(adb, ai, now + 1);
+	srtt = ai->srtt;
+	assert_true(srtt < 150000);
+	dns_adb_agesrtt(adb, ai, now + 1);
+	assert_int_equal(ai->srtt, srtt);
+
+	dns_adb_changeflags(adb, ai, 0x3, 0x3);
+	dns_adb_changeflags(adb, ai2, 0x4, 0x6);
+	assert_int_equal(ai->flags & 0x7, 0x3);
+	assert_int_equal(ai2->flags & 0x7, 0x4);
+
+	dns_adb_freeaddrinfo(adb, &ai2);
+	result = dns_adb_findaddrinfo(adb, &sa, &ai2, now);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(ai2->flags & 0x7, 0x5);
+	assert_int_equal(ai2->srtt, srtt);
+
+	dns_adb_setudpsize(adb, ai, 1232);
+	dns_adb_setudpsize(adb, ai2, 600);
+	assert_int_equal(dns_adb_getudpsize(adb, ai), 1232);
+
+	dns_adb_freeaddrinfo(adb, &ai);
+	dns_adb_freeaddrinfo(adb, &ai2);
+}
+
+int
+main(void) {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(grow_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(update_test,
+						_setup, _teardown),
+	};
+
+	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
+}
+
+#else /* HAVE_CMOCKA */
+
+#include <stdio.h>
+
+int
+main(void) {
+	printf("1..0 # Skipped: cmocka not available\n");
+	return (0);
+}
+
+#endif
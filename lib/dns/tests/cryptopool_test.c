@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <config.h>
+
+#if HAVE_CMOCKA
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <sched.h> /* IWYU pragma: keep */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/event.h>
+#include <isc/mutex.h>
+#include <isc/task.h>
+#include <isc/util.h>
+
+#include <dns/cryptopool.h>
+#include <dns/events.h>
+
+#include "dnstest.h"
+
+#define NJOBS 100
+
+typedef struct {
+	bool ran;
+	bool done;
+} job_t;
+
+static isc_mutex_t lock;
+static unsigned int ndone;
+
+static int
+_setup(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_test_begin(NULL, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_mutex_init(&lock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (0);
+}
+
+static int
+_teardown(void **state) {
+	UNUSED(state);
+
+	DESTROYLOCK(&lock);
+	dns_test_end();
+
+	return (0);
+}
+
+static void
+work(void *arg) {
+	job_t *job = arg;
+
+	job->ran = true;
+}
+
+static void
+done(isc_task_t *task, isc_event_t *event) {
+	job_t *job = event->ev_arg;
+
+	/*
+	 * This runs in the task manager's thread, so the checks are left
+	 * to run_test().
+	 */
+	job->done = (job->ran && task == maintask &&
+		     event->ev_type == DNS_EVENT_CRYPTODONE);
+	isc_event_free(&event);
+
+	LOCK(&lock);
+	ndone++;
+	UNLOCK(&lock);
+}
+
+/* dns_cryptopool_run */
+static void
+run_test(void **state) {
+	dns_cryptopool_t *pool = NULL, *pool2 = NULL;
+	job_t jobs[NJOBS];
+	unsigned int i, n;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_cryptopool_create(mctx, 4, &pool);
+#ifndef ISC_PLATFORM_USETHREADS
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+	skip();
+#endif
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_cryptopool_getworkers(pool), 4);
+
+	dns_cryptopool_attach(pool, &pool2);
+
+	memset(jobs, 0, sizeof(jobs));
+	ndone = 0;
+	for (i = 0; i < NJOBS; i++) {
+		result = dns_cryptopool_run(pool, mctx, work, maintask, done,
+					    &jobs[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	do {
+		dns_test_nap(1000);
+		LOCK(&lock);
+		n = ndone;
+		UNLOCK(&lock);
+	} while (n < NJOBS);
+
+	for (i = 0; i < NJOBS; i++)
+		assert_true(jobs[i].done);
+	assert_int_equal(dns_cryptopool_getqueued(pool), 0);
+
+	dns_cryptopool_detach(&pool2);
+	assert_null(pool2);
+	dns_cryptopool_detach(&pool);
+	assert_null(pool);
+}
+
+static void
+count(void *arg) {
+	unsigned int *counter = arg;
+
+	(*counter)++;
+}
+
+/* dns_cryptopool_runall */
+static void
+runall_test(void **state) {
+	dns_cryptopool_t *pool = NULL;
+	unsigned int counters[NJOBS];
+	unsigned int i;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_cryptopool_create(mctx, 4, &pool);
+#ifndef ISC_PLATFORM_USETHREADS
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+	skip();
+#endif
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	memset(counters, 0, sizeof(counters));
+	dns_cryptopool_runall(pool, mctx, count, counters, 0,
+			      sizeof(counters[0]));
+	for (i = 0; i < NJOBS; i++)
+		assert_int_equal(counters[i], 0);
+
+	/*
+	 * Every element is processed exactly once, and all of them are
+	 * done by the time the call returns.
+	 */
+	dns_cryptopool_runall(pool, mctx, count, counters, NJOBS,
+			      sizeof(counters[0]));
+	for (i = 0; i < NJOBS; i++)
+		assert_int_equal(counters[i], 1);
+	assert_int_equal(dns_cryptopool_getqueued(pool), 0);
+
+	dns_cryptopool_runall(pool, mctx, count, counters, 1,
+			      sizeof(counters[0]));
+	assert_int_equal(counters[0], 2);
+	assert_int_equal(counters[1], 1);
+
+	dns_cryptopool_detach(&pool);
+	assert_null(pool);
+}
+
+int
+main(void) {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(run_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(runall_test,
+						_setup, _teardown),
+	};
+
+	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
+}
+
+#else /* HAVE_CMOCKA */
+
+#include <stdio.h>
+
+int
+main(void) {
+	printf("1..0 # Skipped: cmocka not available\n");
+	return (0);
+}
+
+#endif
@@ -25,6 +25,7 @@
 #include <cmocka.h>
 
 #include <isc/print.h>
+#include <isc/thread.h>
 
 #include <dns/db.h>
 #include <dns/dbiterator.h>
@@ -209,6 +210,181 @@ version_test(void **state) {
 	dns_db_detach(&db);
 }
 
+static unsigned int
+nodelocks(dns_dbtype_t type) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	uint64_t waits[4];
+	unsigned int count;
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, type,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	count = dns_db_nodelockstats(db, waits, 4);
+	dns_db_detach(&db);
+
+	return (count);
+}
+
+/* node lock count */
+static void
+nodelocks_test(void **state) {
+	unsigned int count;
+
+	UNUSED(state);
+
+	/* Caches are sized from the CPU count, zones keep 7 */
+	assert_int_equal(dns_db_getnodelockcount(dns_dbtype_cache), 0);
+	count = nodelocks(dns_dbtype_cache);
+	assert_true(count >= 16 && count <= 64);
+	assert_int_equal(nodelocks(dns_dbtype_zone), 7);
+	assert_int_equal(nodelocks(dns_dbtype_stub), 7);
+
+	/* Explicit counts */
+	dns_db_setnodelockcount(dns_dbtype_cache, 100);
+	dns_db_setnodelockcount(dns_dbtype_zone, 3);
+	assert_int_equal(nodelocks(dns_dbtype_cache), 100);
+	assert_int_equal(nodelocks(dns_dbtype_zone), 3);
+	assert_int_equal(nodelocks(dns_dbtype_stub), 3);
+
+	dns_db_setnodelockcount(dns_dbtype_cache, 0);
+	dns_db_setnodelockcount(dns_dbtype_zone, 0);
+	assert_int_equal(nodelocks(dns_dbtype_cache), count);
+	assert_int_equal(nodelocks(dns_dbtype_zone), 7);
+}
+
+/* node lock wait counters */
+static void
+nodelockstats_test(void **state) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fname;
+	dns_dbnode_t *node = NULL;
+	uint64_t waits[1024];
+	unsigned int i, count;
+
+	UNUSED(state);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 "testdata/db/data.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Uncontended lookups never wait */
+	for (i = 0; i < 100; i++) {
+		dns_test_namefromstring("b.test.test", &fname);
+		result = dns_db_findnode(db, dns_fixedname_name(&fname),
+					 false, &node);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+	}
+
+	count = dns_db_nodelockstats(db, waits, 1024);
+	assert_true(count > 0);
+	for (i = 0; i < count; i++)
+		assert_int_equal(waits[i], 0);
+
+	/* Only 'count' elements are filled in */
+	waits[1] = 42;
+	assert_int_equal(dns_db_nodelockstats(db, waits, 1), count);
+	assert_int_equal(waits[1], 42);
+
+	dns_db_detach(&db);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+#define NREADERS	4
+#define NLOOKUPS	20000
+#define NNEWNAMES	2000
+
+static dns_db_t *cdb = NULL;
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+lookup_thread(isc_threadarg_t arg) {
+	unsigned int *found = arg;
+	dns_fixedname_t fname;
+	dns_dbnode_t *node;
+	isc_result_t result;
+	unsigned int i;
+
+	dns_test_namefromstring("b.test.test", &fname);
+	for (i = 0; i < NLOOKUPS; i++) {
+		node = NULL;
+		result = dns_db_findnode(cdb, dns_fixedname_name(&fname),
+					 false, &node);
+		if (result == ISC_R_SUCCESS) {
+			(*found)++;
+			dns_db_detachnode(cdb, &node);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+add_thread(isc_threadarg_t arg) {
+	unsigned int *added = arg;
+	dns_fixedname_t fname;
+	dns_dbnode_t *node;
+	isc_result_t result;
+	char namebuf[64];
+	unsigned int i;
+
+	for (i = 0; i < NNEWNAMES; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.test.test", i);
+		dns_test_namefromstring(namebuf, &fname);
+		node = NULL;
+		result = dns_db_findnode(cdb, dns_fixedname_name(&fname),
+					 true, &node);
+		if (result == ISC_R_SUCCESS) {
+			(*added)++;
+			dns_db_detachnode(cdb, &node);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/* lookups running concurrently with tree changes */
+static void
+concurrent_test(void **state) {
+	isc_result_t result;
+	isc_thread_t readers[NREADERS], writer;
+	unsigned int found[NREADERS], added = 0;
+	unsigned int i;
+
+	UNUSED(state);
+
+	result = dns_test_loaddb(&cdb, dns_dbtype_zone, "test.test",
+				 "testdata/db/data.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NREADERS; i++) {
+		found[i] = 0;
+		result = isc_thread_create(lookup_thread, &found[i],
+					   &readers[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	result = isc_thread_create(add_thread, &added, &writer);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NREADERS; i++)
+		isc_thread_join(readers[i], NULL);
+	isc_thread_join(writer, NULL);
+
+	for (i = 0; i < NREADERS; i++)
+		assert_int_equal(found[i], NLOOKUPS);
+	assert_int_equal(added, NNEWNAMES);
+
+	dns_db_detach(&cdb);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
 int
 main(void) {
 	const struct CMUnitTest tests[] = {
@@ -219,6 +395,14 @@ main(void) {
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(version_test,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(nodelocks_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(nodelockstats_test,
+						_setup, _teardown),
+#ifdef ISC_PLATFORM_USETHREADS
+		cmocka_unit_test_setup_teardown(concurrent_test,
+						_setup, _teardown),
+#endif
 	};
 
 	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
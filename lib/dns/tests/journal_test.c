@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <config.h>
+
+#if HAVE_CMOCKA
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <sched.h> /* IWYU pragma: keep */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/file.h>
+#include <isc/print.h>
+#include <isc/stdio.h>
+#include <isc/util.h>
+
+#include <dns/diff.h>
+#include <dns/journal.h>
+#include <dns/soa.h>
+
+#include "dnstest.h"
+
+#define JOURNAL		"testjournal.jnl"
+#define JDX		"testjournal.jdx"
+#define JDX_HEADER	16
+#define JDX_ENTRY	8
+#define NTRANS		500
+
+static int
+_setup(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_test_begin(NULL, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	(void)isc_file_remove(JOURNAL);
+	(void)isc_file_remove(JDX);
+
+	return (0);
+}
+
+static int
+_teardown(void **state) {
+	UNUSED(state);
+
+	(void)isc_file_remove(JOURNAL);
+	(void)isc_file_remove(JDX);
+
+	dns_test_end();
+
+	return (0);
+}
+
+/*
+ * Append transactions changing the serial number from 'first' to
+ * 'last' to the journal, one serial number at a time.
+ */
+static void
+write_transactions(uint32_t first, uint32_t last) {
+	dns_journal_t *j = NULL;
+	char oldsoa[100], newsoa[100], a[100];
+	zonechange_t changes[] = {
+		{ DNS_DIFFOP_DEL, "example.", 300, "SOA", oldsoa },
+		{ DNS_DIFFOP_ADD, "example.", 300, "SOA", newsoa },
+		{ DNS_DIFFOP_ADD, "host.example.", 300, "A", a },
+		ZONECHANGE_SENTINEL
+	};
+	dns_diff_t diff;
+	isc_result_t result;
+	uint32_t serial;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_CREATE, &j);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (serial = first; serial != last; serial++) {
+		snprintf(oldsoa, sizeof(oldsoa),
+			 "ns.example. hostmaster.example. %u 3600 600 "
+			 "86400 300", serial);
+		snprintf(newsoa, sizeof(newsoa),
+			 "ns.example. hostmaster.example. %u 3600 600 "
+			 "86400 300", serial + 1);
+		snprintf(a, sizeof(a), "10.53.%u.%u",
+			 (serial >> 8) & 0xff, serial & 0xff);
+
+		result = dns_test_difffromchanges(&diff, changes, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_journal_write_transaction(j, &diff);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_diff_clear(&diff);
+	}
+
+	dns_journal_destroy(&j);
+}
+
+static off_t
+jdx_size(void) {
+	off_t size = 0;
+
+	if (isc_file_getsize(JDX, &size) != ISC_R_SUCCESS)
+		return (-1);
+	return (size);
+}
+
+/*
+ * Check that the transactions from 'first' to 'last' can be found.
+ */
+static void
+check_lookups(uint32_t first, uint32_t last) {
+	dns_journal_t *j = NULL;
+	dns_name_t *name = NULL;
+	dns_rdata_t *rdata = NULL;
+	uint32_t serial, ttl;
+	size_t size, size1, size2;
+	isc_result_t result;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_journal_first_serial(j), first);
+	assert_int_equal(dns_journal_last_serial(j), last);
+
+	for (serial = first; serial < last; serial += 7) {
+		result = dns_journal_iter_init(j, serial, last);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_journal_first_rr(j);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_journal_current_rr(j, &name, &ttl, &rdata);
+		assert_int_equal(rdata->type, dns_rdatatype_soa);
+		assert_int_equal(dns_soa_getserial(rdata), serial);
+	}
+
+	/*
+	 * The sizes of consecutive ranges of transactions add up.
+	 */
+	serial = first + (last - first) / 3;
+	result = dns_journal_iter_init2(j, first, last, &size);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_journal_iter_init2(j, first, serial, &size1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_journal_iter_init2(j, serial, last, &size2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(size1 > 0);
+	assert_true(size2 > 0);
+	assert_int_equal(size, size1 + size2);
+	result = dns_journal_iter_init2(j, last, last, &size);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(size, 0);
+
+	result = dns_journal_iter_init(j, last + 1, last + 2);
+	assert_int_equal(result, ISC_R_RANGE);
+	if (first != 1) {
+		result = dns_journal_iter_init(j, first - 1, last);
+		assert_int_equal(result, ISC_R_RANGE);
+	}
+
+	dns_journal_destroy(&j);
+}
+
+/*
+ * transaction lookups and dns_journal_iter_init2, with and without the
+ * serial index file
+ */
+static void
+lookup_test(void **state) {
+	FILE *fp = NULL;
+	unsigned char garbage[JDX_HEADER + 10 * JDX_ENTRY];
+	unsigned int i;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	write_transactions(1, NTRANS + 1);
+	assert_int_equal(jdx_size(), JDX_HEADER + NTRANS * JDX_ENTRY);
+	check_lookups(1, NTRANS + 1);
+
+	/*
+	 * Without the serial index file, the journal is searched as
+	 * before, and the next writer recreates it.
+	 */
+	assert_int_equal(isc_file_remove(JDX), ISC_R_SUCCESS);
+	check_lookups(1, NTRANS + 1);
+	write_transactions(NTRANS + 1, NTRANS + 2);
+	assert_int_equal(jdx_size(), JDX_HEADER + (NTRANS + 1) * JDX_ENTRY);
+	check_lookups(1, NTRANS + 2);
+
+	/*
+	 * A serial index file whose entries do not match the journal
+	 * is ignored, and rebuilt by the next writer.
+	 */
+	result = isc_stdio_open(JDX, "rb+", &fp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_stdio_read(garbage, 1, JDX_HEADER, fp, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	for (i = 0; i < 10; i++) {
+		unsigned char *p = garbage + JDX_HEADER + i * JDX_ENTRY;
+		uint32_t serial = i + 1, offset = 1000 + 10 * i;
+
+		p[0] = p[1] = p[2] = 0;
+		p[3] = (unsigned char)serial;
+		p[4] = p[5] = 0;
+		p[6] = (unsigned char)(offset >> 8);
+		p[7] = (unsigned char)offset;
+	}
+	result = isc_stdio_seek(fp, 0, SEEK_SET);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_stdio_write(garbage, 1, sizeof(garbage), fp, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_stdio_close(fp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_file_truncate(JDX, sizeof(garbage)),
+			 ISC_R_SUCCESS);
+
+	check_lookups(1, NTRANS + 2);
+	write_transactions(NTRANS + 2, NTRANS + 3);
+	assert_int_equal(jdx_size(), JDX_HEADER + (NTRANS + 2) * JDX_ENTRY);
+	check_lookups(1, NTRANS + 3);
+}
+
+/* dns_journal_compact */
+static void
+compact_test(void **state) {
+	dns_journal_t *j = NULL;
+	char journal[] = JOURNAL;
+	uint32_t first, last;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	write_transactions(1, NTRANS + 1);
+
+	result = dns_journal_compact(mctx, journal, NTRANS / 2, 4096);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	first = dns_journal_first_serial(j);
+	last = dns_journal_last_serial(j);
+	dns_journal_destroy(&j);
+
+	/*
+	 * The compacted journal keeps the changes from NTRANS / 2 on,
+	 * and the serial index file moves with it.
+	 */
+	assert_true(first > 1);
+	assert_true(first <= NTRANS / 2);
+	assert_int_equal(last, NTRANS + 1);
+	assert_int_equal(jdx_size(), JDX_HEADER + (last - first) * JDX_ENTRY);
+	check_lookups(first, last);
+
+	write_transactions(last, last + 1);
+	assert_int_equal(jdx_size(),
+			 JDX_HEADER + (last + 1 - first) * JDX_ENTRY);
+	check_lookups(first, last + 1);
+}
+
+int
+main(void) {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(lookup_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(compact_test,
+						_setup, _teardown),
+	};
+
+	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
+}
+
+#else /* HAVE_CMOCKA */
+
+#include <stdio.h>
+
+int
+main(void) {
+	printf("1..0 # Skipped: cmocka not available\n");
+	return (0);
+}
+
+#endif
@@ -27,13 +27,18 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/file.h>
+#include <isc/mutex.h>
 #include <isc/print.h>
+#include <isc/ratelimiter.h>
 #include <isc/string.h>
+#include <isc/time.h>
 #include <isc/util.h>
 #include <isc/xml.h>
 
 #include <dns/cache.h>
 #include <dns/callbacks.h>
+#include <dns/cryptopool.h>
 #include <dns/db.h>
 #include <dns/master.h>
 #include <dns/masterdump.h>
@@ -552,6 +557,132 @@ dumpraw_test(void **state) {
 	dns_db_detach(&db);
 }
 
+static void
+addcache(dns_db_t *db, const char *owner, const char *address,
+	 dns_ttl_t ttl, dns_trust_t trust)
+{
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	unsigned char data[4];
+
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in,
+					  dns_rdatatype_a, data, sizeof(data),
+					  address, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = ttl;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	rdataset.trust = trust;
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static isc_result_t
+findcache(dns_db_t *db, const char *owner, dns_rdataset_t *rdataset) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_dbnode_t *node = NULL;
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), false, &node);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_a, 0, 0,
+				     rdataset, NULL);
+	dns_db_detachnode(db, &node);
+	return (result);
+}
+
+/*
+ * Cache snapshot test:
+ * a raw dump of a cache keeps the trust levels, and loading it ages
+ * the TTLs by the time that has passed since the dump
+ */
+static void
+dumpcache_test(void **state) {
+	isc_result_t result;
+	dns_db_t *db = NULL, *db2 = NULL;
+	dns_rdataset_t rdataset;
+	isc_stdtime_t now;
+	unsigned char dumptime[4];
+	FILE *f;
+
+	UNUSED(state);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	addcache(db, "a.example.", "10.0.0.1", 3600, dns_trust_answer);
+	addcache(db, "b.example.", "10.0.0.2", 60, dns_trust_glue);
+
+	result = dns_master_dump2(mctx, db, NULL, &dns_master_style_cache,
+				  "test.dump", dns_masterformat_raw);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = test_master("test.dump", dns_masterformat_raw,
+			     nullmsg, nullmsg);
+	assert_string_equal(isc_result_totext(result), "success");
+	assert_true(headerset);
+	assert_int_equal(header.version, DNS_RAWFORMAT_CACHEVERSION);
+	assert_true((header.flags & DNS_MASTERRAW_CACHE) != 0);
+
+	/*
+	 * Pretend the snapshot was written 1000 seconds ago: the first
+	 * RRset should come back with a reduced TTL, and the second
+	 * should have expired.
+	 */
+	isc_stdtime_get(&now);
+	now -= 1000;
+	dumptime[0] = (now >> 24) & 0xff;
+	dumptime[1] = (now >> 16) & 0xff;
+	dumptime[2] = (now >> 8) & 0xff;
+	dumptime[3] = now & 0xff;
+	f = fopen("test.dump", "r+b");
+	assert_non_null(f);
+	assert_int_equal(fseek(f, 8, SEEK_SET), 0);
+	assert_int_equal(fwrite(dumptime, 1, sizeof(dumptime), f),
+			 sizeof(dumptime));
+	fclose(f);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load2(db2, "test.dump", dns_masterformat_raw);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = findcache(db2, "a.example.", &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdataset.trust, dns_trust_answer);
+	assert_true(rdataset.ttl <= 2600);
+	assert_true(rdataset.ttl >= 2590);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = findcache(db2, "b.example.", &rdataset);
+	assert_int_not_equal(result, ISC_R_SUCCESS);
+
+	unlink("test.dump");
+	dns_db_detach(&db2);
+	dns_db_detach(&db);
+}
+
 static const char *warn_expect_value;
 static bool warn_expect_result;
 
@@ -592,6 +723,409 @@ neworigin_test(void **state) {
 	assert_true(warn_expect_result);
 }
 
+#define PARALLEL_FILE	"master-parallel.db"
+#define PARALLEL_INC	"master-parallel-inc.db"
+#define PARALLEL_COUNT	20000
+
+static isc_mutex_t parallel_lock;
+static bool parallel_done;
+static isc_result_t parallel_result;
+static uint64_t parallel_records;
+static uint64_t parallel_sum;
+static bool parallel_error;
+static unsigned int parallel_badline;
+
+static int
+_setup_parallel(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_test_begin(NULL, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_mutex_init(&parallel_lock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (0);
+}
+
+static int
+_teardown_parallel(void **state) {
+	UNUSED(state);
+
+	(void)unlink(PARALLEL_FILE);
+	(void)unlink(PARALLEL_INC);
+	DESTROYLOCK(&parallel_lock);
+	dns_test_end();
+
+	return (0);
+}
+
+/*
+ * Add a hash of each rdata, with its owner, type and TTL, so that the
+ * result does not depend on the order in which rdatasets are added.
+ */
+static isc_result_t
+parallel_add(void *arg, dns_name_t *owner, dns_rdataset_t *dataset) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_result_t result;
+	uint64_t hash;
+	unsigned int i;
+
+	UNUSED(arg);
+
+	for (result = dns_rdataset_first(dataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(dataset))
+	{
+		dns_rdataset_current(dataset, &rdata);
+		hash = 14695981039346656037ULL;
+		for (i = 0; i < owner->length; i++)
+			hash = (hash ^ owner->ndata[i]) * 1099511628211ULL;
+		hash = (hash ^ dataset->type) * 1099511628211ULL;
+		hash = (hash ^ dataset->ttl) * 1099511628211ULL;
+		for (i = 0; i < rdata.length; i++)
+			hash = (hash ^ rdata.data[i]) * 1099511628211ULL;
+		parallel_sum += hash;
+		parallel_records++;
+		dns_rdata_reset(&rdata);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static void
+parallel_errmsg(dns_rdatacallbacks_t *cb, const char *fmt, ...) {
+	char buf[4096];
+	char expect[100];
+	va_list ap;
+
+	UNUSED(cb);
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	snprintf(expect, sizeof(expect), "%s:%u:", PARALLEL_FILE,
+		 parallel_badline);
+	LOCK(&parallel_lock);
+	if (strstr(buf, expect) != NULL)
+		parallel_error = true;
+	UNLOCK(&parallel_lock);
+}
+
+static void
+parallel_loaddone(void *arg, isc_result_t result) {
+	UNUSED(arg);
+
+	LOCK(&parallel_lock);
+	parallel_result = result;
+	parallel_done = true;
+	UNLOCK(&parallel_lock);
+}
+
+/*
+ * Write a zone of about 4MB that uses the constructs the cutting of
+ * the file must not be confused by.  With 'bad', a record that cannot
+ * be parsed is put near the end, on line 'parallel_badline'.  With
+ * 'include', halfway through the zone a file that changes the default
+ * TTL is included, after which the zone cannot be cut.
+ */
+static void
+write_parallel(bool bad, bool include) {
+	FILE *f;
+	unsigned int i, line;
+
+	if (include) {
+		f = fopen(PARALLEL_INC, "w");
+		assert_non_null(f);
+		fprintf(f, "$TTL 1234\n"
+			   "inc A 10.9.9.9\n");
+		assert_int_equal(fclose(f), 0);
+	}
+
+	f = fopen(PARALLEL_FILE, "w");
+	assert_non_null(f);
+
+	fprintf(f, "$TTL 300\n"
+		   "@ IN SOA ns hostmaster (\n"
+		   "\t1 ; serial\n"
+		   "\t3600 1200 604800 300 )\n");
+	line = 5;
+	for (i = 0; i < PARALLEL_COUNT; i++) {
+		if (i % 1000 == 0) {
+			fprintf(f, "$ORIGIN sub%u.test.\n", i / 1000);
+			line++;
+		}
+		if (i % 3000 == 1500) {
+			fprintf(f, "$TTL %u ; changed\n", 300 + i);
+			line++;
+		}
+		if (include && i == PARALLEL_COUNT / 2) {
+			fprintf(f, "$INCLUDE %s\n", PARALLEL_INC);
+			line++;
+		}
+		if (bad && i == PARALLEL_COUNT * 3 / 4) {
+			fprintf(f, "bad A 10.0.0.256\n");
+			parallel_badline = line;
+		} else
+			fprintf(f, "h%u A 10.0.%u.%u ; a \"comment\" (\n",
+				i, i / 256 % 256, i % 256);
+		fprintf(f, "\tAAAA 2001:db8::%x\n", i);
+		fprintf(f, "t%u 600 TXT \"; not a comment (\" "
+			   "\"\\\"quoted\\\" )\"\n"
+			   "mx%u MX ( 10 ; first line\n"
+			   "\tmail%u.test. )\n"
+			   "; a comment\n"
+			   "\n",
+			i, i, i);
+		line += 7;
+	}
+	assert_int_equal(fclose(f), 0);
+}
+
+static isc_result_t
+load_parallel(dns_cryptopool_t *pool, dns_masterloadstats_t *stats) {
+	dns_loadctx_t *lctx = NULL;
+	isc_result_t result;
+	bool done;
+
+	dns_rdatacallbacks_init_stdio(&callbacks);
+	callbacks.add = parallel_add;
+	callbacks.error = parallel_errmsg;
+	callbacks.warn = nullmsg;
+
+	parallel_done = false;
+	parallel_records = 0;
+	parallel_sum = 0;
+	parallel_error = false;
+
+	result = dns_master_loadfileinc6(PARALLEL_FILE, &dns_origin,
+					 &dns_origin, dns_rdataclass_in,
+					 DNS_MASTER_ZONE, 0, &callbacks,
+					 maintask, parallel_loaddone, NULL,
+					 &lctx, NULL, NULL, mctx,
+					 dns_masterformat_text, 0, pool);
+	assert_int_equal(result, DNS_R_CONTINUE);
+
+	do {
+		dns_test_nap(1000);
+		LOCK(&parallel_lock);
+		done = parallel_done;
+		UNLOCK(&parallel_lock);
+	} while (!done);
+
+	dns_loadctx_getstats(lctx, stats);
+	dns_loadctx_detach(&lctx);
+	return (parallel_result);
+}
+
+/*
+ * Parallel load test:
+ * dns_master_loadfileinc6() and dns_master_loadfile6() with a pool add
+ * the same records as they do without one, and report errors at the
+ * right line
+ */
+static void
+parallel_test(void **state) {
+	dns_cryptopool_t *pool = NULL;
+	dns_masterloadstats_t stats;
+	uint64_t records, sum;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_cryptopool_create(mctx, 4, &pool);
+#ifndef ISC_PLATFORM_USETHREADS
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+	skip();
+#endif
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = setup_master(nullmsg, nullmsg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	write_parallel(false, false);
+
+	result = load_parallel(NULL, &stats);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(stats.threads, 0);
+	assert_int_equal(stats.records, 1 + 4 * PARALLEL_COUNT);
+	assert_int_equal(parallel_records, stats.records);
+	assert_true(stats.bytes > 2 * 1024 * 1024);
+	records = parallel_records;
+	sum = parallel_sum;
+
+	result = load_parallel(pool, &stats);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(stats.threads, 4);
+	assert_int_equal(stats.records, records);
+	assert_int_equal(parallel_records, records);
+	assert_true(parallel_sum == sum);
+
+	/*
+	 * Without a task, the calling thread waits for the pool.
+	 */
+	parallel_records = 0;
+	parallel_sum = 0;
+	result = dns_master_loadfile6(PARALLEL_FILE, &dns_origin,
+				      &dns_origin, dns_rdataclass_in,
+				      DNS_MASTER_ZONE, 0, &callbacks, NULL,
+				      NULL, mctx, dns_masterformat_text, 0,
+				      pool, &stats);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(stats.threads, 4);
+	assert_int_equal(stats.records, records);
+	assert_int_equal(parallel_records, records);
+	assert_true(parallel_sum == sum);
+
+	write_parallel(true, false);
+
+	result = load_parallel(pool, &stats);
+	assert_int_equal(result, DNS_R_BADDOTTEDQUAD);
+	assert_true(parallel_error);
+
+	/*
+	 * The chunks before the $INCLUDE are parsed by the pool, and the
+	 * rest of the file by load_text().
+	 */
+	write_parallel(false, true);
+
+	result = load_parallel(NULL, &stats);
+	assert_int_equal(result, DNS_R_SEENINCLUDE);
+	assert_int_equal(stats.records, 2 + 4 * PARALLEL_COUNT);
+	records = parallel_records;
+	sum = parallel_sum;
+
+	result = load_parallel(pool, &stats);
+	assert_int_equal(result, DNS_R_SEENINCLUDE);
+	assert_int_equal(stats.threads, 4);
+	assert_int_equal(stats.records, records);
+	assert_int_equal(parallel_records, records);
+	assert_true(parallel_sum == sum);
+
+	parallel_records = 0;
+	parallel_sum = 0;
+	result = dns_master_loadfile6(PARALLEL_FILE, &dns_origin,
+				      &dns_origin, dns_rdataclass_in,
+				      DNS_MASTER_ZONE, 0, &callbacks, NULL,
+				      NULL, mctx, dns_masterformat_text, 0,
+				      pool, &stats);
+	assert_int_equal(result, DNS_R_SEENINCLUDE);
+	assert_int_equal(stats.threads, 4);
+	assert_int_equal(parallel_records, records);
+	assert_true(parallel_sum == sum);
+
+	dns_cryptopool_detach(&pool);
+}
+
+#define DUMP_FILE	"master-dump.db"
+#define DUMP_FILE2	"master-dump2.db"
+#define DUMP_CHUNK	16384
+
+static void
+dumprate_done(void *arg, isc_result_t result) {
+	UNUSED(arg);
+
+	LOCK(&parallel_lock);
+	parallel_result = result;
+	parallel_done = true;
+	UNLOCK(&parallel_lock);
+}
+
+static unsigned char *
+dumprate_read(const char *file, off_t *sizep) {
+	unsigned char *data;
+	FILE *f;
+
+	assert_int_equal(isc_file_getsize(file, sizep), ISC_R_SUCCESS);
+	data = isc_mem_get(mctx, (size_t)*sizep);
+	assert_non_null(data);
+	f = fopen(file, "r");
+	assert_non_null(f);
+	assert_int_equal(fread(data, 1, (size_t)*sizep, f), (size_t)*sizep);
+	fclose(f);
+	return (data);
+}
+
+/*
+ * Throttled dump test:
+ * dns_master_dumpinc4() with a rate limiter writes the same file as
+ * dns_master_dump3(), one chunk per tick of the rate limiter
+ */
+static void
+dumprate_test(void **state) {
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_dumpctx_t *dctx = NULL;
+	isc_ratelimiter_t *rl = NULL;
+	isc_interval_t interval;
+	isc_time_t start, end;
+	unsigned char *data, *data2;
+	off_t size, size2;
+	bool done;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	write_parallel(false, false);
+	result = dns_test_loaddb(&db, dns_dbtype_zone, TEST_ORIGIN,
+				 PARALLEL_FILE);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_currentversion(db, &version);
+
+	result = dns_master_dump3(mctx, db, version,
+				  &dns_master_style_default, DUMP_FILE,
+				  dns_masterformat_text, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_ratelimiter_create(mctx, timermgr, maintask, &rl);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_interval_set(&interval, 0, 1000000);
+	result = isc_ratelimiter_setinterval(rl, &interval);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_ratelimiter_setpertic(rl, 1);
+
+	parallel_done = false;
+	isc_time_now(&start);
+	result = dns_master_dumpinc4(mctx, db, version,
+				     &dns_master_style_default, DUMP_FILE2,
+				     maintask, dumprate_done, NULL, &dctx,
+				     dns_masterformat_text, NULL, rl,
+				     DUMP_CHUNK);
+	assert_int_equal(result, DNS_R_CONTINUE);
+
+	do {
+		dns_test_nap(1000);
+		LOCK(&parallel_lock);
+		done = parallel_done;
+		UNLOCK(&parallel_lock);
+	} while (!done);
+	isc_time_now(&end);
+	assert_int_equal(parallel_result, ISC_R_SUCCESS);
+	dns_dumpctx_detach(&dctx);
+
+	data = dumprate_read(DUMP_FILE, &size);
+	data2 = dumprate_read(DUMP_FILE2, &size2);
+	assert_int_equal(size, size2);
+	assert_memory_equal(data, data2, (size_t)size);
+	isc_mem_put(mctx, data, (size_t)size);
+	isc_mem_put(mctx, data2, (size_t)size2);
+
+	/*
+	 * Every chunk but the first two waited for a tick.
+	 */
+	assert_true(isc_time_microdiff(&end, &start) >=
+		    (uint64_t)(size / DUMP_CHUNK - 2) * 1000);
+
+	isc_ratelimiter_shutdown(rl);
+	isc_ratelimiter_detach(&rl);
+	dns_db_closeversion(db, &version, false);
+	dns_db_detach(&db);
+	(void)unlink(DUMP_FILE);
+	(void)unlink(DUMP_FILE2);
+}
+
 int
 main(void) {
 	const struct CMUnitTest tests[] = {
@@ -625,12 +1159,20 @@ main(void) {
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(dumpraw_test,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(dumpcache_test,
+						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(toobig_test,
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(maxrdata_test,
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(neworigin_test,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(parallel_test,
+						_setup_parallel,
+						_teardown_parallel),
+		cmocka_unit_test_setup_teardown(dumprate_test,
+						_setup_parallel,
+						_teardown_parallel),
 	};
 
 	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
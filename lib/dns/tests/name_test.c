@@ -33,6 +33,7 @@
 #include <isc/os.h>
 #include <isc/print.h>
 #include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/compress.h>
@@ -183,6 +184,96 @@ compress_test(dns_name_t *name1, dns_name_t *name2, dns_name_t *name3,
 	assert_true(memcmp(target.base, expected, target.used) == 0);
 }
 
+/*
+ * Build a name with a single label of 'length' octets from 'data'.
+ */
+static void
+label_name(const unsigned char *data, unsigned int length,
+	   unsigned char *wire, dns_name_t *name)
+{
+	isc_region_t r;
+
+	wire[0] = length;
+	memmove(wire + 1, data, length);
+	wire[length + 1] = 0;
+	r.base = wire;
+	r.length = length + 2;
+	dns_name_init(name, NULL);
+	dns_name_fromregion(name, &r);
+}
+
+/* case folding of labels of every length, at every octet */
+static void
+casefold_test(void **state) {
+	/* Octets around the upper and lower case ranges. */
+	static const unsigned char edges[] = {
+		'@', 'A', 'M', 'Z', '[', '`', 'a', 'm', 'z', '{',
+		0xc1, 0xda, 0xe1, 0xfa, 0x00, 0x7f, 0x80, 0xff
+	};
+	unsigned char upper[63], lower[63], other[63];
+	unsigned char w1[65], w2[65], w3[65];
+	dns_name_t n1, n2, n3, *down;
+	dns_fixedname_t fdown;
+	unsigned int length, pos, e, nlabels;
+	unsigned char c, lc;
+	int order;
+
+	UNUSED(state);
+
+	for (length = 1; length <= 63; length++) {
+		for (pos = 0; pos < length; pos++) {
+			upper[pos] = 'A' + pos % 26;
+			lower[pos] = 'a' + pos % 26;
+		}
+		for (pos = 0; pos < length; pos++) {
+			for (e = 0; e < sizeof(edges); e++) {
+				c = edges[e];
+				lc = (c >= 'A' && c <= 'Z') ? c + 32 : c;
+
+				memmove(other, upper, length);
+				other[pos] = c;
+				label_name(other, length, w1, &n1);
+				memmove(other, lower, length);
+				other[pos] = lc;
+				label_name(other, length, w2, &n2);
+
+				/* Equal ignoring case. */
+				assert_true(dns_name_equal(&n1, &n2));
+				assert_int_equal(dns_name_fullcompare(&n1, &n2,
+								      &order,
+								      &nlabels),
+						 dns_namereln_equal);
+				assert_int_equal(dns_name_rdatacompare(&n1,
+								       &n2),
+						 0);
+
+				/* Downcasing gives the lower case name. */
+				down = dns_fixedname_initname(&fdown);
+				assert_int_equal(dns_name_downcase(&n1, down,
+								   NULL),
+						 ISC_R_SUCCESS);
+				assert_true(dns_name_caseequal(down, &n2));
+
+				/*
+				 * Raising one octet orders the names by
+				 * that octet.
+				 */
+				if (lc == 0xff)
+					continue;
+				other[pos] = lc + 1;
+				label_name(other, length, w3, &n3);
+				assert_false(dns_name_equal(&n2, &n3));
+				(void)dns_name_fullcompare(&n2, &n3, &order,
+							   &nlabels);
+				assert_true(order < 0);
+				assert_int_equal(dns_name_rdatacompare(&n3,
+								       &n2),
+						 1);
+			}
+		}
+	}
+}
+
 /* name compression test */
 static void
 compression_test(void **state) {
@@ -678,6 +769,141 @@ getlabelsequence_test(void **state) {
 	}
 }
 
+/*
+ * Render the names "host<i>.zone<i % 50>.example." for 'first' <= i < 'last'
+ * into 'target', with 'upper' choosing upper case host labels.
+ */
+static void
+render_names(dns_compress_t *cctx, isc_buffer_t *target,
+	     unsigned int first, unsigned int last, bool upper)
+{
+	dns_fixedname_t fname;
+	char namestr[64];
+	unsigned int i;
+
+	for (i = first; i < last; i++) {
+		snprintf(namestr, sizeof(namestr), "%s%u.zone%u.example.",
+			 upper ? "HOST" : "host", i, i % 50);
+		dns_test_namefromstring(namestr, &fname);
+		assert_int_equal(dns_name_towire(dns_fixedname_name(&fname),
+						 cctx, target),
+				 ISC_R_SUCCESS);
+	}
+}
+
+/*
+ * Decompress the names rendered by render_names() from 'source'.
+ */
+static void
+check_names(isc_buffer_t *source, unsigned int first, unsigned int last,
+	    bool upper)
+{
+	dns_fixedname_t fname, fexpect;
+	dns_decompress_t dctx;
+	dns_name_t *name;
+	char namestr[64];
+	unsigned int i;
+
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_STRICT);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+
+	for (i = first; i < last; i++) {
+		snprintf(namestr, sizeof(namestr), "%s%u.zone%u.example.",
+			 upper ? "HOST" : "host", i, i % 50);
+		dns_test_namefromstring(namestr, &fexpect);
+		name = dns_fixedname_initname(&fname);
+		assert_int_equal(dns_name_fromwire(name, source, &dctx, 0,
+						   NULL),
+				 ISC_R_SUCCESS);
+		assert_true(dns_name_caseequal(name,
+					       dns_fixedname_name(&fexpect)));
+	}
+
+	dns_decompress_invalidate(&dctx);
+}
+
+/* compression table growth and rollback */
+static void
+compression_table_test(void **state) {
+	static unsigned char buf[65535];
+	dns_compress_t cctx;
+	isc_buffer_t target, source;
+	unsigned int middle;
+
+	UNUSED(state);
+
+	assert_int_equal(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	dns_compress_setsensitive(&cctx, true);
+
+	/*
+	 * Enough names to outgrow the preallocated table, nodes and
+	 * name data, and to run past the 14 bit pointer range.
+	 */
+	isc_buffer_init(&target, buf, sizeof(buf));
+	render_names(&cctx, &target, 0, 1000, false);
+	middle = isc_buffer_usedlength(&target);
+	render_names(&cctx, &target, 1000, 3000, false);
+	assert_true(isc_buffer_usedlength(&target) > 0x4000);
+
+	isc_buffer_init(&source, buf, isc_buffer_usedlength(&target));
+	isc_buffer_add(&source, isc_buffer_usedlength(&target));
+	isc_buffer_setactive(&source, isc_buffer_usedlength(&target));
+	check_names(&source, 0, 3000, false);
+
+	/*
+	 * Roll back the second part and render it again in upper case;
+	 * nothing may point into the discarded names, and the host
+	 * labels must not point to lower case copies.
+	 */
+	dns_compress_rollback(&cctx, (uint16_t)middle);
+	isc_buffer_subtract(&target, isc_buffer_usedlength(&target) - middle);
+	render_names(&cctx, &target, 1000, 3000, true);
+	memset(buf + isc_buffer_usedlength(&target), 0xff,
+	       sizeof(buf) - isc_buffer_usedlength(&target));
+
+	isc_buffer_init(&source, buf, isc_buffer_usedlength(&target));
+	isc_buffer_add(&source, isc_buffer_usedlength(&target));
+	isc_buffer_setactive(&source, isc_buffer_usedlength(&target));
+	check_names(&source, 0, 1000, false);
+	check_names(&source, 1000, 3000, true);
+
+	dns_compress_rollback(&cctx, 0);
+	dns_compress_invalidate(&cctx);
+}
+
+/* case insensitive compression */
+static void
+compression_case_test(void **state) {
+	unsigned char buf[1024];
+	dns_compress_t cctx;
+	dns_fixedname_t f1, f2;
+	isc_buffer_t target;
+	unsigned int used;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("www.example.", &f1);
+	dns_test_namefromstring("WWW.Example.", &f2);
+
+	assert_int_equal(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+
+	isc_buffer_init(&target, buf, sizeof(buf));
+	assert_int_equal(dns_name_towire(dns_fixedname_name(&f1), &cctx,
+					 &target), ISC_R_SUCCESS);
+	used = isc_buffer_usedlength(&target);
+	assert_int_equal(dns_name_towire(dns_fixedname_name(&f2), &cctx,
+					 &target), ISC_R_SUCCESS);
+
+	/* The second name is a pointer to the first. */
+	assert_int_equal(isc_buffer_usedlength(&target), used + 2);
+	assert_int_equal(buf[used], 0xc0);
+	assert_int_equal(buf[used + 1], 0);
+
+	dns_compress_invalidate(&cctx);
+}
+
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 
@@ -768,12 +994,139 @@ benchmark_test(void **state) {
 #endif /* DNS_BENCHMARK_TESTS */
 #endif /* ISC_PLATFORM_USETHREADS */
 
+#ifdef DNS_BENCHMARK_TESTS
+
+/* Benchmark name compression of a referral with glue */
+static void
+compress_benchmark_test(void **state) {
+	static const char *names[] = {
+		"example.com.",
+		"a.gtld-servers.net.", "b.gtld-servers.net.",
+		"c.gtld-servers.net.", "d.gtld-servers.net.",
+		"e.gtld-servers.net.", "f.gtld-servers.net.",
+		"g.gtld-servers.net.", "h.gtld-servers.net.",
+		"i.gtld-servers.net.", "j.gtld-servers.net.",
+		"k.gtld-servers.net.", "l.gtld-servers.net.",
+		"m.gtld-servers.net.",
+	};
+	unsigned int maxval = 1000000;
+	dns_fixedname_t fnames[sizeof(names) / sizeof(names[0])];
+	unsigned char buf[4096];
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	isc_result_t result;
+	isc_time_t ts1, ts2;
+	unsigned int i, j, k, n = sizeof(names) / sizeof(names[0]);
+	double t;
+
+	UNUSED(state);
+
+	debug_mem_record = false;
+
+	for (j = 0; j < n; j++)
+		dns_test_namefromstring(names[j], &fnames[j]);
+
+	result = isc_time_now(&ts1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < maxval; i++) {
+		isc_buffer_init(&target, buf, sizeof(buf));
+		dns_compress_init(&cctx, -1, mctx);
+		dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+		/* Question, authority NS records, then A and AAAA glue. */
+		(void)dns_name_towire(dns_fixedname_name(&fnames[0]), &cctx,
+				      &target);
+		for (j = 1; j < n; j++) {
+			(void)dns_name_towire(dns_fixedname_name(&fnames[0]),
+					      &cctx, &target);
+			(void)dns_name_towire(dns_fixedname_name(&fnames[j]),
+					      &cctx, &target);
+		}
+		for (k = 0; k < 2; k++) {
+			for (j = 1; j < n; j++) {
+				(void)dns_name_towire(
+					dns_fixedname_name(&fnames[j]),
+					&cctx, &target);
+			}
+		}
+		dns_compress_invalidate(&cctx);
+	}
+
+	result = isc_time_now(&ts2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	t = isc_time_microdiff(&ts2, &ts1);
+
+	printf("%u referrals compressed, %f seconds, %f referrals/second\n",
+	       maxval, t / 1000000.0, maxval / (t / 1000000.0));
+}
+
+
+/* Benchmark case-insensitive name comparison and downcasing */
+static void
+compare_benchmark_test(void **state) {
+	static const char *names[][2] = {
+		{ "www.example.com.", "WWW.Example.COM." },
+		{ "_443._tcp.mail.subdomain.example-company.co.uk.",
+		  "_443._TCP.Mail.SubDomain.Example-Company.CO.UK." },
+		{ "a.very.long.label.sequence.of.many.labels.example.net.",
+		  "a.very.long.label.sequence.of.many.labels.example.org." },
+	};
+	unsigned int maxval = 10000000;
+	unsigned int i, j, n = sizeof(names) / sizeof(names[0]);
+	dns_fixedname_t f1[3], f2[3], fdown;
+	dns_name_t *down;
+	isc_result_t result;
+	isc_time_t ts1, ts2;
+	unsigned int nlabels;
+	int order;
+	double t;
+
+	UNUSED(state);
+
+	for (j = 0; j < n; j++) {
+		dns_test_namefromstring(names[j][0], &f1[j]);
+		dns_test_namefromstring(names[j][1], &f2[j]);
+	}
+	down = dns_fixedname_initname(&fdown);
+
+	result = isc_time_now(&ts1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < maxval; i++) {
+		j = i % n;
+		(void)dns_name_equal(dns_fixedname_name(&f1[j]),
+				     dns_fixedname_name(&f2[j]));
+		(void)dns_name_fullcompare(dns_fixedname_name(&f1[j]),
+					   dns_fixedname_name(&f2[j]),
+					   &order, &nlabels);
+		(void)dns_name_downcase(dns_fixedname_name(&f2[j]), down,
+					NULL);
+	}
+
+	result = isc_time_now(&ts2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	t = isc_time_microdiff(&ts2, &ts1);
+
+	printf("%u dns_name_equal(), dns_name_fullcompare() and "
+	       "dns_name_downcase() calls, %f seconds, %f calls/second\n",
+	       maxval, t / 1000000.0, maxval / (t / 1000000.0));
+}
+
+#endif /* DNS_BENCHMARK_TESTS */
+
 int
 main(int argc, char **argv) {
 	const struct CMUnitTest tests[] = {
 		cmocka_unit_test(fullcompare_test),
 		cmocka_unit_test_setup_teardown(compression_test,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(compression_table_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(compression_case_test,
+						_setup, _teardown),
+		cmocka_unit_test(casefold_test),
 		cmocka_unit_test(istat_test),
 		cmocka_unit_test(init_test),
 		cmocka_unit_test(invalidate_test),
@@ -790,6 +1143,12 @@ main(int argc, char **argv) {
 						_setup, _teardown),
 #endif /* DNS_BENCHMARK_TESTS */
 #endif /* ISC_PLATFORM_USETHREADS */
+#ifdef DNS_BENCHMARK_TESTS
+		cmocka_unit_test_setup_teardown(compress_benchmark_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(compare_benchmark_test,
+						_setup, _teardown),
+#endif /* DNS_BENCHMARK_TESTS */
 	};
 	int c;
 
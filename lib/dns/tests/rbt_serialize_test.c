@@ -131,14 +131,17 @@ delete_data(void *data, void *arg) {
 }
 
 static isc_result_t
-write_data(FILE *file, unsigned char *datap, void *arg, uint64_t *crc) {
+write_data(FILE *file, unsigned char *datap, void *arg, uintptr_t node,
+	   uint64_t *crc)
+{
 	isc_result_t result;
 	size_t ret = 0;
 	data_holder_t *data;
 	data_holder_t temp;
 	off_t where;
+	uintptr_t base = (arg != NULL) ? *(uintptr_t *)arg : 0;
 
-	UNUSED(arg);
+	UNUSED(node);
 
 	REQUIRE(file != NULL);
 	REQUIRE(crc != NULL);
@@ -155,7 +158,8 @@ write_data(FILE *file, unsigned char *datap, void *arg, uint64_t *crc) {
 	temp = *data;
 	temp.data = (data->len == 0
 		     ? NULL
-		     : (char *)((uintptr_t)where + sizeof(data_holder_t)));
+		     : (char *)(base + (uintptr_t)where +
+				sizeof(data_holder_t)));
 
 	isc_crc64_update(crc, (void *)&temp, sizeof(temp));
 	ret = fwrite(&temp, sizeof(data_holder_t), 1, file);
@@ -194,9 +198,9 @@ fix_data(dns_rbtnode_t *p, void *base, size_t max, void *arg, uint64_t *crc) {
 		return (ISC_R_INVALIDFILE);
 	}
 
-	size = max - ((char *)p - (char *)base);
+	size = max - ((char *)data - (char *)base);
 
-	if (data->len > (int) size || data->data > (const char *) max) {
+	if (size < sizeof(*data) || data->len > (int) size) {
 		return (ISC_R_INVALIDFILE);
 	}
 
@@ -286,6 +290,8 @@ check_test_data(dns_rbt_t *rbt) {
 		result = dns_rbt_findname(rbt, name, 0, foundname,
 					  (void *) &data);
 		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_non_null(data);
+		assert_string_equal(data->data, testdatap->data.data);
 
 		testdatap++;
 	}
@@ -328,7 +334,7 @@ serialize_test(void **state) {
 	 */
 	rbtfile = fopen("./zone.bin", "w+b");
 	assert_non_null(rbtfile);
-	result = dns_rbt_serialize_tree(rbtfile, rbt, write_data, NULL,
+	result = dns_rbt_serialize_tree(rbtfile, rbt, write_data, NULL, 0,
 					&offset);
 	assert_true(result == ISC_R_SUCCESS);
 	dns_rbt_destroy(&rbt);
@@ -347,7 +353,7 @@ serialize_test(void **state) {
 
 	result = dns_rbt_deserialize_tree(base, filesize, 0, mctx,
 					  delete_data, NULL, fix_data, NULL,
-					  NULL, &rbt_deserialized);
+					  false, NULL, &rbt_deserialized);
 
 	/* Test to make sure we have a valid tree */
 	assert_true(result == ISC_R_SUCCESS);
@@ -390,7 +396,7 @@ deserialize_corrupt_test(void **state) {
 	add_test_data(mctx, rbt);
 	rbtfile = fopen("./zone.bin", "w+b");
 	assert_non_null(rbtfile);
-	result = dns_rbt_serialize_tree(rbtfile, rbt, write_data, NULL,
+	result = dns_rbt_serialize_tree(rbtfile, rbt, write_data, NULL, 0,
 					&offset);
 	assert_true(result == ISC_R_SUCCESS);
 	dns_rbt_destroy(&rbt);
@@ -420,7 +426,7 @@ deserialize_corrupt_test(void **state) {
 
 		result = dns_rbt_deserialize_tree(base, filesize, 0, mctx,
 						  delete_data, NULL,
-						  fix_data, NULL,
+						  fix_data, NULL, false,
 						  NULL, &rbt_deserialized);
 
 		/* Test to make sure we have a valid tree */
@@ -440,6 +446,130 @@ deserialize_corrupt_test(void **state) {
 	unlink("zone.bin");
 }
 
+/*
+ * Test loading a tree at the address it was written for, which
+ * uses the image as it is once it has been checked, or without
+ * checking it if the caller trusts it.
+ */
+static void
+serialize_prelinked_test(void **state) {
+	dns_rbt_t *rbt = NULL;
+	isc_result_t result;
+	FILE *rbtfile = NULL;
+	dns_rbt_t *rbt_deserialized = NULL;
+	data_holder_t *data;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	char *p;
+	off_t offset;
+	int fd;
+	off_t filesize = 0;
+	char *base;
+	uintptr_t want;
+	size_t size = 1024 * 1024;
+
+	UNUSED(state);
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	/*
+	 * Find an address range that is likely to still be free when
+	 * the file is mapped.
+	 */
+	base = mmap(NULL, size, PROT_READ, MAP_ANON|MAP_PRIVATE, -1, 0);
+	assert_true(base != NULL && base != MAP_FAILED);
+	want = (uintptr_t)base;
+	munmap(base, size);
+
+	result = dns_rbt_create(mctx, delete_data, NULL, &rbt);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	add_test_data(mctx, rbt);
+
+	rbtfile = fopen("./zone.bin", "w+b");
+	assert_non_null(rbtfile);
+	result = dns_rbt_serialize_tree(rbtfile, rbt, write_data, &want,
+					want, &offset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(offset, 0);
+	fclose(rbtfile);
+	dns_rbt_destroy(&rbt);
+
+	fd = open("zone.bin", O_RDWR);
+	assert_int_not_equal(fd, -1);
+	isc_file_getsizefd(fd, &filesize);
+	assert_true((size_t)filesize <= size);
+	base = mmap((void *)want, filesize, PROT_READ|PROT_WRITE,
+		    MAP_FILE|MAP_PRIVATE, fd, 0);
+	assert_true(base != NULL && base != MAP_FAILED);
+	close(fd);
+
+	result = dns_rbt_deserialize_tree(base, filesize, 0, mctx,
+					  delete_data, NULL, fix_data, NULL,
+					  false, NULL, &rbt_deserialized);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_non_null(rbt_deserialized);
+
+	check_test_data(rbt_deserialized);
+
+	/*
+	 * A change to the data is found by the CRC check.
+	 */
+	name = dns_fixedname_initname(&fname);
+	dns_test_namefromstring("one.net.", &fname);
+	data = NULL;
+	result = dns_rbt_findname(rbt_deserialized, name, 0, NULL,
+				  (void *) &data);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(data->data > base && data->data < base + filesize);
+	DE_CONST(data->data, p);
+	dns_rbt_destroy(&rbt_deserialized);
+
+	*p ^= 0x20;
+	result = dns_rbt_deserialize_tree(base, filesize, 0, mctx,
+					  delete_data, NULL, fix_data, NULL,
+					  false, NULL, &rbt_deserialized);
+	assert_int_equal(result, ISC_R_INVALIDFILE);
+	assert_null(rbt_deserialized);
+	*p ^= 0x20;
+
+	/*
+	 * An image that does not fit in the file is rejected even when
+	 * it is trusted.
+	 */
+	result = dns_rbt_deserialize_tree(base, filesize - 1, 0, mctx,
+					  delete_data, NULL, NULL, NULL,
+					  true, NULL, &rbt_deserialized);
+	assert_int_equal(result, ISC_R_INVALIDFILE);
+	assert_null(rbt_deserialized);
+
+	/*
+	 * If the address was taken after all, the image is relocated
+	 * and checked even when it is trusted.
+	 */
+	result = dns_rbt_deserialize_tree(base, filesize, 0, mctx,
+					  delete_data, NULL,
+					  ((uintptr_t)base != want)
+					  ? fix_data : NULL, NULL,
+					  true, NULL, &rbt_deserialized);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_non_null(rbt_deserialized);
+
+	check_test_data(rbt_deserialized);
+
+	/*
+	 * Nodes added after loading are freed along with the image's.
+	 */
+	name = dns_fixedname_initname(&fname);
+	dns_test_namefromstring("new.one.net.", &fname);
+	result = dns_rbt_addname(rbt_deserialized, name, &testdata[0].data);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rbt_destroy(&rbt_deserialized);
+	munmap(base, filesize);
+	unlink("zone.bin");
+}
+
 /* Test the dns_rbt_serialize_align() function */
 static void
 serialize_align_test(void **state) {
@@ -466,6 +596,8 @@ main(int argc, char **argv) {
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(deserialize_corrupt_test,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(serialize_prelinked_test,
+						_setup, _teardown),
 		cmocka_unit_test(serialize_align_test),
 	};
 	int c;
@@ -1149,6 +1149,103 @@ rbt_deletename(void **state) {
 	test_context_teardown(ctx);
 }
 
+#define REHASH_NAMES 20000
+
+static void
+rehash_name(unsigned int i, dns_fixedname_t *fname) {
+	char namebuf[64];
+
+	snprintf(namebuf, sizeof(namebuf), "n%u.example.", i);
+	dns_test_namefromstring(namebuf, fname);
+}
+
+static bool
+rehash_find(dns_rbt_t *rbt, unsigned int i) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	size_t *data = NULL;
+
+	rehash_name(i, &fname);
+	result = dns_rbt_findname(rbt, dns_fixedname_name(&fname), 0,
+				  NULL, (void **)&data);
+	if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+	assert_non_null(data);
+	assert_int_equal(*data, i);
+	return (true);
+}
+
+/*
+ * Names stay reachable while the hash table grows, whether the
+ * table is grown by insertions or pre-sized ahead of time.
+ */
+static void
+rbt_rehash(void **state) {
+	isc_result_t result;
+	dns_rbt_t *mytree = NULL;
+	dns_fixedname_t fname;
+	size_t *n;
+	unsigned int i, hashsize;
+
+	UNUSED(state);
+
+	result = dns_rbt_create(mctx, delete_data, NULL, &mytree);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	hashsize = dns_rbt_hashsize(mytree);
+	for (i = 0; i < REHASH_NAMES; i++) {
+		n = isc_mem_get(mctx, sizeof(size_t));
+		assert_non_null(n);
+		*n = i;
+		rehash_name(i, &fname);
+		result = dns_rbt_addname(mytree, dns_fixedname_name(&fname),
+					 n);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		/*
+		 * Spot check names inserted before the last resize.
+		 */
+		assert_true(rehash_find(mytree, i));
+		assert_true(rehash_find(mytree, i / 2));
+		assert_true(rehash_find(mytree, i / 7));
+	}
+
+	assert_true(dns_rbt_hashsize(mytree) > hashsize);
+	for (i = 0; i < REHASH_NAMES; i++) {
+		assert_true(rehash_find(mytree, i));
+	}
+
+	/*
+	 * Pre-size for a much larger tree, then delete half the names
+	 * while buckets are still being migrated.
+	 */
+	hashsize = dns_rbt_hashsize(mytree);
+	dns_rbt_adjusthashsize(mytree, REHASH_NAMES * 10);
+	assert_true(dns_rbt_hashsize(mytree) > hashsize);
+	assert_true(dns_rbt_hashsize(mytree) * 3 > REHASH_NAMES * 10);
+
+	for (i = 0; i < REHASH_NAMES; i += 2) {
+		rehash_name(i, &fname);
+		result = dns_rbt_deletename(mytree,
+					    dns_fixedname_name(&fname), false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < REHASH_NAMES; i++) {
+		assert_int_equal(rehash_find(mytree, i), (i % 2) != 0);
+	}
+
+	/*
+	 * Shrinking hints are ignored.
+	 */
+	hashsize = dns_rbt_hashsize(mytree);
+	dns_rbt_adjusthashsize(mytree, 10);
+	assert_int_equal(dns_rbt_hashsize(mytree), hashsize);
+
+	dns_rbt_destroy(&mytree);
+}
+
 /* Test nodechain */
 static void
 rbt_nodechain(void **state) {
@@ -1354,6 +1451,7 @@ main(void) {
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(rbt_nodechain,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(rbt_rehash, _setup, _teardown),
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 		cmocka_unit_test_setup_teardown(benchmark, _setup, _teardown),
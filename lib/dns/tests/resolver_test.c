@@ -28,13 +28,21 @@
 #include <isc/buffer.h>
 #include <isc/print.h>
 #include <isc/socket.h>
+#include <isc/stats.h>
 #include <isc/task.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
+#include <dns/cache.h>
+#include <dns/db.h>
 #include <dns/dispatch.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
 #include <dns/resolver.h>
+#include <dns/stats.h>
 #include <dns/view.h>
 
 #include "dnstest.h"
@@ -204,6 +212,253 @@ settimeout_overmax_test(void **state) {
 	destroy_resolver(&resolver);
 }
 
+#define FETCH_BUCKETS	4
+#define FETCH_NAMES	200
+#define FETCH_COUNT	(FETCH_NAMES + 3)
+
+#define SPREAD_BUCKETS	64
+#define SPREAD_COUNT	(SPREAD_BUCKETS * 16)
+
+#define FETCH_MAX	ISC_MAX(FETCH_COUNT, SPREAD_COUNT)
+
+static dns_fetch_t *fetches[FETCH_MAX];
+static dns_rdataset_t rdatasets[FETCH_MAX];
+static dns_fixedname_t fnames[FETCH_MAX];
+static dns_rdatatype_t types[FETCH_MAX];
+static dns_rdatalist_t nslist;
+static dns_rdataset_t nameservers;
+static dns_rdata_t nsrdata;
+static unsigned char nsdata[] = "\002ns\007example";
+static isc_result_t fetch_result;
+static uint64_t fetch_nfetch, fetch_bucketmax, fetch_chainmax;
+static bool fetches_created;
+static unsigned int fetch_count, fetches_done, fetches_canceled;
+
+static uint64_t
+getstat(isc_statscounter_t counter) {
+	isc_stats_t *stats = NULL;
+	uint64_t value;
+
+	dns_view_getresstats(view, &stats);
+	INSIST(stats != NULL);
+	value = isc_stats_get_counter(stats, counter);
+	isc_stats_detach(&stats);
+
+	return (value);
+}
+
+static void
+fetch_done(isc_task_t *task, isc_event_t *event) {
+	dns_fetchevent_t *fevent = (dns_fetchevent_t *)event;
+	dns_fetch_t *fetch = fevent->fetch;
+
+	UNUSED(task);
+
+	if (fevent->result == ISC_R_CANCELED) {
+		fetches_canceled++;
+	}
+	if (dns_rdataset_isassociated(fevent->rdataset)) {
+		dns_rdataset_disassociate(fevent->rdataset);
+	}
+	if (fevent->node != NULL) {
+		dns_db_detachnode(fevent->db, &fevent->node);
+	}
+	if (fevent->db != NULL) {
+		dns_db_detach(&fevent->db);
+	}
+	isc_event_free(&event);
+	dns_resolver_destroyfetch(&fetch);
+	fetches_done++;
+}
+
+/*
+ * Create every fetch while the task manager is in exclusive mode, so
+ * that no fetch context can start (and fail) before the others have
+ * had the chance to join it, then cancel them all.
+ */
+static void
+create_fetches(isc_task_t *task, isc_event_t *event) {
+	isc_result_t result;
+	unsigned int i;
+
+	result = isc_task_beginexclusive(task);
+	INSIST(result == ISC_R_SUCCESS);
+
+	fetch_result = ISC_R_SUCCESS;
+	for (i = 0; i < fetch_count; i++) {
+		result = dns_resolver_createfetch3(view->resolver,
+						   dns_fixedname_name(&fnames[i]),
+						   types[i], dns_rootname,
+						   &nameservers, NULL, NULL, 0,
+						   0, 0, NULL, task,
+						   fetch_done, NULL,
+						   &rdatasets[i], NULL,
+						   &fetches[i]);
+		if (result != ISC_R_SUCCESS) {
+			fetch_result = result;
+			break;
+		}
+	}
+	fetch_nfetch = getstat(dns_resstatscounter_nfetch);
+	fetch_bucketmax = getstat(dns_resstatscounter_bucketmax);
+	fetch_chainmax = getstat(dns_resstatscounter_chainmax);
+
+	while (i-- > 0) {
+		dns_resolver_cancelfetch(fetches[i]);
+	}
+
+	isc_task_endexclusive(task);
+	isc_event_free(&event);
+	fetches_created = true;
+}
+
+/*
+ * Give the view a cache, statistics and a resolver with 'nbuckets'
+ * buckets, and set up the name servers the fetches start from.
+ */
+static void
+setup_fetches(unsigned int nbuckets) {
+	isc_result_t result;
+	isc_stats_t *stats = NULL;
+	dns_cache_t *cache = NULL;
+	isc_region_t r;
+
+	result = dns_cache_create(mctx, taskmgr, timermgr, dns_rdataclass_in,
+				  "rbt", 0, NULL, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_view_setcache(view, cache);
+	dns_cache_detach(&cache);
+
+	result = isc_stats_create(mctx, &stats, dns_resstatscounter_max);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_view_setresstats(view, stats);
+	isc_stats_detach(&stats);
+
+	result = dns_view_createresolver(view, taskmgr, nbuckets, 1,
+					 socketmgr, timermgr, 0, dispatchmgr,
+					 dispatch, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_view_freeze(view);
+	assert_int_equal(getstat(dns_resstatscounter_buckets), nbuckets);
+
+	/*
+	 * The domain to start from is passed in, so that no hints are
+	 * needed.
+	 */
+	r.base = nsdata;
+	r.length = sizeof(nsdata);
+	dns_rdata_init(&nsrdata);
+	dns_rdata_fromregion(&nsrdata, dns_rdataclass_in, dns_rdatatype_ns,
+			     &r);
+	dns_rdatalist_init(&nslist);
+	nslist.rdclass = dns_rdataclass_in;
+	nslist.type = dns_rdatatype_ns;
+	nslist.ttl = 3600;
+	ISC_LIST_APPEND(nslist.rdata, &nsrdata, link);
+	dns_rdataset_init(&nameservers);
+	result = dns_rdatalist_tordataset(&nslist, &nameservers);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Create the first 'count' fetches set up in 'fnames' and 'types', and
+ * wait until they have all been canceled and destroyed.
+ */
+static void
+run_fetches(unsigned int count) {
+	isc_event_t *event;
+	unsigned int i;
+
+	fetch_count = count;
+	fetches_created = false;
+	fetches_done = 0;
+	fetches_canceled = 0;
+	isc_taskmgr_setexcltask(taskmgr, maintask);
+	event = isc_event_allocate(mctx, NULL, 1000, create_fetches, NULL,
+				   sizeof(*event));
+	assert_non_null(event);
+	isc_task_send(maintask, &event);
+
+	for (i = 0; i < 10000; i++) {
+		if (fetches_created && fetches_done == count &&
+		    getstat(dns_resstatscounter_nfetch) == 0)
+		{
+			break;
+		}
+		dns_test_nap(1000);
+	}
+	assert_true(fetches_created);
+	assert_int_equal(fetch_result, ISC_R_SUCCESS);
+	assert_int_equal(fetches_done, count);
+	assert_int_equal(fetches_canceled, count);
+	assert_int_equal(getstat(dns_resstatscounter_nfetch), 0);
+
+	dns_rdataset_disassociate(&nameservers);
+}
+
+/* dns_resolver_createfetch3 joining and hashing fetches into buckets */
+static void
+createfetch_test(void **state) {
+	char namebuf[64];
+	unsigned int i, n;
+
+	UNUSED(state);
+
+	setup_fetches(FETCH_BUCKETS);
+
+	/*
+	 * Two fetches for the same name and type share a fetch
+	 * context; the same name with another type does not.
+	 */
+	for (i = 0; i < FETCH_COUNT; i++) {
+		n = (i < 3) ? 0 : i - 2;
+		snprintf(namebuf, sizeof(namebuf), "name%u.example.", n);
+		dns_test_namefromstring(namebuf, &fnames[i]);
+		types[i] = (i == 2) ? dns_rdatatype_aaaa : dns_rdatatype_a;
+		dns_rdataset_init(&rdatasets[i]);
+		fetches[i] = NULL;
+	}
+
+	run_fetches(FETCH_COUNT);
+	assert_int_equal(fetch_nfetch, FETCH_COUNT - 1);
+	assert_in_range(fetch_bucketmax, (FETCH_COUNT - 1) / FETCH_BUCKETS,
+			FETCH_COUNT - 1);
+}
+
+/*
+ * Fetches of one type are spread over the hash chains of their bucket
+ * when the number of buckets is a power of two, so every name in a
+ * bucket has the same low bits.
+ */
+static void
+fetchspread_test(void **state) {
+	char namebuf[64];
+	unsigned int i;
+
+	UNUSED(state);
+
+	setup_fetches(SPREAD_BUCKETS);
+
+	for (i = 0; i < SPREAD_COUNT; i++) {
+		snprintf(namebuf, sizeof(namebuf), "spread%u.example.", i);
+		dns_test_namefromstring(namebuf, &fnames[i]);
+		types[i] = dns_rdatatype_a;
+		dns_rdataset_init(&rdatasets[i]);
+		fetches[i] = NULL;
+	}
+
+	run_fetches(SPREAD_COUNT);
+	assert_int_equal(fetch_nfetch, SPREAD_COUNT);
+
+	/*
+	 * A bucket with n fetch contexts has at least n / 2 chains.  If
+	 * they all shared one chain, it would be as long as the bucket.
+	 */
+	assert_true(fetch_bucketmax >= SPREAD_COUNT / SPREAD_BUCKETS);
+	assert_true(fetch_chainmax >= 1);
+	assert_true(fetch_chainmax <= fetch_bucketmax / 2);
+}
+
 int
 main(void) {
 	const struct CMUnitTest tests[] = {
@@ -219,6 +474,10 @@ main(void) {
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(settimeout_overmax_test,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(createfetch_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(fetchspread_test,
+						_setup, _teardown),
 	};
 
 	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <config.h>
+
+#if HAVE_CMOCKA
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <sched.h> /* IWYU pragma: keep */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/print.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/respcache.h>
+
+#include "dnstest.h"
+
+static int
+_setup(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_test_begin(NULL, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (0);
+}
+
+static int
+_teardown(void **state) {
+	UNUSED(state);
+
+	dns_test_end();
+
+	return (0);
+}
+
+/*
+ * Fill 'data' with a recognisable fake response of 'length' octets.
+ */
+static void
+make_response(unsigned char *data, unsigned int length, unsigned char tag,
+	      isc_region_t *r)
+{
+	unsigned int i;
+
+	for (i = 0; i < length; i++)
+		data[i] = (unsigned char)(tag + i);
+	r->base = data;
+	r->length = length;
+}
+
+/*
+ * Record the generations of 'object', if not NULL, in 'deps'.
+ */
+static void
+make_deps(const void *object, dns_respcachedeps_t *deps) {
+	dns_respcache_initdeps(deps);
+	if (object != NULL)
+		dns_respcache_adddep(deps, object);
+}
+
+static void
+make_key(const char *name, dns_fixedname_t *fname, dns_respcachekey_t *key) {
+	dns_test_namefromstring(name, fname);
+	key->qname = dns_fixedname_name(fname);
+	key->qtype = dns_rdatatype_a;
+	key->qclass = dns_rdataclass_in;
+	key->flags = 0;
+}
+
+/* Responses are found by the exact question only */
+static void
+addget_test(void **state) {
+	isc_result_t result;
+	dns_respcache_t *rc = NULL;
+	dns_respcachekey_t key, other;
+	dns_fixedname_t fname, fother;
+	unsigned char data[100], out[200];
+	isc_buffer_t target;
+	isc_region_t r;
+	dns_respcachedeps_t deps;
+
+	UNUSED(state);
+
+	make_deps(NULL, &deps);
+
+	result = dns_respcache_create(mctx, 100, &rc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	make_key("www.example.", &fname, &key);
+	make_response(data, sizeof(data), 1, &r);
+	result = dns_respcache_add(rc, &deps, &key, &r);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_respcache_count(rc), 1);
+
+	isc_buffer_init(&target, out, sizeof(out));
+	result = dns_respcache_get(rc, &key, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_usedlength(&target), sizeof(data));
+	assert_memory_equal(out, data, sizeof(data));
+
+	/*
+	 * The question section echoes the case of the query name.
+	 */
+	make_key("WWW.example.", &fother, &other);
+	isc_buffer_init(&target, out, sizeof(out));
+	result = dns_respcache_get(rc, &other, &target);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	other = key;
+	other.qtype = dns_rdatatype_aaaa;
+	result = dns_respcache_get(rc, &other, &target);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	other = key;
+	other.flags = 1;
+	result = dns_respcache_get(rc, &other, &target);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	/*
+	 * Adding the same question again replaces the response.
+	 */
+	make_response(data, 50, 7, &r);
+	result = dns_respcache_add(rc, &deps, &key, &r);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_respcache_count(rc), 1);
+	result = dns_respcache_get(rc, &key, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_usedlength(&target), 50);
+	assert_memory_equal(out, data, 50);
+
+	dns_respcache_flush(rc);
+	assert_int_equal(dns_respcache_count(rc), 0);
+
+	dns_respcache_destroy(&rc);
+	assert_null(rc);
+}
+
+/* Invalidation discards earlier responses and late additions */
+static void
+invalidate_test(void **state) {
+	isc_result_t result;
+	dns_respcache_t *rc = NULL;
+	dns_respcachekey_t key, other;
+	dns_fixedname_t fname, fother;
+	unsigned char data[64], out[64];
+	isc_buffer_t target;
+	isc_region_t r;
+	dns_respcachedeps_t deps, odeps;
+	static int objects[16];
+	int *zone, *otherzone = NULL;
+	unsigned int i;
+
+	UNUSED(state);
+
+	/*
+	 * Stand-ins for two zones whose generations are kept apart.
+	 */
+	zone = &objects[0];
+	make_deps(zone, &deps);
+	for (i = 1; i < 16; i++) {
+		make_deps(&objects[i], &odeps);
+		if (odeps.slots[0] != deps.slots[0]) {
+			otherzone = &objects[i];
+			break;
+		}
+	}
+	assert_non_null(otherzone);
+
+	result = dns_respcache_create(mctx, 100, &rc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	make_key("www.example.", &fname, &key);
+	make_key("www.example.net.", &fother, &other);
+	make_response(data, sizeof(data), 1, &r);
+
+	result = dns_respcache_add(rc, &deps, &key, &r);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_respcache_add(rc, &odeps, &other, &r);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_respcache_invalidate(zone);
+
+	isc_buffer_init(&target, out, sizeof(out));
+	result = dns_respcache_get(rc, &key, &target);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_int_equal(dns_respcache_count(rc), 1);
+
+	/*
+	 * Responses from other zones stay valid.
+	 */
+	result = dns_respcache_get(rc, &other, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/*
+	 * A response looked up before the change must not be cached
+	 * after it.
+	 */
+	result = dns_respcache_add(rc, &deps, &key, &r);
+	assert_int_equal(result, ISC_R_IGNORE);
+	assert_int_equal(dns_respcache_count(rc), 1);
+
+	make_deps(zone, &deps);
+	result = dns_respcache_add(rc, &deps, &key, &r);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_clear(&target);
+	result = dns_respcache_get(rc, &key, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/*
+	 * A response that depends on too many objects is not cached.
+	 */
+	dns_respcache_initdeps(&deps);
+	for (i = 0; i < 16; i++)
+		dns_respcache_adddep(&deps, &objects[i]);
+	if (deps.count == DNS_RESPCACHE_MAXDEPS) {
+		assert_true(deps.overflow);
+		result = dns_respcache_add(rc, &deps, &key, &r);
+		assert_int_equal(result, ISC_R_IGNORE);
+	}
+
+	dns_respcache_destroy(&rc);
+}
+
+/* The cache stays within its size, dropping the least recently used */
+static void
+evict_test(void **state) {
+	isc_result_t result;
+	dns_respcache_t *rc = NULL;
+	dns_respcachekey_t key, first;
+	dns_fixedname_t fname, ffirst;
+	unsigned char data[32], out[32];
+	isc_buffer_t target;
+	isc_region_t r;
+	char name[64];
+	unsigned int i;
+	dns_respcachedeps_t deps;
+
+	UNUSED(state);
+
+	make_deps(NULL, &deps);
+
+	/* A single shard, so that the LRU order is exact. */
+	result = dns_respcache_create(mctx, 100, &rc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	make_key("first.example.", &ffirst, &first);
+	make_response(data, sizeof(data), 0, &r);
+	result = dns_respcache_add(rc, &deps, &first, &r);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "name%u.example.", i);
+		make_key(name, &fname, &key);
+		result = dns_respcache_add(rc, &deps, &key, &r);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_true(dns_respcache_count(rc) <= 100);
+
+		/* Keep 'first' in use. */
+		isc_buffer_init(&target, out, sizeof(out));
+		result = dns_respcache_get(rc, &first, &target);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(dns_respcache_count(rc), 100);
+
+	isc_buffer_init(&target, out, sizeof(out));
+	make_key("name999.example.", &fname, &key);
+	result = dns_respcache_get(rc, &key, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&target, out, sizeof(out));
+	make_key("name0.example.", &fname, &key);
+	result = dns_respcache_get(rc, &key, &target);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_respcache_destroy(&rc);
+}
+
+/* Responses are only copied into targets that can hold them */
+static void
+nospace_test(void **state) {
+	isc_result_t result;
+	dns_respcache_t *rc = NULL;
+	dns_respcachekey_t key;
+	dns_fixedname_t fname;
+	unsigned char data[DNS_RESPCACHE_MAXRESPONSE + 1], out[100];
+	isc_buffer_t target;
+	isc_region_t r;
+	dns_respcachedeps_t deps;
+
+	UNUSED(state);
+
+	make_deps(NULL, &deps);
+
+	result = dns_respcache_create(mctx, 1000, &rc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	make_key("www.example.", &fname, &key);
+	make_response(data, sizeof(data), 0, &r);
+	result = dns_respcache_add(rc, &deps, &key, &r);
+	assert_int_equal(result, ISC_R_NOSPACE);
+
+	make_response(data, 60, 0, &r);
+	result = dns_respcache_add(rc, &deps, &key, &r);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&target, out, sizeof(out));
+	isc_buffer_add(&target, 50);
+	result = dns_respcache_get(rc, &key, &target);
+	assert_int_equal(result, ISC_R_NOSPACE);
+	assert_int_equal(isc_buffer_usedlength(&target), 50);
+
+	isc_buffer_clear(&target);
+	result = dns_respcache_get(rc, &key, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_usedlength(&target), 60);
+
+	dns_respcache_destroy(&rc);
+}
+
+int
+main(void) {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(addget_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(invalidate_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(evict_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(nospace_test,
+						_setup, _teardown),
+	};
+
+	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
+}
+
+#else /* HAVE_CMOCKA */
+
+#include <stdio.h>
+
+int
+main(void) {
+	printf("1..0 # Skipped: cmocka not available\n");
+	return (0);
+}
+
+#endif
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <config.h>
+
+#if HAVE_CMOCKA
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <sched.h> /* IWYU pragma: keep */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/netaddr.h>
+#include <isc/print.h>
+#include <isc/sockaddr.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/rrl.h>
+#include <dns/view.h>
+
+#include "dnstest.h"
+
+#define RATE	5
+
+static int
+_setup(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_test_begin(NULL, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (0);
+}
+
+static int
+_teardown(void **state) {
+	UNUSED(state);
+
+	dns_test_end();
+
+	return (0);
+}
+
+/*
+ * Create a view with rate limiting configured the way named does by
+ * default, except for 'responses-per-second RATE' and 'slip 0'.
+ */
+static void
+make_rrl(int min_entries, int max_entries, dns_view_t **viewp) {
+	isc_result_t result;
+	dns_view_t *view = NULL;
+	dns_rrl_t *rrl = NULL;
+	int j;
+
+	result = dns_test_makeview("view", &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_rrl_init(&rrl, view, min_entries);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	rrl->max_entries = max_entries;
+	rrl->responses_per_second.r = RATE;
+	rrl->responses_per_second.scaled = RATE;
+	rrl->responses_per_second.str = "responses-per-second";
+	rrl->referrals_per_second = rrl->responses_per_second;
+	rrl->nodata_per_second = rrl->responses_per_second;
+	rrl->nxdomains_per_second = rrl->responses_per_second;
+	rrl->errors_per_second = rrl->responses_per_second;
+	rrl->slip.str = "slip";
+	rrl->window = 15;
+	rrl->qps = 1.0;
+	rrl->ipv4_prefixlen = 24;
+	rrl->ipv4_mask = htonl(0xffffff00);
+	rrl->ipv6_prefixlen = 56;
+	for (j = 0; j < 4; j++)
+		rrl->ipv6_mask[j] = 0;
+	rrl->ipv6_mask[0] = 0xffffffff;
+	rrl->ipv6_mask[1] = htonl(0xffffff00);
+
+	*viewp = view;
+}
+
+static void
+client_addr(unsigned int n, isc_sockaddr_t *sa) {
+	struct in_addr ina;
+
+	ina.s_addr = htonl(0x0a000000 | (n << 8) | 1);
+	isc_sockaddr_fromin(sa, &ina, 53);
+}
+
+static dns_rrl_result_t
+query(dns_view_t *view, const isc_sockaddr_t *sa, dns_name_t *qname,
+      isc_stdtime_t now)
+{
+	char log_buf[DNS_RRL_LOG_BUF_LEN];
+
+	return (dns_rrl(view, sa, false, dns_rdataclass_in, dns_rdatatype_a,
+			qname, ISC_R_SUCCESS, now, false,
+			log_buf, sizeof(log_buf)));
+}
+
+/* The number of shards follows min-table-size */
+static void
+shards_test(void **state) {
+	dns_view_t *view = NULL;
+
+	UNUSED(state);
+
+	make_rrl(1, 1000, &view);
+	assert_int_equal(view->rrl->nshards, 1);
+	dns_view_detach(&view);
+
+	make_rrl(500, 20000, &view);
+	assert_int_equal(view->rrl->nshards, 8);
+	dns_view_detach(&view);
+
+	make_rrl(100000, 100000, &view);
+	assert_int_equal(view->rrl->nshards, DNS_RRL_MAX_SHARDS);
+	dns_view_detach(&view);
+}
+
+/* Responses are limited per client address block */
+static void
+limit_test(void **state) {
+	dns_view_t *view = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *qname;
+	isc_sockaddr_t sa, other;
+	isc_stdtime_t now;
+	int i;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("www.example.", &fname);
+	qname = dns_fixedname_name(&fname);
+
+	make_rrl(500, 20000, &view);
+
+	isc_stdtime_get(&now);
+	client_addr(1, &sa);
+	client_addr(2, &other);
+
+	for (i = 0; i < RATE; i++)
+		assert_int_equal(query(view, &sa, qname, now),
+				 DNS_RRL_RESULT_OK);
+	assert_int_equal(query(view, &sa, qname, now), DNS_RRL_RESULT_DROP);
+
+	/*
+	 * Other clients are not affected.
+	 */
+	assert_int_equal(query(view, &other, qname, now), DNS_RRL_RESULT_OK);
+
+	/*
+	 * The limited client earns its credit back over time.
+	 */
+	assert_int_equal(query(view, &sa, qname, now + 1), DNS_RRL_RESULT_OK);
+
+	dns_view_detach(&view);
+}
+
+/* Entries spread over all shards and stay within max-table-size */
+static void
+spread_test(void **state) {
+	dns_view_t *view = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *qname;
+	isc_sockaddr_t sa;
+	isc_stdtime_t now;
+	dns_rrl_t *rrl;
+	unsigned int i;
+	int total;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("www.example.", &fname);
+	qname = dns_fixedname_name(&fname);
+
+	make_rrl(512, 4096, &view);
+	rrl = view->rrl;
+	assert_int_equal(rrl->nshards, 16);
+
+	isc_stdtime_get(&now);
+	for (i = 0; i < 10000; i++) {
+		client_addr(i, &sa);
+		assert_int_equal(query(view, &sa, qname, now),
+				 DNS_RRL_RESULT_OK);
+	}
+
+	total = 0;
+	for (i = 0; i < rrl->nshards; i++) {
+		assert_true(rrl->shards[i].num_entries >
+			    512 / (int)rrl->nshards);
+		total += rrl->shards[i].num_entries;
+	}
+	assert_true(total <= rrl->max_entries);
+
+	dns_view_detach(&view);
+}
+
+/* A single busy shard can use more than its share of max-table-size */
+static void
+budget_test(void **state) {
+	dns_view_t *view = NULL;
+	dns_fixedname_t fname;
+	isc_sockaddr_t sa;
+	isc_stdtime_t now;
+	dns_rrl_shard_t *shard = NULL;
+	dns_rrl_t *rrl;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	unsigned int i;
+	int total;
+
+	UNUSED(state);
+
+	make_rrl(512, 4096, &view);
+	rrl = view->rrl;
+	assert_int_equal(rrl->nshards, 16);
+
+	/*
+	 * Every entry for one client lands in the same shard.
+	 */
+	isc_stdtime_get(&now);
+	client_addr(1, &sa);
+	for (i = 0; i < 3000; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.example.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		assert_int_equal(query(view, &sa, dns_fixedname_name(&fname),
+				       now),
+				 DNS_RRL_RESULT_OK);
+	}
+
+	total = 0;
+	for (i = 0; i < rrl->nshards; i++) {
+		if (rrl->shards[i].num_entries >
+		    rrl->max_entries / (int)rrl->nshards)
+		{
+			assert_null(shard);
+			shard = &rrl->shards[i];
+		}
+		total += rrl->shards[i].num_entries;
+	}
+	assert_non_null(shard);
+	assert_true(shard->num_entries >= 3000);
+	assert_int_equal(total, rrl->num_entries);
+	assert_true(total <= rrl->max_entries);
+
+	dns_view_detach(&view);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+#define NTHREADS	4
+#define NCLIENTS	256
+
+static dns_view_t *tview = NULL;
+static dns_name_t *tqname = NULL;
+static isc_stdtime_t tnow;
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+query_thread(isc_threadarg_t arg) {
+	unsigned int *passed = arg;
+	isc_sockaddr_t sa;
+	unsigned int i;
+	int j;
+
+	for (i = 0; i < NCLIENTS; i++) {
+		client_addr(i, &sa);
+		for (j = 0; j < RATE; j++) {
+			if (query(tview, &sa, tqname, tnow) ==
+			    DNS_RRL_RESULT_OK)
+			{
+				passed[i]++;
+			}
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/* Concurrent callers share each client's budget exactly */
+static void
+concurrent_test(void **state) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	isc_thread_t threads[NTHREADS];
+	unsigned int passed[NTHREADS][NCLIENTS];
+	unsigned int i, n, sum;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("www.example.", &fname);
+	tqname = dns_fixedname_name(&fname);
+
+	make_rrl(2048, 20000, &tview);
+	isc_stdtime_get(&tnow);
+	memset(passed, 0, sizeof(passed));
+
+	for (n = 0; n < NTHREADS; n++) {
+		result = isc_thread_create(query_thread, passed[n],
+					   &threads[n]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	for (n = 0; n < NTHREADS; n++)
+		isc_thread_join(threads[n], NULL);
+
+	for (i = 0; i < NCLIENTS; i++) {
+		sum = 0;
+		for (n = 0; n < NTHREADS; n++)
+			sum += passed[n][i];
+		assert_int_equal(sum, RATE);
+	}
+
+	dns_view_detach(&tview);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
+int
+main(void) {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(shards_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(limit_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(spread_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(budget_test,
+						_setup, _teardown),
+#ifdef ISC_PLATFORM_USETHREADS
+		cmocka_unit_test_setup_teardown(concurrent_test,
+						_setup, _teardown),
+#endif
+	};
+
+	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
+}
+
+#else /* HAVE_CMOCKA */
+
+#include <stdio.h>
+
+int
+main(void) {
+	printf("1..0 # Skipped: cmocka not available\n");
+	return (0);
+}
+
+#endif
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <config.h>
+
+#if HAVE_CMOCKA
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <sched.h> /* IWYU pragma: keep */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/dnssec.h>
+#include <dns/fixedname.h>
+#include <dns/keyvalues.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/verifycache.h>
+
+#include <dst/dst.h>
+
+#include "dnstest.h"
+
+static int
+_setup(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_test_begin(NULL, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (0);
+}
+
+static int
+_teardown(void **state) {
+	UNUSED(state);
+
+	dns_test_end();
+
+	return (0);
+}
+
+static void
+make_digest(unsigned int n, unsigned char *digest) {
+	unsigned int i;
+
+	for (i = 0; i < DNS_VERIFYCACHE_DIGESTLEN; i++)
+		digest[i] = (unsigned char)(n >> ((i % 4) * 8)) ^ i;
+}
+
+/* dns_verifycache_add, dns_verifycache_find and eviction */
+static void
+cache_test(void **state) {
+	dns_verifycache_t *vc = NULL;
+	unsigned char digest[DNS_VERIFYCACHE_DIGESTLEN];
+	unsigned int i, count;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_verifycache_create(mctx, 4096, &vc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	make_digest(0, digest);
+	assert_false(dns_verifycache_find(vc, digest));
+	dns_verifycache_add(vc, digest);
+	dns_verifycache_add(vc, digest);
+	assert_true(dns_verifycache_find(vc, digest));
+	assert_int_equal(dns_verifycache_count(vc), 1);
+
+	/*
+	 * Fill the cache well past its limit, looking up digest 0 each
+	 * time so that it stays the most recently used.
+	 */
+	for (i = 1; i < 1000; i++) {
+		make_digest(i, digest);
+		dns_verifycache_add(vc, digest);
+		make_digest(0, digest);
+		assert_true(dns_verifycache_find(vc, digest));
+	}
+	count = dns_verifycache_count(vc);
+	assert_true(count > 1);
+	assert_true(count < 1000);
+
+	/* The oldest entries were discarded, the newest kept. */
+	make_digest(1, digest);
+	assert_false(dns_verifycache_find(vc, digest));
+	make_digest(999, digest);
+	assert_true(dns_verifycache_find(vc, digest));
+
+	/* A changed limit flushes; a zero limit disables the cache. */
+	dns_verifycache_setmaxsize(vc, 0);
+	assert_int_equal(dns_verifycache_getmaxsize(vc), 0);
+	assert_int_equal(dns_verifycache_count(vc), 0);
+	dns_verifycache_add(vc, digest);
+	assert_false(dns_verifycache_find(vc, digest));
+
+	dns_verifycache_setmaxsize(vc, 4096);
+	dns_verifycache_add(vc, digest);
+	assert_true(dns_verifycache_find(vc, digest));
+	dns_verifycache_flush(vc);
+	assert_false(dns_verifycache_find(vc, digest));
+
+	dns_verifycache_destroy(&vc);
+	assert_null(vc);
+}
+
+/*
+ * A signed A RRset at "example." and the key that signed it.
+ */
+typedef struct {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dst_key_t *key;
+	unsigned char adata[4];
+	dns_rdata_t rdata;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	unsigned char sigdata[1024];
+	dns_rdata_t sigrdata;
+} signed_t;
+
+static void
+make_signed(signed_t *s, const char *address) {
+	isc_buffer_t b;
+	isc_stdtime_t now, expire;
+	isc_result_t result;
+
+	s->name = dns_fixedname_initname(&s->fname);
+	dns_test_namefromstring("example.", &s->fname);
+	s->key = NULL;
+	result = dst_key_generate(s->name, DST_ALG_RSASHA256, 1024, 0,
+				  DNS_KEYOWNER_ZONE, DNS_KEYPROTO_DNSSEC,
+				  dns_rdataclass_in, mctx, &s->key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdata_init(&s->rdata);
+	result = dns_test_rdatafromstring(&s->rdata, dns_rdataclass_in,
+					  dns_rdatatype_a, s->adata,
+					  sizeof(s->adata), address, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&s->rdatalist);
+	s->rdatalist.type = dns_rdatatype_a;
+	s->rdatalist.rdclass = dns_rdataclass_in;
+	s->rdatalist.ttl = 300;
+	ISC_LIST_APPEND(s->rdatalist.rdata, &s->rdata, link);
+	dns_rdataset_init(&s->rdataset);
+	result = dns_rdatalist_tordataset(&s->rdatalist, &s->rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	now -= 3600;
+	expire = now + 86400;
+	dns_rdata_init(&s->sigrdata);
+	isc_buffer_init(&b, s->sigdata, sizeof(s->sigdata));
+	result = dns_dnssec_sign(s->name, &s->rdataset, s->key, &now,
+				 &expire, mctx, &b, &s->sigrdata);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static void
+free_signed(signed_t *s) {
+	dns_rdataset_disassociate(&s->rdataset);
+	dst_key_free(&s->key);
+}
+
+/* dns_dnssec_verify4 with a verification cache */
+static void
+verify_test(void **state) {
+	dns_verifycache_t *vc = NULL;
+	signed_t s;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_verifycache_create(mctx, 4096, &vc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	make_signed(&s, "192.0.2.1");
+
+	result = dns_dnssec_verify4(s.name, &s.rdataset, s.key, false, 0,
+				    mctx, &s.sigrdata, NULL, vc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_verifycache_count(vc), 1);
+
+	result = dns_dnssec_verify4(s.name, &s.rdataset, s.key, false, 0,
+				    mctx, &s.sigrdata, NULL, vc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_verifycache_count(vc), 1);
+
+	/*
+	 * Different data under the cached signature is not accepted.
+	 */
+	s.adata[3] = 2;
+	result = dns_dnssec_verify4(s.name, &s.rdataset, s.key, false, 0,
+				    mctx, &s.sigrdata, NULL, vc);
+	assert_int_equal(result, DNS_R_SIGINVALID);
+	s.adata[3] = 1;
+
+	/*
+	 * Neither is a different signature over the cached data.
+	 */
+	s.sigrdata.data[s.sigrdata.length - 1] ^= 0xff;
+	result = dns_dnssec_verify4(s.name, &s.rdataset, s.key, false, 0,
+				    mctx, &s.sigrdata, NULL, vc);
+	assert_int_equal(result, DNS_R_SIGINVALID);
+	s.sigrdata.data[s.sigrdata.length - 1] ^= 0xff;
+	assert_int_equal(dns_verifycache_count(vc), 1);
+
+	free_signed(&s);
+	dns_verifycache_destroy(&vc);
+}
+
+/* dns_dnssec_verifybatch */
+static void
+batch_test(void **state) {
+	dns_verifycache_t *vc = NULL;
+	dns_dnssec_verifyitem_t items[2];
+	signed_t s1, s2;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_verifycache_create(mctx, 4096, &vc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	make_signed(&s1, "192.0.2.1");
+	make_signed(&s2, "192.0.2.2");
+
+	/*
+	 * Both signatures are checked against s1's key, so only the
+	 * first one verifies.
+	 */
+	items[0].name = s1.name;
+	items[0].rdataset = &s1.rdataset;
+	items[0].sigrdata = &s1.sigrdata;
+	items[0].wild = NULL;
+	items[1].name = s2.name;
+	items[1].rdataset = &s2.rdataset;
+	items[1].sigrdata = &s2.sigrdata;
+	items[1].wild = NULL;
+
+	result = dns_dnssec_verifybatch(s1.key, items, 2, false, 0,
+					mctx, vc);
+	assert_int_not_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(items[0].result, ISC_R_SUCCESS);
+	assert_int_not_equal(items[1].result, ISC_R_SUCCESS);
+	assert_int_equal(dns_verifycache_count(vc), 1);
+
+	result = dns_dnssec_verifybatch(s1.key, items, 1, false, 0,
+					mctx, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	free_signed(&s1);
+	free_signed(&s2);
+	dns_verifycache_destroy(&vc);
+}
+
+int
+main(void) {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(cache_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(verify_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(batch_test,
+						_setup, _teardown),
+	};
+
+	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
+}
+
+#else /* HAVE_CMOCKA */
+
+#include <stdio.h>
+
+int
+main(void) {
+	printf("1..0 # Skipped: cmocka not available\n");
+	return (0);
+}
+
+#endif
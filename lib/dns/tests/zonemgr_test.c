@@ -217,6 +217,53 @@ zonemgr_unreachable(void **state) {
 	assert_null(myzonemgr);
 }
 
+/* background dumps are rate limited unless the zone is being flushed */
+static void
+zonemgr_dumprate(void **state) {
+	dns_zonemgr_t *myzonemgr = NULL;
+	dns_zone_t *zone = NULL;
+	isc_result_t result;
+	size_t chunk = 1;
+
+	UNUSED(state);
+
+	result = dns_zonemgr_create(mctx, taskmgr, timermgr, socketmgr,
+				    &myzonemgr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_test_makezone("foo", &zone, NULL, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_zonemgr_setsize(myzonemgr, 1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_zonemgr_managezone(myzonemgr, zone);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Unlimited by default. */
+	assert_null(dns__zone_dumprl(zone, &chunk));
+	assert_int_equal(chunk, 0);
+
+	dns_zonemgr_setdumprate(myzonemgr, 1000);
+	assert_int_equal(dns_zonemgr_getdumprate(myzonemgr), 1000);
+	assert_non_null(dns__zone_dumprl(zone, &chunk));
+	assert_int_equal(chunk, 1000);
+
+	/*
+	 * The zone has no master file, so dns_zone_flush() does not
+	 * dump it here, but a dump started from now on is not limited.
+	 */
+	(void)dns_zone_flush(zone);
+	assert_null(dns__zone_dumprl(zone, &chunk));
+	assert_int_equal(chunk, 0);
+
+	dns_zonemgr_releasezone(myzonemgr, zone);
+	dns_zone_detach(&zone);
+	dns_zonemgr_shutdown(myzonemgr);
+	dns_zonemgr_detach(&myzonemgr);
+	assert_null(myzonemgr);
+}
+
 /*
  * XXX:
  * dns_zonemgr API calls that are not yet part of this unit test:
@@ -248,6 +295,8 @@ main(void) {
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(zonemgr_unreachable,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(zonemgr_dumprate,
+						_setup, _teardown),
 	};
 
 	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
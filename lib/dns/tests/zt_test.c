@@ -28,6 +28,7 @@
 
 #include <isc/app.h>
 #include <isc/buffer.h>
+#include <isc/file.h>
 #include <isc/print.h>
 #include <isc/task.h>
 #include <isc/timer.h>
@@ -334,6 +335,160 @@ asyncload_zt(void **state) {
 	dns_view_detach(&view);
 }
 
+#define NORDER 4
+
+/*
+ * Record count and load priority of each zone in asyncload_order, and
+ * the order in which the zones are expected to be loaded.
+ */
+static const unsigned int order_records[NORDER] = { 1, 200, 1, 50 };
+static const unsigned int order_priority[NORDER] = { 0, 0, 5, 0 };
+static const unsigned int order_expected[NORDER] = { 2, 1, 3, 0 };
+
+struct order {
+	dns_zone_t *zones[NORDER];
+	dns_zone_t *loaded[NORDER];
+	unsigned int nloaded;
+	bool done;
+};
+
+static isc_result_t
+order_done(dns_zt_t *zt, dns_zone_t *zone, isc_task_t *task) {
+	/* We treat zt as a pointer to the test state */
+	struct order *order = (struct order *) zt;
+
+	UNUSED(task);
+
+	/* With a load limit of 1 the loads do not overlap. */
+	order->loaded[order->nloaded++] = zone;
+	if (order->nloaded == NORDER) {
+		order->done = true;
+		isc_app_shutdown();
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static void
+start_order_load(isc_task_t *task, isc_event_t *event) {
+	struct order *order = event->ev_arg;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(task);
+
+	dns_zonemgr_holdloads(zonemgr);
+	for (i = 0; i < NORDER; i++) {
+		result = dns_zone_asyncload2(order->zones[i], order_done,
+					     order, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	dns_zonemgr_releaseloads(zonemgr);
+
+	isc_event_free(&event);
+}
+
+static void
+write_order_zone(const char *filename, unsigned int records) {
+	FILE *fp;
+	unsigned int i;
+
+	fp = fopen(filename, "w");
+	assert_non_null(fp);
+	fprintf(fp, "$TTL 300\n"
+		"@ SOA ns hostmaster 1 3600 600 86400 300\n"
+		"@ NS ns\n"
+		"ns A 192.0.2.1\n");
+	for (i = 0; i < records; i++)
+		fprintf(fp, "host%u A 192.0.2.%u\n", i, i % 256);
+	assert_int_equal(fclose(fp), 0);
+}
+
+/* queued zone loads: limit, order and progress */
+static void
+asyncload_order(void **state) {
+	isc_result_t result;
+	dns_view_t *view = NULL;
+	dns_zoneloadprogress_t progress;
+	struct order order;
+	char name[64], filename[64];
+	uint64_t bytes = 0;
+	off_t size;
+	unsigned int i;
+	int n = 0;
+
+	UNUSED(state);
+
+	memset(&order, 0, sizeof(order));
+
+	result = dns_test_setupzonemgr();
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_zonemgr_setloadlimit(zonemgr, 1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_zonemgr_getloadlimit(zonemgr), 1);
+	dns_zonemgr_setloadorder(zonemgr, dns_zoneloadorder_size);
+
+	for (i = 0; i < NORDER; i++) {
+		snprintf(name, sizeof(name), "order%u", i);
+		snprintf(filename, sizeof(filename), "zt-order%u.db", i);
+		write_order_zone(filename, order_records[i]);
+		result = isc_file_getsize(filename, &size);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		bytes += size;
+
+		result = dns_test_makezone(name, &order.zones[i], view,
+					   (view == NULL));
+		assert_int_equal(result, ISC_R_SUCCESS);
+		if (view == NULL)
+			view = dns_zone_getview(order.zones[i]);
+		dns_zone_setfile(order.zones[i], filename);
+		dns_zone_setloadpriority(order.zones[i], order_priority[i]);
+		assert_int_equal(dns_zone_getloadpriority(order.zones[i]),
+				 order_priority[i]);
+		result = dns_test_managezone(order.zones[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	isc_app_onrun(mctx, maintask, start_order_load, &order);
+
+	isc_app_run();
+	while (!order.done && n++ < 5000)
+		dns_test_nap(1000);
+	assert_true(order.done);
+
+	/*
+	 * The highest priority first, then the largest files.
+	 */
+	for (i = 0; i < NORDER; i++)
+		assert_ptr_equal(order.loaded[i],
+				 order.zones[order_expected[i]]);
+
+	/*
+	 * The last load is counted once its callback has returned.
+	 */
+	n = 0;
+	do {
+		dns_zonemgr_getloadprogress(zonemgr, &progress);
+		if (progress.loaded == NORDER)
+			break;
+		dns_test_nap(1000);
+	} while (n++ < 5000);
+	assert_int_equal(progress.total, NORDER);
+	assert_int_equal(progress.loaded, NORDER);
+	assert_int_equal(progress.active, 0);
+	assert_int_equal(progress.bytes, bytes);
+	assert_int_equal(progress.bytesloaded, bytes);
+	assert_int_equal(progress.eta, 0);
+
+	for (i = 0; i < NORDER; i++) {
+		dns_test_releasezone(order.zones[i]);
+		dns_zone_detach(&order.zones[i]);
+		snprintf(filename, sizeof(filename), "zt-order%u.db", i);
+		(void)isc_file_remove(filename);
+	}
+	dns_test_closezonemgr();
+	dns_view_detach(&view);
+}
+
 int
 main(void) {
 	const struct CMUnitTest tests[] = {
@@ -342,6 +497,8 @@ main(void) {
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(asyncload_zt,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(asyncload_order,
+						_setup, _teardown),
 	};
 
 	return (cmocka_run_group_tests(tests, dns_test_init, dns_test_final));
@@ -18,10 +18,13 @@
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/sha2.h>
+#include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
+#include <dns/cryptopool.h>
 #include <dns/db.h>
 #include <dns/dnssec.h>
 #include <dns/ds.h>
@@ -38,6 +41,7 @@
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
 #include <dns/result.h>
+#include <dns/stats.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
@@ -89,6 +93,8 @@
 						 * have attempted a verify. */
 #define VALATTR_INSECURITY		0x0010	/*%< Attempting proveunsecure. */
 #define VALATTR_DLVTRIED		0x0020	/*%< Looked for a DLV record. */
+#define VALATTR_VERIFYING		0x0040	/*%< Waiting for the crypto
+						 * pool to verify a RRSIG. */
 
 /*!
  * NSEC proofs to be looked for.
@@ -226,6 +232,9 @@ exit_check(dns_validator_t *val) {
 	if (val->fetch != NULL || val->subvalidator != NULL)
 		return (false);
 
+	if ((val->attributes & VALATTR_VERIFYING) != 0)
+		return (false);
+
 	return (true);
 }
 
@@ -1417,12 +1426,17 @@ compute_keytag(dns_rdata_t *rdata, dns_rdata_dnskey_t *key) {
 
 /*%
  * Is this keyset self-signed?
+ *
+ * The signatures made by each key are verified together, so that the
+ * key is only converted once however many of them there are.
  */
 static bool
 isselfsigned(dns_validator_t *val) {
 	dns_rdataset_t *rdataset, *sigrdataset;
 	dns_rdata_t rdata = DNS_RDATA_INIT;
 	dns_rdata_t sigrdata = DNS_RDATA_INIT;
+	dns_rdata_t *sigrdatas = NULL;
+	dns_dnssec_verifyitem_t *items = NULL;
 	dns_rdata_dnskey_t key;
 	dns_rdata_rrsig_t sig;
 	dns_keytag_t keytag;
@@ -1431,6 +1445,7 @@ isselfsigned(dns_validator_t *val) {
 	dst_key_t *dstkey;
 	isc_mem_t *mctx;
 	bool answer = false;
+	unsigned int i, n, nsigs;
 
 	rdataset = val->event->rdataset;
 	sigrdataset = val->event->sigrdataset;
@@ -1443,6 +1458,14 @@ isselfsigned(dns_validator_t *val) {
 
 	INSIST(rdataset->type == dns_rdatatype_dnskey);
 
+	nsigs = dns_rdataset_count(sigrdataset);
+	if (nsigs == 0)
+		return (answer);
+	sigrdatas = isc_mem_get(mctx, nsigs * sizeof(*sigrdatas));
+	items = isc_mem_get(mctx, nsigs * sizeof(*items));
+	if (sigrdatas == NULL || items == NULL)
+		goto cleanup;
+
 	for (result = dns_rdataset_first(rdataset);
 	     result == ISC_R_SUCCESS;
 	     result = dns_rdataset_next(rdataset))
@@ -1452,6 +1475,7 @@ isselfsigned(dns_validator_t *val) {
 		result = dns_rdata_tostruct(&rdata, &key, NULL);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 		keytag = compute_keytag(&rdata, &key);
+		n = 0;
 		for (result = dns_rdataset_first(sigrdataset);
 		     result == ISC_R_SUCCESS;
 		     result = dns_rdataset_next(sigrdataset))
@@ -1466,18 +1490,28 @@ isselfsigned(dns_validator_t *val) {
 			    !dns_name_equal(name, &sig.signer))
 				continue;
 
-			dstkey = NULL;
-			result = dns_dnssec_keyfromrdata(name, &rdata, mctx,
-							 &dstkey);
-			if (result != ISC_R_SUCCESS)
-				continue;
+			dns_rdata_init(&sigrdatas[n]);
+			dns_rdata_clone(&sigrdata, &sigrdatas[n]);
+			items[n].name = name;
+			items[n].rdataset = rdataset;
+			items[n].sigrdata = &sigrdatas[n];
+			items[n].wild = NULL;
+			n++;
+		}
+		if (n == 0)
+			continue;
 
-			result = dns_dnssec_verify3(name, rdataset, dstkey,
-						    true,
-						    val->view->maxbits,
-						    mctx, &sigrdata, NULL);
-			dst_key_free(&dstkey);
-			if (result != ISC_R_SUCCESS)
+		dstkey = NULL;
+		result = dns_dnssec_keyfromrdata(name, &rdata, mctx, &dstkey);
+		if (result != ISC_R_SUCCESS)
+			continue;
+
+		(void)dns_dnssec_verifybatch(dstkey, items, n, true,
+					     val->view->maxbits, mctx,
+					     val->view->verifycache);
+		dst_key_free(&dstkey);
+		for (i = 0; i < n; i++) {
+			if (items[i].result != ISC_R_SUCCESS)
 				continue;
 			if ((key.flags & DNS_KEYFLAG_REVOKE) == 0) {
 				answer = true;
@@ -1486,6 +1520,12 @@ isselfsigned(dns_validator_t *val) {
 			dns_view_untrust(val->view, name, &key, mctx);
 		}
 	}
+
+ cleanup:
+	if (sigrdatas != NULL)
+		isc_mem_put(mctx, sigrdatas, nsigs * sizeof(*sigrdatas));
+	if (items != NULL)
+		isc_mem_put(mctx, items, nsigs * sizeof(*items));
 	return (answer);
 }
 
@@ -1499,26 +1539,9 @@ isselfsigned(dns_validator_t *val) {
  * \li	Others if the verification fails.
  */
 static isc_result_t
-verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
-       uint16_t keyid)
+verify_result(dns_validator_t *val, isc_result_t result, bool ignore,
+	      uint16_t keyid, dns_name_t *wild)
 {
-	isc_result_t result;
-	dns_fixedname_t fixed;
-	bool ignore = false;
-	dns_name_t *wild;
-
-	val->attributes |= VALATTR_TRIEDVERIFY;
-	wild = dns_fixedname_initname(&fixed);
- again:
-	result = dns_dnssec_verify3(val->event->name, val->event->rdataset,
-				    key, ignore, val->view->maxbits,
-				    val->view->mctx, rdata, wild);
-	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
-	    val->view->acceptexpired)
-	{
-		ignore = true;
-		goto again;
-	}
 	if (ignore && (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD))
 		validator_log(val, ISC_LOG_INFO,
 			      "accepted expired %sRRSIG (keyid=%u)",
@@ -1552,6 +1575,219 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 	return (result);
 }
 
+static isc_result_t
+verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+       uint16_t keyid)
+{
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	bool ignore = false;
+	dns_name_t *wild;
+
+	val->attributes |= VALATTR_TRIEDVERIFY;
+	wild = dns_fixedname_initname(&fixed);
+ again:
+	result = dns_dnssec_verify4(val->event->name, val->event->rdataset,
+				    key, ignore, val->view->maxbits,
+				    val->view->mctx, rdata, wild,
+				    val->view->verifycache);
+	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
+	    val->view->acceptexpired)
+	{
+		ignore = true;
+		goto again;
+	}
+	return (verify_result(val, result, ignore, keyid, wild));
+}
+
+/*%
+ * A signature verification handed to the view's crypto pool.  The
+ * job holds everything verify_work() needs, so that the validator
+ * itself is not touched outside its own task.  The RRSIG rdata is
+ * copied into the space following the structure.
+ */
+struct dns_valverify {
+	dns_validator_t *	val;
+	isc_mem_t *		mctx;
+	dns_name_t *		name;
+	dns_rdataset_t *	rdataset;
+	dst_key_t *		key;
+	dns_rdata_t		sigrdata;
+	uint16_t		keyid;
+	unsigned int		maxbits;
+	bool			acceptexpired;
+	dns_verifycache_t *	verifycache;
+	isc_time_t		start;
+	/* Set by verify_work(). */
+	bool			ignore;
+	isc_result_t		result;
+	dns_fixedname_t		wild;
+};
+
+static void
+free_verifyjob(dns_validator_t *val) {
+	struct dns_valverify *job = val->verifyjob;
+
+	val->verifyjob = NULL;
+	isc_mem_put(job->mctx, job, sizeof(*job) + job->sigrdata.length);
+}
+
+/*
+ * Runs on a crypto pool thread.
+ */
+static void
+verify_work(void *arg) {
+	struct dns_valverify *job = arg;
+	dns_name_t *wild;
+
+	wild = dns_fixedname_initname(&job->wild);
+	job->ignore = false;
+ again:
+	job->result = dns_dnssec_verify4(job->name, job->rdataset, job->key,
+					 job->ignore, job->maxbits, job->mctx,
+					 &job->sigrdata, wild,
+					 job->verifycache);
+	if ((job->result == DNS_R_SIGEXPIRED ||
+	     job->result == DNS_R_SIGFUTURE) &&
+	    job->acceptexpired && !job->ignore)
+	{
+		job->ignore = true;
+		goto again;
+	}
+}
+
+/*%
+ * Callback from the crypto pool when verify_work() has finished.
+ *
+ * Resumes the stalled validation process, which picks up the result
+ * in verify_finish().
+ */
+static void
+verified(isc_task_t *task, isc_event_t *event) {
+	struct dns_valverify *job;
+	dns_validator_t *val;
+	bool want_destroy;
+	isc_result_t result;
+	isc_time_t now;
+	uint64_t usecs;
+	isc_statscounter_t counter;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_CRYPTODONE);
+
+	job = event->ev_arg;
+	val = job->val;
+	isc_event_free(&event);
+
+	INSIST(val->event != NULL);
+
+	LOCK(&val->lock);
+	INSIST(val->verifyjob == job);
+	val->attributes &= ~VALATTR_VERIFYING;
+
+	if (val->view->resstats != NULL) {
+		TIME_NOW(&now);
+		usecs = isc_time_microdiff(&now, &job->start);
+		if (usecs < 1000)
+			counter = dns_resstatscounter_cryptolatlt1ms;
+		else if (usecs < 10000)
+			counter = dns_resstatscounter_cryptolatlt10ms;
+		else if (usecs < 100000)
+			counter = dns_resstatscounter_cryptolatlt100ms;
+		else
+			counter = dns_resstatscounter_cryptolatge100ms;
+		isc_stats_increment(val->view->resstats, counter);
+	}
+
+	validator_log(val, ISC_LOG_DEBUG(3), "in verified");
+	if (CANCELED(val)) {
+		free_verifyjob(val);
+		validator_done(val, ISC_R_CANCELED);
+	} else {
+		result = validate(val, true);
+		if (result != DNS_R_WAIT)
+			validator_done(val, result);
+	}
+	want_destroy = exit_check(val);
+	UNLOCK(&val->lock);
+	if (want_destroy)
+		destroy(val);
+}
+
+/*%
+ * Verify 'rdata' with 'key'.  If the view has a crypto pool the work
+ * is handed to it and DNS_R_WAIT is returned; validate() is then
+ * resumed by verified().  Otherwise, or if the job cannot be queued,
+ * the signature is verified at once.
+ */
+static isc_result_t
+verify_start(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+	     uint16_t keyid)
+{
+	struct dns_valverify *job;
+	dns_cryptopool_t *pool = val->view->cryptopool;
+	isc_mem_t *mctx = val->view->mctx;
+	isc_region_t r;
+	isc_result_t result;
+
+	if (pool == NULL)
+		return (verify(val, key, rdata, keyid));
+
+	job = isc_mem_get(mctx, sizeof(*job) + rdata->length);
+	if (job == NULL)
+		return (verify(val, key, rdata, keyid));
+
+	job->val = val;
+	job->mctx = mctx;
+	job->name = val->event->name;
+	job->rdataset = val->event->rdataset;
+	job->key = key;
+	dns_rdata_init(&job->sigrdata);
+	r.base = (unsigned char *)(job + 1);
+	r.length = rdata->length;
+	memmove(r.base, rdata->data, r.length);
+	dns_rdata_fromregion(&job->sigrdata, rdata->rdclass, rdata->type, &r);
+	job->keyid = keyid;
+	job->maxbits = val->view->maxbits;
+	job->acceptexpired = val->view->acceptexpired;
+	job->verifycache = val->view->verifycache;
+	TIME_NOW(&job->start);
+	job->ignore = false;
+	job->result = ISC_R_UNEXPECTED;
+
+	result = dns_cryptopool_run(pool, mctx, verify_work, val->task,
+				    verified, job);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, job, sizeof(*job) + rdata->length);
+		return (verify(val, key, rdata, keyid));
+	}
+
+	val->verifyjob = job;
+	val->attributes |= VALATTR_TRIEDVERIFY | VALATTR_VERIFYING;
+	if (val->view->resstats != NULL) {
+		isc_stats_increment(val->view->resstats,
+				    dns_resstatscounter_cryptoqueued);
+		isc_stats_update_if_greater(val->view->resstats,
+					    dns_resstatscounter_cryptoqueuemax,
+					    dns_cryptopool_getqueued(pool));
+	}
+	return (DNS_R_WAIT);
+}
+
+/*%
+ * Consume the result of the job started by verify_start().
+ */
+static isc_result_t
+verify_finish(dns_validator_t *val) {
+	struct dns_valverify *job = val->verifyjob;
+	isc_result_t result;
+
+	result = verify_result(val, job->result, job->ignore, job->keyid,
+			       dns_fixedname_name(&job->wild));
+	free_verifyjob(val);
+	return (result);
+}
+
 /*%
  * Attempts positive response validation of a normal RRset.
  *
@@ -1628,8 +1864,14 @@ validate(dns_validator_t *val, bool resume) {
 		}
 
 		do {
-			vresult = verify(val, val->key, &rdata,
-					val->siginfo->keyid);
+			if (val->verifyjob != NULL) {
+				vresult = verify_finish(val);
+			} else {
+				vresult = verify_start(val, val->key, &rdata,
+						       val->siginfo->keyid);
+				if (vresult == DNS_R_WAIT)
+					return (DNS_R_WAIT);
+			}
 			if (vresult == ISC_R_SUCCESS)
 				break;
 			if (val->keynode != NULL) {
@@ -3778,6 +4020,7 @@ dns_validator_create(dns_view_t *view, dns_name_t *name, dns_rdatatype_t type,
 	val->keynode = NULL;
 	val->key = NULL;
 	val->siginfo = NULL;
+	val->verifyjob = NULL;
 	val->task = task;
 	val->action = action;
 	val->arg = arg;
@@ -3877,6 +4120,7 @@ destroy(dns_validator_t *val) {
 	REQUIRE(SHUTDOWN(val));
 	REQUIRE(val->event == NULL);
 	REQUIRE(val->fetch == NULL);
+	REQUIRE(val->verifyjob == NULL);
 
 	if (val->keynode != NULL)
 		dns_keytable_detachkeynode(val->keytable, &val->keynode);
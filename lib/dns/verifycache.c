@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/list.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/verifycache.h>
+
+typedef struct dns_vcentry dns_vcentry_t;
+
+struct dns_vcentry {
+	dns_vcentry_t *			next;	/*%< hash chain */
+	ISC_LINK(dns_vcentry_t)		link;	/*%< LRU */
+	unsigned char			digest[DNS_VERIFYCACHE_DIGESTLEN];
+};
+
+struct dns_verifycache {
+	unsigned int			magic;
+	isc_mutex_t			lock;
+	isc_mem_t *			mctx;
+
+	size_t				maxsize;
+	dns_vcentry_t **		table;
+	unsigned int			hashbits;
+	unsigned int			count;
+	unsigned int			maxcount;
+	ISC_LIST(dns_vcentry_t)		lru;
+};
+
+#define VERIFYCACHE_MAGIC		ISC_MAGIC('V', 'f', 'C', 'a')
+#define VALID_VERIFYCACHE(m)		ISC_MAGIC_VALID(m, VERIFYCACHE_MAGIC)
+
+/*%
+ * Bucket of 'digest'.  The digest is a cryptographic hash, so any
+ * four bytes of it are as good a hash value as any other.
+ */
+#define VC_BUCKET(vc, digest) \
+	((((unsigned int)(digest)[0] << 24) | \
+	  ((unsigned int)(digest)[1] << 16) | \
+	  ((unsigned int)(digest)[2] << 8) | \
+	  (unsigned int)(digest)[3]) & ((1U << (vc)->hashbits) - 1))
+
+#define VC_HASHBITS_MAX		20
+
+static void
+flush(dns_verifycache_t *vc) {
+	dns_vcentry_t *entry;
+
+	while ((entry = ISC_LIST_HEAD(vc->lru)) != NULL) {
+		ISC_LIST_UNLINK(vc->lru, entry, link);
+		isc_mem_put(vc->mctx, entry, sizeof(*entry));
+	}
+	if (vc->table != NULL)
+		memset(vc->table, 0, sizeof(*vc->table) << vc->hashbits);
+	vc->count = 0;
+}
+
+/*
+ * Size the table and the entry limit for 'maxsize' bytes, aiming at
+ * one entry per hash chain when the cache is full.
+ */
+static isc_result_t
+resize(dns_verifycache_t *vc, size_t maxsize) {
+	dns_vcentry_t **table = NULL;
+	unsigned int hashbits = 0;
+	size_t per;
+
+	per = sizeof(dns_vcentry_t) + sizeof(dns_vcentry_t *);
+	if (maxsize >= per) {
+		while (hashbits < VC_HASHBITS_MAX &&
+		       ((size_t)2 << hashbits) * per <= maxsize)
+			hashbits++;
+		table = isc_mem_get(vc->mctx, sizeof(*table) << hashbits);
+		if (table == NULL)
+			return (ISC_R_NOMEMORY);
+		memset(table, 0, sizeof(*table) << hashbits);
+	}
+
+	flush(vc);
+	if (vc->table != NULL)
+		isc_mem_put(vc->mctx, vc->table,
+			    sizeof(*vc->table) << vc->hashbits);
+
+	vc->table = table;
+	vc->hashbits = hashbits;
+	vc->maxsize = maxsize;
+	if (table == NULL)
+		vc->maxcount = 0;
+	else
+		vc->maxcount = (unsigned int)
+			((maxsize - (sizeof(*table) << hashbits)) /
+			 sizeof(dns_vcentry_t));
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_verifycache_create(isc_mem_t *mctx, size_t maxsize,
+		       dns_verifycache_t **vcp)
+{
+	isc_result_t result;
+	dns_verifycache_t *vc;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(vcp != NULL && *vcp == NULL);
+
+	vc = isc_mem_get(mctx, sizeof(*vc));
+	if (vc == NULL)
+		return (ISC_R_NOMEMORY);
+
+	vc->mctx = NULL;
+	isc_mem_attach(mctx, &vc->mctx);
+	vc->maxsize = 0;
+	vc->table = NULL;
+	vc->hashbits = 0;
+	vc->count = 0;
+	vc->maxcount = 0;
+	ISC_LIST_INIT(vc->lru);
+
+	result = isc_mutex_init(&vc->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	result = resize(vc, maxsize);
+	if (result != ISC_R_SUCCESS)
+		goto destroy_lock;
+
+	vc->magic = VERIFYCACHE_MAGIC;
+	*vcp = vc;
+	return (ISC_R_SUCCESS);
+
+ destroy_lock:
+	DESTROYLOCK(&vc->lock);
+ cleanup:
+	isc_mem_putanddetach(&vc->mctx, vc, sizeof(*vc));
+	return (result);
+}
+
+void
+dns_verifycache_destroy(dns_verifycache_t **vcp) {
+	dns_verifycache_t *vc;
+
+	REQUIRE(vcp != NULL && VALID_VERIFYCACHE(*vcp));
+	vc = *vcp;
+	*vcp = NULL;
+
+	flush(vc);
+	if (vc->table != NULL)
+		isc_mem_put(vc->mctx, vc->table,
+			    sizeof(*vc->table) << vc->hashbits);
+	vc->magic = 0;
+	DESTROYLOCK(&vc->lock);
+	isc_mem_putanddetach(&vc->mctx, vc, sizeof(*vc));
+}
+
+void
+dns_verifycache_setmaxsize(dns_verifycache_t *vc, size_t maxsize) {
+	REQUIRE(VALID_VERIFYCACHE(vc));
+
+	LOCK(&vc->lock);
+	/*
+	 * On failure the old table, and so the old limit, is kept.
+	 */
+	if (maxsize != vc->maxsize)
+		(void)resize(vc, maxsize);
+	UNLOCK(&vc->lock);
+}
+
+size_t
+dns_verifycache_getmaxsize(dns_verifycache_t *vc) {
+	size_t maxsize;
+
+	REQUIRE(VALID_VERIFYCACHE(vc));
+
+	LOCK(&vc->lock);
+	maxsize = vc->maxsize;
+	UNLOCK(&vc->lock);
+
+	return (maxsize);
+}
+
+void
+dns_verifycache_flush(dns_verifycache_t *vc) {
+	REQUIRE(VALID_VERIFYCACHE(vc));
+
+	LOCK(&vc->lock);
+	flush(vc);
+	UNLOCK(&vc->lock);
+}
+
+bool
+dns_verifycache_find(dns_verifycache_t *vc, const unsigned char *digest) {
+	dns_vcentry_t *entry;
+	bool found = false;
+
+	REQUIRE(VALID_VERIFYCACHE(vc));
+	REQUIRE(digest != NULL);
+
+	LOCK(&vc->lock);
+	if (vc->table == NULL)
+		goto unlock;
+	for (entry = vc->table[VC_BUCKET(vc, digest)];
+	     entry != NULL;
+	     entry = entry->next)
+	{
+		if (memcmp(entry->digest, digest, sizeof(entry->digest)) == 0)
+		{
+			ISC_LIST_UNLINK(vc->lru, entry, link);
+			ISC_LIST_PREPEND(vc->lru, entry, link);
+			found = true;
+			break;
+		}
+	}
+ unlock:
+	UNLOCK(&vc->lock);
+
+	return (found);
+}
+
+void
+dns_verifycache_add(dns_verifycache_t *vc, const unsigned char *digest) {
+	dns_vcentry_t *entry, **prev;
+	unsigned int bucket;
+
+	REQUIRE(VALID_VERIFYCACHE(vc));
+	REQUIRE(digest != NULL);
+
+	LOCK(&vc->lock);
+	if (vc->table == NULL || vc->maxcount == 0)
+		goto unlock;
+
+	bucket = VC_BUCKET(vc, digest);
+	for (entry = vc->table[bucket]; entry != NULL; entry = entry->next)
+		if (memcmp(entry->digest, digest, sizeof(entry->digest)) == 0)
+			goto unlock;
+
+	if (vc->count >= vc->maxcount) {
+		/*
+		 * Reuse the least recently used entry.
+		 */
+		entry = ISC_LIST_TAIL(vc->lru);
+		INSIST(entry != NULL);
+		ISC_LIST_UNLINK(vc->lru, entry, link);
+		prev = &vc->table[VC_BUCKET(vc, entry->digest)];
+		while (*prev != entry)
+			prev = &(*prev)->next;
+		*prev = entry->next;
+		vc->count--;
+	} else {
+		entry = isc_mem_get(vc->mctx, sizeof(*entry));
+		if (entry == NULL)
+			goto unlock;
+	}
+
+	memmove(entry->digest, digest, sizeof(entry->digest));
+	ISC_LINK_INIT(entry, link);
+	ISC_LIST_PREPEND(vc->lru, entry, link);
+	entry->next = vc->table[bucket];
+	vc->table[bucket] = entry;
+	vc->count++;
+ unlock:
+	UNLOCK(&vc->lock);
+}
+
+unsigned int
+dns_verifycache_count(dns_verifycache_t *vc) {
+	unsigned int count;
+
+	REQUIRE(VALID_VERIFYCACHE(vc));
+
+	LOCK(&vc->lock);
+	count = vc->count;
+	UNLOCK(&vc->lock);
+
+	return (count);
+}
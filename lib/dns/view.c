@@ -36,6 +36,7 @@
 #include <dns/adb.h>
 #include <dns/badcache.h>
 #include <dns/cache.h>
+#include <dns/cryptopool.h>
 #include <dns/db.h>
 #include <dns/dispatch.h>
 #include <dns/dlz.h>
@@ -54,12 +55,14 @@
 #include <dns/rdataset.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/tsig.h>
+#include <dns/verifycache.h>
 #include <dns/zone.h>
 #include <dns/zt.h>
 
@@ -74,6 +77,7 @@
 
 #define DNS_VIEW_DELONLYHASH 111
 #define DNS_VIEW_FAILCACHESIZE 1021
+#define DNS_VIEW_VERIFYCACHESIZE (1024 * 1024)
 
 static void resolver_shutdown(isc_task_t *task, isc_event_t *event);
 static void adb_shutdown(isc_task_t *task, isc_event_t *event);
@@ -217,6 +221,7 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->denyanswernames = NULL;
 	view->answernames_exclude = NULL;
 	view->rrl = NULL;
+	view->respcache = NULL;
 	view->provideixfr = true;
 	view->maxcachettl = 7 * 24 * 3600;
 	view->maxncachettl = 3 * 3600;
@@ -259,13 +264,20 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_dynkeys;
 	}
+	view->cryptopool = NULL;
+	view->verifycache = NULL;
+	result = dns_verifycache_create(view->mctx, DNS_VIEW_VERIFYCACHESIZE,
+					&view->verifycache);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup_failcache;
+	}
 	view->v6bias = 0;
 	view->dtenv = NULL;
 	view->dttypes = 0;
 
 	result = isc_mutex_init(&view->new_zone_lock);
 	if (result != ISC_R_SUCCESS) {
-		goto cleanup_failcache;
+		goto cleanup_verifycache;
 	}
 
 	if (isc_bind9) {
@@ -314,6 +326,9 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
  cleanup_new_zone_lock:
 	DESTROYLOCK(&view->new_zone_lock);
 
+ cleanup_verifycache:
+	dns_verifycache_destroy(&view->verifycache);
+
  cleanup_failcache:
 	dns_badcache_destroy(&view->failcache);
 
@@ -418,6 +433,8 @@ destroy(dns_view_t *view) {
 		dns_acache_detach(&view->acache);
 	}
 	dns_rrl_view_destroy(view);
+	if (view->respcache != NULL)
+		dns_respcache_destroy(&view->respcache);
 	if (view->rpzs != NULL)
 		dns_rpz_detach_rpzs(&view->rpzs);
 	if (view->catzs != NULL)
@@ -560,6 +577,10 @@ destroy(dns_view_t *view) {
 	dns_aclenv_destroy(&view->aclenv);
 	if (view->failcache != NULL)
 		dns_badcache_destroy(&view->failcache);
+	if (view->verifycache != NULL)
+		dns_verifycache_destroy(&view->verifycache);
+	if (view->cryptopool != NULL)
+		dns_cryptopool_detach(&view->cryptopool);
 	DESTROYLOCK(&view->new_zone_lock);
 	DESTROYLOCK(&view->lock);
 	isc_refcount_destroy(&view->references);
@@ -1849,6 +1870,17 @@ dns_view_getresstats(dns_view_t *view, isc_stats_t **statsp) {
 		isc_stats_attach(view->resstats, statsp);
 }
 
+void
+dns_view_setcryptopool(dns_view_t *view, dns_cryptopool_t *pool) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+
+	if (view->cryptopool != NULL)
+		dns_cryptopool_detach(&view->cryptopool);
+	if (pool != NULL)
+		dns_cryptopool_attach(pool, &view->cryptopool);
+}
+
 void
 dns_view_setresquerystats(dns_view_t *view, dns_stats_t *stats) {
 	REQUIRE(DNS_VIEW_VALID(view));
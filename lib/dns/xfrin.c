@@ -280,6 +280,8 @@ axfr_makedb(dns_xfrin_ctx_t *xfr, dns_db_t **dbp) {
 			       0, NULL, /* XXX guess */
 			       dbp);
 	if (result == ISC_R_SUCCESS) {
+		dns_db_adjusthashsize(*dbp,
+				      dns_zone_getexpectednames(xfr->zone));
 		dns_zone_rpz_enable_db(xfr->zone, *dbp);
 		dns_zone_catz_enable_db(xfr->zone, *dbp);
 	}
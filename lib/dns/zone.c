@@ -13,10 +13,13 @@
 
 #include <config.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdbool.h>
 
 #include <isc/file.h>
+#include <isc/heap.h>
 #include <isc/hex.h>
+#include <isc/ht.h>
 #include <isc/mutex.h>
 #include <isc/pool.h>
 #include <isc/print.h>
@@ -39,6 +42,7 @@
 #include <dns/adb.h>
 #include <dns/callbacks.h>
 #include <dns/catz.h>
+#include <dns/cryptopool.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/dlz.h>
@@ -67,6 +71,7 @@
 #include <dns/rdatatype.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/rriterator.h>
 #include <dns/soa.h>
@@ -135,6 +140,10 @@
 #define DNS_DUMP_DELAY 900		/*%< 15 minutes */
 #endif
 
+#ifndef DNS_DUMP_CHUNK
+#define DNS_DUMP_CHUNK 65536		/*%< bytes per throttled dump step */
+#endif
+
 typedef struct dns_notify dns_notify_t;
 typedef struct dns_stub dns_stub_t;
 typedef struct dns_load dns_load_t;
@@ -149,6 +158,9 @@ typedef ISC_LIST(dns_nsec3chain_t) dns_nsec3chainlist_t;
 typedef struct dns_keyfetch dns_keyfetch_t;
 typedef struct dns_asyncload dns_asyncload_t;
 typedef struct dns_include dns_include_t;
+typedef struct dns_signjob dns_signjob_t;
+typedef struct dns_signbatch dns_signbatch_t;
+typedef struct dns_signsave dns_signsave_t;
 
 #define DNS_ZONE_CHECKLOCK
 #ifdef DNS_ZONE_CHECKLOCK
@@ -256,6 +268,7 @@ struct dns_zone {
 	uint32_t		minretry;
 
 	uint32_t		maxrecords;
+	uint32_t		expectednames;
 
 	isc_sockaddr_t		*masters;
 	isc_dscp_t		*masterdscps;
@@ -351,10 +364,19 @@ struct dns_zone {
 	 * Serial number for deferred journal compaction.
 	 */
 	uint32_t		compact_serial;
+	/*%
+	 * Serial number of the master file as last written or loaded,
+	 * and how large the journal may grow relative to the master file
+	 * before it is written again.
+	 */
+	uint32_t		dumpserial;
+	bool			dumpserialset;
+	uint32_t		dumpjournalratio;
 	/*%
 	 * Keys that are signing the zone for the first time.
 	 */
 	dns_signinglist_t	signing;
+	dns_signbatch_t		*signbatch;
 	dns_nsec3chainlist_t	nsec3chain;
 	/*%
 	 * List of outstanding NSEC3PARAM change requests.
@@ -429,6 +451,11 @@ struct dns_zone {
 	 */
 	dns_ttl_t		maxttl;
 
+	/*%
+	 * priority of asynchronous loads
+	 */
+	unsigned int		loadpriority;
+
 	/*
 	 * Inline zone signing state.
 	 */
@@ -544,6 +571,7 @@ struct dns_zonemgr {
 	isc_ratelimiter_t *	refreshrl;
 	isc_ratelimiter_t *	startupnotifyrl;
 	isc_ratelimiter_t *	startuprefreshrl;
+	isc_ratelimiter_t *	dumprl;
 	isc_rwlock_t		rwlock;
 	isc_mutex_t		iolock;
 	isc_rwlock_t		urlock;
@@ -560,6 +588,9 @@ struct dns_zonemgr {
 	unsigned int		startupnotifyrate;
 	unsigned int		serialqueryrate;
 	unsigned int		startupserialqueryrate;
+	unsigned int		dumprate;
+	size_t			dumpchunk;
+	dns_cryptopool_t *	cryptopool;
 
 	/* Locked by iolock */
 	uint32_t		iolimit;
@@ -567,6 +598,22 @@ struct dns_zonemgr {
 	dns_iolist_t		high;
 	dns_iolist_t		low;
 
+	/* Locked by loadlock. */
+	isc_mutex_t		loadlock;
+	unsigned int		loadlimit;
+	dns_zoneloadorder_t	loadorder;
+	unsigned int		loadhold;
+	bool			loadshutdown;
+	isc_heap_t *		loadqueue;
+	unsigned int		loadseq;
+	isc_task_t **		lanes;
+	unsigned int *		freelanes;
+	unsigned int		nlanes;
+	unsigned int		nfreelanes;
+	dns_zoneloadprogress_t	loadprogress;
+	isc_time_t		loadstart;
+	isc_time_t		loadlogged;
+
 	/* Locked by urlock. */
 	/* LRU cache */
 	struct dns_unreachable	unreachable[UNREACH_CHACHE_SIZE];
@@ -660,9 +707,63 @@ struct dns_signing {
 	uint16_t		keyid;
 	bool		deleteit;
 	bool		done;
+	uint32_t		nodes;	/*%< Names processed; locked by zone */
 	ISC_LINK(dns_signing_t)	link;
 };
 
+/*%
+ *	A RRSIG to be generated.  With a crypto pool zone_sign() signs a
+ *	quantum in two passes: the first collects these in a
+ *	dns_signbatch_t and rolls the version back, the pool computes
+ *	them, and the second pass adds them to the zone in place of
+ *	signing the RRsets itself.
+ */
+struct dns_signjob {
+	dns_signbatch_t		*batch;
+	dns_fixedname_t		fname;
+	dns_name_t		*name;
+	dns_rdatalist_t		rdatalist;	/*%< Copy of the RRset */
+	dns_rdataset_t		rdataset;
+	unsigned char		*copy;
+	size_t			copysize;
+	dst_key_t		*key;
+	isc_stdtime_t		inception;
+	isc_stdtime_t		expire;
+	isc_mem_t		*mctx;
+	/* Set by sign_job(). */
+	isc_result_t		result;
+	dns_rdata_t		rdata;
+	unsigned char		data[1024];
+};
+
+/*%
+ *	Where a signing's iterator was before a collecting pass.
+ */
+struct dns_signsave {
+	dns_signing_t		*signing;
+	dns_fixedname_t		fname;
+	dns_name_t		*name;
+	bool			positioned;
+	uint32_t		nodes;
+};
+
+/*%
+ *	Only used by the zone's task.
+ */
+struct dns_signbatch {
+	isc_mem_t		*mctx;
+	dns_cryptopool_t	*pool;
+	dns_zone_t		*zone;	/*%< Held while 'pending' */
+	bool			collecting;
+	dns_signjob_t		**jobs;
+	unsigned int		count;
+	unsigned int		size;
+	unsigned int		pending;
+	isc_ht_t		*ht;
+	dns_signsave_t		*saved;
+	unsigned int		nsaved;
+};
+
 struct dns_nsec3chain {
 	unsigned int			magic;
 	dns_db_t			*db;
@@ -715,8 +816,18 @@ struct dns_asyncload {
 	dns_zt_zoneloaded_t loaded;
 	void *loaded_arg;
 	bool newonly;
+	/* Used by the zone manager's load queue. */
+	dns_zonemgr_t *zmgr;
+	isc_event_t *event;
+	unsigned int priority;
+	uint64_t size;
+	uint64_t key;
+	unsigned int seq;
+	unsigned int lane;
 };
 
+#define NOLANE		(~0U)
+
 /*%
  * Reference to an include file encountered during loading
  */
@@ -764,10 +875,15 @@ static void zone_xfrdone(dns_zone_t *zone, isc_result_t result);
 static isc_result_t zone_postload(dns_zone_t *zone, dns_db_t *db,
 				  isc_time_t loadtime, isc_result_t result);
 static void zone_needdump(dns_zone_t *zone, unsigned int delay);
+static void zone_journal_compact(dns_zone_t *zone, char *journal,
+				 uint32_t serial);
 static void zone_shutdown(isc_task_t *, isc_event_t *);
 static void zone_loaddone(void *arg, isc_result_t result);
 static isc_result_t zone_startload(dns_db_t *db, dns_zone_t *zone,
 				   isc_time_t loadtime);
+static void zone_logloadstats(dns_zone_t *zone,
+			      dns_masterloadstats_t *stats);
+static dns_cryptopool_t *zone_getcryptopool(dns_zone_t *zone);
 static void zone_namerd_tostr(dns_zone_t *zone, char *buf, size_t length);
 static void zone_name_tostr(dns_zone_t *zone, char *buf, size_t length);
 static void zone_rdclass_tostr(dns_zone_t *zone, char *buf, size_t length);
@@ -807,6 +923,11 @@ static isc_result_t zonemgr_getio(dns_zonemgr_t *zmgr, bool high,
 				  void *arg, dns_io_t **iop);
 static void zonemgr_putio(dns_io_t **iop);
 static void zonemgr_cancelio(dns_io_t *io);
+static isc_result_t zonemgr_queueload(dns_zonemgr_t *zmgr,
+				      dns_asyncload_t *asl);
+static void zonemgr_loaddone(dns_zonemgr_t *zmgr, dns_asyncload_t *asl);
+static bool load_higher(void *v1, void *v2);
+static void zonemgr_startloads(dns_zonemgr_t *zmgr);
 static void rss_post(dns_zone_t *, isc_event_t *);
 
 static isc_result_t
@@ -830,6 +951,7 @@ static isc_result_t delete_nsec(dns_db_t *db, dns_dbversion_t *ver,
 				dns_dbnode_t *node, dns_name_t *name,
 				dns_diff_t *diff);
 static void zone_rekey(dns_zone_t *zone);
+static void signbatch_destroy(dns_signbatch_t **batchp);
 static isc_result_t zone_send_securedb(dns_zone_t *zone, dns_db_t *db);
 static void setrl(isc_ratelimiter_t *rl, unsigned int *rate,
 		  unsigned int value);
@@ -953,6 +1075,9 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->keydirectory = NULL;
 	zone->journalsize = -1;
 	zone->journal = NULL;
+	zone->dumpserial = 0;
+	zone->dumpserialset = false;
+	zone->dumpjournalratio = 0;
 	zone->rdclass = dns_rdataclass_none;
 	zone->type = dns_zone_none;
 	zone->flags = 0;
@@ -988,6 +1113,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->masterscnt = 0;
 	zone->curmaster = 0;
 	zone->maxttl = 0;
+	zone->loadpriority = 0;
 	zone->notify = NULL;
 	zone->notifykeynames = NULL;
 	zone->notifydscp = NULL;
@@ -1050,6 +1176,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->isself = NULL;
 	zone->isselfarg = NULL;
 	ISC_LIST_INIT(zone->signing);
+	zone->signbatch = NULL;
 	ISC_LIST_INIT(zone->nsec3chain);
 	ISC_LIST_INIT(zone->setnsec3param_queue);
 	zone->signatures = 10;
@@ -1080,6 +1207,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->rss_state = NULL;
 	zone->updatemethod = dns_updatemethod_increment;
 	zone->maxrecords = 0U;
+	zone->expectednames = 0U;
 
 	zone->magic = ZONE_MAGIC;
 
@@ -1171,6 +1299,8 @@ zone_free(dns_zone_t *zone) {
 		dns_dbiterator_destroy(&signing->dbiterator);
 		isc_mem_put(zone->mctx, signing, sizeof *signing);
 	}
+	if (zone->signbatch != NULL)
+		signbatch_destroy(&zone->signbatch);
 	for (nsec3chain = ISC_LIST_HEAD(zone->nsec3chain);
 	     nsec3chain != NULL;
 	     nsec3chain = ISC_LIST_HEAD(zone->nsec3chain)) {
@@ -1732,6 +1862,22 @@ dns_zone_setmaxttl(dns_zone_t *zone, dns_ttl_t maxttl) {
 	return;
 }
 
+unsigned int
+dns_zone_getloadpriority(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->loadpriority);
+}
+
+void
+dns_zone_setloadpriority(dns_zone_t *zone, unsigned int priority) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	zone->loadpriority = priority;
+	UNLOCK_ZONE(zone);
+}
+
 static isc_result_t
 default_journal(dns_zone_t *zone) {
 	isc_result_t result;
@@ -2170,6 +2316,8 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 		goto cleanup;
 	}
 	dns_db_settask(db, zone->task);
+	if (zone->expectednames != 0U)
+		dns_db_adjusthashsize(db, zone->expectednames);
 
 	if (! dns_db_ispersistent(db)) {
 		if (zone->masterfile != NULL) {
@@ -2242,6 +2390,35 @@ zone_asyncload(isc_task_t *task, isc_event_t *event) {
 	if (asl->loaded != NULL)
 		(asl->loaded)(asl->loaded_arg, zone, task);
 
+	/*
+	 * Let the next queued load start.  A load that goes on in the
+	 * background, as a reload of a zone that is already loaded does,
+	 * gives up its place here too.
+	 */
+	zonemgr_loaddone(asl->zmgr, asl);
+
+	dns_zonemgr_detach(&asl->zmgr);
+	isc_mem_put(zone->mctx, asl, sizeof (*asl));
+	dns_zone_idetach(&zone);
+}
+
+/*
+ * Tell the caller of dns_zone_asyncload() that the zone will not be
+ * loaded after all.
+ */
+static void
+zone_asyncload_cancel(dns_asyncload_t *asl) {
+	dns_zone_t *zone = asl->zone;
+
+	LOCK_ZONE(zone);
+	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADPENDING);
+	UNLOCK_ZONE(zone);
+
+	if (asl->loaded != NULL)
+		(asl->loaded)(asl->loaded_arg, zone, NULL);
+
+	isc_event_free(&asl->event);
+	dns_zonemgr_detach(&asl->zmgr);
 	isc_mem_put(zone->mctx, asl, sizeof (*asl));
 	dns_zone_idetach(&zone);
 }
@@ -2255,49 +2432,87 @@ isc_result_t
 dns_zone_asyncload2(dns_zone_t *zone, dns_zt_zoneloaded_t done, void * arg,
 		    bool newonly)
 {
-	isc_event_t *e;
 	dns_asyncload_t *asl = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
+	off_t size;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	if (zone->zmgr == NULL)
 		return (ISC_R_FAILURE);
 
-	/* If we already have a load pending, stop now */
-	LOCK_ZONE(zone);
-	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING)) {
-		UNLOCK_ZONE(zone);
-		return (ISC_R_ALREADYRUNNING);
-	}
-
 	asl = isc_mem_get(zone->mctx, sizeof (*asl));
 	if (asl == NULL)
-		CHECK(ISC_R_NOMEMORY);
+		return (ISC_R_NOMEMORY);
 
 	asl->zone = NULL;
 	asl->loaded = done;
 	asl->loaded_arg = arg;
 	asl->newonly = newonly;
-
-	e = isc_event_allocate(zone->zmgr->mctx, zone->zmgr,
-			       DNS_EVENT_ZONELOAD,
-			       zone_asyncload, asl,
-			       sizeof(isc_event_t));
-	if (e == NULL)
+	asl->zmgr = NULL;
+	asl->priority = 0;
+	asl->size = 0;
+	asl->lane = NOLANE;
+
+	asl->event = isc_event_allocate(zone->zmgr->mctx, zone->zmgr,
+					DNS_EVENT_ZONELOAD,
+					zone_asyncload, asl,
+					sizeof(isc_event_t));
+	if (asl->event == NULL)
 		CHECK(ISC_R_NOMEMORY);
 
+	dns_zonemgr_attach(zone->zmgr, &asl->zmgr);
+
+	/* If we already have a load pending, stop now */
+	LOCK_ZONE(zone);
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING)) {
+		UNLOCK_ZONE(zone);
+		CHECK(ISC_R_ALREADYRUNNING);
+	}
+
+	/*
+	 * The size of the master file orders the queue and measures
+	 * progress.  As in zone_load(), the file of a zone that is
+	 * already loaded is left alone when only new zones are loaded.
+	 * The file of an inline-signing zone belongs to the raw zone.
+	 */
+	asl->priority = zone->loadpriority;
+	if (!(newonly && DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED))) {
+		dns_zone_t *filezone = inline_secure(zone) ? zone->raw : zone;
+
+		if (filezone != zone)
+			LOCK_ZONE(filezone);
+		if (filezone->masterfile != NULL &&
+		    isc_file_getsize(filezone->masterfile,
+				     &size) == ISC_R_SUCCESS)
+		{
+			asl->size = (uint64_t)size;
+		}
+		if (filezone != zone)
+			UNLOCK_ZONE(filezone);
+	}
+
 	zone_iattach(zone, &asl->zone);
 	DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADPENDING);
-	isc_task_send(zone->loadtask, &e);
 	UNLOCK_ZONE(zone);
 
-	return (result);
+	result = zonemgr_queueload(asl->zmgr, asl);
+	if (result != ISC_R_SUCCESS) {
+		LOCK_ZONE(zone);
+		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADPENDING);
+		UNLOCK_ZONE(zone);
+		dns_zone_idetach(&asl->zone);
+		goto failure;
+	}
+
+	return (ISC_R_SUCCESS);
 
   failure:
-	if (asl != NULL)
-		isc_mem_put(zone->mctx, asl, sizeof (*asl));
-	UNLOCK_ZONE(zone);
+	if (asl->event != NULL)
+		isc_event_free(&asl->event);
+	if (asl->zmgr != NULL)
+		dns_zonemgr_detach(&asl->zmgr);
+	isc_mem_put(zone->mctx, asl, sizeof (*asl));
 	return (result);
 }
 
@@ -2406,6 +2621,7 @@ zone_registerinclude(const char *filename, void *arg) {
 static void
 zone_gotreadhandle(isc_task_t *task, isc_event_t *event) {
 	dns_load_t *load = event->ev_arg;
+	dns_cryptopool_t *pool;
 	isc_result_t result = ISC_R_SUCCESS;
 	unsigned int options;
 
@@ -2419,7 +2635,8 @@ zone_gotreadhandle(isc_task_t *task, isc_event_t *event) {
 
 	options = get_master_options(load->zone);
 
-	result = dns_master_loadfileinc5(load->zone->masterfile,
+	pool = zone_getcryptopool(load->zone);
+	result = dns_master_loadfileinc6(load->zone->masterfile,
 					 dns_db_origin(load->db),
 					 dns_db_origin(load->db),
 					 load->zone->rdclass, options, 0,
@@ -2429,7 +2646,9 @@ zone_gotreadhandle(isc_task_t *task, isc_event_t *event) {
 					 zone_registerinclude,
 					 load->zone, load->zone->mctx,
 					 load->zone->masterformat,
-					 load->zone->maxttl);
+					 load->zone->maxttl, pool);
+	if (pool != NULL)
+		dns_cryptopool_detach(&pool);
 	if (result != ISC_R_SUCCESS && result != DNS_R_CONTINUE &&
 	    result != DNS_R_SEENINCLUDE)
 		goto fail;
@@ -2456,6 +2675,41 @@ get_raw_serial(dns_zone_t *raw, dns_masterrawheader_t *rawdata) {
 	UNLOCK(&raw->lock);
 }
 
+/*
+ * Return the rate limiter that a background dump of 'zone' should use,
+ * and the number of bytes to write per tick in '*chunkp', or NULL and 0
+ * if the dump is not to be limited.  Dumps asked for by
+ * dns_zone_flush() (rndc sync, rndc freeze, shutdown) are written at
+ * full speed even if they were first queued by zone_maintenance().
+ */
+static isc_ratelimiter_t *
+zone_dumprl(dns_zone_t *zone, size_t *chunkp) {
+	REQUIRE(LOCKED_ZONE(zone));
+
+	if (zone->zmgr == NULL || zone->zmgr->dumpchunk == 0 ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_FLUSH))
+	{
+		*chunkp = 0;
+		return (NULL);
+	}
+	*chunkp = zone->zmgr->dumpchunk;
+	return (zone->zmgr->dumprl);
+}
+
+isc_ratelimiter_t *
+dns__zone_dumprl(dns_zone_t *zone, size_t *chunkp) {
+	isc_ratelimiter_t *rl;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(chunkp != NULL);
+
+	LOCK_ZONE(zone);
+	rl = zone_dumprl(zone, chunkp);
+	UNLOCK_ZONE(zone);
+
+	return (rl);
+}
+
 static void
 zone_gotwritehandle(isc_task_t *task, isc_event_t *event) {
 	const char me[] = "zone_gotwritehandle";
@@ -2463,6 +2717,8 @@ zone_gotwritehandle(isc_task_t *task, isc_event_t *event) {
 	isc_result_t result = ISC_R_SUCCESS;
 	dns_dbversion_t *version = NULL;
 	dns_masterrawheader_t rawdata;
+	isc_ratelimiter_t *rl;
+	size_t chunk;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 	INSIST(task == zone->task);
@@ -2490,10 +2746,12 @@ zone_gotwritehandle(isc_task_t *task, isc_event_t *event) {
 			output_style = zone->masterstyle;
 		else
 			output_style = &dns_master_style_default;
-		result = dns_master_dumpinc3(zone->mctx, zone->db, version,
+		rl = zone_dumprl(zone, &chunk);
+		result = dns_master_dumpinc4(zone->mctx, zone->db, version,
 					     output_style, zone->masterfile,
-					     zone->task, dump_done, zone,						     &zone->dctx, zone->masterformat,
-					     &rawdata);
+					     zone->task, dump_done, zone,
+					     &zone->dctx, zone->masterformat,
+					     &rawdata, rl, chunk);
 		dns_db_closeversion(zone->db, &version, false);
 	} else
 		result = ISC_R_CANCELED;
@@ -2532,6 +2790,54 @@ dns_zone_setrawdata(dns_zone_t *zone, dns_masterrawheader_t *header) {
 	UNLOCK_ZONE(zone);
 }
 
+/*
+ * Log how fast the master file was loaded: at info level if it was
+ * large enough to be parsed in parallel or took a second or more.
+ */
+static void
+zone_logloadstats(dns_zone_t *zone, dns_masterloadstats_t *stats) {
+	uint64_t rate;
+	int level;
+
+	if (stats->records == 0)
+		return;
+
+	if (stats->usecs > 0)
+		rate = stats->records * 1000000 / stats->usecs;
+	else
+		rate = stats->records;
+	if (stats->threads > 0 || stats->usecs >= 1000000)
+		level = ISC_LOG_INFO;
+	else
+		level = ISC_LOG_DEBUG(1);
+
+	dns_zone_log(zone, level,
+		     "loaded %" PRIu64 " records (%" PRIu64 " bytes) "
+		     "in %" PRIu64 ".%03u seconds using %u parser thread%s, "
+		     "%" PRIu64 " records/second",
+		     stats->records, stats->bytes, stats->usecs / 1000000,
+		     (unsigned int)(stats->usecs % 1000000 / 1000),
+		     stats->threads > 0 ? stats->threads : 1,
+		     stats->threads > 1 ? "s" : "", rate);
+}
+
+/*
+ * Return the pool that parses large master files, if any.
+ */
+static dns_cryptopool_t *
+zone_getcryptopool(dns_zone_t *zone) {
+	dns_zonemgr_t *zmgr = zone->zmgr;
+	dns_cryptopool_t *pool = NULL;
+
+	if (zmgr != NULL) {
+		RWLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+		if (zmgr->cryptopool != NULL)
+			dns_cryptopool_attach(zmgr->cryptopool, &pool);
+		RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+	}
+	return (pool);
+}
+
 static isc_result_t
 zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 	dns_load_t *load;
@@ -2579,6 +2885,8 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 			result = DNS_R_CONTINUE;
 	} else {
 		dns_rdatacallbacks_t callbacks;
+		dns_masterloadstats_t stats;
+		dns_cryptopool_t *pool;
 
 		dns_rdatacallbacks_init(&callbacks);
 		callbacks.rawdata = zone_setrawdata;
@@ -2588,17 +2896,22 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 			zone_idetach(&callbacks.zone);
 			return (result);
 		}
-		result = dns_master_loadfile5(zone->masterfile,
+		pool = zone_getcryptopool(zone);
+		result = dns_master_loadfile6(zone->masterfile,
 					      &zone->origin, &zone->origin,
 					      zone->rdclass, options, 0,
 					      &callbacks,
 					      zone_registerinclude,
 					      zone, zone->mctx,
 					      zone->masterformat,
-					      zone->maxttl);
+					      zone->maxttl, pool, &stats);
+		if (pool != NULL)
+			dns_cryptopool_detach(&pool);
 		tresult = dns_db_endload(db, &callbacks);
 		if (result == ISC_R_SUCCESS)
 			result = tresult;
+		if (result == ISC_R_SUCCESS || result == DNS_R_SEENINCLUDE)
+			zone_logloadstats(zone, &stats);
 		zone_idetach(&callbacks.zone);
 	}
 
@@ -4551,6 +4864,15 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 			goto cleanup;
 	}
 
+	/*
+	 * Remember which version of the zone the master file holds, so
+	 * that writing it again can be put off while the journal holds
+	 * the changes made since.
+	 */
+	zone->dumpserialset = (!nomaster &&
+			       dns_db_getsoaserial(db, NULL, &zone->dumpserial)
+			       == ISC_R_SUCCESS);
+
 	/*
 	 * Apply update log, if any, on initial load.
 	 */
@@ -6410,6 +6732,492 @@ del_sigs(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name,
 	return (result);
 }
 
+/*
+ * Create a batch to collect the signatures of a quantum, if the zone
+ * manager has a crypto pool to compute them on.
+ */
+static isc_result_t
+signbatch_create(dns_zone_t *zone, dns_signbatch_t **batchp) {
+	dns_zonemgr_t *zmgr = zone->zmgr;
+	dns_signbatch_t *batch;
+	dns_cryptopool_t *pool = NULL;
+	isc_result_t result;
+
+	REQUIRE(batchp != NULL && *batchp == NULL);
+
+	if (zmgr == NULL)
+		return (ISC_R_NOTFOUND);
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+	if (zmgr->cryptopool != NULL)
+		dns_cryptopool_attach(zmgr->cryptopool, &pool);
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+	if (pool == NULL)
+		return (ISC_R_NOTFOUND);
+
+	batch = isc_mem_get(zone->mctx, sizeof(*batch));
+	if (batch == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_pool;
+	}
+	batch->mctx = NULL;
+	isc_mem_attach(zone->mctx, &batch->mctx);
+	batch->pool = pool;
+	batch->zone = NULL;
+	batch->collecting = true;
+	batch->jobs = NULL;
+	batch->count = 0;
+	batch->size = 0;
+	batch->pending = 0;
+	batch->saved = NULL;
+	batch->nsaved = 0;
+	batch->ht = NULL;
+	result = isc_ht_init(&batch->ht, batch->mctx, 10);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_putanddetach(&batch->mctx, batch, sizeof(*batch));
+		goto cleanup_pool;
+	}
+
+	*batchp = batch;
+	return (ISC_R_SUCCESS);
+
+ cleanup_pool:
+	dns_cryptopool_detach(&pool);
+	return (result);
+}
+
+static void
+signbatch_destroy(dns_signbatch_t **batchp) {
+	dns_signbatch_t *batch;
+	dns_signjob_t *job;
+	unsigned int i;
+
+	REQUIRE(batchp != NULL && *batchp != NULL);
+
+	batch = *batchp;
+	*batchp = NULL;
+
+	INSIST(batch->pending == 0);
+	INSIST(batch->zone == NULL);
+	INSIST(batch->saved == NULL);
+
+	for (i = 0; i < batch->count; i++) {
+		job = batch->jobs[i];
+		dst_key_free(&job->key);
+		isc_mem_put(batch->mctx, job->copy, job->copysize);
+		isc_mem_put(batch->mctx, job, sizeof(*job));
+	}
+	if (batch->jobs != NULL)
+		isc_mem_put(batch->mctx, batch->jobs,
+			    batch->size * sizeof(batch->jobs[0]));
+	isc_ht_destroy(&batch->ht);
+	dns_cryptopool_detach(&batch->pool);
+	isc_mem_putanddetach(&batch->mctx, batch, sizeof(*batch));
+}
+
+/*
+ * A job is found by its owner name, type and key.  Keys are
+ * identified by algorithm and key id rather than by pointer, as
+ * the pass that uses a signature loads the keys again.
+ */
+static unsigned int
+signbatch_key(dns_name_t *name, dns_rdatatype_t type, dst_key_t *key,
+	      unsigned char *buf)
+{
+	isc_region_t r;
+
+	dns_name_toregion(name, &r);
+	INSIST(r.length <= DNS_NAME_MAXWIRE);
+	memmove(buf, r.base, r.length);
+	buf[r.length++] = (type >> 8) & 0xff;
+	buf[r.length++] = type & 0xff;
+	buf[r.length++] = dst_key_alg(key);
+	buf[r.length++] = (dst_key_id(key) >> 8) & 0xff;
+	buf[r.length++] = dst_key_id(key) & 0xff;
+	return (r.length);
+}
+
+/*
+ * Queue a signature over a copy of 'rdataset' by 'key'.  Returns
+ * ISC_R_EXISTS if the same RRset is already queued for 'key': the
+ * version does not show queued signatures to signed_with_key().
+ */
+static isc_result_t
+signbatch_add(dns_signbatch_t *batch, dns_name_t *name,
+	      dns_rdataset_t *rdataset, dst_key_t *key,
+	      isc_stdtime_t inception, isc_stdtime_t expire)
+{
+	dns_signjob_t *job, **jobs;
+	dns_rdata_t rdata = DNS_RDATA_INIT, *copies;
+	unsigned char htkey[DNS_NAME_MAXWIRE + 5], *base;
+	unsigned int size, keysize, count, n;
+	isc_region_t r;
+	isc_result_t result;
+	size_t length;
+
+	REQUIRE(batch->collecting);
+
+	keysize = signbatch_key(name, rdataset->type, key, htkey);
+	if (isc_ht_find(batch->ht, htkey, keysize, NULL) == ISC_R_SUCCESS)
+		return (ISC_R_EXISTS);
+
+	if (batch->count == batch->size) {
+		size = (batch->size == 0) ? 64 : batch->size * 2;
+		jobs = isc_mem_get(batch->mctx, size * sizeof(jobs[0]));
+		if (jobs == NULL)
+			return (ISC_R_NOMEMORY);
+		if (batch->jobs != NULL) {
+			memmove(jobs, batch->jobs,
+				batch->count * sizeof(jobs[0]));
+			isc_mem_put(batch->mctx, batch->jobs,
+				    batch->size * sizeof(jobs[0]));
+		}
+		batch->jobs = jobs;
+		batch->size = size;
+	}
+
+	/*
+	 * The version the RRset was found in is rolled back before
+	 * the signature is computed, so take a copy.
+	 */
+	count = 0;
+	length = 0;
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset)) {
+		dns_rdataset_current(rdataset, &rdata);
+		count++;
+		length += rdata.length;
+		dns_rdata_reset(&rdata);
+	}
+	if (result != ISC_R_NOMORE)
+		return (result);
+
+	job = isc_mem_get(batch->mctx, sizeof(*job));
+	if (job == NULL)
+		return (ISC_R_NOMEMORY);
+	job->copysize = count * sizeof(dns_rdata_t) + length;
+	job->copy = isc_mem_get(batch->mctx, job->copysize);
+	if (job->copy == NULL) {
+		isc_mem_put(batch->mctx, job, sizeof(*job));
+		return (ISC_R_NOMEMORY);
+	}
+
+	dns_rdatalist_init(&job->rdatalist);
+	job->rdatalist.rdclass = rdataset->rdclass;
+	job->rdatalist.type = rdataset->type;
+	job->rdatalist.covers = rdataset->covers;
+	job->rdatalist.ttl = rdataset->ttl;
+	copies = (dns_rdata_t *)job->copy;
+	base = job->copy + count * sizeof(dns_rdata_t);
+	n = 0;
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset)) {
+		dns_rdataset_current(rdataset, &rdata);
+		dns_rdata_toregion(&rdata, &r);
+		memmove(base, r.base, r.length);
+		r.base = base;
+		base += r.length;
+		dns_rdata_init(&copies[n]);
+		dns_rdata_fromregion(&copies[n], rdata.rdclass,
+				     rdata.type, &r);
+		ISC_LIST_APPEND(job->rdatalist.rdata, &copies[n], link);
+		n++;
+		dns_rdata_reset(&rdata);
+	}
+	INSIST(n == count);
+	dns_rdataset_init(&job->rdataset);
+	RUNTIME_CHECK(dns_rdatalist_tordataset(&job->rdatalist,
+					       &job->rdataset)
+		      == ISC_R_SUCCESS);
+
+	result = isc_ht_add(batch->ht, htkey, keysize, job);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(batch->mctx, job->copy, job->copysize);
+		isc_mem_put(batch->mctx, job, sizeof(*job));
+		return (result);
+	}
+
+	job->batch = batch;
+	job->name = dns_fixedname_initname(&job->fname);
+	dns_name_copy(name, job->name, NULL);
+	job->key = NULL;
+	dst_key_attach(key, &job->key);
+	job->inception = inception;
+	job->expire = expire;
+	job->mctx = batch->mctx;
+	job->result = ISC_R_UNEXPECTED;
+	dns_rdata_init(&job->rdata);
+	batch->jobs[batch->count++] = job;
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Return the computed signature over 'rdataset' by 'key', or NULL if
+ * there is none or the RRset has changed since it was queued.
+ */
+static dns_signjob_t *
+signbatch_find(dns_signbatch_t *batch, dns_name_t *name,
+	       dns_rdataset_t *rdataset, dst_key_t *key)
+{
+	dns_signjob_t *job = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT, *copy;
+	unsigned char htkey[DNS_NAME_MAXWIRE + 5];
+	unsigned int keysize;
+	isc_result_t result;
+
+	REQUIRE(!batch->collecting);
+
+	keysize = signbatch_key(name, rdataset->type, key, htkey);
+	if (isc_ht_find(batch->ht, htkey, keysize, (void **)&job) !=
+	    ISC_R_SUCCESS)
+		return (NULL);
+	if (job->result != ISC_R_SUCCESS ||
+	    job->rdatalist.ttl != rdataset->ttl ||
+	    !dst_key_compare(job->key, key))
+		return (NULL);
+
+	copy = ISC_LIST_HEAD(job->rdatalist.rdata);
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset)) {
+		if (copy == NULL)
+			return (NULL);
+		dns_rdataset_current(rdataset, &rdata);
+		if (dns_rdata_compare(copy, &rdata) != 0)
+			return (NULL);
+		dns_rdata_reset(&rdata);
+		copy = ISC_LIST_NEXT(copy, link);
+	}
+	if (result != ISC_R_NOMORE || copy != NULL)
+		return (NULL);
+
+	return (job);
+}
+
+/*
+ * Runs on a crypto pool thread.
+ */
+static void
+sign_job(void *arg) {
+	dns_signjob_t *job = arg;
+	isc_buffer_t buffer;
+
+	isc_buffer_init(&buffer, job->data, sizeof(job->data));
+	job->result = dns_dnssec_sign(job->name, &job->rdataset, job->key,
+				      &job->inception, &job->expire,
+				      job->mctx, &buffer, &job->rdata);
+}
+
+/*
+ * Count off a computed signature.  Once they are all done, schedule
+ * the quantum that adds them and release the zone.
+ */
+static void
+signbatch_complete(dns_signbatch_t *batch) {
+	dns_zone_t *zone = batch->zone;
+	isc_time_t now;
+
+	INSIST(batch->pending > 0);
+	if (--batch->pending != 0)
+		return;
+
+	LOCK_ZONE(zone);
+	TIME_NOW(&now);
+	zone->signingtime = now;
+	zone_settimer(zone, &now);
+	UNLOCK_ZONE(zone);
+
+	batch->zone = NULL;
+	dns_zone_idetach(&zone);
+}
+
+static void
+signbatch_done(isc_task_t *task, isc_event_t *event) {
+	dns_signjob_t *job = event->ev_arg;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_CRYPTODONE);
+
+	isc_event_free(&event);
+	signbatch_complete(job->batch);
+}
+
+/*
+ * Hand the collected signatures to the crypto pool.  Each one comes
+ * back to the zone's task as an event; zone_sign() does nothing until
+ * the last has arrived.
+ */
+static void
+signbatch_dispatch(dns_zone_t *zone, dns_signbatch_t *batch) {
+	dns_signjob_t *job;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(batch->collecting && batch->count != 0);
+
+	batch->collecting = false;
+	batch->pending = batch->count;
+
+	LOCK_ZONE(zone);
+	INSIST(zone->signbatch == NULL);
+	zone_iattach(zone, &batch->zone);
+	zone->signbatch = batch;
+	isc_time_settoepoch(&zone->signingtime);
+	UNLOCK_ZONE(zone);
+
+	for (i = 0; i < batch->count; i++) {
+		job = batch->jobs[i];
+		result = dns_cryptopool_run(batch->pool, batch->mctx,
+					    sign_job, zone->task,
+					    signbatch_done, job);
+		if (result != ISC_R_SUCCESS) {
+			sign_job(job);
+			signbatch_complete(batch);
+		}
+	}
+}
+
+/*
+ * Remember where each signing is so that a pass that only collects
+ * signatures can be undone.
+ */
+static isc_result_t
+signbatch_save(dns_signbatch_t *batch, dns_zone_t *zone) {
+	dns_signing_t *signing;
+	dns_signsave_t *saved;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+	unsigned int n = 0;
+
+	REQUIRE(batch->saved == NULL);
+
+	LOCK_ZONE(zone);
+	for (signing = ISC_LIST_HEAD(zone->signing);
+	     signing != NULL;
+	     signing = ISC_LIST_NEXT(signing, link))
+		n++;
+	UNLOCK_ZONE(zone);
+	if (n == 0)
+		return (ISC_R_SUCCESS);
+
+	batch->saved = isc_mem_get(batch->mctx, n * sizeof(*saved));
+	if (batch->saved == NULL)
+		return (ISC_R_NOMEMORY);
+	batch->nsaved = n;
+
+	/*
+	 * Signings are only appended by other tasks, so the first 'n'
+	 * are the ones that were counted.
+	 */
+	LOCK_ZONE(zone);
+	signing = ISC_LIST_HEAD(zone->signing);
+	UNLOCK_ZONE(zone);
+	for (n = 0; n < batch->nsaved; n++) {
+		INSIST(signing != NULL);
+		saved = &batch->saved[n];
+		saved->signing = signing;
+		saved->name = dns_fixedname_initname(&saved->fname);
+		result = dns_dbiterator_current(signing->dbiterator, &node,
+						saved->name);
+		saved->positioned = (result == ISC_R_SUCCESS ||
+				     result == DNS_R_NEWORIGIN);
+		if (node != NULL)
+			dns_db_detachnode(signing->db, &node);
+		dns_dbiterator_pause(signing->dbiterator);
+		LOCK_ZONE(zone);
+		saved->nodes = signing->nodes;
+		signing = ISC_LIST_NEXT(signing, link);
+		UNLOCK_ZONE(zone);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static bool
+signbatch_saved(dns_signbatch_t *batch, dns_signing_t *signing) {
+	unsigned int n;
+
+	for (n = 0; n < batch->nsaved; n++)
+		if (batch->saved[n].signing == signing)
+			return (true);
+	return (false);
+}
+
+/*
+ * Put the signings that were saved back in their places, including
+ * any that were moved to 'cleanup'.
+ */
+static void
+signbatch_restore(dns_signbatch_t *batch, dns_zone_t *zone,
+		  dns_signinglist_t *cleanup)
+{
+	dns_signing_t *signing;
+	dns_signsave_t *saved;
+	isc_result_t result;
+	unsigned int n;
+
+	if (batch->saved == NULL)
+		return;
+
+	LOCK_ZONE(zone);
+	while ((signing = ISC_LIST_HEAD(*cleanup)) != NULL) {
+		ISC_LIST_UNLINK(*cleanup, signing, link);
+		ISC_LIST_APPEND(zone->signing, signing, link);
+	}
+	for (n = batch->nsaved; n-- > 0;) {
+		saved = &batch->saved[n];
+		signing = saved->signing;
+		ISC_LIST_UNLINK(zone->signing, signing, link);
+		ISC_LIST_PREPEND(zone->signing, signing, link);
+		result = ISC_R_FAILURE;
+		if (saved->positioned)
+			result = dns_dbiterator_seek(signing->dbiterator,
+						     saved->name);
+		if (result == ISC_R_SUCCESS || result == DNS_R_NEWORIGIN) {
+			signing->nodes = saved->nodes;
+		} else {
+			dns_dbiterator_first(signing->dbiterator);
+			signing->nodes = 0;
+		}
+		dns_dbiterator_pause(signing->dbiterator);
+	}
+	UNLOCK_ZONE(zone);
+
+	isc_mem_put(batch->mctx, batch->saved,
+		    batch->nsaved * sizeof(batch->saved[0]));
+	batch->saved = NULL;
+	batch->nsaved = 0;
+}
+
+/*
+ * Set the node and signature limits for one signing quantum.  When
+ * the signatures are computed by the crypto pool each of its threads
+ * gets a quantum's worth.
+ */
+static void
+signing_quantum(dns_zone_t *zone, uint32_t *nodesp, int32_t *signaturesp) {
+	dns_zonemgr_t *zmgr = zone->zmgr;
+	unsigned int workers = 1;
+
+	if (zmgr != NULL) {
+		RWLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+		if (zmgr->cryptopool != NULL)
+			workers = dns_cryptopool_getworkers(zmgr->cryptopool);
+		RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+	}
+
+	if (zone->nodes > UINT32_MAX / workers)
+		*nodesp = UINT32_MAX;
+	else
+		*nodesp = zone->nodes * workers;
+	if (zone->signatures > INT32_MAX / workers)
+		*signaturesp = INT32_MAX;
+	else
+		*signaturesp = zone->signatures * workers;
+}
+
 static isc_result_t
 add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name,
 	 dns_rdatatype_t type, dns_diff_t *diff, dst_key_t **keys,
@@ -6914,6 +7722,11 @@ check_if_bottom_of_zone(dns_db_t *db, dns_dbnode_t *node,
 	return (result);
 }
 
+/*
+ * If 'batch' is collecting, queue the signatures on it rather than
+ * adding them.  Otherwise use the ones it has computed, if any, for
+ * RRsets that have not changed since.
+ */
 static isc_result_t
 sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	    dns_dbversion_t *version, bool build_nsec3,
@@ -6921,12 +7734,14 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	    isc_stdtime_t inception, isc_stdtime_t expire,
 	    unsigned int minimum, bool is_ksk,
 	    bool keyset_kskonly, bool is_bottom_of_zone,
-	    dns_diff_t *diff, int32_t *signatures, isc_mem_t *mctx)
+	    dns_diff_t *diff, int32_t *signatures, isc_mem_t *mctx,
+	    dns_signbatch_t *batch)
 {
 	isc_result_t result;
 	dns_rdatasetiter_t *iterator = NULL;
 	dns_rdataset_t rdataset;
 	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_signjob_t *job;
 	isc_buffer_t buffer;
 	unsigned char data[1024];
 	bool seen_soa, seen_ns, seen_rr, seen_nsec, seen_nsec3, seen_ds;
@@ -7009,6 +7824,26 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 			goto next_rdataset;
 		if (signed_with_key(db, node, version, rdataset.type, key))
 			goto next_rdataset;
+		if (batch != NULL && batch->collecting) {
+			result = signbatch_add(batch, name, &rdataset, key,
+					       inception, expire);
+			if (result == ISC_R_EXISTS)
+				goto next_rdataset;
+			CHECK(result);
+			(*signatures)--;
+			goto next_rdataset;
+		}
+		job = NULL;
+		if (batch != NULL)
+			job = signbatch_find(batch, name, &rdataset, key);
+		if (job != NULL) {
+			/* Use the signature the crypto pool computed. */
+			CHECK(update_one_rr(db, version, diff,
+					    DNS_DIFFOP_ADDRESIGN, name,
+					    rdataset.ttl, &job->rdata));
+			(*signatures)--;
+			goto next_rdataset;
+		}
 		/* Calculate the signature, creating a RRSIG RDATA. */
 		isc_buffer_clear(&buffer);
 		CHECK(dns_dnssec_sign(name, &rdataset, key, &inception,
@@ -8489,10 +9324,11 @@ del_sig(dns_db_t *db, dns_dbversion_t *version, dns_name_t *name,
 
 /*
  * Incrementally sign the zone using the keys requested.
- * Builds the NSEC chain if required.
+ * Builds the NSEC chain if required.  If 'batch' is collecting, the
+ * quantum is rolled back once its signatures have been queued.
  */
-static void
-zone_sign(dns_zone_t *zone) {
+static isc_result_t
+zone_signquantum(dns_zone_t *zone, dns_signbatch_t *batch) {
 	const char *me = "zone_sign";
 	dns_db_t *db = NULL;
 	dns_dbnode_t *node = NULL;
@@ -8515,6 +9351,7 @@ zone_sign(dns_zone_t *zone) {
 	bool build_nsec = false;
 	bool build_nsec3 = false;
 	bool first;
+	bool collecting = (batch != NULL && batch->collecting);
 	isc_result_t result;
 	isc_stdtime_t now, inception, soaexpire, expire;
 	uint32_t jitter, sigvalidityinterval, expiryinterval;
@@ -8600,8 +9437,7 @@ zone_sign(dns_zone_t *zone) {
 	 * we have no more nodes to pull off or we reach the limits
 	 * for this quantum.
 	 */
-	nodes = zone->nodes;
-	signatures = zone->signatures;
+	signing_quantum(zone, &nodes, &signatures);
 	signing = ISC_LIST_HEAD(zone->signing);
 	first = true;
 
@@ -8616,10 +9452,22 @@ zone_sign(dns_zone_t *zone) {
 	if (!build_nsec && !build_nsec3)
 		build_nsec = true;
 
+	if (collecting)
+		CHECK(signbatch_save(batch, zone));
+
 	while (signing != NULL && nodes-- > 0 && signatures > 0) {
 		bool has_alg = false;
+
+		/*
+		 * Signings added since signbatch_save() could not be
+		 * put back.
+		 */
+		if (collecting && !signbatch_saved(batch, signing))
+			break;
+
 		nextsigning = ISC_LIST_NEXT(signing, link);
 
+		LOCK_ZONE(zone);
 		ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
 		if (signing->done || signing->db != zone->db) {
 			/*
@@ -8630,9 +9478,11 @@ zone_sign(dns_zone_t *zone) {
 			ISC_LIST_UNLINK(zone->signing, signing, link);
 			ISC_LIST_APPEND(cleanup, signing, link);
 			ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+			UNLOCK_ZONE(zone);
 			goto next_signing;
 		}
 		ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+		UNLOCK_ZONE(zone);
 
 		if (signing->db != db)
 			goto next_signing;
@@ -8792,7 +9642,7 @@ zone_sign(dns_zone_t *zone) {
 					  expire, zone->minimum, is_ksk,
 					  (both && keyset_kskonly),
 					  is_bottom_of_zone, zonediff.diff,
-					  &signatures, zone->mctx));
+					  &signatures, zone->mctx, batch));
 			/*
 			 * If we are adding we are done.  Look for other keys
 			 * of the same algorithm if deleting.
@@ -8814,11 +9664,16 @@ zone_sign(dns_zone_t *zone) {
  next_node:
 		first = false;
 		dns_db_detachnode(db, &node);
+		LOCK_ZONE(zone);
+		signing->nodes++;
+		UNLOCK_ZONE(zone);
 		do {
 			result = dns_dbiterator_next(signing->dbiterator);
 			if (result == ISC_R_NOMORE) {
+				LOCK_ZONE(zone);
 				ISC_LIST_UNLINK(zone->signing, signing, link);
 				ISC_LIST_APPEND(cleanup, signing, link);
+				UNLOCK_ZONE(zone);
 				dns_dbiterator_pause(signing->dbiterator);
 				if (nkeys != 0 && build_nsec) {
 					/*
@@ -8877,6 +9732,15 @@ zone_sign(dns_zone_t *zone) {
 		first = true;
 	}
 
+	/*
+	 * The signatures are all that was wanted; put everything back
+	 * for the pass that adds them.
+	 */
+	if (collecting) {
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+
 	if (ISC_LIST_HEAD(post_diff.tuples) != NULL) {
 		result = dns__zone_updatesigs(&post_diff, db, version,
 					      zone_keys, nkeys, zone,
@@ -8995,19 +9859,26 @@ zone_sign(dns_zone_t *zone) {
 	     signing = ISC_LIST_NEXT(signing, link))
 		dns_dbiterator_pause(signing->dbiterator);
 
+	if (collecting)
+		signbatch_restore(batch, zone, &cleanup);
+
 	/*
 	 * Rollback the cleanup list.
 	 */
+	LOCK_ZONE(zone);
 	signing = ISC_LIST_HEAD(cleanup);
 	while (signing != NULL) {
 		ISC_LIST_UNLINK(cleanup, signing, link);
 		ISC_LIST_PREPEND(zone->signing, signing, link);
 		dns_dbiterator_first(signing->dbiterator);
 		dns_dbiterator_pause(signing->dbiterator);
+		signing->nodes = 0;
 		signing = ISC_LIST_HEAD(cleanup);
 	}
+	UNLOCK_ZONE(zone);
 
 	dns_diff_clear(&_sig_diff);
+	dns_diff_clear(&post_diff);
 
 	for (i = 0; i < nkeys; i++)
 		dst_key_free(&zone_keys[i]);
@@ -9032,6 +9903,42 @@ zone_sign(dns_zone_t *zone) {
 		isc_time_settoepoch(&zone->signingtime);
 
 	INSIST(version == NULL);
+	return (result);
+}
+
+/*
+ * With a crypto pool each quantum is signed twice.  The first pass
+ * collects the signatures it needs and hands them to the pool; when
+ * the last has been computed signbatch_complete() schedules the second
+ * pass, which makes the changes using them.  The zone's task is never
+ * kept waiting, and no version stays open in between.
+ */
+static void
+zone_sign(dns_zone_t *zone) {
+	dns_signbatch_t *batch = zone->signbatch;
+	isc_result_t result;
+
+	if (batch != NULL) {
+		if (batch->pending != 0) {
+			isc_time_settoepoch(&zone->signingtime);
+			return;
+		}
+		zone->signbatch = NULL;
+		(void)zone_signquantum(zone, batch);
+		signbatch_destroy(&batch);
+		return;
+	}
+
+	if (signbatch_create(zone, &batch) == ISC_R_SUCCESS) {
+		result = zone_signquantum(zone, batch);
+		if (result == ISC_R_SUCCESS && batch->count != 0) {
+			signbatch_dispatch(zone, batch);
+			return;
+		}
+		signbatch_destroy(&batch);
+	}
+
+	(void)zone_signquantum(zone, NULL);
 }
 
 static isc_result_t
@@ -10111,6 +11018,92 @@ zone_refreshkeys(dns_zone_t *zone) {
 	INSIST(ver == NULL);
 }
 
+/*
+ * Whether the dump of 'zone' that is due can be put off because the
+ * journal holds every change made since the master file was written,
+ * and those changes are still small compared with the master file.
+ * The journal is read, so the zone must not be locked.
+ */
+static bool
+zone_deferdump(dns_zone_t *zone) {
+	const char me[] = "zone_deferdump";
+	dns_journal_t *journal = NULL;
+	char *journalfile = NULL, *masterfile = NULL;
+	uint32_t ratio = 0, dumpserial = 0, serial;
+	int32_t journalsize = -1;
+	off_t filesize, jfilesize;
+	size_t changes;
+	bool defer = false;
+	isc_result_t result;
+
+	ENTER;
+
+	LOCK_ZONE(zone);
+	if (zone->dumpjournalratio != 0 && zone->dumpserialset &&
+	    zone->journal != NULL && zone->masterfile != NULL &&
+	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_FLUSH) &&
+	    (zone->type == dns_zone_master || zone->type == dns_zone_slave))
+	{
+		ratio = zone->dumpjournalratio;
+		dumpserial = zone->dumpserial;
+		journalsize = zone->journalsize;
+		journalfile = isc_mem_strdup(zone->mctx, zone->journal);
+		masterfile = isc_mem_strdup(zone->mctx, zone->masterfile);
+	}
+	UNLOCK_ZONE(zone);
+	if (journalfile == NULL || masterfile == NULL)
+		goto cleanup;
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->db != NULL)
+		result = dns_db_getsoaserial(zone->db, NULL, &serial);
+	else
+		result = DNS_R_NOTLOADED;
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+
+	/*
+	 * If nothing has been journalled since the master file was
+	 * written, whatever needs dumping is not in the journal.
+	 */
+	if (result != ISC_R_SUCCESS || !isc_serial_gt(serial, dumpserial))
+		goto cleanup;
+
+	if (isc_file_getsize(masterfile, &filesize) != ISC_R_SUCCESS ||
+	    isc_file_getsize(journalfile, &jfilesize) != ISC_R_SUCCESS)
+		goto cleanup;
+
+	/*
+	 * The journal is only compacted after a dump, so leave room for
+	 * it to be.
+	 */
+	if (journalsize > 0 && jfilesize >= journalsize / 2)
+		goto cleanup;
+
+	result = dns_journal_open(zone->mctx, journalfile,
+				  DNS_JOURNAL_READ, &journal);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	if (dns_journal_last_serial(journal) == serial &&
+	    dns_journal_iter_init2(journal, dumpserial, serial,
+				   &changes) == ISC_R_SUCCESS &&
+	    (uint64_t)changes * 100 < (uint64_t)filesize * ratio)
+	{
+		defer = true;
+		dns_zone_log(zone, ISC_LOG_DEBUG(1),
+			     "putting off dump: journal holds %zu bytes "
+			     "of changes since serial %u",
+			     changes, dumpserial);
+	}
+	dns_journal_destroy(&journal);
+
+ cleanup:
+	if (journalfile != NULL)
+		isc_mem_free(zone->mctx, journalfile);
+	if (masterfile != NULL)
+		isc_mem_free(zone->mctx, masterfile);
+	return (defer);
+}
+
 static void
 zone_maintenance(dns_zone_t *zone) {
 	const char me[] = "zone_maintenance";
@@ -10203,14 +11196,26 @@ zone_maintenance(dns_zone_t *zone) {
 	case dns_zone_redirect:
 	case dns_zone_stub:
 		LOCK_ZONE(zone);
-		if (zone->masterfile != NULL &&
-		    isc_time_compare(&now, &zone->dumptime) >= 0 &&
-		    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED) &&
-		    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDDUMP)) {
-			dumping = was_dumping(zone);
-		} else
-			dumping = true;
+		dumping = (zone->masterfile == NULL ||
+			   isc_time_compare(&now, &zone->dumptime) < 0 ||
+			   !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED) ||
+			   !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDDUMP));
 		UNLOCK_ZONE(zone);
+		if (!dumping && zone_deferdump(zone)) {
+			LOCK_ZONE(zone);
+			isc_time_settoepoch(&zone->dumptime);
+			zone_needdump(zone, DNS_DUMP_DELAY);
+			UNLOCK_ZONE(zone);
+			dumping = true;
+		}
+		if (!dumping) {
+			LOCK_ZONE(zone);
+			if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDDUMP))
+				dumping = was_dumping(zone);
+			else
+				dumping = true;
+			UNLOCK_ZONE(zone);
+		}
 		if (!dumping) {
 			result = zone_dump(zone, true); /* task locked */
 			if (result != ISC_R_SUCCESS)
@@ -10504,6 +11509,32 @@ zone_needdump(dns_zone_t *zone, unsigned int delay) {
 		zone_settimer(zone, &now);
 }
 
+/*
+ * Compact the journal 'journal' of 'zone', keeping the changes from
+ * 'serial' on.  No writer of the journal may run at the same time.
+ */
+static void
+zone_journal_compact(dns_zone_t *zone, char *journal, uint32_t serial) {
+	isc_result_t result;
+
+	result = dns_journal_compact(zone->mctx, journal, serial,
+				     zone->journalsize);
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case ISC_R_NOSPACE:
+	case ISC_R_NOTFOUND:
+		dns_zone_log(zone, ISC_LOG_DEBUG(3),
+			     "dns_journal_compact: %s",
+			     dns_result_totext(result));
+		break;
+	default:
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "dns_journal_compact failed: %s",
+			     dns_result_totext(result));
+		break;
+	}
+}
+
 static void
 dump_done(void *arg, isc_result_t result) {
 	const char me[] = "dump_done";
@@ -10512,23 +11543,26 @@ dump_done(void *arg, isc_result_t result) {
 	dns_db_t *db;
 	dns_dbversion_t *version;
 	bool again = false;
-	bool compact = false;
-	uint32_t serial;
-	isc_result_t tresult;
+	bool compact = false;
+	uint32_t serial = 0, dumpserial = 0;
+	isc_result_t tresult = ISC_R_FAILURE;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	ENTER;
 
-	if (result == ISC_R_SUCCESS && zone->journal != NULL &&
-	    zone->journalsize != -1) {
+	if (result == ISC_R_SUCCESS) {
 		/*
 		 * We don't own these, zone->dctx must stay valid.
 		 */
 		db = dns_dumpctx_db(zone->dctx);
 		version = dns_dumpctx_version(zone->dctx);
 		tresult = dns_db_getsoaserial(db, version, &serial);
+		dumpserial = serial;
+	}
 
+	if (result == ISC_R_SUCCESS && zone->journal != NULL &&
+	    zone->journalsize != -1) {
 		/*
 		 * Handle lock order inversion.
 		 */
@@ -10575,24 +11609,7 @@ dump_done(void *arg, isc_result_t result) {
 		 * zone->xfr safely.
 		 */
 		if (tresult == ISC_R_SUCCESS && zone->xfr == NULL) {
-			tresult = dns_journal_compact(zone->mctx,
-						      zone->journal,
-						      serial,
-						      zone->journalsize);
-			switch (tresult) {
-			case ISC_R_SUCCESS:
-			case ISC_R_NOSPACE:
-			case ISC_R_NOTFOUND:
-				dns_zone_log(zone, ISC_LOG_DEBUG(3),
-					     "dns_journal_compact: %s",
-					     dns_result_totext(tresult));
-				break;
-			default:
-				dns_zone_log(zone, ISC_LOG_ERROR,
-					     "dns_journal_compact failed: %s",
-					     dns_result_totext(tresult));
-				break;
-			}
+			zone_journal_compact(zone, zone->journal, serial);
 		} else if (tresult == ISC_R_SUCCESS) {
 			compact = true;
 			zone->compact_serial = serial;
@@ -10603,6 +11620,10 @@ dump_done(void *arg, isc_result_t result) {
 	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_DUMPING);
 	if (compact)
 		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_NEEDCOMPACT);
+	if (result == ISC_R_SUCCESS) {
+		zone->dumpserial = dumpserial;
+		zone->dumpserialset = (tresult == ISC_R_SUCCESS);
+	}
 	if (result != ISC_R_SUCCESS && result != ISC_R_CANCELED) {
 		/*
 		 * Try again in a short while.
@@ -10692,6 +11713,16 @@ zone_dump(dns_zone_t *zone, bool compact) {
 		result = dns_master_dump3(zone->mctx, db, version,
 					  output_style, masterfile,
 					  masterformat, &rawdata);
+		if (result == ISC_R_SUCCESS) {
+			uint32_t serial;
+			isc_result_t tresult;
+
+			tresult = dns_db_getsoaserial(db, version, &serial);
+			LOCK_ZONE(zone);
+			zone->dumpserial = serial;
+			zone->dumpserialset = (tresult == ISC_R_SUCCESS);
+			UNLOCK_ZONE(zone);
+		}
 		dns_db_closeversion(db, &version, false);
 	}
  fail:
@@ -10905,6 +11936,20 @@ dns_zone_setmaxrecords(dns_zone_t *zone, uint32_t val) {
 	zone->maxrecords = val;
 }
 
+uint32_t
+dns_zone_getexpectednames(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->expectednames);
+}
+
+void
+dns_zone_setexpectednames(dns_zone_t *zone, uint32_t val) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	zone->expectednames = val;
+}
+
 static bool
 notify_isqueued(dns_zone_t *zone, unsigned int flags, dns_name_t *name,
 		isc_sockaddr_t *addr, dns_tsigkey_t *key)
@@ -13829,6 +14874,22 @@ dns_zone_getjournalsize(dns_zone_t *zone) {
 	return (zone->journalsize);
 }
 
+void
+dns_zone_setdumpjournalratio(dns_zone_t *zone, uint32_t ratio) {
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	zone->dumpjournalratio = ratio;
+}
+
+uint32_t
+dns_zone_getdumpjournalratio(dns_zone_t *zone) {
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->dumpjournalratio);
+}
+
 static void
 zone_namerd_tostr(dns_zone_t *zone, char *buf, size_t length) {
 	isc_result_t result = ISC_R_FAILURE;
@@ -15040,6 +16101,8 @@ receive_secure_db(isc_task_t *task, isc_event_t *event) {
 	if (result != ISC_R_SUCCESS) {
 		goto failure;
 	}
+	if (zone->expectednames != 0U)
+		dns_db_adjusthashsize(db, zone->expectednames);
 
 	result = dns_db_newversion(db, &version);
 	if (result != ISC_R_SUCCESS) {
@@ -15283,24 +16346,8 @@ zone_replacedb(dns_zone_t *zone, dns_db_t *db, bool dump) {
 		}
 		if (dump)
 			zone_needdump(zone, DNS_DUMP_DELAY);
-		else if (zone->journalsize != -1) {
-			result = dns_journal_compact(zone->mctx, zone->journal,
-						     serial, zone->journalsize);
-			switch (result) {
-			case ISC_R_SUCCESS:
-			case ISC_R_NOSPACE:
-			case ISC_R_NOTFOUND:
-				dns_zone_log(zone, ISC_LOG_DEBUG(3),
-					     "dns_journal_compact: %s",
-					     dns_result_totext(result));
-				break;
-			default:
-				dns_zone_log(zone, ISC_LOG_ERROR,
-					     "dns_journal_compact failed: %s",
-					     dns_result_totext(result));
-				break;
-			}
-		}
+		else if (zone->journalsize != -1)
+			zone_journal_compact(zone, zone->journal, serial);
 		if (zone->type == dns_zone_master && inline_raw(zone))
 			zone_send_secureserial(zone, serial);
 	} else {
@@ -15390,6 +16437,7 @@ zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
 					 isc_result_totext(result));
 		}
 	}
+	dns_respcache_invalidate(zone);
 }
 
 /* The caller must hold the dblock as a writer. */
@@ -15400,6 +16448,7 @@ zone_detachdb(dns_zone_t *zone) {
 	if (zone->acache != NULL)
 		(void)dns_acache_putdb(zone->acache, zone->db);
 	dns_db_detach(&zone->db);
+	dns_respcache_invalidate(zone);
 }
 
 static void
@@ -15625,23 +16674,8 @@ zone_xfrdone(dns_zone_t *zone, isc_result_t result) {
 	 * Handle any deferred journal compaction.
 	 */
 	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDCOMPACT)) {
-		result = dns_journal_compact(zone->mctx, zone->journal,
-					     zone->compact_serial,
-					     zone->journalsize);
-		switch (result) {
-		case ISC_R_SUCCESS:
-		case ISC_R_NOSPACE:
-		case ISC_R_NOTFOUND:
-			dns_zone_log(zone, ISC_LOG_DEBUG(3),
-				     "dns_journal_compact: %s",
-				     dns_result_totext(result));
-			break;
-		default:
-			dns_zone_log(zone, ISC_LOG_ERROR,
-				     "dns_journal_compact failed: %s",
-				     dns_result_totext(result));
-			break;
-		}
+		zone_journal_compact(zone, zone->journal,
+				     zone->compact_serial);
 		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_NEEDCOMPACT);
 	}
 
@@ -15694,6 +16728,15 @@ zone_loaddone(void *arg, isc_result_t result) {
 	    (result == ISC_R_SUCCESS || result == DNS_R_SEENINCLUDE))
 		result = tresult;
 
+	if (zone->lctx != NULL &&
+	    (result == ISC_R_SUCCESS || result == DNS_R_SEENINCLUDE))
+	{
+		dns_masterloadstats_t stats;
+
+		dns_loadctx_getstats(zone->lctx, &stats);
+		zone_logloadstats(zone, &stats);
+	}
+
 	/*
 	 * Lock hierarchy: zmgr, zone, raw.
 	 */
@@ -16297,6 +17340,8 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	zmgr->refreshrl = NULL;
 	zmgr->startupnotifyrl = NULL;
 	zmgr->startuprefreshrl = NULL;
+	zmgr->dumprl = NULL;
+	zmgr->cryptopool = NULL;
 	ISC_LIST_INIT(zmgr->zones);
 	ISC_LIST_INIT(zmgr->waiting_for_xfrin);
 	ISC_LIST_INIT(zmgr->xfrin_in_progress);
@@ -16339,6 +17384,11 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	if (result != ISC_R_SUCCESS)
 		goto free_startupnotifyrl;
 
+	result = isc_ratelimiter_create(mctx, timermgr, zmgr->task,
+					&zmgr->dumprl);
+	if (result != ISC_R_SUCCESS)
+		goto free_startuprefreshrl;
+
 	/* default to 20 refresh queries / notifies per second. */
 	setrl(zmgr->notifyrl, &zmgr->notifyrate, 20);
 	setrl(zmgr->startupnotifyrl, &zmgr->startupnotifyrate, 20);
@@ -16346,6 +17396,8 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	setrl(zmgr->startuprefreshrl, &zmgr->startupserialqueryrate, 20);
 	isc_ratelimiter_setpushpop(zmgr->startupnotifyrl, true);
 	isc_ratelimiter_setpushpop(zmgr->startuprefreshrl, true);
+	zmgr->dumprate = 0;
+	zmgr->dumpchunk = 0;
 
 	zmgr->iolimit = 1;
 	zmgr->ioactive = 0;
@@ -16354,7 +17406,30 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 
 	result = isc_mutex_init(&zmgr->iolock);
 	if (result != ISC_R_SUCCESS)
-		goto free_startuprefreshrl;
+		goto free_dumprl;
+
+	zmgr->loadlimit = 0;
+	zmgr->loadorder = dns_zoneloadorder_none;
+	zmgr->loadhold = 0;
+	zmgr->loadshutdown = false;
+	zmgr->loadqueue = NULL;
+	zmgr->loadseq = 0;
+	zmgr->lanes = NULL;
+	zmgr->freelanes = NULL;
+	zmgr->nlanes = 0;
+	zmgr->nfreelanes = 0;
+	memset(&zmgr->loadprogress, 0, sizeof(zmgr->loadprogress));
+	isc_time_settoepoch(&zmgr->loadstart);
+	isc_time_settoepoch(&zmgr->loadlogged);
+
+	result = isc_heap_create(mctx, load_higher, NULL, 0,
+				 &zmgr->loadqueue);
+	if (result != ISC_R_SUCCESS)
+		goto free_iolock;
+
+	result = isc_mutex_init(&zmgr->loadlock);
+	if (result != ISC_R_SUCCESS)
+		goto free_loadqueue;
 
 	zmgr->magic = ZONEMGR_MAGIC;
 
@@ -16362,9 +17437,15 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	return (ISC_R_SUCCESS);
 
 #if 0
+ free_loadlock:
+	DESTROYLOCK(&zmgr->loadlock);
+#endif
+ free_loadqueue:
+	isc_heap_destroy(&zmgr->loadqueue);
  free_iolock:
 	DESTROYLOCK(&zmgr->iolock);
-#endif
+ free_dumprl:
+	isc_ratelimiter_detach(&zmgr->dumprl);
  free_startuprefreshrl:
 	isc_ratelimiter_detach(&zmgr->startuprefreshrl);
  free_startupnotifyrl:
@@ -16567,13 +17648,38 @@ dns_zonemgr_resumexfrs(dns_zonemgr_t *zmgr) {
 void
 dns_zonemgr_shutdown(dns_zonemgr_t *zmgr) {
 	dns_zone_t *zone;
+	dns_asyncload_t *asl;
+	unsigned int i;
 
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
+	/*
+	 * Loads that have not started yet never will.
+	 */
+	do {
+		LOCK(&zmgr->loadlock);
+		zmgr->loadshutdown = true;
+		asl = isc_heap_element(zmgr->loadqueue, 1);
+		if (asl != NULL) {
+			isc_heap_delete(zmgr->loadqueue, 1);
+			zmgr->loadprogress.total--;
+			zmgr->loadprogress.bytes -= asl->size;
+		}
+		UNLOCK(&zmgr->loadlock);
+		if (asl != NULL)
+			zone_asyncload_cancel(asl);
+	} while (asl != NULL);
+
+	LOCK(&zmgr->loadlock);
+	for (i = 0; i < zmgr->nlanes; i++)
+		isc_task_detach(&zmgr->lanes[i]);
+	UNLOCK(&zmgr->loadlock);
+
 	isc_ratelimiter_shutdown(zmgr->notifyrl);
 	isc_ratelimiter_shutdown(zmgr->refreshrl);
 	isc_ratelimiter_shutdown(zmgr->startupnotifyrl);
 	isc_ratelimiter_shutdown(zmgr->startuprefreshrl);
+	isc_ratelimiter_shutdown(zmgr->dumprl);
 
 	if (zmgr->task != NULL)
 		isc_task_destroy(&zmgr->task);
@@ -16703,10 +17809,27 @@ zonemgr_free(dns_zonemgr_t *zmgr) {
 	zmgr->magic = 0;
 
 	DESTROYLOCK(&zmgr->iolock);
+	INSIST(isc_heap_element(zmgr->loadqueue, 1) == NULL);
+	isc_heap_destroy(&zmgr->loadqueue);
+	if (zmgr->lanes != NULL) {
+		unsigned int i;
+
+		for (i = 0; i < zmgr->nlanes; i++)
+			if (zmgr->lanes[i] != NULL)
+				isc_task_detach(&zmgr->lanes[i]);
+		isc_mem_put(zmgr->mctx, zmgr->lanes,
+			    zmgr->nlanes * sizeof(zmgr->lanes[0]));
+		isc_mem_put(zmgr->mctx, zmgr->freelanes,
+			    zmgr->nlanes * sizeof(zmgr->freelanes[0]));
+	}
+	DESTROYLOCK(&zmgr->loadlock);
 	isc_ratelimiter_detach(&zmgr->notifyrl);
 	isc_ratelimiter_detach(&zmgr->refreshrl);
 	isc_ratelimiter_detach(&zmgr->startupnotifyrl);
 	isc_ratelimiter_detach(&zmgr->startuprefreshrl);
+	isc_ratelimiter_detach(&zmgr->dumprl);
+	if (zmgr->cryptopool != NULL)
+		dns_cryptopool_detach(&zmgr->cryptopool);
 
 	isc_rwlock_destroy(&zmgr->urlock);
 	isc_rwlock_destroy(&zmgr->rwlock);
@@ -16905,6 +18028,328 @@ dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr) {
 	return (zmgr->iolimit);
 }
 
+/*
+ * How often the progress of a long run of zone loads is logged.
+ */
+#define LOADPROGRESS_INTERVAL	(10 * 1000000)
+
+/*
+ * Order of the load queue: priority, then, if the loads are ordered by
+ * size, the largest master file, then the first queued.
+ */
+static bool
+load_higher(void *v1, void *v2) {
+	dns_asyncload_t *a1 = v1, *a2 = v2;
+
+	if (a1->priority != a2->priority)
+		return (a1->priority > a2->priority);
+	if (a1->key != a2->key)
+		return (a1->key > a2->key);
+	return (a1->seq < a2->seq);
+}
+
+isc_result_t
+dns_zonemgr_setloadlimit(dns_zonemgr_t *zmgr, unsigned int limit) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_task_t **lanes = NULL;
+	unsigned int *freelanes = NULL;
+	unsigned int i, n;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	LOCK(&zmgr->loadlock);
+	if (limit <= zmgr->nlanes || zmgr->loadshutdown)
+		goto setlimit;
+
+	/*
+	 * Each load that runs at once gets a task of its own.  Tasks are
+	 * added as the limit grows and kept when it shrinks.
+	 */
+	lanes = isc_mem_get(zmgr->mctx, limit * sizeof(lanes[0]));
+	freelanes = isc_mem_get(zmgr->mctx, limit * sizeof(freelanes[0]));
+	if (lanes == NULL || freelanes == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	for (i = 0; i < limit; i++)
+		lanes[i] = (i < zmgr->nlanes) ? zmgr->lanes[i] : NULL;
+	for (i = zmgr->nlanes; i < limit; i++) {
+		result = isc_task_create(zmgr->taskmgr, 0, &lanes[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		isc_task_setname(lanes[i], "loadzone", zmgr);
+		/* See dns_zonemgr_setsize(). */
+		isc_task_setprivilege(lanes[i], true);
+	}
+
+	if (zmgr->nfreelanes > 0)
+		memmove(freelanes, zmgr->freelanes,
+			zmgr->nfreelanes * sizeof(freelanes[0]));
+	n = zmgr->nfreelanes;
+	for (i = limit; i > zmgr->nlanes; i--)
+		freelanes[n++] = i - 1;
+
+	if (zmgr->lanes != NULL) {
+		isc_mem_put(zmgr->mctx, zmgr->lanes,
+			    zmgr->nlanes * sizeof(zmgr->lanes[0]));
+		isc_mem_put(zmgr->mctx, zmgr->freelanes,
+			    zmgr->nlanes * sizeof(zmgr->freelanes[0]));
+	}
+	zmgr->lanes = lanes;
+	zmgr->freelanes = freelanes;
+	zmgr->nlanes = limit;
+	zmgr->nfreelanes = n;
+	lanes = NULL;
+	freelanes = NULL;
+
+ setlimit:
+	zmgr->loadlimit = limit;
+	zonemgr_startloads(zmgr);
+
+ cleanup:
+	UNLOCK(&zmgr->loadlock);
+
+	if (lanes != NULL) {
+		for (i = zmgr->nlanes; i < limit; i++)
+			if (lanes[i] != NULL)
+				isc_task_detach(&lanes[i]);
+		isc_mem_put(zmgr->mctx, lanes, limit * sizeof(lanes[0]));
+	}
+	if (freelanes != NULL)
+		isc_mem_put(zmgr->mctx, freelanes,
+			    limit * sizeof(freelanes[0]));
+	return (result);
+}
+
+unsigned int
+dns_zonemgr_getloadlimit(dns_zonemgr_t *zmgr) {
+	unsigned int limit;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	LOCK(&zmgr->loadlock);
+	limit = zmgr->loadlimit;
+	UNLOCK(&zmgr->loadlock);
+
+	return (limit);
+}
+
+void
+dns_zonemgr_setloadorder(dns_zonemgr_t *zmgr, dns_zoneloadorder_t order) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	/*
+	 * Loads already queued keep their place.
+	 */
+	LOCK(&zmgr->loadlock);
+	zmgr->loadorder = order;
+	UNLOCK(&zmgr->loadlock);
+}
+
+void
+dns_zonemgr_holdloads(dns_zonemgr_t *zmgr) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	LOCK(&zmgr->loadlock);
+	zmgr->loadhold++;
+	INSIST(zmgr->loadhold != 0);
+	UNLOCK(&zmgr->loadlock);
+}
+
+void
+dns_zonemgr_releaseloads(dns_zonemgr_t *zmgr) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	LOCK(&zmgr->loadlock);
+	INSIST(zmgr->loadhold > 0);
+	zmgr->loadhold--;
+	zonemgr_startloads(zmgr);
+	UNLOCK(&zmgr->loadlock);
+}
+
+/*
+ * Start as many queued loads as the limit allows.
+ *
+ * Requires:
+ *	The caller holds the load lock.
+ */
+static void
+zonemgr_startloads(dns_zonemgr_t *zmgr) {
+	dns_asyncload_t *asl;
+	isc_task_t *task;
+
+	while (zmgr->loadhold == 0 &&
+	       (zmgr->loadlimit == 0 ||
+		zmgr->loadprogress.active < zmgr->loadlimit) &&
+	       (asl = isc_heap_element(zmgr->loadqueue, 1)) != NULL)
+	{
+		isc_heap_delete(zmgr->loadqueue, 1);
+
+		/*
+		 * Without a limit, or if the lanes could not all be
+		 * created, the load runs on the zone's own load task,
+		 * which it may share with other zones.
+		 */
+		if (zmgr->loadlimit != 0 && zmgr->nfreelanes > 0) {
+			asl->lane = zmgr->freelanes[--zmgr->nfreelanes];
+			task = zmgr->lanes[asl->lane];
+		} else
+			task = asl->zone->loadtask;
+
+		zmgr->loadprogress.active++;
+		isc_task_send(task, &asl->event);
+	}
+}
+
+static isc_result_t
+zonemgr_queueload(dns_zonemgr_t *zmgr, dns_asyncload_t *asl) {
+	isc_result_t result;
+
+	LOCK(&zmgr->loadlock);
+	if (zmgr->loadshutdown) {
+		result = ISC_R_SHUTTINGDOWN;
+		goto unlock;
+	}
+
+	if (zmgr->loadprogress.active == 0 &&
+	    isc_heap_element(zmgr->loadqueue, 1) == NULL)
+	{
+		/*
+		 * The first load of a new run: start counting again.
+		 */
+		memset(&zmgr->loadprogress, 0, sizeof(zmgr->loadprogress));
+		TIME_NOW(&zmgr->loadstart);
+		zmgr->loadlogged = zmgr->loadstart;
+		zmgr->loadseq = 0;
+	}
+
+	asl->seq = zmgr->loadseq++;
+	if (zmgr->loadorder == dns_zoneloadorder_size)
+		asl->key = asl->size;
+	else
+		asl->key = 0;
+	result = isc_heap_insert(zmgr->loadqueue, asl);
+	if (result != ISC_R_SUCCESS)
+		goto unlock;
+
+	zmgr->loadprogress.total++;
+	zmgr->loadprogress.bytes += asl->size;
+	zonemgr_startloads(zmgr);
+
+ unlock:
+	UNLOCK(&zmgr->loadlock);
+	return (result);
+}
+
+/*
+ * Requires:
+ *	The caller holds the load lock.
+ */
+static void
+zonemgr_loadprogress(dns_zonemgr_t *zmgr, const isc_time_t *now,
+		     dns_zoneloadprogress_t *progress)
+{
+	uint64_t done, left;
+
+	*progress = zmgr->loadprogress;
+	if (progress->active == 0 &&
+	    isc_heap_element(zmgr->loadqueue, 1) == NULL)
+	{
+		/* Finished, or never started. */
+		progress->eta = 0;
+		return;
+	}
+
+	progress->usecs = isc_time_microdiff(now, &zmgr->loadstart);
+	if (progress->bytes != 0) {
+		done = progress->bytesloaded;
+		left = progress->bytes - progress->bytesloaded;
+	} else {
+		done = progress->loaded;
+		left = progress->total - progress->loaded;
+	}
+	if (done != 0)
+		progress->eta = (uint64_t)((double)progress->usecs *
+					   left / done);
+	else
+		progress->eta = 0;
+}
+
+static void
+zonemgr_loaddone(dns_zonemgr_t *zmgr, dns_asyncload_t *asl) {
+	dns_zoneloadprogress_t progress;
+	isc_time_t now;
+	bool finished = false, logprogress = false;
+
+	TIME_NOW(&now);
+
+	LOCK(&zmgr->loadlock);
+	INSIST(zmgr->loadprogress.active > 0);
+	zmgr->loadprogress.active--;
+	zmgr->loadprogress.loaded++;
+	zmgr->loadprogress.bytesloaded += asl->size;
+	if (asl->lane != NOLANE) {
+		INSIST(zmgr->nfreelanes < zmgr->nlanes);
+		zmgr->freelanes[zmgr->nfreelanes++] = asl->lane;
+		asl->lane = NOLANE;
+	}
+	zonemgr_startloads(zmgr);
+
+	if (zmgr->loadprogress.active == 0 &&
+	    isc_heap_element(zmgr->loadqueue, 1) == NULL)
+	{
+		zmgr->loadprogress.usecs = isc_time_microdiff(&now,
+							      &zmgr->loadstart);
+		progress = zmgr->loadprogress;
+		finished = true;
+	} else if (isc_time_microdiff(&now, &zmgr->loadlogged) >=
+		   LOADPROGRESS_INTERVAL)
+	{
+		zmgr->loadlogged = now;
+		zonemgr_loadprogress(zmgr, &now, &progress);
+		logprogress = true;
+	}
+	UNLOCK(&zmgr->loadlock);
+
+	if (logprogress) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_ZONE, ISC_LOG_INFO,
+			      "loading zones: %u of %u loaded, %u in progress, "
+			      "%" PRIu64 " seconds elapsed, "
+			      "about %" PRIu64 " seconds left",
+			      progress.loaded, progress.total, progress.active,
+			      progress.usecs / 1000000,
+			      progress.eta / 1000000);
+	} else if (finished && progress.total > 1) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_ZONE,
+			      progress.usecs >= 1000000 ?
+			      ISC_LOG_INFO : ISC_LOG_DEBUG(1),
+			      "loaded %u zones (%" PRIu64 " bytes) "
+			      "in %" PRIu64 ".%03u seconds",
+			      progress.loaded, progress.bytesloaded,
+			      progress.usecs / 1000000,
+			      (unsigned int)(progress.usecs % 1000000 /
+					     1000));
+	}
+}
+
+void
+dns_zonemgr_getloadprogress(dns_zonemgr_t *zmgr,
+			    dns_zoneloadprogress_t *progress)
+{
+	isc_time_t now;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(progress != NULL);
+
+	TIME_NOW(&now);
+
+	LOCK(&zmgr->loadlock);
+	zonemgr_loadprogress(zmgr, &now, progress);
+	UNLOCK(&zmgr->loadlock);
+}
+
 /*
  * Get permission to request a file handle from the OS.
  * An event will be sent to action when one is available.
@@ -17149,6 +18594,55 @@ dns_zonemgr_getserialqueryrate(dns_zonemgr_t *zmgr) {
 	return (zmgr->serialqueryrate);
 }
 
+void
+dns_zonemgr_setdumprate(dns_zonemgr_t *zmgr, unsigned int value) {
+	isc_interval_t interval;
+	uint64_t ns;
+	size_t chunk;
+	isc_result_t result;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	zmgr->dumprate = value;
+	if (value == 0) {
+		zmgr->dumpchunk = 0;
+		return;
+	}
+
+	/*
+	 * Each tick of the rate limiter lets one dump write one chunk.
+	 * Slow rates use smaller chunks rather than ticks more than a
+	 * second apart.
+	 */
+	chunk = ISC_MIN(value, DNS_DUMP_CHUNK);
+	ns = (uint64_t)chunk * 1000000000 / value;
+	isc_interval_set(&interval, (unsigned int)(ns / 1000000000),
+			 (unsigned int)(ns % 1000000000));
+	result = isc_ratelimiter_setinterval(zmgr->dumprl, &interval);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	isc_ratelimiter_setpertic(zmgr->dumprl, 1);
+	zmgr->dumpchunk = chunk;
+}
+
+unsigned int
+dns_zonemgr_getdumprate(dns_zonemgr_t *zmgr) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	return (zmgr->dumprate);
+}
+
+void
+dns_zonemgr_setcryptopool(dns_zonemgr_t *zmgr, dns_cryptopool_t *pool) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	if (zmgr->cryptopool != NULL)
+		dns_cryptopool_detach(&zmgr->cryptopool);
+	if (pool != NULL)
+		dns_cryptopool_attach(pool, &zmgr->cryptopool);
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+}
+
 bool
 dns_zonemgr_unreachable(dns_zonemgr_t *zmgr, isc_sockaddr_t *remote,
 			isc_sockaddr_t *local, isc_time_t *now)
@@ -17629,6 +19123,34 @@ dns_zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm,
 	return (result);
 }
 
+isc_result_t
+dns_zone_getsigningprogress(dns_zone_t *zone, dns_secalg_t algorithm,
+			    uint16_t keyid, uint32_t *nodesp)
+{
+	dns_signing_t *signing;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(nodesp != NULL);
+
+	LOCK_ZONE(zone);
+	for (signing = ISC_LIST_HEAD(zone->signing);
+	     signing != NULL;
+	     signing = ISC_LIST_NEXT(signing, link))
+	{
+		if (signing->algorithm == algorithm &&
+		    signing->keyid == keyid)
+		{
+			*nodesp = signing->nodes;
+			result = ISC_R_SUCCESS;
+			break;
+		}
+	}
+	UNLOCK_ZONE(zone);
+
+	return (result);
+}
+
 /*
  * Called when a dynamic update for an NSEC3PARAM record is received.
  *
@@ -17718,6 +19240,7 @@ zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm, uint16_t keyid,
 	signing->keyid = keyid;
 	signing->deleteit = deleteit;
 	signing->done = false;
+	signing->nodes = 0;
 
 	TIME_NOW(&now);
 
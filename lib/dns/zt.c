@@ -28,6 +28,7 @@
 #include <dns/name.h>
 #include <dns/rbt.h>
 #include <dns/rdataclass.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -135,6 +136,9 @@ dns_zt_mount(dns_zt_t *zt, dns_zone_t *zone) {
 
 	RWUNLOCK(&zt->rwlock, isc_rwlocktype_write);
 
+	if (result == ISC_R_SUCCESS)
+		dns_respcache_invalidate(zt);
+
 	return (result);
 }
 
@@ -153,6 +157,9 @@ dns_zt_unmount(dns_zt_t *zt, dns_zone_t *zone) {
 
 	RWUNLOCK(&zt->rwlock, isc_rwlocktype_write);
 
+	if (result == ISC_R_SUCCESS)
+		dns_respcache_invalidate(zt);
+
 	return (result);
 }
 
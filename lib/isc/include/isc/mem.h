@@ -322,6 +322,14 @@ isc_mem_createx2(size_t max_size, size_t target_size,
  * used to record active memory when ISC_MEM_DEBUGRECORD is set.  Setting
  * 'max_size' too low can have detrimental effects on performance.
  *
+ * In threaded builds, a context with ISC_MEMFLAG_INTERNAL set and
+ * ISC_MEMFLAG_NOLOCK clear keeps a small per-thread cache of free blocks
+ * smaller than 'max_size', so that most isc_mem_get() and isc_mem_put()
+ * calls do not take the context lock.  Cached blocks are counted as in
+ * use by isc_mem_inuse() but not when checking the water marks, and are
+ * returned to the context when it is destroyed.  The caches are bypassed
+ * while isc_mem_debugging is non-zero.
+ *
  * A memory context created using isc_mem_createx() will obtain
  * memory from the system by calling 'memalloc' and 'memfree',
  * passing them the argument 'arg'.  A memory context created
@@ -622,6 +630,11 @@ isc_mempool_associatelock(isc_mempool_t *mpctx, isc_mutex_t *lock);
  * by other than mempool routines once it is given to a pool, since that can
  * easily cause double locking.
  *
+ * Where atomic operations are available, a pool with an associated lock
+ * also keeps a small per-thread cache of free items; the lock is then only
+ * taken to refill or drain a thread's cache.  Items in thread caches are
+ * not counted by isc_mempool_getallocated() or isc_mempool_getfreecount().
+ *
  * Requires:
  *
  *\li	mpctpx is a valid pool.
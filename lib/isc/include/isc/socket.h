@@ -72,6 +72,7 @@
 #define isc_socket_detach isc__socket_detach
 #define isc_socketmgr_create isc__socketmgr_create
 #define isc_socketmgr_create2 isc__socketmgr_create2
+#define isc_socketmgr_create3 isc__socketmgr_create3
 #define isc_socketmgr_destroy isc__socketmgr_destroy
 #define isc_socket_open isc__socket_open
 #define isc_socket_close isc__socket_close
@@ -129,6 +130,15 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_SOCKET_REUSEADDRESS		0x01U
 
+/*%
+ * In isc_socket_bind() set socket option SO_REUSEPORT prior to calling
+ * bind() (AF_INET and AF_INET6), so that several sockets can be bound to
+ * the same address and the kernel will distribute incoming datagrams
+ * between them.  isc_socket_bind() fails
+ * with ISC_R_NOTIMPLEMENTED if the platform does not support it.
+ */
+#define ISC_SOCKET_REUSEPORT		0x02U
+
 /*%
  * Statistics counters.  Used as isc_statscounter_t values.
  */
@@ -705,6 +715,7 @@ isc_socket_bind(isc_socket_t *sock, isc_sockaddr_t *addressp,
  * \li	ISC_R_ADDRNOTAVAIL
  * \li	ISC_R_ADDRINUSE
  * \li	ISC_R_BOUND
+ * \li	ISC_R_NOTIMPLEMENTED (ISC_SOCKET_REUSEPORT is not supported)
  * \li	ISC_R_UNEXPECTED
  */
 
@@ -1026,11 +1037,24 @@ isc_socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 isc_result_t
 isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		      unsigned int maxsocks);
+
+isc_result_t
+isc_socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		      unsigned int maxsocks, unsigned int nthreads);
 /*%<
  * Create a socket manager.  If "maxsocks" is non-zero, it specifies the
  * maximum number of sockets that the created manager should handle.
  * isc_socketmgr_create() is equivalent of isc_socketmgr_create2() with
  * "maxsocks" being zero.
+ * isc_socketmgr_create2() is equivalent of isc_socketmgr_create3() with
+ * "nthreads" being one.
+ *
+ * "nthreads" is the number of socket threads.  Each socket thread runs
+ * its own event loop (epoll, kqueue or /dev/poll descriptor) and watches
+ * a disjoint subset of the manager's sockets, so readiness events for
+ * different sockets can be processed in parallel.  Zero is treated as
+ * one.  It is ignored (one loop is used) when the platform only
+ * supports select() or when built without threads.
  * isc_socketmgr_createinctx() also associates the new manager with the
  * specified application context.
  *
@@ -26,6 +26,11 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_STATSDUMP_VERBOSE	0x00000001 /*%< dump 0-value counters */
 
+/*%<
+ * Flag(s) for isc_stats_create2().
+ */
+#define ISC_STATSCREATE_PERTHREAD 0x00000001 /*%< per-thread counters */
+
 /*%<
  * Dump callback type.
  */
@@ -48,6 +53,32 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int options);
+/*%<
+ * Like isc_stats_create(), with options.
+ *
+ * If ISC_STATSCREATE_PERTHREAD is set and the platform has atomic
+ * operations, each counter is split into several copies, each in a
+ * different cache line, and threads update only their own copy; the
+ * copies are summed when the counters are read.  This avoids contention
+ * on counters updated for every query, at the cost of memory proportional
+ * to the number of CPUs.  isc_stats_set() and
+ * isc_stats_update_if_greater() should not be used on a counter that is
+ * also incremented or decremented.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	-- all ok
+ *
+ *\li	anything else	-- failure
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
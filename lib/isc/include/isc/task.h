@@ -206,6 +206,45 @@ isc_task_create(isc_taskmgr_t *manager, unsigned int quantum,
  *\li	#ISC_R_SHUTTINGDOWN
  */
 
+isc_result_t
+isc_task_create_bound(isc_taskmgr_t *manager, unsigned int quantum,
+		      isc_task_t **taskp, int threadid);
+/*%<
+ * Create a task bound to worker thread 'threadid'.
+ *
+ * Notes:
+ *
+ *\li	Each worker thread of a threaded task manager has its own run
+ *	queue.  The events of a bound task are always processed by the
+ *	worker 'threadid' modulo the number of workers, and the task is
+ *	never stolen by another worker; this keeps the data it works on
+ *	in the cache of one CPU.
+ *
+ *\li	If 'threadid' is negative the task is not bound and behaves
+ *	exactly as one created by isc_task_create(): it is assigned a
+ *	home worker round robin, and an idle worker may take it over
+ *	while its home worker is busy.
+ *
+ *\li	Task managers which do not support affinity ignore 'threadid'.
+ *
+ * Requires:
+ *
+ *\li	'manager' is a valid task manager.
+ *
+ *\li	taskp != NULL && *taskp == NULL
+ *
+ * Ensures:
+ *
+ *\li	On success, '*taskp' is bound to the new task.
+ *
+ * Returns:
+ *
+ *\li   #ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_UNEXPECTED
+ *\li	#ISC_R_SHUTTINGDOWN
+ */
+
 void
 isc_task_attach(isc_task_t *source, isc_task_t **targetp);
 /*%<
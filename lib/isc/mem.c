@@ -28,13 +28,19 @@
 #include <isc/msgs.h>
 #include <isc/once.h>
 #include <isc/ondestroy.h>
+#include <isc/platform.h>
 #include <isc/string.h>
 #include <isc/strerror.h>
 #include <isc/mutex.h>
 #include <isc/print.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/xml.h>
 
+#if defined(ISC_PLATFORM_USETHREADS) && defined(ISC_PLATFORM_HAVESTDATOMIC)
+#include <stdatomic.h>
+#endif
+
 #define MCTXLOCK(m, l) if (((m)->flags & ISC_MEMFLAG_NOLOCK) == 0) LOCK(l)
 #define MCTXUNLOCK(m, l) if (((m)->flags & ISC_MEMFLAG_NOLOCK) == 0) UNLOCK(l)
 
@@ -55,6 +61,26 @@ LIBISC_EXTERNAL_DATA unsigned int isc_mem_defaultflags = ISC_MEMFLAG_DEFAULT;
 #define TABLE_INCREMENT		1024
 #define DEBUGLIST_COUNT		1024
 
+#ifdef ISC_PLATFORM_USETHREADS
+/*
+ * Per-thread caches.  Each thread is given a small index, and each
+ * internal memory context keeps a cache of free blocks for every index,
+ * so that most isc_mem_get() and isc_mem_put() calls only touch the
+ * calling thread's cache and never take the context lock.  Caches are
+ * refilled and flushed in batches of half their limit.  Pools with an
+ * associated lock do the same with their items.
+ */
+#define MEM_THREADCACHES	1
+#define MAXTHREADCACHES		64	/*%< threads with their own caches */
+#define TCACHE_CLASSBYTES	8192	/*%< bytes held per size class */
+#define TCACHE_MINCOUNT		4	/*%< min. blocks held per size class */
+#define TCACHE_MAXCOUNT		64	/*%< max. blocks held per size class */
+#define MPCACHE_COUNT		32	/*%< items held per pool and thread */
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#define MEMPOOL_THREADCACHES	1
+#endif
+#endif
+
 /*
  * Types.
  */
@@ -102,6 +128,30 @@ struct stats {
 	unsigned long		freefrags;
 };
 
+#ifdef MEM_THREADCACHES
+typedef struct tcache tcache_t;
+struct tcache {
+	unsigned long		gets;	/*%< not yet added to ctx->tcgets */
+	size_t			cached;	/*%< bytes held in 'classes' */
+	size_t			reported; /*%< 'cached' as in ctx->tccached */
+	struct tclass {
+		element *	items;
+		unsigned int	count;
+		unsigned int	limit;
+	} *			classes; /*%< indexed by size / ALIGNMENT_SIZE */
+};
+#endif
+
+#ifdef MEMPOOL_THREADCACHES
+typedef union {
+	struct {
+		element *	items;
+		unsigned int	count;
+	} c;
+	char			pad[64]; /*%< one cache line per thread */
+} mpcache_t;
+#endif
+
 #define MEM_MAGIC		ISC_MAGIC('M', 'e', 'm', 'C')
 #define VALID_CONTEXT(c)	ISC_MAGIC_VALID(c, MEM_MAGIC)
 
@@ -117,6 +167,15 @@ static isc_once_t		once = ISC_ONCE_INIT;
 static isc_mutex_t		contextslock;
 static isc_mutex_t 		createlock;
 
+#ifdef MEM_THREADCACHES
+/*%
+ * Thread cache indices; tcache_inuse[] is locked by contextslock.
+ */
+static isc_thread_key_t		tcache_key;
+static bool			tcache_keyok = false;
+static bool			tcache_inuse[MAXTHREADCACHES];
+#endif
+
 /*%
  * Total size of lost memory due to a bug of external library.
  * Locked by the global lock.
@@ -167,6 +226,16 @@ struct isc__mem {
 
 	unsigned int		memalloc_failures;
 	ISC_LINK(isc__mem_t)	link;
+
+#ifdef MEM_THREADCACHES
+	bool			tcaching;
+	tcache_t *		tcaches[MAXTHREADCACHES];
+	unsigned int		tccount;
+	size_t			tccached;
+	unsigned long		tcgets;
+	unsigned long		tcfills;
+	unsigned long		tcflushes;
+#endif
 };
 
 #define MEMPOOL_MAGIC		ISC_MAGIC('M', 'E', 'M', 'p')
@@ -193,6 +262,12 @@ struct isc__mempool {
 #if ISC_MEMPOOL_NAMES
 	char		name[16];	/*%< printed name in stats reports */
 #endif
+#ifdef MEMPOOL_THREADCACHES
+	/*%< set once by isc_mempool_associatelock() */
+	mpcache_t      *tcaches;	/*%< per-thread item caches */
+	/*%< replaces 'allocated' when 'tcaches' is set */
+	atomic_uint_fast32_t tcallocated;
+#endif
 };
 
 /*
@@ -778,6 +853,370 @@ mem_putunlocked(isc__mem_t *ctx, void *mem, size_t size) {
 	ctx->inuse -= new_size;
 }
 
+#ifdef MEM_THREADCACHES
+static void
+tcache_release(void *arg) {
+	uintptr_t idx = (uintptr_t)arg - 1;
+
+	if (idx < MAXTHREADCACHES) {
+		LOCK(&contextslock);
+		tcache_inuse[idx] = false;
+		UNLOCK(&contextslock);
+	}
+}
+
+/*%
+ * Return the calling thread's cache index, assigning one on first use,
+ * or MAXTHREADCACHES if the thread cannot have caches.
+ */
+static inline unsigned int
+tcache_index(void) {
+	uintptr_t value;
+	unsigned int idx;
+
+	if (!tcache_keyok)
+		return (MAXTHREADCACHES);
+
+	value = (uintptr_t)isc_thread_key_getspecific(tcache_key);
+	if (ISC_LIKELY(value != 0))
+		return ((unsigned int)(value - 1));
+
+	LOCK(&contextslock);
+	for (idx = 0; idx < MAXTHREADCACHES; idx++) {
+		if (!tcache_inuse[idx]) {
+			tcache_inuse[idx] = true;
+			break;
+		}
+	}
+	UNLOCK(&contextslock);
+
+	if (isc_thread_key_setspecific(tcache_key,
+				       (void *)(uintptr_t)(idx + 1)) != 0)
+	{
+		tcache_release((void *)(uintptr_t)(idx + 1));
+		idx = MAXTHREADCACHES;
+	}
+
+	return (idx);
+}
+#endif /* MEM_THREADCACHES */
+
+/*%
+ * Return the amount of memory in use in 'ctx' for the purposes of the
+ * water marks: blocks sitting idle in thread caches are not counted.
+ * Requires 'ctx' to be locked.
+ */
+static inline size_t
+water_inuse(isc__mem_t *ctx) {
+#ifdef MEM_THREADCACHES
+	if (ctx->tccached < ctx->inuse)
+		return (ctx->inuse - ctx->tccached);
+	return (0);
+#else
+	return (ctx->inuse);
+#endif
+}
+
+/*%
+ * Update the overmem state after memory has been taken from 'ctx'.
+ * Returns true if the high water callback should be called.
+ * Requires 'ctx' to be locked.
+ */
+static inline bool
+check_hiwater(isc__mem_t *ctx) {
+	bool call_water = false;
+
+	if (ctx->hi_water != 0U && water_inuse(ctx) > ctx->hi_water) {
+		ctx->is_overmem = true;
+		if (!ctx->hi_called)
+			call_water = true;
+	}
+	if (ctx->inuse > ctx->maxinuse) {
+		ctx->maxinuse = ctx->inuse;
+		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
+			fprintf(stderr, "maxinuse = %lu\n",
+				(unsigned long)ctx->inuse);
+	}
+
+	return (call_water);
+}
+
+/*%
+ * Update the overmem state after memory has been returned to 'ctx'.
+ * Returns true if the low water callback should be called.
+ * Requires 'ctx' to be locked.
+ */
+static inline bool
+check_lowater(isc__mem_t *ctx) {
+	bool call_water = false;
+
+	/*
+	 * The check against ctx->lo_water == 0 is for the condition
+	 * when the context was pushed over hi_water but then had
+	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
+	 */
+	if ((water_inuse(ctx) < ctx->lo_water) || (ctx->lo_water == 0U)) {
+		ctx->is_overmem = false;
+		if (ctx->hi_called)
+			call_water = true;
+	}
+
+	return (call_water);
+}
+
+#ifdef MEM_THREADCACHES
+/*
+ * A block may be taken from one thread's cache and returned to another's,
+ * or to the context directly, so contexts with thread caches account for
+ * small blocks by their quantized size.
+ */
+static inline size_t
+tcache_getsize(isc__mem_t *ctx, size_t size) {
+	size_t new_size;
+
+	if (!ctx->tcaching)
+		return (size);
+	new_size = quantize(size);
+	return (new_size < ctx->max_size ? new_size : size);
+}
+
+static inline size_t
+tcache_putsize(isc__mem_t *ctx, void *mem, size_t size) {
+	size_t new_size = tcache_getsize(ctx, size);
+
+#if ISC_MEM_FILL && ISC_MEM_CHECKOVERRUN
+	if (new_size != size)
+		check_overrun(mem, size, new_size);
+#else
+	UNUSED(mem);
+#endif
+	return (new_size);
+}
+
+static inline size_t
+tcache_size(isc__mem_t *ctx) {
+	return (sizeof(tcache_t) + (ctx->max_size / ALIGNMENT_SIZE + 1) *
+		sizeof(struct tclass));
+}
+
+/*%
+ * Return the calling thread's cache for 'ctx', creating it on first use,
+ * or NULL if 'size' bytes cannot be cached.
+ */
+static inline tcache_t *
+tcache_find(isc__mem_t *ctx, size_t size) {
+	tcache_t *tc;
+	unsigned int idx, i, nclasses;
+	size_t count;
+
+	if (!ctx->tcaching || size >= ctx->max_size || isc_mem_debugging != 0)
+		return (NULL);
+
+	idx = tcache_index();
+	if (ISC_UNLIKELY(idx >= MAXTHREADCACHES))
+		return (NULL);
+
+	tc = ctx->tcaches[idx];
+	if (ISC_LIKELY(tc != NULL))
+		return (tc);
+
+	nclasses = ctx->max_size / ALIGNMENT_SIZE + 1;
+	tc = (ctx->memalloc)(ctx->arg, tcache_size(ctx));
+	if (tc == NULL)
+		return (NULL);
+	tc->gets = 0;
+	tc->cached = 0;
+	tc->reported = 0;
+	tc->classes = (struct tclass *)(tc + 1);
+	for (i = 0; i < nclasses; i++) {
+		count = TCACHE_CLASSBYTES / ((i == 0 ? 1 : i) * ALIGNMENT_SIZE);
+		if (count < TCACHE_MINCOUNT)
+			count = TCACHE_MINCOUNT;
+		if (count > TCACHE_MAXCOUNT)
+			count = TCACHE_MAXCOUNT;
+		tc->classes[i].items = NULL;
+		tc->classes[i].count = 0;
+		tc->classes[i].limit = (unsigned int)count;
+	}
+
+	LOCK(&ctx->lock);
+	ctx->tcaches[idx] = tc;
+	ctx->tccount++;
+	UNLOCK(&ctx->lock);
+
+	return (tc);
+}
+
+/*%
+ * Fold the blocks taken from and returned to 'tc' since it was last
+ * synced into 'ctx'.  Requires 'ctx' to be locked.
+ */
+static inline void
+tcache_sync(isc__mem_t *ctx, tcache_t *tc) {
+	INSIST(ctx->tccached >= tc->reported);
+	ctx->tccached -= tc->reported;
+	ctx->tccached += tc->cached;
+	tc->reported = tc->cached;
+	ctx->tcgets += tc->gets;
+	tc->gets = 0;
+}
+
+/*%
+ * Called when the bytes held in 'tc' have drifted more than
+ * TCACHE_CLASSBYTES from what 'ctx' last saw, so that the water marks
+ * never lag far behind the memory that has really been handed out.
+ */
+static void
+tcache_report(isc__mem_t *ctx, tcache_t *tc, bool taken) {
+	bool call_water;
+
+	LOCK(&ctx->lock);
+	tcache_sync(ctx, tc);
+	call_water = taken ? check_hiwater(ctx) : check_lowater(ctx);
+	UNLOCK(&ctx->lock);
+
+	if (call_water && (ctx->water != NULL))
+		(ctx->water)(ctx->water_arg,
+			     taken ? ISC_MEM_HIWATER : ISC_MEM_LOWATER);
+}
+
+static void
+tcache_fill(isc__mem_t *ctx, tcache_t *tc, struct tclass *cl, size_t size) {
+	unsigned int i;
+	element *item;
+	bool call_water;
+
+	LOCK(&ctx->lock);
+	for (i = 0; i < cl->limit / 2; i++) {
+		item = mem_getunlocked(ctx, size);
+		if (item == NULL)
+			break;
+		item->next = cl->items;
+		cl->items = item;
+		cl->count++;
+		tc->cached += size;
+	}
+	tcache_sync(ctx, tc);
+	ctx->tcfills++;
+	call_water = check_hiwater(ctx);
+	UNLOCK(&ctx->lock);
+
+	if (call_water && (ctx->water != NULL))
+		(ctx->water)(ctx->water_arg, ISC_MEM_HIWATER);
+}
+
+/*%
+ * Return all but the 'keep' most recently cached blocks of 'cl' to 'ctx'.
+ */
+static void
+tcache_flush(isc__mem_t *ctx, tcache_t *tc, struct tclass *cl, size_t size,
+	     unsigned int keep)
+{
+	element *item, *next, **itemp;
+	unsigned int i;
+	bool call_water;
+
+	itemp = &cl->items;
+	for (i = 0; i < keep && *itemp != NULL; i++)
+		itemp = &(*itemp)->next;
+	item = *itemp;
+	*itemp = NULL;
+	cl->count = i;
+
+	LOCK(&ctx->lock);
+	while (item != NULL) {
+		next = item->next;
+		mem_putunlocked(ctx, item, size);
+		INSIST(tc->cached >= size);
+		tc->cached -= size;
+		item = next;
+	}
+	tcache_sync(ctx, tc);
+	ctx->tcflushes++;
+	call_water = check_lowater(ctx);
+	UNLOCK(&ctx->lock);
+
+	if (call_water && (ctx->water != NULL))
+		(ctx->water)(ctx->water_arg, ISC_MEM_LOWATER);
+}
+
+static inline void *
+tcache_get(isc__mem_t *ctx, tcache_t *tc, size_t size) {
+	struct tclass *cl = &tc->classes[size / ALIGNMENT_SIZE];
+	element *item;
+
+	if (ISC_UNLIKELY(cl->items == NULL)) {
+		tcache_fill(ctx, tc, cl, size);
+		if (cl->items == NULL)
+			return (NULL);
+	}
+
+	item = cl->items;
+	cl->items = item->next;
+	cl->count--;
+	tc->gets++;
+	tc->cached -= size;
+	if (ISC_UNLIKELY(tc->reported > tc->cached &&
+			 tc->reported - tc->cached > TCACHE_CLASSBYTES))
+		tcache_report(ctx, tc, true);
+
+#if ISC_MEM_FILL
+	memset(item, 0xbe, size); /* Mnemonic for "beef". */
+#endif
+
+	return (item);
+}
+
+static inline void
+tcache_put(isc__mem_t *ctx, tcache_t *tc, void *mem, size_t size) {
+	struct tclass *cl = &tc->classes[size / ALIGNMENT_SIZE];
+	element *item = mem;
+
+#if ISC_MEM_FILL
+	memset(mem, 0xde, size); /* Mnemonic for "dead". */
+#endif
+
+	item->next = cl->items;
+	cl->items = item;
+	tc->cached += size;
+	if (ISC_UNLIKELY(++cl->count > cl->limit))
+		tcache_flush(ctx, tc, cl, size, cl->limit / 2);
+	else if (ISC_UNLIKELY(tc->cached > tc->reported &&
+			      tc->cached - tc->reported > TCACHE_CLASSBYTES))
+		tcache_report(ctx, tc, false);
+}
+
+/*%
+ * Return every cached block to 'ctx' and free the caches.  Called when
+ * 'ctx' is being destroyed, so no locking is needed.
+ */
+static void
+tcache_destroy(isc__mem_t *ctx) {
+	tcache_t *tc;
+	element *item;
+	unsigned int idx, i, nclasses;
+
+	nclasses = ctx->max_size / ALIGNMENT_SIZE + 1;
+	for (idx = 0; idx < MAXTHREADCACHES; idx++) {
+		tc = ctx->tcaches[idx];
+		if (tc == NULL)
+			continue;
+		for (i = 0; i < nclasses; i++) {
+			while ((item = tc->classes[i].items) != NULL) {
+				tc->classes[i].items = item->next;
+				mem_putunlocked(ctx, item, i * ALIGNMENT_SIZE);
+			}
+		}
+		ctx->tccached -= tc->reported;
+		ctx->tcgets += tc->gets;
+		(ctx->memfree)(ctx->arg, tc);
+		ctx->tcaches[idx] = NULL;
+	}
+	ctx->tccount = 0;
+}
+#endif /* MEM_THREADCACHES */
+
 /*!
  * Perform a malloc, doing memory filling and overrun detection as necessary.
  */
@@ -921,6 +1360,10 @@ initialize_action(void) {
 	RUNTIME_CHECK(isc_mutex_init(&contextslock) == ISC_R_SUCCESS);
 	ISC_LIST_INIT(contexts);
 	totallost = 0;
+#ifdef MEM_THREADCACHES
+	tcache_keyok = (isc_thread_key_create(&tcache_key,
+					      tcache_release) == 0);
+#endif
 }
 
 /*
@@ -1005,6 +1448,16 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 	ctx->basic_table_size = 0;
 	ctx->lowest = NULL;
 	ctx->highest = NULL;
+#ifdef MEM_THREADCACHES
+	ctx->tcaching = ((flags & (ISC_MEMFLAG_INTERNAL|ISC_MEMFLAG_NOLOCK)) ==
+			 ISC_MEMFLAG_INTERNAL);
+	memset(ctx->tcaches, 0, sizeof(ctx->tcaches));
+	ctx->tccount = 0;
+	ctx->tccached = 0;
+	ctx->tcgets = 0;
+	ctx->tcfills = 0;
+	ctx->tcflushes = 0;
+#endif
 
 	ctx->stats = (memalloc)(arg,
 				(ctx->max_size+1) * sizeof(struct stats));
@@ -1086,6 +1539,10 @@ destroy(isc__mem_t *ctx) {
 
 	INSIST(ISC_LIST_EMPTY(ctx->pools));
 
+#ifdef MEM_THREADCACHES
+	tcache_destroy(ctx);
+#endif
+
 #if ISC_MEM_TRACKLINES
 	if (ctx->debuglist != NULL) {
 		if (ctx->checkfree) {
@@ -1231,6 +1688,10 @@ isc___mem_putanddetach(isc_mem_t **ctxp, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#ifdef MEM_THREADCACHES
+	size = tcache_putsize(ctx, ptr, size);
+#endif
+
 	MCTXLOCK(ctx, &ctx->lock);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
@@ -1297,12 +1758,22 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	void *ptr;
 	bool call_water = false;
+#ifdef MEM_THREADCACHES
+	tcache_t *tc;
+#endif
 
 	REQUIRE(VALID_CONTEXT(ctx));
 
 	if ((isc_mem_debugging & (ISC_MEM_DEBUGSIZE|ISC_MEM_DEBUGCTX)) != 0)
 		return (isc__mem_allocate(ctx0, size FLARG_PASS));
 
+#ifdef MEM_THREADCACHES
+	size = tcache_getsize(ctx, size);
+	tc = tcache_find(ctx, size);
+	if (tc != NULL)
+		return (tcache_get(ctx, tc, size));
+#endif
+
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		ptr = mem_getunlocked(ctx, size);
@@ -1314,18 +1785,7 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	}
 
 	ADD_TRACE(ctx, ptr, size, file, line);
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water) {
-		ctx->is_overmem = true;
-		if (!ctx->hi_called)
-			call_water = true;
-	}
-	if (ctx->inuse > ctx->maxinuse) {
-		ctx->maxinuse = ctx->inuse;
-		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
-		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
-			fprintf(stderr, "maxinuse = %lu\n",
-				(unsigned long)ctx->inuse);
-	}
+	call_water = check_hiwater(ctx);
 	MCTXUNLOCK(ctx, &ctx->lock);
 
 	if (call_water && (ctx->water != NULL))
@@ -1340,6 +1800,9 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 	bool call_water = false;
 	size_info *si;
 	size_t oldsize;
+#ifdef MEM_THREADCACHES
+	tcache_t *tc;
+#endif
 
 	REQUIRE(VALID_CONTEXT(ctx));
 	REQUIRE(ptr != NULL);
@@ -1356,6 +1819,15 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#ifdef MEM_THREADCACHES
+	size = tcache_putsize(ctx, ptr, size);
+	tc = tcache_find(ctx, size);
+	if (tc != NULL) {
+		tcache_put(ctx, tc, ptr, size);
+		return;
+	}
+#endif
+
 	MCTXLOCK(ctx, &ctx->lock);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
@@ -1367,16 +1839,7 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		mem_put(ctx, ptr, size);
 	}
 
-	/*
-	 * The check against ctx->lo_water == 0 is for the condition
-	 * when the context was pushed over hi_water but then had
-	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
-	 */
-	if ((ctx->inuse < ctx->lo_water) || (ctx->lo_water == 0U)) {
-		ctx->is_overmem = false;
-		if (ctx->hi_called)
-			call_water = true;
-	}
+	call_water = check_lowater(ctx);
 
 	MCTXUNLOCK(ctx, &ctx->lock);
 
@@ -1568,13 +2031,13 @@ isc___mem_allocate(isc_mem_t *ctx0, size_t size FLARG) {
 		mem_getstats(ctx, si[-1].u.size);
 
 	ADD_TRACE(ctx, si, si[-1].u.size, file, line);
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+	if (ctx->hi_water != 0U && water_inuse(ctx) > ctx->hi_water &&
 	    !ctx->is_overmem) {
 		ctx->is_overmem = true;
 	}
 
 	if (ctx->hi_water != 0U && !ctx->hi_called &&
-	    ctx->inuse > ctx->hi_water) {
+	    water_inuse(ctx) > ctx->hi_water) {
 		ctx->hi_called = true;
 		call_water = true;
 	}
@@ -1668,12 +2131,12 @@ isc___mem_free(isc_mem_t *ctx0, void *ptr FLARG) {
 	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
 	 */
 	if (ctx->is_overmem &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+	    (water_inuse(ctx) < ctx->lo_water || ctx->lo_water == 0U)) {
 		ctx->is_overmem = false;
 	}
 
 	if (ctx->hi_called &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+	    (water_inuse(ctx) < ctx->lo_water || ctx->lo_water == 0U)) {
 		ctx->hi_called = false;
 
 		if (ctx->water != NULL)
@@ -1821,7 +2284,7 @@ isc__mem_setwater(isc_mem_t *ctx0, isc_mem_water_t water, void *water_arg,
 	} else {
 		if (ctx->hi_called &&
 		    (ctx->water != water || ctx->water_arg != water_arg ||
-		     ctx->inuse < lowater || lowater == 0U))
+		     water_inuse(ctx) < lowater || lowater == 0U))
 			callwater = true;
 		ctx->water = water;
 		ctx->water_arg = water_arg;
@@ -1934,6 +2397,10 @@ isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	mpctx->name[0] = 0;
 #endif
 	mpctx->items = NULL;
+#ifdef MEMPOOL_THREADCACHES
+	mpctx->tcaches = NULL;
+	atomic_init(&mpctx->tcallocated, 0);
+#endif
 
 	*mpctxp = (isc_mempool_t *)mpctx;
 
@@ -1980,13 +2447,13 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 
 	mpctx = (isc__mempool_t *)*mpctxp;
 #if ISC_MEMPOOL_NAMES
-	if (mpctx->allocated > 0)
+	if (isc__mempool_getallocated(*mpctxp) > 0)
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc__mempool_destroy(): mempool %s "
 				 "leaked memory",
 				 mpctx->name);
 #endif
-	REQUIRE(mpctx->allocated == 0);
+	REQUIRE(isc__mempool_getallocated(*mpctxp) == 0);
 
 	mctx = mpctx->mctx;
 
@@ -1995,6 +2462,27 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 	if (lock != NULL)
 		LOCK(lock);
 
+#ifdef MEMPOOL_THREADCACHES
+	/*
+	 * Move any items held by thread caches to the free list.
+	 */
+	if (mpctx->tcaches != NULL) {
+		unsigned int idx;
+
+		for (idx = 0; idx < MAXTHREADCACHES; idx++) {
+			while ((item = mpctx->tcaches[idx].c.items) != NULL) {
+				mpctx->tcaches[idx].c.items = item->next;
+				item->next = mpctx->items;
+				mpctx->items = item;
+				mpctx->freecount++;
+			}
+		}
+		isc_mem_put((isc_mem_t *)mctx, mpctx->tcaches,
+			    MAXTHREADCACHES * sizeof(mpcache_t));
+		mpctx->tcaches = NULL;
+	}
+#endif
+
 	/*
 	 * Return any items on the free list
 	 */
@@ -2044,31 +2532,33 @@ isc__mempool_associatelock(isc_mempool_t *mpctx0, isc_mutex_t *lock) {
 	REQUIRE(mpctx->lock == NULL);
 
 	mpctx->lock = lock;
-}
-
-void *
-isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
-	isc__mempool_t *mpctx;
-	element *item;
-	isc__mem_t *mctx;
-	unsigned int i;
-
-	REQUIRE(VALID_MEMPOOL(mpctx0));
-
-	mpctx = (isc__mempool_t *)mpctx0;
-
-	mctx = mpctx->mctx;
-
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
 
+#ifdef MEMPOOL_THREADCACHES
 	/*
-	 * Don't let the caller go over quota
+	 * A pool that is shared between threads gets per-thread caches,
+	 * unless items have already been handed out and counted in
+	 * 'allocated'.
 	 */
-	if (ISC_UNLIKELY(mpctx->allocated >= mpctx->maxalloc)) {
-		item = NULL;
-		goto out;
+	if (mpctx->allocated == 0) {
+		mpctx->tcaches = isc_mem_get((isc_mem_t *)mpctx->mctx,
+					     MAXTHREADCACHES *
+					     sizeof(mpcache_t));
+		if (mpctx->tcaches != NULL)
+			memset(mpctx->tcaches, 0,
+			       MAXTHREADCACHES * sizeof(mpcache_t));
 	}
+#endif
+}
+
+/*%
+ * Take an item from the pool's free list, filling the list from the
+ * memory context if it is empty.  Requires the pool to be locked.
+ */
+static inline element *
+mempool_take(isc__mempool_t *mpctx) {
+	isc__mem_t *mctx = mpctx->mctx;
+	element *item;
+	unsigned int i;
 
 	if (ISC_UNLIKELY(mpctx->items == NULL)) {
 		/*
@@ -2098,24 +2588,199 @@ isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 	 */
 	item = mpctx->items;
 	if (ISC_UNLIKELY(item == NULL))
-		goto out;
+		return (NULL);
 
 	mpctx->items = item->next;
 	INSIST(mpctx->freecount > 0);
 	mpctx->freecount--;
 	mpctx->gets++;
-	mpctx->allocated++;
+
+	return (item);
+}
+
+/*%
+ * Return an item to the pool's free list, or to the memory context if
+ * the free list is full.  Requires the pool to be locked.
+ */
+static inline void
+mempool_release(isc__mempool_t *mpctx, element *item) {
+	isc__mem_t *mctx = mpctx->mctx;
+
+	/*
+	 * If our free list is full, return this to the mctx directly.
+	 */
+	if (mpctx->freecount >= mpctx->freemax) {
+		MCTXLOCK(mctx, &mctx->lock);
+		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+			mem_putunlocked(mctx, item, mpctx->size);
+		} else {
+			mem_putstats(mctx, item, mpctx->size);
+			mem_put(mctx, item, mpctx->size);
+		}
+		MCTXUNLOCK(mctx, &mctx->lock);
+		return;
+	}
+
+	/*
+	 * Otherwise, attach it to our free list and bump the counter.
+	 */
+	mpctx->freecount++;
+	item->next = mpctx->items;
+	mpctx->items = item;
+}
+
+#ifdef MEMPOOL_THREADCACHES
+static inline unsigned int
+mempool_tcindex(void) {
+	if (isc_mem_debugging != 0)
+		return (MAXTHREADCACHES);
+	return (tcache_index());
+}
+
+static void *
+mempool_tcget(isc__mempool_t *mpctx) {
+	mpcache_t *tc;
+	element *item;
+	unsigned int idx, i;
+
+	/*
+	 * Don't let the caller go over quota
+	 */
+	if (ISC_UNLIKELY(atomic_fetch_add_explicit(&mpctx->tcallocated, 1,
+						   memory_order_relaxed) >=
+			 mpctx->maxalloc))
+	{
+		(void)atomic_fetch_sub_explicit(&mpctx->tcallocated, 1,
+						memory_order_relaxed);
+		return (NULL);
+	}
+
+	idx = mempool_tcindex();
+	if (ISC_UNLIKELY(idx >= MAXTHREADCACHES)) {
+		LOCK(mpctx->lock);
+		item = mempool_take(mpctx);
+		UNLOCK(mpctx->lock);
+	} else {
+		tc = &mpctx->tcaches[idx];
+		if (ISC_UNLIKELY(tc->c.items == NULL)) {
+			LOCK(mpctx->lock);
+			for (i = 0; i < MPCACHE_COUNT / 2; i++) {
+				item = mempool_take(mpctx);
+				if (item == NULL)
+					break;
+				item->next = tc->c.items;
+				tc->c.items = item;
+				tc->c.count++;
+			}
+			UNLOCK(mpctx->lock);
+		}
+		item = tc->c.items;
+		if (ISC_LIKELY(item != NULL)) {
+			tc->c.items = item->next;
+			tc->c.count--;
+		}
+	}
+
+	if (ISC_UNLIKELY(item == NULL))
+		(void)atomic_fetch_sub_explicit(&mpctx->tcallocated, 1,
+						memory_order_relaxed);
+
+	return (item);
+}
+
+static void
+mempool_tcput(isc__mempool_t *mpctx, void *mem) {
+	mpcache_t *tc;
+	element *item = mem, *next, **itemp;
+	unsigned int idx, i;
+
+	INSIST(atomic_fetch_sub_explicit(&mpctx->tcallocated, 1,
+					 memory_order_relaxed) > 0);
+
+	idx = mempool_tcindex();
+	if (ISC_UNLIKELY(idx >= MAXTHREADCACHES)) {
+		LOCK(mpctx->lock);
+		mempool_release(mpctx, item);
+		UNLOCK(mpctx->lock);
+		return;
+	}
+
+	tc = &mpctx->tcaches[idx];
+	item->next = tc->c.items;
+	tc->c.items = item;
+	if (ISC_LIKELY(++tc->c.count <= MPCACHE_COUNT))
+		return;
+
+	/*
+	 * Keep the most recently used half of the cache and give the
+	 * rest back to the pool.
+	 */
+	itemp = &tc->c.items;
+	for (i = 0; i < MPCACHE_COUNT / 2; i++)
+		itemp = &(*itemp)->next;
+	item = *itemp;
+	*itemp = NULL;
+	tc->c.count = i;
+
+	LOCK(mpctx->lock);
+	while (item != NULL) {
+		next = item->next;
+		mempool_release(mpctx, item);
+		item = next;
+	}
+	UNLOCK(mpctx->lock);
+}
+#endif /* MEMPOOL_THREADCACHES */
+
+void *
+isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
+	isc__mempool_t *mpctx;
+	element *item;
+	isc__mem_t *mctx;
+
+	REQUIRE(VALID_MEMPOOL(mpctx0));
+
+	mpctx = (isc__mempool_t *)mpctx0;
+
+	mctx = mpctx->mctx;
+
+#ifdef MEMPOOL_THREADCACHES
+	if (mpctx->tcaches != NULL) {
+		item = mempool_tcget(mpctx);
+		goto trace;
+	}
+#endif
+
+	if (mpctx->lock != NULL)
+		LOCK(mpctx->lock);
+
+	/*
+	 * Don't let the caller go over quota
+	 */
+	if (ISC_UNLIKELY(mpctx->allocated >= mpctx->maxalloc)) {
+		item = NULL;
+		goto out;
+	}
+
+	item = mempool_take(mpctx);
+	if (ISC_LIKELY(item != NULL))
+		mpctx->allocated++;
 
  out:
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
 
+#ifdef MEMPOOL_THREADCACHES
+ trace:
+#endif
 #if ISC_MEM_TRACKLINES
 	if (((isc_mem_debugging & TRACE_OR_RECORD) != 0) && item != NULL) {
 		MCTXLOCK(mctx, &mctx->lock);
 		ADD_TRACE(mctx, item, mpctx->size, file, line);
 		MCTXUNLOCK(mctx, &mctx->lock);
 	}
+#else
+	UNUSED(mctx);
 #endif /* ISC_MEM_TRACKLINES */
 
 	return (item);
@@ -2126,7 +2791,6 @@ void
 isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 	isc__mempool_t *mpctx;
 	isc__mem_t *mctx;
-	element *item;
 
 	REQUIRE(VALID_MEMPOOL(mpctx0));
 	REQUIRE(mem != NULL);
@@ -2135,44 +2799,30 @@ isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 
 	mctx = mpctx->mctx;
 
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
-
-	INSIST(mpctx->allocated > 0);
-	mpctx->allocated--;
-
 #if ISC_MEM_TRACKLINES
 	if ((isc_mem_debugging & TRACE_OR_RECORD) != 0) {
 		MCTXLOCK(mctx, &mctx->lock);
 		DELETE_TRACE(mctx, mem, mpctx->size, file, line);
 		MCTXUNLOCK(mctx, &mctx->lock);
 	}
+#else
+	UNUSED(mctx);
 #endif /* ISC_MEM_TRACKLINES */
 
-	/*
-	 * If our free list is full, return this to the mctx directly.
-	 */
-	if (mpctx->freecount >= mpctx->freemax) {
-		MCTXLOCK(mctx, &mctx->lock);
-		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-			mem_putunlocked(mctx, mem, mpctx->size);
-		} else {
-			mem_putstats(mctx, mem, mpctx->size);
-			mem_put(mctx, mem, mpctx->size);
-		}
-		MCTXUNLOCK(mctx, &mctx->lock);
-		if (mpctx->lock != NULL)
-			UNLOCK(mpctx->lock);
+#ifdef MEMPOOL_THREADCACHES
+	if (mpctx->tcaches != NULL) {
+		mempool_tcput(mpctx, mem);
 		return;
 	}
+#endif
 
-	/*
-	 * Otherwise, attach it to our free list and bump the counter.
-	 */
-	mpctx->freecount++;
-	item = (element *)mem;
-	item->next = mpctx->items;
-	mpctx->items = item;
+	if (mpctx->lock != NULL)
+		LOCK(mpctx->lock);
+
+	INSIST(mpctx->allocated > 0);
+	mpctx->allocated--;
+
+	mempool_release(mpctx, mem);
 
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
@@ -2290,6 +2940,12 @@ isc__mempool_getallocated(isc_mempool_t *mpctx0) {
 		LOCK(mpctx->lock);
 
 	allocated = mpctx->allocated;
+#ifdef MEMPOOL_THREADCACHES
+	if (mpctx->tcaches != NULL)
+		allocated += (unsigned int)
+			atomic_load_explicit(&mpctx->tcallocated,
+					     memory_order_relaxed);
+#endif
 
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
@@ -2517,6 +3173,36 @@ xml_renderctx(isc__mem_t *ctx, summarystat_t *summary,
 					    (uint64_t)ctx->lo_water));
 	TRY0(xmlTextWriterEndElement(writer)); /* lowater */
 
+#ifdef MEM_THREADCACHES
+	if (ctx->tcaching) {
+		summary->contextsize += ctx->tccount * tcache_size(ctx);
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "threadcaches"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+						    ctx->tccount));
+		TRY0(xmlTextWriterEndElement(writer)); /* threadcaches */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "cachedgets"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%lu",
+						    ctx->tcgets));
+		TRY0(xmlTextWriterEndElement(writer)); /* cachedgets */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "cachefills"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%lu",
+						    ctx->tcfills));
+		TRY0(xmlTextWriterEndElement(writer)); /* cachefills */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "cacheflushes"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%lu",
+						    ctx->tcflushes));
+		TRY0(xmlTextWriterEndElement(writer)); /* cacheflushes */
+	}
+#endif
+
 	TRY0(xmlTextWriterEndElement(writer)); /* context */
 
  error:
@@ -2682,6 +3368,28 @@ json_renderctx(isc__mem_t *ctx, summarystat_t *summary, json_object *array) {
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "lowater", obj);
 
+#ifdef MEM_THREADCACHES
+	if (ctx->tcaching) {
+		summary->contextsize += ctx->tccount * tcache_size(ctx);
+
+		obj = json_object_new_int64(ctx->tccount);
+		CHECKMEM(obj);
+		json_object_object_add(ctxobj, "threadcaches", obj);
+
+		obj = json_object_new_int64(ctx->tcgets);
+		CHECKMEM(obj);
+		json_object_object_add(ctxobj, "cachedgets", obj);
+
+		obj = json_object_new_int64(ctx->tcfills);
+		CHECKMEM(obj);
+		json_object_object_add(ctxobj, "cachefills", obj);
+
+		obj = json_object_new_int64(ctx->tcflushes);
+		CHECKMEM(obj);
+		json_object_object_add(ctxobj, "cacheflushes", obj);
+	}
+#endif
+
 	MCTXUNLOCK(ctx, &ctx->lock);
 	json_object_array_add(array, ctxobj);
 	return (result);
@@ -21,10 +21,13 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
 #include <isc/stats.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #if defined(ISC_PLATFORM_HAVESTDATOMIC)
@@ -85,6 +88,19 @@
 # define MAYBE_RWUNLOCK(a, b)
 #endif
 
+#if defined(ISC_PLATFORM_HAVESTDATOMIC) && defined(ISC_PLATFORM_USETHREADS)
+/*%
+ * Counter sets created with ISC_STATSCREATE_PERTHREAD keep one copy of
+ * every counter per shard, each shard starting on its own cache line.
+ * Threads are spread over the shards and only update their own, and the
+ * shards are summed when the counters are read.
+ */
+# define ISC_STATS_SHARDED 1
+# define MAXSHARDS	64
+# define SHARDALIGN	64
+# define SHARDCOUNTERS	(SHARDALIGN / (int)sizeof(isc_stat_t))
+#endif
+
 #if ISC_PLATFORM_HAVESTDATOMIC
 typedef atomic_uint_fast64_t isc_stat_t;
 #elif ISC_STATS_HAVEATOMICQ
@@ -115,10 +131,48 @@ struct isc_stats {
 	isc_rwlock_t	counterlock;
 #endif
 	isc_stat_t	*counters;
+	int		nshards;	/*%< a power of 2 */
+	int		stride;		/*%< counters per shard */
+	void		*countersmem;	/*%< memory holding 'counters' */
+	size_t		countersmemsize;
 };
 
+#if ISC_STATS_SHARDED
+static isc_once_t	shard_once = ISC_ONCE_INIT;
+static isc_thread_key_t	shard_key;
+static bool		shard_keyok = false;
+static atomic_uint_fast32_t shard_next;
+
+static void
+shard_initialize(void) {
+	shard_keyok = (isc_thread_key_create(&shard_key, NULL) == 0);
+}
+
+/*%
+ * Return the calling thread's shard, assigning threads to shards in turn.
+ */
+static inline int
+shard_offset(isc_stats_t *stats) {
+	uintptr_t value;
+
+	if (stats->nshards == 1 || !shard_keyok)
+		return (0);
+
+	value = (uintptr_t)isc_thread_key_getspecific(shard_key);
+	if (ISC_UNLIKELY(value == 0)) {
+		value = atomic_fetch_add_explicit(&shard_next, 1,
+						  memory_order_relaxed) + 1;
+		(void)isc_thread_key_setspecific(shard_key, (void *)value);
+	}
+
+	return ((int)((value - 1) & (stats->nshards - 1)) * stats->stride);
+}
+#endif /* ISC_STATS_SHARDED */
+
 static isc_result_t
-create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
+create_stats(isc_mem_t *mctx, int ncounters, unsigned int options,
+	     isc_stats_t **statsp)
+{
 	isc_stats_t *stats;
 	isc_result_t result = ISC_R_SUCCESS;
 
@@ -132,11 +186,46 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	stats->counters = isc_mem_get(mctx, sizeof(isc_stat_t) * ncounters);
-	if (stats->counters == NULL) {
+	stats->nshards = 1;
+	stats->stride = ncounters;
+	stats->countersmemsize = sizeof(isc_stat_t) * ncounters;
+#if ISC_STATS_SHARDED
+	if ((options & ISC_STATSCREATE_PERTHREAD) != 0) {
+		unsigned int ncpus = isc_os_ncpus();
+
+		RUNTIME_CHECK(isc_once_do(&shard_once, shard_initialize) ==
+			      ISC_R_SUCCESS);
+
+		/*
+		 * Use at least two shards, as the CPU count may not
+		 * reflect the number of threads updating the counters.
+		 */
+		stats->nshards = 2;
+		while ((unsigned int)stats->nshards < ncpus &&
+		       stats->nshards < MAXSHARDS)
+			stats->nshards *= 2;
+		stats->stride = (ncounters + SHARDCOUNTERS - 1) /
+			SHARDCOUNTERS * SHARDCOUNTERS;
+		stats->countersmemsize = sizeof(isc_stat_t) * stats->stride *
+			stats->nshards + SHARDALIGN;
+	}
+#else
+	UNUSED(options);
+#endif
+
+	stats->countersmem = isc_mem_get(mctx, stats->countersmemsize);
+	if (stats->countersmem == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto clean_mutex;
 	}
+	memset(stats->countersmem, 0, stats->countersmemsize);
+	stats->counters = stats->countersmem;
+#if ISC_STATS_SHARDED
+	if (stats->nshards > 1)
+		stats->counters = (isc_stat_t *)
+			(((uintptr_t)stats->countersmem + SHARDALIGN - 1) &
+			 ~(uintptr_t)(SHARDALIGN - 1));
+#endif
 
 #if ISC_STATS_LOCKCOUNTERS
 	result = isc_rwlock_init(&stats->counterlock, 0, 0);
@@ -145,7 +234,6 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 #endif
 
 	stats->references = 1;
-	memset(stats->counters, 0, sizeof(isc_stat_t) * ncounters);
 	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
 	stats->ncounters = ncounters;
@@ -157,7 +245,7 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 
 #if ISC_STATS_LOCKCOUNTERS
 clean_counters:
-	isc_mem_put(mctx, stats->counters, sizeof(isc_stat_t) * ncounters);
+	isc_mem_put(mctx, stats->countersmem, stats->countersmemsize);
 #endif
 
 clean_mutex:
@@ -194,8 +282,8 @@ isc_stats_detach(isc_stats_t **statsp) {
 	stats->references--;
 
 	if (stats->references == 0) {
-		isc_mem_put(stats->mctx, stats->counters,
-			    sizeof(isc_stat_t) * stats->ncounters);
+		isc_mem_put(stats->mctx, stats->countersmem,
+			    stats->countersmemsize);
 		UNLOCK(&stats->lock);
 		DESTROYLOCK(&stats->lock);
 #if ISC_STATS_LOCKCOUNTERS
@@ -217,7 +305,11 @@ isc_stats_ncounters(isc_stats_t *stats) {
 
 static inline void
 incrementcounter(isc_stats_t *stats, int counter) {
-#if ISC_PLATFORM_HAVESTDATOMIC
+#if ISC_STATS_SHARDED
+	(void)atomic_fetch_add_explicit(&stats->counters[shard_offset(stats) +
+							 counter],
+					1, memory_order_relaxed);
+#elif ISC_PLATFORM_HAVESTDATOMIC
 	(void)atomic_fetch_add_explicit(&stats->counters[counter], 1,
 					memory_order_relaxed);
 #elif ISC_STATS_HAVEATOMICQ
@@ -242,7 +334,11 @@ incrementcounter(isc_stats_t *stats, int counter) {
 
 static inline void
 decrementcounter(isc_stats_t *stats, int counter) {
-#if ISC_PLATFORM_HAVESTDATOMIC
+#if ISC_STATS_SHARDED
+	(void)atomic_fetch_sub_explicit(&stats->counters[shard_offset(stats) +
+							 counter],
+					1, memory_order_relaxed);
+#elif ISC_PLATFORM_HAVESTDATOMIC
 	(void)atomic_fetch_sub_explicit(&stats->counters[counter], 1,
 					memory_order_relaxed);
 #elif ISC_STATS_HAVEATOMICQ
@@ -261,7 +357,22 @@ decrementcounter(isc_stats_t *stats, int counter) {
 
 static inline uint64_t
 getcounter(isc_stats_t *stats, const int counter) {
-#if ISC_PLATFORM_HAVESTDATOMIC
+#if ISC_STATS_SHARDED
+	uint64_t curr_value = 0;
+	int i;
+
+	/*
+	 * A decrement may land in a different shard than the increment
+	 * it undoes, so only the sum is meaningful.
+	 */
+	for (i = 0; i < stats->nshards; i++) {
+		curr_value += atomic_load_explicit(&stats->counters[i *
+						   stats->stride + counter],
+						   memory_order_relaxed);
+	}
+
+	return (curr_value);
+#elif ISC_PLATFORM_HAVESTDATOMIC
 	return(atomic_load_explicit(&stats->counters[counter],
 				    memory_order_relaxed));
 #elif ISC_STATS_HAVEATOMICQ
@@ -286,7 +397,17 @@ setcounter(isc_stats_t *stats,
 	   const isc_statscounter_t counter,
 	   const uint64_t value)
 {
-#if ISC_PLATFORM_HAVESTDATOMIC
+#if ISC_STATS_SHARDED
+	int i;
+
+	atomic_store_explicit(&stats->counters[counter], value,
+			      memory_order_relaxed);
+	for (i = 1; i < stats->nshards; i++) {
+		atomic_store_explicit(&stats->counters[i * stats->stride +
+						       counter],
+				      0, memory_order_relaxed);
+	}
+#elif ISC_PLATFORM_HAVESTDATOMIC
 	atomic_store_explicit(&stats->counters[counter], value,
 			      memory_order_relaxed);
 #elif ISC_STATS_HAVEATOMICQ
@@ -323,7 +444,16 @@ isc_result_t
 isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, ncounters, statsp));
+	return (create_stats(mctx, ncounters, 0, statsp));
+}
+
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int options)
+{
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, ncounters, options, statsp));
 }
 
 void
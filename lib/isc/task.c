@@ -30,6 +30,7 @@
 #include <isc/once.h>
 #include <isc/platform.h>
 #include <isc/print.h>
+#include <isc/refcount.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/thread.h>
@@ -100,6 +101,8 @@ struct isc__task {
 	isc_task_t			common;
 	isc__taskmgr_t *		manager;
 	isc_mutex_t			lock;
+	unsigned int			threadid;
+	bool				bound;
 	/* Locked by task lock. */
 	task_state_t			state;
 	unsigned int			references;
@@ -114,6 +117,7 @@ struct isc__task {
 	void *				tag;
 	/* Locked by task manager lock. */
 	LINK(isc__task_t)		link;
+	/* Locked by the lock of run queue 'threadid'. */
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
 };
@@ -129,6 +133,28 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+/*%
+ * Each worker thread has its own run queue.  A task is always queued
+ * on the run queue of its home worker ('task->threadid'); a worker
+ * which runs out of work steals unbound tasks from the other queues
+ * before going to sleep.
+ */
+typedef struct isc__taskqueue {
+	/* Not locked. */
+	isc__taskmgr_t *		manager;
+	unsigned int			threadid;
+	isc_mutex_t			lock;
+	/* Locked by queue lock. */
+	isc__tasklist_t			ready_tasks;
+	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			tasks_ready;
+	bool				running;
+#ifdef USE_WORKER_THREADS
+	bool				idle;
+	isc_condition_t			work_available;
+#endif /* USE_WORKER_THREADS */
+} isc__taskqueue_t;
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
@@ -138,22 +164,33 @@ struct isc__taskmgr {
 	unsigned int			workers;
 	isc_thread_t *			threads;
 #endif /* ISC_PLATFORM_USETHREADS */
+	unsigned int			nqueues;
+	isc__taskqueue_t *		queues;
+#ifdef USE_WORKER_THREADS
+	/*
+	 * Number of workers with 'idle' set.  Only used as a hint, to
+	 * avoid looking for an idle worker when there is none.
+	 */
+	isc_refcount_t			idle_workers;
+#endif /* USE_WORKER_THREADS */
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
 	LIST(isc__task_t)		tasks;
-	isc__tasklist_t			ready_tasks;
-	isc__tasklist_t			ready_priority_tasks;
-	isc_taskmgrmode_t		mode;
+	unsigned int			next_queue;
 #ifdef ISC_PLATFORM_USETHREADS
-	isc_condition_t			work_available;
 	isc_condition_t			exclusive_granted;
 	isc_condition_t			paused;
 #endif /* ISC_PLATFORM_USETHREADS */
-	unsigned int			tasks_running;
-	unsigned int			tasks_ready;
-	bool			pause_requested;
-	bool			exclusive_requested;
-	bool			exiting;
+	bool				exiting;
+	/*
+	 * Locked by task manager lock, and only changed while every
+	 * queue lock is held as well (see lock_queues()), so that a
+	 * worker holding its own queue lock can safely read them.
+	 */
+	isc_taskmgrmode_t		mode;
+	bool				pause_requested;
+	bool				exclusive_requested;
+	bool				finished;
 
 	/*
 	 * Multiple threads can read/write 'excl' at the same time, so we need
@@ -184,6 +221,9 @@ static isc__taskmgr_t *taskmgr = NULL;
 isc_result_t
 isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 		 isc_task_t **taskp);
+isc_result_t
+isc__task_create_bound(isc_taskmgr_t *manager0, unsigned int quantum,
+		       isc_task_t **taskp, int threadid);
 void
 isc__task_attach(isc_task_t *source0, isc_task_t **targetp);
 void
@@ -247,13 +287,24 @@ isc_taskmgrmode_t
 isc__taskmgr_mode(isc_taskmgr_t *manager0);
 
 static inline bool
-empty_readyq(isc__taskmgr_t *manager);
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager);
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task);
+
+static void
+lock_queues(isc__taskmgr_t *manager);
+
+static void
+unlock_queues(isc__taskmgr_t *manager, bool wakeup);
+
+#ifdef USE_WORKER_THREADS
+static void
+wake_idle(isc__taskmgr_t *manager, unsigned int threadid);
+#endif /* USE_WORKER_THREADS */
 
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
@@ -316,7 +367,6 @@ task_finished(isc__task_t *task) {
 
 	LOCK(&manager->lock);
 	UNLINK(manager->tasks, task, link);
-#ifdef USE_WORKER_THREADS
 	if (FINISHED(manager)) {
 		/*
 		 * All tasks have completed and the
@@ -324,9 +374,10 @@ task_finished(isc__task_t *task) {
 		 * any idle worker threads so they
 		 * can exit.
 		 */
-		BROADCAST(&manager->work_available);
+		lock_queues(manager);
+		manager->finished = true;
+		unlock_queues(manager, true);
 	}
-#endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
 
 	DESTROYLOCK(&task->lock);
@@ -338,6 +389,13 @@ task_finished(isc__task_t *task) {
 isc_result_t
 isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 		 isc_task_t **taskp)
+{
+	return (isc__task_create_bound(manager0, quantum, taskp, -1));
+}
+
+isc_result_t
+isc__task_create_bound(isc_taskmgr_t *manager0, unsigned int quantum,
+		       isc_task_t **taskp, int threadid)
 {
 	isc__taskmgr_t *manager;
 	isc__task_t *task;
@@ -379,6 +437,19 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+		/*
+		 * Unbound tasks are spread over the run queues round
+		 * robin; they may still be stolen by an idle worker.
+		 */
+		if (threadid >= 0) {
+			task->threadid = (unsigned int)threadid %
+					 manager->nqueues;
+			task->bound = true;
+		} else {
+			task->threadid = manager->next_queue++ %
+					 manager->nqueues;
+			task->bound = false;
+		}
 		APPEND(manager->tasks, task, link);
 	} else
 		exiting = true;
@@ -465,8 +536,10 @@ task_shutdown(isc__task_t *task) {
 static inline void
 task_ready(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 #ifdef USE_WORKER_THREADS
 	bool has_privilege = isc__task_privilege((isc_task_t *) task);
+	bool steal = false;
 #endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
@@ -474,15 +547,32 @@ task_ready(isc__task_t *task) {
 
 	XTRACE("task_ready");
 
-	LOCK(&manager->lock);
+	queue = &manager->queues[task->threadid];
+	LOCK(&queue->lock);
 	LOCK(&task->lock);
-	push_readyq(manager, task);
+	push_readyq(queue, task);
 	UNLOCK(&task->lock);
 #ifdef USE_WORKER_THREADS
-	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
+	if (manager->mode == isc_taskmgrmode_normal || has_privilege) {
+		/*
+		 * Wake the owner if it is idle.  If it is busy, wake an
+		 * idle worker instead so it can steal the task.
+		 */
+		if (queue->idle) {
+			queue->idle = false;
+			SIGNAL(&queue->work_available);
+		} else if (!task->bound &&
+			   isc_refcount_current(&manager->idle_workers) > 0)
+		{
+			steal = true;
+		}
+	}
+#endif /* USE_WORKER_THREADS */
+	UNLOCK(&queue->lock);
+#ifdef USE_WORKER_THREADS
+	if (steal)
+		wake_idle(manager, queue->threadid);
 #endif /* USE_WORKER_THREADS */
-	UNLOCK(&manager->lock);
 }
 
 static inline bool
@@ -954,47 +1044,124 @@ isc__task_getcurrenttimex(isc_task_t *task0, isc_time_t *t) {
  ***/
 
 /*
- * Return true if the current ready list for the manager, which is
+ * Lock every run queue, in order.  The manager-wide scheduling state
+ * ('mode', 'pause_requested', 'exclusive_requested' and 'finished') is
+ * only changed while all of the queue locks are held, so a worker
+ * holding just its own queue lock always sees a consistent value.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+lock_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++)
+		LOCK(&manager->queues[i].lock);
+}
+
+/*
+ * Undo lock_queues().  If 'wakeup' is true, wake up every worker so
+ * it re-evaluates the scheduling state.
+ */
+static void
+unlock_queues(isc__taskmgr_t *manager, bool wakeup) {
+	unsigned int i;
+
+	for (i = manager->nqueues; i-- > 0; ) {
+		isc__taskqueue_t *queue = &manager->queues[i];
+
+#ifdef USE_WORKER_THREADS
+		if (wakeup) {
+			queue->idle = false;
+			BROADCAST(&queue->work_available);
+		}
+#else
+		UNUSED(wakeup);
+#endif /* USE_WORKER_THREADS */
+		UNLOCK(&queue->lock);
+	}
+}
+
+/*
+ * Count the workers which are running a task, and the tasks waiting
+ * on the run queues.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+count_tasks(isc__taskmgr_t *manager, unsigned int *runningp,
+	    unsigned int *readyp)
+{
+	unsigned int i, running = 0, ready = 0;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		isc__taskqueue_t *queue = &manager->queues[i];
+
+		LOCK(&queue->lock);
+		if (queue->running)
+			running++;
+		ready += queue->tasks_ready;
+		UNLOCK(&queue->lock);
+	}
+
+	if (runningp != NULL)
+		*runningp = running;
+	if (readyp != NULL)
+		*readyp = ready;
+}
+
+/*
+ * Return true if the current ready list for 'queue', which is
  * either ready_tasks or the ready_priority_tasks, depending on whether
  * the manager is currently in normal or privileged execution mode.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline bool
-empty_readyq(isc__taskmgr_t *manager) {
-	isc__tasklist_t queue;
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__tasklist_t list;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		queue = manager->ready_tasks;
+		list = queue->ready_tasks;
 	else
-		queue = manager->ready_priority_tasks;
+		list = queue->ready_priority_tasks;
 
-	return (EMPTY(queue));
+	return (EMPTY(list));
+}
+
+/*
+ * Remove 'task' from the ready lists of 'queue'.
+ *
+ * Caller must hold the queue lock.
+ */
+static inline void
+dequeue_readyq(isc__taskqueue_t *queue, isc__task_t *task) {
+	DEQUEUE(queue->ready_tasks, task, ready_link);
+	if (ISC_LINK_LINKED(task, ready_priority_link))
+		DEQUEUE(queue->ready_priority_tasks, task,
+			ready_priority_link);
+	queue->tasks_ready--;
 }
 
 /*
  * Dequeue and return a pointer to the first task on the current ready
- * list for the manager.
+ * list for 'queue'.
  * If the task is privileged, dequeue it from the other ready list
  * as well.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager) {
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
 	isc__task_t *task;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		task = HEAD(manager->ready_tasks);
+		task = HEAD(queue->ready_tasks);
 	else
-		task = HEAD(manager->ready_priority_tasks);
+		task = HEAD(queue->ready_priority_tasks);
 
-	if (task != NULL) {
-		DEQUEUE(manager->ready_tasks, task, ready_link);
-		if (ISC_LINK_LINKED(task, ready_priority_link))
-			DEQUEUE(manager->ready_priority_tasks, task,
-				ready_priority_link);
-	}
+	if (task != NULL)
+		dequeue_readyq(queue, task);
 
 	return (task);
 }
@@ -1003,332 +1170,403 @@ pop_readyq(isc__taskmgr_t *manager) {
  * Push 'task' onto the ready_tasks queue.  If 'task' has the privilege
  * flag set, then also push it onto the ready_priority_tasks queue.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock and the task lock.
  */
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
-	ENQUEUE(manager->ready_tasks, task, ready_link);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task) {
+	ENQUEUE(queue->ready_tasks, task, ready_link);
 	if ((task->flags & TASK_F_PRIVILEGED) != 0)
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	manager->tasks_ready++;
+	queue->tasks_ready++;
+}
+
+/*
+ * Run the events of 'task', which has just been taken off a run queue,
+ * until it has none left or its quantum expires.  The number of events
+ * dispatched is stored in '*dispatch_countp'.
+ *
+ * Returns true if the task still has events and must be requeued.
+ *
+ * Caller must not hold any locks.
+ */
+static bool
+dispatch_task(isc__task_t *task, unsigned int *dispatch_countp) {
+	unsigned int dispatch_count = 0;
+	bool done = false;
+	bool requeue = false;
+	bool finished = false;
+	isc_event_t *event;
+
+	INSIST(VALID_TASK(task));
+
+	LOCK(&task->lock);
+	INSIST(task->state == task_state_ready);
+	task->state = task_state_running;
+	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+			      ISC_MSG_RUNNING, "running"));
+	TIME_NOW(&task->tnow);
+	task->now = isc_time_seconds(&task->tnow);
+	do {
+		if (!EMPTY(task->events)) {
+			event = HEAD(task->events);
+			DEQUEUE(task->events, event, ev_link);
+			task->nevents--;
+
+			/*
+			 * Execute the event action.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_EXECUTE,
+					      "execute action"));
+			if (event->ev_action != NULL) {
+				UNLOCK(&task->lock);
+				(event->ev_action)((isc_task_t *)task, event);
+				LOCK(&task->lock);
+			}
+			dispatch_count++;
+		}
+
+		if (task->references == 0 &&
+		    EMPTY(task->events) &&
+		    !TASK_SHUTTINGDOWN(task)) {
+			bool was_idle;
+
+			/*
+			 * There are no references and no
+			 * pending events for this task,
+			 * which means it will not become
+			 * runnable again via an external
+			 * action (such as sending an event
+			 * or detaching).
+			 *
+			 * We initiate shutdown to prevent
+			 * it from becoming a zombie.
+			 *
+			 * We do this here instead of in
+			 * the "if EMPTY(task->events)" block
+			 * below because:
+			 *
+			 *	If we post no shutdown events,
+			 *	we want the task to finish.
+			 *
+			 *	If we did post shutdown events,
+			 *	will still want the task's
+			 *	quantum to be applied.
+			 */
+			was_idle = task_shutdown(task);
+			INSIST(!was_idle);
+		}
+
+		if (EMPTY(task->events)) {
+			/*
+			 * Nothing else to do for this task
+			 * right now.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_EMPTY,
+					      "empty"));
+			if (task->references == 0 &&
+			    TASK_SHUTTINGDOWN(task)) {
+				/*
+				 * The task is done.
+				 */
+				XTRACE(isc_msgcat_get(isc_msgcat,
+						      ISC_MSGSET_TASK,
+						      ISC_MSG_DONE,
+						      "done"));
+				finished = true;
+				task->state = task_state_done;
+			} else
+				task->state = task_state_idle;
+			done = true;
+		} else if (dispatch_count >= task->quantum) {
+			/*
+			 * Our quantum has expired, but
+			 * there is more work to be done.
+			 * We'll requeue it to the ready
+			 * queue later.
+			 *
+			 * We don't check quantum until
+			 * dispatching at least one event,
+			 * so the minimum quantum is one.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_QUANTUM,
+					      "quantum"));
+			task->state = task_state_ready;
+			requeue = true;
+			done = true;
+		}
+	} while (!done);
+	UNLOCK(&task->lock);
+
+	if (finished)
+		task_finished(task);
+
+	*dispatch_countp = dispatch_count;
+	return (requeue);
+}
+
+#ifdef USE_WORKER_THREADS
+/*
+ * Wake up one idle worker other than 'threadid', if there is one, so
+ * that it can steal some work.  This is only a hint, so queues whose
+ * lock is busy are skipped rather than waited for.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+wake_idle(isc__taskmgr_t *manager, unsigned int threadid) {
+	unsigned int i;
+
+	for (i = 1; i < manager->nqueues; i++) {
+		isc__taskqueue_t *queue;
+		bool found;
+
+		queue = &manager->queues[(threadid + i) % manager->nqueues];
+		if (isc_mutex_trylock(&queue->lock) != ISC_R_SUCCESS)
+			continue;
+		found = queue->idle;
+		if (found) {
+			queue->idle = false;
+			SIGNAL(&queue->work_available);
+		}
+		UNLOCK(&queue->lock);
+		if (found)
+			break;
+	}
+}
+
+/*
+ * Take an unbound task from the run queue of some other, busy worker,
+ * starting with the next one along.  Bound tasks are never stolen.
+ *
+ * Caller must not hold any queue lock.
+ */
+static isc__task_t *
+steal_readyq(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__task_t *task = NULL;
+	unsigned int i;
+
+	for (i = 1; i < manager->nqueues && task == NULL; i++) {
+		isc__taskqueue_t *queue;
+
+		queue = &manager->queues[(threadid + i) % manager->nqueues];
+		LOCK(&queue->lock);
+		if (queue->running && !manager->pause_requested &&
+		    !manager->exclusive_requested)
+		{
+			if (manager->mode == isc_taskmgrmode_normal) {
+				task = HEAD(queue->ready_tasks);
+				while (task != NULL && task->bound)
+					task = NEXT(task, ready_link);
+			} else {
+				task = HEAD(queue->ready_priority_tasks);
+				while (task != NULL && task->bound)
+					task = NEXT(task, ready_priority_link);
+			}
+			if (task != NULL)
+				dequeue_readyq(queue, task);
+		}
+		UNLOCK(&queue->lock);
+	}
+
+	return (task);
+}
+
+/*
+ * If we are in privileged execution mode and there are no privileged
+ * tasks left on any run queue and nothing is running, then we're
+ * stuck.  Automatically drop privileges at that point and continue
+ * with the regular ready queues.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+drop_privilege(isc__taskmgr_t *manager) {
+	bool stuck;
+	unsigned int i;
+
+	LOCK(&manager->lock);
+	lock_queues(manager);
+	stuck = (manager->mode != isc_taskmgrmode_normal);
+	for (i = 0; stuck && i < manager->nqueues; i++) {
+		isc__taskqueue_t *queue = &manager->queues[i];
+
+		if (queue->running || !EMPTY(queue->ready_priority_tasks))
+			stuck = false;
+	}
+	if (stuck)
+		manager->mode = isc_taskmgrmode_normal;
+	unlock_queues(manager, stuck);
+	UNLOCK(&manager->lock);
 }
 
 static void
-dispatch(isc__taskmgr_t *manager) {
+dispatch(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue;
 	isc__task_t *task;
-#ifndef USE_WORKER_THREADS
-	unsigned int total_dispatch_count = 0;
-	isc__tasklist_t new_ready_tasks;
-	isc__tasklist_t new_priority_tasks;
-	unsigned int tasks_ready = 0;
-#endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(threadid < manager->nqueues);
+
+	queue = &manager->queues[threadid];
 
 	/*
 	 * Again we're trying to hold the lock for as short a time as possible
 	 * and to do as little locking and unlocking as possible.
 	 *
-	 * In both while loops, the appropriate lock must be held before the
-	 * while body starts.  Code which acquired the lock at the top of
-	 * the loop would be more readable, but would result in a lot of
-	 * extra locking.  Compare:
-	 *
-	 * Straightforward:
-	 *
-	 *	LOCK();
-	 *	...
-	 *	UNLOCK();
-	 *	while (expression) {
-	 *		LOCK();
-	 *		...
-	 *		UNLOCK();
-	 *
-	 *	       	Unlocked part here...
-	 *
-	 *		LOCK();
-	 *		...
-	 *		UNLOCK();
-	 *	}
+	 * The queue lock must be held before the while body starts and is
+	 * held whenever the while expression is evaluated.  For N tasks
+	 * taken from our own queue this does N+1 locks and N+1 unlocks.
 	 *
-	 * Note how if the loop continues we unlock and then immediately lock.
-	 * For N iterations of the loop, this code does 2N+1 locks and 2N+1
-	 * unlocks.  Also note that the lock is not held when the while
-	 * condition is tested, which may or may not be important, depending
-	 * on the expression.
-	 *
-	 * As written:
-	 *
-	 *	LOCK();
-	 *	while (expression) {
-	 *		...
-	 *		UNLOCK();
-	 *
-	 *	       	Unlocked part here...
-	 *
-	 *		LOCK();
-	 *		...
-	 *	}
-	 *	UNLOCK();
-	 *
-	 * For N iterations of the loop, this code does N+1 locks and N+1
-	 * unlocks.  The while expression is always protected by the lock.
+	 * Only this worker ever waits on 'queue->work_available', and it
+	 * re-checks its queue with the lock held before waiting, so a
+	 * task_ready() which finds the worker busy doesn't have to signal.
 	 */
+	LOCK(&queue->lock);
 
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_INIT(new_ready_tasks);
-	ISC_LIST_INIT(new_priority_tasks);
-#endif
-	LOCK(&manager->lock);
+	while (!manager->finished) {
+		unsigned int dispatch_count;
+		bool requeue;
 
-	while (!FINISHED(manager)) {
-#ifdef USE_WORKER_THREADS
 		/*
-		 * For reasons similar to those given in the comment in
-		 * isc_task_send() above, it is safe for us to dequeue
-		 * the task while only holding the manager lock, and then
-		 * change the task to running state while only holding the
-		 * task lock.
-		 *
-		 * If a pause has been requested, don't do any work
-		 * until it's been released.
+		 * If a pause or exclusive access has been requested,
+		 * don't do any work until it's been released.
 		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
-			manager->exclusive_requested) && !FINISHED(manager))
-		{
+		if (manager->pause_requested || manager->exclusive_requested) {
 			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
 						    ISC_MSGSET_GENERAL,
 						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
+			WAIT(&queue->work_available, &queue->lock);
 			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
 						    ISC_MSGSET_TASK,
 						    ISC_MSG_AWAKE, "awake"));
+			continue;
 		}
-#else /* USE_WORKER_THREADS */
-		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
-		    empty_readyq(manager))
-			break;
-#endif /* USE_WORKER_THREADS */
+
 		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
 					    ISC_MSG_WORKING, "working"));
 
-		task = pop_readyq(manager);
-		if (task != NULL) {
-			unsigned int dispatch_count = 0;
-			bool done = false;
-			bool requeue = false;
-			bool finished = false;
-			isc_event_t *event;
-
-			INSIST(VALID_TASK(task));
+		task = pop_readyq(manager, queue);
+		if (task == NULL) {
+			bool privileged;
 
 			/*
-			 * Note we only unlock the manager lock if we actually
-			 * have a task to do.  We must reacquire the manager
-			 * lock before exiting the 'if (task != NULL)' block.
+			 * Our own queue is empty.  Advertise that we are
+			 * idle, then try to steal some work before going to
+			 * sleep.  Anyone who wants us awake clears 'idle',
+			 * so work which turns up while we're looking at the
+			 * other queues is not slept through.
 			 */
-			manager->tasks_ready--;
-			manager->tasks_running++;
-			UNLOCK(&manager->lock);
-
-			LOCK(&task->lock);
-			INSIST(task->state == task_state_ready);
-			task->state = task_state_running;
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-					      ISC_MSG_RUNNING, "running"));
-			TIME_NOW(&task->tnow);
-			task->now = isc_time_seconds(&task->tnow);
-			do {
-				if (!EMPTY(task->events)) {
-					event = HEAD(task->events);
-					DEQUEUE(task->events, event, ev_link);
-					task->nevents--;
-
-					/*
-					 * Execute the event action.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
+			privileged = (manager->mode != isc_taskmgrmode_normal);
+			queue->idle = true;
+			isc_refcount_increment0(&manager->idle_workers, NULL);
+			UNLOCK(&queue->lock);
+			task = steal_readyq(manager, threadid);
+			if (task == NULL && privileged)
+				drop_privilege(manager);
+			LOCK(&queue->lock);
+
+			if (task == NULL && queue->idle &&
+			    !manager->finished &&
+			    !manager->pause_requested &&
+			    !manager->exclusive_requested &&
+			    empty_readyq(manager, queue))
+			{
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_GENERAL,
+							    ISC_MSG_WAIT,
+							    "wait"));
+				WAIT(&queue->work_available, &queue->lock);
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
 							    ISC_MSGSET_TASK,
-							    ISC_MSG_EXECUTE,
-							    "execute action"));
-					if (event->ev_action != NULL) {
-						UNLOCK(&task->lock);
-						(event->ev_action)(
-							(isc_task_t *)task,
-							event);
-						LOCK(&task->lock);
-					}
-					dispatch_count++;
-#ifndef USE_WORKER_THREADS
-					total_dispatch_count++;
-#endif /* USE_WORKER_THREADS */
-				}
-
-				if (task->references == 0 &&
-				    EMPTY(task->events) &&
-				    !TASK_SHUTTINGDOWN(task)) {
-					bool was_idle;
-
-					/*
-					 * There are no references and no
-					 * pending events for this task,
-					 * which means it will not become
-					 * runnable again via an external
-					 * action (such as sending an event
-					 * or detaching).
-					 *
-					 * We initiate shutdown to prevent
-					 * it from becoming a zombie.
-					 *
-					 * We do this here instead of in
-					 * the "if EMPTY(task->events)" block
-					 * below because:
-					 *
-					 *	If we post no shutdown events,
-					 *	we want the task to finish.
-					 *
-					 *	If we did post shutdown events,
-					 *	will still want the task's
-					 *	quantum to be applied.
-					 */
-					was_idle = task_shutdown(task);
-					INSIST(!was_idle);
-				}
-
-				if (EMPTY(task->events)) {
-					/*
-					 * Nothing else to do for this task
-					 * right now.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_EMPTY,
-							      "empty"));
-					if (task->references == 0 &&
-					    TASK_SHUTTINGDOWN(task)) {
-						/*
-						 * The task is done.
-						 */
-						XTRACE(isc_msgcat_get(
-							       isc_msgcat,
-							       ISC_MSGSET_TASK,
-							       ISC_MSG_DONE,
-							       "done"));
-						finished = true;
-						task->state = task_state_done;
-					} else
-						task->state = task_state_idle;
-					done = true;
-				} else if (dispatch_count >= task->quantum) {
-					/*
-					 * Our quantum has expired, but
-					 * there is more work to be done.
-					 * We'll requeue it to the ready
-					 * queue later.
-					 *
-					 * We don't check quantum until
-					 * dispatching at least one event,
-					 * so the minimum quantum is one.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_QUANTUM,
-							      "quantum"));
-					task->state = task_state_ready;
-					requeue = true;
-					done = true;
-				}
-			} while (!done);
-			UNLOCK(&task->lock);
-
-			if (finished)
-				task_finished(task);
-
-			LOCK(&manager->lock);
-			manager->tasks_running--;
-#ifdef USE_WORKER_THREADS
-			if (manager->exclusive_requested &&
-			    manager->tasks_running == 1) {
-				SIGNAL(&manager->exclusive_granted);
-			} else if (manager->pause_requested &&
-				   manager->tasks_running == 0) {
-				SIGNAL(&manager->paused);
+							    ISC_MSG_AWAKE,
+							    "awake"));
 			}
-#endif /* USE_WORKER_THREADS */
-			if (requeue) {
+			queue->idle = false;
+			isc_refcount_decrement(&manager->idle_workers, NULL);
+			if (task == NULL)
+				continue;
+
+			if (manager->pause_requested ||
+			    manager->exclusive_requested)
+			{
 				/*
-				 * We know we're awake, so we don't have
-				 * to wakeup any sleeping threads if the
-				 * ready queue is empty before we requeue.
-				 *
-				 * A possible optimization if the queue is
-				 * empty is to 'goto' the 'if (task != NULL)'
-				 * block, avoiding the ENQUEUE of the task
-				 * and the subsequent immediate DEQUEUE
-				 * (since it is the only executable task).
-				 * We don't do this because then we'd be
-				 * skipping the exit_requested check.  The
-				 * cost of ENQUEUE is low anyway, especially
-				 * when you consider that we'd have to do
-				 * an extra EMPTY check to see if we could
-				 * do the optimization.  If the ready queue
-				 * were usually nonempty, the 'optimization'
-				 * might even hurt rather than help.
+				 * Too late; send it back home.
 				 */
-#ifdef USE_WORKER_THREADS
-				LOCK(&task->lock);
-				push_readyq(manager, task);
-				UNLOCK(&task->lock);
-#else
-				ENQUEUE(new_ready_tasks, task, ready_link);
-				if ((task->flags & TASK_F_PRIVILEGED) != 0)
-					ENQUEUE(new_priority_tasks, task,
-						ready_priority_link);
-				tasks_ready++;
-#endif
+				UNLOCK(&queue->lock);
+				task_ready(task);
+				LOCK(&queue->lock);
+				continue;
 			}
 		}
 
-#ifdef USE_WORKER_THREADS
 		/*
-		 * If we are in privileged execution mode and there are no
-		 * tasks remaining on the current ready queue, then
-		 * we're stuck.  Automatically drop privileges at that
-		 * point and continue with the regular ready queue.
+		 * For reasons similar to those given in the comment in
+		 * isc_task_send() above, it is safe for us to dequeue
+		 * the task while only holding the queue lock, and then
+		 * change the task to running state while only holding the
+		 * task lock.
 		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
-			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
+		queue->running = true;
+		UNLOCK(&queue->lock);
+
+		requeue = dispatch_task(task, &dispatch_count);
+		if (requeue) {
+			/*
+			 * The task goes to the back of its home queue.  If
+			 * that is our queue we know we're awake, so no
+			 * wakeup is needed.
+			 */
+			task_ready(task);
 		}
-#endif
-	}
 
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_APPENDLIST(manager->ready_tasks, new_ready_tasks, ready_link);
-	ISC_LIST_APPENDLIST(manager->ready_priority_tasks, new_priority_tasks,
-			    ready_priority_link);
-	manager->tasks_ready += tasks_ready;
-	if (empty_readyq(manager))
-		manager->mode = isc_taskmgrmode_normal;
-#endif
+		LOCK(&queue->lock);
+		queue->running = false;
+		if (manager->pause_requested || manager->exclusive_requested) {
+			/*
+			 * Let isc__taskmgr_pause() or
+			 * isc__task_beginexclusive() recount the workers
+			 * which are still running.
+			 */
+			UNLOCK(&queue->lock);
+			LOCK(&manager->lock);
+			if (manager->exclusive_requested)
+				SIGNAL(&manager->exclusive_granted);
+			if (manager->pause_requested)
+				SIGNAL(&manager->paused);
+			UNLOCK(&manager->lock);
+			LOCK(&queue->lock);
+		}
+	}
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
-#ifdef USE_WORKER_THREADS
 static isc_threadresult_t
 #ifdef _WIN32
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskqueue_t *queue = uap;
+	isc__taskmgr_t *manager = queue->manager;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	/*
+	 * Wait for isc__taskmgr_create() to finish starting the workers,
+	 * so that 'manager->nqueues' is final.
+	 */
+	LOCK(&manager->lock);
+	UNLOCK(&manager->lock);
+
+	dispatch(manager, queue->threadid);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1339,18 +1577,145 @@ run(void *uap) {
 
 	return ((isc_threadresult_t)0);
 }
+#else /* USE_WORKER_THREADS */
+static void
+dispatch(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue;
+	isc__task_t *task;
+	unsigned int total_dispatch_count = 0;
+	isc__tasklist_t new_ready_tasks;
+	isc__tasklist_t new_priority_tasks;
+	unsigned int tasks_ready = 0;
+
+	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(threadid < manager->nqueues);
+
+	queue = &manager->queues[threadid];
+
+	ISC_LIST_INIT(new_ready_tasks);
+	ISC_LIST_INIT(new_priority_tasks);
+	LOCK(&queue->lock);
+
+	while (!manager->finished) {
+		unsigned int dispatch_count;
+		bool requeue;
+
+		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
+		    empty_readyq(manager, queue))
+			break;
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					    ISC_MSG_WORKING, "working"));
+
+		task = pop_readyq(manager, queue);
+		queue->running = true;
+		UNLOCK(&queue->lock);
+
+		requeue = dispatch_task(task, &dispatch_count);
+		total_dispatch_count += dispatch_count;
+
+		LOCK(&queue->lock);
+		queue->running = false;
+		if (requeue) {
+			ENQUEUE(new_ready_tasks, task, ready_link);
+			if ((task->flags & TASK_F_PRIVILEGED) != 0)
+				ENQUEUE(new_priority_tasks, task,
+					ready_priority_link);
+			tasks_ready++;
+		}
+	}
+
+	ISC_LIST_APPENDLIST(queue->ready_tasks, new_ready_tasks, ready_link);
+	ISC_LIST_APPENDLIST(queue->ready_priority_tasks, new_priority_tasks,
+			    ready_priority_link);
+	queue->tasks_ready += tasks_ready;
+	if (empty_readyq(manager, queue))
+		manager->mode = isc_taskmgrmode_normal;
+
+	UNLOCK(&queue->lock);
+}
 #endif /* USE_WORKER_THREADS */
 
+/*
+ * Destroy run queues 'first' .. 'last' - 1.
+ */
+static void
+destroy_queues(isc__taskqueue_t *queues, unsigned int first,
+	       unsigned int last)
+{
+	unsigned int i;
+
+	for (i = first; i < last; i++) {
+		INSIST(EMPTY(queues[i].ready_tasks));
+		INSIST(EMPTY(queues[i].ready_priority_tasks));
+#ifdef USE_WORKER_THREADS
+		(void)isc_condition_destroy(&queues[i].work_available);
+#endif /* USE_WORKER_THREADS */
+		DESTROYLOCK(&queues[i].lock);
+	}
+}
+
+static isc_result_t
+create_queues(isc__taskmgr_t *manager, isc_mem_t *mctx, unsigned int n) {
+	isc__taskqueue_t *queues;
+	isc_result_t result;
+	unsigned int i;
+
+	queues = isc_mem_allocate(mctx, n * sizeof(queues[0]));
+	if (queues == NULL)
+		return (ISC_R_NOMEMORY);
+
+	for (i = 0; i < n; i++) {
+		isc__taskqueue_t *queue = &queues[i];
+
+		queue->manager = manager;
+		queue->threadid = i;
+		INIT_LIST(queue->ready_tasks);
+		INIT_LIST(queue->ready_priority_tasks);
+		queue->tasks_ready = 0;
+		queue->running = false;
+		result = isc_mutex_init(&queue->lock);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+#ifdef USE_WORKER_THREADS
+		queue->idle = false;
+		if (isc_condition_init(&queue->work_available) !=
+		    ISC_R_SUCCESS)
+		{
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_condition_init() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			DESTROYLOCK(&queue->lock);
+			result = ISC_R_UNEXPECTED;
+			goto cleanup;
+		}
+#endif /* USE_WORKER_THREADS */
+	}
+
+	manager->queues = queues;
+	manager->nqueues = n;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	destroy_queues(queues, 0, i);
+	isc_mem_free(mctx, queues);
+	return (result);
+}
+
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
 
 #ifdef USE_WORKER_THREADS
 	(void)isc_condition_destroy(&manager->exclusive_granted);
-	(void)isc_condition_destroy(&manager->work_available);
 	(void)isc_condition_destroy(&manager->paused);
+	isc_refcount_destroy(&manager->idle_workers);
 	isc_mem_free(manager->mctx, manager->threads);
 #endif /* USE_WORKER_THREADS */
+	destroy_queues(manager->queues, 0, manager->nqueues);
+	isc_mem_free(manager->mctx, manager->queues);
 	DESTROYLOCK(&manager->lock);
 	DESTROYLOCK(&manager->excl_lock);
 	manager->common.impmagic = 0;
@@ -1419,21 +1784,13 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		result = ISC_R_NOMEMORY;
 		goto cleanup_lock;
 	}
-	if (isc_condition_init(&manager->work_available) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_threads;
-	}
 	if (isc_condition_init(&manager->exclusive_granted) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_condition_init() %s",
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"));
 		result = ISC_R_UNEXPECTED;
-		goto cleanup_workavailable;
+		goto cleanup_threads;
 	}
 	if (isc_condition_init(&manager->paused) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1443,18 +1800,29 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_exclusivegranted;
 	}
+	result = isc_refcount_init(&manager->idle_workers, 0);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_paused;
+	result = create_queues(manager, mctx, workers);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_idle;
+#else /* USE_WORKER_THREADS */
+	result = create_queues(manager, mctx, 1);
+	if (result != ISC_R_SUCCESS) {
+		DESTROYLOCK(&manager->excl_lock);
+		DESTROYLOCK(&manager->lock);
+		goto cleanup_mgr;
+	}
 #endif /* USE_WORKER_THREADS */
 	if (default_quantum == 0)
 		default_quantum = DEFAULT_DEFAULT_QUANTUM;
 	manager->default_quantum = default_quantum;
 	INIT_LIST(manager->tasks);
-	INIT_LIST(manager->ready_tasks);
-	INIT_LIST(manager->ready_priority_tasks);
-	manager->tasks_running = 0;
-	manager->tasks_ready = 0;
+	manager->next_queue = 0;
 	manager->exclusive_requested = false;
 	manager->pause_requested = false;
 	manager->exiting = false;
+	manager->finished = false;
 	manager->excl = NULL;
 
 	isc_mem_attach(mctx, &manager->mctx);
@@ -1465,7 +1833,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	 * Start workers.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
+		if (isc_thread_create(run, &manager->queues[manager->workers],
 				      &manager->threads[manager->workers]) ==
 		    ISC_R_SUCCESS) {
 			char name[21];	/* thread name limit on Linux */
@@ -1476,6 +1844,11 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 			started++;
 		}
 	}
+	/*
+	 * Only keep a run queue for each worker we actually have.
+	 */
+	destroy_queues(manager->queues, started, workers);
+	manager->nqueues = started;
 	UNLOCK(&manager->lock);
 
 	if (started == 0) {
@@ -1494,10 +1867,12 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	return (ISC_R_SUCCESS);
 
 #ifdef USE_WORKER_THREADS
+ cleanup_idle:
+	isc_refcount_destroy(&manager->idle_workers);
+ cleanup_paused:
+	(void)isc_condition_destroy(&manager->paused);
  cleanup_exclusivegranted:
 	(void)isc_condition_destroy(&manager->exclusive_granted);
- cleanup_workavailable:
-	(void)isc_condition_destroy(&manager->work_available);
  cleanup_threads:
 	isc_mem_free(mctx, manager->threads);
  cleanup_lock:
@@ -1556,8 +1931,8 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	 * We need to do so, because otherwise the list of tasks could
 	 * change while we were traversing it.
 	 *
-	 * This is also the only function where we will hold both the
-	 * task manager lock and a task lock at the same time.
+	 * This is also the only function where we will hold the task
+	 * manager lock, a queue lock and a task lock at the same time.
 	 */
 
 	LOCK(&manager->lock);
@@ -1571,7 +1946,9 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	/*
 	 * If privileged mode was on, turn it off.
 	 */
+	lock_queues(manager);
 	manager->mode = isc_taskmgrmode_normal;
+	unlock_queues(manager, false);
 
 	/*
 	 * Post shutdown event(s) to every task (if they haven't already been
@@ -1580,18 +1957,31 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	for (task = HEAD(manager->tasks);
 	     task != NULL;
 	     task = NEXT(task, link)) {
+		isc__taskqueue_t *queue;
+		bool was_idle;
+
 		LOCK(&task->lock);
-		if (task_shutdown(task))
-			push_readyq(manager, task);
+		was_idle = task_shutdown(task);
 		UNLOCK(&task->lock);
+		if (was_idle) {
+			queue = &manager->queues[task->threadid];
+			LOCK(&queue->lock);
+			LOCK(&task->lock);
+			push_readyq(queue, task);
+			UNLOCK(&task->lock);
+			UNLOCK(&queue->lock);
+		}
 	}
-#ifdef USE_WORKER_THREADS
+
 	/*
 	 * Wake up any sleeping workers.  This ensures we get work done if
 	 * there's work left to do, and if there are already no tasks left
-	 * it will cause the workers to see manager->exiting.
+	 * it will cause the workers to see manager->finished.
 	 */
-	BROADCAST(&manager->work_available);
+	lock_queues(manager);
+	manager->finished = FINISHED(manager);
+	unlock_queues(manager, true);
+#ifdef USE_WORKER_THREADS
 	UNLOCK(&manager->lock);
 
 	/*
@@ -1624,7 +2014,9 @@ isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 
 	LOCK(&manager->lock);
+	lock_queues(manager);
 	manager->mode = mode;
+	unlock_queues(manager, mode == isc_taskmgrmode_normal);
 	UNLOCK(&manager->lock);
 }
 
@@ -1651,9 +2043,9 @@ isc__taskmgr_ready(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (false);
 
-	LOCK(&manager->lock);
-	is_ready = !empty_readyq(manager);
-	UNLOCK(&manager->lock);
+	LOCK(&manager->queues[0].lock);
+	is_ready = !empty_readyq(manager, &manager->queues[0]);
+	UNLOCK(&manager->queues[0].lock);
 
 	return (is_ready);
 }
@@ -1669,7 +2061,7 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (ISC_R_NOTFOUND);
 
-	dispatch(manager);
+	dispatch(manager, 0);
 
 	return (ISC_R_SUCCESS);
 }
@@ -1678,9 +2070,16 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 void
 isc__taskmgr_pause(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
-	manager->pause_requested = true;
+	unsigned int running;
+
 	LOCK(&manager->lock);
-	while (manager->tasks_running > 0) {
+	lock_queues(manager);
+	manager->pause_requested = true;
+	unlock_queues(manager, false);
+	for (;;) {
+		count_tasks(manager, &running, NULL);
+		if (running == 0)
+			break;
 		WAIT(&manager->paused, &manager->lock);
 	}
 	UNLOCK(&manager->lock);
@@ -1692,8 +2091,9 @@ isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 
 	LOCK(&manager->lock);
 	if (manager->pause_requested) {
+		lock_queues(manager);
 		manager->pause_requested = false;
-		BROADCAST(&manager->work_available);
+		unlock_queues(manager, true);
 	}
 	UNLOCK(&manager->lock);
 }
@@ -1736,6 +2136,7 @@ isc__task_beginexclusive(isc_task_t *task0) {
 #ifdef USE_WORKER_THREADS
 	isc__task_t *task;
 	isc__taskmgr_t *manager;
+	unsigned int running;
 
 	REQUIRE(VALID_TASK(task0));
 
@@ -1752,8 +2153,13 @@ isc__task_beginexclusive(isc_task_t *task0) {
 		UNLOCK(&manager->lock);
 		return (ISC_R_LOCKBUSY);
 	}
+	lock_queues(manager);
 	manager->exclusive_requested = true;
-	while (manager->tasks_running > 1) {
+	unlock_queues(manager, false);
+	for (;;) {
+		count_tasks(manager, &running, NULL);
+		if (running <= 1)
+			break;
 		WAIT(&manager->exclusive_granted, &manager->lock);
 	}
 	UNLOCK(&manager->lock);
@@ -1777,8 +2183,9 @@ isc__task_endexclusive(isc_task_t *task0) {
 
 	LOCK(&manager->lock);
 	REQUIRE(manager->exclusive_requested);
+	lock_queues(manager);
 	manager->exclusive_requested = false;
-	BROADCAST(&manager->work_available);
+	unlock_queues(manager, true);
 	UNLOCK(&manager->lock);
 #else
 	UNUSED(task0);
@@ -1789,6 +2196,7 @@ void
 isc__task_setprivilege(isc_task_t *task0, bool priv) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue = &manager->queues[task->threadid];
 	bool oldpriv;
 
 	LOCK(&task->lock);
@@ -1802,14 +2210,14 @@ isc__task_setprivilege(isc_task_t *task0, bool priv) {
 	if (priv == oldpriv)
 		return;
 
-	LOCK(&manager->lock);
+	LOCK(&queue->lock);
 	if (priv && ISC_LINK_LINKED(task, ready_link))
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
 	else if (!priv && ISC_LINK_LINKED(task, ready_priority_link))
-		DEQUEUE(manager->ready_priority_tasks, task,
+		DEQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 bool
@@ -1843,6 +2251,7 @@ int
 isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
+	unsigned int tasks_running, tasks_ready;
 	int xmlrc;
 
 	LOCK(&mgr->lock);
@@ -1875,12 +2284,14 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 					    mgr->default_quantum));
 	TRY0(xmlTextWriterEndElement(writer)); /* default-quantum */
 
+	count_tasks(mgr, &tasks_running, &tasks_ready);
+
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-running"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_running));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d", tasks_running));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-running */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-ready"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_ready));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d", tasks_ready));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-ready */
 
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
@@ -1953,6 +2364,7 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
+	unsigned int tasks_running, tasks_ready;
 	json_object *obj = NULL, *array = NULL, *taskobj = NULL;
 
 	LOCK(&mgr->lock);
@@ -1983,11 +2395,13 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "default-quantum", obj);
 
-	obj = json_object_new_int(mgr->tasks_running);
+	count_tasks(mgr, &tasks_running, &tasks_ready);
+
+	obj = json_object_new_int(tasks_running);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-running", obj);
 
-	obj = json_object_new_int(mgr->tasks_ready);
+	obj = json_object_new_int(tasks_ready);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-ready", obj);
 
@@ -2164,6 +2578,24 @@ isc_task_create(isc_taskmgr_t *manager, unsigned int quantum,
 	return (manager->methods->taskcreate(manager, quantum, taskp));
 }
 
+isc_result_t
+isc_task_create_bound(isc_taskmgr_t *manager, unsigned int quantum,
+		      isc_task_t **taskp, int threadid)
+{
+	REQUIRE(ISCAPI_TASKMGR_VALID(manager));
+	REQUIRE(taskp != NULL && *taskp == NULL);
+
+	if (isc_bind9)
+		return (isc__task_create_bound(manager, quantum, taskp,
+					       threadid));
+
+	/*
+	 * Other task manager implementations have no notion of worker
+	 * affinity.
+	 */
+	return (manager->methods->taskcreate(manager, quantum, taskp));
+}
+
 void
 isc_task_attach(isc_task_t *source, isc_task_t **targetp) {
 	REQUIRE(ISCAPI_TASK_VALID(source));
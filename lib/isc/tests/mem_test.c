@@ -26,9 +26,11 @@
 #include <cmocka.h>
 
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include "isctest.h"
@@ -275,6 +277,192 @@ isc_mem_inuse_test(void **state) {
 
 }
 
+typedef struct {
+	isc_mem_t *mctx;
+	int hicount;
+	int locount;
+} water_arg_t;
+
+static void
+water(void *arg0, int mark) {
+	water_arg_t *arg = arg0;
+
+	if (mark == ISC_MEM_HIWATER) {
+		arg->hicount++;
+	} else {
+		arg->locount++;
+	}
+	isc_mem_waterack(arg->mctx, mark);
+}
+
+#define	WATER_BLOCKS	1000
+#define	WATER_SIZE	100
+
+/* test water marks with blocks held by the thread caches */
+static void
+isc_mem_water_test(void **state) {
+	isc_result_t result;
+	isc_mem_t *mctx2 = NULL;
+	water_arg_t arg;
+	void *blocks[WATER_BLOCKS];
+	unsigned int i, debugging;
+
+	UNUSED(state);
+
+	/*
+	 * Thread caches are only used by internal contexts, and not
+	 * while memory debugging is on.
+	 */
+	debugging = isc_mem_debugging;
+	isc_mem_debugging = 0;
+	result = isc_mem_createx2(0, 0, default_memalloc, default_memfree,
+				  NULL, &mctx2, ISC_MEMFLAG_INTERNAL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	arg.mctx = mctx2;
+	arg.hicount = 0;
+	arg.locount = 0;
+	isc_mem_setwater(mctx2, water, &arg,
+			 4096,
+			 2048);
+
+	for (i = 0; i < WATER_BLOCKS; i++) {
+		blocks[i] = isc_mem_get(mctx2, WATER_SIZE);
+		assert_non_null(blocks[i]);
+	}
+	assert_int_equal(arg.hicount, 1);
+	assert_true(isc_mem_isovermem(mctx2));
+
+	/*
+	 * Blocks that have been freed but are still cached by this
+	 * thread must not keep the context over its water marks.
+	 */
+	for (i = 0; i < WATER_BLOCKS; i++) {
+		isc_mem_put(mctx2, blocks[i], WATER_SIZE);
+	}
+	assert_int_equal(arg.locount, 1);
+	assert_false(isc_mem_isovermem(mctx2));
+
+	isc_mem_setwater(mctx2, NULL, NULL, 0, 0);
+	isc_mem_destroy(&mctx2);
+	isc_mem_debugging = debugging;
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+#define	MT_THREADS	4
+#define	MT_ITEMS	200
+#define	MT_LOOPS	2000
+
+typedef struct {
+	isc_mem_t *mctx;
+	isc_mempool_t *mp;
+	void *foreign[MT_ITEMS];	/* allocated by the main thread */
+} mt_arg_t;
+
+static isc_threadresult_t
+mt_worker(isc_threadarg_t arg0) {
+	mt_arg_t *arg = arg0;
+	void *blocks[MT_ITEMS];
+	void *items[MT_ITEMS];
+	unsigned int i, j;
+
+	/*
+	 * Free memory taken by another thread.
+	 */
+	for (i = 0; i < MT_ITEMS; i++) {
+		isc_mem_put(arg->mctx, arg->foreign[i], i + 1);
+	}
+
+	for (j = 0; j < MT_LOOPS; j++) {
+		for (i = 0; i < MT_ITEMS; i++) {
+			blocks[i] = isc_mem_get(arg->mctx, (i * 13 + j) % 900);
+			assert_non_null(blocks[i]);
+			memset(blocks[i], j, (i * 13 + j) % 900);
+			items[i] = isc_mempool_get(arg->mp);
+			assert_non_null(items[i]);
+		}
+		for (i = 0; i < MT_ITEMS; i++) {
+			isc_mem_put(arg->mctx, blocks[i], (i * 13 + j) % 900);
+			isc_mempool_put(arg->mp, items[i]);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/* test per-thread caches with several threads */
+static void
+isc_mem_thread_test(void **state) {
+	isc_result_t result;
+	isc_mem_t *localmctx = NULL;
+	isc_mempool_t *mp = NULL;
+	isc_mutex_t lock;
+	isc_thread_t threads[MT_THREADS];
+	mt_arg_t args[MT_THREADS];
+	void *items[MT_ITEMS + 1];
+	unsigned int i, j;
+
+	UNUSED(state);
+
+	result = isc_mem_create(0, 0, &localmctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_mutex_init(&lock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_mempool_create(localmctx, 40, &mp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_mempool_associatelock(mp, &lock);
+	isc_mempool_setfreemax(mp, 64);
+	isc_mempool_setfillcount(mp, 16);
+	isc_mempool_setmaxalloc(mp, MT_THREADS * MT_ITEMS);
+
+	for (i = 0; i < MT_THREADS; i++) {
+		args[i].mctx = localmctx;
+		args[i].mp = mp;
+		for (j = 0; j < MT_ITEMS; j++) {
+			args[i].foreign[j] = isc_mem_get(localmctx, j + 1);
+			assert_non_null(args[i].foreign[j]);
+		}
+		result = isc_thread_create(mt_worker, &args[i], &threads[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < MT_THREADS; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	/*
+	 * Items held by thread caches are not counted as allocated.
+	 */
+	assert_int_equal(isc_mempool_getallocated(mp), 0);
+
+	/*
+	 * The pool limit still applies.
+	 */
+	isc_mempool_setmaxalloc(mp, MT_ITEMS);
+	for (i = 0; i < MT_ITEMS; i++) {
+		items[i] = isc_mempool_get(mp);
+		assert_non_null(items[i]);
+	}
+	items[MT_ITEMS] = isc_mempool_get(mp);
+	assert_null(items[MT_ITEMS]);
+	assert_int_equal(isc_mempool_getallocated(mp), MT_ITEMS);
+	for (i = 0; i < MT_ITEMS; i++) {
+		isc_mempool_put(mp, items[i]);
+	}
+	assert_int_equal(isc_mempool_getallocated(mp), 0);
+
+	isc_mempool_destroy(&mp);
+	DESTROYLOCK(&lock);
+
+	/*
+	 * Destroying the context checks that every block, including
+	 * those still held by thread caches, has been accounted for.
+	 */
+	isc_mem_destroy(&localmctx);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
 /*
  * Main
  */
@@ -288,6 +476,12 @@ main(void) {
 				_setup, _teardown),
 		cmocka_unit_test_setup_teardown(isc_mem_inuse_test,
 				_setup, _teardown),
+		cmocka_unit_test_setup_teardown(isc_mem_water_test,
+				_setup, _teardown),
+#ifdef ISC_PLATFORM_USETHREADS
+		cmocka_unit_test_setup_teardown(isc_mem_thread_test,
+				_setup, _teardown),
+#endif
 	};
 
 	return (cmocka_run_group_tests(tests, NULL, NULL));
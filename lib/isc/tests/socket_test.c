@@ -240,6 +240,206 @@ udp_sendto_test(void **state)  {
 
 }
 
+/* Test UDP sendto/recv with a manager running several socket threads */
+#define MULTILOOP_SOCKETS 8
+static void
+udp_multiloop_test(void **state) {
+	isc_result_t result;
+	isc_socketmgr_t *mgr = NULL;
+	isc_sockaddr_t addr[MULTILOOP_SOCKETS];
+	struct in_addr in;
+	isc_socket_t *s[MULTILOOP_SOCKETS];
+	isc_task_t *task = NULL;
+	char sendbuf[MULTILOOP_SOCKETS][BUFSIZ];
+	char recvbuf[MULTILOOP_SOCKETS][BUFSIZ];
+	completion_t sent[MULTILOOP_SOCKETS], recvd[MULTILOOP_SOCKETS];
+	isc_region_t r;
+	int i;
+
+	UNUSED(state);
+
+	result = isc_socketmgr_create3(mctx, &mgr, 0, 4);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	for (i = 0; i < MULTILOOP_SOCKETS; i++) {
+		s[i] = NULL;
+		isc_sockaddr_fromin(&addr[i], &in, 0);
+		result = isc_socket_create(mgr, PF_INET, isc_sockettype_udp,
+					   &s[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = isc_socket_bind(s[i], &addr[i], 0);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = isc_socket_getsockname(s[i], &addr[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Post the receives first so that every socket thread has a
+	 * descriptor to watch, then send to each socket from its
+	 * neighbour.
+	 */
+	for (i = 0; i < MULTILOOP_SOCKETS; i++) {
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&recvd[i]);
+		result = isc_socket_recv(s[i], &r, 1, task, event_done,
+					 &recvd[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < MULTILOOP_SOCKETS; i++) {
+		int to = (i + 1) % MULTILOOP_SOCKETS;
+
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "Hello %d", to);
+		r.base = (void *) sendbuf[i];
+		r.length = strlen(sendbuf[i]) + 1;
+		completion_init(&sent[i]);
+		result = isc_socket_sendto(s[i], &r, task, event_done,
+					   &sent[i], &addr[to], NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < MULTILOOP_SOCKETS; i++) {
+		char expect[BUFSIZ];
+
+		result = waitfor2(&sent[i], &recvd[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(sent[i].result, ISC_R_SUCCESS);
+		assert_int_equal(recvd[i].result, ISC_R_SUCCESS);
+		snprintf(expect, sizeof(expect), "Hello %d", i);
+		assert_string_equal(recvbuf[i], expect);
+	}
+
+	isc_task_detach(&task);
+
+	for (i = 0; i < MULTILOOP_SOCKETS; i++)
+		isc_socket_detach(&s[i]);
+
+	isc_socketmgr_destroy(&mgr);
+}
+
+/* Test binding several UDP sockets to one port with SO_REUSEPORT */
+static void
+udp_reuseport_test(void **state) {
+	isc_result_t result;
+	isc_sockaddr_t addr;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL, *s3 = NULL;
+
+	UNUSED(state);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr, ISC_SOCKET_REUSEPORT);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_socket_detach(&s1);
+		skip();
+		return;
+	}
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s1, &addr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(isc_sockaddr_getport(&addr) != 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr, ISC_SOCKET_REUSEPORT);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* A socket without SO_REUSEPORT may not join the group. */
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s3);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s3, &addr, 0);
+	assert_int_equal(result, ISC_R_ADDRINUSE);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+	isc_socket_detach(&s3);
+}
+
+/* Test several UDP receives queued on one socket (batched receive) */
+#define BATCH_DATAGRAMS 6
+static void
+udp_batch_test(void **state) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[BATCH_DATAGRAMS][BUFSIZ];
+	char recvbuf[BATCH_DATAGRAMS][BUFSIZ];
+	completion_t sent[BATCH_DATAGRAMS], recvd[BATCH_DATAGRAMS];
+	isc_region_t r;
+	int i;
+
+	UNUSED(state);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(isc_sockaddr_getport(&addr2) != 0);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/*
+	 * Queue all the receives before anything is sent, so that they
+	 * are satisfied together when the socket becomes readable.
+	 */
+	for (i = 0; i < BATCH_DATAGRAMS; i++) {
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&recvd[i]);
+		result = isc_socket_recv(s2, &r, 1, task, event_done,
+					 &recvd[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < BATCH_DATAGRAMS; i++) {
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "Datagram %d", i);
+		r.base = (void *) sendbuf[i];
+		r.length = strlen(sendbuf[i]) + 1;
+		completion_init(&sent[i]);
+		result = isc_socket_sendto(s1, &r, task, event_done,
+					   &sent[i], &addr2, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < BATCH_DATAGRAMS; i++) {
+		waitfor(&sent[i]);
+		assert_true(sent[i].done);
+		assert_int_equal(sent[i].result, ISC_R_SUCCESS);
+		waitfor(&recvd[i]);
+		assert_true(recvd[i].done);
+		assert_int_equal(recvd[i].result, ISC_R_SUCCESS);
+		assert_string_equal(recvbuf[i], sendbuf[i]);
+	}
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+}
+
 /* Test UDP sendto/recv with duplicated socket */
 static void
 udp_dup_test(void **state) {
@@ -863,6 +1063,12 @@ main(void) {
 						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(udp_dup_test,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(udp_multiloop_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(udp_reuseport_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(udp_batch_test,
+						_setup, _teardown),
 		cmocka_unit_test_setup_teardown(tcp_dscp_v4_test,
 						_setup, _teardown),
 #if defined(ISC_PLATFORM_HAVEIPV6) && defined(WANT_IPV6)
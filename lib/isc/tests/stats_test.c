@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <config.h>
+
+#if HAVE_CMOCKA
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <sched.h> /* IWYU pragma: keep */
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/result.h>
+#include <isc/stats.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+#define NCOUNTERS	11
+#define NTHREADS	4
+#define NLOOPS		100000
+
+static int
+_setup(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = isc_test_begin(NULL, true, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (0);
+}
+
+static int
+_teardown(void **state) {
+	UNUSED(state);
+
+	isc_test_end();
+
+	return (0);
+}
+
+static isc_threadresult_t
+update(isc_threadarg_t arg) {
+	isc_stats_t *stats = arg;
+	int i;
+
+	for (i = 0; i < NLOOPS; i++) {
+		isc_stats_increment(stats, 0);
+		isc_stats_increment(stats, NCOUNTERS - 1);
+		if ((i % 2) == 0) {
+			isc_stats_decrement(stats, NCOUNTERS - 1);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+dump(isc_statscounter_t counter, uint64_t value, void *arg) {
+	uint64_t *values = arg;
+
+	assert_in_range(counter, 0, NCOUNTERS - 1);
+	values[counter] = value;
+}
+
+static void
+check_stats(unsigned int options) {
+	isc_result_t result;
+	isc_stats_t *stats = NULL;
+	uint64_t values[NCOUNTERS];
+	int i;
+
+	result = isc_stats_create2(mctx, &stats, NCOUNTERS, options);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_stats_ncounters(stats), NCOUNTERS);
+
+#ifdef ISC_PLATFORM_USETHREADS
+	{
+		isc_thread_t threads[NTHREADS];
+
+		for (i = 0; i < NTHREADS; i++) {
+			result = isc_thread_create(update, stats, &threads[i]);
+			assert_int_equal(result, ISC_R_SUCCESS);
+		}
+		for (i = 0; i < NTHREADS; i++) {
+			isc_thread_join(threads[i], NULL);
+		}
+	}
+#else
+	for (i = 0; i < NTHREADS; i++) {
+		(void)update(stats);
+	}
+#endif
+	(void)update(stats);
+
+	/*
+	 * Counters updated by several threads add up.
+	 */
+	assert_int_equal(isc_stats_get_counter(stats, 0),
+			 (NTHREADS + 1) * NLOOPS);
+	assert_int_equal(isc_stats_get_counter(stats, NCOUNTERS - 1),
+			 (NTHREADS + 1) * NLOOPS / 2);
+
+	memset(values, 0xff, sizeof(values));
+	isc_stats_dump(stats, dump, values, ISC_STATSDUMP_VERBOSE);
+	assert_int_equal(values[0], (NTHREADS + 1) * NLOOPS);
+	assert_int_equal(values[NCOUNTERS - 1], (NTHREADS + 1) * NLOOPS / 2);
+	for (i = 1; i < NCOUNTERS - 1; i++) {
+		assert_int_equal(values[i], 0);
+	}
+
+	/*
+	 * Set and raise a counter.
+	 */
+	isc_stats_set(stats, 42, 0);
+	assert_int_equal(isc_stats_get_counter(stats, 0), 42);
+	isc_stats_update_if_greater(stats, 1, 10);
+	isc_stats_update_if_greater(stats, 1, 5);
+	assert_int_equal(isc_stats_get_counter(stats, 1), 10);
+	isc_stats_update_if_greater(stats, 1, 100);
+	assert_int_equal(isc_stats_get_counter(stats, 1), 100);
+
+	isc_stats_detach(&stats);
+	assert_null(stats);
+}
+
+/* counters shared by all threads */
+static void
+isc_stats_shared_test(void **state) {
+	UNUSED(state);
+
+	check_stats(0);
+}
+
+/* counters with a copy per thread */
+static void
+isc_stats_perthread_test(void **state) {
+	UNUSED(state);
+
+	check_stats(ISC_STATSCREATE_PERTHREAD);
+}
+
+int
+main(void) {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(isc_stats_shared_test,
+						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(isc_stats_perthread_test,
+						_setup, _teardown),
+	};
+
+	return (cmocka_run_group_tests(tests, NULL, NULL));
+}
+
+#else /* HAVE_CMOCKA */
+
+#include <stdio.h>
+
+int
+main(void) {
+	printf("1..0 # Skipped: cmocka not available\n");
+	return (0);
+}
+
+#endif
@@ -33,6 +33,7 @@
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
@@ -1478,6 +1479,160 @@ purgeevent_notpurge(void **state) {
 
 	try_purgeevent(false);
 }
+
+/*
+ * Bound task test:
+ * All events sent to a task created with isc_task_create_bound() are
+ * processed by the same worker thread.
+ */
+#define BOUND_EVENTS 100
+static isc_thread_t bound_threads[BOUND_EVENTS];
+
+static void
+bound_cb(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	LOCK(&lock);
+	bound_threads[counter++] = isc_thread_self();
+	if (counter == BOUND_EVENTS) {
+		SIGNAL(&cv);
+	}
+	UNLOCK(&lock);
+
+	isc_event_free(&event);
+}
+
+static void
+bound_task(void **state) {
+	isc_result_t result;
+	isc_task_t *task = NULL;
+	int i;
+
+	UNUSED(state);
+
+	counter = 0;
+
+	result = isc_task_create_bound(taskmgr, 1, &task, 1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	LOCK(&lock);
+	for (i = 0; i < BOUND_EVENTS; i++) {
+		isc_event_t *event;
+
+		event = isc_event_allocate(mctx, task, ISC_TASKEVENT_TEST,
+					   bound_cb, NULL, sizeof(*event));
+		assert_non_null(event);
+		isc_task_send(task, &event);
+
+		/* Give the other workers a chance to interfere. */
+		if (i % 10 == 0) {
+			UNLOCK(&lock);
+			isc_test_nap(1000);
+			LOCK(&lock);
+		}
+	}
+	while (counter < BOUND_EVENTS) {
+		WAIT(&cv, &lock);
+	}
+	UNLOCK(&lock);
+
+	for (i = 1; i < BOUND_EVENTS; i++) {
+		assert_true(bound_threads[i] == bound_threads[0]);
+	}
+
+	isc_task_detach(&task);
+}
+
+/*
+ * Work stealing test:
+ * While one worker is kept busy, the tasks queued behind it are
+ * picked up by the other worker.
+ */
+#define STEAL_TASKS 10
+static int steal_count;
+
+static void
+steal_block(isc_task_t *task, isc_event_t *event) {
+	int i = 0;
+
+	UNUSED(task);
+
+	LOCK(&lock);
+	while (counter < STEAL_TASKS && i++ < 500) {
+		UNLOCK(&lock);
+		isc_test_nap(10000);
+		LOCK(&lock);
+	}
+	steal_count = counter;
+	done = true;
+	SIGNAL(&cv);
+	UNLOCK(&lock);
+
+	isc_event_free(&event);
+}
+
+static void
+steal_cb(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	LOCK(&lock);
+	counter++;
+	UNLOCK(&lock);
+
+	isc_event_free(&event);
+}
+
+static void
+steal(void **state) {
+	isc_result_t result;
+	isc_task_t *blocker = NULL;
+	isc_task_t *tasks[STEAL_TASKS];
+	isc_event_t *event;
+	int i;
+
+	UNUSED(state);
+
+	counter = 0;
+	steal_count = 0;
+	done = false;
+
+	/*
+	 * Tie up worker 0.
+	 */
+	result = isc_task_create_bound(taskmgr, 0, &blocker, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	event = isc_event_allocate(mctx, blocker, ISC_TASKEVENT_TEST,
+				   steal_block, NULL, sizeof(*event));
+	assert_non_null(event);
+	isc_task_send(blocker, &event);
+	isc_test_nap(10000);
+
+	/*
+	 * Unbound tasks are spread over both workers; the ones queued
+	 * on worker 0 can only complete if worker 1 steals them.
+	 */
+	for (i = 0; i < STEAL_TASKS; i++) {
+		tasks[i] = NULL;
+		result = isc_task_create(taskmgr, 0, &tasks[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		event = isc_event_allocate(mctx, tasks[i], ISC_TASKEVENT_TEST,
+					   steal_cb, NULL, sizeof(*event));
+		assert_non_null(event);
+		isc_task_send(tasks[i], &event);
+	}
+
+	LOCK(&lock);
+	while (!done) {
+		WAIT(&cv, &lock);
+	}
+	UNLOCK(&lock);
+	assert_int_equal(steal_count, STEAL_TASKS);
+
+	for (i = 0; i < STEAL_TASKS; i++) {
+		isc_task_detach(&tasks[i]);
+	}
+	isc_task_detach(&blocker);
+}
 #endif
 
 int
@@ -1502,6 +1657,9 @@ main(int argc, char **argv) {
 		cmocka_unit_test_setup_teardown(purgeevent, _setup2, _teardown),
 		cmocka_unit_test_setup_teardown(purgeevent_notpurge,
 						_setup, _teardown),
+		cmocka_unit_test_setup_teardown(bound_task,
+						_setup4, _teardown),
+		cmocka_unit_test_setup_teardown(steal, _setup2, _teardown),
 #endif
 	};
 	int c;
@@ -570,6 +570,118 @@ purge(void **state) {
 	isc_task_destroy(&task2);
 	DESTROYLOCK(&mx);
 }
+
+#define NWHEELTIMERS	64
+
+static isc_timer_t *wheeltimers[NWHEELTIMERS];
+static isc_time_t wheeldue[NWHEELTIMERS];
+static int wheelfired[NWHEELTIMERS];
+
+static void
+wheel_event(isc_task_t *task, isc_event_t *event) {
+	isc_timerevent_t *tevent = (isc_timerevent_t *)event;
+	uintptr_t i = (uintptr_t)event->ev_arg;
+	isc_result_t result;
+	isc_time_t now;
+
+	UNUSED(task);
+
+	result = isc_time_now(&now);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	if (verbose) {
+		print_message("# wheel timer %u\n", (unsigned int)i);
+	}
+
+	assert_int_equal(event->ev_type, ISC_TIMEREVENT_LIFE);
+	assert_true(isc_time_compare(&now, &wheeldue[i]) >= 0);
+	assert_int_equal(isc_time_compare(&tevent->due, &wheeldue[i]), 0);
+
+	LOCK(&mx);
+	wheelfired[i]++;
+	if (++eventcnt == NWHEELTIMERS) {
+		result = isc_condition_signal(&cv);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	UNLOCK(&mx);
+
+	isc_event_free(&event);
+}
+
+/* timers spread over the timing wheel, rescheduled from far away */
+static void
+wheel(void **state) {
+	isc_result_t result;
+	isc_task_t *task = NULL;
+	isc_interval_t interval;
+	isc_time_t far;
+	uintptr_t i;
+
+	UNUSED(state);
+
+	eventcnt = 0;
+	memset(wheelfired, 0, sizeof(wheelfired));
+
+	result = isc_mutex_init(&mx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_condition_init(&cv);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_interval_set(&interval, 3600, 0);
+	result = isc_time_nowplusinterval(&far, &interval);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	LOCK(&mx);
+
+	/*
+	 * Due times from 5ms to about 700ms cover several laps of the
+	 * innermost level.  Every other timer is first scheduled an hour
+	 * away and then reset, moving it between levels.
+	 */
+	for (i = 0; i < NWHEELTIMERS; i++) {
+		isc_interval_set(&interval, 0, 5000000 + i * 10999999);
+		result = isc_time_nowplusinterval(&wheeldue[i], &interval);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		wheeltimers[i] = NULL;
+		result = isc_timer_create(timermgr, isc_timertype_once,
+					  (i % 2) == 0 ? &far : &wheeldue[i],
+					  NULL, task, wheel_event, (void *)i,
+					  &wheeltimers[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < NWHEELTIMERS; i += 2) {
+		result = isc_timer_reset(wheeltimers[i], isc_timertype_once,
+					 &wheeldue[i], NULL, true);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	while (eventcnt != NWHEELTIMERS) {
+		result = isc_condition_wait(&cv, &mx);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	UNLOCK(&mx);
+
+	/*
+	 * Give any duplicate events a chance to show up.
+	 */
+	usleep(100000);
+
+	for (i = 0; i < NWHEELTIMERS; i++) {
+		assert_int_equal(wheelfired[i], 1);
+		isc_timer_detach(&wheeltimers[i]);
+	}
+
+	isc_task_detach(&task);
+	DESTROYLOCK(&mx);
+	(void) isc_condition_destroy(&cv);
+}
 #endif
 
 int
@@ -581,6 +693,7 @@ main(int argc, char **argv) {
 		cmocka_unit_test_setup_teardown(once_idle, _setup, _teardown),
 		cmocka_unit_test_setup_teardown(reset, _setup, _teardown),
 		cmocka_unit_test_setup_teardown(purge, _setup, _teardown),
+		cmocka_unit_test_setup_teardown(wheel, _setup, _teardown),
 	};
 	int c;
 
@@ -14,16 +14,18 @@
 
 #include <config.h>
 
+#include <inttypes.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include <isc/app.h>
 #include <isc/condition.h>
-#include <isc/heap.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/msgs.h>
 #include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/task.h>
@@ -67,27 +69,76 @@
 #define TIMER_MAGIC			ISC_MAGIC('T', 'I', 'M', 'R')
 #define VALID_TIMER(t)			ISC_MAGIC_VALID(t, TIMER_MAGIC)
 
+/*
+ * Scheduled timers are kept in hierarchical timing wheels.  Due times
+ * are rounded up to whole ticks of TIMER_TICK nanoseconds; level 0 of
+ * the wheel holds the timers due within the next WHEEL_SIZE ticks, one
+ * slot per tick, and each higher level covers WHEEL_SIZE times the span
+ * of the level below.  When the lower levels wrap, the timers in the
+ * next slot of the level above are redistributed ("cascaded") into the
+ * lower levels.  Scheduling and descheduling a timer is O(1).
+ *
+ * Timers are spread over several shards, each with its own wheel, lock
+ * and (when threaded) dispatch thread, so that the tasks creating and
+ * resetting timers do not all contend for one lock.
+ */
+#define TIMER_TICK			1000000		/* 1ms */
+#define TICKS_PER_SECOND		(1000000000 / TIMER_TICK)
+#define TICK_NEVER			UINT64_MAX
+#define WHEEL_BITS			8
+#define WHEEL_SIZE			(1 << WHEEL_BITS)
+#define WHEEL_MASK			(WHEEL_SIZE - 1)
+#define WHEEL_WORDS			(WHEEL_SIZE / 64)
+#define WHEEL_LEVELS			4
+#define WHEEL_RANGE			((UINT64_C(1) << \
+					  (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+#define TIMER_MAXSHARDS			16
+
 typedef struct isc__timer isc__timer_t;
+typedef struct isc__timershard isc__timershard_t;
 typedef struct isc__timermgr isc__timermgr_t;
 
+typedef ISC_LIST(isc__timer_t) timerlist_t;
+
 struct isc__timer {
 	/*! Not locked. */
 	isc_timer_t			common;
 	isc__timermgr_t *		manager;
+	isc__timershard_t *		shard;
 	isc_mutex_t			lock;
 	/*! Locked by timer lock. */
 	unsigned int			references;
 	isc_time_t			idle;
-	/*! Locked by manager lock. */
+	/*! Locked by shard lock. */
 	isc_timertype_t			type;
 	isc_time_t			expires;
 	isc_interval_t			interval;
 	isc_task_t *			task;
 	isc_taskaction_t		action;
 	void *				arg;
-	unsigned int			index;
+	int				slot;	/* -1 if not scheduled */
+	uint64_t			tick;
 	isc_time_t			due;
 	LINK(isc__timer_t)		link;
+	LINK(isc__timer_t)		wheellink;
+};
+
+struct isc__timershard {
+	/* Not locked. */
+	isc__timermgr_t *		manager;
+	isc_mutex_t			lock;
+	/* Locked by shard lock. */
+	bool				done;
+	LIST(isc__timer_t)		timers;
+	unsigned int			nscheduled;
+	uint64_t			current;	/* next tick to expire */
+	uint64_t			next;		/* nothing due before */
+	uint64_t			bits[WHEEL_LEVELS][WHEEL_WORDS];
+	timerlist_t			wheel[WHEEL_LEVELS][WHEEL_SIZE];
+#ifdef USE_TIMER_THREAD
+	isc_condition_t			wakeup;
+	isc_thread_t			thread;
+#endif	/* USE_TIMER_THREAD */
 };
 
 #define TIMER_MANAGER_MAGIC		ISC_MAGIC('T', 'I', 'M', 'M')
@@ -98,19 +149,13 @@ struct isc__timermgr {
 	isc_timermgr_t			common;
 	isc_mem_t *			mctx;
 	isc_mutex_t			lock;
+	unsigned int			nshards;
+	isc__timershard_t *		shards;
 	/* Locked by manager lock. */
 	bool			done;
-	LIST(isc__timer_t)		timers;
-	unsigned int			nscheduled;
-	isc_time_t			due;
-#ifdef USE_TIMER_THREAD
-	isc_condition_t			wakeup;
-	isc_thread_t			thread;
-#endif	/* USE_TIMER_THREAD */
 #ifdef USE_SHARED_MANAGER
 	unsigned int			refs;
 #endif /* USE_SHARED_MANAGER */
-	isc_heap_t *			heap;
 };
 
 /*%
@@ -178,15 +223,203 @@ static struct isc__timermgrmethods {
 static isc__timermgr_t *timermgr = NULL;
 #endif /* USE_SHARED_MANAGER */
 
+static inline uint64_t
+time_totick(const isc_time_t *t, bool roundup) {
+	unsigned int nanoseconds = isc_time_nanoseconds(t);
+	uint64_t tick;
+
+	tick = (uint64_t)isc_time_seconds(t) * TICKS_PER_SECOND +
+		nanoseconds / TIMER_TICK;
+	if (roundup && nanoseconds % TIMER_TICK != 0)
+		tick++;
+
+	return (tick);
+}
+
+static inline void
+tick_totime(uint64_t tick, isc_time_t *t) {
+	isc_time_set(t, (unsigned int)(tick / TICKS_PER_SECOND),
+		     (unsigned int)(tick % TICKS_PER_SECOND) * TIMER_TICK);
+}
+
+static inline unsigned int
+lowbit(uint64_t word) {
+	unsigned int bit = 0;
+
+	INSIST(word != 0);
+
+	while ((word & 0xff) == 0) {
+		word >>= 8;
+		bit += 8;
+	}
+	while ((word & 1) == 0) {
+		word >>= 1;
+		bit++;
+	}
+	return (bit);
+}
+
+/*
+ * Return the distance from slot 'start' to the first non-empty slot at
+ * or after it, wrapping around the end of the wheel, or WHEEL_SIZE if
+ * the level is empty.
+ */
+static inline unsigned int
+wheel_find(const uint64_t *bits, unsigned int start) {
+	unsigned int i, slot = start;
+	uint64_t word;
+
+	for (i = 0; i <= WHEEL_WORDS; i++) {
+		word = bits[(slot & WHEEL_MASK) / 64] >> (slot % 64);
+		if (word != 0)
+			return (slot - start + lowbit(word));
+		slot = (slot | 63) + 1;
+	}
+	return (WHEEL_SIZE);
+}
+
+static void
+wheel_insert(isc__timershard_t *shard, isc__timer_t *timer) {
+	uint64_t tick = timer->tick, delta;
+	unsigned int level, slot;
+
+	/*
+	 * The caller must be holding the shard lock.
+	 */
+
+	if (tick < shard->current)
+		tick = shard->current;
+	delta = tick - shard->current;
+	if (delta > WHEEL_RANGE) {
+		/*
+		 * Park the timer in the farthest slot; it will be
+		 * cascaded back up to here until it is in range.
+		 */
+		tick = shard->current + WHEEL_RANGE;
+		delta = WHEEL_RANGE;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		if ((delta >> (WHEEL_BITS * (level + 1))) == 0)
+			break;
+	}
+	slot = (tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+	APPEND(shard->wheel[level][slot], timer, wheellink);
+	shard->bits[level][slot / 64] |= UINT64_C(1) << (slot % 64);
+	timer->slot = level * WHEEL_SIZE + slot;
+}
+
+static void
+wheel_remove(isc__timershard_t *shard, isc__timer_t *timer) {
+	unsigned int level = timer->slot / WHEEL_SIZE;
+	unsigned int slot = timer->slot % WHEEL_SIZE;
+
+	UNLINK(shard->wheel[level][slot], timer, wheellink);
+	if (EMPTY(shard->wheel[level][slot]))
+		shard->bits[level][slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+	timer->slot = -1;
+}
+
+/*
+ * Take the timers out of 'slot' of 'level', leaving it empty.
+ */
+static inline timerlist_t
+wheel_take(isc__timershard_t *shard, unsigned int level, unsigned int slot) {
+	timerlist_t list = shard->wheel[level][slot];
+
+	INIT_LIST(shard->wheel[level][slot]);
+	shard->bits[level][slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+	return (list);
+}
+
+/*
+ * Redistribute the timers in the current slot of 'level' into the
+ * levels below it.
+ */
+static void
+wheel_cascade(isc__timershard_t *shard, unsigned int level) {
+	timerlist_t list;
+	isc__timer_t *timer;
+	unsigned int slot;
+
+	slot = (shard->current >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	list = wheel_take(shard, level, slot);
+	while ((timer = HEAD(list)) != NULL) {
+		UNLINK(list, timer, wheellink);
+		wheel_insert(shard, timer);
+	}
+}
+
+/*
+ * Move the wheel to 'tick' and redistribute every scheduled timer.
+ * Only needed if the clock has been stepped backwards.
+ */
+static void
+wheel_rebase(isc__timershard_t *shard, uint64_t tick) {
+	timerlist_t list, taken;
+	isc__timer_t *timer;
+	unsigned int level, slot;
+
+	INIT_LIST(list);
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (slot = 0; slot < WHEEL_SIZE; slot++) {
+			if (EMPTY(shard->wheel[level][slot]))
+				continue;
+			taken = wheel_take(shard, level, slot);
+			ISC_LIST_APPENDLIST(list, taken, wheellink);
+		}
+	}
+
+	shard->current = tick;
+	while ((timer = HEAD(list)) != NULL) {
+		UNLINK(list, timer, wheellink);
+		wheel_insert(shard, timer);
+	}
+}
+
+/*
+ * Return a tick no later than the earliest due time in the shard.  Timers
+ * in the upper levels are accounted for by the tick at which their slot
+ * will be cascaded.
+ */
+static uint64_t
+wheel_next(isc__timershard_t *shard) {
+	uint64_t next = TICK_NEVER, when;
+	unsigned int level, shift, start, skip, distance;
+
+	if (shard->nscheduled == 0)
+		return (TICK_NEVER);
+
+	distance = wheel_find(shard->bits[0], shard->current & WHEEL_MASK);
+	if (distance < WHEEL_SIZE)
+		next = shard->current + distance;
+
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		/*
+		 * Unless 'current' is on a boundary of this level, the
+		 * current slot has already been cascaded and anything in
+		 * it now belongs to the next lap of the wheel.
+		 */
+		shift = WHEEL_BITS * level;
+		start = (shard->current >> shift) & WHEEL_MASK;
+		skip = ((shard->current & ((UINT64_C(1) << shift) - 1)) != 0);
+		distance = wheel_find(shard->bits[level], start + skip);
+		if (distance == WHEEL_SIZE)
+			continue;
+		when = ((shard->current >> shift) + skip + distance) << shift;
+		if (when < next)
+			next = when;
+	}
+
+	return (next);
+}
+
 static inline isc_result_t
 schedule(isc__timer_t *timer, isc_time_t *now, bool signal_ok) {
 	isc_result_t result;
-	isc__timermgr_t *manager;
+	isc__timershard_t *shard;
 	isc_time_t due;
-	int cmp;
-#ifdef USE_TIMER_THREAD
-	bool timedwait;
-#endif
 
 	/*!
 	 * Note: the caller must ensure locking.
@@ -198,16 +431,7 @@ schedule(isc__timer_t *timer, isc_time_t *now, bool signal_ok) {
 	UNUSED(signal_ok);
 #endif /* USE_TIMER_THREAD */
 
-	manager = timer->manager;
-
-#ifdef USE_TIMER_THREAD
-	/*!
-	 * If the manager was timed wait, we may need to signal the
-	 * manager to force a wakeup.
-	 */
-	timedwait = (manager->nscheduled > 0 &&
-		     isc_time_seconds(&manager->due) != 0);
-#endif
+	shard = timer->shard;
 
 	/*
 	 * Compute the new due time.
@@ -234,125 +458,66 @@ schedule(isc__timer_t *timer, isc_time_t *now, bool signal_ok) {
 	 * Schedule the timer.
 	 */
 
-	if (timer->index > 0) {
-		/*
-		 * Already scheduled.
-		 */
-		cmp = isc_time_compare(&due, &timer->due);
-		timer->due = due;
-		switch (cmp) {
-		case -1:
-			isc_heap_increased(manager->heap, timer->index);
-			break;
-		case 1:
-			isc_heap_decreased(manager->heap, timer->index);
-			break;
-		case 0:
-			/* Nothing to do. */
-			break;
-		}
-	} else {
-		timer->due = due;
-		result = isc_heap_insert(manager->heap, timer);
-		if (result != ISC_R_SUCCESS) {
-			INSIST(result == ISC_R_NOMEMORY);
-			return (ISC_R_NOMEMORY);
-		}
-		manager->nscheduled++;
-	}
+	if (timer->slot >= 0)
+		wheel_remove(shard, timer);
+	else
+		shard->nscheduled++;
+	timer->due = due;
+	timer->tick = time_totick(&due, true);
+	wheel_insert(shard, timer);
 
 	XTRACETIMER(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				   ISC_MSG_SCHEDULE, "schedule"), timer, due);
 
 	/*
-	 * If this timer is at the head of the queue, we need to ensure
-	 * that we won't miss it if it has a more recent due time than
-	 * the current "next" timer.  We do this either by waking up the
-	 * run thread, or explicitly setting the value in the manager.
+	 * If this timer is due before anything else in the shard, we need
+	 * to ensure that we won't miss it.  We do this by waking up the
+	 * shard's thread, which will work out when to wake up next.
 	 */
+	if (timer->tick < shard->next) {
+		shard->next = timer->tick;
 #ifdef USE_TIMER_THREAD
-
-	/*
-	 * This is a temporary (probably) hack to fix a bug on tru64 5.1
-	 * and 5.1a.  Sometimes, pthread_cond_timedwait() doesn't actually
-	 * return when the time expires, so here, we check to see if
-	 * we're 15 seconds or more behind, and if we are, we signal
-	 * the dispatcher.  This isn't such a bad idea as a general purpose
-	 * watchdog, so perhaps we should just leave it in here.
-	 */
-	if (signal_ok && timedwait) {
-		isc_interval_t fifteen;
-		isc_time_t then;
-
-		isc_interval_set(&fifteen, 15, 0);
-		result = isc_time_add(&manager->due, &fifteen, &then);
-
-		if (result == ISC_R_SUCCESS &&
-		    isc_time_compare(&then, now) < 0) {
-			SIGNAL(&manager->wakeup);
-			signal_ok = false;
-			isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL,
-				      ISC_LOGMODULE_TIMER, ISC_LOG_WARNING,
-				      "*** POKED TIMER ***");
+		if (signal_ok) {
+			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+					      ISC_MSG_SIGNALSCHED,
+					      "signal (schedule)"));
+			SIGNAL(&shard->wakeup);
 		}
-	}
-
-	if (timer->index == 1 && signal_ok) {
-		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
-				      ISC_MSG_SIGNALSCHED,
-				      "signal (schedule)"));
-		SIGNAL(&manager->wakeup);
-	}
-#else /* USE_TIMER_THREAD */
-	if (timer->index == 1 &&
-	    isc_time_compare(&timer->due, &manager->due) < 0)
-		manager->due = timer->due;
 #endif /* USE_TIMER_THREAD */
+	}
 
 	return (ISC_R_SUCCESS);
 }
 
 static inline void
 deschedule(isc__timer_t *timer) {
-#ifdef USE_TIMER_THREAD
-	bool need_wakeup = false;
-#endif
-	isc__timermgr_t *manager;
+	isc__timershard_t *shard;
 
 	/*
 	 * The caller must ensure locking.
+	 *
+	 * There is no need to wake up the shard's thread; at worst it
+	 * will wake up early and find nothing to do.
 	 */
 
-	manager = timer->manager;
-	if (timer->index > 0) {
-#ifdef USE_TIMER_THREAD
-		if (timer->index == 1)
-			need_wakeup = true;
-#endif
-		isc_heap_delete(manager->heap, timer->index);
-		timer->index = 0;
-		INSIST(manager->nscheduled > 0);
-		manager->nscheduled--;
-#ifdef USE_TIMER_THREAD
-		if (need_wakeup) {
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
-					      ISC_MSG_SIGNALDESCHED,
-					      "signal (deschedule)"));
-			SIGNAL(&manager->wakeup);
-		}
-#endif /* USE_TIMER_THREAD */
+	shard = timer->shard;
+	if (timer->slot >= 0) {
+		wheel_remove(shard, timer);
+		INSIST(shard->nscheduled > 0);
+		shard->nscheduled--;
 	}
 }
 
 static void
 destroy(isc__timer_t *timer) {
 	isc__timermgr_t *manager = timer->manager;
+	isc__timershard_t *shard = timer->shard;
 
 	/*
 	 * The caller must ensure it is safe to destroy the timer.
 	 */
 
-	LOCK(&manager->lock);
+	LOCK(&shard->lock);
 
 	(void)isc_task_purgerange(timer->task,
 				  timer,
@@ -360,9 +525,9 @@ destroy(isc__timer_t *timer) {
 				  ISC_TIMEREVENT_LASTEVENT,
 				  NULL);
 	deschedule(timer);
-	UNLINK(manager->timers, timer, link);
+	UNLINK(shard->timers, timer, link);
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&shard->lock);
 
 	isc_task_detach(&timer->task);
 	DESTROYLOCK(&timer->lock);
@@ -424,6 +589,11 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		return (ISC_R_NOMEMORY);
 
 	timer->manager = manager;
+	/*
+	 * Spread the timers over the shards by address.
+	 */
+	timer->shard = &manager->shards[((uintptr_t)timer / sizeof(*timer)) %
+					manager->nshards];
 	timer->references = 1;
 
 	if (type == isc_timertype_once && !isc_interval_iszero(interval)) {
@@ -452,7 +622,8 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	 * keep track of whether arg started as a true const.
 	 */
 	DE_CONST(arg, timer->arg);
-	timer->index = 0;
+	timer->slot = -1;
+	timer->tick = 0;
 	result = isc_mutex_init(&timer->lock);
 	if (result != ISC_R_SUCCESS) {
 		isc_task_detach(&timer->task);
@@ -460,11 +631,12 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		return (result);
 	}
 	ISC_LINK_INIT(timer, link);
+	ISC_LINK_INIT(timer, wheellink);
 	timer->common.impmagic = TIMER_MAGIC;
 	timer->common.magic = ISCAPI_TIMER_MAGIC;
 	timer->common.methods = (isc_timermethods_t *)&timermethods;
 
-	LOCK(&manager->lock);
+	LOCK(&timer->shard->lock);
 
 	/*
 	 * Note we don't have to lock the timer like we normally would because
@@ -477,10 +649,10 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		result = ISC_R_SUCCESS;
 	if (result == ISC_R_SUCCESS) {
 		*timerp = (isc_timer_t *)timer;
-		APPEND(manager->timers, timer, link);
+		APPEND(timer->shard->timers, timer, link);
 	}
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&timer->shard->lock);
 
 	if (result != ISC_R_SUCCESS) {
 		timer->common.impmagic = 0;
@@ -538,7 +710,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 		isc_time_settoepoch(&now);
 	}
 
-	LOCK(&manager->lock);
+	LOCK(&timer->shard->lock);
 	LOCK(&timer->lock);
 
 	if (purge)
@@ -566,7 +738,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	}
 
 	UNLOCK(&timer->lock);
-	UNLOCK(&manager->lock);
+	UNLOCK(&timer->shard->lock);
 
 	return (result);
 }
@@ -606,7 +778,7 @@ isc__timer_touch(isc_timer_t *timer0) {
 	 *
 	 *	REQUIRE(timer->type == isc_timertype_once);
 	 *
-	 * but we cannot without locking the manager lock too, which we
+	 * but we cannot without locking the shard lock too, which we
 	 * don't want to do.
 	 */
 
@@ -664,122 +836,162 @@ isc__timer_detach(isc_timer_t **timerp) {
 }
 
 static void
-dispatch(isc__timermgr_t *manager, isc_time_t *now) {
-	bool done = false, post_event, need_schedule;
+fire(isc__timershard_t *shard, isc__timer_t *timer, isc_time_t *now) {
+	bool post_event, need_schedule;
 	isc_timerevent_t *event;
 	isc_eventtype_t type = 0;
-	isc__timer_t *timer;
 	isc_result_t result;
 	bool idle;
 
 	/*!
-	 * The caller must be holding the manager lock.
+	 * The caller must be holding the shard lock, and have taken the
+	 * timer off the wheel.
 	 */
 
-	while (manager->nscheduled > 0 && !done) {
-		timer = isc_heap_element(manager->heap, 1);
-		INSIST(timer != NULL && timer->type != isc_timertype_inactive);
-		if (isc_time_compare(now, &timer->due) >= 0) {
-			if (timer->type == isc_timertype_ticker) {
-				type = ISC_TIMEREVENT_TICK;
-				post_event = true;
-				need_schedule = true;
-			} else if (timer->type == isc_timertype_limited) {
-				int cmp;
-				cmp = isc_time_compare(now, &timer->expires);
-				if (cmp >= 0) {
-					type = ISC_TIMEREVENT_LIFE;
-					post_event = true;
-					need_schedule = false;
-				} else {
-					type = ISC_TIMEREVENT_TICK;
-					post_event = true;
-					need_schedule = true;
-				}
-			} else if (!isc_time_isepoch(&timer->expires) &&
-				   isc_time_compare(now,
-						    &timer->expires) >= 0) {
-				type = ISC_TIMEREVENT_LIFE;
-				post_event = true;
-				need_schedule = false;
-			} else {
-				idle = false;
-
-				LOCK(&timer->lock);
-				if (!isc_time_isepoch(&timer->idle) &&
-				    isc_time_compare(now,
-						     &timer->idle) >= 0) {
-					idle = true;
-				}
-				UNLOCK(&timer->lock);
-				if (idle) {
-					type = ISC_TIMEREVENT_IDLE;
-					post_event = true;
-					need_schedule = false;
-				} else {
-					/*
-					 * Idle timer has been touched;
-					 * reschedule.
-					 */
-					XTRACEID(isc_msgcat_get(isc_msgcat,
-								ISC_MSGSET_TIMER,
-								ISC_MSG_IDLERESCHED,
-								"idle reschedule"),
-						 timer);
-					post_event = false;
-					need_schedule = true;
-				}
-			}
+	INSIST(timer->type != isc_timertype_inactive);
+	INSIST(isc_time_compare(now, &timer->due) >= 0);
+
+	if (timer->type == isc_timertype_ticker) {
+		type = ISC_TIMEREVENT_TICK;
+		post_event = true;
+		need_schedule = true;
+	} else if (timer->type == isc_timertype_limited) {
+		int cmp;
+		cmp = isc_time_compare(now, &timer->expires);
+		if (cmp >= 0) {
+			type = ISC_TIMEREVENT_LIFE;
+			post_event = true;
+			need_schedule = false;
+		} else {
+			type = ISC_TIMEREVENT_TICK;
+			post_event = true;
+			need_schedule = true;
+		}
+	} else if (!isc_time_isepoch(&timer->expires) &&
+		   isc_time_compare(now, &timer->expires) >= 0) {
+		type = ISC_TIMEREVENT_LIFE;
+		post_event = true;
+		need_schedule = false;
+	} else {
+		idle = false;
 
-			if (post_event) {
-				XTRACEID(isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_TIMER,
-							ISC_MSG_POSTING,
-							"posting"), timer);
-				/*
-				 * XXX We could preallocate this event.
-				 */
-				event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
-							   timer,
-							   type,
-							   timer->action,
-							   timer->arg,
-							   sizeof(*event));
-
-				if (event != NULL) {
-					event->due = timer->due;
-					isc_task_send(timer->task,
-						      ISC_EVENT_PTR(&event));
-				} else
-					UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
-						 isc_msgcat_get(isc_msgcat,
-							 ISC_MSGSET_TIMER,
-							 ISC_MSG_EVENTNOTALLOC,
-							 "couldn't "
-							 "allocate event"));
-			}
+		LOCK(&timer->lock);
+		if (!isc_time_isepoch(&timer->idle) &&
+		    isc_time_compare(now, &timer->idle) >= 0) {
+			idle = true;
+		}
+		UNLOCK(&timer->lock);
+		if (idle) {
+			type = ISC_TIMEREVENT_IDLE;
+			post_event = true;
+			need_schedule = false;
+		} else {
+			/*
+			 * Idle timer has been touched; reschedule.
+			 */
+			XTRACEID(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+						ISC_MSG_IDLERESCHED,
+						"idle reschedule"),
+				 timer);
+			post_event = false;
+			need_schedule = true;
+		}
+	}
 
-			timer->index = 0;
-			isc_heap_delete(manager->heap, 1);
-			manager->nscheduled--;
+	if (post_event) {
+		XTRACEID(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+					ISC_MSG_POSTING, "posting"), timer);
+		/*
+		 * XXX We could preallocate this event.
+		 */
+		event = (isc_timerevent_t *)isc_event_allocate(shard->manager->mctx,
+							      timer,
+							      type,
+							      timer->action,
+							      timer->arg,
+							      sizeof(*event));
+
+		if (event != NULL) {
+			event->due = timer->due;
+			isc_task_send(timer->task, ISC_EVENT_PTR(&event));
+		} else
+			UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_TIMER,
+							ISC_MSG_EVENTNOTALLOC,
+							"couldn't "
+							"allocate event"));
+	}
 
-			if (need_schedule) {
-				result = schedule(timer, now, false);
-				if (result != ISC_R_SUCCESS)
-					UNEXPECTED_ERROR(__FILE__, __LINE__,
-							 "%s: %u",
-						isc_msgcat_get(isc_msgcat,
+	if (need_schedule) {
+		result = schedule(timer, now, false);
+		if (result != ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__, "%s: %u",
+					 isc_msgcat_get(isc_msgcat,
 							ISC_MSGSET_TIMER,
 							ISC_MSG_SCHEDFAIL,
 							"couldn't schedule "
 							"timer"),
-							 result);
+					 result);
+	}
+}
+
+static void
+dispatch(isc__timershard_t *shard, isc_time_t *now) {
+	uint64_t nowtick = time_totick(now, false);
+	unsigned int level, slot, distance;
+	timerlist_t list;
+	isc__timer_t *timer;
+
+	/*!
+	 * The caller must be holding the shard lock.
+	 */
+
+	if (nowtick + 1 < shard->current)
+		wheel_rebase(shard, nowtick);
+
+	while (shard->current <= nowtick) {
+		if (shard->nscheduled == 0) {
+			shard->current = nowtick + 1;
+			break;
+		}
+
+		slot = shard->current & WHEEL_MASK;
+		if (slot == 0) {
+			for (level = 1; level < WHEEL_LEVELS; level++) {
+				wheel_cascade(shard, level);
+				if (((shard->current >> (WHEEL_BITS * level)) &
+				     WHEEL_MASK) != 0)
+					break;
 			}
-		} else {
-			manager->due = timer->due;
-			done = true;
+		}
+
+		/*
+		 * Skip over empty slots, stopping at the end of this lap
+		 * of level 0 so the next cascade is not missed.
+		 */
+		distance = wheel_find(shard->bits[0], slot);
+		if (distance != 0) {
+			if (distance > WHEEL_SIZE - slot)
+				distance = WHEEL_SIZE - slot;
+			shard->current += distance;
+			if (shard->current > nowtick + 1)
+				shard->current = nowtick + 1;
+			continue;
+		}
+
+		list = wheel_take(shard, 0, slot);
+		shard->current++;
+		while ((timer = HEAD(list)) != NULL) {
+			UNLINK(list, timer, wheellink);
+			timer->slot = -1;
+			INSIST(shard->nscheduled > 0);
+			shard->nscheduled--;
+			fire(shard, timer, now);
 		}
 	}
+
+	shard->next = wheel_next(shard);
 }
 
 #ifdef USE_TIMER_THREAD
@@ -788,38 +1000,39 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__timermgr_t *manager = uap;
-	isc_time_t now;
+	isc__timershard_t *shard = uap;
+	isc_time_t now, due;
 	isc_result_t result;
 
-	LOCK(&manager->lock);
-	while (!manager->done) {
+	LOCK(&shard->lock);
+	while (!shard->done) {
 		TIME_NOW(&now);
 
 		XTRACETIME(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 					  ISC_MSG_RUNNING,
 					  "running"), now);
 
-		dispatch(manager, &now);
+		dispatch(shard, &now);
 
-		if (manager->nscheduled > 0) {
+		if (shard->next != TICK_NEVER) {
+			tick_totime(shard->next, &due);
 			XTRACETIME2(isc_msgcat_get(isc_msgcat,
 						   ISC_MSGSET_GENERAL,
 						   ISC_MSG_WAITUNTIL,
 						   "waituntil"),
-				    manager->due, now);
-			result = WAITUNTIL(&manager->wakeup, &manager->lock, &manager->due);
+				    due, now);
+			result = WAITUNTIL(&shard->wakeup, &shard->lock, &due);
 			INSIST(result == ISC_R_SUCCESS ||
 			       result == ISC_R_TIMEDOUT);
 		} else {
 			XTRACETIME(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						  ISC_MSG_WAIT, "wait"), now);
-			WAIT(&manager->wakeup, &manager->lock);
+			WAIT(&shard->wakeup, &shard->lock);
 		}
 		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				      ISC_MSG_WAKEUP, "wakeup"));
 	}
-	UNLOCK(&manager->lock);
+	UNLOCK(&shard->lock);
 
 #ifdef OPENSSL_LEAKS
 	ERR_remove_state(0);
@@ -829,34 +1042,83 @@ run(void *uap) {
 }
 #endif /* USE_TIMER_THREAD */
 
-static bool
-sooner(void *v1, void *v2) {
-	isc__timer_t *t1, *t2;
+static isc_result_t
+shard_init(isc__timermgr_t *manager, isc__timershard_t *shard) {
+	isc_result_t result;
+	isc_time_t now;
+	unsigned int level, slot;
 
-	t1 = v1;
-	t2 = v2;
-	REQUIRE(VALID_TIMER(t1));
-	REQUIRE(VALID_TIMER(t2));
+	shard->manager = manager;
+	shard->done = false;
+	INIT_LIST(shard->timers);
+	shard->nscheduled = 0;
+	TIME_NOW(&now);
+	shard->current = time_totick(&now, false);
+	shard->next = TICK_NEVER;
+	memset(shard->bits, 0, sizeof(shard->bits));
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (slot = 0; slot < WHEEL_SIZE; slot++)
+			INIT_LIST(shard->wheel[level][slot]);
+	}
 
-	if (isc_time_compare(&t1->due, &t2->due) < 0)
-		return (true);
-	return (false);
+	result = isc_mutex_init(&shard->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#ifdef USE_TIMER_THREAD
+	if (isc_condition_init(&shard->wakeup) != ISC_R_SUCCESS) {
+		DESTROYLOCK(&shard->lock);
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		return (ISC_R_UNEXPECTED);
+	}
+	if (isc_thread_create(run, shard, &shard->thread) != ISC_R_SUCCESS) {
+		(void)isc_condition_destroy(&shard->wakeup);
+		DESTROYLOCK(&shard->lock);
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_thread_create() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		return (ISC_R_UNEXPECTED);
+	}
+	isc_thread_setname(shard->thread, "isc-timer");
+#endif /* USE_TIMER_THREAD */
+
+	return (ISC_R_SUCCESS);
 }
 
 static void
-set_index(void *what, unsigned int index) {
-	isc__timer_t *timer;
-
-	REQUIRE(VALID_TIMER(what));
-	timer = what;
+shard_destroy(isc__timershard_t *shard) {
+	LOCK(&shard->lock);
+	REQUIRE(EMPTY(shard->timers));
+	shard->done = true;
+#ifdef USE_TIMER_THREAD
+	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+			      ISC_MSG_SIGNALDESTROY, "signal (destroy)"));
+	SIGNAL(&shard->wakeup);
+#endif /* USE_TIMER_THREAD */
+	UNLOCK(&shard->lock);
 
-	timer->index = index;
+#ifdef USE_TIMER_THREAD
+	/*
+	 * Wait for thread to exit.
+	 */
+	if (isc_thread_join(shard->thread, NULL) != ISC_R_SUCCESS)
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_thread_join() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+	(void)isc_condition_destroy(&shard->wakeup);
+#endif /* USE_TIMER_THREAD */
+	DESTROYLOCK(&shard->lock);
 }
 
 isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	isc__timermgr_t *manager;
 	isc_result_t result;
+	unsigned int i;
 
 	/*
 	 * Create a timer manager.
@@ -881,50 +1143,36 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	manager->common.methods = (isc_timermgrmethods_t *)&timermgrmethods;
 	manager->mctx = NULL;
 	manager->done = false;
-	INIT_LIST(manager->timers);
-	manager->nscheduled = 0;
-	isc_time_settoepoch(&manager->due);
-	manager->heap = NULL;
-	result = isc_heap_create(mctx, sooner, set_index, 0, &manager->heap);
-	if (result != ISC_R_SUCCESS) {
-		INSIST(result == ISC_R_NOMEMORY);
+
+	/*
+	 * One shard per CPU, as a power of two.
+	 */
+	manager->nshards = 1;
+#ifdef USE_TIMER_THREAD
+	while (manager->nshards < isc_os_ncpus() &&
+	       manager->nshards < TIMER_MAXSHARDS)
+		manager->nshards *= 2;
+#endif /* USE_TIMER_THREAD */
+	manager->shards = isc_mem_get(mctx, manager->nshards *
+				      sizeof(isc__timershard_t));
+	if (manager->shards == NULL) {
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (ISC_R_NOMEMORY);
 	}
+
 	result = isc_mutex_init(&manager->lock);
-	if (result != ISC_R_SUCCESS) {
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		return (result);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_shards;
+	for (i = 0; i < manager->nshards; i++) {
+		result = shard_init(manager, &manager->shards[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (i > 0)
+				shard_destroy(&manager->shards[--i]);
+			DESTROYLOCK(&manager->lock);
+			goto cleanup_shards;
+		}
 	}
 	isc_mem_attach(mctx, &manager->mctx);
-#ifdef USE_TIMER_THREAD
-	if (isc_condition_init(&manager->wakeup) != ISC_R_SUCCESS) {
-		isc_mem_detach(&manager->mctx);
-		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		return (ISC_R_UNEXPECTED);
-	}
-	if (isc_thread_create(run, manager, &manager->thread) !=
-	    ISC_R_SUCCESS) {
-		isc_mem_detach(&manager->mctx);
-		(void)isc_condition_destroy(&manager->wakeup);
-		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		return (ISC_R_UNEXPECTED);
-	}
-	isc_thread_setname(manager->thread, "isc-timer");
-#endif
 #ifdef USE_SHARED_MANAGER
 	manager->refs = 1;
 	timermgr = manager;
@@ -933,17 +1181,25 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	*managerp = (isc_timermgr_t *)manager;
 
 	return (ISC_R_SUCCESS);
+
+ cleanup_shards:
+	isc_mem_put(mctx, manager->shards,
+		    manager->nshards * sizeof(isc__timershard_t));
+	isc_mem_put(mctx, manager, sizeof(*manager));
+	return (result);
 }
 
 void
 isc_timermgr_poke(isc_timermgr_t *manager0) {
 #ifdef USE_TIMER_THREAD
 	isc__timermgr_t *manager;
+	unsigned int i;
 
 	REQUIRE(VALID_MANAGER(manager0));
 	manager = (isc__timermgr_t *)manager0;
 
-	SIGNAL(&manager->wakeup);
+	for (i = 0; i < manager->nshards; i++)
+		SIGNAL(&manager->shards[i].wakeup);
 #else
 	UNUSED(manager0);
 #endif
@@ -953,6 +1209,7 @@ void
 isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	isc__timermgr_t *manager;
 	isc_mem_t *mctx;
+	unsigned int i;
 
 	/*
 	 * Destroy a timer manager.
@@ -978,39 +1235,25 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	isc__timermgr_dispatch((isc_timermgr_t *)manager);
 #endif
 
-	REQUIRE(EMPTY(manager->timers));
 	manager->done = true;
 
-#ifdef USE_TIMER_THREAD
-	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
-			      ISC_MSG_SIGNALDESTROY, "signal (destroy)"));
-	SIGNAL(&manager->wakeup);
-#endif /* USE_TIMER_THREAD */
-
 	UNLOCK(&manager->lock);
 
-#ifdef USE_TIMER_THREAD
 	/*
-	 * Wait for thread to exit.
+	 * Stop the shards; this waits for their threads to exit.
 	 */
-	if (isc_thread_join(manager->thread, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-#endif /* USE_TIMER_THREAD */
+	for (i = 0; i < manager->nshards; i++)
+		shard_destroy(&manager->shards[i]);
 
 	/*
 	 * Clean up.
 	 */
-#ifdef USE_TIMER_THREAD
-	(void)isc_condition_destroy(&manager->wakeup);
-#endif /* USE_TIMER_THREAD */
 	DESTROYLOCK(&manager->lock);
-	isc_heap_destroy(&manager->heap);
 	manager->common.impmagic = 0;
 	manager->common.magic = 0;
 	mctx = manager->mctx;
+	isc_mem_put(mctx, manager->shards,
+		    manager->nshards * sizeof(isc__timershard_t));
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	isc_mem_detach(&mctx);
 
@@ -1025,14 +1268,22 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 isc_result_t
 isc__timermgr_nextevent(isc_timermgr_t *manager0, isc_time_t *when) {
 	isc__timermgr_t *manager = (isc__timermgr_t *)manager0;
+	uint64_t next = TICK_NEVER;
+	unsigned int i;
 
 #ifdef USE_SHARED_MANAGER
 	if (manager == NULL)
 		manager = timermgr;
 #endif
-	if (manager == NULL || manager->nscheduled == 0)
+	if (manager == NULL)
+		return (ISC_R_NOTFOUND);
+	for (i = 0; i < manager->nshards; i++) {
+		if (manager->shards[i].next < next)
+			next = manager->shards[i].next;
+	}
+	if (next == TICK_NEVER)
 		return (ISC_R_NOTFOUND);
-	*when = manager->due;
+	tick_totime(next, when);
 	return (ISC_R_SUCCESS);
 }
 
@@ -1040,6 +1291,7 @@ void
 isc__timermgr_dispatch(isc_timermgr_t *manager0) {
 	isc__timermgr_t *manager = (isc__timermgr_t *)manager0;
 	isc_time_t now;
+	unsigned int i;
 
 #ifdef USE_SHARED_MANAGER
 	if (manager == NULL)
@@ -1048,7 +1300,11 @@ isc__timermgr_dispatch(isc_timermgr_t *manager0) {
 	if (manager == NULL)
 		return;
 	TIME_NOW(&now);
-	dispatch(manager, &now);
+	for (i = 0; i < manager->nshards; i++) {
+		LOCK(&manager->shards[i].lock);
+		dispatch(&manager->shards[i], &now);
+		UNLOCK(&manager->shards[i].lock);
+	}
 }
 #endif /* USE_TIMER_THREAD */
 
@@ -356,8 +356,22 @@ typedef isc_event_t intev_t;
  */
 #define NRETRIES 10
 
+/*%
+ * Where available, UDP sockets with several queued requests receive and
+ * send up to MAXBATCH datagrams per recvmmsg()/sendmmsg() call instead of
+ * one per recvmsg()/sendmsg() call.
+ */
+#if defined(HAVE_RECVMMSG) && defined(ISC_NET_BSD44MSGHDR)
+#define USE_RECVMMSG 1
+#endif
+#if defined(HAVE_SENDMMSG) && defined(ISC_NET_BSD44MSGHDR)
+#define USE_SENDMMSG 1
+#endif
+#define MAXBATCH 32
+
 typedef struct isc__socket isc__socket_t;
 typedef struct isc__socketmgr isc__socketmgr_t;
+typedef struct isc__socketthread isc__socketthread_t;
 
 #define NEWCONNSOCK(ev) ((isc__socket_t *)(ev)->newsocket)
 
@@ -377,6 +391,13 @@ struct isc__socket {
 	char				name[16];
 	void *				tag;
 
+	/*
+	 * Completed receive and send requests (datagrams for UDP),
+	 * reported per socket by the statistics channel.
+	 */
+	uint64_t		recvcount;
+	uint64_t		sendcount;
+
 	ISC_LIST(isc_socketevent_t)		send_list;
 	ISC_LIST(isc_socketevent_t)		recv_list;
 	ISC_LIST(isc_socket_newconnev_t)	accept_list;
@@ -425,13 +446,22 @@ struct isc__socket {
 #define SOCKET_MANAGER_MAGIC	ISC_MAGIC('I', 'O', 'm', 'g')
 #define VALID_MANAGER(m)	ISC_MAGIC_VALID(m, SOCKET_MANAGER_MAGIC)
 
-struct isc__socketmgr {
-	/* Not locked. */
-	isc_socketmgr_t		common;
-	isc_mem_t	       *mctx;
-	isc_mutex_t		lock;
-	isc_mutex_t		*fdlock;
-	isc_stats_t		*stats;
+/*%
+ * Each socket thread runs its own event loop with its own kernel
+ * polling descriptor and control pipe.  A socket is owned by exactly
+ * one thread for its whole lifetime, selected by FDTHREAD(); all
+ * watch/unwatch requests and readiness notifications for the socket's
+ * descriptor go through that thread only.
+ */
+struct isc__socketthread {
+	isc__socketmgr_t	*manager;
+	int			threadid;
+#ifdef USE_WATCHER_THREAD
+	isc_thread_t		thread;
+#endif
+#ifdef ISC_PLATFORM_USETHREADS
+	int			pipe_fds[2];
+#endif
 #ifdef USE_KQUEUE
 	int			kqueue_fd;
 	int			nevents;
@@ -449,13 +479,23 @@ struct isc__socketmgr {
 	int			nevents;
 	struct pollfd		*events;
 #endif	/* USE_DEVPOLL */
+};
+
+#define FDTHREAD(m, fd)		(&(m)->threads[(fd) % (m)->nthreads])
+
+struct isc__socketmgr {
+	/* Not locked. */
+	isc_socketmgr_t		common;
+	isc_mem_t	       *mctx;
+	isc_mutex_t		lock;
+	isc_mutex_t		*fdlock;
+	isc_stats_t		*stats;
+	int			nthreads;
+	isc__socketthread_t	*threads;
 #ifdef USE_SELECT
 	int			fd_bufsize;
 #endif	/* USE_SELECT */
 	unsigned int		maxsocks;
-#ifdef ISC_PLATFORM_USETHREADS
-	int			pipe_fds[2];
-#endif
 
 	/* Locked by fdlock. */
 	isc__socket_t	       **fds;
@@ -478,7 +518,6 @@ struct isc__socketmgr {
 #endif	/* USE_SELECT */
 	int			reserved;	/* unlocked */
 #ifdef USE_WATCHER_THREAD
-	isc_thread_t		watcher;
 	isc_condition_t		shutdown_ok;
 #else /* USE_WATCHER_THREAD */
 	unsigned int		refs;
@@ -527,7 +566,7 @@ static void build_msghdr_send(isc__socket_t *, char *, isc_socketevent_t *,
 static void build_msghdr_recv(isc__socket_t *, char *, isc_socketevent_t *,
 			      struct msghdr *, struct iovec *, size_t *);
 #ifdef USE_WATCHER_THREAD
-static bool process_ctlfd(isc__socketmgr_t *manager);
+static bool process_ctlfd(isc__socketthread_t *thread);
 #endif
 static void setdscp(isc__socket_t *sock, isc_dscp_t dscp);
 
@@ -639,6 +678,9 @@ isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks);
 isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, unsigned int nthreads);
+isc_result_t
 isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager0, unsigned int *nsockp);
 void
 isc_socketmgr_setstats(isc_socketmgr_t *manager0, isc_stats_t *stats);
@@ -935,7 +977,8 @@ dec_stats(isc_stats_t *stats, isc_statscounter_t counterid) {
 }
 
 static inline isc_result_t
-watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+watch_fd(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -948,7 +991,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_ADD;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -969,7 +1012,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (oldevents == 0U) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1) {
 		if (errno == EEXIST)
 			UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -991,7 +1034,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	pfd.fd = fd;
 	pfd.revents = 0;
 	LOCK(&manager->fdlock[lockid]);
-	if (write(manager->devpoll_fd, &pfd, sizeof(pfd)) == -1)
+	if (write(thread->devpoll_fd, &pfd, sizeof(pfd)) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -1015,7 +1058,8 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static inline isc_result_t
-unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+unwatch_fd(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -1028,7 +1072,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_DELETE;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -1047,7 +1091,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (event.events == 0U) ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1 && errno != ENOENT) {
 		char strbuf[ISC_STRERRORSIZE];
 		isc__strerror(errno, strbuf, sizeof(strbuf));
@@ -1084,7 +1128,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		writelen += sizeof(pfds[1]);
 	}
 
-	if (write(manager->devpoll_fd, pfds, writelen) == -1)
+	if (write(thread->devpoll_fd, pfds, writelen) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -1108,7 +1152,8 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static void
-wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
+wakeup_socket(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result;
 	int lockid = FDLOCK_ID(fd);
 
@@ -1124,8 +1169,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		/* No one should be updating fdstate, so no need to lock it */
 		INSIST(manager->fdstate[fd] == CLOSE_PENDING);
 		manager->fdstate[fd] = CLOSED;
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		(void)close(fd);
 		return;
 	}
@@ -1142,8 +1187,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		 * fdlock; otherwise it could cause deadlock due to a lock order
 		 * reversal.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 	if (manager->fdstate[fd] != MANAGED) {
@@ -1155,7 +1200,7 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 	/*
 	 * Set requested bit.
 	 */
-	result = watch_fd(manager, fd, msg);
+	result = watch_fd(thread, fd, msg);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * XXXJT: what should we do?  Ignoring the failure of watching
@@ -1171,12 +1216,12 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 
 #ifdef USE_WATCHER_THREAD
 /*
- * Poke the select loop when there is something for us to do.
- * The write is required (by POSIX) to complete.  That is, we
+ * Poke a socket thread's select loop when there is something for it
+ * to do.  The write is required (by POSIX) to complete.  That is, we
  * will not get partial writes.
  */
 static void
-select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+select_poke_thread(isc__socketthread_t *thread, int fd, int msg) {
 	int cc;
 	int buf[2];
 	char strbuf[ISC_STRERRORSIZE];
@@ -1185,7 +1230,7 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	buf[1] = msg;
 
 	do {
-		cc = write(mgr->pipe_fds[1], buf, sizeof(buf));
+		cc = write(thread->pipe_fds[1], buf, sizeof(buf));
 #ifdef ENOSR
 		/*
 		 * Treat ENOSR as EAGAIN but loop slowly as it is
@@ -1211,16 +1256,33 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	INSIST(cc == sizeof(buf));
 }
 
+/*
+ * Poke the select loop of the thread owning 'fd'.  A shutdown request
+ * is delivered to every socket thread.
+ */
+static void
+select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+	int i;
+
+	if (msg == SELECT_POKE_SHUTDOWN) {
+		for (i = 0; i < mgr->nthreads; i++)
+			select_poke_thread(&mgr->threads[i], fd, msg);
+		return;
+	}
+
+	select_poke_thread(FDTHREAD(mgr, fd), fd, msg);
+}
+
 /*
  * Read a message on the internal fd.
  */
 static void
-select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
+select_readmsg(isc__socketthread_t *thread, int *fd, int *msg) {
 	int buf[2];
 	int cc;
 	char strbuf[ISC_STRERRORSIZE];
 
-	cc = read(mgr->pipe_fds[0], buf, sizeof(buf));
+	cc = read(thread->pipe_fds[0], buf, sizeof(buf));
 	if (cc < 0) {
 		*msg = SELECT_POKE_NOTHING;
 		*fd = -1;	/* Silence compiler. */
@@ -1249,7 +1311,7 @@ select_poke(isc__socketmgr_t *manager, int fd, int msg) {
 	if (msg == SELECT_POKE_SHUTDOWN)
 		return;
 	else if (fd >= 0)
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(FDTHREAD(manager, fd), fd, msg);
 	return;
 }
 #endif /* USE_WATCHER_THREAD */
@@ -1902,30 +1964,19 @@ dump_msg(struct msghdr *msg) {
 #define DOIO_HARD		2	/* i/o error, event sent */
 #define DOIO_EOF		3	/* EOF, no event sent */
 
+/*
+ * Complete a receive request after recvmsg() or recvmmsg() returned 'cc'
+ * for it ('recv_errno' being the error if 'cc' is negative): update the
+ * event and its buffers and classify the result as for doio_recv().
+ */
 static int
-doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_RECV];
-	size_t read_count;
+complete_recv(isc__socket_t *sock, isc_socketevent_t *dev,
+	      struct msghdr *msghdr, int cc, int recv_errno,
+	      size_t read_count)
+{
 	size_t actual_count;
-	struct msghdr msghdr;
 	isc_buffer_t *buffer;
-	int recv_errno;
 	char strbuf[ISC_STRERRORSIZE];
-	char cmsgbuf[RECVCMSGBUFLEN] = {0};
-
-	build_msghdr_recv(sock, cmsgbuf, dev, &msghdr, iov, &read_count);
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
-	cc = recvmsg(sock->fd, &msghdr, 0);
-	recv_errno = errno;
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
 
 	if (cc < 0) {
 		if (SOFT_ERROR(recv_errno))
@@ -2008,7 +2059,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	}
 
 	if (sock->type == isc_sockettype_udp) {
-		dev->address.length = msghdr.msg_namelen;
+		dev->address.length = msghdr->msg_namelen;
 		if (isc_sockaddr_getport(&dev->address) == 0) {
 			if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
 				socket_log(sock, &dev->address, IOEVENT,
@@ -2049,7 +2100,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	 * If there are control messages attached, run through them and pull
 	 * out the interesting bits.
 	 */
-	process_cmsg(sock, &msghdr, dev);
+	process_cmsg(sock, msghdr, dev);
 
 	/*
 	 * update the buffers (if any) and the i/o count
@@ -2085,10 +2136,106 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	/*
 	 * Full reads are posted, or partials if partials are ok.
 	 */
+	sock->recvcount++;
 	dev->result = ISC_R_SUCCESS;
 	return (DOIO_SUCCESS);
 }
 
+static int
+doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	size_t read_count;
+	struct msghdr msghdr;
+	int recv_errno;
+	char cmsgbuf[RECVCMSGBUFLEN] = {0};
+
+	build_msghdr_recv(sock, cmsgbuf, dev, &msghdr, iov, &read_count);
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	cc = recvmsg(sock->fd, &msghdr, 0);
+	recv_errno = errno;
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	return (complete_recv(sock, dev, &msghdr, cc, recv_errno,
+			      read_count));
+}
+
+#ifdef USE_RECVMMSG
+/*
+ * Receive datagrams for up to MAXBATCH requests queued on the UDP socket
+ * 'sock' with one recvmmsg() call, and post the done events of those that
+ * completed.
+ *
+ * Returns true if the batch was filled and more datagrams may be
+ * waiting, false if the socket has been drained and needs to be watched
+ * again.
+ */
+static bool
+doio_recvmmsg(isc__socket_t *sock) {
+	isc_socketevent_t *devs[MAXBATCH];
+	struct mmsghdr msgs[MAXBATCH];
+	struct iovec iov[MAXBATCH][MAXSCATTERGATHER_RECV];
+	char cmsgbuf[MAXBATCH][RECVCMSGBUFLEN];
+	size_t read_count[MAXBATCH];
+	isc_socketevent_t *dev;
+	unsigned int i, n = 0;
+	int cc;
+
+	dev = ISC_LIST_HEAD(sock->recv_list);
+	while (dev != NULL && n < MAXBATCH) {
+		devs[n] = dev;
+		memset(cmsgbuf[n], 0, sizeof(cmsgbuf[n]));
+		build_msghdr_recv(sock, cmsgbuf[n], dev, &msgs[n].msg_hdr,
+				  iov[n], &read_count[n]);
+		msgs[n].msg_len = 0;
+		n++;
+		dev = ISC_LIST_NEXT(dev, ev_link);
+	}
+
+	cc = recvmmsg(sock->fd, msgs, n, 0, NULL);
+	if (cc < 0) {
+		/*
+		 * Nothing was received; treat the error as if it
+		 * had been returned for the first request alone.
+		 */
+		switch (complete_recv(sock, devs[0], &msgs[0].msg_hdr, -1,
+				      errno, read_count[0]))
+		{
+		case DOIO_SOFT:
+			return (false);
+		default:
+			send_recvdone_event(sock, &devs[0]);
+			return (true);
+		}
+	}
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		switch (complete_recv(sock, devs[i], &msgs[i].msg_hdr,
+				      (int)msgs[i].msg_len, 0, read_count[i]))
+		{
+		case DOIO_SOFT:
+			/*
+			 * The datagram was dropped; the request stays
+			 * queued for the next one.
+			 */
+			break;
+		default:
+			send_recvdone_event(sock, &devs[i]);
+			break;
+		}
+	}
+
+	return ((unsigned int)cc == n);
+}
+#endif /* USE_RECVMMSG */
+
 /*
  * Returns:
  *	DOIO_SUCCESS	The operation succeeded.  dev->result contains
@@ -2102,38 +2249,24 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
  *
  *	No other return values are possible.
  */
+/*
+ * Complete a send request after sendmsg() or sendmmsg() returned 'cc'
+ * for it ('send_errno' being the error if 'cc' is negative): update the
+ * event and classify the result as for doio_send().
+ */
 static int
-doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_SEND];
-	size_t write_count;
-	struct msghdr msghdr;
+complete_send(isc__socket_t *sock, isc_socketevent_t *dev, int cc,
+	      int send_errno, size_t write_count)
+{
 	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
-	int attempts = 0;
-	int send_errno;
 	char strbuf[ISC_STRERRORSIZE];
-	char cmsgbuf[SENDCMSGBUFLEN] = {0};
-
-	build_msghdr_send(sock, cmsgbuf, dev, &msghdr, iov, &write_count);
-
- resend:
-	if (sock->type == isc_sockettype_udp &&
-	    sock->manager->maxudp != 0 &&
-	    write_count > sock->manager->maxudp)
-		cc = write_count;
-	else
-		cc = sendmsg(sock->fd, &msghdr, 0);
-	send_errno = errno;
 
 	/*
 	 * Check for error or block condition.
 	 */
 	if (cc < 0) {
-		if (send_errno == EINTR && ++attempts < NRETRIES)
-			goto resend;
-
 		if (SOFT_ERROR(send_errno)) {
-			if (errno == EWOULDBLOCK || errno == EAGAIN)
+			if (send_errno == EWOULDBLOCK || send_errno == EAGAIN)
 				dev->result = ISC_R_WOULDBLOCK;
 			return (DOIO_SOFT);
 		}
@@ -2212,10 +2345,107 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	 * Exactly what we wanted to write.  We're done with this
 	 * entry.  Post its completion event.
 	 */
+	sock->sendcount++;
 	dev->result = ISC_R_SUCCESS;
 	return (DOIO_SUCCESS);
 }
 
+static int
+doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_SEND];
+	size_t write_count;
+	struct msghdr msghdr;
+	int attempts = 0;
+	int send_errno;
+	char cmsgbuf[SENDCMSGBUFLEN] = {0};
+
+	build_msghdr_send(sock, cmsgbuf, dev, &msghdr, iov, &write_count);
+
+ resend:
+	if (sock->type == isc_sockettype_udp &&
+	    sock->manager->maxudp != 0 &&
+	    write_count > sock->manager->maxudp)
+		cc = write_count;
+	else
+		cc = sendmsg(sock->fd, &msghdr, 0);
+	send_errno = errno;
+
+	if (cc < 0 && send_errno == EINTR && ++attempts < NRETRIES)
+		goto resend;
+
+	return (complete_send(sock, dev, cc, send_errno, write_count));
+}
+
+#ifdef USE_SENDMMSG
+/*
+ * Send the datagrams of up to MAXBATCH requests queued on the UDP socket
+ * 'sock' with one sendmmsg() call, and post the done events of those that
+ * completed.
+ *
+ * Returns true if the whole batch was sent, false if the socket would
+ * block and needs to be watched again.
+ */
+static bool
+doio_sendmmsg(isc__socket_t *sock) {
+	isc_socketevent_t *devs[MAXBATCH];
+	struct mmsghdr msgs[MAXBATCH];
+	struct iovec iov[MAXBATCH][MAXSCATTERGATHER_SEND];
+	char cmsgbuf[MAXBATCH][SENDCMSGBUFLEN];
+	size_t write_count[MAXBATCH];
+	isc_socketevent_t *dev;
+	unsigned int i, n = 0;
+	int attempts = 0;
+	int cc;
+
+	dev = ISC_LIST_HEAD(sock->send_list);
+	while (dev != NULL && n < MAXBATCH) {
+		devs[n] = dev;
+		memset(cmsgbuf[n], 0, sizeof(cmsgbuf[n]));
+		build_msghdr_send(sock, cmsgbuf[n], dev, &msgs[n].msg_hdr,
+				  iov[n], &write_count[n]);
+		msgs[n].msg_len = 0;
+		n++;
+		dev = ISC_LIST_NEXT(dev, ev_link);
+	}
+
+ resend:
+	cc = sendmmsg(sock->fd, msgs, n, 0);
+	if (cc < 0) {
+		if (errno == EINTR && ++attempts < NRETRIES)
+			goto resend;
+
+		/*
+		 * Nothing was sent; treat the error as if it had been
+		 * returned for the first request alone.
+		 */
+		switch (complete_send(sock, devs[0], -1, errno,
+				      write_count[0]))
+		{
+		case DOIO_SOFT:
+			return (false);
+		default:
+			send_senddone_event(sock, &devs[0]);
+			return (true);
+		}
+	}
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		switch (complete_send(sock, devs[i], (int)msgs[i].msg_len, 0,
+				      write_count[i]))
+		{
+		case DOIO_SOFT:
+			return (false);
+		default:
+			send_senddone_event(sock, &devs[i]);
+			break;
+		}
+	}
+
+	return ((unsigned int)cc == n);
+}
+#endif /* USE_SENDMMSG */
+
 /*
  * Kill.
  *
@@ -2248,8 +2478,8 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 		 * solve this would be to dup() the watched descriptor, but we
 		 * take a simpler approach at this moment.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd, SELECT_POKE_READ);
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd, SELECT_POKE_WRITE);
 	} else
 		select_poke(manager, fd, SELECT_POKE_CLOSE);
 
@@ -2281,8 +2511,8 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 			UNLOCK(&manager->fdlock[lockid]);
 		}
 #ifdef ISC_PLATFORM_USETHREADS
-		if (manager->maxfd < manager->pipe_fds[0])
-			manager->maxfd = manager->pipe_fds[0];
+		if (manager->maxfd < manager->threads[0].pipe_fds[0])
+			manager->maxfd = manager->threads[0].pipe_fds[0];
 #endif
 	}
 
@@ -2347,6 +2577,8 @@ allocate_socket(isc__socketmgr_t *manager, isc_sockettype_t type,
 	sock->fd = -1;
 	sock->dscp = 0;		/* TOS/TCLASS is zero until set. */
 	sock->dupped = 0;
+	sock->recvcount = 0;
+	sock->sendcount = 0;
 	sock->statsindex = NULL;
 	sock->active = 0;
 
@@ -3817,6 +4049,15 @@ internal_recv(isc_task_t *me, isc_event_t *ev) {
 	 * limits here, currently.
 	 */
 	dev = ISC_LIST_HEAD(sock->recv_list);
+#ifdef USE_RECVMMSG
+	if (sock->type == isc_sockettype_udp) {
+		while (dev != NULL && ISC_LIST_NEXT(dev, ev_link) != NULL) {
+			if (!doio_recvmmsg(sock))
+				goto poke;
+			dev = ISC_LIST_HEAD(sock->recv_list);
+		}
+	}
+#endif
 	while (dev != NULL) {
 		switch (doio_recv(sock, dev)) {
 		case DOIO_SOFT:
@@ -3892,6 +4133,15 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 	 * limits here, currently.
 	 */
 	dev = ISC_LIST_HEAD(sock->send_list);
+#ifdef USE_SENDMMSG
+	if (sock->type == isc_sockettype_udp && sock->manager->maxudp == 0) {
+		while (dev != NULL && ISC_LIST_NEXT(dev, ev_link) != NULL) {
+			if (!doio_sendmmsg(sock))
+				goto poke;
+			dev = ISC_LIST_HEAD(sock->send_list);
+		}
+	}
+#endif
 	while (dev != NULL) {
 		switch (doio_send(sock, dev)) {
 		case DOIO_SOFT:
@@ -4000,9 +4250,10 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
  * and unlocking twice if both reads and writes are possible.
  */
 static void
-process_fd(isc__socketmgr_t *manager, int fd, bool readable,
+process_fd(isc__socketthread_t *thread, int fd, bool readable,
 	   bool writeable)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	isc__socket_t *sock;
 	bool unlock_sock;
 	bool unwatch_read = false, unwatch_write = false;
@@ -4015,8 +4266,8 @@ process_fd(isc__socketmgr_t *manager, int fd, bool readable,
 	if (manager->fdstate[fd] == CLOSE_PENDING) {
 		UNLOCK(&manager->fdlock[lockid]);
 
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 
@@ -4061,15 +4312,16 @@ check_write:
  unlock_fd:
 	UNLOCK(&manager->fdlock[lockid]);
 	if (unwatch_read)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
 	if (unwatch_write)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 
 }
 
 #ifdef USE_KQUEUE
 static bool
-process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct kevent *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	bool readable, writable;
 	bool done = false;
@@ -4077,7 +4329,7 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	bool have_ctlevent = false;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		/*
 		 * This is not an error, but something unexpected.  If this
 		 * happens, it may indicate the need for increasing
@@ -4092,34 +4344,36 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].ident < manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].ident == (uintptr_t)manager->pipe_fds[0]) {
+		if (events[i].ident == (uintptr_t)thread->pipe_fds[0]) {
 			have_ctlevent = true;
 			continue;
 		}
 #endif
 		readable = (events[i].filter == EVFILT_READ);
 		writable = (events[i].filter == EVFILT_WRITE);
-		process_fd(manager, events[i].ident, readable, writable);
+		process_fd(thread, events[i].ident, readable, writable);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_EPOLL)
 static bool
-process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
+process_fds(isc__socketthread_t *thread, struct epoll_event *events,
+	    int nevents)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	bool done = false;
 #ifdef USE_WATCHER_THREAD
 	bool have_ctlevent = false;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -4129,7 +4383,7 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].data.fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].data.fd == manager->pipe_fds[0]) {
+		if (events[i].data.fd == thread->pipe_fds[0]) {
 			have_ctlevent = true;
 			continue;
 		}
@@ -4146,28 +4400,29 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 			int fd = events[i].data.fd;
 			events[i].events |= manager->epoll_events[fd];
 		}
-		process_fd(manager, events[i].data.fd,
+		process_fd(thread, events[i].data.fd,
 			   (events[i].events & EPOLLIN) != 0,
 			   (events[i].events & EPOLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_DEVPOLL)
 static bool
-process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct pollfd *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	bool done = false;
 #ifdef USE_WATCHER_THREAD
 	bool have_ctlevent = false;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -4177,38 +4432,39 @@ process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].fd == manager->pipe_fds[0]) {
+		if (events[i].fd == thread->pipe_fds[0]) {
 			have_ctlevent = true;
 			continue;
 		}
 #endif
-		process_fd(manager, events[i].fd,
+		process_fd(thread, events[i].fd,
 			   (events[i].events & POLLIN) != 0,
 			   (events[i].events & POLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_SELECT)
 static void
-process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
+process_fds(isc__socketthread_t *thread, int maxfd, fd_set *readfds,
 	    fd_set *writefds)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 
 	REQUIRE(maxfd <= (int)manager->maxsocks);
 
 	for (i = 0; i < maxfd; i++) {
 #ifdef USE_WATCHER_THREAD
-		if (i == manager->pipe_fds[0] || i == manager->pipe_fds[1])
+		if (i == thread->pipe_fds[0] || i == thread->pipe_fds[1])
 			continue;
 #endif /* USE_WATCHER_THREAD */
-		process_fd(manager, i, FD_ISSET(i, readfds),
+		process_fd(thread, i, FD_ISSET(i, readfds),
 			   FD_ISSET(i, writefds));
 	}
 }
@@ -4216,11 +4472,12 @@ process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
 
 #ifdef USE_WATCHER_THREAD
 static bool
-process_ctlfd(isc__socketmgr_t *manager) {
+process_ctlfd(isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
 	int msg, fd;
 
 	for (;;) {
-		select_readmsg(manager, &fd, &msg);
+		select_readmsg(thread, &fd, &msg);
 
 		manager_log(manager, IOEVENT,
 			    isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
@@ -4249,7 +4506,7 @@ process_ctlfd(isc__socketmgr_t *manager) {
 		 * and decide if we need to watch on it now
 		 * or not.
 		 */
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(thread, fd, msg);
 	}
 
 	return (false);
@@ -4264,7 +4521,8 @@ process_ctlfd(isc__socketmgr_t *manager) {
  */
 static isc_threadresult_t
 watcher(void *uap) {
-	isc__socketmgr_t *manager = uap;
+	isc__socketthread_t *thread = uap;
+	isc__socketmgr_t *manager = thread->manager;
 	bool done;
 	int cc;
 #ifdef USE_KQUEUE
@@ -4290,34 +4548,34 @@ watcher(void *uap) {
 	/*
 	 * Get the control fd here.  This will never change.
 	 */
-	ctlfd = manager->pipe_fds[0];
+	ctlfd = thread->pipe_fds[0];
 #endif
 	done = false;
 	while (!done) {
 		do {
 #ifdef USE_KQUEUE
-			cc = kevent(manager->kqueue_fd, NULL, 0,
-				    manager->events, manager->nevents, NULL);
+			cc = kevent(thread->kqueue_fd, NULL, 0,
+				    thread->events, thread->nevents, NULL);
 #elif defined(USE_EPOLL)
-			cc = epoll_wait(manager->epoll_fd, manager->events,
-					manager->nevents, -1);
+			cc = epoll_wait(thread->epoll_fd, thread->events,
+					thread->nevents, -1);
 #elif defined(USE_DEVPOLL)
 			/*
 			 * Re-probe every thousand calls.
 			 */
-			if (manager->calls++ > 1000U) {
+			if (thread->calls++ > 1000U) {
 				result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 				if (result != ISC_R_SUCCESS)
-					manager->open_max = 64;
-				manager->calls = 0;
+					thread->open_max = 64;
+				thread->calls = 0;
 			}
 			for (pass = 0; pass < 2; pass++) {
-				dvp.dp_fds = manager->events;
-				dvp.dp_nfds = manager->nevents;
-				if (dvp.dp_nfds >= manager->open_max)
-					dvp.dp_nfds = manager->open_max - 1;
+				dvp.dp_fds = thread->events;
+				dvp.dp_nfds = thread->nevents;
+				if (dvp.dp_nfds >= thread->open_max)
+					dvp.dp_nfds = thread->open_max - 1;
 #ifndef ISC_SOCKET_USE_POLLWATCH
 				dvp.dp_timeout = -1;
 #else
@@ -4327,7 +4585,7 @@ watcher(void *uap) {
 					dvp.dp_timeout =
 						 ISC_SOCKET_POLLWATCH_TIMEOUT;
 #endif	/* ISC_SOCKET_USE_POLLWATCH */
-				cc = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+				cc = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 				if (cc == -1 && errno == EINVAL) {
 					/*
 					 * {OPEN_MAX} may have dropped.  Look
@@ -4335,9 +4593,9 @@ watcher(void *uap) {
 					 */
 					result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 					if (result != ISC_R_SUCCESS)
-						manager->open_max = 64;
+						thread->open_max = 64;
 				} else
 					break;
 			}
@@ -4392,16 +4650,16 @@ watcher(void *uap) {
 		} while (cc < 0);
 
 #if defined(USE_KQUEUE) || defined (USE_EPOLL) || defined (USE_DEVPOLL)
-		done = process_fds(manager, manager->events, cc);
+		done = process_fds(thread, thread->events, cc);
 #elif defined(USE_SELECT)
-		process_fds(manager, maxfd, manager->read_fds_copy,
+		process_fds(thread, maxfd, manager->read_fds_copy,
 			    manager->write_fds_copy);
 
 		/*
 		 * Process reads on internal, control fd.
 		 */
 		if (FD_ISSET(ctlfd, manager->read_fds_copy))
-			done = process_ctlfd(manager);
+			done = process_ctlfd(thread);
 #endif
 	}
 
@@ -4436,20 +4694,44 @@ isc__socketmgr_maxudp(isc_socketmgr_t *manager0, unsigned int maxudp) {
  */
 
 static isc_result_t
-setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+setup_thread(isc_mem_t *mctx, isc__socketthread_t *thread) {
 	isc_result_t result;
-#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL) || \
+    defined(USE_WATCHER_THREAD)
 	char strbuf[ISC_STRERRORSIZE];
 #endif
 
+#ifdef USE_WATCHER_THREAD
+	/*
+	 * Create the special fds that will be used to wake up the
+	 * select/poll loop when something internal needs to be done.
+	 */
+	if (pipe(thread->pipe_fds) != 0) {
+		isc__strerror(errno, strbuf, sizeof(strbuf));
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "pipe() %s: %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"),
+				 strbuf);
+		return (ISC_R_UNEXPECTED);
+	}
+
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[0]) == ISC_R_SUCCESS);
+#if 0
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[1]) == ISC_R_SUCCESS);
+#endif
+#endif	/* USE_WATCHER_THREAD */
+
 #ifdef USE_KQUEUE
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->kqueue_fd = kqueue();
-	if (manager->kqueue_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct kevent) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
+	}
+	thread->kqueue_fd = kqueue();
+	if (thread->kqueue_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4457,28 +4739,30 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
+		goto close_pipe;
 	}
 
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->kqueue_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		close(thread->kqueue_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
+		goto close_pipe;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_EPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->epoll_fd = epoll_create(manager->nevents);
-	if (manager->epoll_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
+	}
+	thread->epoll_fd = epoll_create(thread->nevents);
+	if (thread->epoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4486,44 +4770,34 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
+		goto close_pipe;
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->epoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		close(thread->epoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
+		goto close_pipe;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_DEVPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
 	result = isc_resource_getcurlimit(isc_resource_openfiles,
-					  &manager->open_max);
+					  &thread->open_max);
 	if (result != ISC_R_SUCCESS)
-		manager->open_max = 64;
-	manager->calls = 0;
-	manager->events = isc_mem_get(mctx, sizeof(struct pollfd) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	/*
-	 * Note: fdpollinfo should be able to support all possible FDs, so
-	 * it must have maxsocks entries (not nevents).
-	 */
-	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
-					  manager->maxsocks);
-	if (manager->fdpollinfo == NULL) {
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		return (ISC_R_NOMEMORY);
+		thread->open_max = 64;
+	thread->calls = 0;
+	thread->events = isc_mem_get(mctx, sizeof(struct pollfd) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
 	}
-	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
-	manager->devpoll_fd = open("/dev/poll", O_RDWR);
-	if (manager->devpoll_fd == -1) {
+	thread->devpoll_fd = open("/dev/poll", O_RDWR);
+	if (thread->devpoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4531,26 +4805,93 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		goto close_pipe;
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->devpoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		close(thread->devpoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		goto close_pipe;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_SELECT)
-	UNUSED(result);
+	UNUSED(mctx);
+
+#ifdef USE_WATCHER_THREAD
+	(void)watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	thread->manager->maxfd = thread->pipe_fds[0];
+#endif /* USE_WATCHER_THREAD */
+	result = ISC_R_SUCCESS;
+#endif	/* USE_KQUEUE */
+
+	return (ISC_R_SUCCESS);
+
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+ close_pipe:
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif	/* USE_WATCHER_THREAD */
+	return (result);
+#endif
+}
 
+static void
+cleanup_thread(isc_mem_t *mctx, isc__socketthread_t *thread) {
+#ifdef USE_WATCHER_THREAD
+	isc_result_t result;
+
+	result = unwatch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "epoll_ctl(DEL) %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+	}
+#endif	/* USE_WATCHER_THREAD */
+
+#ifdef USE_KQUEUE
+	close(thread->kqueue_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct kevent) * thread->nevents);
+#elif defined(USE_EPOLL)
+	close(thread->epoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct epoll_event) * thread->nevents);
+#elif defined(USE_DEVPOLL)
+	close(thread->devpoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct pollfd) * thread->nevents);
+#elif defined(USE_SELECT)
+	UNUSED(mctx);
+#endif	/* USE_KQUEUE */
+
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif	/* USE_WATCHER_THREAD */
+}
+
+static isc_result_t
+setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+	isc_result_t result;
+	int i;
+
+#ifdef USE_DEVPOLL
+	/*
+	 * Note: fdpollinfo should be able to support all possible FDs, so
+	 * it must have maxsocks entries (not nevents).
+	 */
+	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
+					  manager->maxsocks);
+	if (manager->fdpollinfo == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
+#elif defined(USE_SELECT)
 #if ISC_SOCKET_MAXSOCKETS > FD_SETSIZE
 	/*
 	 * Note: this code should also cover the case of MAXSOCKETS <=
@@ -4594,44 +4935,41 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 	}
 	memset(manager->read_fds, 0, manager->fd_bufsize);
 	memset(manager->write_fds, 0, manager->fd_bufsize);
-
-#ifdef USE_WATCHER_THREAD
-	(void)watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	manager->maxfd = manager->pipe_fds[0];
-#else /* USE_WATCHER_THREAD */
 	manager->maxfd = 0;
-#endif /* USE_WATCHER_THREAD */
-#endif	/* USE_KQUEUE */
+#endif	/* USE_DEVPOLL */
+
+	for (i = 0; i < manager->nthreads; i++) {
+		result = setup_thread(mctx, &manager->threads[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (--i >= 0)
+				cleanup_thread(mctx, &manager->threads[i]);
+			goto cleanup;
+		}
+	}
 
 	return (ISC_R_SUCCESS);
+
+ cleanup:
+#ifdef USE_DEVPOLL
+	isc_mem_put(mctx, manager->fdpollinfo,
+		    sizeof(pollinfo_t) * manager->maxsocks);
+#elif defined(USE_SELECT)
+	isc_mem_put(mctx, manager->read_fds, manager->fd_bufsize);
+	isc_mem_put(mctx, manager->read_fds_copy, manager->fd_bufsize);
+	isc_mem_put(mctx, manager->write_fds, manager->fd_bufsize);
+	isc_mem_put(mctx, manager->write_fds_copy, manager->fd_bufsize);
+#endif	/* USE_DEVPOLL */
+	return (result);
 }
 
 static void
 cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
-#ifdef USE_WATCHER_THREAD
-	isc_result_t result;
+	int i;
 
-	result = unwatch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	if (result != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "epoll_ctl(DEL) %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-	}
-#endif	/* USE_WATCHER_THREAD */
+	for (i = 0; i < manager->nthreads; i++)
+		cleanup_thread(mctx, &manager->threads[i]);
 
-#ifdef USE_KQUEUE
-	close(manager->kqueue_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct kevent) * manager->nevents);
-#elif defined(USE_EPOLL)
-	close(manager->epoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct epoll_event) * manager->nevents);
-#elif defined(USE_DEVPOLL)
-	close(manager->devpoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct pollfd) * manager->nevents);
+#ifdef USE_DEVPOLL
 	isc_mem_put(mctx, manager->fdpollinfo,
 		    sizeof(pollinfo_t) * manager->maxsocks);
 #elif defined(USE_SELECT)
@@ -4643,23 +4981,54 @@ cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 		isc_mem_put(mctx, manager->write_fds, manager->fd_bufsize);
 	if (manager->write_fds_copy != NULL)
 		isc_mem_put(mctx, manager->write_fds_copy, manager->fd_bufsize);
-#endif	/* USE_KQUEUE */
+#endif	/* USE_DEVPOLL */
 }
 
+#ifdef USE_WATCHER_THREAD
+/*
+ * Stop and join the first 'nthreads' socket threads.
+ */
+static void
+stop_threads(isc__socketmgr_t *manager, int nthreads) {
+	int i;
+
+	for (i = 0; i < nthreads; i++)
+		select_poke_thread(&manager->threads[i], 0,
+				   SELECT_POKE_SHUTDOWN);
+
+	for (i = 0; i < nthreads; i++) {
+		if (isc_thread_join(manager->threads[i].thread, NULL) !=
+		    ISC_R_SUCCESS)
+		{
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+		}
+	}
+}
+#endif /* USE_WATCHER_THREAD */
+
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc__socketmgr_create2(mctx, managerp, 0));
+	return (isc__socketmgr_create3(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks)
+{
+	return (isc__socketmgr_create3(mctx, managerp, maxsocks, 1));
+}
+
+isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, unsigned int nthreads)
 {
 	int i;
 	isc__socketmgr_t *manager;
-#ifdef USE_WATCHER_THREAD
-	char strbuf[ISC_STRERRORSIZE];
-#endif
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
@@ -4679,6 +5048,18 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	if (maxsocks == 0)
 		maxsocks = ISC_SOCKET_MAXSOCKETS;
 
+	/*
+	 * select() shares a single set of descriptor masks, and without
+	 * threads there is only the caller's event loop, so both are
+	 * limited to one socket thread.
+	 */
+#if defined(USE_WATCHER_THREAD) && !defined(USE_SELECT)
+	if (nthreads == 0)
+		nthreads = 1;
+#else
+	nthreads = 1;
+#endif
+
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
 		return (ISC_R_NOMEMORY);
@@ -4688,6 +5069,19 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	manager->maxsocks = maxsocks;
 	manager->reserved = 0;
 	manager->maxudp = 0;
+	manager->nthreads = nthreads;
+	manager->threads = isc_mem_get(mctx, manager->nthreads *
+				       sizeof(isc__socketthread_t));
+	if (manager->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_manager;
+	}
+	memset(manager->threads, 0,
+	       manager->nthreads * sizeof(isc__socketthread_t));
+	for (i = 0; i < manager->nthreads; i++) {
+		manager->threads[i].manager = manager;
+		manager->threads[i].threadid = i;
+	}
 	manager->fds = isc_mem_get(mctx,
 				   manager->maxsocks * sizeof(isc__socket_t *));
 	if (manager->fds == NULL) {
@@ -4745,26 +5139,6 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_lock;
 	}
-
-	/*
-	 * Create the special fds that will be used to wake up the
-	 * select/poll loop when something internal needs to be done.
-	 */
-	if (pipe(manager->pipe_fds) != 0) {
-		isc__strerror(errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "pipe() %s: %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"),
-				 strbuf);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_condition;
-	}
-
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[0]) == ISC_R_SUCCESS);
-#if 0
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[1]) == ISC_R_SUCCESS);
-#endif
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_SHARED_MANAGER
@@ -4772,7 +5146,7 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 #endif /* USE_SHARED_MANAGER */
 
 	/*
-	 * Set up initial state for the select loop
+	 * Set up initial state for the select loops
 	 */
 	result = setup_watcher(mctx, manager);
 	if (result != ISC_R_SUCCESS)
@@ -4782,19 +5156,30 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Start up the select/poll thread.
+	 * Start up the select/poll threads.
 	 */
-	if (isc_thread_create(watcher, manager, &manager->watcher) !=
-	    ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		cleanup_watcher(mctx, manager);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup;
+	for (i = 0; i < manager->nthreads; i++) {
+		char name[16];	/* thread name limit on Linux, with NUL */
+
+		if (isc_thread_create(watcher, &manager->threads[i],
+				      &manager->threads[i].thread) !=
+		    ISC_R_SUCCESS)
+		{
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			stop_threads(manager, i);
+			cleanup_watcher(mctx, manager);
+			result = ISC_R_UNEXPECTED;
+			goto cleanup;
+		}
+		snprintf(name, sizeof(name), "isc-socket%04u",
+			 (unsigned)i % 10000);
+		isc_thread_setname(manager->threads[i].thread, name);
 	}
-	isc_thread_setname(manager->watcher, "isc-socket");
 #endif /* USE_WATCHER_THREAD */
 	isc_mem_attach(mctx, &manager->mctx);
 
@@ -4807,12 +5192,6 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 cleanup:
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
-#endif	/* USE_WATCHER_THREAD */
-
-#ifdef USE_WATCHER_THREAD
-cleanup_condition:
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif	/* USE_WATCHER_THREAD */
 
@@ -4843,6 +5222,10 @@ free_manager:
 		isc_mem_put(mctx, manager->fds,
 			    manager->maxsocks * sizeof(isc_socket_t *));
 	}
+	if (manager->threads != NULL) {
+		isc_mem_put(mctx, manager->threads,
+			    manager->nthreads * sizeof(isc__socketthread_t));
+	}
 	isc_mem_put(mctx, manager, sizeof(*manager));
 
 	return (result);
@@ -4915,22 +5298,11 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 
 	UNLOCK(&manager->lock);
 
-	/*
-	 * Here, poke our select/poll thread.  Do this by closing the write
-	 * half of the pipe, which will send EOF to the read half.
-	 * This is currently a no-op in the non-threaded case.
-	 */
-	select_poke(manager, 0, SELECT_POKE_SHUTDOWN);
-
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Wait for thread to exit.
+	 * Here, poke our select/poll threads and wait for them to exit.
 	 */
-	if (isc_thread_join(manager->watcher, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	stop_threads(manager, manager->nthreads);
 #endif /* USE_WATCHER_THREAD */
 
 	/*
@@ -4939,8 +5311,6 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 	cleanup_watcher(manager->mctx, manager);
 
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif /* USE_WATCHER_THREAD */
 
@@ -4956,6 +5326,8 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 		    manager->maxsocks * sizeof(isc__socket_t *));
 	isc_mem_put(manager->mctx, manager->fdstate,
 		    manager->maxsocks * sizeof(int));
+	isc_mem_put(manager->mctx, manager->threads,
+		    manager->nthreads * sizeof(isc__socketthread_t));
 
 	if (manager->stats != NULL)
 		isc_stats_detach(&manager->stats);
@@ -5602,6 +5974,29 @@ isc__socket_bind(isc_socket_t *sock0, isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+#ifdef SO_REUSEPORT
+		if (setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT,
+			       (void *)&on, sizeof(on)) < 0)
+		{
+			/*
+			 * The option exists at build time but the kernel
+			 * may not support it; let the caller fall back to
+			 * a single socket.
+			 */
+			isc__strerror(errno, strbuf, sizeof(strbuf));
+			socket_log(sock, sockaddr, CREATION, isc_msgcat,
+				   ISC_MSGSET_GENERAL, ISC_MSG_FAILED,
+				   "setsockopt(%d, SO_REUSEPORT) failed: %s",
+				   sock->fd, strbuf);
+			UNLOCK(&sock->lock);
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+#else
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	}
 #ifdef AF_UNIX
  bind_socket:
 #endif
@@ -6512,6 +6907,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			  isc_socketwait_t **swaitp)
 {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 	int n;
 #ifdef USE_KQUEUE
 	struct timespec ts, *tsp;
@@ -6533,6 +6929,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 #endif
 	if (manager == NULL)
 		return (0);
+	thread = &manager->threads[0];
 
 #ifdef USE_KQUEUE
 	if (tvp != NULL) {
@@ -6541,8 +6938,8 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		tsp = &ts;
 	} else
 		tsp = NULL;
-	swait_private.nevents = kevent(manager->kqueue_fd, NULL, 0,
-				       manager->events, manager->nevents,
+	swait_private.nevents = kevent(thread->kqueue_fd, NULL, 0,
+				       thread->events, thread->nevents,
 				       tsp);
 	n = swait_private.nevents;
 #elif defined(USE_EPOLL)
@@ -6550,32 +6947,32 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		timeout = tvp->tv_sec * 1000 + (tvp->tv_usec + 999) / 1000;
 	else
 		timeout = -1;
-	swait_private.nevents = epoll_wait(manager->epoll_fd,
-					   manager->events,
-					   manager->nevents, timeout);
+	swait_private.nevents = epoll_wait(thread->epoll_fd,
+					   thread->events,
+					   thread->nevents, timeout);
 	n = swait_private.nevents;
 #elif defined(USE_DEVPOLL)
 	/*
 	 * Re-probe every thousand calls.
 	 */
-	if (manager->calls++ > 1000U) {
+	if (thread->calls++ > 1000U) {
 		result = isc_resource_getcurlimit(isc_resource_openfiles,
-						  &manager->open_max);
+						  &thread->open_max);
 		if (result != ISC_R_SUCCESS)
-			manager->open_max = 64;
-		manager->calls = 0;
+			thread->open_max = 64;
+		thread->calls = 0;
 	}
 	for (pass = 0; pass < 2; pass++) {
-		dvp.dp_fds = manager->events;
-		dvp.dp_nfds = manager->nevents;
-		if (dvp.dp_nfds >= manager->open_max)
-			dvp.dp_nfds = manager->open_max - 1;
+		dvp.dp_fds = thread->events;
+		dvp.dp_nfds = thread->nevents;
+		if (dvp.dp_nfds >= thread->open_max)
+			dvp.dp_nfds = thread->open_max - 1;
 		if (tvp != NULL) {
 			dvp.dp_timeout = tvp->tv_sec * 1000 +
 				(tvp->tv_usec + 999) / 1000;
 		} else
 			dvp.dp_timeout = -1;
-		n = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+		n = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 		if (n == -1 && errno == EINVAL) {
 			/*
 			 * {OPEN_MAX} may have dropped.  Look
@@ -6583,9 +6980,9 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			 */
 			result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 			if (result != ISC_R_SUCCESS)
-				manager->open_max = 64;
+				thread->open_max = 64;
 		} else
 			break;
 	}
@@ -6610,6 +7007,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 isc_result_t
 isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 
 	REQUIRE(swait == &swait_private);
 
@@ -6619,12 +7017,13 @@ isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 #endif
 	if (manager == NULL)
 		return (ISC_R_NOTFOUND);
+	thread = &manager->threads[0];
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
-	(void)process_fds(manager, manager->events, swait->nevents);
+	(void)process_fds(thread, thread->events, swait->nevents);
 	return (ISC_R_SUCCESS);
 #elif defined(USE_SELECT)
-	process_fds(manager, swait->maxfd, swait->readset, swait->writeset);
+	process_fds(thread, swait->maxfd, swait->readset, swait->writeset);
 	return (ISC_R_SUCCESS);
 #endif
 }
@@ -6735,6 +7134,17 @@ isc_socketmgr_renderxml(isc_socketmgr_t *mgr0, xmlTextWriterPtr writer) {
 		TRY0(xmlTextWriterWriteElement(writer, ISC_XMLCHAR "type",
 					  ISC_XMLCHAR _socktype(sock->type)));
 
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "received"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    sock->recvcount));
+		TRY0(xmlTextWriterEndElement(writer));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "sent"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    sock->sendcount));
+		TRY0(xmlTextWriterEndElement(writer));
+
 		if (sock->connected) {
 			isc_sockaddr_format(&sock->peer_address, peerbuf,
 					    sizeof(peerbuf));
@@ -6857,6 +7267,14 @@ isc_socketmgr_renderjson(isc_socketmgr_t *mgr0, json_object *stats) {
 		CHECKMEM(obj);
 		json_object_object_add(entry, "type", obj);
 
+		obj = json_object_new_int64(sock->recvcount);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "received", obj);
+
+		obj = json_object_new_int64(sock->sendcount);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "sent", obj);
+
 		if (sock->connected) {
 			isc_sockaddr_format(&sock->peer_address, peerbuf,
 					    sizeof(peerbuf));
@@ -2685,6 +2685,19 @@ isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
 	return (isc_socketmgr_create2(mctx, managerp, 0));
 }
 
+/*
+ * The completion port already spreads I/O over its own worker threads,
+ * so 'nthreads' is ignored here.
+ */
+isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, unsigned int nthreads)
+{
+	UNUSED(nthreads);
+
+	return (isc__socketmgr_create2(mctx, managerp, maxsocks));
+}
+
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks)
@@ -3303,6 +3316,13 @@ isc__socket_bind(isc_socket_t *sock, isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	/*
+	 * Windows has no equivalent of SO_REUSEPORT load distribution.
+	 */
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+	}
 	if (bind(sock->fd, &sockaddr->type.sa, sockaddr->length) < 0) {
 		bind_errno = WSAGetLastError();
 		UNLOCK(&sock->lock);
@@ -591,6 +591,12 @@ static cfg_type_t cfg_type_updatemethod = {
 	&cfg_rep_string, &updatemethods_enums
 };
 
+static const char *loadorder_enums[] = { "none", "size", NULL };
+static cfg_type_t cfg_type_loadorder = {
+	"loadorder", cfg_parse_enum, cfg_print_ustring, cfg_doc_enum,
+	&cfg_rep_string, &loadorder_enums
+};
+
 /*
  * zone-statistics: full, terse, or none.
  *
@@ -1033,9 +1039,11 @@ options_clauses[] = {
 	{ "avoid-v6-udp-ports", &cfg_type_bracketed_portlist, 0 },
 	{ "bindkeys-file", &cfg_type_qstring, 0 },
 	{ "blackhole", &cfg_type_bracketed_aml, 0 },
+	{ "cache-node-locks", &cfg_type_uint32, 0 },
 	{ "cookie-algorithm", &cfg_type_cookiealg, 0 },
 	{ "cookie-secret", &cfg_type_sstring, CFG_CLAUSEFLAG_MULTI },
 	{ "coresize", &cfg_type_size, 0 },
+	{ "crypto-threads", &cfg_type_uint32, 0 },
 	{ "datasize", &cfg_type_size, 0 },
 	{ "deallocate-on-exit", &cfg_type_boolean, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "directory", &cfg_type_qstring, CFG_CLAUSEFLAG_CALLBACK },
@@ -1053,6 +1061,7 @@ options_clauses[] = {
 #endif
 	{ "dscp", &cfg_type_uint32, 0 },
 	{ "dump-file", &cfg_type_qstring, 0 },
+	{ "dump-rate", &cfg_type_sizenodefault, 0 },
 	{ "fake-iquery", &cfg_type_boolean, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "files", &cfg_type_size, 0 },
 	{ "flush-zones-on-shutdown", &cfg_type_boolean, 0 },
@@ -1113,6 +1122,7 @@ options_clauses[] = {
 	{ "recursing-file", &cfg_type_qstring, 0 },
 	{ "recursive-clients", &cfg_type_uint32, 0 },
 	{ "reserved-sockets", &cfg_type_uint32, 0 },
+	{ "reuseport", &cfg_type_boolean, 0 },
 	{ "secroots-file", &cfg_type_qstring, 0 },
 	{ "serial-queries", &cfg_type_uint32, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "serial-query-rate", &cfg_type_uint32, 0 },
@@ -1122,6 +1132,8 @@ options_clauses[] = {
 	{ "session-keyname", &cfg_type_astring, 0 },
 	{ "sit-secret", &cfg_type_sstring, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "stacksize", &cfg_type_size, 0 },
+	{ "startup-load-concurrency", &cfg_type_uint32, 0 },
+	{ "startup-load-order", &cfg_type_loadorder, 0 },
 	{ "startup-notify-rate", &cfg_type_uint32, 0 },
 	{ "statistics-file", &cfg_type_qstring, 0 },
 	{ "statistics-interval", &cfg_type_uint32, CFG_CLAUSEFLAG_NYI },
@@ -1141,6 +1153,7 @@ options_clauses[] = {
 	{ "use-v4-udp-ports", &cfg_type_bracketed_portlist, 0 },
 	{ "use-v6-udp-ports", &cfg_type_bracketed_portlist, 0 },
 	{ "version", &cfg_type_qstringornone, 0 },
+	{ "zone-node-locks", &cfg_type_uint32, 0 },
 	{ NULL, NULL, 0 }
 };
 
@@ -1718,6 +1731,7 @@ view_clauses[] = {
 	{ "attach-cache", &cfg_type_astring, 0 },
 	{ "auth-nxdomain", &cfg_type_boolean, CFG_CLAUSEFLAG_NEWDEFAULT },
 	{ "cache-file", &cfg_type_qstring, 0 },
+	{ "cache-snapshot", &cfg_type_qstring, 0 },
 	{ "catalog-zones", &cfg_type_catz, 0 },
 	{ "check-names", &cfg_type_checknames, CFG_CLAUSEFLAG_MULTI },
 	{ "cleaning-interval", &cfg_type_uint32, 0 },
@@ -1748,6 +1762,7 @@ view_clauses[] = {
 	{ "empty-contact", &cfg_type_astring, 0 },
 	{ "empty-server", &cfg_type_astring, 0 },
 	{ "empty-zones-enable", &cfg_type_boolean, 0 },
+	{ "expected-cache-names", &cfg_type_uint32, 0 },
 	{ "fetch-glue", &cfg_type_boolean, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "fetch-quota-params", &cfg_type_fetchquota, 0 },
 	{ "fetches-per-server", &cfg_type_fetchesper, 0 },
@@ -1807,6 +1822,7 @@ view_clauses[] = {
 	{ "request-sit", &cfg_type_boolean, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "require-server-cookie", &cfg_type_boolean, 0 },
 	{ "resolver-query-timeout", &cfg_type_uint32, 0 },
+	{ "response-cache-entries", &cfg_type_uint32, 0 },
 	{ "response-policy", &cfg_type_rpz, 0 },
 	{ "rfc2308-type1", &cfg_type_boolean, CFG_CLAUSEFLAG_NYI },
 	{ "root-delegation-only",  &cfg_type_optional_exclude, 0 },
@@ -1822,6 +1838,7 @@ view_clauses[] = {
 	  CFG_CLAUSEFLAG_EXPERIMENTAL },
 	{ "use-queryport-pool", &cfg_type_boolean, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "v6-bias", &cfg_type_uint32, 0 },
+	{ "verify-cache-size", &cfg_type_sizeval, 0 },
 	{ "zero-no-soa-ttl-cache", &cfg_type_boolean, 0 },
 	{ NULL, NULL, 0 }
 };
@@ -1923,6 +1940,9 @@ zone_clauses[] = {
 	{ "dnssec-dnskey-kskonly", &cfg_type_boolean,
 		CFG_ZONE_MASTER | CFG_ZONE_SLAVE
 	},
+	{ "expected-names", &cfg_type_uint32,
+		CFG_ZONE_MASTER | CFG_ZONE_SLAVE | CFG_ZONE_REDIRECT
+	},
 	{ "dnssec-loadkeys-interval", &cfg_type_uint32,
 		CFG_ZONE_MASTER | CFG_ZONE_SLAVE
 	},
@@ -1932,6 +1952,9 @@ zone_clauses[] = {
 	{ "dnssec-update-mode", &cfg_type_dnssecupdatemode,
 		CFG_ZONE_MASTER | CFG_ZONE_SLAVE
 	},
+	{ "dump-journal-ratio", &cfg_type_uint32,
+		CFG_ZONE_MASTER | CFG_ZONE_SLAVE
+	},
 	{ "forward", &cfg_type_forwardtype,
 		CFG_ZONE_MASTER | CFG_ZONE_SLAVE | CFG_ZONE_STUB |
 		CFG_ZONE_STATICSTUB | CFG_ZONE_FORWARD
@@ -2123,6 +2146,10 @@ zone_only_clauses[] = {
 	{ "server-names", &cfg_type_namelist,
 		CFG_ZONE_STATICSTUB
 	},
+	{ "startup-load-priority", &cfg_type_uint32,
+		CFG_ZONE_MASTER | CFG_ZONE_SLAVE | CFG_ZONE_STUB |
+		CFG_ZONE_REDIRECT
+	},
 	{ "update-policy", &cfg_type_updatepolicy,
 		CFG_ZONE_MASTER
 	},